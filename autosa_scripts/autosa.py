@@ -2,6 +2,48 @@
 import sys
 import subprocess
 import os
+import socket
+
+
+def run_autosa(argv):
+  """Run the compiler with the arguments "argv" and return its exit status.
+
+  If the environment variable AUTOSA_SERVER names the socket of a compile
+  server (autosa --server=<socket>), the compilation is sent to the server,
+  otherwise the compiler is started.
+  """
+  server = os.environ.get('AUTOSA_SERVER')
+  if not server:
+    return subprocess.run(argv).returncode
+  s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+  try:
+    s.connect(server)
+  except OSError:
+    print('[AutoSA] Warning: Can\'t connect to the compile server %s, '
+          'starting the compiler.' % server)
+    return subprocess.run(argv).returncode
+  request = [os.getcwd()] + argv[1:] + ['']
+  s.sendall(b''.join([a.encode() + b'\0' for a in request]))
+  # The output of the compilation is followed by a NUL byte and
+  # the exit status.
+  tail = None
+  while True:
+    data = s.recv(65536)
+    if not data:
+      break
+    if tail is None:
+      out, sep, rest = data.partition(b'\0')
+      sys.stdout.buffer.write(out)
+      sys.stdout.flush()
+      if sep:
+        tail = rest
+    else:
+      tail += data
+  s.close()
+  try:
+    return int(tail)
+  except (TypeError, ValueError):
+    return 1
 
 if __name__ == "__main__":
   n_arg = len(sys.argv)
@@ -25,56 +67,64 @@ if __name__ == "__main__":
     for arg in argv:
       if 'AutoSA-hls' in arg:
         xilinx_host = 'hls'
+  if target == 'autosa_c':
+    # The CPU simulation always uses the HLS host
+    xilinx_host = 'hls'
 
-  # Check if the output directory exists
-  if not os.path.isdir("./autosa.tmp"):
-    os.mkdir("./autosa.tmp")
-  if not os.path.isdir(output_dir):
-    os.mkdir(output_dir)
-    os.mkdir(output_dir + '/src')
-    os.mkdir(output_dir + '/latency_est')
-    os.mkdir(output_dir + '/resource_est')
+  # Create the output directory. Several instances may run concurrently
+  # with their own output directories, possibly under the same parent.
+  for d in ['/src', '/latency_est', '/resource_est']:
+    os.makedirs(output_dir + d, exist_ok=True)
 
   # Execute the AutoSA
-  process = subprocess.run(argv)
-  if process.returncode != 0:
+  if run_autosa(argv) != 0:
     sys.exit()
   if not os.path.exists(output_dir + '/src/completed'):
     sys.exit()
 
-  # Generate the top module
-  print("[AutoSA] Post-processing the generated code...")
-  if not os.path.exists(output_dir + '/src/' + src_file_prefix + '_top_gen.cpp'):
-    sys.exit()
-  cmd = 'g++ -o '   + output_dir + '/src/top_gen ' + output_dir + \
-        '/src/' + src_file_prefix + '_top_gen.cpp ' + \
-        '-I./src/isl/include -L./src/isl/.libs -lisl'
-  process = subprocess.run(cmd.split())
-  my_env = os.environ.copy()
-  cwd = os.getcwd()
-  if 'LD_LIBRARY_PATH' in my_env:
-    my_env['LD_LIBRARY_PATH'] += os.pathsep +  cwd + '/src/isl/.libs'
+  # The final kernel is stitched by AutoSA directly, unless the top module
+  # could not be generated natively. In that case, fall back to the compiled
+  # top module generator and codegen.py.
+  if target == 'autosa_opencl':
+    kernel_modules = output_dir + '/src/' + src_file_prefix + '_kernel_modules.cl'
+    kernel = output_dir + '/src/' + src_file_prefix + '_kernel.cl'
   else:
-    my_env['LD_LIBRARY_PATH'] = os.pathsep +  cwd + '/src/isl/.libs'
-  cmd = output_dir + '/src/top_gen'
-  process = subprocess.run(cmd.split(), env=my_env)
+    kernel_modules = output_dir + '/src/' + src_file_prefix + '_kernel_modules.cpp'
+    kernel = output_dir + '/src/' + src_file_prefix + '_kernel.cpp'
+  if os.path.exists(kernel_modules):
+    print("[AutoSA] Post-processing the generated code...")
+    if not os.path.exists(output_dir + '/src/' + src_file_prefix + '_top_gen.cpp'):
+      sys.exit()
+    cmd = 'g++ -o '   + output_dir + '/src/top_gen ' + output_dir + \
+          '/src/' + src_file_prefix + '_top_gen.cpp ' + \
+          '-I./src/isl/include -L./src/isl/.libs -lisl'
+    process = subprocess.run(cmd.split())
+    my_env = os.environ.copy()
+    cwd = os.getcwd()
+    if 'LD_LIBRARY_PATH' in my_env:
+      my_env['LD_LIBRARY_PATH'] += os.pathsep +  cwd + '/src/isl/.libs'
+    else:
+      my_env['LD_LIBRARY_PATH'] = os.pathsep +  cwd + '/src/isl/.libs'
+    cmd = output_dir + '/src/top_gen'
+    process = subprocess.run(cmd.split(), env=my_env)
 
-  # Generate the final code
-  if target == 'autosa_hls_c':
-    cmd = './autosa_scripts/codegen.py -c ' + output_dir + \
-          '/src/top.cpp -d ' + output_dir + '/src/' + src_file_prefix + \
-          '_kernel_modules.cpp -t ' + target + ' -o ' + output_dir + '/src/' + \
-          src_file_prefix + '_kernel.cpp'
-  elif target == 'autosa_opencl':
     cmd = './autosa_scripts/codegen.py -c ' + output_dir + \
-          '/src/top.cpp -d ' + output_dir + '/src/' + src_file_prefix + \
-          '_kernel_modules.cl -t ' + target + ' -o ' + output_dir + '/src/' + \
-          src_file_prefix + '_kernel.cl'
+          '/src/top.cpp -d ' + kernel_modules + ' -t ' + target + \
+          ' -o ' + kernel
+    if target == 'autosa_hls_c' or target == 'autosa_c':
+      cmd += ' --host '
+      cmd += xilinx_host
+    process = subprocess.run(cmd.split())
+    if target == 'autosa_hls_c' and xilinx_host == 'opencl':
+      os.remove(output_dir + '/src/' + src_file_prefix + '_kernel.h')
+    for f in [output_dir + '/src/top_gen', output_dir + '/src/top.cpp',
+              kernel_modules]:
+      if os.path.exists(f):
+        os.remove(f)
 
-  if target == 'autosa_hls_c':
-    cmd += ' --host '
-    cmd += xilinx_host
-  process = subprocess.run(cmd.split())
+  if target == 'autosa_c':
+    cmd = 'cp ./autosa_scripts/cpu_sim/autosa_cpu_stream.h ' + output_dir + '/src/'
+    process = subprocess.run(cmd.split())
 
   cmd = 'cp ' + argv[1] + ' ' + output_dir + '/src/'
   process = subprocess.run(cmd.split())
@@ -84,24 +134,9 @@ if __name__ == "__main__":
   if os.path.exists(headers):
     cmd = 'cp ' + headers + ' ' + output_dir + '/src/'
     process = subprocess.run(cmd.split())
-  if os.path.exists(output_dir + '/src/completed'):
-    cmd = 'rm ' + output_dir + '/src/completed'
-    process = subprocess.run(cmd.split())
-  if target == 'autosa_hls_c' and xilinx_host == 'opencl':
-    cmd = 'rm ' + output_dir + '/src/' + src_file_prefix + '_kernel.h'
-    process = subprocess.run(cmd.split())
-
   # Clean up the temp files
-  cmd = 'rm ' + output_dir + '/src/top_gen'
-  process = subprocess.run(cmd.split())
-  cmd = 'rm ' + output_dir + '/src/top.cpp'
-  process = subprocess.run(cmd.split())
-  cmd = 'rm ' + output_dir + '/src/' + src_file_prefix + '_top_gen.cpp'
-  process = subprocess.run(cmd.split())
-  cmd = 'rm ' + output_dir + '/src/' + src_file_prefix + '_top_gen.h'
-  process = subprocess.run(cmd.split())
-  if target == 'autosa_hls_c':
-    cmd = 'rm ' + output_dir + '/src/' + src_file_prefix + '_kernel_modules.cpp'
-  elif target == 'autosa_opencl':
-    cmd = 'rm ' + output_dir + '/src/' + src_file_prefix + '_kernel_modules.cl'
-  process = subprocess.run(cmd.split())
+  for f in [output_dir + '/src/completed',
+            output_dir + '/src/' + src_file_prefix + '_top_gen.cpp',
+            output_dir + '/src/' + src_file_prefix + '_top_gen.h']:
+    if os.path.exists(f):
+      os.remove(f)
@@ -0,0 +1,319 @@
+#!/usr/bin/env python3
+
+"""Benchmark suite of AutoSA.
+
+Compiles each example of the suite (autosa_tests/benchmark.json by default)
+for each of its fixed --sa-sizes configurations, and records the compile
+time, the peak memory of the compiler, the estimated latency and resources
+of the generated design and, with --hw, the throughput measured by the host
+on the board.
+The results are written to a JSON file, and compared against a baseline
+results file if one is given, such that regressions in the compiler or in
+the generated designs show up immediately.
+The environment variables in the paths and arguments of the suite are
+expanded, e.g., ${POLYBENCH_DIR} in autosa_tests/polybench.json, which
+benchmarks the compile time of AutoSA itself on the PolyBench kernels.
+
+Run from the AutoSA root directory, e.g.,
+  ./autosa_scripts/benchmark.py -o bench.json -b baseline.json
+  POLYBENCH_DIR=<dir> ./autosa_scripts/benchmark.py \\
+      -s autosa_tests/polybench.json -o polybench.json -b baseline.json
+"""
+
+import argparse
+import datetime
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+import time
+
+# The compile times below this duration (in seconds) are too noisy to be
+# compared against the baseline.
+MIN_TIME = 0.5
+
+
+def load_json(path):
+  """Load the JSON file "path", or return None if it can't be read."""
+  try:
+    with open(path) as f:
+      return json.load(f)
+  except (IOError, ValueError):
+    return None
+
+
+def git_commit():
+  """Return the commit of the AutoSA tree, or None outside of a git tree."""
+  try:
+    out = subprocess.run(['git', 'rev-parse', 'HEAD'], stdout=subprocess.PIPE,
+                         stderr=subprocess.DEVNULL, universal_newlines=True)
+  except OSError:
+    return None
+  if out.returncode != 0:
+    return None
+  return out.stdout.strip()
+
+
+def run_hw(bench, output_dir, log):
+  """Build the design in "output_dir" and run it on the board.
+
+  The Makefile and connectivity.cfg of the example are copied to the output
+  directory. The FPGA time reported by the host is returned in seconds, or
+  None if the design can't be built or run.
+  """
+  for f in ['Makefile', 'connectivity.cfg']:
+    src = os.path.join(os.path.expandvars(bench['dir']), f)
+    if os.path.exists(src):
+      shutil.copy(src, output_dir)
+  ret = subprocess.run(['make', 'all'], cwd=output_dir, stdout=log,
+                       stderr=subprocess.STDOUT)
+  if ret.returncode != 0:
+    return None
+  ret = subprocess.run(['./host.exe', 'kernel0.hw.xclbin'], cwd=output_dir,
+                       stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                       universal_newlines=True)
+  log.write(ret.stdout)
+  m = re.search(r'FPGA Time: ([0-9.eE+-]+) s', ret.stdout)
+  if ret.returncode != 0 or not m:
+    return None
+  return float(m.group(1))
+
+
+def run_checks(bench, kernel):
+  """Check the generated kernel file "kernel" of the example "bench".
+
+  Each check of the example gives a regular expression ("pattern"), matched
+  line by line, and the number of its matches ("count") expected in the
+  kernel file, e.g., the number of instances of a module.
+  Return the list of the failed checks.
+  """
+  with open(kernel) as f:
+    code = f.read()
+  failed = []
+  for check in bench.get('checks', []):
+    n = len(re.findall(check['pattern'], code, re.MULTILINE))
+    if n != check['count']:
+      print('[AutoSA] Error: "%s" matches %d times in %s, %d expected' %
+            (check['pattern'], n, kernel, check['count']))
+      failed.append(check['pattern'])
+  return failed
+
+
+def run_config(args, suite, bench, config, sa_sizes):
+  """Compile the example "bench" with the configuration "config".
+
+  Return the record of the compilation.
+  """
+  name = bench['name'] + ':' + config
+  output_dir = os.path.join(args.work_dir, bench['name'] + '_' + config)
+  if os.path.isdir(output_dir):
+    shutil.rmtree(output_dir)
+  bench_dir = os.path.expandvars(bench['dir'])
+  src_file = os.path.join(bench_dir, os.path.expandvars(bench.get('src',
+                                                                  'kernel.c')))
+  prefix = os.path.basename(src_file).split('.')[0]
+
+  cmd = [args.autosa, src_file]
+  cmd += os.path.expandvars(suite.get('common_args', '')).split()
+  cmd += os.path.expandvars(bench.get('args', '')).split()
+  cmd += ['--AutoSA-output-dir=' + output_dir, '--sa-sizes={' + sa_sizes + '}',
+          '--AutoSA-profile']
+  simd_info = os.path.join(bench_dir, 'simd_info.json')
+  if os.path.exists(simd_info):
+    cmd.append('--AutoSA-simd-info=' + simd_info)
+
+  record = {'name': name, 'benchmark': bench['name'], 'config': config,
+            'sa_sizes': sa_sizes}
+  if not os.path.exists(src_file):
+    print('[AutoSA] Error: Can\'t find the source of %s: %s' % (name, src_file))
+    record['status'] = 'failed'
+    record['compile_time'] = None
+    return record
+  log_path = output_dir + '.log'
+  with open(log_path, 'w') as log:
+    start = time.time()
+    ret = subprocess.run(cmd, stdout=log, stderr=subprocess.STDOUT)
+    record['compile_time'] = time.time() - start
+    # The peak memory and the time of the compilation phases are taken from
+    # the profile of the compiler.
+    profile = load_json(os.path.join(output_dir, 'profile.json'))
+    if profile:
+      events = profile.get('traceEvents', [])
+      record['peak_memory_kb'] = max([e['args']['peak_rss_kb']
+                                      for e in events] or [None])
+      record['phases'] = dict((e['name'], e['dur'] / 1e6) for e in events
+                              if e.get('cat') == 'phase')
+
+    kernel = os.path.join(output_dir, 'src', prefix + '_kernel.cpp')
+    record['status'] = 'ok' if ret.returncode == 0 and \
+        os.path.exists(kernel) else 'failed'
+    if record['status'] == 'ok' and bench.get('checks'):
+      failed = run_checks(bench, kernel)
+      if failed:
+        record['status'] = 'failed'
+        record['failed_checks'] = failed
+    latency = load_json(os.path.join(output_dir, 'latency_est',
+                                     'latency_info.json'))
+    if latency:
+      record['latency'] = latency.get('latency')
+    res = load_json(os.path.join(output_dir, 'resource_est',
+                                 'resource_info.json'))
+    if res:
+      record['resource'] = res.get('total')
+    roofline = load_json(os.path.join(output_dir, 'roofline.json'))
+    if roofline:
+      record['bound'] = roofline.get('bound')
+      record['operational_intensity'] = roofline.get('operational_intensity')
+      record['off_chip_bytes'] = roofline.get('off_chip_bytes')
+
+    if args.hw and record['status'] == 'ok':
+      fpga_time = run_hw(bench, output_dir, log)
+      record['fpga_time'] = fpga_time
+      if fpga_time and 'flops' in bench:
+        record['gflops'] = eval(bench['flops'], {'__builtins__': {}}) / \
+            fpga_time / 1e9
+
+  status = record['status']
+  if record.get('latency') is not None:
+    status += ', latency: %d cycles' % record['latency']
+  if record.get('gflops') is not None:
+    status += ', %.2f GFLOP/s' % record['gflops']
+  if record.get('peak_memory_kb') is not None:
+    status += ', peak memory: %d MB' % (record['peak_memory_kb'] / 1024)
+  print('[AutoSA] Benchmark %s: %s (%.2f s)' %
+        (name, status, record['compile_time']))
+
+  return record
+
+
+def report_phases(results):
+  """Print the time of each compilation phase, summed over "results"."""
+  total = {}
+  for r in results:
+    for phase, t in (r.get('phases') or {}).items():
+      total[phase] = total.get(phase, 0.0) + t
+  for phase in sorted(total, key=lambda p: -total[p]):
+    print('[AutoSA] Phase %s: %.2f s' % (phase, total[phase]))
+
+
+def compare(results, baseline, tolerance):
+  """Compare "results" against "baseline".
+
+  A compilation regresses if it fails while it succeeded in the baseline,
+  if its compile time, the time of one of its compilation phases, its peak
+  memory, latency, off-chip traffic or resources grow by more than
+  "tolerance" (a fraction), or if its throughput drops by more than
+  "tolerance". The compile times shorter than MIN_TIME in both runs are
+  too noisy to be compared. Return the list of regressions.
+  """
+  base = dict((r['name'], r) for r in baseline.get('results', []))
+  regressions = []
+
+  def check(name, what, new, old, higher_is_worse=True):
+    if new is None or old is None or old == 0:
+      return
+    change = (new - old) / float(old)
+    if not higher_is_worse:
+      change = -change
+    if change > tolerance:
+      regressions.append('%s: %s regressed from %s to %s (%+.1f%%)' %
+                         (name, what, old, new, 100.0 * change))
+
+  def check_time(name, what, new, old):
+    if new is None or old is None or max(new, old) < MIN_TIME:
+      return
+    check(name, what, round(new, 3), round(old, 3))
+
+  for r in results:
+    old = base.get(r['name'])
+    if not old:
+      continue
+    if r['status'] != 'ok' and old['status'] == 'ok':
+      regressions.append('%s: compilation failed' % r['name'])
+      continue
+    check_time(r['name'], 'compile time', r.get('compile_time'),
+               old.get('compile_time'))
+    phases = r.get('phases') or {}
+    old_phases = old.get('phases') or {}
+    for phase in sorted(phases):
+      check_time(r['name'], 'phase "%s"' % phase, phases[phase],
+                 old_phases.get(phase))
+    check(r['name'], 'peak memory', r.get('peak_memory_kb'),
+          old.get('peak_memory_kb'))
+    check(r['name'], 'latency', r.get('latency'), old.get('latency'))
+    check(r['name'], 'off-chip traffic', r.get('off_chip_bytes'),
+          old.get('off_chip_bytes'))
+    res = r.get('resource') or {}
+    old_res = old.get('resource') or {}
+    for key in sorted(res):
+      check(r['name'], key, res.get(key), old_res.get(key))
+    check(r['name'], 'GFLOP/s', r.get('gflops'), old.get('gflops'),
+          higher_is_worse=False)
+
+  return regressions
+
+
+def main():
+  parser = argparse.ArgumentParser(description='Benchmark suite of AutoSA')
+  parser.add_argument('-s', '--suite', default='autosa_tests/benchmark.json',
+                      help='benchmark suite')
+  parser.add_argument('-o', '--output', default='autosa.tmp/benchmark.json',
+                      help='results file')
+  parser.add_argument('-b', '--baseline', help='baseline results file')
+  parser.add_argument('-t', '--tolerance', type=float, default=0.1,
+                      help='tolerated relative regression')
+  parser.add_argument('-w', '--work-dir', default='autosa.tmp/benchmark',
+                      help='directory of the generated designs')
+  parser.add_argument('--autosa', default='./autosa',
+                      help='AutoSA script')
+  parser.add_argument('--filter', help='only run the benchmarks matching '
+                      'the regular expression on "name:config"')
+  parser.add_argument('--hw', action='store_true',
+                      help='build and run the designs on the board')
+  args = parser.parse_args()
+
+  suite = load_json(args.suite)
+  if not suite:
+    print('[AutoSA] Error: Can\'t load the benchmark suite: %s' % args.suite)
+    sys.exit(1)
+  if not os.path.isdir(args.work_dir):
+    os.makedirs(args.work_dir)
+
+  results = []
+  for bench in suite['benchmarks']:
+    for config in sorted(bench['configs']):
+      name = bench['name'] + ':' + config
+      if args.filter and not re.search(args.filter, name):
+        continue
+      results.append(run_config(args, suite, bench, config,
+                                bench['configs'][config]))
+
+  report = {'date': datetime.datetime.now().isoformat(),
+            'commit': git_commit(), 'results': results}
+  with open(args.output, 'w') as f:
+    json.dump(report, f, indent=2)
+  report_phases(results)
+  print('[AutoSA] Benchmark results are written to %s' % args.output)
+  failed = [r['name'] for r in results if r.get('failed_checks')]
+  for name in failed:
+    print('[AutoSA] Error: The generated design of %s fails its checks' % name)
+
+  if args.baseline:
+    baseline = load_json(args.baseline)
+    if not baseline:
+      print('[AutoSA] Error: Can\'t load the baseline: %s' % args.baseline)
+      sys.exit(1)
+    regressions = compare(results, baseline, args.tolerance)
+    for r in regressions:
+      print('[AutoSA] Regression: %s' % r)
+    if regressions:
+      sys.exit(1)
+    print('[AutoSA] No regression against %s' % args.baseline)
+  if failed:
+    sys.exit(1)
+
+
+if __name__ == "__main__":
+  main()
@@ -0,0 +1,259 @@
+#!/usr/bin/env python3
+
+"""Calibration of the AutoSA latency and resource estimators.
+
+Fits the correction coefficients of the estimators against the designs of
+the benchmark suite (see benchmark.py). For each design, the estimates of
+the compiler (latency_est/latency_info.json, resource_est/resource_info.json)
+are compared to:
+- the Vitis HLS synthesis reports (*_csynth.xml) found under the design
+  directory, for the latency and resources of each module, and of the top
+  module for the FIFOs;
+- the FPGA time measured on the board by benchmark.py --hw, for the latency
+  of the kernel.
+One coefficient is fitted per module type (PE, IO, drain) and per resource,
+and one for the kernel latency, by least squares on the ratio
+measured / estimated. The coefficients are written to a JSON file that is
+passed to the compiler with --AutoSA-calibration.
+
+Run from the AutoSA root directory after the benchmark suite was synthesized,
+e.g.,
+  ./autosa_scripts/benchmark.py --hw -o bench.json
+  ./autosa_scripts/calibrate.py -r bench.json
+"""
+
+import argparse
+import json
+import os
+import sys
+import xml.etree.ElementTree as ET
+
+RESOURCES = ['BRAM18K', 'DSP', 'FF', 'LUT', 'URAM']
+# The names of the resources in the HLS reports, by the AutoSA names
+HLS_RESOURCES = {'BRAM18K': ['BRAM_18K'], 'DSP': ['DSP', 'DSP48E'],
+                 'FF': ['FF'], 'LUT': ['LUT'], 'URAM': ['URAM']}
+MODULE_TYPES = ['PE', 'IO', 'drain']
+
+
+def load_json(path):
+  """Load the JSON file "path", or return None if it can't be read."""
+  try:
+    with open(path) as f:
+      return json.load(f)
+  except (IOError, ValueError):
+    return None
+
+
+def to_int(text):
+  """Convert the report entry "text" to an integer, or None if undefined."""
+  try:
+    return int(text)
+  except (TypeError, ValueError):
+    return None
+
+
+def parse_csynth(path):
+  """Parse the Vitis HLS synthesis report "path".
+
+  Return the name of the synthesized function, its worst-case latency in
+  cycles (None if undefined) and its resources.
+  """
+  try:
+    root = ET.parse(path).getroot()
+  except (IOError, ET.ParseError):
+    return None, None, None
+  name = root.findtext('UserAssignments/TopModelName')
+  latency = to_int(root.findtext(
+      'PerformanceEstimates/SummaryOfOverallLatency/Worst-caseLatency'))
+  res = {}
+  for key in RESOURCES:
+    for hls_key in HLS_RESOURCES[key]:
+      value = to_int(root.findtext('AreaEstimates/Resources/' + hls_key))
+      if value is not None:
+        res[key] = value
+        break
+  return name, latency, res
+
+
+def load_reports(design_dir):
+  """Return the HLS synthesis reports under "design_dir", by function."""
+  reports = {}
+  for dirpath, _, files in os.walk(design_dir):
+    for f in files:
+      if not f.endswith('_csynth.xml'):
+        continue
+      name, latency, res = parse_csynth(os.path.join(dirpath, f))
+      if name:
+        reports[name] = {'latency': latency, 'resource': res}
+  return reports
+
+
+def find_report(reports, module):
+  """Return the report of the module "module", if any.
+
+  The modules with inner and outer functions are reported under
+  the outer "<module>_wrapper" function.
+  """
+  for name in [module + '_wrapper', module]:
+    if name in reports:
+      return reports[name]
+  return None
+
+
+def find_top_report(reports):
+  """Return the report of the top kernel function, if any."""
+  for name in sorted(reports):
+    if name.startswith('kernel') and name[len('kernel'):].isdigit():
+      return reports[name]
+  return None
+
+
+class Fit(object):
+  """Least-squares fit of a ratio "measured ~ coef * estimated"."""
+
+  def __init__(self):
+    self.em = 0.0
+    self.ee = 0.0
+    self.samples = []
+
+  def add(self, est, meas):
+    if est is None or meas is None or est <= 0:
+      return
+    self.em += est * meas
+    self.ee += est * est
+    self.samples.append((est, meas))
+
+  def coef(self):
+    return self.em / self.ee if self.ee > 0 else 1.0
+
+  def error(self, coef):
+    """Mean relative error of the estimates scaled by "coef"."""
+    if not self.samples:
+      return 0.0
+    return sum([abs(coef * e - m) / max(m, 1) for e, m in self.samples]) / \
+        len(self.samples)
+
+
+def kernel_latency(latency_info, coefs):
+  """Recompute the kernel latency from the module latencies in
+  "latency_info", scaled by the latency coefficients "coefs".
+  """
+  max_lat = 0
+  for info in latency_info.get('modules', {}).values():
+    coef = coefs.get(info.get('type'), 1.0)
+    max_lat = max(max_lat, int(info['latency'] * coef))
+  return max_lat + latency_info.get('fill_latency', 0)
+
+
+def calibrate(args, results):
+  """Fit the coefficients on the designs of "results"."""
+  lat_fits = dict((t, Fit()) for t in MODULE_TYPES)
+  res_fits = dict((t, dict((r, Fit()) for r in RESOURCES))
+                  for t in MODULE_TYPES + ['FIFO'])
+  kernel_fit = Fit()
+  designs = []
+
+  for r in results:
+    if r.get('status') != 'ok':
+      continue
+    design_dir = os.path.join(args.work_dir, r['benchmark'] + '_' + r['config'])
+    latency_info = load_json(os.path.join(design_dir, 'latency_est',
+                                          'latency_info.json'))
+    resource_info = load_json(os.path.join(design_dir, 'resource_est',
+                                           'resource_info.json'))
+    if not latency_info or not resource_info:
+      print('[AutoSA] Warning: No estimates found for %s.' % r['name'])
+      continue
+    reports = load_reports(design_dir)
+    designs.append((r, latency_info))
+
+    for name, info in latency_info.get('modules', {}).items():
+      report = find_report(reports, name)
+      if report and info.get('type') in lat_fits:
+        lat_fits[info['type']].add(info['latency'], report['latency'])
+
+    # The FIFOs are fitted on the resources of the top module left to
+    # the module instances.
+    modules_res = dict((key, 0) for key in RESOURCES)
+    for name, info in resource_info.get('modules', {}).items():
+      report = find_report(reports, name)
+      if not report or info.get('type') not in res_fits:
+        continue
+      for key in RESOURCES:
+        res_fits[info['type']][key].add(info.get(key), report['resource'].get(key))
+        modules_res[key] += report['resource'].get(key, 0) * info.get('num', 0)
+    top = find_top_report(reports)
+    total = resource_info.get('uncalibrated_total', resource_info.get('total'))
+    if top and total:
+      est_modules = dict((key, 0) for key in RESOURCES)
+      for info in resource_info.get('modules', {}).values():
+        for key in RESOURCES:
+          est_modules[key] += info.get(key, 0) * info.get('num', 0)
+      for key in RESOURCES:
+        meas = top['resource'].get(key)
+        if meas is not None and meas - modules_res[key] > 0:
+          res_fits['FIFO'][key].add(total[key] - est_modules[key],
+                                    meas - modules_res[key])
+
+  lat_coefs = dict((t, lat_fits[t].coef()) for t in MODULE_TYPES)
+  # The kernel coefficient is fitted on top of the module coefficients.
+  for r, latency_info in designs:
+    if r.get('fpga_time'):
+      kernel_fit.add(kernel_latency(latency_info, lat_coefs),
+                     r['fpga_time'] * args.freq * 1e6)
+
+  calibration = {'latency': dict(lat_coefs), 'resource': {}}
+  calibration['latency']['kernel'] = kernel_fit.coef()
+  for t in sorted(res_fits):
+    calibration['resource'][t] = dict((key, res_fits[t][key].coef())
+                                      for key in RESOURCES)
+
+  # Report the fitting errors
+  fits = [('latency ' + t, lat_fits[t]) for t in MODULE_TYPES]
+  fits.append(('latency kernel', kernel_fit))
+  for t in sorted(res_fits):
+    fits += [('%s %s' % (t, key), res_fits[t][key]) for key in RESOURCES]
+  for name, fit in fits:
+    if fit.samples:
+      print('[AutoSA] Calibration %s: coefficient %.3f, error %.1f%% -> %.1f%% '
+            '(%d samples)' % (name, fit.coef(), 100.0 * fit.error(1.0),
+                              100.0 * fit.error(fit.coef()), len(fit.samples)))
+
+  return calibration
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description='Calibration of the AutoSA estimators')
+  parser.add_argument('-r', '--results', default='autosa.tmp/benchmark.json',
+                      help='benchmark results file')
+  parser.add_argument('-w', '--work-dir', default='autosa.tmp/benchmark',
+                      help='directory of the generated designs')
+  parser.add_argument('-o', '--output',
+                      default='autosa_config/calibration.json',
+                      help='calibration file')
+  parser.add_argument('--hw-info', default='autosa_config/hw_info.json',
+                      help='hardware information file, for the frequency')
+  parser.add_argument('--freq', type=float,
+                      help='kernel frequency in MHz (default: "FREQ" in the '
+                      'hardware information, or 300)')
+  args = parser.parse_args()
+
+  report = load_json(args.results)
+  if not report:
+    print('[AutoSA] Error: Can\'t load the benchmark results: %s' %
+          args.results)
+    sys.exit(1)
+  if args.freq is None:
+    hw_info = load_json(args.hw_info) or {}
+    args.freq = hw_info.get('FREQ', 300)
+
+  calibration = calibrate(args, report.get('results', []))
+  calibration['commit'] = report.get('commit')
+  with open(args.output, 'w') as f:
+    json.dump(calibration, f, indent=2, sort_keys=True)
+  print('[AutoSA] Calibration coefficients are written to %s' % args.output)
+
+
+if __name__ == "__main__":
+  main()
@@ -4,7 +4,7 @@ import sympy
 import sys
 import argparse
 import re
-import numpy as np
+import functools
 
 def print_module_def(f, arg_map, module_def, def_args, call_args_type):
   """Print out module definitions for Intel OpenCL
@@ -282,7 +282,18 @@ def float_to_int(matchobj):
     return str_expr
 
 def index_simplify(matchobj):
-  str_expr = matchobj.group(0)
+  return index_simplify_str(matchobj.group(0))
+
+@functools.lru_cache(maxsize=None)
+def index_simplify_str(str_expr):
+  """ Simplify the array index expression "str_expr"
+
+  The same index expressions appear many times in the program, the results
+  are cached. The shifts and masks of the strength-reduced expressions
+  printed by AutoSA are kept as they are.
+  """
+  if '>>' in str_expr or '&' in str_expr:
+    return str_expr
   expr = sympy.sympify(str_expr[1 : len(str_expr) - 1])
   """
   This will sometimes cause bugs due to the different semantics in C
@@ -304,7 +315,12 @@ def index_simplify(matchobj):
     return '[' + new_str_expr + ']'
 
 def mod_simplify(matchobj):
-  str_expr = matchobj.group(0)
+  return mod_simplify_str(matchobj.group(0))
+
+@functools.lru_cache(maxsize=None)
+def mod_simplify_str(str_expr):
+  if '>>' in str_expr or '&' in str_expr:
+    return str_expr
   str_expr = str_expr[1: len(str_expr) - 3]
   expr = sympy.sympify(str_expr)
   expr = sympy.simplify(expr)
@@ -335,70 +351,41 @@ def simplify_expressions(lines):
 
   return lines
 
-def shrink_bit_width(lines):
-  """ Calculate the bitwidth of the iterator and shrink it to the proper size
-
-  Args:
-    lines: contains the codelines of the program
-  """
-
-  code_len = len(lines)
-  for pos in range(code_len):
-    line = lines[pos]
-    if line.find('for') != -1:
-      # Parse the loop upper bound
-      m = re.search('<=(.+?);', line)
-      if m:
-        ub = m.group(1).strip()
-        if ub.isnumeric():
-          # Replace it with shallow bit width
-          bitwidth = int(np.ceil(np.log2(float(ub) + 1))) + 1
-          new_iter_t = 'ap_uint<' + str(bitwidth) + '>'
-          line = re.sub('int', new_iter_t, line)
-          lines[pos] = line
-      m = re.search('<(.+?);', line)
-      if m:
-        ub = m.group(1).strip()
-        if ub.isnumeric():
-          # Replace it with shallow bit width
-          bitwidth = int(np.ceil(np.log2(float(ub)))) + 1
-          new_iter_t = 'ap_uint<' + str(bitwidth) + '>'
-          line = re.sub('int', new_iter_t, line)
-          lines[pos] = line
-
-  return lines
-
 def lify_split_buffers(lines):
   """ Lift the split buffers in the program
 
   For each module, if we find any split buffers with the name "buf_data_split",
   we will lift them out of the for loops and put them in the variable declaration
   section at the beginning of the module.
+  The lines are processed in a single pass. The lifted lines are collected
+  for each variable declaration section and inserted in the end.
 
   Args:
     lines: contains the codelines of the program
   """
-  code_len = len(lines)
-  for pos in range(code_len):
-    line = lines[pos]
-    if line.find('variable=buf_data_split') != -1:
-      # Search for the variable declaration section
-      decl_pos = -1
-      prev_pos = pos - 1
-      while prev_pos >= 0:
-        prev_line = lines[prev_pos]
-        if prev_line.find('Variable Declaration') != -1:
-          decl_pos = prev_pos
-          break
-        prev_pos -= 1
-      # Move the two code lines at [pos - 1] and [pos] to [decl_pos] and [decl_pos + 1]
-      indent = lines[decl_pos].find('/*')
-      line1 = ' ' * indent + lines[pos - 1].lstrip()
-      line2 = ' ' * indent + lines[pos].lstrip()
-      del lines[pos - 1]
-      del lines[pos - 1]
-      lines.insert(decl_pos, line1)
-      lines.insert(decl_pos + 1, line2)
+  new_lines = []
+  lifted = {}
+  decl_pos = -1
+  for line in lines:
+    if line.find('Variable Declaration') != -1:
+      decl_pos = len(new_lines)
+    if line.find('variable=buf_data_split') != -1 and \
+       decl_pos >= 0 and decl_pos < len(new_lines) - 1:
+      # Move the declaration and the pragma of the split buffer in front of [decl_pos]
+      indent = new_lines[decl_pos].find('/*')
+      line1 = ' ' * indent + new_lines.pop().lstrip()
+      line2 = ' ' * indent + line.lstrip()
+      lifted.setdefault(decl_pos, []).extend([line1, line2])
+      continue
+    new_lines.append(line)
+
+  if not lifted:
+    return new_lines
+  lines = []
+  for pos in range(len(new_lines)):
+    if pos in lifted:
+      lines.extend(lifted[pos])
+    lines.append(new_lines[pos])
 
   return lines
 
@@ -409,12 +396,15 @@ def reorder_module_calls(lines):
   Starting from the first module, enlist the module calls until the boundary module
   is met.
   Reverse the list and output it.
+  The lines are processed in a single pass, with the reversed module calls
+  replacing the tail of the output lines.
 
   Args:
     lines: contains the codelines of the program
   """
 
   code_len = len(lines)
+  new_lines = []
   module_calls = []
   module_start = 0
   module_call = []
@@ -423,11 +413,11 @@ def reorder_module_calls(lines):
   new_module = 0
   prev_module_name = ""
   first_line = -1
-  last_line = -1
   reset = 0
 
   for pos in range(code_len):
     line = lines[pos]
+    emitted = 0
     if line.find("/* Module Call */") != -1:
       if module_start == 0:
         module_start = 1
@@ -448,38 +438,36 @@ def reorder_module_calls(lines):
           module_name = module_name[:-9]
         if prev_module_name == "":
           prev_module_name = module_name
-          first_line = pos
+          first_line = len(new_lines)
         else:
           if prev_module_name != module_name:
             new_module = 1
             prev_module_name = module_name
-            first_line = pos
+            first_line = len(new_lines)
             reset = 0
           else:
             if reset:
-              first_line = pos
+              first_line = len(new_lines)
               reset = 0
             new_module = 0
 
       if not module_start:
         if output_io:
-          last_line = pos
           module_call.append(line)
           module_calls.append(module_call.copy())
           module_call.clear()
           if boundary:
             # Reverse the list
             module_calls.reverse()
-            # Insert it back
-            left_lines = lines[last_line + 1:]
-            lines = lines[:first_line]
+            # Replace the module calls in the output
+            del new_lines[first_line:]
             first = 1
             for c in module_calls:
               if not first:
-                lines.append("\n")
-              lines = lines + c
+                new_lines.append("\n")
+              new_lines.extend(c)
               first = 0
-            lines = lines + left_lines
+            emitted = 1
             # Clean up
             module_calls.clear()
             boundary = 0
@@ -491,10 +479,51 @@ def reorder_module_calls(lines):
 
     if module_start and output_io:
       module_call.append(line)
+    if not emitted:
+      new_lines.append(line)
 
-  return lines
+  return new_lines
+
+def spawn_module_threads(lines):
+  """ Launch each module call in its own thread
 
-def xilinx_run(kernel_call, kernel_def, kernel='autosa.tmp/output/src/kernel_kernel.cpp', host='opencl'):
+  Used by the CPU simulation. Each module call enclosed by the
+  "/* Module Call */" markers is wrapped in a lambda that is run by a new
+  thread. The threads are joined after the last module call.
+
+  Args:
+    lines: contains the codelines of the program
+  """
+
+  new_lines = []
+  in_call = False
+  declared = False
+  last = -1
+  indent = ''
+  for line in lines:
+    if line.find('/* Module Call */') != -1:
+      indent = line[:len(line) - len(line.lstrip())]
+      if not in_call:
+        if not declared:
+          new_lines.append(indent + 'std::vector<std::thread> autosa_threads;\n')
+          declared = True
+        new_lines.append(line)
+        new_lines.append(indent + 'autosa_threads.emplace_back([&]() {\n')
+      else:
+        new_lines.append(indent + '});\n')
+        new_lines.append(line)
+        last = len(new_lines)
+      in_call = not in_call
+      continue
+    new_lines.append(line)
+
+  if last != -1:
+    new_lines.insert(last, indent + 'for (auto &t : autosa_threads)\n')
+    new_lines.insert(last + 1, indent + '  t.join();\n')
+
+  return new_lines
+
+def xilinx_run(kernel_call, kernel_def, kernel='autosa.tmp/output/src/kernel_kernel.cpp', host='opencl', reorder=True, cpu_sim=False):
   """ Generate the kernel file for Xilinx platform
 
   We will copy the content of kernel definitions before the kernel calls.
@@ -503,6 +532,9 @@ def xilinx_run(kernel_call, kernel_def, kernel='autosa.tmp/output/src/kernel_ker
     kernel_call: file containing kernel calls
     kernel_def: file containing kernel definitions
     kernel: output kernel file
+    reorder: reorder the module calls, not needed if the kernel calls are
+             generated by AutoSA directly
+    cpu_sim: run each module call in its own thread for the CPU simulation
 
   """
 
@@ -514,9 +546,6 @@ def xilinx_run(kernel_call, kernel_def, kernel='autosa.tmp/output/src/kernel_ker
   # Simplify the expressions
   lines = simplify_expressions(lines)
 
-  # Change the loop iterator type
-  lines = shrink_bit_width(lines)
-
   # Insert the HLS pragmas
   lines = insert_xlnx_pragmas(lines)
 
@@ -543,7 +572,10 @@ def xilinx_run(kernel_call, kernel_def, kernel='autosa.tmp/output/src/kernel_ker
     with open(kernel_call, 'r') as f2:
       lines = f2.readlines()
       # Reorder module calls
-      lines = reorder_module_calls(lines)
+      if reorder:
+        lines = reorder_module_calls(lines)
+      if cpu_sim:
+        lines = spawn_module_threads(lines)
       f.writelines(lines)
 
 def intel_run(kernel_call, kernel_def, kernel='autosa.tmp/output/src/kernel_kernel.cpp'):
@@ -635,13 +667,16 @@ if __name__ == "__main__":
   parser = argparse.ArgumentParser(description='==== AutoSA CodeGen ====')
   parser.add_argument('-c', '--kernel-call', metavar='KERNEL_CALL', required=True, help='kernel function call')
   parser.add_argument('-d', '--kernel-def', metavar='KERNEL_DEF', required=True, help='kernel function definition')
-  parser.add_argument('-t', '--target', metavar='TARGET', required=True, help='hardware target: autosa_hls_c|autosa_opencl')
+  parser.add_argument('-t', '--target', metavar='TARGET', required=True, help='hardware target: autosa_hls_c|autosa_opencl|autosa_c')
   parser.add_argument('-o', '--output', metavar='OUTPUT', required=False, help='output kernel file')
   parser.add_argument('--host', metavar='HOST', required=False, help='Xilinx host target: hls|opencl', default='opencl')
+  parser.add_argument('--no-reorder', action='store_true', help='do not reorder the module calls')
 
   args = parser.parse_args()
 
   if args.target == 'autosa_opencl':
     intel_run(args.kernel_call, args.kernel_def, args.output)
   elif args.target == 'autosa_hls_c':
-    xilinx_run(args.kernel_call, args.kernel_def, args.output, args.host)
+    xilinx_run(args.kernel_call, args.kernel_def, args.output, args.host, not args.no_reorder)
+  elif args.target == 'autosa_c':
+    xilinx_run(args.kernel_call, args.kernel_def, args.output, 'hls', not args.no_reorder, True)
@@ -0,0 +1,103 @@
+/* Multithreaded replacement of hls::stream for the AutoSA CPU simulation
+ * (--target=autosa_c).
+ *
+ * Each module call of the top kernel runs in its own thread, and the modules
+ * communicate through the streams below. A stream is a bounded
+ * single-producer single-consumer ring buffer. A read from an empty stream
+ * and a write to a full stream spin until the peer makes progress.
+ * The capacity of each stream is AUTOSA_CPU_FIFO_DEPTH elements, which is
+ * much deeper than the hardware FIFOs, so any design that makes progress
+ * on the FPGA makes progress here.
+ */
+
+#ifndef _AUTOSA_CPU_STREAM_H
+#define _AUTOSA_CPU_STREAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#ifndef AUTOSA_CPU_FIFO_DEPTH
+#define AUTOSA_CPU_FIFO_DEPTH 1024
+#endif
+
+namespace hls
+{
+  template <typename T>
+  class stream
+  {
+  public:
+    stream() : buf(AUTOSA_CPU_FIFO_DEPTH + 1), head(0), tail(0) {}
+    stream(const char *name) : stream() {}
+    stream(const stream &) = delete;
+    stream &operator=(const stream &) = delete;
+
+    bool empty() const
+    {
+      return head.load(std::memory_order_acquire) ==
+             tail.load(std::memory_order_acquire);
+    }
+
+    bool full() const
+    {
+      return next(tail.load(std::memory_order_acquire)) ==
+             head.load(std::memory_order_acquire);
+    }
+
+    /* Only called by the consumer. */
+    bool read_nb(T &val)
+    {
+      size_t h = head.load(std::memory_order_relaxed);
+      if (h == tail.load(std::memory_order_acquire))
+        return false;
+      val = buf[h];
+      head.store(next(h), std::memory_order_release);
+      return true;
+    }
+
+    /* Only called by the producer. */
+    bool write_nb(const T &val)
+    {
+      size_t t = tail.load(std::memory_order_relaxed);
+      size_t n = next(t);
+      if (n == head.load(std::memory_order_acquire))
+        return false;
+      buf[t] = val;
+      tail.store(n, std::memory_order_release);
+      return true;
+    }
+
+    void read(T &val)
+    {
+      while (!read_nb(val))
+        std::this_thread::yield();
+    }
+
+    T read()
+    {
+      T val;
+      read(val);
+      return val;
+    }
+
+    void write(const T &val)
+    {
+      while (!write_nb(val))
+        std::this_thread::yield();
+    }
+
+    void operator>>(T &val) { read(val); }
+    void operator<<(const T &val) { write(val); }
+
+  private:
+    size_t next(size_t i) const { return i + 1 == buf.size() ? 0 : i + 1; }
+
+    std::vector<T> buf;
+    /* Keep the two indices on different cache lines. */
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+  };
+} // namespace hls
+
+#endif
@@ -0,0 +1,452 @@
+#!/usr/bin/env python3
+
+"""Distributed design space exploration of AutoSA.
+
+Evaluates the design points of an exploration (autosa --AutoSA-explore, see
+tuning.json) on a cluster of workers and keeps the results in a shared
+SQLite database, such that no design point is compiled or synthesized twice,
+across runs and across users sharing the database.
+The script acts as the coordinator: the design points are queued and handed
+out to the jobs of the workers as they become free. Each worker is a compile
+server (autosa --server=<socket>) on the local host or on a remote host
+reached by ssh; the remote hosts are expected to share the file system of
+the coordinator, with AutoSA at the same path. With --hls, each generated
+design is also synthesized on the worker that generated it, with a Vitis HLS
+script, with "v++ -c", or module by module with the results of the unchanged
+modules reused from a shared cache (--hls-tool), at most --hls-jobs at once. Each design
+point is generated in its own output directory under --work-dir, such that
+any number of them can be generated and synthesized concurrently. With
+--update-tuning, the HLS results are added to the design points of
+tuning.json, and its Pareto front is ranked by the HLS latency.
+
+Each record is keyed by the hash of the program (the source file and its
+header), the compiler arguments and the --sa-sizes of the design point.
+The estimates of the exploration and the estimated latency and resources of
+the compiler are stored once the design is generated, and the latency and
+resources of the HLS report once it is synthesized. The records with both
+train the learned cost model of the exploration (see train_cost_model.py).
+
+Run from the AutoSA root directory, e.g.,
+  ./autosa_scripts/explore_cluster.py ./autosa_tests/mm/kernel.c \\
+      -t autosa.tmp/output/tuning.json --db /shared/autosa_dse.db \\
+      -a "--config=./autosa_config/autosa_config.json --target=autosa_hls_c \\
+          --simd-info=./autosa_tests/mm/simd_info.json --host-code-only" \\
+      -W localhost:/tmp/autosa.sock:4 -W node1:/tmp/autosa.sock:8 --hls
+"""
+
+import argparse
+import datetime
+import hashlib
+import json
+import os
+import queue
+import shlex
+import sqlite3
+import subprocess
+import sys
+import threading
+import time
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, SCRIPT_DIR)
+from calibrate import load_json, load_reports, find_top_report
+
+# The version of the records, to be increased when the results of the same
+# design point change, e.g., with the estimators.
+RECORD_VERSION = '1'
+LOCAL_HOSTS = ['', 'local', 'localhost']
+
+SCHEMA = '''CREATE TABLE IF NOT EXISTS results (
+  key TEXT PRIMARY KEY,
+  program TEXT,
+  args TEXT,
+  sa_sizes TEXT,
+  status TEXT,
+  latency INTEGER,
+  resource TEXT,
+  compile_time REAL,
+  hls_latency INTEGER,
+  hls_resource TEXT,
+  hls_time REAL,
+  features TEXT,
+  worker TEXT,
+  date TEXT
+)'''
+COLUMNS = ['key', 'program', 'args', 'sa_sizes', 'status', 'latency',
+           'resource', 'compile_time', 'hls_latency', 'hls_resource',
+           'hls_time', 'features', 'worker', 'date']
+JSON_COLUMNS = ['resource', 'hls_resource', 'features']
+
+HLS_TCL = '''open_project hls_prj
+set_top kernel0
+add_files src/%s_kernel.cpp
+open_solution "solution1"
+set_part {%s}
+create_clock -period %s -name default
+config_compile -name_max_length 50
+csynth_design
+exit
+'''
+
+
+class Database(object):
+  """The shared result database, accessed by all the jobs of the coordinator.
+  """
+
+  def __init__(self, path):
+    # Other coordinators may hold the lock of the database for a while.
+    self.conn = sqlite3.connect(path, timeout=300, check_same_thread=False)
+    self.conn.execute(SCHEMA)
+    self.conn.commit()
+    self.lock = threading.Lock()
+
+  def get(self, key):
+    """Return the record "key", or None if there is none."""
+    with self.lock:
+      row = self.conn.execute('SELECT %s FROM results WHERE key = ?' %
+                              ', '.join(COLUMNS), (key,)).fetchone()
+    if not row:
+      return None
+    record = dict(zip(COLUMNS, row))
+    for k in JSON_COLUMNS:
+      if record[k]:
+        record[k] = json.loads(record[k])
+    return record
+
+  def put(self, record):
+    """Insert or replace the record "record"."""
+    row = dict(record)
+    for k in JSON_COLUMNS:
+      if row.get(k) is not None:
+        row[k] = json.dumps(row[k], sort_keys=True)
+    row['date'] = datetime.datetime.now().isoformat()
+    with self.lock:
+      self.conn.execute('INSERT OR REPLACE INTO results (%s) VALUES (%s)' %
+                        (', '.join(COLUMNS), ', '.join(['?'] * len(COLUMNS))),
+                        [row.get(k) for k in COLUMNS])
+      self.conn.commit()
+
+
+class Worker(object):
+  """A compile server "socket" on the host "host", with "jobs" jobs."""
+
+  def __init__(self, spec):
+    parts = spec.split(':')
+    self.host = parts[0]
+    self.socket = parts[1] if len(parts) > 1 and parts[1] else \
+        '/tmp/autosa.sock'
+    self.jobs = int(parts[2]) if len(parts) > 2 else 1
+    self.name = (self.host or 'localhost') + ':' + self.socket
+
+  def run(self, cmd, cwd, log, env=None):
+    """Run the command "cmd" in the directory "cwd" on the worker.
+
+    Return the exit status of the command.
+    """
+    if self.host in LOCAL_HOSTS:
+      my_env = os.environ.copy()
+      my_env.update(env or {})
+      return subprocess.run(cmd, cwd=cwd, env=my_env, stdout=log,
+                            stderr=subprocess.STDOUT).returncode
+    remote = 'cd %s && ' % shlex.quote(cwd)
+    for k, v in sorted((env or {}).items()):
+      remote += '%s=%s ' % (k, shlex.quote(v))
+    remote += ' '.join(shlex.quote(c) for c in cmd)
+    return subprocess.run(['ssh', '-o', 'BatchMode=yes', self.host, remote],
+                          stdout=log, stderr=subprocess.STDOUT).returncode
+
+
+def normalize_sizes(sa_sizes):
+  """Return the --sa-sizes string "sa_sizes" with its braces."""
+  sa_sizes = sa_sizes.strip()
+  if not sa_sizes.startswith('{'):
+    sa_sizes = '{' + sa_sizes + '}'
+  return sa_sizes
+
+
+def program_hash(src_file):
+  """Return the hash of the source file "src_file" and of its header."""
+  h = hashlib.sha256()
+  header = os.path.splitext(src_file)[0] + '.h'
+  for path in [src_file, header]:
+    if os.path.exists(path):
+      with open(path, 'rb') as f:
+        h.update(f.read())
+    h.update(b'\0')
+  return h.hexdigest()
+
+
+def record_key(program, args, sa_sizes):
+  """Return the key of the design point "sa_sizes" of the program with
+  the hash "program", compiled with the arguments "args".
+  """
+  h = hashlib.sha256()
+  for s in [RECORD_VERSION, program] + sorted(args) + [sa_sizes]:
+    h.update(s.encode() + b'\0')
+  return h.hexdigest()
+
+
+def load_points(tuning, all_points, top):
+  """Return the --sa-sizes and the estimates of the design points of
+  the exploration "tuning".
+
+  The points on the Pareto front are returned, or all the points if
+  "all_points" is set, in the order of the exploration, and at most "top" of
+  them if "top" is positive.
+  """
+  explore = tuning.get('explore', {})
+  points = explore.get('points' if all_points else 'pareto', [])
+  sizes = []
+  for p in points:
+    s = normalize_sizes(p['sa_sizes'])
+    if s not in [s1 for s1, _ in sizes]:
+      sizes.append((s, p))
+  if top > 0:
+    sizes = sizes[:top]
+  return sizes
+
+
+def update_tuning(path, tuning, records):
+  """Add the HLS results of "records" to the design points of
+  the exploration "tuning" and write it back to "path".
+
+  The Pareto front is ranked by the HLS latency, where the design points
+  without HLS results come last in their original order.
+  """
+  results = dict((r['sa_sizes'], r) for r in records
+                 if r.get('hls_latency') is not None)
+  explore = tuning.get('explore', {})
+  for key in ['points', 'pareto']:
+    for p in explore.get(key, []):
+      r = results.get(normalize_sizes(p['sa_sizes']))
+      if r:
+        p['hls_latency'] = r['hls_latency']
+        p['hls_resource'] = r['hls_resource']
+  explore.get('pareto', []).sort(
+      key=lambda p: (p.get('hls_latency') is None, p.get('hls_latency') or 0))
+  with open(path, 'w') as f:
+    json.dump(tuning, f, indent=2)
+  print('[AutoSA] HLS results of %d design points are added to %s' %
+        (len(results), path))
+
+
+def run_point(args, worker, record, log):
+  """Generate the design point "record" on "worker" and, with --hls,
+  synthesize it.
+
+  The record is updated with the results.
+  """
+  cwd = os.getcwd()
+  output_dir = os.path.abspath(os.path.join(args.work_dir, record['key'][:16]))
+  prefix = os.path.basename(args.src).split('.')[0]
+  env = {'AUTOSA_SERVER': worker.socket}
+
+  kernel = os.path.join(output_dir, 'src', prefix + '_kernel.cpp')
+  if record.get('status') != 'ok' or not os.path.exists(kernel):
+    cmd = [args.autosa, args.src] + args.compile_args + \
+          ['--AutoSA-output-dir=' + output_dir,
+           '--sa-sizes=' + record['sa_sizes']]
+    start = time.time()
+    ret = worker.run(cmd, cwd, log, env)
+    record['compile_time'] = time.time() - start
+    record['status'] = 'ok' if ret == 0 and os.path.exists(kernel) \
+        else 'failed'
+    latency = load_json(os.path.join(output_dir, 'latency_est',
+                                     'latency_info.json'))
+    record['latency'] = latency.get('latency') if latency else None
+    res = load_json(os.path.join(output_dir, 'resource_est',
+                                 'resource_info.json'))
+    record['resource'] = res.get('total') if res else None
+    record['worker'] = worker.name
+
+  if args.hls and record['status'] == 'ok':
+    if args.hls_tool == 'modules':
+      cmd = [os.path.join(SCRIPT_DIR, 'hls_module_cache.py'), output_dir, '--cache', os.path.abspath(args.module_cache),
+             '--part', args.part, '--clock-period', args.clock_period,
+             '--vitis-hls', args.vitis_hls, '-j', '1']
+    elif args.hls_tool == 'v++':
+      cmd = [args.vpp, '-c', '-t', 'hw', '--platform', args.platform,
+             '-k', 'kernel0', '--save-temps', '-o', 'kernel0.xo',
+             'src/' + prefix + '_kernel.cpp']
+    else:
+      with open(os.path.join(output_dir, 'autosa_csynth.tcl'), 'w') as f:
+        f.write(HLS_TCL % (prefix, args.part, args.clock_period))
+      cmd = [args.vitis_hls, '-f', 'autosa_csynth.tcl']
+    with args.hls_slots:
+      start = time.time()
+      worker.run(cmd, output_dir, log)
+      record['hls_time'] = time.time() - start
+    if args.hls_tool == 'modules':
+      report = load_json(os.path.join(output_dir, 'module_reports.json'))
+      if report and report.get('failed'):
+        report = None
+    else:
+      # The reports of v++ are kept under _x with --save-temps.
+      report = find_top_report(load_reports(output_dir))
+    if report:
+      record['hls_latency'] = report['latency']
+      record['hls_resource'] = report['resource']
+    else:
+      print('[AutoSA] Warning: No HLS report for the design %s.' %
+            record['sa_sizes'])
+    record['worker'] = worker.name
+
+
+def serve(args, db, worker, points, done):
+  """Evaluate the design points of the queue "points" on "worker" until
+  the queue is empty, and store the records in "db".
+  """
+  while True:
+    try:
+      record = points.get_nowait()
+    except queue.Empty:
+      return
+    log_path = os.path.join(args.work_dir, record['key'][:16] + '.log')
+    with open(log_path, 'a') as log:
+      run_point(args, worker, record, log)
+    db.put(record)
+    done.append(record)
+    status = record['status']
+    if record.get('latency') is not None:
+      status += ', latency: %d cycles' % record['latency']
+    if record.get('hls_latency') is not None:
+      status += ', HLS latency: %d cycles' % record['hls_latency']
+    print('[AutoSA] [%d/%d] %s on %s: %s' % (len(done), args.n_points,
+                                             record['sa_sizes'], worker.name,
+                                             status))
+    sys.stdout.flush()
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description='Distributed design space exploration of AutoSA')
+  parser.add_argument('src', help='source file of the program')
+  parser.add_argument('-t', '--tuning', required=True,
+                      help='tuning.json of the exploration')
+  parser.add_argument('-a', '--args', default='',
+                      help='compiler arguments of the design points')
+  parser.add_argument('--db', default='autosa.tmp/explore.db',
+                      help='shared result database')
+  parser.add_argument('-W', '--worker', action='append', default=[],
+                      help='worker HOST[:SOCKET[:JOBS]], may be repeated '
+                      '(default: localhost:/tmp/autosa.sock:1)')
+  parser.add_argument('-w', '--work-dir', default='autosa.tmp/explore',
+                      help='directory of the generated designs, shared by '
+                      'the workers')
+  parser.add_argument('-o', '--output', help='results file')
+  parser.add_argument('--all', action='store_true',
+                      help='evaluate all the design points instead of the '
+                      'Pareto front')
+  parser.add_argument('--top', type=int, default=0,
+                      help='evaluate at most this number of design points')
+  parser.add_argument('--retry', action='store_true',
+                      help='evaluate the failed design points again')
+  parser.add_argument('--hls', action='store_true',
+                      help='synthesize the generated designs with Vitis HLS')
+  parser.add_argument('--hls-tool', choices=['vitis_hls', 'v++', 'modules'],
+                      default='vitis_hls',
+                      help='synthesize with a Vitis HLS script, with '
+                      '"v++ -c", or module by module with the results cached '
+                      '(see hls_module_cache.py)')
+  parser.add_argument('--module-cache', default='autosa.tmp/hls_cache',
+                      help='cache of the module results with '
+                      '--hls-tool=modules, shared by the workers')
+  parser.add_argument('--hls-jobs', type=int, default=0,
+                      help='maximal number of concurrent syntheses '
+                      '(default: one per job)')
+  parser.add_argument('--platform', help='platform of "v++ -c"')
+  parser.add_argument('--update-tuning', action='store_true',
+                      help='add the HLS results to the design points of '
+                      'the exploration and rank its Pareto front by them')
+  parser.add_argument('--part', default='xcu200-fsgd2104-2-e',
+                      help='FPGA part of the synthesis')
+  parser.add_argument('--clock-period', default='5',
+                      help='clock period of the synthesis in ns')
+  parser.add_argument('--vitis-hls', default='vitis_hls',
+                      help='Vitis HLS command')
+  parser.add_argument('--vpp', default='v++', help='v++ command')
+  parser.add_argument('--autosa', default='./autosa',
+                      help='AutoSA script')
+  args = parser.parse_args()
+
+  tuning = load_json(args.tuning)
+  if not tuning:
+    print('[AutoSA] Error: Can\'t load the exploration: %s' % args.tuning)
+    sys.exit(1)
+  if not os.path.exists(args.src):
+    print('[AutoSA] Error: Can\'t find the source file: %s' % args.src)
+    sys.exit(1)
+  for d in [args.work_dir, os.path.dirname(args.db)]:
+    if d and not os.path.isdir(d):
+      os.makedirs(d)
+  if args.hls and args.hls_tool == 'v++' and not args.platform:
+    print('[AutoSA] Error: "v++ -c" needs a platform (--platform).')
+    sys.exit(1)
+  args.compile_args = shlex.split(args.args)
+  workers = [Worker(w) for w in args.worker or ['localhost']]
+  # The syntheses are much heavier than the compilations and may be limited
+  # separately.
+  args.hls_slots = threading.BoundedSemaphore(
+      args.hls_jobs if args.hls_jobs > 0 else sum(w.jobs for w in workers))
+  db = Database(args.db)
+
+  # Queue the design points that are not in the database yet.
+  program = program_hash(args.src)
+  records = []
+  points = queue.Queue()
+  for sa_sizes, point in load_points(tuning, args.all, args.top):
+    key = record_key(program, args.compile_args, sa_sizes)
+    record = db.get(key)
+    if record and record['status'] == 'ok':
+      todo = args.hls and record['hls_latency'] is None
+    else:
+      todo = not record or args.retry
+    if not todo:
+      records.append(record)
+      continue
+    if not record or record['status'] != 'ok':
+      record = {'key': key, 'program': program,
+                'args': ' '.join(args.compile_args), 'sa_sizes': sa_sizes}
+    # The estimates of the exploration are the features of the learned
+    # cost model, see train_cost_model.py.
+    record['features'] = point
+    records.append(record)
+    points.put(record)
+  args.n_points = points.qsize()
+  print('[AutoSA] %d design points, %d found in %s, %d to evaluate on %d jobs.'
+        % (len(records), len(records) - args.n_points, args.db, args.n_points,
+           sum(w.jobs for w in workers)))
+
+  done = []
+  threads = []
+  for w in workers:
+    for _ in range(w.jobs):
+      t = threading.Thread(target=serve, args=(args, db, w, points, done))
+      t.start()
+      threads.append(t)
+  for t in threads:
+    t.join()
+
+  # Rank the design points by the measured latency if any, then by
+  # the estimated latency.
+  def rank(r):
+    lat = r.get('hls_latency')
+    if lat is None:
+      lat = r.get('latency')
+    return (r.get('status') != 'ok', lat is None, lat or 0)
+  records.sort(key=rank)
+  for r in records[:10]:
+    print('[AutoSA] %s: %s, latency: %s, HLS latency: %s' %
+          (r['sa_sizes'], r.get('status'), r.get('latency'),
+           r.get('hls_latency')))
+  if args.output:
+    with open(args.output, 'w') as f:
+      json.dump({'date': datetime.datetime.now().isoformat(),
+                 'program': program, 'results': records}, f, indent=2)
+    print('[AutoSA] Exploration results are written to %s' % args.output)
+  if args.update_tuning:
+    update_tuning(args.tuning, tuning, records)
+
+
+if __name__ == "__main__":
+  main()
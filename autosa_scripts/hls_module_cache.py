@@ -0,0 +1,257 @@
+#!/usr/bin/env python3
+
+"""Per-module out-of-context HLS synthesis of AutoSA designs, with caching.
+
+Splits the kernel generated by AutoSA (<prefix>_kernel.cpp) into its hardware
+modules, i.e., the functions enclosed by "Module Definition" comments that
+are called by the top kernel, and synthesizes each one of them with Vitis HLS
+as the top function of its own project. The source of a module (the common
+declarations, the headers of the design, the module and the functions it
+calls) is hashed together with the synthesis settings, and the results are
+kept under the cache directory by hash, such that a module that is unchanged
+between neighboring design points (e.g., the I/O modules when only the SIMD
+factor changes) is never synthesized again, and only the changed modules are
+synthesized, in parallel.
+The modules shared by module deduplication (--AutoSA-module-dedup) reuse
+the results of the module they call.
+
+The assembly step combines the reports of the modules into the report of
+the design, written to module_reports.json in the design directory: the
+resources of the design are the resources of the modules times their number
+of instances, and its latency is the latency of the slowest module, since
+all the modules run concurrently in the dataflow region of the top kernel.
+The synthesized RTL of each module is kept in the cache as well.
+
+Run from the AutoSA root directory, e.g.,
+  ./autosa_scripts/hls_module_cache.py autosa.tmp/output \\
+      --cache /shared/autosa_hls_cache -j 8
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+from concurrent.futures import ThreadPoolExecutor
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from calibrate import RESOURCES, parse_csynth
+
+MARKER = '/* Module Definition */'
+# The version of the cached results, to be increased when the synthesis
+# script changes.
+CACHE_VERSION = '1'
+
+HLS_TCL = '''open_project hls_prj
+set_top %s
+add_files %s.cpp
+open_solution "solution1"
+set_part {%s}
+create_clock -period %s -name default
+config_compile -name_max_length 50
+csynth_design
+exit
+'''
+
+
+def split_kernel(text):
+  """Split the kernel source "text" into the common declarations before
+  the first module, the module definitions in order, and the top kernel
+  after the last module.
+
+  Each module definition is returned as a pair of its function name and
+  its source.
+  """
+  parts = text.split(MARKER)
+  if len(parts) < 3:
+    return text, [], ''
+  modules = []
+  # The definitions are at the odd positions, between two markers.
+  for i in range(1, len(parts) - 1, 2):
+    m = re.search(r'\bvoid\s+(\w+)\s*\(', parts[i])
+    if m:
+      modules.append((m.group(1), parts[i]))
+  return parts[0], modules, parts[-1]
+
+
+def calls(source, name):
+  """Return the number of calls to the function "name" in "source"."""
+  return len(re.findall(r'\b%s\s*\(' % re.escape(name), source))
+
+
+def module_closure(modules, name):
+  """Return the sources of the module "name" and of the modules it calls,
+  transitively, in the order of the kernel.
+  """
+  defs = dict(modules)
+  needed = set([name])
+  todo = [name]
+  while todo:
+    body = defs[todo.pop()]
+    for other, _ in modules:
+      # The header of the definition itself is not a call.
+      if other not in needed and calls(body, other) > 0:
+        needed.add(other)
+        todo.append(other)
+  return [src for n, src in modules if n in needed]
+
+
+def shared_module(source):
+  """Return the module whose definition the deduplicated module "source"
+  shares, or None.
+  """
+  m = re.search(r'/\* Shared with (\w+) \*/', source)
+  return m.group(1) if m else None
+
+
+def design_headers(src_dir):
+  """Return the headers of the design, by file name."""
+  headers = {}
+  for f in sorted(os.listdir(src_dir)):
+    if f.endswith('.h'):
+      with open(os.path.join(src_dir, f)) as fh:
+        headers[f] = fh.read()
+  return headers
+
+
+def synthesize(args, name, source, headers, key):
+  """Synthesize the module "name" with the source "source" out of context,
+  unless its results are cached under "key".
+
+  Return the report of the module and whether it was cached.
+  """
+  entry = os.path.join(args.cache, key)
+  report_path = os.path.join(entry, name + '_csynth.xml')
+  if not os.path.exists(report_path):
+    # Synthesize in a private directory that is renamed once complete,
+    # such that concurrent runs sharing the cache don't race.
+    work = tempfile.mkdtemp(prefix=key[:16] + '.', dir=args.cache)
+    for f, text in headers.items():
+      with open(os.path.join(work, f), 'w') as fh:
+        fh.write(text)
+    with open(os.path.join(work, name + '.cpp'), 'w') as fh:
+      fh.write(source)
+    with open(os.path.join(work, 'script.tcl'), 'w') as fh:
+      fh.write(HLS_TCL % (name, name, args.part, args.clock_period))
+    with open(os.path.join(work, 'hls.log'), 'w') as log:
+      subprocess.run([args.vitis_hls, '-f', 'script.tcl'], cwd=work,
+                     stdout=log, stderr=subprocess.STDOUT)
+    syn = os.path.join(work, 'hls_prj', 'solution1', 'syn')
+    report = os.path.join(syn, 'report', name + '_csynth.xml')
+    if not os.path.exists(report):
+      print('[AutoSA] Warning: Synthesis of the module %s failed, see %s' %
+            (name, os.path.join(work, 'hls.log')))
+      return None, False
+    result = os.path.join(work, 'result')
+    os.mkdir(result)
+    shutil.copy(report, result)
+    if os.path.isdir(os.path.join(syn, 'verilog')):
+      shutil.copytree(os.path.join(syn, 'verilog'),
+                      os.path.join(result, 'verilog'))
+    try:
+      os.rename(result, entry)
+    except OSError:
+      # Another run has cached the same module meanwhile.
+      pass
+    shutil.rmtree(work, ignore_errors=True)
+    cached = False
+  else:
+    cached = True
+  _, latency, res = parse_csynth(report_path)
+  return {'latency': latency, 'resource': res}, cached
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description='Per-module HLS synthesis of AutoSA designs with caching')
+  parser.add_argument('design', help='output directory of the design')
+  parser.add_argument('--cache', default='autosa.tmp/hls_cache',
+                      help='directory of the cached module results')
+  parser.add_argument('-j', '--jobs', type=int, default=4,
+                      help='maximal number of concurrent syntheses')
+  parser.add_argument('--part', default='xcu200-fsgd2104-2-e',
+                      help='FPGA part of the synthesis')
+  parser.add_argument('--clock-period', default='5',
+                      help='clock period of the synthesis in ns')
+  parser.add_argument('--vitis-hls', default='vitis_hls',
+                      help='Vitis HLS command')
+  args = parser.parse_args()
+
+  src_dir = os.path.join(args.design, 'src')
+  kernels = [f for f in os.listdir(src_dir) if f.endswith('_kernel.cpp')] \
+      if os.path.isdir(src_dir) else []
+  if not kernels:
+    print('[AutoSA] Error: Can\'t find the kernel in %s' % src_dir)
+    sys.exit(1)
+  with open(os.path.join(src_dir, kernels[0])) as f:
+    common, modules, top = split_kernel(f.read())
+  if not modules:
+    print('[AutoSA] Error: No module definition in %s' % kernels[0])
+    sys.exit(1)
+  if not os.path.isdir(args.cache):
+    os.makedirs(args.cache, exist_ok=True)
+  headers = design_headers(src_dir)
+  defs = dict(modules)
+
+  # The modules instantiated by the top kernel, with their number of
+  # instances. The deduplicated modules are synthesized as the module
+  # they share.
+  instances = {}
+  for name, _ in modules:
+    n = calls(top, name)
+    if n > 0:
+      instances[name] = n
+  targets = {}
+  for name in instances:
+    target = shared_module(defs[name]) or name
+    if target not in defs:
+      target = name
+    targets[name] = target
+
+  jobs = {}
+  with ThreadPoolExecutor(max_workers=max(args.jobs, 1)) as pool:
+    for target in sorted(set(targets.values())):
+      source = common + '\n'.join(module_closure(modules, target))
+      h = hashlib.sha256()
+      for s in [CACHE_VERSION, args.part, str(args.clock_period), source] + \
+          [k + '\0' + v for k, v in sorted(headers.items())]:
+        h.update(s.encode() + b'\0')
+      jobs[target] = pool.submit(synthesize, args, target, source, headers,
+                                 h.hexdigest())
+  results = dict((t, j.result()) for t, j in jobs.items())
+  n_cached = len([1 for r, cached in results.values() if r and cached])
+  n_synth = len([1 for r, cached in results.values() if r and not cached])
+  print('[AutoSA] %d modules: %d synthesized, %d reused from %s' %
+        (len(results), n_synth, n_cached, args.cache))
+
+  # Assemble the reports of the modules into the report of the design.
+  report = {'modules': {}, 'latency': None,
+            'resource': dict((k, 0) for k in RESOURCES)}
+  failed = []
+  for name in sorted(instances):
+    module_report, _ = results[targets[name]]
+    if not module_report:
+      failed.append(name)
+      continue
+    report['modules'][name] = dict(module_report, instances=instances[name])
+    if module_report['latency'] is not None:
+      report['latency'] = max(report['latency'] or 0, module_report['latency'])
+    for k, v in (module_report['resource'] or {}).items():
+      report['resource'][k] = report['resource'].get(k, 0) + \
+          v * instances[name]
+  if failed:
+    report['failed'] = failed
+  with open(os.path.join(args.design, 'module_reports.json'), 'w') as f:
+    json.dump(report, f, indent=2)
+  print('[AutoSA] Latency: %s cycles, resources: %s' %
+        (report['latency'], report['resource']))
+  if failed:
+    sys.exit(1)
+
+
+if __name__ == "__main__":
+  main()
@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+
+"""Training of the learned cost model of the AutoSA exploration.
+
+Fits gradient-boosted regression trees on the records of the result
+databases of explore_cluster.py that were synthesized with Vitis HLS.
+For each design point, the features are computed from the estimates of the
+exploration (the number of PEs, the SIMD factor, the latency hiding length,
+the array dimensions, the length of the I/O daisy chains, and the analytic
+latency, resources and off-chip traffic), and the targets are the logarithms
+of the ratios of the HLS latency and resources to the analytic estimates.
+The trees are written to a JSON file that is passed to the compiler with
+--AutoSA-cost-model, which corrects the estimates of the explored design
+points with the predicted ratios before ranking them.
+
+Run from the AutoSA root directory, e.g.,
+  ./autosa_scripts/train_cost_model.py --db /shared/autosa_dse.db \\
+      -o autosa_config/cost_model.json
+"""
+
+import argparse
+import json
+import math
+import sqlite3
+import sys
+
+from sklearn.ensemble import GradientBoostingRegressor
+
+# The features of a design point, in the order of the compiler,
+# see cost_model_features in autosa_explore.cpp.
+FEATURES = ['n_pe', 'simd', 'latency_hide_len', 'sa_dim0', 'sa_dim1',
+            'sa_dim2', 'io_chain', 'log_latency', 'DSP', 'BRAM18K', 'URAM',
+            'log_DRAM_bytes']
+# The targets of the model, with the keys of their analytic estimates in
+# the design points and of their measurements in the HLS reports.
+TARGETS = ['latency', 'DSP', 'BRAM18K', 'URAM']
+# The minimal number of samples to fit the model of a target.
+MIN_SAMPLES = 8
+
+
+def point_estimates(point):
+  """Return the analytic estimates of the design point "point".
+
+  The design points rescored by an earlier cost model keep their analytic
+  estimates under "analytic".
+  """
+  est = dict((k, point.get(k)) for k in TARGETS)
+  est.update(point.get('analytic', {}))
+  return est
+
+
+def point_features(point):
+  """Return the features of the design point "point"."""
+  est = point_estimates(point)
+  dims = list(point.get('sa_dims', []))[:3]
+  dims += [0] * (3 - len(dims))
+  return [point['n_pe'], point['simd'], point['latency_hide_len']] + dims + \
+         [max(dims + [1]), math.log(max(est['latency'], 1)), est['DSP'],
+          est['BRAM18K'], est['URAM'],
+          math.log(max(point.get('DRAM_bytes', 1), 1))]
+
+
+def load_samples(paths):
+  """Return the features, the analytic estimates and the measurements of
+  the synthesized design points in the databases "paths".
+  """
+  samples = []
+  for path in paths:
+    conn = sqlite3.connect(path, timeout=300)
+    rows = conn.execute('SELECT features, hls_latency, hls_resource FROM '
+                        'results WHERE status = "ok" AND hls_latency IS NOT '
+                        'NULL AND features IS NOT NULL').fetchall()
+    conn.close()
+    for features, hls_latency, hls_resource in rows:
+      point = json.loads(features)
+      meas = dict(json.loads(hls_resource or '{}'))
+      meas['latency'] = hls_latency
+      try:
+        samples.append((point_features(point), point_estimates(point), meas))
+      except (KeyError, TypeError):
+        continue
+  return samples
+
+
+def export_tree(tree):
+  """Return the regression tree "tree" of scikit-learn in the format of
+  the compiler.
+
+  A node is a leaf if its left child is negative.
+  """
+  t = tree.tree_
+  return {'feature': [max(int(f), 0) for f in t.feature],
+          'threshold': [float(x) for x in t.threshold],
+          'left': [int(c) for c in t.children_left],
+          'right': [int(c) for c in t.children_right],
+          'value': [float(v[0][0]) for v in t.value]}
+
+
+def fit_target(samples, target, args):
+  """Fit the trees of the target "target" on "samples".
+
+  Return the model of the target, or None if there are too few samples.
+  """
+  X, y = [], []
+  for f, est, meas in samples:
+    if not est.get(target) or not meas.get(target):
+      continue
+    X.append(f)
+    y.append(math.log(float(meas[target]) / est[target]))
+  if len(y) < MIN_SAMPLES:
+    print('[AutoSA] Warning: Only %d samples of the %s, the analytic '
+          'estimate is kept.' % (len(y), target))
+    return None
+
+  base = sum(y) / len(y)
+  model = GradientBoostingRegressor(n_estimators=args.trees,
+                                    max_depth=args.depth,
+                                    learning_rate=args.learning_rate,
+                                    init='zero')
+  model.fit(X, [v - base for v in y])
+  pred = model.predict(X)
+  err = [abs(math.exp(base + p) / math.exp(v) - 1) for p, v in zip(pred, y)]
+  err0 = [abs(math.exp(base) / math.exp(v) - 1) for v in y]
+  print('[AutoSA] %s: %d samples, mean relative error %.3f (%.3f without '
+        'the trees).' % (target, len(y), sum(err) / len(err),
+                         sum(err0) / len(err0)))
+  return {'base': base, 'learning_rate': args.learning_rate,
+          'trees': [export_tree(t[0]) for t in model.estimators_]}
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description='Training of the learned cost model of AutoSA')
+  parser.add_argument('--db', action='append', required=True,
+                      help='result database of explore_cluster.py, may be '
+                      'repeated')
+  parser.add_argument('-o', '--output', default='autosa_config/cost_model.json',
+                      help='cost model file')
+  parser.add_argument('--trees', type=int, default=100,
+                      help='number of trees per target')
+  parser.add_argument('--depth', type=int, default=3,
+                      help='maximal depth of the trees')
+  parser.add_argument('--learning-rate', type=float, default=0.1,
+                      help='learning rate of the boosting')
+  args = parser.parse_args()
+
+  samples = load_samples(args.db)
+  print('[AutoSA] %d synthesized design points.' % len(samples))
+  targets = {}
+  for target in TARGETS:
+    model = fit_target(samples, target, args)
+    if model:
+      targets[target] = model
+  if not targets:
+    print('[AutoSA] Error: Too few synthesized design points to train the '
+          'cost model.')
+    sys.exit(1)
+  with open(args.output, 'w') as f:
+    json.dump({'features': FEATURES, 'n_samples': len(samples),
+               'targets': targets}, f, indent=2)
+  print('[AutoSA] Cost model is written to %s' % args.output)
+
+
+if __name__ == "__main__":
+  main()
@@ -24,13 +24,30 @@ int main(int argc, char **argv) {
     }
 #pragma endscop
 
-  for (int i = 0; i < I; i++)
-    for (int j = 0; j < J; j++) {
-      C_golden[i][j] = 0;
-      for (int k = 0; k < K; k++) {
-        C_golden[i][j] = C_golden[i][j] + A[i][k] * B[j][k];
-      }
+  /* The golden reference dominates the host time at this problem size.
+   * It is a hand-tiled copy of the loop nest above (not AutoSA's CPU code)
+   * and runs after the FPGA kernel. Tile it for the cache and spread the
+   * row tiles over the host cores.
+   * The k tiles are visited in order so that every C_golden[i][j] is
+   * accumulated in the same order as in the naive loop nest. */
+#pragma omp parallel for
+  for (int it = 0; it < I; it += GOLDEN_TILE_I) {
+    int i_end = (it + GOLDEN_TILE_I < I) ? it + GOLDEN_TILE_I : I;
+    for (int i = it; i < i_end; i++)
+      for (int j = 0; j < J; j++)
+        C_golden[i][j] = 0;
+    for (int kt = 0; kt < K; kt += GOLDEN_TILE_K) {
+      int k_end = (kt + GOLDEN_TILE_K < K) ? kt + GOLDEN_TILE_K : K;
+      for (int i = it; i < i_end; i++)
+        for (int j = 0; j < J; j++) {
+          data_t sum = C_golden[i][j];
+          for (int k = kt; k < k_end; k++) {
+            sum = sum + A[i][k] * B[j][k];
+          }
+          C_golden[i][j] = sum;
+        }
     }
+  }
 
   int err = 0;
   for (int i = 0; i < I; i++)
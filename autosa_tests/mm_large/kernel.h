@@ -7,3 +7,7 @@ typedef float data_t;
 #define J 1024
 //#define J 1152
 #define K 1024
+
+/* Tile sizes of the host golden reference */
+#define GOLDEN_TILE_I 16
+#define GOLDEN_TILE_K 256
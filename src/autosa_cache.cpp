@@ -0,0 +1,663 @@
+/* Defines functions for the persistent compilation cache in AutoSA.
+ *
+ * The dependence analysis of a scop only depends on the polyhedral model
+ * extracted by pet and a few options. The results are stored under the
+ * cache directory in a JSON file named after the hash of these inputs,
+ * so that later runs on the same program, e.g., with different "--sa-sizes",
+ * can skip the dependence analysis.
+ * The computed schedule is stored next to them, in a file that is also
+ * named after the scheduling options, so that these runs can skip
+ * the scheduling as well.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include <isl/ctx.h>
+#include <isl/id.h>
+#include <isl/space.h>
+#include <isl/set.h>
+#include <isl/map.h>
+#include <isl/union_set.h>
+#include <isl/union_map.h>
+#include <isl/options.h>
+#include <isl/schedule.h>
+#include <isl/schedule_node.h>
+#include <cJSON/cJSON.h>
+
+#include "autosa_cache.h"
+
+#define AUTOSA_CACHE_VERSION "1"
+
+/* The per-scop dependence information stored in the cache.
+ * The fields are filled in by compute_dependences and eliminate_dead_code.
+ * Some of them may be NULL, depending on the options.
+ */
+static const char *cache_dep_names[] = {
+    "live_in", "live_out", "tagged_dep_flow", "dep_flow", "dep_false",
+    "dep_forced", "tagged_dep_order", "dep_order", "tagged_dep_rar",
+    "dep_rar", "tagged_dep_waw", "dep_waw"};
+
+#define N_CACHE_DEPS (sizeof(cache_dep_names) / sizeof(cache_dep_names[0]))
+
+static void cache_dep_fields(struct ppcg_scop *ps,
+                             isl_union_map **fields[N_CACHE_DEPS])
+{
+  fields[0] = &ps->live_in;
+  fields[1] = &ps->live_out;
+  fields[2] = &ps->tagged_dep_flow;
+  fields[3] = &ps->dep_flow;
+  fields[4] = &ps->dep_false;
+  fields[5] = &ps->dep_forced;
+  fields[6] = &ps->tagged_dep_order;
+  fields[7] = &ps->dep_order;
+  fields[8] = &ps->tagged_dep_rar;
+  fields[9] = &ps->dep_rar;
+  fields[10] = &ps->tagged_dep_waw;
+  fields[11] = &ps->dep_waw;
+}
+
+/* Update the 64-bit FNV-1a hash "h" with the string "str".
+ */
+static unsigned long long cache_hash_str(unsigned long long h,
+                                         const char *str)
+{
+  if (!str)
+    str = "(null)";
+  for (; *str; str++)
+  {
+    h ^= (unsigned char)*str;
+    h *= 1099511628211ULL;
+  }
+  h ^= 0xff;
+  h *= 1099511628211ULL;
+
+  return h;
+}
+
+static unsigned long long cache_hash_umap(unsigned long long h,
+                                          __isl_keep isl_union_map *umap)
+{
+  char *str = isl_union_map_to_str(umap);
+  h = cache_hash_str(h, str);
+  free(str);
+
+  return h;
+}
+
+/* Compute the cache key of "ps".
+ * The key is the hash of the textual representation of the polyhedral
+ * model of the scop before the dependence analysis, together with
+ * the options that have an effect on the dependence analysis.
+ * Return NULL if the cache is disabled.
+ */
+char *autosa_cache_key(struct ppcg_scop *ps)
+{
+  struct ppcg_options *options = ps->options;
+  unsigned long long h = 14695981039346656037ULL;
+  char buf[64];
+  char *str;
+
+  if (!options->autosa->cache_dir)
+    return NULL;
+
+  h = cache_hash_str(h, AUTOSA_CACHE_VERSION);
+  sprintf(buf, "%d,%d,%d,%d,%d", options->live_range_reordering,
+          options->target, options->autosa->autosa,
+          options->non_negative_parameters,
+          options->autosa->irregular_cache != NULL);
+  h = cache_hash_str(h, buf);
+  h = cache_hash_str(h, options->ctx);
+
+  str = isl_set_to_str(ps->context);
+  h = cache_hash_str(h, str);
+  free(str);
+  str = isl_union_set_to_str(ps->domain);
+  h = cache_hash_str(h, str);
+  free(str);
+  str = isl_union_set_to_str(ps->call);
+  h = cache_hash_str(h, str);
+  free(str);
+  str = isl_schedule_to_str(ps->schedule);
+  h = cache_hash_str(h, str);
+  free(str);
+  h = cache_hash_umap(h, ps->tagged_reads);
+  h = cache_hash_umap(h, ps->tagged_may_writes);
+  h = cache_hash_umap(h, ps->tagged_must_writes);
+  h = cache_hash_umap(h, ps->tagged_must_kills);
+  h = cache_hash_umap(h, ps->independence);
+
+  sprintf(buf, "%016llx", h);
+
+  return strdup(buf);
+}
+
+static std::string cache_file_name(struct ppcg_scop *ps)
+{
+  std::string name = ps->options->autosa->cache_dir;
+
+  return name + "/" + ps->cache_key + ".deps.json";
+}
+
+/* Data used to rebind the identifiers of the objects read back from
+ * the cache.
+ * Parameters and arrays are identified by pet using identifiers that
+ * carry a pointer to their declarations. These pointers are lost in the
+ * textual representation and are restored from "context" and "pet" by name.
+ */
+struct cache_rebind_data
+{
+  isl_set *context;
+  struct pet_scop *pet;
+  isl_union_map *res;
+};
+
+static __isl_give isl_id *cache_find_array_id(struct pet_scop *pet,
+                                              const char *name)
+{
+  for (int i = 0; i < pet->n_array; i++)
+  {
+    isl_set *extent = pet->arrays[i]->extent;
+    const char *array_name = isl_set_get_tuple_name(extent);
+    if (array_name && !strcmp(array_name, name))
+      return isl_set_get_tuple_id(extent);
+  }
+
+  return NULL;
+}
+
+static __isl_give isl_map *cache_rebind_map(__isl_take isl_map *map,
+                                            struct cache_rebind_data *data)
+{
+  isl_size n = isl_map_dim(map, isl_dim_param);
+
+  for (int i = 0; i < n; i++)
+  {
+    const char *name = isl_map_get_dim_name(map, isl_dim_param, i);
+    int pos = isl_set_find_dim_by_name(data->context, isl_dim_param, name);
+    if (pos < 0)
+      continue;
+    map = isl_map_set_dim_id(map, isl_dim_param, i,
+                             isl_set_get_dim_id(data->context,
+                                                isl_dim_param, pos));
+  }
+
+  if (isl_map_has_tuple_name(map, isl_dim_out) == isl_bool_true)
+  {
+    const char *name = isl_map_get_tuple_name(map, isl_dim_out);
+    isl_id *id = cache_find_array_id(data->pet, name);
+    if (id)
+      map = isl_map_set_tuple_id(map, isl_dim_out, id);
+  }
+
+  return map;
+}
+
+static isl_stat cache_rebind_map_wrap(__isl_take isl_map *map, void *user)
+{
+  struct cache_rebind_data *data = (struct cache_rebind_data *)user;
+
+  map = cache_rebind_map(map, data);
+  data->res = isl_union_map_union(data->res, isl_union_map_from_map(map));
+
+  return isl_stat_ok;
+}
+
+/* Rebind the identifiers of "umap" to those of "ps".
+ */
+static __isl_give isl_union_map *cache_rebind_union_map(struct ppcg_scop *ps,
+                                                        __isl_take isl_union_map *umap)
+{
+  struct cache_rebind_data data;
+
+  if (!umap)
+    return NULL;
+
+  data.context = ps->context;
+  data.pet = ps->pet;
+  data.res = isl_union_map_empty(isl_set_get_space(ps->context));
+  if (isl_union_map_foreach_map(umap, &cache_rebind_map_wrap, &data) < 0)
+    data.res = isl_union_map_free(data.res);
+  isl_union_map_free(umap);
+
+  return data.res;
+}
+
+static __isl_give isl_union_map *cache_read_union_map(struct ppcg_scop *ps,
+                                                      const char *str)
+{
+  isl_ctx *ctx = isl_set_get_ctx(ps->context);
+
+  return cache_rebind_union_map(ps, isl_union_map_read_from_str(ctx, str));
+}
+
+/* Rebind the parameters of "uset" to those of "ps".
+ * The sets are rebound through their identity maps.
+ */
+static __isl_give isl_union_set *cache_rebind_union_set(struct ppcg_scop *ps,
+                                                        __isl_take isl_union_set *uset)
+{
+  isl_union_map *umap;
+
+  umap = cache_rebind_union_map(ps, isl_union_set_identity(uset));
+
+  return isl_union_map_domain(umap);
+}
+
+/* Read a union set from "str" and rebind its parameters to those of "ps".
+ */
+static __isl_give isl_union_set *cache_read_union_set(struct ppcg_scop *ps,
+                                                      const char *str)
+{
+  isl_ctx *ctx = isl_set_get_ctx(ps->context);
+
+  return cache_rebind_union_set(ps, isl_union_set_read_from_str(ctx, str));
+}
+
+/* Try to restore the results of the dependence analysis of "ps"
+ * from the cache.
+ * On success, the statement domain and the schedule are restricted
+ * to the live statement instances, as done by eliminate_dead_code.
+ * Return 1 if the cached information is found and 0 otherwise.
+ */
+int autosa_cache_load_deps(struct ppcg_scop *ps)
+{
+  FILE *f;
+  char *buffer = NULL;
+  long length;
+  cJSON *cache, *item;
+  isl_union_map **fields[N_CACHE_DEPS];
+  isl_union_map *deps[N_CACHE_DEPS];
+  isl_union_set *domain;
+  int ok = 1;
+
+  ps->cache_key = autosa_cache_key(ps);
+  if (!ps->cache_key)
+    return 0;
+
+  std::string file_name = cache_file_name(ps);
+  f = fopen(file_name.c_str(), "rb");
+  if (!f)
+    return 0;
+  fseek(f, 0, SEEK_END);
+  length = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  buffer = (char *)malloc(length + 1);
+  if (buffer)
+  {
+    buffer[length] = '\0';
+    if (fread(buffer, 1, length, f) != (size_t)length)
+    {
+      free(buffer);
+      buffer = NULL;
+    }
+  }
+  fclose(f);
+  if (!buffer)
+    return 0;
+
+  cache = cJSON_Parse(buffer);
+  free(buffer);
+  if (!cache)
+    return 0;
+
+  item = cJSON_GetObjectItemCaseSensitive(cache, "version");
+  if (!cJSON_IsString(item) || strcmp(item->valuestring, AUTOSA_CACHE_VERSION))
+  {
+    cJSON_Delete(cache);
+    return 0;
+  }
+
+  for (int i = 0; i < N_CACHE_DEPS; i++)
+  {
+    deps[i] = NULL;
+    item = cJSON_GetObjectItemCaseSensitive(cache, cache_dep_names[i]);
+    if (!cJSON_IsString(item))
+      continue;
+    deps[i] = cache_read_union_map(ps, item->valuestring);
+    if (!deps[i])
+      ok = 0;
+  }
+  item = cJSON_GetObjectItemCaseSensitive(cache, "domain");
+  domain = cJSON_IsString(item) ? cache_read_union_set(ps, item->valuestring)
+                                : NULL;
+  if (!domain)
+    ok = 0;
+  cJSON_Delete(cache);
+
+  if (!ok)
+  {
+    printf("[AutoSA] Warning: Invalid cache file: %s\n", file_name.c_str());
+    for (int i = 0; i < N_CACHE_DEPS; i++)
+      isl_union_map_free(deps[i]);
+    isl_union_set_free(domain);
+    return 0;
+  }
+
+  cache_dep_fields(ps, fields);
+  for (int i = 0; i < N_CACHE_DEPS; i++)
+  {
+    isl_union_map_free(*fields[i]);
+    *fields[i] = deps[i];
+  }
+  ps->domain = isl_union_set_free(ps->domain);
+  ps->domain = domain;
+  ps->schedule = isl_schedule_intersect_domain(ps->schedule,
+                                               isl_union_set_copy(domain));
+
+  if (ps->options->autosa->verbose)
+    printf("[AutoSA] Dependences are loaded from the cache: %s\n",
+           file_name.c_str());
+
+  return 1;
+}
+
+/* Store the results of the dependence analysis of "ps" in the cache.
+ */
+void autosa_cache_save_deps(struct ppcg_scop *ps)
+{
+  FILE *f;
+  cJSON *cache;
+  char *content, *str;
+  isl_union_map **fields[N_CACHE_DEPS];
+
+  if (!ps->cache_key)
+    return;
+
+  cache = cJSON_CreateObject();
+  cJSON_AddItemToObject(cache, "version",
+                        cJSON_CreateString(AUTOSA_CACHE_VERSION));
+  str = isl_union_set_to_str(ps->domain);
+  cJSON_AddItemToObject(cache, "domain", cJSON_CreateString(str));
+  free(str);
+  cache_dep_fields(ps, fields);
+  for (int i = 0; i < N_CACHE_DEPS; i++)
+  {
+    if (!*fields[i])
+      continue;
+    str = isl_union_map_to_str(*fields[i]);
+    cJSON_AddItemToObject(cache, cache_dep_names[i], cJSON_CreateString(str));
+    free(str);
+  }
+
+  std::string file_name = cache_file_name(ps);
+  f = fopen(file_name.c_str(), "w");
+  if (!f)
+  {
+    printf("[AutoSA] Warning: Can't write cache file: %s\n",
+           file_name.c_str());
+    cJSON_Delete(cache);
+    return;
+  }
+  content = cJSON_Print(cache);
+  fprintf(f, "%s", content);
+  fclose(f);
+  free(content);
+  cJSON_Delete(cache);
+}
+
+/* Return the name of the cache file of the schedule of "ps".
+ * Besides the polyhedral model and the dependences, which are identified
+ * by the cache key, the schedule depends on the scheduling options of
+ * PPCG and of isl, which are hashed into the name.
+ */
+static std::string cache_schedule_file_name(struct ppcg_scop *ps)
+{
+  struct ppcg_options *options = ps->options;
+  isl_ctx *ctx = isl_set_get_ctx(ps->context);
+  std::string name = options->autosa->cache_dir;
+  unsigned long long h = 14695981039346656037ULL;
+  char buf[256];
+
+  sprintf(buf, "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d",
+          options->reschedule, options->group_chains,
+          isl_options_get_schedule_max_coefficient(ctx),
+          isl_options_get_schedule_max_constant_term(ctx),
+          isl_options_get_schedule_maximize_band_depth(ctx),
+          isl_options_get_schedule_maximize_coincidence(ctx),
+          isl_options_get_schedule_outer_coincidence(ctx),
+          isl_options_get_schedule_split_scaled(ctx),
+          isl_options_get_schedule_treat_coalescing(ctx),
+          isl_options_get_schedule_separate_components(ctx),
+          isl_options_get_schedule_serialize_sccs(ctx),
+          isl_options_get_schedule_whole_component(ctx),
+          isl_options_get_schedule_carry_self_first(ctx),
+          isl_options_get_schedule_algorithm(ctx));
+  h = cache_hash_str(h, buf);
+  sprintf(buf, "%016llx", h);
+
+  return name + "/" + ps->cache_key + ".schedule." + buf + ".json";
+}
+
+/* Insert the band node "node" of a cached schedule on top of "schedule",
+ * the rebuilt subtree of "node", restoring the permutability and
+ * the coincidence of its members.
+ */
+static __isl_give isl_schedule *cache_rebuild_band(struct ppcg_scop *ps,
+                                                   __isl_keep isl_schedule_node *node,
+                                                   __isl_take isl_schedule *schedule)
+{
+  isl_schedule_node *child;
+  isl_multi_union_pw_aff *mupa;
+  isl_union_map *umap;
+  isl_size n;
+
+  n = isl_schedule_node_band_n_member(node);
+  if (!schedule || n <= 0)
+    return schedule;
+
+  mupa = isl_schedule_node_band_get_partial_schedule(node);
+  umap = isl_union_map_from_multi_union_pw_aff(mupa);
+  umap = cache_rebind_union_map(ps, umap);
+  mupa = isl_multi_union_pw_aff_from_union_map(umap);
+  schedule = isl_schedule_insert_partial_schedule(schedule, mupa);
+
+  child = isl_schedule_get_root(schedule);
+  isl_schedule_free(schedule);
+  child = isl_schedule_node_child(child, 0);
+  child = isl_schedule_node_band_set_permutable(
+      child, isl_schedule_node_band_get_permutable(node));
+  for (int i = 0; i < n; i++)
+    child = isl_schedule_node_band_member_set_coincident(
+        child, i, isl_schedule_node_band_member_get_coincident(node, i));
+  schedule = isl_schedule_node_get_schedule(child);
+  isl_schedule_node_free(child);
+
+  return schedule;
+}
+
+/* Rebuild the subtree at "node" of a cached schedule on the statement
+ * instances "domain", with the identifiers rebound to those of "ps".
+ * The schedule is rebuilt rather than read back as such, since
+ * the identifiers of the parameters can't be replaced in place.
+ * Only the node types produced by the scheduler are supported.
+ * Return NULL on other node types.
+ */
+static __isl_give isl_schedule *cache_rebuild_schedule(struct ppcg_scop *ps,
+                                                       __isl_keep isl_schedule_node *node,
+                                                       __isl_take isl_union_set *domain)
+{
+  enum isl_schedule_node_type type;
+  isl_schedule *schedule = NULL;
+  isl_size n;
+
+  type = isl_schedule_node_get_type(node);
+  if (type == isl_schedule_node_leaf)
+    return isl_schedule_from_domain(domain);
+  if (type == isl_schedule_node_band)
+  {
+    isl_schedule_node *child = isl_schedule_node_get_child(node, 0);
+    schedule = cache_rebuild_schedule(ps, child, domain);
+    isl_schedule_node_free(child);
+    return cache_rebuild_band(ps, node, schedule);
+  }
+  if (type != isl_schedule_node_sequence && type != isl_schedule_node_set)
+  {
+    isl_union_set_free(domain);
+    return NULL;
+  }
+
+  n = isl_schedule_node_n_children(node);
+  for (int i = 0; i < n; i++)
+  {
+    isl_schedule_node *child, *grandchild;
+    isl_union_set *filter;
+    isl_schedule *part;
+
+    child = isl_schedule_node_get_child(node, i);
+    filter = cache_rebind_union_set(ps,
+                                    isl_schedule_node_filter_get_filter(child));
+    filter = isl_union_set_intersect(filter, isl_union_set_copy(domain));
+    grandchild = isl_schedule_node_get_child(child, 0);
+    part = cache_rebuild_schedule(ps, grandchild, filter);
+    isl_schedule_node_free(grandchild);
+    isl_schedule_node_free(child);
+    if (!part)
+    {
+      isl_schedule_free(schedule);
+      schedule = NULL;
+      break;
+    }
+    if (i == 0)
+      schedule = part;
+    else if (type == isl_schedule_node_sequence)
+      schedule = isl_schedule_sequence(schedule, part);
+    else
+      schedule = isl_schedule_set(schedule, part);
+  }
+  isl_union_set_free(domain);
+
+  return schedule;
+}
+
+/* Try to restore the schedule of "ps" from the cache.
+ * The cached schedule is only used if it covers exactly the statement
+ * instances of "ps".
+ * Return NULL if no usable schedule is found.
+ */
+__isl_give isl_schedule *autosa_cache_load_schedule(struct ppcg_scop *ps)
+{
+  FILE *f;
+  char *buffer;
+  long length;
+  cJSON *cache, *item;
+  isl_schedule *cached, *schedule = NULL;
+  isl_schedule_node *root;
+  isl_union_set *domain;
+  isl_bool equal;
+
+  if (!ps->cache_key)
+    return NULL;
+
+  std::string file_name = cache_schedule_file_name(ps);
+  f = fopen(file_name.c_str(), "rb");
+  if (!f)
+    return NULL;
+  fseek(f, 0, SEEK_END);
+  length = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  buffer = (char *)malloc(length + 1);
+  if (buffer)
+  {
+    buffer[length] = '\0';
+    if (fread(buffer, 1, length, f) != (size_t)length)
+    {
+      free(buffer);
+      buffer = NULL;
+    }
+  }
+  fclose(f);
+  if (!buffer)
+    return NULL;
+
+  cache = cJSON_Parse(buffer);
+  free(buffer);
+  if (!cache)
+    return NULL;
+
+  item = cJSON_GetObjectItemCaseSensitive(cache, "version");
+  if (!cJSON_IsString(item) || strcmp(item->valuestring, AUTOSA_CACHE_VERSION))
+  {
+    cJSON_Delete(cache);
+    return NULL;
+  }
+  item = cJSON_GetObjectItemCaseSensitive(cache, "schedule");
+  cached = cJSON_IsString(item)
+               ? isl_schedule_read_from_str(isl_set_get_ctx(ps->context),
+                                            item->valuestring)
+               : NULL;
+  cJSON_Delete(cache);
+
+  if (cached)
+  {
+    root = isl_schedule_get_root(cached);
+    if (isl_schedule_node_get_type(root) == isl_schedule_node_domain)
+    {
+      isl_schedule_node *child;
+
+      domain = cache_rebind_union_set(ps,
+                                      isl_schedule_node_domain_get_domain(root));
+      child = isl_schedule_node_get_child(root, 0);
+      schedule = cache_rebuild_schedule(ps, child, domain);
+      isl_schedule_node_free(child);
+    }
+    isl_schedule_node_free(root);
+    isl_schedule_free(cached);
+  }
+  if (schedule)
+  {
+    domain = isl_schedule_get_domain(schedule);
+    equal = isl_union_set_is_equal(domain, ps->domain);
+    isl_union_set_free(domain);
+    if (equal != isl_bool_true)
+      schedule = isl_schedule_free(schedule);
+  }
+  if (!schedule)
+  {
+    printf("[AutoSA] Warning: Invalid cache file: %s\n", file_name.c_str());
+    return NULL;
+  }
+
+  if (ps->options->autosa->verbose)
+    printf("[AutoSA] Schedule is loaded from the cache: %s\n",
+           file_name.c_str());
+
+  return schedule;
+}
+
+/* Store the schedule "schedule" of "ps" in the cache.
+ */
+void autosa_cache_save_schedule(struct ppcg_scop *ps,
+                                __isl_keep isl_schedule *schedule)
+{
+  FILE *f;
+  cJSON *cache;
+  char *content, *str;
+
+  if (!ps->cache_key || !schedule)
+    return;
+
+  cache = cJSON_CreateObject();
+  cJSON_AddItemToObject(cache, "version",
+                        cJSON_CreateString(AUTOSA_CACHE_VERSION));
+  str = isl_schedule_to_str(schedule);
+  cJSON_AddItemToObject(cache, "schedule", cJSON_CreateString(str));
+  free(str);
+
+  std::string file_name = cache_schedule_file_name(ps);
+  f = fopen(file_name.c_str(), "w");
+  if (!f)
+  {
+    printf("[AutoSA] Warning: Can't write cache file: %s\n",
+           file_name.c_str());
+    cJSON_Delete(cache);
+    return;
+  }
+  content = cJSON_Print(cache);
+  fprintf(f, "%s", content);
+  fclose(f);
+  free(content);
+  cJSON_Delete(cache);
+}
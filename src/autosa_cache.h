@@ -0,0 +1,24 @@
+#ifndef _AUTOSA_CACHE_H
+#define _AUTOSA_CACHE_H
+
+#include <pet.h>
+#include "ppcg_options.h"
+#include "ppcg.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	char *autosa_cache_key(struct ppcg_scop *ps);
+	int autosa_cache_load_deps(struct ppcg_scop *ps);
+	void autosa_cache_save_deps(struct ppcg_scop *ps);
+	__isl_give isl_schedule *autosa_cache_load_schedule(struct ppcg_scop *ps);
+	void autosa_cache_save_schedule(struct ppcg_scop *ps,
+									__isl_keep isl_schedule *schedule);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
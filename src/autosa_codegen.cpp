@@ -413,6 +413,7 @@ struct add_io_copies_stmt_acc_data
   int read;
   char *stmt_name;
   int insert_dependence;
+  int buf_n_lane;
 };
 
 /* Create an IO statement. 
@@ -489,6 +490,78 @@ static isl_bool is_acc_stride_one_at_node(
   return is_one;
 }
 
+/* Replace the last output dimension of "ma" by its value divided by
+ * "n_lane", i.e., by the index of the data packed by "n_lane".
+ */
+static __isl_give isl_multi_aff *pack_last_dim(__isl_take isl_multi_aff *ma,
+                                               int n_lane)
+{
+  int n;
+  isl_aff *aff;
+
+  n = isl_multi_aff_dim(ma, isl_dim_out);
+  if (n <= 0 || n_lane <= 1)
+    return ma;
+  aff = isl_multi_aff_get_aff(ma, n - 1);
+  aff = isl_aff_scale_down_ui(aff, n_lane);
+  aff = isl_aff_floor(aff);
+
+  return isl_multi_aff_set_aff(ma, n - 1, aff);
+}
+
+/* Examine if the I/O statement instances "domain" writing to a local buffer 
+ * packed by "buf_n_lane" carry no dependence on the buffer at the pipelined 
+ * loop, i.e., if no two instances with the same outer loop iterations and 
+ * different iterations of the innermost loop of "sched" access the same 
+ * buffer word.
+ * "from_access" maps the instances to the pairs of their prefix schedule 
+ * and the array elements they access. The buffer tile is assumed to be 
+ * aligned with the data packing, such that the buffer words are identified 
+ * by the array elements with the last dimension divided by "buf_n_lane".
+ */
+static isl_bool io_stmt_carries_no_dep(__isl_keep isl_union_set *domain,
+                                       __isl_take isl_multi_aff *sched, __isl_keep isl_multi_aff *from_access,
+                                       int buf_n_lane)
+{
+  isl_multi_aff *word;
+  isl_map *same, *pairs;
+  isl_set *set, *delta, *zero;
+  isl_bool no_dep;
+  int n;
+
+  if (isl_union_set_n_set(domain) != 1)
+  {
+    isl_multi_aff_free(sched);
+    return isl_bool_false;
+  }
+  set = isl_set_from_union_set(isl_union_set_copy(domain));
+  word = isl_multi_aff_range_factor_range(isl_multi_aff_copy(from_access));
+  word = pack_last_dim(word, buf_n_lane);
+  same = isl_map_from_multi_aff(word);
+  same = isl_map_intersect_domain(same, set);
+  same = isl_map_apply_range(isl_map_copy(same), isl_map_reverse(same));
+  pairs = isl_map_apply_domain(same,
+                               isl_map_from_multi_aff(isl_multi_aff_copy(sched)));
+  pairs = isl_map_apply_range(pairs, isl_map_from_multi_aff(sched));
+
+  /* Differences of the pairs at the same outer loop iterations. */
+  delta = isl_map_deltas(pairs);
+  n = isl_set_dim(delta, isl_dim_set);
+  if (n <= 0)
+  {
+    isl_set_free(delta);
+    return isl_bool_false;
+  }
+  for (int i = 0; i < n - 1; i++)
+    delta = isl_set_fix_si(delta, isl_dim_set, i, 0);
+  zero = isl_set_fix_si(isl_set_copy(delta), isl_dim_set, n - 1, 0);
+  no_dep = isl_set_is_subset(delta, zero);
+  isl_set_free(delta);
+  isl_set_free(zero);
+
+  return no_dep;
+}
+
 /* Insert the copy statement at the statement level.
  */
 static __isl_give isl_schedule_node *add_io_copies_stmt_acc_single(
@@ -545,6 +618,8 @@ static __isl_give isl_schedule_node *add_io_copies_stmt_acc_single(
   isl_id_free(id2);
   ctx = isl_schedule_node_get_ctx(node);
   is_simd = is_node_under_simd(node);
+  /* Transfer the data above the loops in which it is reused by the PE. */
+  node = autosa_tree_move_up_to_reuse_level(data->kernel, node, ref);
 
   access = io_comm_access_ref(data->kernel, node, group, ref, read);
   empty = isl_union_map_is_empty(access);
@@ -572,7 +647,9 @@ static __isl_give isl_schedule_node *add_io_copies_stmt_acc_single(
     if (stride_one)
     {
       /* Test if the loop bound/n_lane > 1. 
-       * If so, insert a hls_dep mark.
+       * If so, the loop is a candidate for a hls_dep mark, which is 
+       * inserted if the statement carries no dependence on the buffer 
+       * at the loop.
        * Only do this when there is a single access in the group.
        */
       int *ubs = NULL;
@@ -641,7 +718,23 @@ static __isl_give isl_schedule_node *add_io_copies_stmt_acc_single(
     domain = isl_union_set_from_set(isl_map_wrap(map));
   }
 
-  domain = isl_union_set_preimage_multi_aff(domain, from_access);
+  domain = isl_union_set_preimage_multi_aff(domain,
+                                            isl_multi_aff_copy(from_access));
+  if (insert_dependence)
+  {
+    isl_multi_aff *sched;
+
+    /* The statement is pipelined at the innermost loop above it, or at the 
+     * loop above the SIMD loop. */
+    sched = isl_multi_aff_range_factor_domain(isl_multi_aff_copy(from_access));
+    if (n_lane >= 1 && is_simd)
+      sched = isl_multi_aff_drop_dims(sched, isl_dim_out,
+                                      isl_multi_aff_dim(sched, isl_dim_out) - 1, 1);
+    if (io_stmt_carries_no_dep(domain, sched, from_access,
+                               data->buf_n_lane) != isl_bool_true)
+      insert_dependence = isl_bool_false;
+  }
+  isl_multi_aff_free(from_access);
   access = isl_union_set_wrapped_domain_map(domain);
   access = isl_union_map_reverse(access);
   access = isl_union_map_coalesce(access);
@@ -783,11 +876,12 @@ __isl_give isl_schedule_node *add_io_copies_stmt_acc(
     int read,
     __isl_take char *stmt_name,
     int before,
-    int insert_dependence)
+    int insert_dependence,
+    int buf_n_lane)
 {
   struct add_io_copies_stmt_acc_data data = {
       kernel, group, NULL, tile, n_lane, read, stmt_name,
-      insert_dependence && group->n_ref == 1};
+      insert_dependence && group->n_ref == 1, buf_n_lane};
 
   for (int i = 0; i < group->n_ref; i++)
   {
@@ -801,8 +895,9 @@ __isl_give isl_schedule_node *add_io_copies_stmt_acc(
 }
 
 /* Insert the copy statement at the node level to transfer the entire tie.
- * If "is_buffer" is set, add a marker for dependence false. This is
- * only for Xilinx platform.
+ * If "is_buffer" and "insert_dependence" are set, add a marker for dependence 
+ * false if the statement carries no dependence on the local buffer packed by 
+ * "buf_n_lane" at the pipelined loop. This is only for Xilinx platform.
  */
 static __isl_give isl_schedule_node *add_io_copies_stmt_tile(
     struct autosa_kernel *kernel,
@@ -815,7 +910,8 @@ static __isl_give isl_schedule_node *add_io_copies_stmt_tile(
     __isl_take char *stmt_name,
     int before, int is_buffer,
     /* If it is proper to insert hls_pipeline for Xilinx platforms. */
-    int insert_dependence)
+    int insert_dependence,
+    int buf_n_lane)
 {
   isl_union_map *access = NULL;
   int empty;
@@ -864,7 +960,23 @@ static __isl_give isl_schedule_node *add_io_copies_stmt_tile(
     domain = isl_union_set_from_set(isl_map_wrap(map));
   }
 
-  domain = isl_union_set_preimage_multi_aff(domain, from_access);
+  domain = isl_union_set_preimage_multi_aff(domain,
+                                            isl_multi_aff_copy(from_access));
+  if (is_buffer && !read && insert_dependence)
+  {
+    isl_multi_aff *sched;
+
+    /* The statement is pipelined at the last tile loop, which transfers 
+     * "n_lane" elements at a time. */
+    ma = isl_multi_aff_pullback_multi_aff(isl_multi_aff_copy(tile->tiling),
+                                          isl_multi_aff_copy(from_access));
+    sched = isl_multi_aff_range_factor_domain(isl_multi_aff_copy(from_access));
+    sched = isl_multi_aff_flat_range_product(sched, pack_last_dim(ma, n_lane));
+    if (io_stmt_carries_no_dep(domain, sched, from_access,
+                               buf_n_lane) != isl_bool_true)
+      insert_dependence = 0;
+  }
+  isl_multi_aff_free(from_access);
   access = isl_union_set_wrapped_domain_map(domain);
   access = isl_union_map_reverse(access);
   access = isl_union_map_coalesce(access);
@@ -921,12 +1033,8 @@ static __isl_give isl_schedule_node *add_io_copies_stmt_tile(
 
   if (is_buffer && !read && insert_dependence)
   {
-    // TODO: should not be inter_trans or intra_trans.
-    // TODO: only add this pragma for io_transfer statement which requires data packing.
     /* Insert a "dependence" mark. 
-     * This is not safe. Currently only insert the mark when there is at least 
-     * one level of coalesce loop (coalesce_bound > 1) and
-     * when data_pack does not equal to the nxt_data_pack. 
+     * The statement carries no dependence on the buffer at the pipelined loop.
      */
     char *mark_name;
     isl_printer *p_str = isl_printer_to_str(ctx);
@@ -1000,8 +1108,12 @@ static __isl_give isl_schedule *generate_io_module_inter_trans(
   io_ids = ppcg_scop_generate_names(gen->prog->scop, n_io_ids, "p");
   n_io_ids = 0;
 
-  assert(module->to_mem == 0);
   upper_io_level = io_level + 1;
+  /* The outermost module accesses the external memory. It doesn't filter
+   * the data and is split at the buffer instead of the upper I/O mark.
+   */
+  if (module->to_mem)
+    is_filter = 0;
 
   /* Update the context by adding the constraints for the io ids. */
   //  context = isl_set_universe(isl_set_get_space(kernel->context));
@@ -1046,7 +1158,7 @@ static __isl_give isl_schedule *generate_io_module_inter_trans(
       isl_union_set *uset;
 
       ids = isl_id_list_from_id(isl_id_list_get_id(io_ids, n_io_ids));
-      if (n_io_ids == space_dim - io_level)
+      if (n_io_ids == space_dim - io_level && is_filter)
       {
         uset = set_schedule_ge(node, ids);
       }
@@ -1118,8 +1230,20 @@ static __isl_give isl_schedule *generate_io_module_inter_trans(
   /* Move the schedule node to the level of the buffer since the 
    * buffer may have been hoisted. 
    */
-  node = autosa_tree_move_down_to_io_mark(node, kernel->core, buf->level);
-  node = isl_schedule_node_child(node, 0);
+  if (module->to_mem)
+  {
+    /* Insert the "io_module.inter_trans" function mark at the buffer. */
+    node = autosa_tree_move_up_to_kernel(node);
+    node = autosa_tree_move_down_to_depth(node, buf->tile->depth, kernel->core);
+    id = isl_id_alloc(ctx, "io_module.inter_trans", NULL);
+    node = isl_schedule_node_insert_mark(node, id);
+    node = isl_schedule_node_child(node, 0);
+  }
+  else
+  {
+    node = autosa_tree_move_down_to_io_mark(node, kernel->core, buf->level);
+    node = isl_schedule_node_child(node, 0);
+  }
   if (!buf->tile)
   {
     /* Add the I/O statement for each array reference in the group. */
@@ -1131,7 +1255,8 @@ static __isl_give isl_schedule *generate_io_module_inter_trans(
     isl_printer_free(p);
     node = add_io_copies_stmt_acc(kernel, group, node,
                                   buf->tile, buf->n_lane, read, stmt_name, read ? 1 : 0,
-                                  is_buffer && !read && 0 && kernel->options->autosa->insert_hls_dependence);
+                                  is_buffer && !read && 0 && kernel->options->autosa->insert_hls_dependence,
+                                  buf->n_lane);
   }
   else
   {
@@ -1164,7 +1289,8 @@ static __isl_give isl_schedule *generate_io_module_inter_trans(
     node = add_io_copies_stmt_tile(kernel, group, node,
                                    buf->tile, buf->tile, buf->n_lane, read, stmt_name, read ? 1 : 0,
                                    is_buffer & 0,
-                                   coalesce_bound > 1 && 0 && kernel->options->autosa->insert_hls_dependence);
+                                   coalesce_bound > 1 && 0 && kernel->options->autosa->insert_hls_dependence,
+                                   buf->n_lane);
     node = isl_schedule_node_cut(node);
     /* Insert empty filter. */
     empty_filter = isl_union_set_from_set(isl_set_empty(
@@ -1176,11 +1302,14 @@ static __isl_give isl_schedule *generate_io_module_inter_trans(
   free(buf_suffix);
 
   /* Insert the "io_module.inter_trans" function mark. */
-  node = autosa_tree_move_up_to_kernel(node);
-  node = autosa_tree_move_down_to_io_mark(node, kernel->core, upper_io_level);
-  node = isl_schedule_node_child(node, 0);
-  id = isl_id_alloc(ctx, "io_module.inter_trans", NULL);
-  node = isl_schedule_node_insert_mark(node, id);
+  if (!module->to_mem)
+  {
+    node = autosa_tree_move_up_to_kernel(node);
+    node = autosa_tree_move_down_to_io_mark(node, kernel->core, upper_io_level);
+    node = isl_schedule_node_child(node, 0);
+    id = isl_id_alloc(ctx, "io_module.inter_trans", NULL);
+    node = isl_schedule_node_insert_mark(node, id);
+  }
 
   /* Compute the union of domains of all the array references in the group. */
   group_access = isl_union_map_empty(isl_map_get_space(group->access));
@@ -1263,7 +1392,6 @@ static __isl_give isl_schedule *generate_io_module_intra_trans(
   io_ids = ppcg_scop_generate_names(gen->prog->scop, n_io_ids, "p");
   n_io_ids = 0;
 
-  assert(module->to_mem == 0);
   upper_io_level = io_level + 1;
 
   //  /* Update the context. */
@@ -1295,10 +1423,13 @@ static __isl_give isl_schedule *generate_io_module_intra_trans(
   /* Add the filters.
    * All the space loops above the current io_level should equal to
    * the io_ids. 
+   * The outermost module has no upper I/O level, all the space loops
+   * including the current io_level should equal to the io_ids.
    */
   n_io_ids = 0;
   node = autosa_tree_move_down_to_array(node, kernel->core);
-  while (!isl_schedule_node_is_io_mark(node, upper_io_level))
+  while (!isl_schedule_node_is_io_mark(node,
+                                       module->to_mem ? io_level : upper_io_level))
   {
     if (isl_schedule_node_get_type(node) == isl_schedule_node_band)
     {
@@ -1336,22 +1467,6 @@ static __isl_give isl_schedule *generate_io_module_intra_trans(
   }
   node = autosa_tree_move_up_to_kernel(node);
 
-  /* Add a filter node. 
-   * The io_loop at the current io_level should equal to the io_id.
-   */
-  node = autosa_tree_move_down_to_io_mark(node, kernel->core, io_level);
-  ids = isl_id_list_from_id(isl_id_list_get_id(io_ids, space_dim - io_level));
-  node = isl_schedule_node_parent(node);
-  eq_filter = set_schedule_eq(node, ids);
-  node = isl_schedule_node_child(node, 0);
-  isl_id_list_free(ids);
-  node = isl_schedule_node_parent(node);
-  node = isl_schedule_node_insert_filter(node, eq_filter);
-  node = isl_schedule_node_child(node, 0);
-
-  /* Add the data transfer statements. */
-  init_suffix(module, group, &fifo_suffix, &buf_suffix);
-
   /* Locate the current buffer. */
   for (i = io_level; i >= 1; i--)
   {
@@ -1359,6 +1474,33 @@ static __isl_give isl_schedule *generate_io_module_intra_trans(
     if (buf->tile != NULL)
       break;
   }
+
+  if (module->to_mem)
+  {
+    /* Insert the "io_module.intra_trans" function mark at the buffer. */
+    node = autosa_tree_move_down_to_depth(node, buf->tile->depth, kernel->core);
+    id = isl_id_alloc(ctx, "io_module.intra_trans", NULL);
+    node = isl_schedule_node_insert_mark(node, id);
+    node = isl_schedule_node_child(node, 0);
+  }
+  else
+  {
+    /* Add a filter node. 
+     * The io_loop at the current io_level should equal to the io_id.
+     */
+    node = autosa_tree_move_down_to_io_mark(node, kernel->core, io_level);
+    ids = isl_id_list_from_id(isl_id_list_get_id(io_ids, space_dim - io_level));
+    node = isl_schedule_node_parent(node);
+    eq_filter = set_schedule_eq(node, ids);
+    node = isl_schedule_node_child(node, 0);
+    isl_id_list_free(ids);
+    node = isl_schedule_node_parent(node);
+    node = isl_schedule_node_insert_filter(node, eq_filter);
+    node = isl_schedule_node_child(node, 0);
+  }
+
+  /* Add the data transfer statements. */
+  init_suffix(module, group, &fifo_suffix, &buf_suffix);
   if (is_buffer)
   {
     if (i != io_level)
@@ -1403,12 +1545,10 @@ static __isl_give isl_schedule *generate_io_module_intra_trans(
     stmt_name = isl_printer_get_str(p);
     isl_printer_free(p);
     module->data_pack_intra = group->n_lane;
-    // TODO: Test if we could insert a hls dependence at the current loop.
-    // We weed to test if the access under the innermost loop is stride-1.
-    // If so, gather the loop bound and make sure the bound is greater than n_lane.
     node = add_io_copies_stmt_acc(kernel, group, node,
                                   cur_buf->tile, group->n_lane, read, stmt_name, read ? 1 : 0,
-                                  is_buffer && !read && cur_buf->n_lane != group->n_lane && kernel->options->autosa->insert_hls_dependence);
+                                  is_buffer && !read && kernel->options->autosa->insert_hls_dependence,
+                                  cur_buf->n_lane);
   }
   else
   {
@@ -1439,7 +1579,8 @@ static __isl_give isl_schedule *generate_io_module_intra_trans(
     node = add_io_copies_stmt_tile(kernel, group, node,
                                    cur_buf->tile, buf->tile, buf->n_lane,
                                    read, stmt_name, read ? 1 : 0, is_buffer & 0,
-                                   coalesce_bound > 1 && cur_buf->n_lane != buf->n_lane && kernel->options->autosa->insert_hls_dependence);
+                                   coalesce_bound > 1 && kernel->options->autosa->insert_hls_dependence,
+                                   cur_buf->n_lane);
     node = isl_schedule_node_cut(node);
     /* Insert empty filter. */
     empty_filter = isl_union_set_from_set(isl_set_empty(isl_set_get_space(kernel->context)));
@@ -1450,11 +1591,14 @@ static __isl_give isl_schedule *generate_io_module_intra_trans(
   free(buf_suffix);
 
   /* Insert the function mark. */
-  node = autosa_tree_move_up_to_kernel(node);
-  node = autosa_tree_move_down_to_io_mark(node, kernel->core, upper_io_level);
-  node = isl_schedule_node_child(node, 0);
-  id = isl_id_alloc(ctx, "io_module.intra_trans", NULL);
-  node = isl_schedule_node_insert_mark(node, id);
+  if (!module->to_mem)
+  {
+    node = autosa_tree_move_up_to_kernel(node);
+    node = autosa_tree_move_down_to_io_mark(node, kernel->core, upper_io_level);
+    node = isl_schedule_node_child(node, 0);
+    id = isl_id_alloc(ctx, "io_module.intra_trans", NULL);
+    node = isl_schedule_node_insert_mark(node, id);
+  }
 
   /* Compute the union of domains of all the array references in the group. */
   group_access = isl_union_map_empty(isl_map_get_space(group->access));
@@ -1511,6 +1655,7 @@ static void create_io_module_var(isl_ctx *ctx,
   var->type = autosa_array_ref_group_type(group);
   var->n_lane = n_lane;
   var->n_part = 1;
+  var->mem_type = -1;
 
   p = isl_printer_to_str(ctx);
   p = autosa_array_ref_group_print_name(group, p);
@@ -1590,7 +1735,6 @@ static __isl_give isl_schedule *generate_io_module_outer(
   io_ids = ppcg_scop_generate_names(gen->prog->scop, n_io_ids, "p");
   n_io_ids = 0;
 
-  assert(module->to_mem == 0);
   upper_io_level = io_level + 1;
 
   //  /* Update the context. */
@@ -1622,7 +1766,8 @@ static __isl_give isl_schedule *generate_io_module_outer(
   /* Add the filters. */
   n_io_ids = 0;
   node = autosa_tree_move_down_to_array(node, kernel->core);
-  while (!isl_schedule_node_is_io_mark(node, upper_io_level))
+  while (!isl_schedule_node_is_io_mark(node,
+                                       module->to_mem ? io_level : upper_io_level))
   {
     if (isl_schedule_node_get_type(node) == isl_schedule_node_band)
     {
@@ -1649,8 +1794,23 @@ static __isl_give isl_schedule *generate_io_module_outer(
   stmt_name4 = boundary == 0 ? "io_module.intra_inter" : "io_module.intra_inter.boundary";
   stmt_name5 = "io_module.state_handle";
 
-  node = autosa_tree_move_down_to_io_mark(node, kernel->core, upper_io_level);
-  node = isl_schedule_node_child(node, 0);
+  /* Locate the buffer. */
+  for (int i = io_level; i >= 1; i--)
+  {
+    buf = group->io_buffers[i - 1];
+    if (buf->tile != NULL)
+      break;
+  }
+  if (module->to_mem)
+  {
+    /* Split the outermost module at the buffer. */
+    node = autosa_tree_move_down_to_depth(node, buf->tile->depth, kernel->core);
+  }
+  else
+  {
+    node = autosa_tree_move_down_to_io_mark(node, kernel->core, upper_io_level);
+    node = isl_schedule_node_child(node, 0);
+  }
   node = isl_schedule_node_cut(node);
 
   space = isl_space_set_alloc(ctx, 0, 0);
@@ -1760,18 +1920,12 @@ static __isl_give isl_schedule *generate_io_module_outer(
     module->inst_ids = io_ids;
     module->kernel = kernel;
     module->is_buffer = 1;
-    module->is_filter = 1;
+    module->is_filter = module->to_mem ? 0 : 1;
     if (read)
       module->in = 1;
     else
       module->in = 0;
     /* Create IO module variables. */
-    for (int i = io_level; i >= 1; i--)
-    {
-      buf = group->io_buffers[i - 1];
-      if (buf->tile != NULL)
-        break;
-    }
     create_io_module_vars(module, kernel, buf->tile);
   }
   else
@@ -1782,6 +1936,43 @@ static __isl_give isl_schedule *generate_io_module_outer(
   return new_sched;
 }
 
+/* Insert the credit statement "io_module.credit" at the "array" mark
+ * of the I/O module schedule "sched", such that the module reading
+ * the array ("read" is set) waits for a credit before each array partition,
+ * and the module writing the array returns a credit after each array
+ * partition.
+ */
+static __isl_give isl_schedule *insert_io_module_credit(
+    __isl_take isl_schedule *sched, struct autosa_kernel *kernel, int read)
+{
+  isl_ctx *ctx;
+  isl_schedule_node *node, *graft;
+  isl_space *space;
+  isl_union_set *domain;
+
+  if (!sched)
+    return NULL;
+
+  ctx = isl_schedule_get_ctx(sched);
+  node = isl_schedule_get_root(sched);
+  isl_schedule_free(sched);
+  node = autosa_tree_move_down_to_array(node, kernel->core);
+
+  space = isl_space_set_alloc(ctx, 0, 0);
+  space = isl_space_set_tuple_name(space, isl_dim_set, "io_module.credit");
+  domain = isl_union_set_from_set(isl_set_universe(space));
+  graft = isl_schedule_node_from_domain(domain);
+  if (read)
+    node = isl_schedule_node_graft_before(node, graft);
+  else
+    node = isl_schedule_node_graft_after(node, graft);
+
+  sched = isl_schedule_node_get_schedule(node);
+  isl_schedule_node_free(node);
+
+  return sched;
+}
+
 /* We will generate five seperate schedules for this type of I/O module.
  * Schedule 1: Outer loops contains two marks for inter_transfer 
  *             and intra_transfer modules
@@ -1841,6 +2032,12 @@ static __isl_give struct autosa_hw_module *generate_filter_buffer_io_module(
     boundary_sched1 = generate_io_module_outer(sched, module, group, kernel, gen,
                                                io_level, space_dim, read, 1);
   }
+  if (module->credit)
+  {
+    sched1 = insert_io_module_credit(sched1, kernel, read);
+    if (is_filter)
+      boundary_sched1 = insert_io_module_credit(boundary_sched1, kernel, read);
+  }
 
   isl_schedule_free(sched);
 
@@ -2282,7 +2479,8 @@ static isl_stat generate_default_io_module_schedule(
     /* Add the I/O statement for each array reference in the group. */
     node = add_io_copies_stmt_acc(kernel, group, node,
                                   buf->tile, buf->n_lane, read, stmt_name, read ? 1 : 0,
-                                  is_buffer && !read && 0 && kernel->options->autosa->insert_hls_dependence);
+                                  is_buffer && !read && 0 && kernel->options->autosa->insert_hls_dependence,
+                                  buf->n_lane);
   }
   else
   {
@@ -2315,7 +2513,8 @@ static isl_stat generate_default_io_module_schedule(
     node = add_io_copies_stmt_tile(kernel, group, node,
                                    buf->tile, buf->tile, buf->n_lane, read,
                                    stmt_name, read ? 1 : 0, is_buffer,
-                                   coalesce_bound > 1 && 0 && kernel->options->autosa->insert_hls_dependence);
+                                   coalesce_bound > 1 && 0 && kernel->options->autosa->insert_hls_dependence,
+                                   buf->n_lane);
     if (!is_buffer)
     {
       node = isl_schedule_node_cut(node);
@@ -2369,7 +2568,8 @@ static isl_stat generate_default_io_module_schedule(
       module->data_pack_intra = group->n_lane;
       node = add_io_copies_stmt_acc(kernel, group, node, cur_buf->tile,
                                     group->n_lane, read, stmt_name, read ? 1 : 0,
-                                    is_buffer && !read && cur_buf->n_lane != group->n_lane && kernel->options->autosa->insert_hls_dependence);
+                                    is_buffer && !read && kernel->options->autosa->insert_hls_dependence,
+                                    cur_buf->n_lane);
     }
     else
     {
@@ -2399,7 +2599,8 @@ static isl_stat generate_default_io_module_schedule(
       module->data_pack_intra = buf->n_lane;
       node = add_io_copies_stmt_tile(kernel, group, node, cur_buf->tile,
                                      buf->tile, buf->n_lane, read, stmt_name, read ? 1 : 0, is_buffer,
-                                     coalesce_bound > 1 && cur_buf->n_lane != buf->n_lane && kernel->options->autosa->insert_hls_dependence);
+                                     coalesce_bound > 1 && kernel->options->autosa->insert_hls_dependence,
+                                     cur_buf->n_lane);
       node = isl_schedule_node_cut(node);
       empty_filter = isl_union_set_from_set(isl_set_empty(
           isl_set_get_space(kernel->context)));
@@ -2443,6 +2644,8 @@ static isl_stat generate_default_io_module_schedule(
 
   sched1 = isl_schedule_node_get_schedule(node);
   isl_schedule_node_free(node);
+  if (module->credit)
+    sched1 = insert_io_module_credit(sched1, kernel, read);
 
   if (!boundary)
   {
@@ -2525,6 +2728,17 @@ static __isl_give struct autosa_hw_module *generate_io_module_by_type(
     module = generate_filter_buffer_io_module(module, node, group, kernel,
                                               gen, io_level, space_dim, is_filter, is_buffer, read);
   }
+  else if (is_buffer && module->to_mem &&
+           gen->options->autosa->double_buffer &&
+           group->local_array->array_type == AUTOSA_EXT_ARRAY &&
+           group->io_buffers[io_level - 1]->tile)
+  {
+    /* Split the buffered outermost module into the inter_trans and
+     * intra_trans functions so that its buffer can be double-buffered.
+     */
+    module = generate_filter_buffer_io_module(module, node, group, kernel,
+                                              gen, io_level, space_dim, is_filter, is_buffer, read);
+  }
   else
   {
     module = generate_default_io_module(module, node, group, kernel,
@@ -2538,7 +2752,9 @@ static __isl_give struct autosa_hw_module *generate_io_module_by_type(
  * We will first examine if any flow dependence that is associated with the 
  * current group is carried by the array part loops. 
  * In that case, credit control should be added to force the dependece.
- * TODO: to be implemented.
+ * The depth of the credit control is the minimal distance of the carried
+ * dependences in array partitions, which can be lowered by the user
+ * through "kernel[0]->credit_<array>[depth]" in the "sa_sizes" option.
  * Next, we will generate the copy-in set and copy-out set of I/O modules for 
  * the I/O groups. At each I/O level, we generate one I/O module.
  * We apply the I/O module pruning by default here.
@@ -2578,15 +2794,42 @@ static __isl_give struct autosa_hw_module **sa_io_module_gen(
   node = autosa_tree_move_down_to_kernel(node);
 
   /* Test if the deps in this I/O group are carried by array part loops.
-   * If so, data hazards are possible, and we will set the credit as true
-   * so that we could enable credit control between read and write I/O modules to 
-   * prevent the data hazards. 
-   * TODO: This is not supported yet.
+   * If so, data hazards are possible, and we will enable credit control
+   * between read and write I/O modules to prevent the data hazards.
+   * The read module may run ahead of the write module by as many array
+   * partitions as the minimal distance of the carried deps.
    */
   if (gen->options->autosa->credit_control)
   {
-    if (is_flow_dep_carried_by_array_part_loops(group->io_schedule, group, kernel))
-      credit = 1;
+    credit = flow_dep_array_part_distance(group->io_schedule, group, kernel);
+    if (credit > 0)
+    {
+      isl_printer *p_str;
+      char *name;
+      int depth;
+
+      p_str = isl_printer_to_str(ctx);
+      p_str = isl_printer_print_str(p_str, "credit_");
+      p_str = isl_printer_print_str(p_str, group->array->name);
+      name = isl_printer_get_str(p_str);
+      isl_printer_free(p_str);
+      depth = read_credit_size(kernel, name);
+      free(name);
+      if (depth > credit)
+        printf("[AutoSA] Warning: The credit depth %d of array %s exceeds the dependence distance %d, %d is used instead.\n",
+               depth, group->array->name, credit, credit);
+      else if (depth == 0 || depth < -1)
+        printf("[AutoSA] Warning: Invalid credit depth %d of array %s, %d is used instead.\n",
+               depth, group->array->name, credit);
+      else if (depth > 0)
+        credit = depth;
+      printf("[AutoSA] Credit control of depth %d is enabled for array %s.\n",
+             credit, group->array->name);
+    }
+    else if (credit < 0)
+    {
+      credit = 0;
+    }
 
     //    if (group->local_array->array_type == AUTOSA_INT_ARRAY) {
     //      isl_bool carried = isl_bool_false;
@@ -2733,6 +2976,8 @@ static __isl_give struct autosa_hw_module **sa_io_module_gen(
             int mem_port_offset = group->mem_port_id;
             std::pair<int, int> ref_port_map(group_ref_offset + p, mem_port_offset + p);
             group->local_array->group_ref_mem_port_map.push_back(ref_port_map);
+            group->local_array->group_ref_bw_demand.push_back(
+                autosa_array_ref_group_bw_demand(kernel, group) / group->n_mem_ports);
           }
           group->local_array->n_io_group_refs += group->n_mem_ports;
         }
@@ -2821,6 +3066,8 @@ static __isl_give struct autosa_hw_module **sa_io_module_gen(
             int mem_port_offset = group->mem_port_id;
             std::pair<int, int> ref_port_map(group_ref_offset + p, mem_port_offset + p);
             group->local_array->group_ref_mem_port_map.push_back(ref_port_map);
+            group->local_array->group_ref_bw_demand.push_back(
+                autosa_array_ref_group_bw_demand(kernel, group) / group->n_mem_ports);
           }
           group->local_array->n_io_group_refs += group->n_mem_ports;
         }
@@ -2856,6 +3103,49 @@ static __isl_give isl_schedule_node *split_band(
   return node;
 }
 
+/* Return the number of PEs in the bounding box of the PE identifiers "grid"
+ * that don't execute any statement instance, i.e., the PEs of
+ * a non-rectangular (e.g., triangular) array outside the iteration domain.
+ * Return 0 if the number of PEs is not known at compile time.
+ */
+static int count_idle_pes(__isl_keep isl_set *grid)
+{
+  isl_set *active, *box;
+  isl_val *n_active, *n_box;
+  int n_idle = 0;
+
+  active = isl_set_copy(grid);
+  active = isl_set_project_out(active, isl_dim_param, 0,
+                               isl_set_dim(active, isl_dim_param));
+  box = isl_set_universe(isl_set_get_space(active));
+  for (int i = 0; i < isl_set_dim(active, isl_dim_set); i++)
+  {
+    isl_val *ub = isl_set_dim_max_val(isl_set_copy(active), i);
+
+    if (!isl_val_is_int(ub))
+    {
+      isl_val_free(ub);
+      box = isl_set_free(box);
+      break;
+    }
+    box = isl_set_lower_bound_si(box, isl_dim_set, i, 0);
+    box = isl_set_upper_bound_val(box, isl_dim_set, i, ub);
+  }
+  if (box)
+  {
+    n_active = isl_set_count_val(active);
+    n_box = isl_set_count_val(box);
+    if (isl_val_is_int(n_active) && isl_val_is_int(n_box))
+      n_idle = isl_val_get_num_si(n_box) - isl_val_get_num_si(n_active);
+    isl_val_free(n_active);
+    isl_val_free(n_box);
+  }
+  isl_set_free(active);
+  isl_set_free(box);
+
+  return n_idle;
+}
+
 /* Compute the effective sa size as a list of the sizes in each dimension.
  *
  * The sa size specified by the user or set by default
@@ -2874,6 +3164,8 @@ static __isl_give isl_schedule_node *split_band(
  *
  * Then, for each PE dimension, we compute the maximal value of the PE id
  * and add one.
+ * The number of PEs in the grid that don't execute any statement instance
+ * is stored in kernel->n_pe_idle.
  */
 static __isl_give isl_multi_pw_aff *extract_sa_grid_size(
     struct autosa_kernel *kernel, __isl_take isl_union_set *domain)
@@ -2910,6 +3202,7 @@ static __isl_give isl_multi_pw_aff *extract_sa_grid_size(
   }
 
   grid = isl_set_coalesce(grid);
+  kernel->n_pe_idle = count_idle_pes(grid);
   size = ppcg_size_from_extent(grid);
   context = isl_set_params(isl_set_copy(kernel->context));
   return isl_multi_pw_aff_gist(size, context);
@@ -3109,6 +3402,13 @@ __isl_give isl_schedule_node *add_pe_ext_io_copies_stmt(
     }
     node = autosa_tree_move_up_to_mark(node, "simd");
   }
+  else
+  {
+    /* We will insert the statements before/after the loops in which
+     * the data is reused in the registers.
+     */
+    node = autosa_tree_move_up_to_reuse_level(data->kernel, node, data->ref);
+  }
   access = io_comm_access_ref(data->kernel, node, io_group, data->ref, read);
   empty = isl_union_map_is_empty(access);
   if (empty < 0 || empty)
@@ -3563,35 +3863,95 @@ static __isl_give isl_schedule_node *insert_context(struct autosa_kernel *kernel
   return node;
 }
 
+/* Return the lcm of "lcm" and "n".
+ */
+static __isl_give isl_val *val_lcm_si(__isl_take isl_val *lcm, int n)
+{
+  isl_val *val = isl_val_int_from_si(isl_val_get_ctx(lcm), n);
+  isl_val *product = isl_val_mul(isl_val_copy(val), isl_val_copy(lcm));
+  isl_val *gcd = isl_val_gcd(val, lcm);
+
+  return isl_val_div(product, gcd);
+}
+
+/* Do the array reference groups "group1" and "group2" share any
+ * array reference?
+ */
+static int groups_share_ref(struct autosa_array_ref_group *group1,
+                            struct autosa_array_ref_group *group2)
+{
+  for (int i = 0; i < group1->n_ref; i++)
+    for (int j = 0; j < group2->n_ref; j++)
+      if (group1->refs[i] == group2->refs[j])
+        return 1;
+
+  return 0;
+}
+
+/* Compute the cyclic partitioning factor of the last dimension of the
+ * local buffer of the PE group "group" of the local array "local",
+ * i.e., the number of elements of the last dimension that are accessed
+ * in parallel in one cycle:
+ * - the I/O groups sharing an array reference with "group" transfer
+ *   "n_lane" packed elements in parallel;
+ * - the references of "group" with stride one under the SIMD loop
+ *   access "simd_w" elements in parallel.
+ * The lcm of these factors is used, so that each of these parallel
+ * accesses hits distinct partitions and the accessing loops achieve II=1,
+ * without partitioning the buffer for the accesses of other groups.
+ * If no I/O group shares an array reference with "group", the lcm of the
+ * data packing factors of all the I/O groups of the array is used.
+ */
+static int pe_module_var_n_part(struct autosa_kernel *kernel,
+                                struct autosa_array_ref_group *group,
+                                struct autosa_local_array_info *local)
+{
+  isl_val *lcm = isl_val_one(kernel->ctx);
+  int n_part, found = 0;
+
+  for (int i = 0; i < local->n_io_group; i++)
+  {
+    struct autosa_array_ref_group *io_group = local->io_groups[i];
+    if (!groups_share_ref(group, io_group))
+      continue;
+    lcm = val_lcm_si(lcm, io_group->n_lane);
+    found = 1;
+  }
+  if (!found)
+  {
+    for (int i = 0; i < local->n_io_group; i++)
+      lcm = val_lcm_si(lcm, local->io_groups[i]->n_lane);
+  }
+  for (int i = 0; i < group->n_ref; i++)
+  {
+    if (group->refs[i]->simd_stride == 1 && kernel->simd_w > 1)
+      lcm = val_lcm_si(lcm, kernel->simd_w);
+  }
+  n_part = isl_val_get_num_si(lcm);
+  isl_val_free(lcm);
+
+  return n_part;
+}
+
 /* Create the local buffer variables inside the PE.
- * Specifically, we will also scan through all IO groups for the array,
- * find the lcm of all the data packing factors to set as the array partitioning
- * factor for the local buffer so that all I/O groups should be able to 
- * access the packed elements without any bank conflict.
+ * The last dimension of the local buffer is partitioned cyclically by the
+ * factor computed by pe_module_var_n_part, such that the parallel accesses
+ * of the I/O groups and of the SIMD loop access the elements without any
+ * bank conflict. The factor is bounded by the size of the last dimension.
  */
-static void create_pe_module_var(isl_ctx *ctx,
+static void create_pe_module_var(struct autosa_kernel *kernel,
                                  struct autosa_array_ref_group *group,
                                  struct autosa_kernel_var *var, struct autosa_local_array_info *local)
 {
+  isl_ctx *ctx = kernel->ctx;
   struct autosa_array_tile *tile;
   isl_printer *p;
-  isl_val *lcm = isl_val_int_from_si(ctx, 1);
 
   var->array = group->array;
   var->type = autosa_array_ref_group_type(group);
   var->n_lane = 1;
-  /* Scan all the I/O groups, and compute the lcm of the group SIMD factors,
-   * set it as the partition factor of the variable. */
-  for (int i = 0; i < local->n_io_group; i++)
-  {
-    struct autosa_array_ref_group *io_group = local->io_groups[i];
-    isl_val *val = isl_val_int_from_si(ctx, io_group->n_lane);
-    isl_val *product = isl_val_mul(isl_val_copy(val), isl_val_copy(lcm));
-    isl_val *gcd = isl_val_gcd(val, lcm);
-    lcm = isl_val_div(product, gcd);
-  }
-  var->n_part = isl_val_get_num_si(lcm);
-  isl_val_free(lcm);
+  var->n_part = pe_module_var_n_part(kernel, group, local);
+  var->mem_type = -1;
 
   tile = autosa_array_ref_group_tile(group);
 
@@ -3614,6 +3974,14 @@ static void create_pe_module_var(isl_ctx *ctx,
                                           isl_val_copy(tile->bound[i].size));
     }
   }
+  if (var->n_part > 1)
+  {
+    isl_val *last = isl_vec_get_element_val(var->size, isl_vec_size(var->size) - 1);
+    long size = isl_val_get_num_si(last);
+    isl_val_free(last);
+    if (size > 0 && size < var->n_part)
+      var->n_part = size;
+  }
 }
 
 /* Create the local buffer variables inside the PE module. */
@@ -3654,7 +4022,7 @@ static isl_stat create_pe_module_vars(struct autosa_hw_module *module,
       type = autosa_array_ref_group_type(group);
       if (type == AUTOSA_ACCESS_GLOBAL)
         continue;
-      create_pe_module_var(kernel->ctx, group, &module->var[n], array);
+      create_pe_module_var(kernel, group, &module->var[n], array);
       n++;
     }
   }
@@ -3746,6 +4114,171 @@ static __isl_give isl_schedule *pe_module_dummy_gen(struct autosa_gen *gen,
   return schedule;
 }
 
+/* Return the array accessed by the reference "ref_id" of the statement
+ * "stmt", or NULL if it is not found.
+ */
+static struct autosa_array_info *stmt_ref_array(struct autosa_prog *prog,
+                                                struct autosa_stmt *stmt, __isl_keep isl_id *ref_id)
+{
+  struct autosa_stmt_access *access;
+
+  for (access = stmt->accesses; access; access = access->next)
+  {
+    const char *name;
+
+    if (access->ref_id != ref_id)
+      continue;
+    name = isl_map_get_tuple_name(access->access, isl_dim_out);
+    for (int i = 0; name && i < prog->n_array; i++)
+      if (!strcmp(prog->array[i].name, name))
+        return &prog->array[i];
+  }
+
+  return NULL;
+}
+
+/* Can the zero initialization "init" with instances "domain" in the kernel
+ * be fused into the statements that read the array elements it sets,
+ * given the flow dependences "flow" from these instances?
+ * This is the case if every instance of "init" is read,
+ * and if it is only read as the accumulator of the first update of a sum
+ * "acc = acc + e", i.e., by an instance that doesn't depend on any other
+ * update of the same sum.
+ * The accumulator should be read through its own reference,
+ * distinct from the write, such that the read can be replaced
+ * by the selection of zero in the first update.
+ */
+static isl_bool init_is_fusable(struct autosa_prog *prog,
+                                struct autosa_stmt *init, __isl_keep isl_set *domain,
+                                __isl_keep isl_union_map *flow)
+{
+  struct autosa_array_info *array = NULL;
+  struct autosa_stmt_access *access;
+  isl_union_set *written, *read;
+  isl_bool fusable;
+
+  for (access = init->accesses; access && !array; access = access->next)
+    if (access->write)
+      array = stmt_ref_array(prog, init, access->ref_id);
+  if (!array)
+    return isl_bool_false;
+
+  written = isl_union_set_from_set(isl_set_copy(domain));
+  read = isl_union_map_domain(isl_union_map_copy(flow));
+  fusable = isl_union_set_is_subset(written, read);
+  isl_union_set_free(written);
+  isl_union_set_free(read);
+
+  for (int i = 0; fusable == isl_bool_true && i < prog->n_stmts; i++)
+  {
+    struct autosa_stmt *stmt = &prog->stmts[i];
+    isl_id *write_ref = NULL, *read_ref = NULL;
+    isl_union_set *first, *updated;
+    isl_union_map *self;
+    isl_space *space;
+    int n_read = 0;
+
+    space = isl_set_get_space(stmt->stmt->domain);
+    first = isl_union_map_range(isl_union_map_copy(flow));
+    first = isl_union_set_intersect(first,
+                                    isl_union_set_from_set(isl_set_universe(space)));
+    if (isl_union_set_is_empty(first) != isl_bool_false)
+    {
+      isl_union_set_free(first);
+      continue;
+    }
+
+    fusable = autosa_stmt_is_sum(stmt->stmt, &write_ref, &read_ref);
+    if (fusable == isl_bool_true && write_ref == read_ref)
+      fusable = isl_bool_false;
+    if (fusable == isl_bool_true && stmt_ref_array(prog, stmt, read_ref) != array)
+      fusable = isl_bool_false;
+    for (access = stmt->accesses; fusable == isl_bool_true && access; access = access->next)
+      if (access->read && stmt_ref_array(prog, stmt, access->ref_id) == array)
+        n_read++;
+    if (n_read > 1)
+      fusable = isl_bool_false;
+    isl_id_free(write_ref);
+    isl_id_free(read_ref);
+
+    /* The first updates don't depend on any other update. */
+    self = isl_union_map_copy(prog->scop->dep_flow);
+    self = isl_union_map_intersect_domain(self,
+                                          isl_union_set_from_set(isl_set_universe(
+                                              isl_set_get_space(stmt->stmt->domain))));
+    updated = isl_union_map_range(self);
+    if (fusable == isl_bool_true)
+      fusable = isl_union_set_is_disjoint(first, updated);
+    isl_union_set_free(updated);
+    isl_union_set_free(first);
+  }
+
+  return fusable;
+}
+
+/* Fuse the zero initializations "acc = 0" of the kernel "kernel" into
+ * the first updates of the sums "acc = acc + e" that read the array
+ * elements they set, such that the PE selects between the initial value
+ * and the accumulator in the first update instead of executing
+ * the initialization as a separate statement:
+ *
+ *   acc = (first ? 0 : acc) + e
+ *
+ * The first updates are stored in kernel->fused_init
+ * and the instances of the fused initializations are returned,
+ * to be removed from the PE.
+ */
+static __isl_give isl_union_set *pe_fuse_init(struct autosa_kernel *kernel)
+{
+  struct autosa_prog *prog = kernel->prog;
+  isl_union_set *init, *first;
+
+  init = isl_union_set_empty(isl_union_set_get_space(kernel->core));
+  first = isl_union_set_copy(init);
+  for (int i = 0; i < prog->n_stmts; i++)
+  {
+    struct autosa_stmt *stmt = &prog->stmts[i];
+    isl_set *domain;
+    isl_union_map *flow;
+    isl_bool fusable;
+
+    if (autosa_stmt_is_zero_init(stmt->stmt) != isl_bool_true)
+      continue;
+    domain = isl_union_set_extract_set(kernel->core,
+                                       isl_set_get_space(stmt->stmt->domain));
+    domain = isl_set_intersect(domain, isl_set_copy(stmt->stmt->domain));
+    if (isl_set_is_empty(domain) != isl_bool_false)
+    {
+      isl_set_free(domain);
+      continue;
+    }
+
+    flow = isl_union_map_copy(prog->scop->dep_flow);
+    flow = isl_union_map_intersect_domain(flow,
+                                          isl_union_set_from_set(isl_set_copy(domain)));
+    fusable = init_is_fusable(prog, stmt, domain, flow);
+    if (fusable == isl_bool_true)
+    {
+      printf("[AutoSA] The initialization %s is fused into the PEs.\n",
+             isl_id_get_name(stmt->id));
+      init = isl_union_set_add_set(init, domain);
+      first = isl_union_set_union(first, isl_union_map_range(flow));
+    }
+    else
+    {
+      printf("[AutoSA] Warning: The initialization %s can't be fused into the PEs.\n",
+             isl_id_get_name(stmt->id));
+      isl_set_free(domain);
+      isl_union_map_free(flow);
+    }
+  }
+
+  isl_union_set_free(kernel->fused_init);
+  kernel->fused_init = first;
+
+  return init;
+}
+
 /* Modify the input "schedule" to describe the PE module.
  * Set the schedule dimensions of space loops as parameters.
  *
@@ -3800,12 +4333,30 @@ static __isl_give struct autosa_hw_module *sa_pe_module_gen(struct autosa_gen *g
   kernel->pe_filter = set_schedule_modulo(node, kernel->pe_ids,
                                           kernel->sa_dim);
   kernel->sa_grid_size = extract_sa_grid_size(kernel, domain);
+  if (kernel->n_pe_idle > 0 && kernel->options->autosa->triangular)
+    printf("[AutoSA] %d PEs don't intersect the iteration domain and only forward the data.\n",
+           kernel->n_pe_idle);
+  else if (kernel->n_pe_idle > 0)
+    printf("[AutoSA] %d PEs don't intersect the iteration domain. Use --AutoSA-triangular to remove their computation.\n",
+           kernel->n_pe_idle);
 
   /* Add the statements for I/O groups with exterior I/O at the user 
    * statement level. 
    * Add the statements for I/O group with interior I/O at the PE level.
    */
   node = autosa_tree_move_down_to_pe(node, kernel->core);
+  /* Remove the zero initializations fused into the sums. */
+  if (kernel->options->autosa->fuse_init)
+  {
+    isl_union_set *init, *filter;
+
+    init = pe_fuse_init(kernel);
+    node = isl_schedule_node_child(node, 0);
+    filter = isl_schedule_node_get_domain(node);
+    filter = isl_union_set_subtract(filter, init);
+    node = isl_schedule_node_insert_filter(node, filter);
+    node = isl_schedule_node_parent(node);
+  }
   /* Add copy-in/copy-out statements */
   for (int i = 0; i < kernel->n_array; ++i)
   {
@@ -5111,6 +5662,13 @@ void generate_hw_modules(__isl_take isl_schedule *schedule,
       if (hw_modules)
         free(hw_modules);
     }
+    if (info->array->irregular)
+    {
+      /* The cache of the array is the only module accessing it. */
+      info->group_ref_mem_port_map.push_back(std::pair<int, int>(0, 0));
+      info->group_ref_bw_demand.push_back(0);
+      info->n_io_group_refs = 1;
+    }
   }
   /* Drain module */
   for (int i = 0; i < kernel->n_array; i++)
@@ -6972,6 +7530,293 @@ static void autosa_at_domain_data_init(
   data->drain_merge_func = NULL;
 }
 
+/* Return constraints on the domain elements that equate the parameters
+ * called "names" to the members "pos" of the partial schedule of "node".
+ * If "size" is set, the members are taken modulo the integers in "size".
+ */
+static __isl_give isl_union_set *set_schedule_members_eq(
+    __isl_keep isl_schedule_node *node, __isl_keep isl_id_list *names,
+    int *pos, int *size)
+{
+  int n;
+  isl_ctx *ctx;
+  isl_multi_union_pw_aff *mupa;
+  isl_union_set *domain, *filter;
+
+  if (!node)
+    return NULL;
+  ctx = isl_schedule_node_get_ctx(node);
+  n = isl_id_list_n_id(names);
+  domain = isl_schedule_node_get_universe_domain(node);
+  filter = isl_union_set_copy(domain);
+  mupa = isl_schedule_node_band_get_partial_schedule(node);
+  for (int i = 0; i < n; i++)
+  {
+    isl_union_pw_aff *upa, *param;
+
+    upa = isl_multi_union_pw_aff_get_union_pw_aff(mupa, pos[i]);
+    if (size)
+      upa = isl_union_pw_aff_mod_val(upa, isl_val_int_from_si(ctx, size[i]));
+    param = isl_union_pw_aff_param_on_domain_id(isl_union_set_copy(domain),
+                                                isl_id_list_get_id(names, i));
+    upa = isl_union_pw_aff_sub(upa, param);
+    filter = isl_union_set_intersect(filter,
+                                     isl_union_pw_aff_zero_union_set(upa));
+  }
+  isl_multi_union_pw_aff_free(mupa);
+  isl_union_set_free(domain);
+
+  return filter;
+}
+
+/* Compute the extents of the identifiers "ids" mapped by "filter" on the
+ * domain elements "domain", in the same way as extract_sa_grid_size.
+ */
+static __isl_give isl_multi_pw_aff *extract_mapped_grid_size(
+    struct autosa_kernel *kernel, __isl_take isl_union_set *domain,
+    __isl_take isl_union_set *filter, __isl_keep isl_id_list *ids)
+{
+  int n;
+  isl_set *grid;
+  isl_set *context;
+  isl_multi_pw_aff *size;
+
+  n = isl_id_list_n_id(ids);
+  domain = isl_union_set_intersect(domain, filter);
+  grid = isl_union_set_params(domain);
+  grid = isl_set_from_params(grid);
+  grid = isl_set_add_dims(grid, isl_dim_set, n);
+  for (int i = 0; i < n; ++i)
+  {
+    int pos;
+    isl_id *id;
+
+    if (!grid)
+      return NULL;
+
+    id = isl_id_list_get_id(ids, i);
+    pos = isl_set_find_dim_by_id(grid, isl_dim_param, id);
+    isl_id_free(id);
+    if (pos < 0)
+      isl_die(isl_set_get_ctx(grid), isl_error_internal,
+              "missing constraints on mapped identifier",
+              grid = isl_set_free(grid));
+    grid = isl_set_equate(grid, isl_dim_param, pos, isl_dim_set, i);
+    grid = isl_set_project_out(grid, isl_dim_param, pos, 1);
+  }
+
+  grid = isl_set_coalesce(grid);
+  size = ppcg_size_from_extent(grid);
+  context = isl_set_params(isl_set_copy(kernel->context));
+  return isl_multi_pw_aff_gist(size, context);
+}
+
+/* This function is called for each statement instance of the CUDA kernel.
+ * The user statements access the arrays in the global memory, which is
+ * why the leaves are created outside of any kernel.
+ * The synchronization statements are printed as they are.
+ */
+static __isl_give isl_ast_node *at_domain_cuda(__isl_take isl_ast_node *node,
+                                               __isl_keep isl_ast_build *build, void *user)
+{
+  struct autosa_at_domain_data *data = (struct autosa_at_domain_data *)user;
+  struct autosa_stmt *device_stmt;
+  isl_ast_expr *expr, *arg;
+  isl_id *id;
+
+  expr = isl_ast_node_user_get_expr(node);
+  arg = isl_ast_expr_get_op_arg(expr, 0);
+  id = isl_ast_expr_get_id(arg);
+  isl_ast_expr_free(expr);
+  isl_ast_expr_free(arg);
+
+  device_stmt = find_stmt(data->prog, id);
+  isl_id_free(id);
+
+  if (device_stmt)
+    return create_domain_leaf(NULL, node, build, device_stmt);
+
+  return node;
+}
+
+/* Store the AST below the "kernel" mark as the CUDA kernel of the kernel
+ * object attached to the mark.
+ */
+static __isl_give isl_ast_node *after_mark_cuda(__isl_take isl_ast_node *node,
+                                                __isl_keep isl_ast_build *build, void *user)
+{
+  isl_id *id;
+  struct autosa_kernel *kernel;
+
+  id = isl_ast_node_mark_get_id(node);
+  if (!id)
+    return isl_ast_node_free(node);
+  if (!strcmp(isl_id_get_name(id), "kernel"))
+  {
+    kernel = (struct autosa_kernel *)isl_id_get_user(id);
+    isl_ast_node_free(kernel->cuda_tree);
+    kernel->cuda_tree = isl_ast_node_mark_get_node(node);
+  }
+  isl_id_free(id);
+
+  return node;
+}
+
+/* Generate the CUDA kernel of "kernel" from the space-time mapping and
+ * the array partitioning of the systolic array in "gen->schedule".
+ *
+ * The array partitions are executed by the thread blocks: the first (at most
+ * two) coincident members of the outermost band above the "array" mark are
+ * equated to the block identifiers "b0" and "b1".
+ * The PEs are executed by the threads of a block: the coincident space loops
+ * are equated to the thread identifiers "t0", "t1" and "t2" modulo the
+ * sizes of the PE array, the same way as the PE identifiers of the PE module.
+ * The time loops and the space loops that carry dependences are executed
+ * sequentially by each thread.
+ * If some array partitioning loops are not mapped to the thread blocks,
+ * the array partitions are executed one after the other by each block,
+ * and the threads are synchronized after each partition by
+ * a "cuda_sync" statement.
+ *
+ * The effective sizes of the grid and of the blocks are stored in
+ * kernel->grid_size, kernel->n_grid and kernel->n_block, kernel->block_dim,
+ * such that the host code launches the kernel on this grid.
+ * The AST of the kernel is stored in kernel->cuda_tree.
+ */
+isl_stat sa_cuda_kernel_generate_code(struct autosa_gen *gen,
+                                      struct autosa_kernel *kernel)
+{
+  isl_ctx *ctx = gen->ctx;
+  isl_schedule *schedule;
+  isl_schedule_node *node;
+  isl_union_set *domain, *filter;
+  struct autosa_at_domain_data data;
+  isl_ast_build *build;
+  isl_ast_node *tree;
+  isl_id_list *iterators;
+  int block_pos[2], thread_pos[3], thread_size[3];
+  int n_block = 0, n_thread = 0, n_part = 0, depth;
+
+  schedule = isl_schedule_dup(gen->schedule);
+  node = isl_schedule_get_root(schedule);
+  isl_schedule_free(schedule);
+  node = autosa_tree_move_down_to_kernel(node);
+  domain = isl_schedule_node_get_domain(node);
+
+  /* Map the array partitions to the thread blocks. */
+  node = isl_schedule_node_child(node, 0);
+  while (isl_schedule_node_get_type(node) == isl_schedule_node_mark &&
+         !autosa_tree_node_is_mark(node, "array"))
+    node = isl_schedule_node_child(node, 0);
+  if (isl_schedule_node_get_type(node) == isl_schedule_node_band)
+  {
+    int n = isl_schedule_node_band_n_member(node);
+    for (int i = 0; i < n && n_block < 2; i++)
+      if (isl_schedule_node_band_member_get_coincident(node, i))
+        block_pos[n_block++] = i;
+  }
+  kernel->block_ids = ppcg_scop_generate_names(gen->prog->scop, n_block, "b");
+  if (n_block > 0)
+  {
+    filter = set_schedule_members_eq(node, kernel->block_ids, block_pos, NULL);
+    isl_multi_pw_aff_free(kernel->grid_size);
+    kernel->grid_size = extract_mapped_grid_size(kernel,
+                                                 isl_union_set_copy(domain), isl_union_set_copy(filter),
+                                                 kernel->block_ids);
+    kernel->n_grid = n_block;
+    node = isl_schedule_node_insert_filter(node, filter);
+  }
+
+  /* Map the PEs to the threads. */
+  node = isl_schedule_node_root(node);
+  node = autosa_tree_move_down_to_array(node, kernel->core);
+  {
+    isl_schedule_node *ancestor = isl_schedule_node_copy(node);
+    while (!autosa_tree_node_is_kernel(ancestor))
+    {
+      ancestor = isl_schedule_node_parent(ancestor);
+      if (isl_schedule_node_get_type(ancestor) == isl_schedule_node_band)
+        n_part += isl_schedule_node_band_n_member(ancestor);
+    }
+    isl_schedule_node_free(ancestor);
+  }
+  node = isl_schedule_node_child(node, 0);
+  if (isl_schedule_node_get_type(node) == isl_schedule_node_band)
+  {
+    int n = isl_schedule_node_band_n_member(node);
+    for (int i = 0; i < kernel->n_sa_dim && i < n; i++)
+    {
+      if (!isl_schedule_node_band_member_get_coincident(node, i))
+      {
+        printf("[AutoSA] Warning: Space loop %d carries dependences, it is executed sequentially by each thread.\n", i);
+        continue;
+      }
+      thread_pos[n_thread] = i;
+      thread_size[n_thread] = kernel->sa_dim[i];
+      n_thread++;
+    }
+  }
+  kernel->thread_ids = ppcg_scop_generate_names(gen->prog->scop, n_thread, "t");
+  kernel->n_block = n_thread > 0 ? n_thread : 1;
+  kernel->block_dim[0] = 1;
+  for (int i = 0; i < n_thread; i++)
+    kernel->block_dim[i] = thread_size[i];
+  if (n_thread > 0)
+  {
+    filter = set_schedule_members_eq(node, kernel->thread_ids, thread_pos,
+                                     thread_size);
+    node = isl_schedule_node_insert_filter(node, filter);
+  }
+  {
+    int n_threads = 1;
+    for (int i = 0; i < kernel->n_block; i++)
+      n_threads *= kernel->block_dim[i];
+    if (n_threads > 1024)
+      printf("[AutoSA] Warning: %d threads per block exceed the CUDA limit of 1024.\n", n_threads);
+  }
+
+  /* Synchronize the threads after each array partition. */
+  if (n_part > n_block)
+  {
+    isl_space *space;
+    isl_schedule_node *graft;
+
+    node = isl_schedule_node_root(node);
+    node = autosa_tree_move_down_to_array(node, kernel->core);
+    space = isl_space_set_alloc(ctx, 0, 0);
+    space = isl_space_set_tuple_name(space, isl_dim_set, "cuda_sync");
+    graft = isl_schedule_node_from_domain(
+        isl_union_set_from_set(isl_set_universe(space)));
+    node = isl_schedule_node_graft_after(node, graft);
+  }
+  isl_union_set_free(domain);
+
+  schedule = isl_schedule_node_get_schedule(node);
+  isl_schedule_node_free(node);
+
+  /* Generate the AST. */
+  autosa_at_domain_data_init(&data, gen);
+  depth = 0;
+  if (isl_schedule_foreach_schedule_node_top_down(schedule, &update_depth,
+                                                  &depth) < 0)
+    schedule = isl_schedule_free(schedule);
+  build = isl_ast_build_alloc(ctx);
+  iterators = ppcg_scop_generate_names(gen->prog->scop, depth, "c");
+  build = isl_ast_build_set_iterators(build, iterators);
+  build = isl_ast_build_set_at_each_domain(build, &at_domain_cuda, &data);
+  build = isl_ast_build_set_after_each_mark(build, &after_mark_cuda, &data);
+  tree = isl_ast_build_node_from_schedule(build, schedule);
+  isl_ast_build_free(build);
+  isl_ast_node_free(tree);
+
+  if (!kernel->cuda_tree)
+    return isl_stat_error;
+  printf("[AutoSA] CUDA kernel%d: %d array partitioning loop(s) mapped to the thread blocks, %d space loop(s) mapped to the threads.\n",
+         kernel->id, n_block, n_thread);
+
+  return isl_stat_ok;
+}
+
 /* Return a pointer to the autosa_array_ref_group in "local"
  * that contains the reference "access".
  * Return NULL if no such group can be found.
@@ -7123,6 +7968,46 @@ static __isl_give isl_multi_pw_aff *transform_index_module(
   return index;
 }
 
+/* Replace the access "expr" to the irregular array of "data" by a read
+ * through the cache of the array, i.e.,
+ *
+ *	autosa_cache_read(fifo_A_cache_req, fifo_A_cache_resp, i)
+ *
+ * where "i" is the linearized index of the access.
+ */
+static __isl_give isl_ast_expr *irregular_cache_read(
+    __isl_take isl_ast_expr *expr, struct autosa_transform_data *data)
+{
+  isl_ctx *ctx = isl_ast_expr_get_ctx(expr);
+  const char *suffix[] = {"_cache_req", "_cache_resp"};
+  isl_ast_expr_list *args;
+  isl_ast_expr *index;
+
+  expr = autosa_local_array_info_linearize_index(data->local_array, expr);
+  index = isl_ast_expr_get_op_arg(expr, 1);
+  isl_ast_expr_free(expr);
+
+  args = isl_ast_expr_list_alloc(ctx, 3);
+  for (int i = 0; i < 2; i++)
+  {
+    isl_printer *p_str = isl_printer_to_str(ctx);
+    char *name;
+
+    p_str = isl_printer_print_str(p_str, "fifo_");
+    p_str = isl_printer_print_str(p_str, data->array->name);
+    p_str = isl_printer_print_str(p_str, suffix[i]);
+    name = isl_printer_get_str(p_str);
+    isl_printer_free(p_str);
+    args = isl_ast_expr_list_add(args,
+                                 isl_ast_expr_from_id(isl_id_alloc(ctx, name, NULL)));
+    free(name);
+  }
+  args = isl_ast_expr_list_add(args, index);
+
+  return isl_ast_expr_call(
+      isl_ast_expr_from_id(isl_id_alloc(ctx, "autosa_cache_read", NULL)), args);
+}
+
 /* AST expression transformation callback for pet_stmt_build_ast_exprs.
  *
  * If the AST expression refers to an array that is not accessed
@@ -7133,6 +8018,9 @@ static __isl_give isl_multi_pw_aff *transform_index_module(
  * a read-only scalar, then its address was passed to the kernel and
  * we need to dereference it.
  *
+ * If the AST expression refers to an irregular array, then the element
+ * is read from the cache of the array.
+ *
  * If the AST expression refers to an array reference that is put in 
  * the registers. We will modify the expr to a register access.
  *
@@ -7157,8 +8045,10 @@ static __isl_give isl_ast_expr *transform_expr_module(__isl_take isl_ast_expr *e
   }
   if (autosa_array_is_read_only_scalar(data->array))
     return expr;
+  if (data->array->irregular && data->kernel)
+    return irregular_cache_read(expr, data);
   if (!data->reg)
-    return expr;
+    return autosa_ast_expr_strength_reduce(expr);
   if (data->reg)
   {
     isl_ctx *ctx;
@@ -7193,7 +8083,81 @@ static __isl_give isl_ast_expr *transform_expr_module(__isl_take isl_ast_expr *e
   if (!data->array->linearize)
     return expr;
 
-  return autosa_local_array_info_linearize_index(data->local_array, expr);
+  expr = autosa_local_array_info_linearize_index(data->local_array, expr);
+  return autosa_ast_expr_strength_reduce(expr);
+}
+
+/* Return the condition that the statement instance of "stmt" at the current
+ * position of "build" belongs to the original domain of the statement,
+ * given the map "iterator_map" from the generated loops to the statement
+ * instances, or NULL if the condition always holds.
+ * This masks the statement instances that pad the iteration domain
+ * to multiples of the array partitioning tiling factors.
+ */
+static __isl_give isl_ast_expr *build_padded_domain_guard(
+    __isl_keep isl_ast_build *build, struct autosa_stmt *stmt,
+    __isl_keep isl_pw_multi_aff *iterator_map)
+{
+  isl_set *domain;
+  isl_ast_expr *guard;
+
+  domain = isl_set_copy(stmt->stmt->domain);
+  domain = isl_set_preimage_pw_multi_aff(domain,
+                                         isl_pw_multi_aff_copy(iterator_map));
+  guard = isl_ast_build_expr_from_set(build, domain);
+  if (isl_ast_expr_get_type(guard) == isl_ast_expr_int)
+  {
+    isl_val *val = isl_ast_expr_get_val(guard);
+    int always = isl_val_is_one(val);
+    isl_val_free(val);
+    if (always)
+      return isl_ast_expr_free(guard);
+  }
+
+  return guard;
+}
+
+/* Return the condition that the statement instance of "stmt" at the current
+ * position of "build" is the first update of a sum whose zero
+ * initialization is fused into it (see pe_fuse_init), given the map
+ * "iterator_map" from the generated loops to the statement instances,
+ * or NULL if no instance of the statement is such a first update.
+ * The array of the accumulator is stored in stmt->u.d.init_array.
+ */
+static __isl_give isl_ast_expr *build_fused_init_cond(
+    struct autosa_kernel *kernel, __isl_keep isl_ast_build *build,
+    struct autosa_kernel_stmt *stmt, __isl_keep isl_pw_multi_aff *iterator_map)
+{
+  struct autosa_stmt *autosa_stmt = stmt->u.d.stmt;
+  isl_id *write_ref = NULL, *read_ref = NULL;
+  isl_set *first;
+  isl_ast_expr *cond;
+
+  first = isl_union_set_extract_set(kernel->fused_init,
+                                    isl_set_get_space(autosa_stmt->stmt->domain));
+  if (isl_set_is_empty(first) != isl_bool_false ||
+      autosa_stmt_is_sum(autosa_stmt->stmt, &write_ref, &read_ref) != isl_bool_true)
+  {
+    isl_set_free(first);
+    return NULL;
+  }
+  stmt->u.d.init_array = stmt_ref_array(kernel->prog, autosa_stmt, read_ref);
+  isl_id_free(write_ref);
+  isl_id_free(read_ref);
+
+  first = isl_set_preimage_pw_multi_aff(first,
+                                        isl_pw_multi_aff_copy(iterator_map));
+  cond = isl_ast_build_expr_from_set(build, first);
+  if (isl_ast_expr_get_type(cond) == isl_ast_expr_int)
+  {
+    isl_val *val = isl_ast_expr_get_val(cond);
+    int never = isl_val_is_zero(val);
+    isl_val_free(val);
+    if (never)
+      return isl_ast_expr_free(cond);
+  }
+
+  return cond;
 }
 
 /* This function is called for each instance of a user statement
@@ -7249,6 +8213,12 @@ static __isl_give isl_ast_node *create_domain_leaf_module(
   stmt->u.d.ref2expr = pet_stmt_build_ast_exprs(stmt->u.d.stmt->stmt,
                                                 build, &transform_index_module, &data,
                                                 &transform_expr_module, &data);
+  if (kernel && kernel->padded_domain)
+    stmt->u.d.guard = build_padded_domain_guard(build, autosa_stmt,
+                                                iterator_map);
+  if (kernel && kernel->fused_init)
+    stmt->u.d.init = build_fused_init_cond(kernel, build, stmt,
+                                           iterator_map);
 
   isl_pw_multi_aff_free(iterator_map);
   isl_pw_multi_aff_free(sched2copy);
@@ -7772,7 +8742,7 @@ static __isl_give isl_ast_node *create_io_leaf(struct autosa_kernel *kernel,
     }
   }
 
-  stmt->u.i.index = expr;
+  stmt->u.i.index = autosa_ast_expr_strength_reduce(expr);
 
   /* Compute the local index. */
   tile = pair->local_tile;
@@ -7795,7 +8765,7 @@ static __isl_give isl_ast_node *create_io_leaf(struct autosa_kernel *kernel,
     /* L -> T */
     pma2 = isl_pw_multi_aff_pullback_pw_multi_aff(pma2, pma);
     expr = isl_ast_build_access_from_pw_multi_aff(build, pma2);
-    stmt->u.i.local_index = expr;
+    stmt->u.i.local_index = autosa_ast_expr_strength_reduce(expr);
     stmt->u.i.reg = 0;
   }
   else
@@ -7916,7 +8886,7 @@ static __isl_give isl_ast_node *create_drain_merge_leaf(struct autosa_kernel *ke
   /* Linearize the index. */
   group = func->group;
   expr = autosa_local_array_info_linearize_index(group->local_array, expr);
-  stmt->u.dm.index = expr;
+  stmt->u.dm.index = autosa_ast_expr_strength_reduce(expr);
 
   id = isl_id_alloc(ctx, "drain_merge", stmt);
   id = isl_id_set_free_user(id, &autosa_kernel_stmt_free);
@@ -8272,6 +9242,8 @@ static __isl_give isl_ast_node *create_io_module_call_leaf(
     stmt->type = AUTOSA_KERNEL_STMT_IO_MODULE_CALL_INTRA_INTER;
   else if (!prefixcmp(name, "io_module.state_handle"))
     stmt->type = AUTOSA_KERNEL_STMT_IO_MODULE_CALL_STATE_HANDLE;
+  else if (!prefixcmp(name, "io_module.credit"))
+    stmt->type = AUTOSA_KERNEL_STMT_IO_MODULE_CALL_CREDIT;
   id = isl_id_alloc(ctx, name, stmt);
   id = isl_id_set_free_user(id, &autosa_kernel_stmt_free);
   if (!id)
@@ -8592,6 +9564,86 @@ static __isl_give isl_ast_node *after_mark_module(__isl_take isl_ast_node *node,
   return node;
 }
 
+/* Return the number of bits required to represent the non-negative "val".
+ */
+static int bits_of(long val)
+{
+  int bits = 1;
+
+  while (bits < 64 && (val >> bits) != 0)
+    bits++;
+
+  return bits;
+}
+
+/* This function is called after each for loop in the AST generated
+ * for the hardware modules.
+ * Infer the bit width of the loop iterator from the range of the current
+ * schedule dimension, i.e., the last dimension of the schedule at "build",
+ * bounded by the context, and store it in the annotation of the for node.
+ * The iterator reaches one past its upper bound when the loop exits,
+ * which is included in the width.
+ * The iterator is kept as an "int" if its range is not bounded by
+ * constants or needs as many bits.
+ */
+static __isl_give isl_ast_node *after_for_module(__isl_take isl_ast_node *node,
+                                                 __isl_keep isl_ast_build *build, void *user)
+{
+  struct autosa_at_domain_data *data = (struct autosa_at_domain_data *)user;
+  struct autosa_ast_node_userinfo *info;
+  isl_union_set *schedule_range;
+  isl_set *range;
+  isl_val *lb, *ub;
+  isl_id *id;
+  int n;
+
+  schedule_range = isl_union_map_range(isl_ast_build_get_schedule(build));
+  if (isl_union_set_n_set(schedule_range) != 1)
+  {
+    isl_union_set_free(schedule_range);
+    return node;
+  }
+  range = isl_set_from_union_set(schedule_range);
+  n = isl_set_dim(range, isl_dim_set);
+  if (n <= 0)
+  {
+    isl_set_free(range);
+    return node;
+  }
+  range = isl_set_project_out(range, isl_dim_set, 0, n - 1);
+  range = isl_set_intersect_params(range, isl_set_copy(data->prog->context));
+  lb = isl_set_dim_min_val(isl_set_copy(range), 0);
+  ub = isl_set_dim_max_val(range, 0);
+
+  info = alloc_ast_node_userinfo();
+  if (isl_val_is_int(lb) && isl_val_is_int(ub))
+  {
+    long min = isl_val_get_num_si(lb);
+    long max = isl_val_get_num_si(ub);
+    int bits;
+
+    if (min >= 0)
+    {
+      bits = bits_of(max + 1);
+    }
+    else
+    {
+      bits = bits_of(max + 1 > -min ? max + 1 : -min) + 1;
+      info->iter_signed = 1;
+    }
+    if (bits < 32)
+      info->iter_bits = bits;
+  }
+  isl_val_free(lb);
+  isl_val_free(ub);
+
+  id = isl_id_alloc(isl_ast_node_get_ctx(node), "for", info);
+  id = isl_id_set_free_user(id, &free);
+  node = isl_ast_node_set_annotation(node, id);
+
+  return node;
+}
+
 /* Generate AST from the schedule for AutoSA hardware modules. 
  */
 static __isl_give isl_ast_node *autosa_generate_ast_from_schedule(
@@ -8616,6 +9668,7 @@ static __isl_give isl_ast_node *autosa_generate_ast_from_schedule(
   build = isl_ast_build_set_at_each_domain(build, &at_domain_module, &data);
   build = isl_ast_build_set_before_each_mark(build, &before_mark_module, &data);
   build = isl_ast_build_set_after_each_mark(build, &after_mark_module, &data);
+  build = isl_ast_build_set_after_each_for(build, &after_for_module, &data);
 
   if (gen->prog->scop->options->debug->dump_final_schedule)
     isl_schedule_dump(schedule);
@@ -24,6 +24,8 @@ isl_stat sa_filter_buffer_io_module_generate_code(struct autosa_gen *gen,
 isl_stat sa_module_generate_code(struct autosa_gen *gen,
                                  struct autosa_hw_module *module);
 isl_stat sa_top_module_generate_code(struct autosa_gen *gen);
+isl_stat sa_cuda_kernel_generate_code(struct autosa_gen *gen,
+                                      struct autosa_kernel *kernel);
 isl_stat sa_drain_merge_generate_code(struct autosa_gen *gen,
                                       struct autosa_drain_merge_func *func);
 
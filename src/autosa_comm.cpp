@@ -7,6 +7,22 @@
 #include "autosa_utils.h"
 #include "autosa_print.h"
 
+/* The I/O module schedule computed for the I/O groups with the I/O
+ * direction "dir" of the io_L1 modules.
+ * "schedule" is the kernel schedule after I/O module clustering.
+ * "io_L1_schedule", "io_L1_trans", "io_trans" and "io_level" are
+ * the corresponding fields of the I/O groups.
+ */
+struct autosa_io_schedule_memo
+{
+  isl_vec *dir;
+  isl_schedule *schedule;
+  isl_schedule *io_L1_schedule;
+  isl_multi_aff *io_L1_trans;
+  isl_multi_aff *io_trans;
+  int io_level;
+};
+
 /* Internal data structure for autosa_group_references.
  */
 struct autosa_group_data
@@ -40,6 +56,10 @@ struct autosa_group_data
   isl_union_map *pe_sched;
   /* A union map representation of the entire kernel schedule. */
   isl_union_map *full_sched;
+
+  /* The I/O module schedules computed so far. */
+  int n_io_sched;
+  struct autosa_io_schedule_memo *io_sched;
 };
 
 /* Return the prefix schedule at "node" as a relation
@@ -402,6 +422,191 @@ static __isl_give isl_map *remove_strides(__isl_take isl_map *access,
   return access;
 }
 
+/* Return the affine expression "-g" of the constraint "c" of the form
+ * "a o + g >= 0" or "a o + g = 0" on the domain space "space".
+ */
+static __isl_give isl_aff *constraint_rest_neg(__isl_keep isl_constraint *c,
+                                               __isl_keep isl_space *space)
+{
+  isl_aff *aff;
+  isl_size n_param, n_in;
+
+  aff = isl_aff_zero_on_domain(isl_local_space_from_space(
+      isl_space_copy(space)));
+  aff = isl_aff_set_constant_val(aff, isl_constraint_get_constant_val(c));
+  n_param = isl_constraint_dim(c, isl_dim_param);
+  for (int i = 0; i < n_param; i++)
+    aff = isl_aff_set_coefficient_val(aff, isl_dim_param, i,
+                                      isl_constraint_get_coefficient_val(c, isl_dim_param, i));
+  n_in = isl_constraint_dim(c, isl_dim_in);
+  for (int i = 0; i < n_in; i++)
+    aff = isl_aff_set_coefficient_val(aff, isl_dim_in, i,
+                                      isl_constraint_get_coefficient_val(c, isl_dim_in, i));
+
+  return isl_aff_neg(aff);
+}
+
+/* Try to compute the memory tile of the access "access" in closed form.
+ * This is the case for rectangular tiles accessed with unit strides,
+ * i.e., if "access" is a single basic map without existentially
+ * quantified variables, where each constraint involves at most one index,
+ * with a unit coefficient.
+ * The bounds of each index i are then of the form
+ *
+ *	l(p) <= i <= u(p)
+ *
+ * and the tile is given by the pair of bounds with the smallest constant
+ * difference u(p) - l(p).
+ * Return isl_bool_true if the tile is computed and put the results
+ * in "tile", with unit strides.
+ * Return isl_bool_false if the general computation is required.
+ */
+static isl_bool can_tile_box(__isl_keep isl_map *access,
+                             struct autosa_array_tile *tile)
+{
+  isl_basic_map_list *bmap_list;
+  isl_basic_map *bmap;
+  isl_constraint_list *c_list;
+  isl_space *space;
+  isl_size n_c;
+  isl_bool valid = isl_bool_true;
+  isl_aff_list **lower, **upper;
+  isl_ctx *ctx = isl_map_get_ctx(access);
+
+  if (isl_map_n_basic_map(access) != 1)
+    return isl_bool_false;
+  bmap_list = isl_map_get_basic_map_list(access);
+  bmap = isl_basic_map_list_get_basic_map(bmap_list, 0);
+  isl_basic_map_list_free(bmap_list);
+  if (isl_basic_map_dim(bmap, isl_dim_div) != 0)
+  {
+    isl_basic_map_free(bmap);
+    return isl_bool_false;
+  }
+
+  space = isl_space_domain(isl_basic_map_get_space(bmap));
+  c_list = isl_basic_map_get_constraint_list(bmap);
+  isl_basic_map_free(bmap);
+  n_c = isl_constraint_list_n_constraint(c_list);
+
+  lower = isl_calloc_array(ctx, isl_aff_list *, tile->n);
+  upper = isl_calloc_array(ctx, isl_aff_list *, tile->n);
+  for (int i = 0; i < tile->n; i++)
+  {
+    lower[i] = isl_aff_list_alloc(ctx, 0);
+    upper[i] = isl_aff_list_alloc(ctx, 0);
+  }
+
+  /* Collect the lower and upper bounds of each index. */
+  for (int i = 0; i < n_c && valid; i++)
+  {
+    isl_constraint *c = isl_constraint_list_get_constraint(c_list, i);
+    int pos = -1;
+    isl_val *coef = NULL;
+    isl_aff *bound;
+
+    for (int j = 0; j < tile->n && valid; j++)
+    {
+      if (!isl_constraint_involves_dims(c, isl_dim_out, j, 1))
+        continue;
+      if (pos >= 0)
+        valid = isl_bool_false;
+      pos = j;
+    }
+    if (valid && pos >= 0)
+    {
+      coef = isl_constraint_get_coefficient_val(c, isl_dim_out, pos);
+      if (!isl_val_is_one(coef) && !isl_val_is_negone(coef))
+        valid = isl_bool_false;
+    }
+    if (valid && pos >= 0)
+    {
+      bound = constraint_rest_neg(c, space);
+      if (isl_val_is_negone(coef))
+        bound = isl_aff_neg(bound);
+      if (isl_constraint_is_equality(c))
+      {
+        lower[pos] = isl_aff_list_add(lower[pos], isl_aff_copy(bound));
+        upper[pos] = isl_aff_list_add(upper[pos], bound);
+      }
+      else if (isl_val_is_one(coef))
+        lower[pos] = isl_aff_list_add(lower[pos], bound);
+      else
+        upper[pos] = isl_aff_list_add(upper[pos], bound);
+    }
+    isl_val_free(coef);
+    isl_constraint_free(c);
+  }
+  isl_constraint_list_free(c_list);
+
+  /* Find the tightest pair of bounds with a constant difference. */
+  for (int i = 0; i < tile->n && valid; i++)
+  {
+    isl_aff *lb = NULL;
+    isl_val *size = NULL;
+
+    for (int j = 0; j < isl_aff_list_n_aff(lower[i]); j++)
+      for (int k = 0; k < isl_aff_list_n_aff(upper[i]); k++)
+      {
+        isl_aff *diff;
+        isl_val *v;
+
+        diff = isl_aff_sub(isl_aff_list_get_aff(upper[i], k),
+                           isl_aff_list_get_aff(lower[i], j));
+        if (isl_aff_is_cst(diff))
+        {
+          v = isl_val_add_ui(isl_aff_get_constant_val(diff), 1);
+          if (!size || isl_val_lt(v, size))
+          {
+            isl_val_free(size);
+            isl_aff_free(lb);
+            size = isl_val_copy(v);
+            lb = isl_aff_list_get_aff(lower[i], j);
+          }
+          isl_val_free(v);
+        }
+        isl_aff_free(diff);
+      }
+    if (!size)
+    {
+      valid = isl_bool_false;
+      break;
+    }
+    tile->bound[i].size = size;
+    tile->bound[i].lb = lb;
+  }
+
+  for (int i = 0; i < tile->n; i++)
+  {
+    isl_aff_list_free(lower[i]);
+    isl_aff_list_free(upper[i]);
+  }
+  free(lower);
+  free(upper);
+
+  if (!valid)
+  {
+    for (int i = 0; i < tile->n; i++)
+    {
+      tile->bound[i].size = isl_val_free(tile->bound[i].size);
+      tile->bound[i].lb = isl_aff_free(tile->bound[i].lb);
+    }
+    isl_space_free(space);
+    return isl_bool_false;
+  }
+
+  for (int i = 0; i < tile->n; i++)
+  {
+    tile->bound[i].stride = isl_val_one(ctx);
+    tile->bound[i].shift = isl_aff_zero_on_domain(isl_local_space_from_space(
+        isl_space_copy(space)));
+  }
+  isl_space_free(space);
+  tile->depth = isl_map_dim(access, isl_dim_in);
+
+  return isl_bool_true;
+}
+
 /* Check if we can find a memory tile for the given array
  * based on the given accesses, and if so, put the results in "tile".
  *
@@ -410,6 +615,9 @@ static __isl_give isl_map *remove_strides(__isl_take isl_map *access,
  * any stride that may appear in the accesses.
  *
  * tile->depth is initialized to the input dimension of the computed bounds.
+ *
+ * Rectangular tiles with unit strides are computed in closed form
+ * by can_tile_box.
  */
 isl_bool can_tile(__isl_keep isl_map *access,
                   struct autosa_array_tile *tile)
@@ -423,7 +631,9 @@ isl_bool can_tile(__isl_keep isl_map *access,
   if (!tile)
     return isl_bool_error;
 
-  isl_map_free(isl_map_detect_equalities(isl_map_copy(access)));
+  valid = can_tile_box(access, tile);
+  if (valid != isl_bool_false)
+    return valid;
 
   has_strides = detect_strides(tile, access);
   if (has_strides < 0)
@@ -550,7 +760,8 @@ static isl_bool compute_local_tile_acc_single(__isl_keep isl_set *set, void *use
 /* Examine the schedule depth and prefix schedule used to calculated the 
  * register tiling. Specifically, if the access is under the SIMD loop,
  * we will move up to the "SIMD" mark and compute tiling at this level.
- * Otherwise, we will compute the tiling at the statement level.
+ * Otherwise, we will compute the tiling at the statement level, or above
+ * the inner loops in which the access is invariant with "--AutoSA-reg-reuse".
  * In addition, if the access is found in more than one loop, we will 
  * not create register tiling. Instead, we create a local buffer at the PE level.
  */
@@ -594,9 +805,18 @@ static __isl_give isl_schedule_node *compute_local_tile_acc(
     }
     else
     {
-      prefix = isl_schedule_node_get_prefix_schedule_union_map(node);
-      prefix_upma = isl_schedule_node_get_prefix_schedule_union_pw_multi_aff(node);
-      depth = isl_schedule_node_get_schedule_depth(node);
+      /* If the accessed element is reused in the inner loops, we will move
+       * up to the outermost of these loops, and compute the tiling at
+       * this level.
+       */
+      isl_schedule_node *new_node;
+
+      new_node = isl_schedule_node_copy(node);
+      new_node = autosa_tree_move_up_to_reuse_level(data->kernel, new_node, acc);
+      prefix = isl_schedule_node_get_prefix_schedule_union_map(new_node);
+      prefix_upma = isl_schedule_node_get_prefix_schedule_union_pw_multi_aff(new_node);
+      depth = isl_schedule_node_get_schedule_depth(new_node);
+      isl_schedule_node_free(new_node);
     }
     if (data->depth == -1)
     {
@@ -1006,10 +1226,107 @@ static int group_share_io(struct autosa_kernel *kernel,
   return group_io(kernel, n, groups, &share_io, 0, data);
 }
 
+/* Return the default space loop along which the data of the array "array"
+ * with interior I/O are transferred.
+ * The data are transferred along the first space loop by default.
+ * In the 3D systolic arrays, the reduction (RAW) dependence carried by
+ * one space loop accumulates the partial results along that loop, and the
+ * final results are only available at the last boundary plane of the array.
+ * The data are then drained along the reduction dimension, such that
+ * each PE of the boundary plane is connected to its own drain chain instead
+ * of forwarding the results of the whole plane through one chain.
+ */
+static int interior_io_default_dim(struct autosa_kernel *kernel,
+                                   struct autosa_array_info *array)
+{
+  if (kernel->n_sa_dim < 3)
+    return 0;
+
+  for (int i = 0; i < array->n_ref; i++)
+  {
+    struct autosa_stmt_access *ref = array->refs[i];
+    for (int j = 0; j < ref->n_io_info; j++)
+    {
+      struct autosa_io_info *io_info = ref->io_info[j];
+      if (io_info->io_type != AUTOSA_EXT_IO ||
+          io_info->dep->type != AUTOSA_DEP_RAW)
+        continue;
+      for (int k = 0; k < isl_vec_size(io_info->dir); k++)
+      {
+        isl_val *val = isl_vec_get_element_val(io_info->dir, k);
+        int carried = !isl_val_is_zero(val);
+        isl_val_free(val);
+        if (carried)
+          return k;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* Return the space loop along which the data of the array "array" with
+ * interior I/O are transferred, as given by "kernel[0]->io_dir_<array>[dim]"
+ * in the "--sa-sizes" option, or the default one if it is not given.
+ * The direction applies to both the I/O groups and the drain group
+ * of the array.
+ */
+static int interior_io_dim(struct autosa_kernel *kernel,
+                           struct autosa_array_info *array)
+{
+  isl_printer *p_str;
+  char *name;
+  int dim;
+
+  p_str = isl_printer_to_str(kernel->ctx);
+  p_str = isl_printer_print_str(p_str, "io_dir_");
+  p_str = isl_printer_print_str(p_str, array->name);
+  name = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  dim = read_io_dir_size(kernel, name);
+  free(name);
+  if (dim >= kernel->n_sa_dim)
+  {
+    printf("[AutoSA] Warning: Illegal I/O direction %d of array %s, the default direction is used.\n",
+           dim, array->name);
+    dim = -1;
+  }
+  if (dim < 0)
+    dim = interior_io_default_dim(kernel, array);
+
+  return dim;
+}
+
+/* Assign the direction "dim" to the I/O group "group" with interior I/O,
+ * together with the communication pairs of its references with interior I/O,
+ * such that the communication pairs are matched against the group later on.
+ */
+static void set_interior_io_dir(struct autosa_array_ref_group *group, int dim)
+{
+  group->dir = isl_vec_set_element_si(group->dir, dim, 1);
+  for (int i = 0; i < group->n_ref; i++)
+  {
+    struct autosa_stmt_access *ref = group->refs[i];
+    for (int j = 0; j < ref->n_io_info; j++)
+    {
+      struct autosa_io_info *io_info = ref->io_info[j];
+      if (io_info->io_type == group->io_type && isl_vec_is_zero(io_info->dir))
+      {
+        isl_vec_free(io_info->dir);
+        io_info->dir = isl_vec_copy(group->dir);
+      }
+    }
+  }
+}
+
 /* Perform interior I/O elimination.
  * Find the I/O group with interior I/O, and assign new data tranfer direction 
  * at the PE level.
- * At present, we will assign the first dim to 1 by default.
+ * The data are transferred along the space loop given by
+ * "kernel[0]->io_dir_<array>[dim]" in the "--sa-sizes" option, which decides
+ * whether the array is fed (or drained) through the rows or the columns
+ * of the array, and thus the number of I/O modules and the length of the
+ * daisy chains. By default, see interior_io_default_dim.
  */
 static isl_stat autosa_interior_io_eliminate(
     struct autosa_kernel *kernel, struct autosa_array_ref_group *group,
@@ -1018,22 +1335,7 @@ static isl_stat autosa_interior_io_eliminate(
   if (isl_vec_is_zero(group->dir))
   {
     /* This group will generate interior I/O, which needs to be eliminated. */
-    /* By default, set the first dim to be 1. */
-    group->dir = isl_vec_set_element_si(group->dir, 0, 1);
-    /* Update the array info */
-    for (int i = 0; i < group->n_ref; i++)
-    {
-      struct autosa_stmt_access *ref = group->refs[i];
-      for (int j = 0; j < ref->n_io_info; j++)
-      {
-        struct autosa_io_info *io_info = ref->io_info[j];
-        if (io_info->io_type == group->io_type && isl_vec_is_zero(io_info->dir))
-        {
-          isl_vec_free(io_info->dir);
-          io_info->dir = isl_vec_copy(group->dir);
-        }
-      }
-    }
+    set_interior_io_dir(group, interior_io_dim(kernel, group->array));
   }
   return isl_stat_ok;
 }
@@ -1192,7 +1494,97 @@ static __isl_give isl_schedule_node *insert_io_module_context(
   return node;
 }
 
+/* Estimate the off-chip bandwidth demand of the I/O or drain group "group"
+ * in bytes per cycle.
+ * Each PE consumes or produces one element per cycle. With interior I/O,
+ * the elements only enter or leave the array at the boundary PEs along the
+ * I/O direction. With exterior I/O, each PE is connected to I/O modules.
+ */
+double autosa_array_ref_group_bw_demand(struct autosa_kernel *kernel,
+                                        struct autosa_array_ref_group *group)
+{
+  double n_entry = 1;
+
+  for (int i = 0; i < kernel->n_sa_dim; i++)
+  {
+    if (group->io_type == AUTOSA_INT_IO && group->dir &&
+        i < isl_vec_size(group->dir))
+    {
+      isl_val *val = isl_vec_get_element_val(group->dir, i);
+      int along_dir = !isl_val_is_zero(val);
+      isl_val_free(val);
+      if (along_dir)
+        continue;
+    }
+    n_entry *= kernel->sa_dim[i];
+  }
+
+  return n_entry * group->array->size;
+}
+
+/* Assign the "n_channel" HBM channels to the I/O and drain groups of "kernel"
+ * and return the number of channels assigned to "group".
+ * Each group gets one channel first. The remaining channels are handed out 
+ * one at a time to the group with the largest bandwidth demand per channel,
+ * which balances the load of the channels.
+ */
+static int hbm_assign_channels(struct autosa_kernel *kernel,
+                               struct autosa_array_ref_group *group, int n_channel)
+{
+  std::vector<struct autosa_array_ref_group *> groups;
+  std::vector<double> demands;
+  std::vector<int> channels;
+  int n_left;
+
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    for (int j = 0; j < local_array->n_io_group; j++)
+      groups.push_back(local_array->io_groups[j]);
+    if (local_array->drain_group)
+      groups.push_back(local_array->drain_group);
+  }
+  for (int i = 0; i < groups.size(); i++)
+  {
+    demands.push_back(autosa_array_ref_group_bw_demand(kernel, groups[i]));
+    channels.push_back(1);
+  }
+
+  n_left = n_channel - (int)groups.size();
+  while (n_left-- > 0)
+  {
+    int best = 0;
+    for (int i = 1; i < groups.size(); i++)
+      if (demands[i] / channels[i] > demands[best] / channels[best])
+        best = i;
+    channels[best]++;
+  }
+
+  for (int i = 0; i < groups.size(); i++)
+    if (groups[i] == group)
+      return channels[i];
+
+  return 1;
+}
+
+/* Return the largest number of HBM ports no greater than "n_port" such that
+ * the I/O loop with the upper bound "ub" is split evenly into more than one
+ * iteration per port.
+ */
+static int hbm_select_port_num(int n_port, int ub)
+{
+  for (int n = min(n_port, ub - 1); n > 1; n--)
+  {
+    if (ub % n == 0)
+      return n;
+  }
+
+  return 1;
+}
+
 /* Perform HBM/Multi-port DRAM optimization.
+ * In AUTO mode, if the number of HBM channels is specified, the number of
+ * ports of the group is selected based on its bandwidth demand.
  */
 static __isl_give isl_schedule_node *hbm_optimize(
     __isl_take isl_schedule_node *node,
@@ -1234,6 +1626,19 @@ static __isl_give isl_schedule_node *hbm_optimize(
      * We will pick up the tiling factors by default.
      */
     tile_size = read_default_hbm_tile_sizes(kernel, tile_len);
+    if (kernel->options->autosa->n_hbm_channel > 0)
+    {
+      int n_channel = hbm_assign_channels(kernel, group,
+                                          kernel->options->autosa->n_hbm_channel);
+      tile_size[0] = hbm_select_port_num(n_channel, ubs[0]);
+      if (tile_size[0] == 1)
+      {
+        printf("[AutoSA] A single HBM port is assigned, HBM optimization is omitted.\n");
+        free(tile_size);
+        free(ubs);
+        return node;
+      }
+    }
   }
   else
   {
@@ -1541,6 +1946,101 @@ isl_bool is_io_module_valid(
   return isl_bool_true;
 }
 
+/* Return the I/O direction used to cluster the io_L1 modules of the I/O group
+ * "group" with "space_dim" space loops.
+ * This is the direction of the group, which for the groups with interior
+ * I/O is assigned by autosa_interior_io_eliminate, or by
+ * group_array_references_drain for the drain groups.
+ */
+static __isl_give isl_vec *io_L1_dir(struct autosa_array_ref_group *group,
+                                     int space_dim, isl_ctx *ctx)
+{
+  isl_vec *dir;
+
+  if (!isl_vec_is_zero(group->dir))
+    return isl_vec_dup(group->dir);
+
+  dir = isl_vec_zero(ctx, space_dim);
+  dir = isl_vec_set_element_si(dir, 0, 1);
+
+  return dir;
+}
+
+/* Return the I/O module schedule in "data" computed for the I/O groups
+ * with the same io_L1 direction as the I/O group "group", or NULL if
+ * there is none.
+ */
+static struct autosa_io_schedule_memo *find_io_schedule_memo(
+    struct autosa_group_data *data, struct autosa_array_ref_group *group,
+    int space_dim, isl_ctx *ctx)
+{
+  struct autosa_io_schedule_memo *memo = NULL;
+  isl_vec *dir;
+
+  dir = io_L1_dir(group, space_dim, ctx);
+  for (int i = 0; i < data->n_io_sched; i++)
+  {
+    if (isl_vec_is_equal(data->io_sched[i].dir, dir) == isl_bool_true)
+    {
+      memo = &data->io_sched[i];
+      break;
+    }
+  }
+  isl_vec_free(dir);
+
+  return memo;
+}
+
+/* Store the I/O module schedule "schedule" computed for the I/O group
+ * "group" in "data".
+ */
+static void add_io_schedule_memo(struct autosa_group_data *data,
+                                 struct autosa_array_ref_group *group, __isl_take isl_schedule *schedule,
+                                 isl_ctx *ctx)
+{
+  struct autosa_io_schedule_memo *memo;
+
+  data->io_sched = (struct autosa_io_schedule_memo *)realloc(data->io_sched,
+                                                             (data->n_io_sched + 1) * sizeof(struct autosa_io_schedule_memo));
+  memo = &data->io_sched[data->n_io_sched++];
+  memo->dir = io_L1_dir(group, group->space_dim, ctx);
+  memo->schedule = schedule;
+  memo->io_L1_schedule = isl_schedule_copy(group->io_L1_schedule);
+  memo->io_L1_trans = isl_multi_aff_copy(group->io_L1_trans);
+  memo->io_trans = isl_multi_aff_copy(group->io_trans);
+  memo->io_level = group->io_level;
+}
+
+/* Can the I/O group "group" share its memory port with the other
+ * read-only I/O groups of the same array?
+ * The I/O groups of an array that are not merged by share_io feed
+ * the array in different directions or with different I/O types, and
+ * thus read the array tiles in different orders, each with its own
+ * I/O modules. Each of them still gets its own host buffer, holding
+ * a full copy of the array, which is transferred to the device for
+ * each group. If "--AutoSA-share-input" is set, the read-only groups
+ * with a single memory port all read from the same buffer instead,
+ * which is transferred once and placed in a single memory bank.
+ * The serialized arrays are not shared, since their layout depends on
+ * the order of the accesses of the group.
+ */
+static int shares_input_port(struct autosa_gen *gen,
+                             struct autosa_array_ref_group *group)
+{
+  if (!gen->options->autosa->share_input)
+    return 0;
+  if (gen->options->target != AUTOSA_TARGET_XILINX_HLS_C)
+    return 0;
+  if (gen->options->autosa->host_serialize)
+    return 0;
+  if (group->group_type != AUTOSA_IO_GROUP)
+    return 0;
+  if (!group->copy_in || group->copy_out || group->n_mem_ports != 1)
+    return 0;
+
+  return 1;
+}
+
 /* This function computes the schedule for the I/O modules that transfers
  * the data for the I/O group "group".
  * We will cluster I/O modules level by level. 
@@ -1565,11 +2065,16 @@ isl_bool is_io_module_valid(
  * Y
  * |
  * "PE" mark
+ *
+ * The clustering only depends on the io_L1 direction of the group.
+ * Unless HBM is used, the clustered schedule is stored in "data" and
+ * reused for the other groups with the same io_L1 direction.
  */
 static isl_stat compute_io_group_schedule(
     struct autosa_kernel *kernel, struct autosa_array_ref_group *group,
-    struct autosa_gen *gen)
+    struct autosa_gen *gen, struct autosa_group_data *data)
 {
+  struct autosa_io_schedule_memo *memo;
   isl_printer *p_str;
   char *io_str;
   int io_level = 0;
@@ -1594,6 +2099,21 @@ static isl_stat compute_io_group_schedule(
   space_dim = isl_schedule_node_band_n_member(node);
   group->space_dim = space_dim;
 
+  memo = NULL;
+  if (!gen->options->autosa->hbm)
+    memo = find_io_schedule_memo(data, group, space_dim, ctx);
+  if (memo)
+  {
+    isl_schedule_node_free(node);
+    node = isl_schedule_get_root(memo->schedule);
+    node = autosa_tree_move_down_to_kernel(node);
+    group->io_L1_schedule = isl_schedule_dup(memo->io_L1_schedule);
+    group->io_L1_trans = isl_multi_aff_copy(memo->io_L1_trans);
+    group->io_trans = isl_multi_aff_copy(memo->io_trans);
+    group->io_level = memo->io_level;
+    goto context;
+  }
+
   /* Insert the IO_L1 mark. */
   node = isl_schedule_node_child(node, 0);
   p_str = isl_printer_to_str(ctx);
@@ -1616,10 +2136,10 @@ static isl_stat compute_io_group_schedule(
     isl_mat *mat;
 
     /* Perform space-time transformation on the current band. */
-    if (i == space_dim - 1 && group->io_type == AUTOSA_EXT_IO)
+    if (i == space_dim - 1)
     {
-      /* For I/O L1 modules with exterior I/O, we use the default I/O direction. */
-      dir = isl_vec_dup(group->dir);
+      /* For I/O L1 modules, we use the I/O direction of the group. */
+      dir = io_L1_dir(group, space_dim, ctx);
     }
     else
     {
@@ -1740,6 +2260,16 @@ static isl_stat compute_io_group_schedule(
         printf("[AutoSA] HBM optimization failed! Not enough I/O modules.\n");
         goto next;
       }
+      /* With the on-chip drain merge, the drained results are collected
+       * by the drain modules and written through a single port, so that
+       * no merge of the port copies is left to the host. */
+      if (group->group_type == AUTOSA_DRAIN_GROUP &&
+          gen->options->autosa->on_chip_drain_merge)
+      {
+        printf("[AutoSA] The drain group of array %s is merged on-chip, HBM optimization is omitted.\n",
+               group->array->name);
+        goto next;
+      }
       node = hbm_optimize(node, &io_trans_ma, kernel, group, gen);
     }
   next:
@@ -1767,8 +2297,12 @@ static isl_stat compute_io_group_schedule(
   group->io_level = io_level;
   group->io_trans = io_trans_ma;
 
-  /* Insert the context node for the IO ids. */
   node = autosa_tree_move_up_to_kernel(node);
+  if (!gen->options->autosa->hbm)
+    add_io_schedule_memo(data, group, isl_schedule_node_get_schedule(node), ctx);
+
+context:
+  /* Insert the context node for the IO ids. */
   node = insert_io_module_context(node, group, gen, kernel);
   //#ifdef _DEBUG
   //  isl_printer *pd = isl_printer_to_file(ctx, stdout);
@@ -1792,8 +2326,26 @@ static isl_stat compute_io_group_schedule(
 
   if (group->copy_in || group->copy_out)
   {
-    group->mem_port_id = group->local_array->n_mem_ports;
-    group->local_array->n_mem_ports += group->n_mem_ports;
+    if (shares_input_port(gen, group))
+    {
+      struct autosa_local_array_info *local_array = group->local_array;
+      if (local_array->shared_in_port < 0)
+      {
+        local_array->shared_in_port = local_array->n_mem_ports;
+        local_array->n_mem_ports += group->n_mem_ports;
+      }
+      else if (gen->options->autosa->verbose)
+      {
+        printf("[AutoSA] An I/O group of array %s shares the memory port %d.\n",
+               group->array->name, local_array->shared_in_port);
+      }
+      group->mem_port_id = local_array->shared_in_port;
+    }
+    else
+    {
+      group->mem_port_id = group->local_array->n_mem_ports;
+      group->local_array->n_mem_ports += group->n_mem_ports;
+    }
   }
 
   /* Store the I/O schedule. */
@@ -1805,50 +2357,47 @@ static isl_stat compute_io_group_schedule(
   return isl_stat_ok;
 }
 
+/* Map the domain of the accesses "access" of "group" to the outer
+ * schedule dimensions at "node" and return the result.
+ * The accesses are consumed.
+ */
 static __isl_give isl_map *local_access_io_at_node(struct autosa_kernel *kernel,
                                                    struct autosa_array_ref_group *group,
-                                                   __isl_keep isl_union_map *access, __isl_keep isl_schedule_node *node)
+                                                   __isl_take isl_union_map *access, __isl_keep isl_schedule_node *node)
 {
-  isl_union_map *local, *sched;
+  isl_union_map *sched;
   isl_union_pw_multi_aff *contraction;
 
-  local = isl_union_map_copy(access);
   sched = prefix_with_equalities(node);
   // TODO: fix the contraction
   contraction = isl_schedule_node_get_subtree_contraction(node);
-  /* #ifdef _DEBUG
-  isl_printer *pd = isl_printer_to_file(isl_schedule_node_get_ctx(node), stdout);
-  pd = isl_printer_print_union_pw_multi_aff(pd, contraction);
-  pd = isl_printer_end_line(pd);
-  isl_printer_free(pd);
-#endif */
-
-  sched = expand(sched, contraction);
-  local = isl_union_map_apply_domain(local, sched);
-
-  isl_union_pw_multi_aff_free(contraction);
+  sched = isl_union_map_preimage_domain_union_pw_multi_aff(sched, contraction);
+  access = isl_union_map_apply_domain(access, sched);
 
-  return isl_map_from_union_map(local);
+  return isl_map_from_union_map(access);
 }
 
-/* Compute the local memory tiles for the drain group "group"
- * of array "array". Return isl_stat_ok on success and isl_stat_error on error.
+/* Compute the local memory tile of the group "group" at "node" and
+ * store it in "tile", or NULL if no tile can be found.
+ * The accesses of the group exclude the read accesses if "read" is not set.
+ * Return isl_stat_ok on success and isl_stat_error on error.
  *
  * If the array is a read-only scalar or if the user requested not to use local
  * memory, then we do not need to do anything.
+ *
+ * This function is evaluated for every I/O buffer of every design point
+ * during the exploration, hence the accesses are collected once and
+ * consumed in place instead of being copied at each step.
  */
-isl_stat compute_group_bounds_drain_at_node(struct autosa_kernel *kernel,
-                                            struct autosa_array_ref_group *group, __isl_keep isl_schedule_node *node,
-                                            struct autosa_io_buffer *buffer)
+static isl_stat compute_group_tile_at_node(struct autosa_kernel *kernel,
+                                           struct autosa_array_ref_group *group, __isl_keep isl_schedule_node *node,
+                                           int read, struct autosa_array_tile **tile)
 {
-  isl_ctx *ctx = isl_space_get_ctx(group->array->space);
-  int use_local = kernel->options->autosa->use_local_memory;
-  isl_stat r = isl_stat_ok;
-  isl_union_map *access;
+  isl_ctx *ctx;
   isl_map *acc;
   isl_bool ok;
 
-  if (!use_local)
+  if (!kernel->options->autosa->use_local_memory)
     return isl_stat_ok;
   if (autosa_array_is_read_only_scalar(group->array))
     return isl_stat_ok;
@@ -1857,32 +2406,32 @@ isl_stat compute_group_bounds_drain_at_node(struct autosa_kernel *kernel,
   if (group->slice)
     return isl_stat_ok;
 
-  /* Collect all accesses in the group. */
-  access = autosa_array_ref_group_access_relation(group, 0, 1);
-  /* Create local tile */
-  if (use_local)
-  {
-    /* Create a tile */
-    buffer->tile = autosa_array_tile_create(ctx, group->array->n_index);
-    /* Map the domain to the outer scheduling dimensions */
-    acc = local_access_io_at_node(kernel, group, access, node);
-    /* Collect the shift and scale factors of the tile */
-    ok = can_tile(acc, buffer->tile);
-    if (ok < 0)
-      r = isl_stat_error;
-    else if (!ok)
-      buffer->tile = autosa_array_tile_free(buffer->tile);
-    isl_map_free(acc);
-  }
-
-  if (r < 0)
-  {
-    isl_union_map_free(access);
-    return r;
-  }
+  ctx = isl_space_get_ctx(group->array->space);
+  /* Create a tile. */
+  *tile = autosa_array_tile_create(ctx, group->array->n_index);
+  /* Map the domain to the outer scheduling dimensions. */
+  acc = local_access_io_at_node(kernel, group,
+                                autosa_array_ref_group_access_relation(group, read, 1), node);
+  /* Collect the shift and scale factors of the tile. */
+  ok = can_tile(acc, *tile);
+  isl_map_free(acc);
+  if (!ok)
+    *tile = autosa_array_tile_free(*tile);
+
+  return ok < 0 ? isl_stat_error : isl_stat_ok;
+}
 
-  isl_union_map_free(access);
-  return isl_stat_ok;
+/* Compute the local memory tiles for the drain group "group"
+ * of array "array". Return isl_stat_ok on success and isl_stat_error on error.
+ *
+ * If the array is a read-only scalar or if the user requested not to use local
+ * memory, then we do not need to do anything.
+ */
+isl_stat compute_group_bounds_drain_at_node(struct autosa_kernel *kernel,
+                                            struct autosa_array_ref_group *group, __isl_keep isl_schedule_node *node,
+                                            struct autosa_io_buffer *buffer)
+{
+  return compute_group_tile_at_node(kernel, group, node, 0, &buffer->tile);
 }
 
 /* Should this array reference group be mapped to local or global
@@ -2102,48 +2651,7 @@ static isl_stat compute_group_bounds_drain_at_node_PE(
     struct autosa_kernel *kernel, struct autosa_array_ref_group *group,
     __isl_keep isl_schedule_node *node)
 {
-  isl_ctx *ctx = isl_space_get_ctx(group->array->space);
-  int use_local = kernel->options->autosa->use_local_memory;
-  isl_stat r = isl_stat_ok;
-  isl_union_map *access;
-  isl_map *acc;
-  isl_bool ok;
-
-  if (!use_local)
-    return isl_stat_ok;
-  if (autosa_array_is_read_only_scalar(group->array))
-    return isl_stat_ok;
-  if (!group->exact_write)
-    return isl_stat_ok;
-  if (group->slice)
-    return isl_stat_ok;
-
-  /* Collect all accesses in the group. */
-  access = autosa_array_ref_group_access_relation(group, 0, 1);
-  /* Create local tile. */
-  if (use_local)
-  {
-    /* Create a tile. */
-    group->pe_tile = autosa_array_tile_create(ctx, group->array->n_index);
-    /* Map the domain to the outer scheduling dimensions. */
-    acc = local_access_io_at_node(kernel, group, access, node);
-    /* Collect the shift and scale factors of the tile. */
-    ok = can_tile(acc, group->pe_tile);
-    if (ok < 0)
-      r = isl_stat_error;
-    else if (!ok)
-      group->pe_tile = autosa_array_tile_free(group->pe_tile);
-    isl_map_free(acc);
-  }
-
-  if (r < 0)
-  {
-    isl_union_map_free(access);
-    return r;
-  }
-
-  isl_union_map_free(access);
-  return isl_stat_ok;
+  return compute_group_tile_at_node(kernel, group, node, 0, &group->pe_tile);
 }
 
 /* Compute the drain group tiling at the PE level. */
@@ -2172,48 +2680,7 @@ isl_stat compute_group_bounds_io_at_node(struct autosa_kernel *kernel,
                                          struct autosa_array_ref_group *group, __isl_keep isl_schedule_node *node,
                                          struct autosa_io_buffer *buffer)
 {
-  isl_ctx *ctx = isl_space_get_ctx(group->array->space);
-  int use_local = kernel->options->autosa->use_local_memory;
-  isl_stat r = isl_stat_ok;
-  isl_union_map *access;
-  isl_map *acc;
-  isl_bool ok;
-
-  if (!use_local)
-    return isl_stat_ok;
-  if (autosa_array_is_read_only_scalar(group->array))
-    return isl_stat_ok;
-  if (!group->exact_write)
-    return isl_stat_ok;
-  if (group->slice)
-    return isl_stat_ok;
-
-  /* Collect all accesses in the group. */
-  access = autosa_array_ref_group_access_relation(group, 1, 1);
-  /* Create local tile. */
-  if (use_local)
-  {
-    /* Create a tile. */
-    buffer->tile = autosa_array_tile_create(ctx, group->array->n_index);
-    /* Map the domain to the outer scheduling dimensions. */
-    acc = local_access_io_at_node(kernel, group, access, node);
-    /* Collect the shift and scale factors of the tile. */
-    ok = can_tile(acc, buffer->tile);
-    if (ok < 0)
-      r = isl_stat_error;
-    else if (!ok)
-      buffer->tile = autosa_array_tile_free(buffer->tile);
-    isl_map_free(acc);
-  }
-
-  if (r < 0)
-  {
-    isl_union_map_free(access);
-    return r;
-  }
-
-  isl_union_map_free(access);
-  return isl_stat_ok;
+  return compute_group_tile_at_node(kernel, group, node, 1, &buffer->tile);
 }
 
 /* Compute the tiling group bounds for the io group at the PE level. */
@@ -2221,48 +2688,7 @@ isl_stat compute_group_bounds_io_at_node_PE(
     struct autosa_kernel *kernel,
     struct autosa_array_ref_group *group, __isl_keep isl_schedule_node *node)
 {
-  isl_ctx *ctx = isl_space_get_ctx(group->array->space);
-  int use_local = kernel->options->autosa->use_local_memory;
-  isl_stat r = isl_stat_ok;
-  isl_union_map *access;
-  isl_map *acc;
-  isl_bool ok;
-
-  if (!use_local)
-    return isl_stat_ok;
-  if (autosa_array_is_read_only_scalar(group->array))
-    return isl_stat_ok;
-  if (!group->exact_write)
-    return isl_stat_ok;
-  if (group->slice)
-    return isl_stat_ok;
-
-  /* Collect all accesses in the group. */
-  access = autosa_array_ref_group_access_relation(group, 1, 1);
-  /* Create local tile. */
-  if (use_local)
-  {
-    /* Create a tile. */
-    group->pe_tile = autosa_array_tile_create(ctx, group->array->n_index);
-    /* Map the domain to the outer scheduling dimensions. */
-    acc = local_access_io_at_node(kernel, group, access, node);
-    /* Collect the shift and scale factors of the tile. */
-    ok = can_tile(acc, group->pe_tile);
-    if (ok < 0)
-      r = isl_stat_error;
-    else if (!ok)
-      group->pe_tile = autosa_array_tile_free(group->pe_tile);
-    isl_map_free(acc);
-  }
-
-  if (r < 0)
-  {
-    isl_union_map_free(access);
-    return r;
-  }
-
-  isl_union_map_free(access);
-  return isl_stat_ok;
+  return compute_group_tile_at_node(kernel, group, node, 1, &group->pe_tile);
 }
 
 /* Create the tiling for the IO group at the PE level. */
@@ -2655,6 +3081,80 @@ static isl_bool update_group_simd(__isl_keep isl_schedule_node *node, void *user
   return isl_bool_true;
 }
 
+/* Is the last dimension of "array" a multiple of "n_lane"?
+ * The arrays with parametric sizes are assumed to be aligned.
+ */
+static isl_bool array_last_dim_is_divisible_by(struct autosa_array_info *array,
+                                              int n_lane)
+{
+  isl_pw_aff *bound;
+  isl_set *dom, *zero;
+  isl_bool divisible;
+
+  if (array->n_index == 0)
+    return isl_bool_true;
+  bound = isl_multi_pw_aff_get_pw_aff(array->bound, array->n_index - 1);
+  if (isl_pw_aff_is_cst(bound) != isl_bool_true)
+  {
+    isl_pw_aff_free(bound);
+    return isl_bool_true;
+  }
+  dom = isl_pw_aff_domain(isl_pw_aff_copy(bound));
+  bound = isl_pw_aff_mod_val(bound, isl_val_int_from_si(isl_pw_aff_get_ctx(bound), n_lane));
+  zero = isl_pw_aff_zero_set(bound);
+  divisible = isl_set_is_subset(dom, zero);
+  isl_set_free(dom);
+  isl_set_free(zero);
+
+  return divisible;
+}
+
+/* Return the maximal width in bits of the FIFOs connecting the I/O buffers
+ * of the array "array" at the I/O level position "pos", which is "pe" for
+ * the L1 buffers beside the PEs, "dram" for the outermost buffers next to
+ * the external memory, and "inner" for the levels in between.
+ * The width is read from the "data_pack" entry of the AutoSA configuration,
+ * e.g.,
+ *
+ *   "data_pack": {
+ *     "pe": 64, "inner": 256, "dram": 512,
+ *     "arrays": { "A": { "pe": 128 } }
+ *   }
+ *
+ * where the entries under "arrays" override the widths for single arrays.
+ * Return "def" if the width is not specified or invalid.
+ * The FIFOs are no wider than the DRAM ports of 512 bits.
+ */
+static int io_fifo_max_width(struct autosa_gen *gen,
+                             struct autosa_array_info *array, const char *pos, int def)
+{
+  cJSON *data_pack, *arrays, *width;
+
+  data_pack = cJSON_GetObjectItemCaseSensitive(gen->tuning_config, "data_pack");
+  if (!data_pack)
+    return def;
+  width = cJSON_GetObjectItemCaseSensitive(data_pack, pos);
+  arrays = cJSON_GetObjectItemCaseSensitive(data_pack, "arrays");
+  if (arrays)
+  {
+    cJSON *array_json = cJSON_GetObjectItemCaseSensitive(arrays, array->name);
+    cJSON *array_width = cJSON_GetObjectItemCaseSensitive(array_json, pos);
+    if (array_width)
+      width = array_width;
+  }
+  if (!width)
+    return def;
+  if (!cJSON_IsNumber(width) || width->valueint < 8 || width->valueint % 8 != 0 ||
+      width->valueint > 512)
+  {
+    printf("[AutoSA] Warning: Invalid FIFO width for array %s at the %s level, %d bits are used.\n",
+           array->name, pos, def);
+    return def;
+  }
+
+  return width->valueint;
+}
+
 /* Select the data pack factor for I/O buffers. The data pack factor
  * should be sub-multiples of the last dimension of the local array.
  * Meanwhile, it should also be sub-multiples of the data pack factors 
@@ -2717,18 +3217,26 @@ static isl_stat compute_io_group_data_pack(struct autosa_kernel *kernel,
    * Furthermore, for L1 buffers reside at the io_L1 level (beside PEs), we 
    * furtehr restrain the FIFO widths to be no more than 64 bits to mitigate 
    * the potential routing congestion.
-   * TODO: make these factors into autosa_config.
+   * These widths can be changed per level and per array in the AutoSA
+   * configuration (see io_fifo_max_width). The I/O modules convert the
+   * data between the widths of adjacent levels.
    */
   int cur_max_n_lane;
+  int pe_width = max(io_fifo_max_width(gen, group->array, "pe", 64),
+                     group->rebalance_width[0]);
+  int inner_width = max(io_fifo_max_width(gen, group->array, "inner", 256),
+                        group->rebalance_width[1]);
+  int dram_width = max(io_fifo_max_width(gen, group->array, "dram", 512),
+                       group->rebalance_width[2]);
   for (int i = 0; i < group->io_level; i++)
   {
     struct autosa_io_buffer *buf = group->io_buffers[i];
     if (i == 0)
-      cur_max_n_lane = max(group->n_lane, 8 / ele_size); // 64 bits
+      cur_max_n_lane = max(group->n_lane, pe_width / 8 / ele_size);
     else if (i > 0 && i < group->io_level - 1)
-      cur_max_n_lane = max(group->n_lane, 32 / ele_size); // 256 bits
+      cur_max_n_lane = max(group->n_lane, inner_width / 8 / ele_size);
     else
-      cur_max_n_lane = max(group->n_lane, 64 / ele_size); // 512 bits
+      cur_max_n_lane = max(group->n_lane, dram_width / 8 / ele_size);
     if (buf->tile)
     {
       int n_lane = cur_n_lane;
@@ -2740,7 +3248,9 @@ static isl_stat compute_io_group_data_pack(struct autosa_kernel *kernel,
         {
           isl_val *val = isl_val_int_from_si(gen->ctx, n_lane);
           /* The lane should be sub-multiples of the last dim of the array. */
-          if (isl_val_is_divisible_by(size, val))
+          if (isl_val_is_divisible_by(size, val) &&
+              (!kernel->padded_domain ||
+               array_last_dim_is_divisible_by(group->array, n_lane) == isl_bool_true))
           {
             cur_n_lane = n_lane;
             status = true;
@@ -2925,7 +3435,7 @@ static isl_stat autosa_io_optimize(
     struct autosa_gen *gen, struct autosa_group_data *data)
 {
   /* Update the I/O schedules by I/O module clustering. */
-  compute_io_group_schedule(kernel, group, gen);
+  compute_io_group_schedule(kernel, group, gen, data);
   /* Allocate I/O buffers inside I/O modules. */
   compute_io_group_buffer(kernel, group, gen);
   if (gen->options->autosa->two_level_buffer)
@@ -3290,7 +3800,8 @@ static int group_array_references_drain(struct autosa_kernel *kernel,
   int n;
   isl_ctx *ctx = isl_union_map_get_ctx(data->pe_sched);
   struct autosa_array_ref_group **groups = NULL;
-  isl_union_map *dep_waw = kernel->scop->tagged_dep_waw;
+  isl_union_map *dep_waw = ppcg_scop_get_tagged_dep_waw(kernel->scop,
+                                                         local->array->name);
 
   /* Populate the groups. */
   n = 0;
@@ -3340,8 +3851,6 @@ static int group_array_references_drain(struct autosa_kernel *kernel,
       group->io_type = AUTOSA_INT_IO;
       group->dir = isl_vec_zero(ctx, kernel->n_sa_dim);
       group->old_dir = isl_vec_zero(ctx, kernel->n_sa_dim);
-      /* Perform interior I/O elimination by default. */
-      group->dir = isl_vec_set_element_si(group->dir, 0, 1);
       group->group_type = AUTOSA_DRAIN_GROUP;
       group->pe_io_dir = IO_OUT;
       group->array_io_dir = IO_OUT;
@@ -3352,6 +3861,9 @@ static int group_array_references_drain(struct autosa_kernel *kernel,
       group->copy_schedule = NULL;
       group->pe_tile = NULL;
       group->n_mem_ports = 1;
+      /* Perform interior I/O elimination by default, along the same
+       * direction as the I/O groups of the array. */
+      set_interior_io_dir(group, interior_io_dim(kernel, local->array));
 
       groups = (struct autosa_array_ref_group **)realloc(groups, (++n) *
                                                                      sizeof(struct autosa_array_ref_group *));
@@ -3463,6 +3975,371 @@ static void compute_group_tilings_drain(struct autosa_kernel *kernel)
   }
 }
 
+/* Add the number of points of "set" to the counter "user",
+ * or set it to -1 if the number is not a constant.
+ */
+static isl_stat add_set_count(__isl_take isl_set *set, void *user)
+{
+  long *n = (long *)user;
+  isl_val *val;
+
+  val = isl_set_count_val(set);
+  if (*n >= 0 && isl_val_is_int(val) == isl_bool_true)
+    *n += isl_val_get_num_si(val);
+  else
+    *n = -1;
+  isl_val_free(val);
+  isl_set_free(set);
+
+  return isl_stat_ok;
+}
+
+/* Return the number of points of "set", or -1 if it is not a constant.
+ */
+static long union_set_count(__isl_take isl_union_set *set)
+{
+  long n = 0;
+
+  if (isl_union_set_foreach_set(set, &add_set_count, &n) < 0)
+    n = -1;
+  isl_union_set_free(set);
+
+  return n;
+}
+
+/* Return the relation mapping the domain elements of "kernel" to the
+ * array tiles, i.e., the iterations of the array partitioning loops above
+ * the "array" mark, that execute them.
+ */
+static __isl_give isl_union_map *kernel_array_tile_map(
+    struct autosa_kernel *kernel)
+{
+  isl_schedule_node *node;
+  isl_union_pw_multi_aff *prefix;
+  isl_union_map *tile;
+
+  node = isl_schedule_get_root(kernel->schedule);
+  node = autosa_tree_move_down_to_array(node, kernel->core);
+  prefix = isl_schedule_node_get_prefix_schedule_union_pw_multi_aff(node);
+  isl_schedule_node_free(node);
+  prefix = isl_union_pw_multi_aff_pullback_union_pw_multi_aff(prefix,
+                                                              isl_union_pw_multi_aff_copy(kernel->contraction));
+  tile = isl_union_map_from_union_pw_multi_aff(prefix);
+  tile = isl_union_map_intersect_domain(tile,
+                                        isl_union_set_copy(kernel->expanded_domain));
+
+  return tile;
+}
+
+/* Return the number of cycles the PEs of "kernel" spend on one array tile
+ * mapped by "tile", i.e., the domain elements of the kernel executed in
+ * one array tile, spread over the PEs and the SIMD lanes at one element
+ * per cycle. Return -1 if the numbers are not constant.
+ */
+static double io_rebalance_pe_cycles(struct autosa_kernel *kernel,
+                                     __isl_keep isl_union_map *tile)
+{
+  long n_elem, n_tile;
+  long n_pe = 1;
+
+  n_elem = union_set_count(isl_union_set_copy(kernel->expanded_domain));
+  n_tile = union_set_count(isl_union_map_range(isl_union_map_copy(tile)));
+  if (n_elem <= 0 || n_tile <= 0)
+    return -1;
+  for (int i = 0; i < kernel->n_sa_dim; i++)
+    n_pe *= kernel->sa_dim[i];
+
+  return (double)n_elem / n_tile / n_pe / kernel->simd_w;
+}
+
+/* Return the number of array elements transferred by the I/O or drain group
+ * "group" in one array tile mapped by "tile", i.e., the bounding box of the
+ * elements accessed by the group in the tile, or -1 if it has no constant
+ * size. Each element is assumed to be transferred once per array tile.
+ */
+static long io_group_tile_footprint(struct autosa_array_ref_group *group,
+                                    __isl_keep isl_union_map *tile)
+{
+  isl_union_map *access;
+  isl_map *map;
+  isl_fixed_box *box;
+  long size = -1;
+  int n;
+  int read = group->group_type != AUTOSA_DRAIN_GROUP;
+
+  access = autosa_io_group_access_relation(group, read, !read);
+  access = isl_union_map_apply_range(
+      isl_union_map_reverse(isl_union_map_copy(tile)), access);
+  if (isl_union_map_n_map(access) != 1)
+  {
+    isl_union_map_free(access);
+    return -1;
+  }
+  map = isl_map_from_union_map(access);
+  n = isl_map_dim(map, isl_dim_out);
+  box = isl_map_get_range_simple_fixed_box_hull(map);
+  if (isl_fixed_box_is_valid(box) == isl_bool_true)
+  {
+    isl_multi_val *mv = isl_fixed_box_get_size(box);
+    size = 1;
+    for (int i = 0; i < n; i++)
+    {
+      isl_val *val = isl_multi_val_get_val(mv, i);
+      size *= isl_val_get_num_si(val);
+      isl_val_free(val);
+    }
+    isl_multi_val_free(mv);
+  }
+  isl_fixed_box_free(box);
+  isl_map_free(map);
+
+  return size;
+}
+
+/* Return the lowest I/O level of "group" that is fed through a single
+ * chain. The outermost I/O module feeds the single chain of modules at the
+ * level below. Further down, each of these modules feeds its own chain,
+ * and the load is shared among them.
+ */
+static int io_group_first_chain_level(struct autosa_array_ref_group *group)
+{
+  return max(0, group->io_level - 2);
+}
+
+/* Return the name of the group "group" as printed in the code.
+ */
+static char *io_group_name(struct autosa_array_ref_group *group, isl_ctx *ctx)
+{
+  isl_printer *p_str;
+  char *name;
+
+  p_str = isl_printer_to_str(ctx);
+  p_str = autosa_array_ref_group_print_prefix(group, p_str);
+  name = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+
+  return name;
+}
+
+/* Rebalance the I/O or drain group "group" of "kernel" against the PEs,
+ * which consume (or produce) "demand" elements of the group per cycle.
+ * In steady state, each I/O module moves one packed word per cycle, i.e.,
+ * as many elements as the data pack factor of its buffer. Every level
+ * that is fed through a single chain and whose data pack factor is below
+ * the demand gets its maximal FIFO width raised to the smallest power of
+ * two covering the demand, up to the 512 bits of the DRAM ports, and the
+ * data pack factors of the group are recomputed. The data pack factors
+ * remain constrained by the tile sizes of the buffers.
+ * The changes are appended to "changes".
+ */
+static void io_rebalance_group(struct autosa_kernel *kernel,
+                               struct autosa_array_ref_group *group, struct autosa_gen *gen,
+                               double demand, cJSON *changes)
+{
+  int ele_size = group->array->size;
+  int raised = 0;
+  std::vector<int> old_lanes;
+  char *name;
+
+  for (int i = io_group_first_chain_level(group); i < group->io_level; i++)
+  {
+    struct autosa_io_buffer *buf = group->io_buffers[i];
+    int pos = i == 0 ? 0 : (i < group->io_level - 1 ? 1 : 2);
+    int n_lane = buf->n_lane;
+
+    if (n_lane >= demand)
+      continue;
+    while (n_lane < demand && n_lane * ele_size * 8 < 512)
+      n_lane *= 2;
+    if (n_lane * ele_size * 8 > group->rebalance_width[pos])
+    {
+      group->rebalance_width[pos] = n_lane * ele_size * 8;
+      raised = 1;
+    }
+  }
+  if (!raised)
+    return;
+
+  for (int i = 0; i < group->io_level; i++)
+    old_lanes.push_back(group->io_buffers[i]->n_lane);
+  compute_io_group_data_pack(kernel, group, gen, -1);
+
+  name = io_group_name(group, gen->ctx);
+  for (int i = 0; i < group->io_level; i++)
+  {
+    int n_lane = group->io_buffers[i]->n_lane;
+    cJSON *change;
+
+    if (n_lane == old_lanes[i])
+      continue;
+    change = cJSON_CreateObject();
+    cJSON_AddStringToObject(change, "group", name);
+    cJSON_AddNumberToObject(change, "level", i + 1);
+    cJSON_AddStringToObject(change, "action", "data_pack");
+    cJSON_AddNumberToObject(change, "from", old_lanes[i]);
+    cJSON_AddNumberToObject(change, "to", n_lane);
+    cJSON_AddItemToArray(changes, change);
+    printf("[AutoSA] I/O rebalancing: data pack of %s at level %d raised from %d to %d.\n",
+           name, i + 1, old_lanes[i], n_lane);
+  }
+  free(name);
+}
+
+/* Report the steady-state throughput of the I/O or drain group "group"
+ * against the "demand" of the PEs (both in elements per cycle) in "info".
+ * The group is limited by its slowest level fed through a single chain.
+ * If it can't keep up with the PEs, the remaining options are printed.
+ */
+static void io_rebalance_report_group(struct autosa_kernel *kernel,
+                                      struct autosa_array_ref_group *group, struct autosa_gen *gen,
+                                      double demand, cJSON *info)
+{
+  cJSON *levels;
+  int bottleneck = -1;
+  double rate = 0;
+
+  levels = cJSON_CreateArray();
+  for (int i = io_group_first_chain_level(group); i < group->io_level; i++)
+  {
+    int n_lane = group->io_buffers[i]->n_lane;
+    cJSON *level = cJSON_CreateObject();
+
+    cJSON_AddNumberToObject(level, "level", i + 1);
+    cJSON_AddNumberToObject(level, "data_pack", n_lane);
+    cJSON_AddNumberToObject(level, "elements_per_cycle", n_lane);
+    cJSON_AddItemToArray(levels, level);
+    if (bottleneck == -1 || n_lane < rate)
+    {
+      bottleneck = i;
+      rate = n_lane;
+    }
+  }
+  cJSON_AddItemToObject(info, "levels", levels);
+  if (bottleneck == -1)
+    return;
+  cJSON_AddNumberToObject(info, "bottleneck_level", bottleneck + 1);
+  cJSON_AddNumberToObject(info, "elements_per_cycle", rate);
+  cJSON_AddNumberToObject(info, "slowdown", rate < demand ? demand / rate : 1);
+
+  if (rate < demand)
+  {
+    char *name = io_group_name(group, gen->ctx);
+    const char *hint;
+
+    if (bottleneck == group->io_level - 1 &&
+        rate * group->array->size >= 64)
+      hint = "the DRAM port is saturated, spread the array over more memory ports (--AutoSA-hbm)";
+    else if (!gen->options->autosa->two_level_buffer && group->io_level > 1)
+      hint = "the data pack is limited by the tile sizes, try the L2 I/O buffers (--AutoSA-two-level-buffer) or larger array partitioning tiles";
+    else
+      hint = "the data pack is limited by the tile sizes, try larger array partitioning or latency hiding tiles";
+    cJSON_AddStringToObject(info, "suggestion", hint);
+    printf("[AutoSA] Warning: %s supplies %.2f elements/cycle at level %d, below the %.2f elements/cycle of the PEs (%.2fx slowdown): %s.\n",
+           name, rate, bottleneck + 1, demand, demand / rate, hint);
+    free(name);
+  }
+}
+
+/* Analyze the steady-state throughput of the I/O system of "kernel" and
+ * rebalance the I/O modules that can't keep up with the PEs.
+ * Per array tile, the PEs spend "cycles" cycles, see io_rebalance_pe_cycles,
+ * during which each I/O or drain group transfers its footprint in the tile.
+ * The ratio is the throughput that the I/O modules of the group need to
+ * sustain, compared to the data pack factors of their buffers.
+ * The analysis is run twice, with "final" unset before the data pack
+ * factors of the groups of the same array are aligned, to raise the data
+ * pack factors of the slow groups, and with "final" set afterwards, to
+ * report the resulting throughput in "io_rebalance.json" under the output
+ * directory. Return the report, to be passed to the second run in
+ * "report", which frees it.
+ */
+static cJSON *sa_io_rebalance(struct autosa_kernel *kernel,
+                              struct autosa_gen *gen, cJSON *report, int final)
+{
+  isl_union_map *tile;
+  double cycles;
+  cJSON *groups, *changes;
+
+  tile = kernel_array_tile_map(kernel);
+  cycles = io_rebalance_pe_cycles(kernel, tile);
+  if (!report)
+  {
+    report = cJSON_CreateObject();
+    cJSON_AddNumberToObject(report, "pe_cycles_per_tile", cycles);
+    cJSON_AddItemToObject(report, "groups", cJSON_CreateObject());
+    cJSON_AddItemToObject(report, "changes", cJSON_CreateArray());
+  }
+  groups = cJSON_GetObjectItemCaseSensitive(report, "groups");
+  changes = cJSON_GetObjectItemCaseSensitive(report, "changes");
+
+  for (int i = 0; i < kernel->n_array && cycles > 0; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+
+    for (int j = 0; j <= local_array->n_io_group; j++)
+    {
+      struct autosa_array_ref_group *group;
+      long footprint;
+      double demand;
+      char *name;
+      cJSON *info;
+
+      group = j < local_array->n_io_group ? local_array->io_groups[j] : local_array->drain_group;
+      if (!group || group->io_level == 0)
+        continue;
+      footprint = io_group_tile_footprint(group, tile);
+      if (footprint <= 0)
+        continue;
+      demand = footprint / cycles;
+      if (!final)
+      {
+        io_rebalance_group(kernel, group, gen, demand, changes);
+        continue;
+      }
+
+      name = io_group_name(group, gen->ctx);
+      info = cJSON_CreateObject();
+      cJSON_AddStringToObject(info, "array", group->array->name);
+      cJSON_AddNumberToObject(info, "elements_per_tile", footprint);
+      cJSON_AddNumberToObject(info, "demand_elements_per_cycle", demand);
+      io_rebalance_report_group(kernel, group, gen, demand, info);
+      cJSON_AddItemToObject(groups, name, info);
+      free(name);
+    }
+  }
+  isl_union_map_free(tile);
+
+  if (final)
+  {
+    isl_printer *p_str;
+    char *file_path, *json_str;
+    FILE *fp;
+
+    if (cycles <= 0)
+      printf("[AutoSA] Warning: The PE cycles per array tile are not constant, the I/O rebalancing is skipped.\n");
+    json_str = cJSON_Print(report);
+    p_str = isl_printer_to_str(gen->ctx);
+    p_str = isl_printer_print_str(p_str, gen->options->autosa->output_dir);
+    p_str = isl_printer_print_str(p_str, "/io_rebalance.json");
+    file_path = isl_printer_get_str(p_str);
+    isl_printer_free(p_str);
+    fp = fopen(file_path, "w");
+    if (!fp)
+    {
+      printf("[AutoSA] Error: Cannot open file: %s\n", file_path);
+      exit(1);
+    }
+    free(file_path);
+    fprintf(fp, "%s", json_str);
+    fclose(fp);
+    free(json_str);
+    cJSON_Delete(report);
+    report = NULL;
+  }
+
+  return report;
+}
+
 /* Group references of all arrays in "kernel".
  * Each array is associated with three types of groups:
  * PE group: Assign the local buffers inside PEs.
@@ -3477,6 +4354,7 @@ isl_stat sa_io_construct_optimize(struct autosa_kernel *kernel, struct autosa_ge
   struct autosa_group_data data;
   isl_schedule_node *node;
   isl_union_pw_multi_aff *contraction;
+  cJSON *rebalance = NULL;
 
   node = isl_schedule_get_root(kernel->schedule);
   node = autosa_tree_move_down_to_kernel(node);
@@ -3498,6 +4376,8 @@ isl_stat sa_io_construct_optimize(struct autosa_kernel *kernel, struct autosa_ge
   data.full_sched = isl_union_map_flat_range_product(data.full_sched,
                                                      isl_schedule_node_get_subtree_schedule_union_map(node));
   data.schedule = kernel->schedule;
+  data.n_io_sched = 0;
+  data.io_sched = NULL;
 
   /* Create the default array reference groups (PPCG heritage). */
   for (int i = 0; i < kernel->n_array; i++)
@@ -3509,9 +4389,12 @@ isl_stat sa_io_construct_optimize(struct autosa_kernel *kernel, struct autosa_ge
 
   /* Group the array references for the PE.
    * These groups will be used for allocate local buffers inside PEs.
+   * The irregular arrays are only accessed through their caches.
    */
   for (int i = 0; i < kernel->n_array; i++)
   {
+    if (kernel->array[i].array->irregular)
+      continue;
     r = group_array_references_pe(kernel, &kernel->array[i], &data);
     if (r < 0)
       break;
@@ -3520,6 +4403,8 @@ isl_stat sa_io_construct_optimize(struct autosa_kernel *kernel, struct autosa_ge
   /* Group the array references for the I/O modules. */
   for (int i = 0; i < kernel->n_array; i++)
   {
+    if (kernel->array[i].array->irregular)
+      continue;
     r = group_array_references_io(kernel, &kernel->array[i], &data);
     if (r < 0)
       break;
@@ -3528,11 +4413,17 @@ isl_stat sa_io_construct_optimize(struct autosa_kernel *kernel, struct autosa_ge
   /* Group the array references for the drain data */
   for (int i = 0; i < kernel->n_array; i++)
   {
+    if (kernel->array[i].array->irregular)
+      continue;
     r = group_array_references_drain(kernel, &kernel->array[i], &data);
     if (r < 0)
       break;
   }
 
+  /* Raise the data pack factors of the I/O modules slower than the PEs. */
+  if (gen->options->autosa->io_rebalance)
+    rebalance = sa_io_rebalance(kernel, gen, NULL, 0);
+
   /* Since different I/O groups of the same array will access the DRAM with the 
    * same global array pointer. We will need to make sure the outermost 
    * data packing factors are the same across these groups.
@@ -3586,14 +4477,39 @@ isl_stat sa_io_construct_optimize(struct autosa_kernel *kernel, struct autosa_ge
       }
     }
 
+    if (local_array->array->irregular)
+    {
+      /* The array is read by the PEs through its cache, which accesses
+       * the external memory through a single port, element by element.
+       */
+      n_lane = 1;
+      local_array->global = 1;
+      local_array->array->global = 1;
+      local_array->n_mem_ports = 1;
+      printf("[AutoSA] The irregular accesses to the array %s are served by a cache.\n",
+             local_array->array->name);
+    }
+
     local_array->n_lane = n_lane;
     local_array->array->n_lane = n_lane;
   }
 
+  if (gen->options->autosa->io_rebalance)
+    sa_io_rebalance(kernel, gen, rebalance, 1);
+
   isl_union_map_free(data.host_sched);
   isl_union_map_free(data.copy_sched);
   isl_union_map_free(data.full_sched);
   isl_union_map_free(data.pe_sched);
+  for (int i = 0; i < data.n_io_sched; i++)
+  {
+    isl_vec_free(data.io_sched[i].dir);
+    isl_schedule_free(data.io_sched[i].schedule);
+    isl_schedule_free(data.io_sched[i].io_L1_schedule);
+    isl_multi_aff_free(data.io_sched[i].io_L1_trans);
+    isl_multi_aff_free(data.io_sched[i].io_trans);
+  }
+  free(data.io_sched);
   isl_schedule_node_free(node);
 
   /* Compute a tiling for all the array reference groups in "kernel". */
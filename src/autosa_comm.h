@@ -70,5 +70,7 @@ isl_bool is_io_module_valid(
   __isl_keep isl_schedule_node *node,  
   struct autosa_kernel *kernel, 
   struct autosa_array_ref_group *group, int read);  
+double autosa_array_ref_group_bw_demand(struct autosa_kernel *kernel,
+  struct autosa_array_ref_group *group);
 
 #endif
\ No newline at end of file
@@ -1,11 +1,18 @@
 /* Defines functions used for AutoSA structs. */
 
+#include <map>
+#include <string>
+#include <utility>
+
 #include <isl/id.h>
+#include <isl/polynomial.h>
 #include <cJSON/cJSON.h>
 
 #include "autosa_common.h"
 #include "autosa_utils.h"
 #include "autosa_print.h"
+#include "autosa_comm.h"
+#include "autosa_schedule_tree.h"
 
 /****************************************************************
  * AutoSA kernel
@@ -18,8 +25,10 @@ void *autosa_kernel_free(struct autosa_kernel *kernel)
 
   isl_schedule_free(kernel->schedule);
   isl_ast_node_free(kernel->tree);
+  isl_ast_node_free(kernel->cuda_tree);
   isl_union_map_free(kernel->sizes);
   isl_union_map_free(kernel->used_sizes);
+  cJSON_Delete(kernel->tuning);
   isl_union_set_free(kernel->core);
   isl_set_free(kernel->context);
   isl_multi_pw_aff_free(kernel->sa_grid_size);
@@ -30,6 +39,7 @@ void *autosa_kernel_free(struct autosa_kernel *kernel)
   isl_id_list_free(kernel->thread_ids);
   isl_id_list_free(kernel->pe_ids);
   isl_union_set_free(kernel->pe_filter);
+  isl_union_set_free(kernel->fused_init);
   isl_multi_pw_aff_free(kernel->grid_size);
   isl_ast_expr_free(kernel->grid_size_expr);
   isl_union_pw_multi_aff_free(kernel->contraction);
@@ -62,6 +72,8 @@ void *autosa_kernel_free(struct autosa_kernel *kernel)
     isl_vec_free(kernel->var[i].size);
   }
   free(kernel->var);
+  free(kernel->runtime_tile_ub);
+  free(kernel->runtime_tile_size);
 
   free(kernel);
   return NULL;
@@ -81,6 +93,21 @@ struct autosa_kernel *autosa_kernel_copy(struct autosa_kernel *kernel)
   {
     kernel_dup->sa_dim[i] = kernel->sa_dim[i];
   }
+  kernel_dup->n_runtime_tile = kernel->n_runtime_tile;
+  kernel_dup->runtime_tile_ub = NULL;
+  kernel_dup->runtime_tile_size = NULL;
+  if (kernel->n_runtime_tile > 0)
+  {
+    kernel_dup->runtime_tile_ub = (int *)malloc(kernel->n_runtime_tile * sizeof(int));
+    kernel_dup->runtime_tile_size = (int *)malloc(kernel->n_runtime_tile * sizeof(int));
+    for (int i = 0; i < kernel->n_runtime_tile; i++)
+    {
+      kernel_dup->runtime_tile_ub[i] = kernel->runtime_tile_ub[i];
+      kernel_dup->runtime_tile_size[i] = kernel->runtime_tile_size[i];
+    }
+  }
+  kernel_dup->padded_domain = kernel->padded_domain;
+  kernel_dup->n_pe_idle = kernel->n_pe_idle;
   kernel_dup->array_part_w = kernel->array_part_w;
   kernel_dup->space_w = kernel->space_w;
   kernel_dup->time_w = kernel->time_w;
@@ -88,6 +115,7 @@ struct autosa_kernel *autosa_kernel_copy(struct autosa_kernel *kernel)
   kernel_dup->sa_grid_size = isl_multi_pw_aff_copy(kernel->sa_grid_size);
   kernel_dup->sizes = isl_union_map_copy(kernel->sizes);
   kernel_dup->used_sizes = isl_union_map_copy(kernel->used_sizes);
+  kernel_dup->tuning = NULL;
   kernel_dup->id = kernel->id;
   kernel_dup->space_time_id = kernel->space_time_id;
   kernel_dup->core = isl_union_set_copy(kernel->core);
@@ -98,12 +126,14 @@ struct autosa_kernel *autosa_kernel_copy(struct autosa_kernel *kernel)
   kernel_dup->copy_schedule_dim = kernel->copy_schedule_dim;
   kernel_dup->space = isl_space_copy(kernel->space);
   kernel_dup->tree = isl_ast_node_copy(kernel->tree);
+  kernel_dup->cuda_tree = isl_ast_node_copy(kernel->cuda_tree);
   kernel_dup->n_var = kernel->n_var;
   kernel_dup->var = kernel->var;
   kernel_dup->block_ids = isl_id_list_copy(kernel->block_ids);
   kernel_dup->thread_ids = isl_id_list_copy(kernel->thread_ids);
   kernel_dup->pe_ids = isl_id_list_copy(kernel->pe_ids);
   kernel_dup->pe_filter = isl_union_set_copy(kernel->pe_filter);
+  kernel_dup->fused_init = isl_union_set_copy(kernel->fused_init);
   kernel_dup->n_grid = kernel->n_grid;
   kernel_dup->n_block = kernel->n_block;
   for (int i = 0; i < kernel->n_grid; i++)
@@ -137,6 +167,11 @@ struct autosa_kernel *autosa_kernel_from_schedule(__isl_take isl_schedule *sched
   kernel->prog = NULL;
   kernel->options = NULL;
   kernel->n_sa_dim = 0;
+  kernel->n_runtime_tile = 0;
+  kernel->runtime_tile_ub = NULL;
+  kernel->runtime_tile_size = NULL;
+  kernel->padded_domain = 0;
+  kernel->n_pe_idle = 0;
   kernel->array_part_w = 0;
   kernel->space_w = 0;
   kernel->time_w = 0;
@@ -144,6 +179,7 @@ struct autosa_kernel *autosa_kernel_from_schedule(__isl_take isl_schedule *sched
   kernel->sa_grid_size = NULL;
   kernel->sizes = NULL;
   kernel->used_sizes = NULL;
+  kernel->tuning = NULL;
   kernel->id = 0;
   kernel->core = NULL;
   kernel->arrays = NULL;
@@ -153,12 +189,14 @@ struct autosa_kernel *autosa_kernel_from_schedule(__isl_take isl_schedule *sched
   kernel->copy_schedule_dim = -1;
   kernel->space = NULL;
   kernel->tree = NULL;
+  kernel->cuda_tree = NULL;
   kernel->n_var = 0;
   kernel->var = NULL;
   kernel->block_ids = NULL;
   kernel->thread_ids = NULL;
   kernel->pe_ids = NULL;
   kernel->pe_filter = NULL;
+  kernel->fused_init = NULL;
   kernel->n_grid = 0;
   kernel->n_block = 0;
   kernel->grid_size = NULL;
@@ -191,6 +229,11 @@ struct autosa_kernel *autosa_kernel_alloc(isl_ctx *ctx, struct ppcg_scop *scop)
   kernel->prog = NULL;
   kernel->options = NULL;
   kernel->n_sa_dim = 0;
+  kernel->n_runtime_tile = 0;
+  kernel->runtime_tile_ub = NULL;
+  kernel->runtime_tile_size = NULL;
+  kernel->padded_domain = 0;
+  kernel->n_pe_idle = 0;
   kernel->array_part_w = 0;
   kernel->space_w = 0;
   kernel->time_w = 0;
@@ -198,6 +241,7 @@ struct autosa_kernel *autosa_kernel_alloc(isl_ctx *ctx, struct ppcg_scop *scop)
   kernel->sa_grid_size = NULL;
   kernel->sizes = NULL;
   kernel->used_sizes = NULL;
+  kernel->tuning = NULL;
   kernel->id = 0;
   kernel->core = NULL;
   kernel->arrays = NULL;
@@ -207,12 +251,14 @@ struct autosa_kernel *autosa_kernel_alloc(isl_ctx *ctx, struct ppcg_scop *scop)
   kernel->copy_schedule_dim = -1;
   kernel->space = NULL;
   kernel->tree = NULL;
+  kernel->cuda_tree = NULL;
   kernel->n_var = 0;
   kernel->var = NULL;
   kernel->block_ids = NULL;
   kernel->thread_ids = NULL;
   kernel->pe_ids = NULL;
   kernel->pe_filter = NULL;
+  kernel->fused_init = NULL;
   kernel->n_grid = 0;
   kernel->n_block = 0;
   kernel->grid_size = NULL;
@@ -312,6 +358,36 @@ isl_bool access_is_stride_zero(__isl_keep isl_map *access, int pos)
   return zero;
 }
 
+/* Check if the "access" is invariant along the schedule dimension "pos".
+ * The access is already transformed to scheduling domains.
+ * We create a mapping "map" that maps the array elements accessed by the
+ * current iteration to the elements accessed by the next iteration along
+ * dimension "pos", and examine if it is a subset of the identity mapping
+ * on the array elements.
+ */
+isl_bool access_is_invariant(__isl_keep isl_map *access, int pos)
+{
+  isl_space *space;
+  isl_map *same_element, *map, *next_iter;
+  isl_bool invariant;
+
+  space = isl_map_get_space(access);
+  space = isl_space_range(space);
+  same_element = same(space);
+
+  space = isl_map_get_space(access);
+  space = isl_space_domain(space);
+  next_iter = next(space, pos);
+  map = isl_map_apply_domain(next_iter, isl_map_copy(access));
+  map = isl_map_apply_range(map, isl_map_copy(access));
+  invariant = isl_map_is_subset(map, same_element);
+
+  isl_map_free(same_element);
+  isl_map_free(map);
+
+  return invariant;
+}
+
 /* Check is the "access" has stride-1 access at dim "pos".
  * The access is already transformed to scheduling domains. 
  * We first create a mapping "next_element"that maps the accessed 
@@ -452,6 +528,7 @@ static void free_array_info(struct autosa_prog *prog)
   for (i = 0; i < prog->n_array; ++i)
   {
     free(prog->array[i].type);
+    free(prog->array[i].hls_type);
     free(prog->array[i].name);
     isl_multi_pw_aff_free(prog->array[i].bound);
     isl_ast_expr_free(prog->array[i].bound_expr);
@@ -635,6 +712,14 @@ static isl_stat extract_array_info(struct autosa_prog *prog,
 
   info->type = strdup(pa->element_type);
   info->size = pa->element_size;
+  info->hls_type = autosa_hls_data_type(prog->scop->options, info->type);
+  if (info->hls_type &&
+      autosa_hls_data_type_width(info->hls_type) != info->size * 8)
+  {
+    printf("[AutoSA] Error: Unsupported HLS data type %s for %s (%d bytes).\n",
+           info->hls_type, info->type, info->size);
+    exit(1);
+  }
   info->local = pa->declared && !pa->exposed;
   info->has_compound_element = pa->element_is_record;
   info->read_only_scalar = is_read_only_scalar(info, prog);
@@ -666,6 +751,14 @@ static isl_stat extract_array_info(struct autosa_prog *prog,
   info->local_array = NULL;
   info->copy_in = 0;
   info->copy_out = 0;
+  info->irregular = 0;
+  if (prog->scop->irregular_arrays)
+  {
+    info->irregular = isl_union_set_contains(prog->scop->irregular_arrays,
+                                             info->space);
+    if (info->irregular < 0)
+      return isl_stat_error;
+  }
   /* AutoSA Extended */
 
   return isl_stat_ok;
@@ -1330,6 +1423,8 @@ void autosa_kernel_stmt_free(void *user)
     break;
   case AUTOSA_KERNEL_STMT_DOMAIN:
     isl_id_to_ast_expr_free(stmt->u.d.ref2expr);
+    isl_ast_expr_free(stmt->u.d.guard);
+    isl_ast_expr_free(stmt->u.d.init);
     break;
   case AUTOSA_KERNEL_STMT_SYNC:
     break;
@@ -1520,6 +1615,16 @@ struct autosa_hw_module *autosa_hw_module_alloc(struct autosa_gen *gen)
   return module;
 }
 
+/* Return 1 if the I/O module is split into the outer loops and the
+ * inter_trans/intra_trans functions.
+ * This is the case for the filter + buffer modules, and for the buffered
+ * modules at the outermost level when they are double-buffered.
+ */
+int autosa_hw_module_is_split(struct autosa_hw_module *module)
+{
+  return module->is_buffer && (module->is_filter || module->double_buffer);
+}
+
 void *autosa_hw_module_free(struct autosa_hw_module *module)
 {
   if (!module)
@@ -1719,10 +1824,221 @@ struct autosa_ast_node_userinfo *alloc_ast_node_userinfo()
           struct autosa_ast_node_userinfo));
   info->is_pipeline = 0;
   info->is_unroll = 0;
+  info->iter_bits = 0;
+  info->iter_signed = 0;
 
   return info;
 }
 
+/* Return the number of iterations of the for node "node" if it iterates
+ * from 0 with a step of 1 up to a constant bound, or -1 otherwise.
+ */
+long autosa_ast_node_for_n_iter(__isl_keep isl_ast_node *node)
+{
+  isl_ast_expr *init, *inc, *cond, *ub;
+  isl_val *v_init, *v_inc, *v_ub;
+  long n = -1;
+
+  init = isl_ast_node_for_get_init(node);
+  inc = isl_ast_node_for_get_inc(node);
+  cond = isl_ast_node_for_get_cond(node);
+  if (isl_ast_expr_get_type(init) != isl_ast_expr_int ||
+      isl_ast_expr_get_type(inc) != isl_ast_expr_int ||
+      isl_ast_expr_get_type(cond) != isl_ast_expr_op)
+  {
+    isl_ast_expr_free(init);
+    isl_ast_expr_free(inc);
+    isl_ast_expr_free(cond);
+    return -1;
+  }
+
+  ub = isl_ast_expr_get_op_arg(cond, 1);
+  v_init = isl_ast_expr_get_val(init);
+  v_inc = isl_ast_expr_get_val(inc);
+  if (isl_val_is_zero(v_init) && isl_val_is_one(v_inc) &&
+      isl_ast_expr_get_type(ub) == isl_ast_expr_int)
+  {
+    v_ub = isl_ast_expr_get_val(ub);
+    if (isl_ast_expr_get_op_type(cond) == isl_ast_op_lt)
+      n = isl_val_get_num_si(v_ub);
+    else if (isl_ast_expr_get_op_type(cond) == isl_ast_op_le)
+      n = isl_val_get_num_si(v_ub) + 1;
+    isl_val_free(v_ub);
+  }
+  isl_val_free(v_init);
+  isl_val_free(v_inc);
+  isl_ast_expr_free(ub);
+  isl_ast_expr_free(init);
+  isl_ast_expr_free(inc);
+  isl_ast_expr_free(cond);
+
+  return n;
+}
+
+/* Examine if the for node "node" is the outermost loop of a perfect nest
+ * of at least two loops ending at the "hls_pipeline" mark, i.e., if each
+ * loop of the nest iterates from 0 with a step of 1 up to a constant bound,
+ * and its body consists of the next loop only, except for the innermost
+ * loop, whose body is the mark.
+ * If so, store the loops from outermost to innermost in "loops" and their
+ * numbers of iterations in "n_iters", and return the mark.
+ */
+__isl_give isl_ast_node *autosa_ast_node_extract_flatten_nest(
+    __isl_keep isl_ast_node *node, std::vector<isl_ast_node *> &loops,
+    std::vector<long> &n_iters)
+{
+  isl_ast_node *cur = isl_ast_node_copy(node);
+
+  while (1)
+  {
+    isl_ast_node *body;
+    long n = autosa_ast_node_for_n_iter(cur);
+
+    if (n <= 0)
+    {
+      isl_ast_node_free(cur);
+      break;
+    }
+    loops.push_back(cur);
+    n_iters.push_back(n);
+    body = isl_ast_node_for_get_body(cur);
+    if (isl_ast_node_get_type(body) == isl_ast_node_block)
+    {
+      isl_ast_node_list *list = isl_ast_node_block_get_children(body);
+      if (isl_ast_node_list_n_ast_node(list) == 1)
+      {
+        isl_ast_node_free(body);
+        body = isl_ast_node_list_get_ast_node(list, 0);
+      }
+      isl_ast_node_list_free(list);
+    }
+    if (isl_ast_node_get_type(body) == isl_ast_node_mark)
+    {
+      isl_id *id = isl_ast_node_mark_get_id(body);
+      int pipeline = !strcmp(isl_id_get_name(id), "hls_pipeline");
+      isl_id_free(id);
+      if (pipeline && loops.size() > 1)
+        return body;
+      isl_ast_node_free(body);
+      break;
+    }
+    if (isl_ast_node_get_type(body) != isl_ast_node_for)
+    {
+      isl_ast_node_free(body);
+      break;
+    }
+    cur = body;
+  }
+
+  for (int i = 0; i < loops.size(); i++)
+    isl_ast_node_free(loops[i]);
+  loops.clear();
+  n_iters.clear();
+
+  return NULL;
+}
+
+/* Return k if "expr" is the integer 2^k, or -1 otherwise.
+ */
+static int ast_expr_log2(__isl_keep isl_ast_expr *expr)
+{
+  isl_val *val;
+  long v;
+  int k;
+
+  if (isl_ast_expr_get_type(expr) != isl_ast_expr_int)
+    return -1;
+  val = isl_ast_expr_get_val(expr);
+  v = isl_val_is_int(val) ? isl_val_get_num_si(val) : 0;
+  isl_val_free(val);
+  if (v <= 0 || (v & (v - 1)) != 0)
+    return -1;
+  for (k = 0; (1L << k) < v; k++)
+    ;
+
+  return k;
+}
+
+/* Replace the divisions and remainders by powers of two in the index
+ * expression "expr" with shifts and masks, which don't need to correct
+ * the result for negative operands as the signed "int" divisions do.
+ * This applies to
+ * - the exact divisions, which are exact as shifts as well;
+ * - the divisions and remainders of non-negative operands (pdiv_q and
+ *   pdiv_r);
+ * - the remainders that are only compared to zero (zdiv_r).
+ * The rounding divisions of operands of unknown sign (fdiv_q) are kept.
+ * As the isl AST can't express shifts, the reduced subexpressions are
+ * printed to identifiers.
+ */
+__isl_give isl_ast_expr *autosa_ast_expr_strength_reduce(
+    __isl_take isl_ast_expr *expr)
+{
+  enum isl_ast_op_type op;
+  isl_ast_expr *arg;
+  isl_printer *p_str;
+  isl_ctx *ctx;
+  char *str;
+  int n_arg, k;
+
+  if (!expr || isl_ast_expr_get_type(expr) != isl_ast_expr_op)
+    return expr;
+
+  n_arg = isl_ast_expr_get_op_n_arg(expr);
+  for (int i = 0; i < n_arg; i++)
+  {
+    arg = isl_ast_expr_get_op_arg(expr, i);
+    arg = autosa_ast_expr_strength_reduce(arg);
+    expr = isl_ast_expr_set_op_arg(expr, i, arg);
+  }
+
+  op = isl_ast_expr_get_op_type(expr);
+  if (op != isl_ast_op_div && op != isl_ast_op_pdiv_q &&
+      op != isl_ast_op_pdiv_r && op != isl_ast_op_zdiv_r)
+    return expr;
+  arg = isl_ast_expr_get_op_arg(expr, 1);
+  k = ast_expr_log2(arg);
+  isl_ast_expr_free(arg);
+  if (k < 0 || k >= 31)
+    return expr;
+
+  arg = isl_ast_expr_get_op_arg(expr, 0);
+  ctx = isl_ast_expr_get_ctx(expr);
+  if (k == 0)
+  {
+    isl_ast_expr_free(expr);
+    if (op == isl_ast_op_div || op == isl_ast_op_pdiv_q)
+      return arg;
+    isl_ast_expr_free(arg);
+    return isl_ast_expr_from_val(isl_val_zero(ctx));
+  }
+
+  p_str = isl_printer_to_str(ctx);
+  p_str = isl_printer_set_output_format(p_str, ISL_FORMAT_C);
+  p_str = isl_printer_print_str(p_str, "((");
+  p_str = isl_printer_print_ast_expr(p_str, arg);
+  if (op == isl_ast_op_div || op == isl_ast_op_pdiv_q)
+  {
+    p_str = isl_printer_print_str(p_str, ") >> ");
+    p_str = isl_printer_print_int(p_str, k);
+  }
+  else
+  {
+    p_str = isl_printer_print_str(p_str, ") & ");
+    p_str = isl_printer_print_int(p_str, (1 << k) - 1);
+  }
+  p_str = isl_printer_print_str(p_str, ")");
+  str = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  isl_ast_expr_free(arg);
+  isl_ast_expr_free(expr);
+
+  expr = isl_ast_expr_from_id(isl_id_alloc(ctx, str, NULL));
+  free(str);
+
+  return expr;
+}
+
 /****************************************************************
  * AutoSA PE opt
  ****************************************************************/
@@ -1866,6 +2182,52 @@ error:
   return NULL;
 }
 
+/* Extract the user specified dimension of the space loops from which
+ * the interior I/O of the I/O groups named "name" is fed, i.e.,
+ * "kernel[0]->io_dir_<array>[dim]" in the "sa_sizes" command line option.
+ * Return -1 if not specified.
+ */
+int read_io_dir_size(struct autosa_kernel *sa, char *name)
+{
+  int dim;
+  isl_set *size;
+
+  size = extract_sa_sizes(sa->sizes, name, sa->id);
+  if (isl_set_dim(size, isl_dim_set) < 1)
+  {
+    isl_set_free(size);
+    return -1;
+  }
+  if (read_sa_sizes_from_set(size, &dim, 1) < 0)
+    return -1;
+  set_sa_used_sizes(sa, name, sa->id, &dim, 1);
+
+  return dim;
+}
+
+/* Extract the user specified depth of the credit control between
+ * the I/O modules reading and writing the array named "name", i.e.,
+ * "kernel[0]->credit_<array>[depth]" in the "sa_sizes" command line option.
+ * Return -1 if not specified.
+ */
+int read_credit_size(struct autosa_kernel *sa, char *name)
+{
+  int depth;
+  isl_set *size;
+
+  size = extract_sa_sizes(sa->sizes, name, sa->id);
+  if (isl_set_dim(size, isl_dim_set) < 1)
+  {
+    isl_set_free(size);
+    return -1;
+  }
+  if (read_sa_sizes_from_set(size, &depth, 1) < 0)
+    return -1;
+  set_sa_used_sizes(sa, name, sa->id, &depth, 1);
+
+  return depth;
+}
+
 int *read_default_hbm_tile_sizes(struct autosa_kernel *sa, int tile_len)
 {
   int n;
@@ -1914,6 +2276,50 @@ error:
   return NULL;
 }
 
+/* Read the order of the array partitioning loops from the "array_part_order"
+ * entry of the "--sa-sizes" option, i.e., the list of the original positions
+ * of the loops from the outermost to the innermost.
+ * Return NULL if the order is not specified or is not a permutation of
+ * the "tile_len" loops.
+ */
+int *read_array_part_order(struct autosa_kernel *sa, int tile_len)
+{
+  int *order;
+  isl_set *size;
+  std::vector<bool> used(tile_len, false);
+
+  size = extract_sa_sizes(sa->sizes, "array_part_order", sa->id);
+  if (isl_set_dim(size, isl_dim_set) < tile_len)
+  {
+    isl_set_free(size);
+    return NULL;
+  }
+  order = isl_alloc_array(sa->ctx, int, tile_len);
+  if (!order)
+  {
+    isl_set_free(size);
+    return NULL;
+  }
+  if (read_sa_sizes_from_set(size, order, tile_len) < 0)
+  {
+    free(order);
+    return NULL;
+  }
+  for (int i = 0; i < tile_len; i++)
+  {
+    if (order[i] < 0 || order[i] >= tile_len || used[order[i]])
+    {
+      printf("[AutoSA] Warning: The order of the array partitioning loops is not a permutation. The original order is kept.\n");
+      free(order);
+      return NULL;
+    }
+    used[order[i]] = true;
+  }
+  set_sa_used_sizes(sa, "array_part_order", sa->id, order, tile_len);
+
+  return order;
+}
+
 int *read_default_array_part_tile_sizes(struct autosa_kernel *sa, int tile_len)
 {
   int n;
@@ -1962,16 +2368,64 @@ error:
   return NULL;
 }
 
-int *read_default_latency_tile_sizes(struct autosa_kernel *sa, int tile_len)
+/* Return the default latency hiding tile sizes of the "tile_len" candidate
+ * loops with upper bounds "ubs".
+ * The latency hiding loops should cover the latency of the loop-carried
+ * updates of the PEs for these to be pipelined with II=1.
+ * Starting from the innermost candidate loop, select the smallest divisor
+ * of the loop bound that covers the remaining latency, and leave the
+ * outer loops untiled once the latency is covered.
+ * If the kernel has no loop-carried updates, or if the loop bounds are
+ * unknown, fall back to half of the default array tile size.
+ */
+int *read_default_latency_tile_sizes(struct autosa_kernel *sa, int tile_len,
+                                     int *ubs)
 {
   int n;
   int *tile_size;
+  int lat, remain;
 
   tile_size = isl_alloc_array(sa->ctx, int, tile_len);
   if (!tile_size)
     return NULL;
+
+  lat = autosa_kernel_update_latency(sa);
   for (n = 0; n < tile_len; ++n)
-    tile_size[n] = sa->scop->options->autosa->sa_tile_size / 2;
+  {
+    if (!ubs || ubs[n] <= 0)
+      break;
+  }
+  if (lat <= 1 || n < tile_len)
+  {
+    for (n = 0; n < tile_len; ++n)
+      tile_size[n] = sa->scop->options->autosa->sa_tile_size / 2;
+    return tile_size;
+  }
+
+  remain = lat;
+  for (n = tile_len - 1; n >= 0; --n)
+  {
+    int factor;
+
+    if (remain <= 1)
+    {
+      tile_size[n] = 1;
+      continue;
+    }
+    for (factor = remain; factor < ubs[n]; factor++)
+    {
+      if (ubs[n] % factor == 0)
+        break;
+    }
+    factor = min(factor, ubs[n]);
+    tile_size[n] = factor;
+    remain = (remain + factor - 1) / factor;
+  }
+
+  if (sa->scop->options->autosa->verbose)
+    printf("[AutoSA] Select the latency hiding tile sizes to cover the update latency of %d cycles.\n", lat);
+  if (remain > 1)
+    printf("[AutoSA] Warning: The latency hiding loops can't cover the update latency of %d cycles, the PEs won't achieve II=1.\n", lat);
 
   return tile_size;
 }
@@ -2408,7 +2862,7 @@ isl_stat sa_extract_loop_info(struct autosa_gen *gen, struct autosa_hw_module *m
   char *json_str = NULL;
   isl_ctx *ctx = gen->ctx;
 
-  if (module->is_filter && module->is_buffer)
+  if (autosa_hw_module_is_split(module))
   {
     /* Parse the loop structure of the intra trans module */
     module_name = concat(ctx, module->name, "intra_trans");
@@ -2522,6 +2976,8 @@ isl_stat sa_extract_array_info(struct autosa_kernel *kernel)
  * - If the module is connected to DRAM, use URAM if URAM is allowed, otherwise
  *   use BRAM.
  * - Otherwise, if memory util > 0.2 use BRAM, else use LUTRAM.
+ * If the buffer has been bound by sa_bind_memory, the binding is
+ * returned instead.
  */
 int extract_memory_type(struct autosa_hw_module *module,
                         struct autosa_kernel_var *var, int uram)
@@ -2531,6 +2987,9 @@ int extract_memory_type(struct autosa_hw_module *module,
   int var_size = 1;
   float bram_util;
 
+  if (var->mem_type >= 0)
+    return var->mem_type;
+
   for (int i = 0; i < isl_vec_size(var->size); ++i)
   {
     isl_val *v = isl_vec_get_element_val(var->size, i);
@@ -2638,6 +3097,9 @@ static cJSON *extract_design_info_from_module(struct autosa_gen *gen,
     cJSON_AddItemToObject(info, "unroll", unroll);
     cJSON *lat_hide_len = cJSON_CreateNumber(gen->kernel->lat_hide_len);
     cJSON_AddItemToObject(info, "latency_hide_len", lat_hide_len);
+    /* Number of multiplies packed in one DSP */
+    cJSON *dsp_pack = cJSON_CreateNumber(autosa_kernel_dsp_pack(gen->kernel) ? 2 : 1);
+    cJSON_AddItemToObject(info, "dsp_pack", dsp_pack);
 
     int *fifo_lanes_num = (int *)malloc(module->n_io_group * sizeof(int));
     for (int i = 0; i < module->n_io_group; i++)
@@ -2729,7 +3191,7 @@ isl_stat sa_extract_design_info(struct autosa_gen *gen)
     char *module_name;
     cJSON *info;
 
-    if (module->is_filter && module->is_buffer)
+    if (autosa_hw_module_is_split(module))
     {
       /* intra_trans */
       module_name = concat(ctx, module->name, "intra_trans");
@@ -2817,3 +3279,2812 @@ isl_stat sa_extract_design_info(struct autosa_gen *gen)
 
   return isl_stat_ok;
 }
+
+/****************************************************************
+ * AutoSA analytical latency model
+ ****************************************************************/
+/* Data used for evaluating the module ASTs in the latency and resource
+ * models.
+ */
+struct autosa_ast_est_data
+{
+  struct autosa_hw_module *module;
+  /* Values of the iterators of the enclosing loops. */
+  std::map<std::string, long> iters;
+  /* Number of accesses to each FIFO in one iteration of the pipelined loop. */
+  std::map<std::string, long> fifo_access;
+  /* Set if the current node is under a "hls_pipeline" mark. */
+  int under_pipeline;
+  /* Maximal pipeline depth of the pipelined loops in the module. */
+  long depth;
+};
+
+/* Evaluate the integer value of "expr".
+ * The iterators of the enclosing loops are replaced by their lower bounds.
+ * Any other identifier (e.g., the module index) is assumed to be zero.
+ * For a conditional expression, the larger one of the two branches is used.
+ */
+static long eval_ast_expr(__isl_keep isl_ast_expr *expr,
+                          struct autosa_ast_est_data *data)
+{
+  enum isl_ast_expr_type type = isl_ast_expr_get_type(expr);
+
+  if (type == isl_ast_expr_int)
+  {
+    isl_val *v = isl_ast_expr_get_val(expr);
+    long val = isl_val_get_num_si(v);
+    isl_val_free(v);
+    return val;
+  }
+  else if (type == isl_ast_expr_id)
+  {
+    isl_id *id = isl_ast_expr_get_id(expr);
+    std::map<std::string, long>::iterator it;
+    long val = 0;
+
+    it = data->iters.find(isl_id_get_name(id));
+    if (it != data->iters.end())
+      val = it->second;
+    isl_id_free(id);
+    return val;
+  }
+  else if (type == isl_ast_expr_op)
+  {
+    enum isl_ast_op_type op = isl_ast_expr_get_op_type(expr);
+    int n_arg = isl_ast_expr_get_op_n_arg(expr);
+    long args[3] = {0, 0, 0};
+    long val = 0;
+
+    if (op == isl_ast_op_call || op == isl_ast_op_access ||
+        op == isl_ast_op_member || op == isl_ast_op_address_of)
+      return 0;
+    for (int i = 0; i < n_arg && i < 3; i++)
+    {
+      isl_ast_expr *arg = isl_ast_expr_get_op_arg(expr, i);
+      args[i] = eval_ast_expr(arg, data);
+      isl_ast_expr_free(arg);
+    }
+
+    switch (op)
+    {
+    case isl_ast_op_minus:
+      return -args[0];
+    case isl_ast_op_add:
+      return args[0] + args[1];
+    case isl_ast_op_sub:
+      return args[0] - args[1];
+    case isl_ast_op_mul:
+      return args[0] * args[1];
+    case isl_ast_op_div:
+    case isl_ast_op_pdiv_q:
+      return args[1] == 0 ? 0 : args[0] / args[1];
+    case isl_ast_op_fdiv_q:
+      if (args[1] == 0)
+        return 0;
+      val = args[0] / args[1];
+      if ((args[0] % args[1] != 0) && ((args[0] < 0) != (args[1] < 0)))
+        val--;
+      return val;
+    case isl_ast_op_pdiv_r:
+    case isl_ast_op_zdiv_r:
+      return args[1] == 0 ? 0 : args[0] % args[1];
+    case isl_ast_op_max:
+    case isl_ast_op_min:
+      /* The operation may take more than two arguments. */
+      for (int i = 0; i < n_arg; i++)
+      {
+        isl_ast_expr *arg = isl_ast_expr_get_op_arg(expr, i);
+        long arg_val = eval_ast_expr(arg, data);
+        isl_ast_expr_free(arg);
+        if (i == 0 || (op == isl_ast_op_max && arg_val > val) ||
+            (op == isl_ast_op_min && arg_val < val))
+          val = arg_val;
+      }
+      return val;
+    case isl_ast_op_cond:
+    case isl_ast_op_select:
+      return args[1] > args[2] ? args[1] : args[2];
+    case isl_ast_op_eq:
+      return args[0] == args[1];
+    case isl_ast_op_le:
+      return args[0] <= args[1];
+    case isl_ast_op_lt:
+      return args[0] < args[1];
+    case isl_ast_op_ge:
+      return args[0] >= args[1];
+    case isl_ast_op_gt:
+      return args[0] > args[1];
+    case isl_ast_op_and:
+    case isl_ast_op_and_then:
+      return args[0] && args[1];
+    case isl_ast_op_or:
+    case isl_ast_op_or_else:
+      return args[0] || args[1];
+    default:
+      return 0;
+    }
+  }
+
+  return 0;
+}
+
+/* Compute the trip count of the for node "node".
+ * Store the lower bound of the loop in "lb".
+ */
+static long ast_node_for_trip_count(__isl_keep isl_ast_node *node,
+                                    struct autosa_ast_est_data *data, long *lb)
+{
+  isl_ast_expr *init, *cond, *inc, *arg;
+  long ub, stride, trip;
+  enum isl_ast_op_type op;
+
+  init = isl_ast_node_for_get_init(node);
+  *lb = eval_ast_expr(init, data);
+  isl_ast_expr_free(init);
+  if (isl_ast_node_for_is_degenerate(node))
+    return 1;
+
+  cond = isl_ast_node_for_get_cond(node);
+  inc = isl_ast_node_for_get_inc(node);
+  op = isl_ast_expr_get_op_type(cond);
+  arg = isl_ast_expr_get_op_arg(cond, 1);
+  ub = eval_ast_expr(arg, data);
+  isl_ast_expr_free(arg);
+  if (op == isl_ast_op_lt)
+    ub--;
+  stride = eval_ast_expr(inc, data);
+  if (stride <= 0)
+    stride = 1;
+  isl_ast_expr_free(cond);
+  isl_ast_expr_free(inc);
+
+  trip = ub < *lb ? 0 : (ub - *lb) / stride + 1;
+
+  return trip;
+}
+
+static long estimate_module_tree_latency(__isl_keep isl_ast_node *tree,
+                                         struct autosa_ast_est_data *data);
+
+/* Compute the latency of the user node "node".
+ * The latency of a computation statement depends on its operations and
+ * their data types.
+ * The I/O module calls are replaced by the latency of the corresponding
+ * inter_trans/intra_trans functions. With double buffering, the two
+ * functions run in parallel on the ping and pong buffers. Otherwise,
+ * they are executed in sequence.
+ * Under a pipelined loop, the number of FIFO accesses are recorded to
+ * derive the initiation interval of the loop.
+ */
+static long estimate_ast_node_user_latency(__isl_keep isl_ast_node *node,
+                                           struct autosa_ast_est_data *data)
+{
+  isl_id *id;
+  const char *name;
+  struct autosa_kernel_stmt *stmt;
+  struct autosa_hw_module *module;
+  long inter, intra, lat;
+  int boundary;
+
+  id = isl_ast_node_get_annotation(node);
+  if (!id)
+    return AUTOSA_LAT_COMPUTE;
+  name = isl_id_get_name(id);
+  stmt = (struct autosa_kernel_stmt *)isl_id_get_user(id);
+  isl_id_free(id);
+
+  if (!prefixcmp(name, "io_module.inter_trans") ||
+      !prefixcmp(name, "io_module.intra_trans") ||
+      !prefixcmp(name, "io_module.inter_intra") ||
+      !prefixcmp(name, "io_module.intra_inter"))
+  {
+    module = stmt ? stmt->u.f.module : data->module;
+    boundary = stmt ? stmt->u.f.boundary : 0;
+    inter = estimate_module_tree_latency(
+        boundary ? module->boundary_inter_tree : module->inter_tree, data);
+    intra = estimate_module_tree_latency(module->intra_tree, data);
+    if (!prefixcmp(name, "io_module.inter_trans"))
+      return inter;
+    if (!prefixcmp(name, "io_module.intra_trans"))
+      return intra;
+    if (module->double_buffer)
+      return inter > intra ? inter : intra;
+    return inter + intra;
+  }
+  if (!stmt)
+    return 0;
+
+  switch (stmt->type)
+  {
+  case AUTOSA_KERNEL_STMT_DOMAIN:
+    if (data->module && data->module->kernel)
+      return autosa_stmt_latency(data->module->kernel->prog, stmt->u.d.stmt->stmt);
+    return AUTOSA_LAT_COMPUTE;
+  case AUTOSA_KERNEL_STMT_IO:
+  case AUTOSA_KERNEL_STMT_IO_TRANSFER:
+  case AUTOSA_KERNEL_STMT_IO_TRANSFER_BUF:
+  case AUTOSA_KERNEL_STMT_IO_DRAM:
+    if (stmt->type == AUTOSA_KERNEL_STMT_IO_DRAM)
+      lat = AUTOSA_LAT_DRAM;
+    else if (stmt->type == AUTOSA_KERNEL_STMT_IO_TRANSFER_BUF)
+      lat = AUTOSA_LAT_BUFFER + AUTOSA_LAT_FIFO;
+    else
+      lat = AUTOSA_LAT_FIFO;
+    if (data->under_pipeline && stmt->u.i.fifo_name)
+      data->fifo_access[stmt->u.i.fifo_name]++;
+    return lat;
+  case AUTOSA_KERNEL_STMT_IO_MODULE_CALL_STATE_HANDLE:
+  case AUTOSA_KERNEL_STMT_IO_MODULE_CALL_CREDIT:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+/* Compute the latency of the loop "node" with the pipelined body "body".
+ * The initiation interval (II) is bounded by the maximal number of accesses
+ * to the same FIFO in one iteration, since each FIFO can only be accessed
+ * once per cycle. A FIFO shallower than two can't sustain a new
+ * token every cycle and doubles the II.
+ * The latency of the loop is computed as II * (trip - 1) + depth.
+ */
+static long estimate_pipelined_loop_latency(__isl_keep isl_ast_node *body,
+                                            long trip, struct autosa_ast_est_data *data)
+{
+  std::map<std::string, long> fifo_access;
+  std::map<std::string, long>::iterator it;
+  long depth, II = 1;
+
+  fifo_access.swap(data->fifo_access);
+  data->under_pipeline = 1;
+  depth = estimate_module_tree_latency(body, data);
+  data->under_pipeline = 0;
+  for (it = data->fifo_access.begin(); it != data->fifo_access.end(); it++)
+  {
+    if (it->second > II)
+      II = it->second;
+  }
+  data->fifo_access.swap(fifo_access);
+  if (AUTOSA_FIFO_DEPTH < 2)
+    II *= 2;
+  if (depth > data->depth)
+    data->depth = depth;
+
+  return trip == 0 ? 0 : II * (trip - 1) + depth;
+}
+
+/* If the for node "tree" is the outermost loop of a perfect loop nest that
+ * is flattened into a single pipelined loop with --AutoSA-loop-flatten,
+ * see autosa_ast_node_extract_flatten_nest, return the "hls_pipeline" mark
+ * of the nest and store the total number of iterations in "trip".
+ * Otherwise, return NULL.
+ * Only the nests of the I/O modules are flattened.
+ */
+static __isl_give isl_ast_node *flattened_nest(__isl_keep isl_ast_node *tree,
+                                               struct autosa_ast_est_data *data, long *trip)
+{
+  std::vector<isl_ast_node *> loops;
+  std::vector<long> n_iters;
+  isl_ast_node *mark;
+
+  if (data->under_pipeline || !data->module || data->module->type == PE_MODULE ||
+      !data->module->options->autosa->loop_flatten)
+    return NULL;
+  mark = autosa_ast_node_extract_flatten_nest(tree, loops, n_iters);
+  if (!mark)
+    return NULL;
+  *trip = 1;
+  for (int i = 0; i < loops.size(); i++)
+  {
+    *trip *= n_iters[i];
+    isl_ast_node_free(loops[i]);
+  }
+
+  return mark;
+}
+
+/* Compute the latency of the AST "tree" of a hardware module.
+ * Outside the pipelined loops, the loops and blocks are executed
+ * sequentially.
+ * Loops under a pipelined loop or marked by "hls_unroll" are fully unrolled.
+ * They add to the pipeline depth with a reduction tree of log2(trip) levels,
+ * and multiply the number of FIFO accesses per iteration.
+ * For an if node, the longer branch is taken.
+ */
+static long estimate_module_tree_latency(__isl_keep isl_ast_node *tree,
+                                         struct autosa_ast_est_data *data)
+{
+  enum isl_ast_node_type type;
+  long lat = 0;
+
+  if (!tree)
+    return 0;
+
+  type = isl_ast_node_get_type(tree);
+  switch (type)
+  {
+  case isl_ast_node_for:
+  {
+    isl_ast_node *body;
+    isl_ast_expr *iterator;
+    isl_id *id;
+    char *name;
+    long lb, trip;
+    int pipeline = 0;
+    isl_ast_node *mark;
+
+    trip = ast_node_for_trip_count(tree, data, &lb);
+    iterator = isl_ast_node_for_get_iterator(tree);
+    id = isl_ast_expr_get_id(iterator);
+    name = strdup(isl_id_get_name(id));
+    isl_id_free(id);
+    isl_ast_expr_free(iterator);
+    data->iters[name] = lb;
+
+    body = isl_ast_node_for_get_body(tree);
+    if (isl_ast_node_get_type(body) == isl_ast_node_mark)
+    {
+      id = isl_ast_node_mark_get_id(body);
+      pipeline = !strcmp(isl_id_get_name(id), "hls_pipeline");
+      isl_id_free(id);
+    }
+
+    if (data->under_pipeline)
+    {
+      std::map<std::string, long> fifo_access;
+      std::map<std::string, long>::iterator it;
+      int levels = 0;
+
+      fifo_access.swap(data->fifo_access);
+      lat = estimate_module_tree_latency(body, data);
+      for (it = data->fifo_access.begin(); it != data->fifo_access.end(); it++)
+        fifo_access[it->first] += it->second * trip;
+      data->fifo_access.swap(fifo_access);
+      while ((1L << levels) < trip)
+        levels++;
+      lat += levels;
+    }
+    else if (pipeline)
+    {
+      lat = estimate_pipelined_loop_latency(body, trip, data);
+    }
+    else if ((mark = flattened_nest(tree, data, &trip)) != NULL)
+    {
+      /* The flattened nest is a single pipelined loop. */
+      lat = estimate_pipelined_loop_latency(mark, trip, data);
+      isl_ast_node_free(mark);
+    }
+    else
+    {
+      lat = trip * estimate_module_tree_latency(body, data);
+    }
+    isl_ast_node_free(body);
+    data->iters.erase(name);
+    free(name);
+    break;
+  }
+  case isl_ast_node_block:
+  {
+    isl_ast_node_list *child_list = isl_ast_node_block_get_children(tree);
+    int n_child = isl_ast_node_list_n_ast_node(child_list);
+    for (int i = 0; i < n_child; i++)
+    {
+      isl_ast_node *child = isl_ast_node_list_get_ast_node(child_list, i);
+      lat += estimate_module_tree_latency(child, data);
+      isl_ast_node_free(child);
+    }
+    isl_ast_node_list_free(child_list);
+    break;
+  }
+  case isl_ast_node_if:
+  {
+    isl_ast_node *child;
+    long then_lat, else_lat = 0;
+
+    child = isl_ast_node_if_get_then_node(tree);
+    then_lat = estimate_module_tree_latency(child, data);
+    isl_ast_node_free(child);
+    child = isl_ast_node_if_get_else_node(tree);
+    if (child)
+    {
+      else_lat = estimate_module_tree_latency(child, data);
+      isl_ast_node_free(child);
+    }
+    lat = then_lat > else_lat ? then_lat : else_lat;
+    break;
+  }
+  case isl_ast_node_mark:
+  {
+    isl_ast_node *child;
+    isl_id *id = isl_ast_node_mark_get_id(tree);
+    int pipeline = !strcmp(isl_id_get_name(id), "hls_pipeline");
+    isl_id_free(id);
+
+    child = isl_ast_node_mark_get_node(tree);
+    /* A pipeline mark without an enclosing loop */
+    if (pipeline && !data->under_pipeline)
+      lat = estimate_pipelined_loop_latency(child, 1, data);
+    else
+      lat = estimate_module_tree_latency(child, data);
+    isl_ast_node_free(child);
+    break;
+  }
+  case isl_ast_node_user:
+    lat = estimate_ast_node_user_latency(tree, data);
+    break;
+  default:
+    break;
+  }
+
+  return lat;
+}
+
+/* Return the module type of "module" in the calibration file. */
+static const char *calibration_module_type(struct autosa_hw_module *module)
+{
+  if (module->type == PE_MODULE)
+    return "PE";
+  if (module->type == IO_MODULE)
+    return "IO";
+  return "drain";
+}
+
+/* Compute the latency of the hardware module "module" of "kernel" and add it
+ * to "modules" under the name "module_name".
+ * Store the maximal pipeline depth of the module in "depth".
+ * The runtime numbers of array partitions are set to the compiled numbers.
+ */
+static long estimate_module_latency(struct autosa_kernel *kernel,
+                                    struct autosa_hw_module *module,
+                                    __isl_keep isl_ast_node *tree, const char *module_name, cJSON *modules,
+                                    long *depth)
+{
+  struct autosa_ast_est_data data;
+  cJSON *info;
+  long lat;
+
+  data.module = module;
+  data.under_pipeline = 0;
+  data.depth = 0;
+  for (int i = 0; i < kernel->n_runtime_tile; i++)
+    data.iters["n_tile_" + std::to_string(i)] = kernel->runtime_tile_ub[i];
+  lat = estimate_module_tree_latency(tree, &data);
+  *depth = data.depth;
+
+  info = cJSON_CreateObject();
+  cJSON_AddItemToObject(info, "latency", cJSON_CreateNumber(lat));
+  cJSON_AddItemToObject(info, "pipeline_depth", cJSON_CreateNumber(data.depth));
+  cJSON_AddStringToObject(info, "type", calibration_module_type(module));
+  cJSON_AddItemToObject(modules, module_name, info);
+
+  return lat;
+}
+
+/* Return the correction coefficient "name" of the module type "type"
+ * under "kind" ("latency" or "resource") in "calibration".
+ * If "name" is NULL, the coefficient is the entry "type" itself.
+ * Return 1 if the coefficient is not given.
+ */
+static double calibration_coef(cJSON *calibration, const char *kind,
+                               const char *type, const char *name)
+{
+  cJSON *item;
+
+  if (!calibration)
+    return 1;
+  item = cJSON_GetObjectItemCaseSensitive(calibration, kind);
+  item = cJSON_GetObjectItemCaseSensitive(item, type);
+  if (name)
+    item = cJSON_GetObjectItemCaseSensitive(item, name);
+  if (!cJSON_IsNumber(item) || item->valuedouble <= 0)
+    return 1;
+
+  return item->valuedouble;
+}
+
+/* Return the number of array tiles of "kernel", i.e., the iterations of the
+ * array partitioning loops above the "array" mark, executed until the first
+ * output tile is complete, and store the total number of array tiles in
+ * "n_tile". An output tile is complete after the last tile writing to its
+ * elements. Return -1 if the numbers are not constant.
+ */
+static long kernel_first_output_tiles(struct autosa_kernel *kernel,
+                                      long *n_tile)
+{
+  struct autosa_prog *prog = kernel->prog;
+  isl_schedule_node *node;
+  isl_union_pw_multi_aff *prefix;
+  isl_union_map *tile, *writes, *last;
+  isl_union_set *arrays, *range;
+  isl_set *tiles, *first;
+  isl_val *val;
+  long n_first = -1;
+
+  *n_tile = -1;
+  node = isl_schedule_get_root(kernel->schedule);
+  node = autosa_tree_move_down_to_array(node, kernel->core);
+  prefix = isl_schedule_node_get_prefix_schedule_union_pw_multi_aff(node);
+  prefix = isl_union_pw_multi_aff_pullback_union_pw_multi_aff(prefix,
+                                                              isl_union_pw_multi_aff_copy(kernel->contraction));
+  tile = isl_union_map_from_union_pw_multi_aff(prefix);
+  isl_schedule_node_free(node);
+
+  arrays = isl_union_set_empty(isl_set_get_space(prog->context));
+  for (int i = 0; i < prog->n_array; i++)
+  {
+    if (!prog->array[i].accessed || prog->array[i].local)
+      continue;
+    arrays = isl_union_set_add_set(arrays,
+                                   isl_set_universe(isl_space_copy(prog->array[i].space)));
+  }
+  writes = isl_union_map_copy(prog->may_write);
+  writes = isl_union_map_intersect_domain(writes,
+                                          isl_union_set_copy(kernel->expanded_domain));
+  writes = isl_union_map_intersect_range(writes, arrays);
+  last = isl_union_map_reverse(writes);
+  last = isl_union_map_apply_range(last, isl_union_map_copy(tile));
+  last = isl_union_map_lexmax(last);
+  tile = isl_union_map_intersect_domain(tile,
+                                        isl_union_set_copy(kernel->expanded_domain));
+
+  range = isl_union_map_range(isl_union_map_copy(tile));
+  if (isl_union_map_is_empty(last) == isl_bool_false &&
+      isl_union_set_n_set(range) == 1)
+  {
+    tiles = isl_set_from_union_set(range);
+    range = NULL;
+    first = isl_set_from_union_set(isl_union_set_lexmin(isl_union_map_range(
+        isl_union_map_copy(last))));
+    val = isl_set_count_val(tiles);
+    if (isl_val_is_int(val) == isl_bool_true)
+      *n_tile = isl_val_get_num_si(val);
+    isl_val_free(val);
+    tiles = isl_map_domain(isl_set_lex_le_set(tiles, first));
+    val = isl_set_count_val(tiles);
+    if (isl_val_is_int(val) == isl_bool_true && *n_tile > 0)
+      n_first = isl_val_get_num_si(val);
+    isl_val_free(val);
+    isl_set_free(tiles);
+  }
+  isl_union_set_free(range);
+  isl_union_map_free(last);
+  isl_union_map_free(tile);
+
+  return n_first;
+}
+
+/* Estimate the end-to-end latency (in cycles) of the kernel from the ASTs of
+ * the hardware modules, and store it in "latency".
+ * All the modules run concurrently and are connected by FIFOs.
+ * The kernel latency is therefore bounded by the slowest module, plus the
+ * time to fill the array, i.e., the number of PEs that the data travels
+ * through along all the space dimensions, each hop costing the pipeline
+ * depth of the PE and one FIFO access, plus the pipeline stages inserted
+ * in the I/O chains.
+ * If "calibration" is not NULL, the latency of each module is scaled by
+ * the coefficient of its module type, and the kernel latency by the
+ * "kernel" coefficient.
+ * The latencies of the first and the last result of a single request are
+ * estimated separately, see kernel_first_output_tiles.
+ * The estimation results are printed to "latency_est/latency_info.json".
+ * The latencies of the modules are printed uncalibrated, such that
+ * the coefficients can be refitted.
+ * If "modules_info" is not NULL, a copy of the latencies of the modules
+ * is returned in "modules_info".
+ * With the PE clock (--AutoSA-pe-clock), the latencies of the PEs and
+ * their pipeline depths are counted in PE cycles and converted to cycles
+ * of the kernel clock (--AutoSA-kernel-clock), and the data crosses
+ * the clock domains twice in the fill. The latencies of the modules
+ * are printed in the cycles of their own clock.
+ */
+isl_stat sa_estimate_latency(struct autosa_gen *gen, cJSON *calibration,
+                             long *latency, cJSON **modules_info)
+{
+  cJSON *latency_info, *modules;
+  isl_ctx *ctx = gen->ctx;
+  isl_printer *p_str;
+  char *file_path, *json_str;
+  FILE *fp;
+  long max_lat = 0, pe_depth = 0, fill = 0, n_hop = 0;
+  long raw_max_lat = 0, n_tile, n_first, first_lat;
+  double pe_ratio = 1;
+
+  if (gen->options->autosa->pe_clock > 0 && gen->options->autosa->kernel_clock > 0)
+    pe_ratio = (double)gen->options->autosa->kernel_clock /
+               gen->options->autosa->pe_clock;
+
+  latency_info = cJSON_CreateObject();
+  modules = cJSON_CreateObject();
+  cJSON_AddItemToObject(latency_info, "modules", modules);
+
+  for (int i = 0; i < gen->n_hw_modules; i++)
+  {
+    struct autosa_hw_module *module = gen->hw_modules[i];
+    long lat, depth;
+    double coef;
+
+    coef = calibration_coef(calibration, "latency",
+                            calibration_module_type(module), NULL);
+    lat = estimate_module_latency(gen->kernel, module, module->device_tree, module->name,
+                                  modules, &depth);
+    if (module->type == PE_MODULE)
+    {
+      lat = (long)(lat * pe_ratio);
+      depth = (long)(depth * pe_ratio);
+    }
+    if (module->type == PE_MODULE && depth > pe_depth)
+      pe_depth = depth;
+    if (lat > raw_max_lat)
+      raw_max_lat = lat;
+    if ((long)(lat * coef) > max_lat)
+      max_lat = (long)(lat * coef);
+
+    if (module->boundary)
+    {
+      char *module_name = concat(ctx, module->name, "boundary");
+      lat = estimate_module_latency(gen->kernel, module, module->boundary_tree,
+                                    module_name, modules, &depth);
+      free(module_name);
+      if (module->type == PE_MODULE)
+        lat = (long)(lat * pe_ratio);
+      if (lat > raw_max_lat)
+        raw_max_lat = lat;
+      if ((long)(lat * coef) > max_lat)
+        max_lat = (long)(lat * coef);
+    }
+
+    for (int j = 0; j < module->n_pe_dummy_modules; j++)
+    {
+      struct autosa_pe_dummy_module *dummy_module = module->pe_dummy_modules[j];
+      char *module_name;
+
+      p_str = isl_printer_to_str(ctx);
+      p_str = autosa_array_ref_group_print_prefix(dummy_module->io_group, p_str);
+      p_str = isl_printer_print_str(p_str, "_PE_dummy");
+      module_name = isl_printer_get_str(p_str);
+      isl_printer_free(p_str);
+      lat = estimate_module_latency(gen->kernel, module, dummy_module->device_tree,
+                                    module_name, modules, &depth);
+      free(module_name);
+      if (lat > raw_max_lat)
+        raw_max_lat = lat;
+      if ((long)(lat * coef) > max_lat)
+        max_lat = (long)(lat * coef);
+    }
+  }
+
+  for (int i = 0; i < gen->kernel->n_sa_dim; i++)
+    n_hop += gen->kernel->sa_dim[i];
+  fill = n_hop * (pe_depth + AUTOSA_LAT_FIFO);
+  /* Each pipeline stage in the I/O chains delays the data by one FIFO. */
+  if (gen->options->autosa->chain_pipeline > 0)
+    fill += n_hop / gen->options->autosa->chain_pipeline * AUTOSA_LAT_FIFO;
+  /* The data enters and leaves the PE clock domain once. */
+  if (pe_ratio != 1)
+    fill += 2 * AUTOSA_LAT_CDC;
+  *latency = (long)((max_lat + fill) *
+                    calibration_coef(calibration, "latency", "kernel", NULL));
+
+  cJSON_AddItemToObject(latency_info, "fill_latency", cJSON_CreateNumber(fill));
+  cJSON_AddItemToObject(latency_info, "latency", cJSON_CreateNumber(*latency));
+  /* The results of a single request are drained through the array,
+   * which takes as long as the fill. The first result leaves the array
+   * once the first output tile is complete. */
+  n_first = kernel_first_output_tiles(gen->kernel, &n_tile);
+  first_lat = *latency + fill;
+  if (n_first > 0)
+    first_lat = (long)((double)(*latency - fill) * n_first / n_tile) + 2 * fill;
+  cJSON_AddItemToObject(latency_info, "first_result_latency",
+                        cJSON_CreateNumber(first_lat));
+  cJSON_AddItemToObject(latency_info, "last_result_latency",
+                        cJSON_CreateNumber(*latency + fill));
+  if (calibration)
+    cJSON_AddItemToObject(latency_info, "uncalibrated_latency",
+                          cJSON_CreateNumber(raw_max_lat + fill));
+
+  json_str = cJSON_Print(latency_info);
+  p_str = isl_printer_to_str(ctx);
+  p_str = isl_printer_print_str(p_str, gen->options->autosa->output_dir);
+  p_str = isl_printer_print_str(p_str, "/latency_est/latency_info.json");
+  file_path = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  fp = fopen(file_path, "w");
+  if (!fp)
+  {
+    printf("[AutoSA] Error: Cannot open file: %s\n", file_path);
+    exit(1);
+  }
+  free(file_path);
+  fprintf(fp, "%s", json_str);
+  fclose(fp);
+  free(json_str);
+  if (modules_info)
+    *modules_info = cJSON_Duplicate(modules, 1);
+  cJSON_Delete(latency_info);
+
+  printf("[AutoSA] Estimated latency: %ld cycles\n", *latency);
+  if (gen->options->autosa->batch1)
+    printf("[AutoSA] Estimated latency of a single request: %ld cycles to the first result, %ld cycles to the last result.\n",
+           first_lat, *latency + fill);
+
+  return isl_stat_ok;
+}
+
+/****************************************************************
+ * AutoSA analytical resource model
+ ****************************************************************/
+/* Instance counts of the hardware modules and FIFOs in the top module.
+ * The module instances are indexed by the module (or the PE dummy module)
+ * and whether it is the boundary module.
+ */
+struct autosa_instance_count
+{
+  std::map<std::pair<void *, int>, long> modules;
+  long n_fifo;
+  long fifo_bits;
+  long fifo_bram18k;
+};
+
+/* Extract the resource usage of one arithmetic lane of the data type "type".
+ * A lane performs a multiply-accumulate operation.
+ */
+void extract_op_resource(const char *type, struct autosa_resource *res)
+{
+  int width = autosa_hls_data_type_width(type);
+
+  res->bram18k = 0;
+  res->uram = 0;
+  if (width > 0)
+  {
+    /* Arbitrary-precision types */
+    res->dsp = width <= 18 ? 1 : (width <= 32 ? 3 : 10);
+    res->lut = 4 * width;
+    res->ff = 6 * width;
+  }
+  else if (!strcmp(type, "double"))
+  {
+    res->dsp = 14;
+    res->lut = 900;
+    res->ff = 1500;
+  }
+  else if (!strcmp(type, "half"))
+  {
+    res->dsp = 2;
+    res->lut = 250;
+    res->ff = 400;
+  }
+  else if (strstr(type, "char"))
+  {
+    res->dsp = 1;
+    res->lut = 30;
+    res->ff = 50;
+  }
+  else if (strstr(type, "short"))
+  {
+    res->dsp = 1;
+    res->lut = 50;
+    res->ff = 80;
+  }
+  else if (strstr(type, "long"))
+  {
+    res->dsp = 10;
+    res->lut = 200;
+    res->ff = 300;
+  }
+  else if (strstr(type, "int"))
+  {
+    res->dsp = 3;
+    res->lut = 100;
+    res->ff = 150;
+  }
+  else
+  {
+    /* float */
+    res->dsp = 5;
+    res->lut = 400;
+    res->ff = 700;
+  }
+}
+
+/* Compute the depth of the FIFOs of "module" with "n_lane" elements per word.
+ * The depth covers the maximal skew between the writes by the producer and
+ * the reads by the consumer in the static module schedule.
+ * The modules in the daisy-chain of an I/O module with a local buffer but
+ * without double buffering alternate between filling the buffer from the
+ * upstream FIFO and draining it to the lower level. While an instance drains
+ * its buffer, the upstream instance continues writing the data of the next
+ * buffer, i.e., the skew is one buffer worth of FIFO words.
+ * The other modules read and write the FIFOs at the same rate, being
+ * decoupled by the double buffers, or running in lockstep in the PEs.
+ * The depth is at least 2 and at most "--AutoSA-max-fifo-depth".
+ */
+int autosa_fifo_depth(struct autosa_hw_module *module, int n_lane)
+{
+  long depth = 2;
+
+  if (module->type != PE_MODULE && module->is_buffer &&
+      !module->double_buffer && n_lane > 0)
+  {
+    for (int i = 0; i < module->n_var; i++)
+    {
+      struct autosa_kernel_var *var = &module->var[i];
+      long size = var->n_lane;
+      for (int j = 0; j < isl_vec_size(var->size); j++)
+      {
+        isl_val *v = isl_vec_get_element_val(var->size, j);
+        size *= isl_val_get_num_si(v);
+        isl_val_free(v);
+      }
+      depth = max(depth, (size + n_lane - 1) / n_lane);
+    }
+  }
+
+  return (int)min(depth, (long)module->options->autosa->max_fifo_depth);
+}
+
+/* Return the HLS data type given to the element type "type" by
+ * "--AutoSA-data-type", or NULL if there is none.
+ * The option is a list of "<type>=<HLS type>" separated by semicolons.
+ */
+char *autosa_hls_data_type(struct ppcg_options *options, const char *type)
+{
+  const char *entry;
+  int len;
+
+  if (!options->autosa->data_type || !type)
+    return NULL;
+
+  len = strlen(type);
+  entry = options->autosa->data_type;
+  while (entry)
+  {
+    const char *end;
+
+    while (*entry == ' ')
+      entry++;
+    end = strchr(entry, ';');
+    if (!strncmp(entry, type, len) && entry[len] == '=')
+    {
+      const char *hls_type = entry + len + 1;
+      if (end)
+        return strndup(hls_type, end - hls_type);
+      return strdup(hls_type);
+    }
+    entry = end ? end + 1 : NULL;
+  }
+
+  return NULL;
+}
+
+/* Return the block size (in elements) of the array "name" given by
+ * "--autosa-block-sparse", or 0 if "name" is not declared as block-sparse.
+ * The option has the form "name=size;name=size".
+ */
+int autosa_sparse_block_size(struct ppcg_options *options, const char *name)
+{
+  const char *entry;
+  int len;
+
+  if (!options->autosa->block_sparse || !name)
+    return 0;
+
+  len = strlen(name);
+  entry = options->autosa->block_sparse;
+  while (entry)
+  {
+    const char *end;
+
+    while (*entry == ' ')
+      entry++;
+    end = strchr(entry, ';');
+    if (!strncmp(entry, name, len) && entry[len] == '=')
+      return atoi(entry + len + 1);
+    entry = end ? end + 1 : NULL;
+  }
+
+  return 0;
+}
+
+/* Return 1 if the array "name" is selected by "--autosa-qdma-stream",
+ * which has the form "name;name".
+ */
+int autosa_qdma_stream_selected(struct ppcg_options *options, const char *name)
+{
+  const char *entry;
+  int len;
+
+  if (!options->autosa->qdma_stream || !name)
+    return 0;
+
+  len = strlen(name);
+  entry = options->autosa->qdma_stream;
+  while (entry)
+  {
+    const char *end;
+
+    while (*entry == ' ')
+      entry++;
+    end = strchr(entry, ';');
+    if (!strncmp(entry, name, len) &&
+        (entry[len] == ';' || entry[len] == ' ' || entry[len] == '\0'))
+      return 1;
+    entry = end ? end + 1 : NULL;
+  }
+
+  return 0;
+}
+
+/* Return the bit width of the arbitrary-precision data type "hls_type",
+ * i.e., "W" for ap_int<W>, ap_uint<W>, ap_fixed<W, I> and ap_ufixed<W, I>.
+ * Return -1 for the other types.
+ */
+int autosa_hls_data_type_width(const char *hls_type)
+{
+  if (!strncmp(hls_type, "ap_int<", 7) || !strncmp(hls_type, "ap_uint<", 8) ||
+      !strncmp(hls_type, "ap_fixed<", 9) || !strncmp(hls_type, "ap_ufixed<", 10))
+    return atoi(strchr(hls_type, '<') + 1);
+
+  return -1;
+}
+
+/* Return 1 if "expr" accesses an array of ap_int<W> with W <= 8,
+ * 0 if it accesses an array of ap_uint<W> with W <= 8, and -1 otherwise.
+ */
+static int narrow_int_access_signed(struct autosa_prog *prog,
+                                    __isl_keep pet_expr *expr)
+{
+  isl_id *id;
+  const char *name;
+  int is_signed = -1;
+
+  if (pet_expr_get_type(expr) != pet_expr_access)
+    return -1;
+
+  id = pet_expr_access_get_id(expr);
+  name = isl_id_get_name(id);
+  for (int i = 0; i < prog->n_array; i++)
+  {
+    struct autosa_array_info *array = &prog->array[i];
+    if (strcmp(array->name, name) || !array->hls_type)
+      continue;
+    if (autosa_hls_data_type_width(array->hls_type) > 8)
+      break;
+    if (!strncmp(array->hls_type, "ap_int<", 7))
+      is_signed = 1;
+    else if (!strncmp(array->hls_type, "ap_uint<", 8))
+      is_signed = 0;
+    break;
+  }
+  isl_id_free(id);
+
+  return is_signed;
+}
+
+/* Examine if the access expressions "expr1" and "expr2" access the same
+ * array element.
+ */
+static isl_bool access_expr_is_equal(__isl_keep pet_expr *expr1,
+                                     __isl_keep pet_expr *expr2)
+{
+  isl_multi_pw_aff *index1, *index2;
+  isl_bool equal;
+
+  if (pet_expr_get_type(expr1) != pet_expr_access ||
+      pet_expr_get_type(expr2) != pet_expr_access)
+    return isl_bool_false;
+
+  index1 = pet_expr_access_get_index(expr1);
+  index2 = pet_expr_access_get_index(expr2);
+  equal = isl_multi_pw_aff_plain_is_equal(index1, index2);
+  isl_multi_pw_aff_free(index1);
+  isl_multi_pw_aff_free(index2);
+
+  return equal;
+}
+
+/* Examine if "expr" is a multiplication of two accesses to narrow
+ * integer arrays of the same signedness.
+ */
+static int is_narrow_int_mul(struct autosa_prog *prog, __isl_keep pet_expr *expr)
+{
+  pet_expr *arg0, *arg1;
+  int s0, s1;
+
+  if (pet_expr_get_type(expr) != pet_expr_op ||
+      pet_expr_op_get_type(expr) != pet_op_mul ||
+      pet_expr_get_n_arg(expr) != 2)
+    return 0;
+
+  arg0 = pet_expr_get_arg(expr, 0);
+  arg1 = pet_expr_get_arg(expr, 1);
+  s0 = narrow_int_access_signed(prog, arg0);
+  s1 = narrow_int_access_signed(prog, arg1);
+  pet_expr_free(arg0);
+  pet_expr_free(arg1);
+
+  return s0 >= 0 && s0 == s1;
+}
+
+/* Examine if "expr" is a multiplication of two accesses.
+ */
+static int is_access_mul(__isl_keep pet_expr *expr)
+{
+  pet_expr *arg0, *arg1;
+  int is_access;
+
+  if (pet_expr_get_type(expr) != pet_expr_op ||
+      pet_expr_op_get_type(expr) != pet_op_mul ||
+      pet_expr_get_n_arg(expr) != 2)
+    return 0;
+
+  arg0 = pet_expr_get_arg(expr, 0);
+  arg1 = pet_expr_get_arg(expr, 1);
+  is_access = pet_expr_get_type(arg0) == pet_expr_access &&
+              pet_expr_get_type(arg1) == pet_expr_access;
+  pet_expr_free(arg0);
+  pet_expr_free(arg1);
+
+  return is_access;
+}
+
+/* Examine if "expr" is the multiplication of a multiply-accumulate
+ * statement, i.e., a multiplication of two accesses to narrow integer
+ * arrays if "narrow" is set, or of any two accesses otherwise.
+ */
+static int is_mac_mul(struct autosa_prog *prog, __isl_keep pet_expr *expr,
+                      int narrow)
+{
+  if (narrow)
+    return is_narrow_int_mul(prog, expr);
+  return is_access_mul(expr);
+}
+
+/* Examine if the statement "stmt" is a multiply-accumulate,
+ * i.e., of the form "acc += x * y" or "acc = acc + x * y",
+ * where "x" and "y" are accesses, to narrow integer arrays if "narrow" is set.
+ * If so, return the multiplication "x * y" and store the accumulated
+ * access "acc" in "acc". Otherwise, return NULL.
+ */
+static __isl_give pet_expr *stmt_extract_mac(struct autosa_prog *prog,
+                                             struct pet_stmt *stmt, __isl_give pet_expr **acc, int narrow)
+{
+  pet_expr *expr, *lhs, *rhs;
+  pet_expr *mul = NULL;
+
+  if (pet_tree_get_type(stmt->body) != pet_tree_expr)
+    return NULL;
+  expr = pet_tree_expr_get_expr(stmt->body);
+  if (pet_expr_get_type(expr) != pet_expr_op ||
+      pet_expr_get_n_arg(expr) != 2)
+  {
+    pet_expr_free(expr);
+    return NULL;
+  }
+
+  lhs = pet_expr_get_arg(expr, 0);
+  rhs = pet_expr_get_arg(expr, 1);
+  if (pet_expr_op_get_type(expr) == pet_op_add_assign)
+  {
+    if (is_mac_mul(prog, rhs, narrow))
+      mul = pet_expr_copy(rhs);
+  }
+  else if (pet_expr_op_get_type(expr) == pet_op_assign &&
+           pet_expr_get_type(rhs) == pet_expr_op &&
+           pet_expr_op_get_type(rhs) == pet_op_add &&
+           pet_expr_get_n_arg(rhs) == 2)
+  {
+    for (int i = 0; i < 2; i++)
+    {
+      pet_expr *term = pet_expr_get_arg(rhs, i);
+      pet_expr *other = pet_expr_get_arg(rhs, 1 - i);
+      if (is_mac_mul(prog, term, narrow) &&
+          access_expr_is_equal(lhs, other) == isl_bool_true)
+        mul = pet_expr_copy(term);
+      pet_expr_free(term);
+      pet_expr_free(other);
+      if (mul)
+        break;
+    }
+  }
+  pet_expr_free(rhs);
+  pet_expr_free(expr);
+
+  if (!mul || pet_expr_get_type(lhs) != pet_expr_access)
+  {
+    pet_expr_free(lhs);
+    pet_expr_free(mul);
+    return NULL;
+  }
+  *acc = lhs;
+
+  return mul;
+}
+
+/* Examine if the statement "stmt" is a multiply-accumulate of narrow
+ * integers, i.e., of the form "acc += x * y" or "acc = acc + x * y",
+ * where "x" and "y" access arrays of ap_int<W> (or ap_uint<W>) with W <= 8.
+ * If so, return the multiplication "x * y" and store the accumulated
+ * access "acc" in "acc". Otherwise, return NULL.
+ */
+__isl_give pet_expr *autosa_stmt_extract_narrow_mac(struct autosa_prog *prog,
+                                                    struct pet_stmt *stmt, __isl_give pet_expr **acc)
+{
+  return stmt_extract_mac(prog, stmt, acc, 1);
+}
+
+/* Examine if the statement "stmt" is a multiply-accumulate of the form
+ * "acc += x * y" or "acc = acc + x * y", where "x" and "y" are accesses.
+ * If so, return the multiplication "x * y" and store the accumulated
+ * access "acc" in "acc". Otherwise, return NULL.
+ */
+__isl_give pet_expr *autosa_stmt_extract_mac(struct autosa_prog *prog,
+                                             struct pet_stmt *stmt, __isl_give pet_expr **acc)
+{
+  return stmt_extract_mac(prog, stmt, acc, 0);
+}
+
+/* Examine if "type" is an associative and commutative operation
+ * of a reduction.
+ */
+static int is_reduction_op(enum pet_op_type type)
+{
+  return type == pet_op_add || type == pet_op_mul;
+}
+
+/* Examine if the statement "stmt" is an associative update of an array
+ * element, i.e., of the form "acc op= e" or "acc = acc op e" (or
+ * "acc = e op acc"), where "op" is an addition or a multiplication.
+ * If so, store the reference ids of the write and the read of "acc"
+ * in "write_ref" and "read_ref". They are the same for "acc op= e".
+ */
+isl_bool autosa_stmt_is_reduction(struct pet_stmt *stmt,
+                                  __isl_give isl_id **write_ref, __isl_give isl_id **read_ref)
+{
+  pet_expr *expr, *lhs, *rhs;
+  enum pet_op_type type;
+  isl_bool is_reduction = isl_bool_false;
+
+  if (pet_tree_get_type(stmt->body) != pet_tree_expr)
+    return isl_bool_false;
+  expr = pet_tree_expr_get_expr(stmt->body);
+  if (pet_expr_get_type(expr) != pet_expr_op ||
+      pet_expr_get_n_arg(expr) != 2)
+  {
+    pet_expr_free(expr);
+    return isl_bool_false;
+  }
+
+  lhs = pet_expr_get_arg(expr, 0);
+  rhs = pet_expr_get_arg(expr, 1);
+  type = pet_expr_op_get_type(expr);
+  if (pet_expr_get_type(lhs) != pet_expr_access)
+  {
+    /* Not an update of an array element. */
+  }
+  else if (type == pet_op_add_assign || type == pet_op_mul_assign)
+  {
+    *write_ref = pet_expr_access_get_ref_id(lhs);
+    *read_ref = pet_expr_access_get_ref_id(lhs);
+    is_reduction = isl_bool_true;
+  }
+  else if (type == pet_op_assign &&
+           pet_expr_get_type(rhs) == pet_expr_op &&
+           is_reduction_op(pet_expr_op_get_type(rhs)) &&
+           pet_expr_get_n_arg(rhs) == 2)
+  {
+    for (int i = 0; i < 2; i++)
+    {
+      pet_expr *term = pet_expr_get_arg(rhs, i);
+      if (access_expr_is_equal(lhs, term) == isl_bool_true)
+      {
+        *write_ref = pet_expr_access_get_ref_id(lhs);
+        *read_ref = pet_expr_access_get_ref_id(term);
+        is_reduction = isl_bool_true;
+      }
+      pet_expr_free(term);
+      if (is_reduction)
+        break;
+    }
+  }
+  pet_expr_free(lhs);
+  pet_expr_free(rhs);
+  pet_expr_free(expr);
+
+  return is_reduction;
+}
+
+/* Examine if the statement "stmt" is a sum into an array element, i.e.,
+ * an associative update (see autosa_stmt_is_reduction) by an addition.
+ * If so, store the reference ids of the write and the read of the
+ * accumulator in "write_ref" and "read_ref".
+ */
+isl_bool autosa_stmt_is_sum(struct pet_stmt *stmt,
+                            __isl_give isl_id **write_ref, __isl_give isl_id **read_ref)
+{
+  pet_expr *expr, *rhs;
+  enum pet_op_type op;
+  isl_bool is_reduction;
+
+  is_reduction = autosa_stmt_is_reduction(stmt, write_ref, read_ref);
+  if (is_reduction != isl_bool_true)
+    return is_reduction;
+
+  expr = pet_tree_expr_get_expr(stmt->body);
+  rhs = pet_expr_get_arg(expr, 1);
+  op = pet_expr_op_get_type(expr);
+  if (op == pet_op_assign)
+    op = pet_expr_op_get_type(rhs);
+  pet_expr_free(rhs);
+  pet_expr_free(expr);
+  if (op == pet_op_add_assign || op == pet_op_add)
+    return isl_bool_true;
+
+  *write_ref = isl_id_free(*write_ref);
+  *read_ref = isl_id_free(*read_ref);
+  return isl_bool_false;
+}
+
+/* Examine if the statement "stmt" sets an array element to zero,
+ * i.e., is of the form "acc = 0".
+ */
+isl_bool autosa_stmt_is_zero_init(struct pet_stmt *stmt)
+{
+  pet_expr *expr, *lhs, *rhs;
+  isl_bool is_zero = isl_bool_false;
+
+  if (pet_tree_get_type(stmt->body) != pet_tree_expr)
+    return isl_bool_false;
+  expr = pet_tree_expr_get_expr(stmt->body);
+  if (pet_expr_get_type(expr) != pet_expr_op ||
+      pet_expr_op_get_type(expr) != pet_op_assign ||
+      pet_expr_get_n_arg(expr) != 2)
+  {
+    pet_expr_free(expr);
+    return isl_bool_false;
+  }
+
+  lhs = pet_expr_get_arg(expr, 0);
+  rhs = pet_expr_get_arg(expr, 1);
+  if (pet_expr_get_type(lhs) != pet_expr_access)
+  {
+    /* Not an update of an array element. */
+  }
+  else if (pet_expr_get_type(rhs) == pet_expr_int)
+  {
+    isl_val *val = pet_expr_int_get_val(rhs);
+    is_zero = isl_val_is_zero(val);
+    isl_val_free(val);
+  }
+  else if (pet_expr_get_type(rhs) == pet_expr_double)
+  {
+    if (pet_expr_double_get_val(rhs) == 0)
+      is_zero = isl_bool_true;
+  }
+  pet_expr_free(lhs);
+  pet_expr_free(rhs);
+  pet_expr_free(expr);
+
+  return is_zero;
+}
+
+/* Latencies (in cycles) of the additions and multiplications per data type,
+ * for the Xilinx and Intel FPGAs around 300 MHz.
+ * The data types are matched by prefix, the integer and fixed-point types
+ * of all widths share one entry.
+ * Unknown types are assumed to be as slow as floats.
+ */
+struct autosa_op_latency
+{
+  const char *type;
+  int add;
+  int mul;
+};
+
+static const struct autosa_op_latency xilinx_op_latency[] = {
+    {"half", 3, 2},
+    {"float", 4, 3},
+    {"double", 5, 6},
+    {"ap_fixed", 1, 2},
+    {"ap_ufixed", 1, 2},
+    {"ap_int", 1, 2},
+    {"ap_uint", 1, 2},
+    {"char", 1, 1},
+    {"unsigned char", 1, 1},
+    {"short", 1, 2},
+    {"unsigned short", 1, 2},
+    {"int", 1, 3},
+    {"unsigned int", 1, 3},
+    {"unsigned", 1, 3},
+    {"long", 1, 4},
+    {"unsigned long", 1, 4},
+    {NULL, 4, 3}};
+
+static const struct autosa_op_latency intel_op_latency[] = {
+    {"half", 3, 3},
+    {"float", 3, 3},
+    {"double", 7, 6},
+    {"char", 1, 2},
+    {"unsigned char", 1, 2},
+    {"short", 1, 2},
+    {"unsigned short", 1, 2},
+    {"int", 1, 3},
+    {"unsigned int", 1, 3},
+    {"unsigned", 1, 3},
+    {"long", 1, 4},
+    {"unsigned long", 1, 4},
+    {NULL, 3, 3}};
+
+/* Return the latency of the operation "op" on the data type "type"
+ * on the target of "options".
+ * The type is the HLS type of the element type given by
+ * "--autosa-data-type", if any.
+ * Additions, subtractions and multiplications are looked up in the
+ * latency tables, the other operations are assumed to be as fast
+ * as an addition.
+ */
+int autosa_op_latency(struct ppcg_options *options, const char *type,
+                      enum pet_op_type op)
+{
+  const struct autosa_op_latency *table;
+  char *hls_type;
+  int i;
+
+  table = options->target == AUTOSA_TARGET_INTEL_OPENCL ? intel_op_latency : xilinx_op_latency;
+  hls_type = autosa_hls_data_type(options, type);
+  if (hls_type)
+    type = hls_type;
+  for (i = 0; table[i].type; i++)
+  {
+    size_t len = strlen(table[i].type);
+    /* Exact match of the C types, prefix match of the templated types. */
+    if (!strcmp(type, table[i].type) ||
+        (!strncmp(type, table[i].type, len) && type[len] == '<'))
+      break;
+  }
+  free(hls_type);
+
+  if (op == pet_op_mul || op == pet_op_mul_assign)
+    return table[i].mul;
+  return table[i].add;
+}
+
+/* Return the element type of the array accessed by "expr".
+ */
+static const char *access_expr_type(struct autosa_prog *prog,
+                                    __isl_keep pet_expr *expr)
+{
+  isl_id *id;
+  const char *type = NULL;
+
+  id = pet_expr_access_get_id(expr);
+  for (int i = 0; i < prog->n_array; i++)
+  {
+    if (!strcmp(prog->array[i].name, isl_id_get_name(id)))
+    {
+      type = prog->array[i].type;
+      break;
+    }
+  }
+  isl_id_free(id);
+
+  return type;
+}
+
+/* Return the latency of the loop-carried update of the statement "stmt",
+ * i.e., the latency of the operation "op" of an associative update
+ * "acc op= e" or "acc = acc op e" on the type of "acc",
+ * or 0 if "stmt" is not such an update.
+ */
+int autosa_stmt_update_latency(struct autosa_prog *prog, struct pet_stmt *stmt)
+{
+  isl_id *write_ref = NULL, *read_ref = NULL;
+  pet_expr *expr, *lhs, *rhs;
+  enum pet_op_type op;
+  const char *type;
+  int lat;
+
+  if (autosa_stmt_is_reduction(stmt, &write_ref, &read_ref) != isl_bool_true)
+    return 0;
+  isl_id_free(write_ref);
+  isl_id_free(read_ref);
+
+  expr = pet_tree_expr_get_expr(stmt->body);
+  lhs = pet_expr_get_arg(expr, 0);
+  rhs = pet_expr_get_arg(expr, 1);
+  op = pet_expr_op_get_type(expr);
+  if (op == pet_op_assign)
+    op = pet_expr_op_get_type(rhs);
+  type = access_expr_type(prog, lhs);
+  lat = type ? autosa_op_latency(prog->scop->options, type, op) : AUTOSA_LAT_COMPUTE;
+  pet_expr_free(lhs);
+  pet_expr_free(rhs);
+  pet_expr_free(expr);
+
+  return lat;
+}
+
+/* Return the latency of the statement "stmt".
+ * A multiply-accumulate takes a multiplication and an addition,
+ * another associative update takes its update operation.
+ * The other statements take AUTOSA_LAT_COMPUTE cycles.
+ */
+int autosa_stmt_latency(struct autosa_prog *prog, struct pet_stmt *stmt)
+{
+  pet_expr *acc, *mul, *x;
+  const char *type;
+  int lat;
+
+  mul = autosa_stmt_extract_mac(prog, stmt, &acc);
+  if (mul)
+  {
+    x = pet_expr_get_arg(mul, 0);
+    type = access_expr_type(prog, x);
+    lat = type ? autosa_op_latency(prog->scop->options, type, pet_op_mul) : AUTOSA_LAT_COMPUTE;
+    type = access_expr_type(prog, acc);
+    lat += type ? autosa_op_latency(prog->scop->options, type, pet_op_add) : AUTOSA_LAT_COMPUTE;
+    pet_expr_free(x);
+    pet_expr_free(mul);
+    pet_expr_free(acc);
+    return lat;
+  }
+
+  lat = autosa_stmt_update_latency(prog, stmt);
+
+  return lat > 0 ? lat : AUTOSA_LAT_COMPUTE;
+}
+
+/* Return the latency of the loop-carried updates of the statements of
+ * "kernel", i.e., the maximal latency of its associative updates,
+ * or 0 if there is no such update.
+ * The latency hiding loops should cover this latency for the PEs
+ * to be pipelined with II=1.
+ */
+int autosa_kernel_update_latency(struct autosa_kernel *kernel)
+{
+  struct autosa_prog *prog = kernel->prog;
+  int lat = 0;
+
+  for (int i = 0; i < prog->n_stmts; i++)
+  {
+    int lat_i = autosa_stmt_update_latency(prog, prog->stmts[i].stmt);
+    if (lat_i > lat)
+      lat = lat_i;
+  }
+
+  return lat;
+}
+
+/* Return the number of arithmetic operations in "expr".
+ * Each arithmetic operator, including the one of a compound assignment,
+ * and each function call count as one operation.
+ */
+static int expr_count_ops(__isl_keep pet_expr *expr)
+{
+  int n = 0;
+
+  if (pet_expr_get_type(expr) == pet_expr_call)
+    n = 1;
+  if (pet_expr_get_type(expr) == pet_expr_op)
+  {
+    switch (pet_expr_op_get_type(expr))
+    {
+    case pet_op_add_assign:
+    case pet_op_sub_assign:
+    case pet_op_mul_assign:
+    case pet_op_div_assign:
+    case pet_op_add:
+    case pet_op_sub:
+    case pet_op_mul:
+    case pet_op_div:
+    case pet_op_mod:
+    case pet_op_minus:
+      n = 1;
+      break;
+    default:
+      break;
+    }
+  }
+  for (int i = 0; i < pet_expr_get_n_arg(expr); i++)
+  {
+    pet_expr *arg = pet_expr_get_arg(expr, i);
+    n += expr_count_ops(arg);
+    pet_expr_free(arg);
+  }
+
+  return n;
+}
+
+/* Return the number of arithmetic operations executed by "kernel",
+ * i.e., the sum over the statements of the number of their instances
+ * in the kernel times the number of arithmetic operations in their body,
+ * or -1 if the number of instances is not fixed by the context.
+ * A statement that is not an expression counts as one operation.
+ */
+double autosa_kernel_count_ops(struct autosa_kernel *kernel)
+{
+  struct autosa_prog *prog = kernel->prog;
+  double ops = 0;
+
+  if (isl_set_is_singleton(prog->context) != isl_bool_true)
+    return -1;
+
+  for (int i = 0; i < prog->n_stmts && ops >= 0; i++)
+  {
+    struct pet_stmt *stmt = prog->stmts[i].stmt;
+    isl_set *domain;
+    isl_pw_qpolynomial *card;
+    isl_point *pnt;
+    isl_val *val;
+    int n = 1;
+
+    domain = isl_union_set_extract_set(kernel->expanded_domain,
+                                       isl_set_get_space(stmt->domain));
+    domain = isl_set_intersect_params(domain, isl_set_copy(prog->context));
+    card = isl_set_card(domain);
+    pnt = isl_set_sample_point(isl_set_copy(prog->context));
+    val = isl_pw_qpolynomial_eval(card, pnt);
+    if (pet_tree_get_type(stmt->body) == pet_tree_expr)
+    {
+      pet_expr *expr = pet_tree_expr_get_expr(stmt->body);
+      n = expr_count_ops(expr);
+      pet_expr_free(expr);
+    }
+    if (isl_val_is_int(val) == isl_bool_true)
+      ops += isl_val_get_d(val) * n;
+    else
+      ops = -1;
+    isl_val_free(val);
+  }
+
+  return ops;
+}
+
+/* Return the SIMD stride of the access "expr" of the statement "stmt".
+ */
+static int access_expr_simd_stride(struct autosa_stmt *stmt,
+                                   __isl_keep pet_expr *expr)
+{
+  isl_id *ref_id = pet_expr_access_get_ref_id(expr);
+  int stride = -1;
+
+  for (struct autosa_stmt_access *access = stmt->accesses; access;
+       access = access->next)
+  {
+    if (access->ref_id == ref_id)
+    {
+      stride = access->simd_stride;
+      break;
+    }
+  }
+  isl_id_free(ref_id);
+
+  return stride;
+}
+
+/* Examine if the PEs of "kernel" pack two multiplies in one DSP
+ * with "--AutoSA-dsp-pack".
+ * This is the case if the SIMD factor is even and there is a narrow integer
+ * multiply-accumulate statement with one operand shared by the iterations
+ * of the SIMD loop (stride-0) and the other operand varying along the SIMD
+ * loop (stride-1).
+ */
+int autosa_kernel_dsp_pack(struct autosa_kernel *kernel)
+{
+  struct autosa_prog *prog = kernel->prog;
+  int dsp_pack = 0;
+
+  if (!kernel->options->autosa->dsp_pack || kernel->simd_w % 2 != 0)
+    return 0;
+
+  for (int i = 0; i < prog->n_stmts && !dsp_pack; i++)
+  {
+    struct autosa_stmt *stmt = &prog->stmts[i];
+    pet_expr *acc = NULL, *mul;
+    pet_expr *x, *y;
+    int sx, sy;
+
+    mul = autosa_stmt_extract_narrow_mac(prog, stmt->stmt, &acc);
+    if (!mul)
+      continue;
+    x = pet_expr_get_arg(mul, 0);
+    y = pet_expr_get_arg(mul, 1);
+    sx = access_expr_simd_stride(stmt, x);
+    sy = access_expr_simd_stride(stmt, y);
+    if ((sx == 0 && sy == 1) || (sx == 1 && sy == 0))
+      dsp_pack = 1;
+    pet_expr_free(x);
+    pet_expr_free(y);
+    pet_expr_free(mul);
+    pet_expr_free(acc);
+  }
+
+  return dsp_pack;
+}
+
+/* Count the number of module instances and FIFOs declared in the
+ * top module AST "tree". Each module instance is launched by one
+ * "module_call_upper" statement. For an if node, the branch with more
+ * instances is taken.
+ */
+static void count_top_module_instances(__isl_keep isl_ast_node *tree,
+                                       struct autosa_ast_est_data *data, long mult,
+                                       struct autosa_instance_count *count)
+{
+  enum isl_ast_node_type type;
+
+  if (!tree)
+    return;
+
+  type = isl_ast_node_get_type(tree);
+  switch (type)
+  {
+  case isl_ast_node_for:
+  {
+    isl_ast_node *body;
+    isl_ast_expr *iterator;
+    isl_id *id;
+    std::string name;
+    long lb, trip;
+
+    trip = ast_node_for_trip_count(tree, data, &lb);
+    iterator = isl_ast_node_for_get_iterator(tree);
+    id = isl_ast_expr_get_id(iterator);
+    name = isl_id_get_name(id);
+    isl_id_free(id);
+    isl_ast_expr_free(iterator);
+    data->iters[name] = lb;
+
+    body = isl_ast_node_for_get_body(tree);
+    count_top_module_instances(body, data, mult * trip, count);
+    isl_ast_node_free(body);
+    data->iters.erase(name);
+    break;
+  }
+  case isl_ast_node_block:
+  {
+    isl_ast_node_list *child_list = isl_ast_node_block_get_children(tree);
+    int n_child = isl_ast_node_list_n_ast_node(child_list);
+    for (int i = 0; i < n_child; i++)
+    {
+      isl_ast_node *child = isl_ast_node_list_get_ast_node(child_list, i);
+      count_top_module_instances(child, data, mult, count);
+      isl_ast_node_free(child);
+    }
+    isl_ast_node_list_free(child_list);
+    break;
+  }
+  case isl_ast_node_if:
+  {
+    struct autosa_instance_count then_count, else_count;
+    std::map<std::pair<void *, int>, long>::iterator it;
+    isl_ast_node *child;
+
+    then_count.n_fifo = else_count.n_fifo = 0;
+    then_count.fifo_bits = else_count.fifo_bits = 0;
+    then_count.fifo_bram18k = else_count.fifo_bram18k = 0;
+    child = isl_ast_node_if_get_then_node(tree);
+    count_top_module_instances(child, data, mult, &then_count);
+    isl_ast_node_free(child);
+    child = isl_ast_node_if_get_else_node(tree);
+    if (child)
+    {
+      count_top_module_instances(child, data, mult, &else_count);
+      isl_ast_node_free(child);
+    }
+    for (it = else_count.modules.begin(); it != else_count.modules.end(); it++)
+    {
+      if (it->second > then_count.modules[it->first])
+        then_count.modules[it->first] = it->second;
+    }
+    for (it = then_count.modules.begin(); it != then_count.modules.end(); it++)
+      count->modules[it->first] += it->second;
+    count->n_fifo += max(then_count.n_fifo, else_count.n_fifo);
+    count->fifo_bits += max(then_count.fifo_bits, else_count.fifo_bits);
+    count->fifo_bram18k += max(then_count.fifo_bram18k, else_count.fifo_bram18k);
+    break;
+  }
+  case isl_ast_node_mark:
+  {
+    isl_ast_node *child = isl_ast_node_mark_get_node(tree);
+    count_top_module_instances(child, data, mult, count);
+    isl_ast_node_free(child);
+    break;
+  }
+  case isl_ast_node_user:
+  {
+    isl_id *id = isl_ast_node_get_annotation(tree);
+    struct autosa_kernel_stmt *stmt;
+
+    if (!id)
+      break;
+    stmt = (struct autosa_kernel_stmt *)isl_id_get_user(id);
+    isl_id_free(id);
+    if (!stmt)
+      break;
+    if (stmt->type == AUTOSA_KERNEL_STMT_MODULE_CALL && stmt->u.m.upper)
+    {
+      void *module = stmt->u.m.pe_dummy_module ? (void *)stmt->u.m.pe_dummy_module : (void *)stmt->u.m.module;
+      count->modules[std::make_pair(module, stmt->u.m.boundary)] += mult;
+    }
+    else if (stmt->type == AUTOSA_KERNEL_STMT_FIFO_DECL)
+    {
+      struct autosa_array_ref_group *group = stmt->u.m.group;
+      long width = group->n_lane * group->array->size * 8;
+      int depth = autosa_fifo_depth(stmt->u.m.module, group->n_lane);
+      count->n_fifo += mult;
+      if (depth <= 32)
+        count->fifo_bits += mult * width * ((depth + 15) / 16);
+      else
+        count->fifo_bram18k += mult * ((width + 35) / 36) * ((depth + 511) / 512);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+/* Compute the resource usage of the local buffer "var" in "module".
+ * The buffer is bound to the memory type returned by extract_memory_type.
+ * Each partition of the buffer is mapped to BRAM18K (1024x18 or 512x36),
+ * URAM (4096x72) or LUTRAM (64x1) separately.
+ */
+static void extract_buffer_resource(struct autosa_gen *gen,
+                                    struct autosa_hw_module *module, struct autosa_kernel_var *var,
+                                    struct autosa_resource *res)
+{
+  long depth = 1, width, part_depth;
+  int n_part = var->n_part > 0 ? var->n_part : 1;
+  int mem_type;
+
+  for (int i = 0; i < isl_vec_size(var->size); i++)
+  {
+    isl_val *v = isl_vec_get_element_val(var->size, i);
+    depth *= isl_val_get_num_si(v);
+    isl_val_free(v);
+  }
+  width = var->n_lane * var->array->size * 8;
+  part_depth = (depth + n_part - 1) / n_part;
+
+  res->dsp = res->bram18k = res->uram = res->lut = res->ff = 0;
+  mem_type = extract_memory_type(module, var, gen->options->autosa->uram);
+  if (mem_type == 0)
+  {
+    res->ff = depth * width;
+  }
+  else if (mem_type == 1)
+  {
+    res->lut = n_part * width * ((part_depth + 63) / 64);
+  }
+  else if (mem_type == 2)
+  {
+    if (width <= 18)
+      res->bram18k = n_part * ((width + 17) / 18) * ((part_depth + 1023) / 1024);
+    else
+      res->bram18k = n_part * ((width + 35) / 36) * ((part_depth + 511) / 512);
+  }
+  else
+  {
+    res->uram = n_part * ((width + 71) / 72) * ((part_depth + 4095) / 4096);
+  }
+}
+
+/* Accumulate "n" copies of "res" into "total". */
+static void resource_add(struct autosa_resource *total,
+                         struct autosa_resource *res, long n)
+{
+  total->dsp += n * res->dsp;
+  total->bram18k += n * res->bram18k;
+  total->uram += n * res->uram;
+  total->lut += n * res->lut;
+  total->ff += n * res->ff;
+}
+
+static cJSON *resource_to_json(struct autosa_resource *res)
+{
+  cJSON *json = cJSON_CreateObject();
+
+  cJSON_AddItemToObject(json, "BRAM18K", cJSON_CreateNumber(res->bram18k));
+  cJSON_AddItemToObject(json, "DSP", cJSON_CreateNumber(res->dsp));
+  cJSON_AddItemToObject(json, "FF", cJSON_CreateNumber(res->ff));
+  cJSON_AddItemToObject(json, "LUT", cJSON_CreateNumber(res->lut));
+  cJSON_AddItemToObject(json, "URAM", cJSON_CreateNumber(res->uram));
+
+  return json;
+}
+
+/* Scale the resource usage "res" of a module of type "type" by its
+ * correction coefficients in "calibration", rounding up.
+ */
+static void resource_calibrate(struct autosa_resource *res, cJSON *calibration,
+                               const char *type)
+{
+  double coef;
+
+  coef = calibration_coef(calibration, "resource", type, "BRAM18K");
+  res->bram18k = (long)(res->bram18k * coef + 0.999);
+  coef = calibration_coef(calibration, "resource", type, "DSP");
+  res->dsp = (long)(res->dsp * coef + 0.999);
+  coef = calibration_coef(calibration, "resource", type, "FF");
+  res->ff = (long)(res->ff * coef + 0.999);
+  coef = calibration_coef(calibration, "resource", type, "LUT");
+  res->lut = (long)(res->lut * coef + 0.999);
+  coef = calibration_coef(calibration, "resource", type, "URAM");
+  res->uram = (long)(res->uram * coef + 0.999);
+}
+
+/* Check if the usage "used" of the resource "name" exceeds the
+ * utilization target "target" (in percentage) of the available amount
+ * in "hw_info". Record the utilization in "util".
+ */
+static isl_bool resource_exceeds_target(cJSON *hw_info, const char *name,
+                                        long used, int target, cJSON *util)
+{
+  cJSON *avail;
+  double ratio;
+
+  avail = cJSON_GetObjectItemCaseSensitive(hw_info, name);
+  if (!cJSON_IsNumber(avail))
+    return isl_bool_false;
+  ratio = avail->valuedouble > 0 ? (double)used / avail->valuedouble : 0;
+  cJSON_AddItemToObject(util, name, cJSON_CreateNumber(ratio));
+  if (ratio * 100 > target)
+  {
+    printf("[AutoSA] Error: %s utilization %.1f%% exceeds the target %d%%.\n",
+           name, ratio * 100, target);
+    return isl_bool_true;
+  }
+
+  return isl_bool_false;
+}
+
+/* Count the instances of the modules and FIFOs of the design in "count",
+ * from the top module ASTs.
+ */
+static void count_design_instances(struct autosa_gen *gen,
+                                   struct autosa_instance_count *count)
+{
+  struct autosa_ast_est_data data;
+  struct autosa_hw_top_module *top = gen->hw_top_module;
+
+  data.module = NULL;
+  data.under_pipeline = 0;
+  data.depth = 0;
+  count->n_fifo = 0;
+  count->fifo_bits = 0;
+  count->fifo_bram18k = 0;
+  for (int i = 0; i < top->n_module_calls; i++)
+    count_top_module_instances(top->module_call_trees[i], &data, 1, count);
+  for (int i = 0; i < top->n_fifo_decls; i++)
+    count_top_module_instances(top->fifo_decl_trees[i], &data, 1, count);
+}
+
+/* Extract the resource usage of one arithmetic lane of "kernel" in "op",
+ * based on the widest data type of the kernel arrays.
+ */
+static void extract_kernel_op_resource(struct autosa_kernel *kernel,
+                                       struct autosa_resource *op)
+{
+  extract_op_resource("char", op);
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_resource array_op;
+    struct autosa_array_info *array = kernel->array[i].array;
+    extract_op_resource(array->hls_type ? array->hls_type : array->type, &array_op);
+    if (array_op.dsp > op->dsp)
+      *op = array_op;
+  }
+}
+
+/* Extract the resource usage of one instance of "module" other than its
+ * local buffers in "res", i.e., a fixed control overhead and, for the PE,
+ * the arithmetic lanes "op" of the SIMD factor.
+ */
+static void extract_module_logic_resource(struct autosa_kernel *kernel,
+                                          struct autosa_hw_module *module, struct autosa_resource *op,
+                                          struct autosa_resource *res)
+{
+  res->dsp = res->bram18k = res->uram = 0;
+  res->lut = 200;
+  res->ff = 300;
+  if (module->type == PE_MODULE)
+  {
+    /* Two packed multiplies share one DSP. */
+    res->dsp += (autosa_kernel_dsp_pack(kernel) ? kernel->simd_w / 2 : kernel->simd_w) * op->dsp;
+    res->lut += kernel->simd_w * op->lut;
+    res->ff += kernel->simd_w * op->ff;
+  }
+}
+
+/* The maximal depth of the partitions of the local buffers that may be
+ * bound to LUTRAM by sa_bind_memory.
+ */
+#define AUTOSA_LUTRAM_MAX_DEPTH 128
+
+/* A local buffer "var" of "module" that occupies BRAM, URAM or LUTRAM,
+ * of which there are "n" copies in the design.
+ */
+struct autosa_mem_binding
+{
+  struct autosa_hw_module *module;
+  struct autosa_kernel_var *var;
+  long n;
+};
+
+/* Return the utilization of the BRAM, URAM and LUT resources "used",
+ * given the available amounts "avail", as the maximal utilization
+ * in "max" and the sum of the utilizations in "sum".
+ */
+static void mem_binding_util(long *used, double *avail, double *max, double *sum)
+{
+  *max = *sum = 0;
+  for (int i = 0; i < 3; i++)
+  {
+    double util;
+
+    if (avail[i] <= 0)
+      continue;
+    util = used[i] / avail[i];
+    *sum += util;
+    if (util > *max)
+      *max = util;
+  }
+}
+
+/* Bind the local buffers of all the modules of the design to the memory
+ * resources together, balancing the utilization of the BRAM, URAM and
+ * LUT resources available in "hw_info".
+ *
+ * The buffers are first bound by the heuristics of extract_memory_type.
+ * The buffers that are not bound to FF are then rebound greedily:
+ * at each step, the buffer and the memory type (LUTRAM, BRAM or URAM)
+ * that reduce the maximal utilization of the three resources the most,
+ * and then their sum, are picked, until no rebinding reduces them.
+ * This moves the wide and deep buffers to URAM and the shallow ones
+ * to LUTRAM when BRAM runs out first, and vice versa.
+ * Only the buffers with partitions of at most AUTOSA_LUTRAM_MAX_DEPTH
+ * elements may be bound to LUTRAM, and URAM is only used if it is
+ * available on the board.
+ * The LUT usage includes the logic and the FIFOs of the design,
+ * estimated as in sa_estimate_resource.
+ * The binding is recorded in the "mem_type" field of each buffer, which
+ * is picked up by extract_memory_type.
+ */
+isl_stat sa_bind_memory(struct autosa_gen *gen, cJSON *hw_info)
+{
+  struct autosa_instance_count count;
+  struct autosa_kernel *kernel = gen->kernel;
+  struct autosa_resource op, res;
+  std::vector<struct autosa_mem_binding> buffers;
+  const char *names[3] = {"BRAM", "URAM", "LUT"};
+  double avail[3];
+  long used[3], init[3];
+  int n_rebound = 0;
+
+  for (int i = 0; i < 3; i++)
+  {
+    cJSON *item = cJSON_GetObjectItemCaseSensitive(hw_info, names[i]);
+    avail[i] = cJSON_IsNumber(item) ? item->valuedouble : 0;
+  }
+  if (avail[0] <= 0)
+  {
+    printf("[AutoSA] Warning: No BRAM found in the hardware information, the memory binding is skipped.\n");
+    return isl_stat_ok;
+  }
+
+  count_design_instances(gen, &count);
+  extract_kernel_op_resource(kernel, &op);
+  used[0] = count.fifo_bram18k;
+  used[1] = 0;
+  used[2] = count.fifo_bits + 16 * count.n_fifo;
+  for (int i = 0; i < gen->n_hw_modules; i++)
+  {
+    struct autosa_hw_module *module = gen->hw_modules[i];
+    long n_inst;
+
+    n_inst = count.modules[std::make_pair((void *)module, 0)] +
+             count.modules[std::make_pair((void *)module, 1)];
+    extract_module_logic_resource(kernel, module, &op, &res);
+    used[2] += n_inst * res.lut;
+    for (int j = 0; j < module->n_var; j++)
+    {
+      struct autosa_mem_binding buffer;
+
+      buffer.module = module;
+      buffer.var = &module->var[j];
+      buffer.n = n_inst * (module->double_buffer ? 2 : 1);
+      buffer.var->mem_type = -1;
+      buffer.var->mem_type = extract_memory_type(module, buffer.var,
+                                                 gen->options->autosa->uram);
+      extract_buffer_resource(gen, module, buffer.var, &res);
+      used[0] += buffer.n * res.bram18k;
+      used[1] += buffer.n * res.uram;
+      used[2] += buffer.n * res.lut;
+      if (buffer.var->mem_type != 0 && buffer.n > 0)
+        buffers.push_back(buffer);
+    }
+  }
+  for (int i = 0; i < 3; i++)
+    init[i] = used[i];
+
+  while (1)
+  {
+    double cur_max, cur_sum, best_max, best_sum;
+    int best = -1, best_type = -1;
+    long best_used[3];
+
+    mem_binding_util(used, avail, &cur_max, &cur_sum);
+    best_max = cur_max;
+    best_sum = cur_sum;
+    for (size_t b = 0; b < buffers.size(); b++)
+    {
+      struct autosa_kernel_var *var = buffers[b].var;
+      struct autosa_resource old_res;
+      int old_type = var->mem_type;
+      long depth = 1;
+      int n_part = var->n_part > 0 ? var->n_part : 1;
+
+      for (int i = 0; i < isl_vec_size(var->size); i++)
+      {
+        isl_val *v = isl_vec_get_element_val(var->size, i);
+        depth *= isl_val_get_num_si(v);
+        isl_val_free(v);
+      }
+      extract_buffer_resource(gen, buffers[b].module, var, &old_res);
+      for (int type = 1; type <= 3; type++)
+      {
+        long new_used[3];
+        double new_max, new_sum;
+
+        if (type == old_type)
+          continue;
+        if (type == 1 && (depth + n_part - 1) / n_part > AUTOSA_LUTRAM_MAX_DEPTH)
+          continue;
+        if (type == 3 && avail[1] <= 0)
+          continue;
+        var->mem_type = type;
+        extract_buffer_resource(gen, buffers[b].module, var, &res);
+        var->mem_type = old_type;
+        new_used[0] = used[0] + buffers[b].n * (res.bram18k - old_res.bram18k);
+        new_used[1] = used[1] + buffers[b].n * (res.uram - old_res.uram);
+        new_used[2] = used[2] + buffers[b].n * (res.lut - old_res.lut);
+        mem_binding_util(new_used, avail, &new_max, &new_sum);
+        if (new_max < best_max - 1e-9 ||
+            (new_max < best_max + 1e-9 && new_sum < best_sum - 1e-9))
+        {
+          best = b;
+          best_type = type;
+          best_max = new_max;
+          best_sum = new_sum;
+          for (int i = 0; i < 3; i++)
+            best_used[i] = new_used[i];
+        }
+      }
+    }
+    if (best < 0)
+      break;
+    buffers[best].var->mem_type = best_type;
+    for (int i = 0; i < 3; i++)
+      used[i] = best_used[i];
+    n_rebound++;
+  }
+
+  printf("[AutoSA] Memory binding: %d rebindings, BRAM18K: %ld -> %ld, URAM: %ld -> %ld, LUT: %ld -> %ld\n",
+         n_rebound, init[0], used[0], init[1], used[1], init[2], used[2]);
+
+  return isl_stat_ok;
+}
+
+/* Estimate the resource usage of the design and store it in "total".
+ * The instance counts of the modules and FIFOs are derived from the
+ * top module ASTs. For each module instance, we count:
+ * - the arithmetic lanes in the PE (SIMD factor) based on the widest
+ *   data type of the kernel arrays
+ * - the local buffers (doubled with double buffering)
+ * - a fixed control overhead
+ * FIFOs are implemented in shift registers implemented by LUTs, except for
+ * the FIFOs deeper than 32, which are implemented in BRAMs.
+ *
+ * If "calibration" is not NULL, the resource usage of each module is scaled
+ * by the coefficients of its module type, and the FIFOs by the "FIFO"
+ * coefficients.
+ * If "hw_info" is not NULL, the estimated resource usage is compared
+ * against the available resources on the board. If any of the resources
+ * exceeds the utilization target, return isl_stat_error.
+ * The estimation results are printed to "resource_est/resource_info.json".
+ * The resource usage of the modules is printed uncalibrated, such that
+ * the coefficients can be refitted.
+ */
+isl_stat sa_estimate_resource(struct autosa_gen *gen, cJSON *hw_info,
+                              cJSON *calibration, struct autosa_resource *total)
+{
+  struct autosa_instance_count count;
+  struct autosa_kernel *kernel = gen->kernel;
+  struct autosa_resource op, res, raw_total;
+  cJSON *resource_info, *modules;
+  isl_ctx *ctx = gen->ctx;
+  isl_printer *p_str;
+  char *file_path, *json_str;
+  FILE *fp;
+  int target = gen->options->autosa->resource_target;
+  isl_bool exceed = isl_bool_false;
+
+  count_design_instances(gen, &count);
+  extract_kernel_op_resource(kernel, &op);
+
+  total->dsp = total->bram18k = total->uram = total->lut = total->ff = 0;
+  raw_total = *total;
+  resource_info = cJSON_CreateObject();
+  modules = cJSON_CreateObject();
+  cJSON_AddItemToObject(resource_info, "modules", modules);
+  for (int i = 0; i < gen->n_hw_modules; i++)
+  {
+    struct autosa_hw_module *module = gen->hw_modules[i];
+    struct autosa_resource module_res;
+    long n_inst, n_idle = 0;
+    cJSON *info;
+
+    n_inst = count.modules[std::make_pair((void *)module, 0)] +
+             count.modules[std::make_pair((void *)module, 1)];
+    /* The idle PEs of a non-rectangular array drop their arithmetic. */
+    if (module->type == PE_MODULE && kernel->options->autosa->triangular)
+      n_idle = min((long)kernel->n_pe_idle, n_inst);
+    extract_module_logic_resource(kernel, module, &op, &module_res);
+    for (int j = 0; j < module->n_var; j++)
+    {
+      extract_buffer_resource(gen, module, &module->var[j], &res);
+      resource_add(&module_res, &res, module->double_buffer ? 2 : 1);
+    }
+    info = resource_to_json(&module_res);
+    cJSON_AddItemToObject(info, "num", cJSON_CreateNumber(n_inst));
+    if (n_idle > 0)
+      cJSON_AddItemToObject(info, "num_idle", cJSON_CreateNumber(n_idle));
+    cJSON_AddStringToObject(info, "type", calibration_module_type(module));
+    cJSON_AddItemToObject(modules, module->name, info);
+
+    resource_add(&raw_total, &module_res, n_inst);
+    raw_total.dsp -= module_res.dsp * n_idle;
+    resource_calibrate(&module_res, calibration, calibration_module_type(module));
+    resource_add(total, &module_res, n_inst);
+    total->dsp -= module_res.dsp * n_idle;
+
+    for (int j = 0; j < module->n_pe_dummy_modules; j++)
+    {
+      long n_dummy;
+
+      n_dummy = count.modules[std::make_pair((void *)module->pe_dummy_modules[j], 0)];
+      res.dsp = res.bram18k = res.uram = 0;
+      res.lut = 200;
+      res.ff = 300;
+      resource_add(&raw_total, &res, n_dummy);
+      resource_calibrate(&res, calibration, "PE");
+      resource_add(total, &res, n_dummy);
+    }
+  }
+  /* FIFOs */
+  res.dsp = res.uram = 0;
+  res.bram18k = count.fifo_bram18k;
+  res.lut = count.fifo_bits + 16 * count.n_fifo;
+  res.ff = 16 * count.n_fifo;
+  resource_add(&raw_total, &res, 1);
+  resource_calibrate(&res, calibration, "FIFO");
+  resource_add(total, &res, 1);
+  cJSON_AddItemToObject(resource_info, "num_fifo", cJSON_CreateNumber(count.n_fifo));
+  cJSON_AddItemToObject(resource_info, "total", resource_to_json(total));
+  if (calibration)
+    cJSON_AddItemToObject(resource_info, "uncalibrated_total",
+                          resource_to_json(&raw_total));
+
+  if (hw_info)
+  {
+    cJSON *util = cJSON_CreateObject();
+    isl_bool exceed_i;
+
+    exceed_i = resource_exceeds_target(hw_info, "BRAM", total->bram18k, target, util);
+    exceed = (isl_bool)(exceed || exceed_i);
+    exceed_i = resource_exceeds_target(hw_info, "DSP", total->dsp, target, util);
+    exceed = (isl_bool)(exceed || exceed_i);
+    exceed_i = resource_exceeds_target(hw_info, "FF", total->ff, target, util);
+    exceed = (isl_bool)(exceed || exceed_i);
+    exceed_i = resource_exceeds_target(hw_info, "LUT", total->lut, target, util);
+    exceed = (isl_bool)(exceed || exceed_i);
+    exceed_i = resource_exceeds_target(hw_info, "URAM", total->uram, target, util);
+    exceed = (isl_bool)(exceed || exceed_i);
+    cJSON_AddItemToObject(resource_info, "utilization", util);
+  }
+
+  json_str = cJSON_Print(resource_info);
+  p_str = isl_printer_to_str(ctx);
+  p_str = isl_printer_print_str(p_str, gen->options->autosa->output_dir);
+  p_str = isl_printer_print_str(p_str, "/resource_est/resource_info.json");
+  file_path = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  fp = fopen(file_path, "w");
+  if (!fp)
+  {
+    printf("[AutoSA] Error: Cannot open file: %s\n", file_path);
+    exit(1);
+  }
+  free(file_path);
+  fprintf(fp, "%s", json_str);
+  fclose(fp);
+  free(json_str);
+  cJSON_Delete(resource_info);
+
+  printf("[AutoSA] Estimated resource: DSP: %ld BRAM18K: %ld URAM: %ld LUT: %ld FF: %ld\n",
+         total->dsp, total->bram18k, total->uram, total->lut, total->ff);
+
+  return exceed ? isl_stat_error : isl_stat_ok;
+}
+
+/* Select the number of compute units of the kernel of "gen", i.e.,
+ * the number of copies of the kernel in the design, each with the resource
+ * usage "total" estimated by sa_estimate_resource.
+ * With "--AutoSA-compute-units=0", the number of compute units is
+ * the number of copies that fit in the resources of "hw_info" under
+ * the utilization target, bounded by the number of DDR banks ("DDR")
+ * if known, as each compute unit is connected to its own bank.
+ * A given number of compute units is only checked against "hw_info".
+ * The selected number is stored back in the option.
+ */
+void sa_select_compute_units(struct autosa_gen *gen, cJSON *hw_info,
+                             struct autosa_resource *total)
+{
+  int *n_cu = &gen->options->autosa->compute_units;
+  int target = gen->options->autosa->resource_target;
+  const char *names[] = {"BRAM", "DSP", "FF", "LUT", "URAM", "DDR"};
+  long used[] = {total->bram18k, total->dsp, total->ff, total->lut,
+                 total->uram, 1};
+  int fit = -1;
+
+  if (*n_cu == 1)
+    return;
+  if (gen->options->target != AUTOSA_TARGET_XILINX_HLS_C)
+  {
+    *n_cu = 1;
+    return;
+  }
+  for (int i = 0; hw_info && i < 6; i++)
+  {
+    cJSON *avail = cJSON_GetObjectItemCaseSensitive(hw_info, names[i]);
+    double n;
+
+    if (!cJSON_IsNumber(avail) || used[i] <= 0)
+      continue;
+    n = avail->valuedouble / used[i];
+    if (strcmp(names[i], "DDR"))
+      n = n * target / 100;
+    if (fit < 0 || n < fit)
+      fit = (int)n;
+  }
+
+  if (*n_cu == 0)
+  {
+    if (fit < 0)
+      printf("[AutoSA] Warning: The number of compute units requires the hardware information (--AutoSA-hw-info). A single compute unit is generated.\n");
+    *n_cu = max(fit, 1);
+    printf("[AutoSA] Select %d compute units.\n", *n_cu);
+  }
+  else if (fit >= 0 && *n_cu > fit)
+  {
+    printf("[AutoSA] Warning: %d compute units exceed the resource utilization target or the DDR banks, at most %d fit.\n",
+           *n_cu, fit);
+  }
+}
+
+/****************************************************************
+ * AutoSA roofline model
+ ****************************************************************/
+/* Count the operations, i.e., the computation statement instances, and the
+ * bytes transferred from or to the external memory by the AST "tree" of
+ * a hardware module executed "n" times, and add them to "ops" and "bytes".
+ * The I/O module calls are replaced by the corresponding inter_trans and
+ * intra_trans functions. For an if node, the larger branch is taken.
+ */
+static void count_module_tree_traffic(__isl_keep isl_ast_node *tree,
+                                      struct autosa_ast_est_data *data, double n,
+                                      double *ops, double *bytes)
+{
+  enum isl_ast_node_type type;
+
+  if (!tree)
+    return;
+
+  type = isl_ast_node_get_type(tree);
+  switch (type)
+  {
+  case isl_ast_node_for:
+  {
+    isl_ast_node *body;
+    isl_ast_expr *iterator;
+    isl_id *id;
+    std::string name;
+    long lb, trip;
+
+    trip = ast_node_for_trip_count(tree, data, &lb);
+    iterator = isl_ast_node_for_get_iterator(tree);
+    id = isl_ast_expr_get_id(iterator);
+    name = isl_id_get_name(id);
+    isl_id_free(id);
+    isl_ast_expr_free(iterator);
+    data->iters[name] = lb;
+
+    body = isl_ast_node_for_get_body(tree);
+    count_module_tree_traffic(body, data, n * trip, ops, bytes);
+    isl_ast_node_free(body);
+    data->iters.erase(name);
+    break;
+  }
+  case isl_ast_node_block:
+  {
+    isl_ast_node_list *child_list = isl_ast_node_block_get_children(tree);
+    int n_child = isl_ast_node_list_n_ast_node(child_list);
+    for (int i = 0; i < n_child; i++)
+    {
+      isl_ast_node *child = isl_ast_node_list_get_ast_node(child_list, i);
+      count_module_tree_traffic(child, data, n, ops, bytes);
+      isl_ast_node_free(child);
+    }
+    isl_ast_node_list_free(child_list);
+    break;
+  }
+  case isl_ast_node_if:
+  {
+    double then_ops = 0, then_bytes = 0, else_ops = 0, else_bytes = 0;
+    isl_ast_node *child;
+
+    child = isl_ast_node_if_get_then_node(tree);
+    count_module_tree_traffic(child, data, n, &then_ops, &then_bytes);
+    isl_ast_node_free(child);
+    child = isl_ast_node_if_get_else_node(tree);
+    if (child)
+    {
+      count_module_tree_traffic(child, data, n, &else_ops, &else_bytes);
+      isl_ast_node_free(child);
+    }
+    *ops += max(then_ops, else_ops);
+    *bytes += max(then_bytes, else_bytes);
+    break;
+  }
+  case isl_ast_node_mark:
+  {
+    isl_ast_node *child = isl_ast_node_mark_get_node(tree);
+    count_module_tree_traffic(child, data, n, ops, bytes);
+    isl_ast_node_free(child);
+    break;
+  }
+  case isl_ast_node_user:
+  {
+    isl_id *id = isl_ast_node_get_annotation(tree);
+    struct autosa_kernel_stmt *stmt;
+    const char *name;
+
+    if (!id)
+      break;
+    name = isl_id_get_name(id);
+    stmt = (struct autosa_kernel_stmt *)isl_id_get_user(id);
+    isl_id_free(id);
+    if (!prefixcmp(name, "io_module.credit"))
+      break;
+    if (!prefixcmp(name, "io_module."))
+    {
+      struct autosa_hw_module *module = stmt ? stmt->u.f.module : data->module;
+      int boundary = stmt ? stmt->u.f.boundary : 0;
+
+      if (prefixcmp(name, "io_module.intra_trans"))
+        count_module_tree_traffic(boundary ? module->boundary_inter_tree : module->inter_tree,
+                                  data, n, ops, bytes);
+      if (prefixcmp(name, "io_module.inter_trans"))
+        count_module_tree_traffic(module->intra_tree, data, n, ops, bytes);
+      break;
+    }
+    if (!stmt)
+      break;
+    if (stmt->type == AUTOSA_KERNEL_STMT_DOMAIN)
+      *ops += n;
+    else if (stmt->type == AUTOSA_KERNEL_STMT_IO_DRAM)
+      *bytes += n * stmt->u.i.data_pack * stmt->u.i.array->size;
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+/* Return the number of points in the bounding box of "set",
+ * or -1 if "set" lives in more than one space or the box has no constant
+ * size.
+ */
+static long union_set_box_size(__isl_take isl_union_set *set)
+{
+  isl_map *map;
+  isl_fixed_box *box;
+  long size = -1;
+  int n;
+
+  set = isl_union_set_coalesce(set);
+  if (isl_union_set_n_set(set) != 1)
+  {
+    isl_union_set_free(set);
+    return -1;
+  }
+
+  map = isl_map_from_range(isl_set_from_union_set(set));
+  n = isl_map_dim(map, isl_dim_out);
+  box = isl_map_get_range_simple_fixed_box_hull(map);
+  isl_map_free(map);
+  if (isl_fixed_box_is_valid(box) == isl_bool_true)
+  {
+    isl_multi_val *mv = isl_fixed_box_get_size(box);
+    size = 1;
+    for (int i = 0; i < n; i++)
+    {
+      isl_val *val = isl_multi_val_get_val(mv, i);
+      size *= isl_val_get_num_si(val);
+      isl_val_free(val);
+    }
+    isl_multi_val_free(mv);
+  }
+  isl_fixed_box_free(box);
+
+  return size;
+}
+
+/* Return the number of array tiles of "kernel", i.e., the number of
+ * iterations of the array partitioning loops above the "array" mark,
+ * or -1 if it is not bounded by a constant.
+ * The array partitioning loops iterate over the tile indices.
+ */
+static long kernel_array_tile_count(struct autosa_kernel *kernel)
+{
+  isl_schedule_node *node;
+  isl_union_map *prefix;
+
+  node = isl_schedule_get_root(kernel->schedule);
+  node = autosa_tree_move_down_to_array(node, kernel->core);
+  prefix = isl_schedule_node_get_prefix_schedule_union_map(node);
+  isl_schedule_node_free(node);
+
+  return union_set_box_size(isl_union_map_range(prefix));
+}
+
+/* Estimate the cycles of the PCIe transfers between the host and
+ * the device of a single run of "kernel", at the kernel frequency "freq"
+ * (in MHz). The host copies the complete extents of the arrays read by
+ * the kernel to the device, and of the arrays written by the kernel back
+ * to the host. The cycles of both directions are stored in "in" and "out".
+ * The bandwidth of the host link ("PCIE_BW" in GB/s, e.g., the measured
+ * XDMA throughput of the platform) is read from "hw_info" if provided.
+ * Otherwise, we use 12 GB/s, i.e., PCIe Gen3 x16.
+ * The arrays whose extents are not fixed by the context are not counted.
+ */
+void sa_estimate_host_transfer(struct autosa_kernel *kernel, cJSON *hw_info,
+                               double freq, double *in, double *out)
+{
+  struct autosa_prog *prog = kernel->prog;
+  isl_union_set *read, *written;
+  double bw = 12, bw_cycle;
+  cJSON *item;
+
+  if (hw_info)
+  {
+    item = cJSON_GetObjectItemCaseSensitive(hw_info, "PCIE_BW");
+    if (cJSON_IsNumber(item))
+      bw = item->valuedouble;
+  }
+  bw_cycle = bw * 1000 / freq;
+
+  read = isl_union_map_range(isl_union_map_apply_range(
+      isl_union_map_copy(prog->read), isl_union_map_copy(prog->to_outer)));
+  written = isl_union_map_range(isl_union_map_apply_range(
+      isl_union_map_copy(prog->may_write), isl_union_map_copy(prog->to_outer)));
+  *in = 0;
+  *out = 0;
+  for (int i = 0; i < prog->n_array; i++)
+  {
+    struct autosa_array_info *array = &prog->array[i];
+    isl_set *extent, *elements;
+    int is_read, is_written;
+    long size;
+
+    if (array->local || !array->accessed)
+      continue;
+    elements = isl_union_set_extract_set(read, isl_space_copy(array->space));
+    is_read = isl_set_is_empty(elements) == isl_bool_false;
+    isl_set_free(elements);
+    elements = isl_union_set_extract_set(written, isl_space_copy(array->space));
+    is_written = isl_set_is_empty(elements) == isl_bool_false;
+    isl_set_free(elements);
+
+    extent = isl_set_copy(array->extent);
+    extent = isl_set_intersect_params(extent, isl_set_copy(prog->context));
+    size = union_set_box_size(isl_union_set_from_set(extent));
+    if (size < 0)
+      continue;
+    if (is_read)
+      *in += (double)size * array->size / bw_cycle;
+    if (is_written)
+      *out += (double)size * array->size / bw_cycle;
+  }
+  isl_union_set_free(read);
+  isl_union_set_free(written);
+}
+
+/* Return the end-to-end latency of a request to the kernel with
+ * the latency "latency", including the host transfers of "in" and "out"
+ * cycles to and from the device.
+ * With several batches in flight (--AutoSA-host-batch), the transfers
+ * of a batch overlap the execution of the others on the full-duplex link,
+ * and the throughput is bounded by the slowest of the three stages.
+ * Otherwise, the transfers and the execution are serialized.
+ */
+double sa_end_to_end_latency(struct ppcg_options *options, double latency,
+                             double in, double out)
+{
+  if (options->autosa->host_batch > 1)
+    return max(latency, max(in, out));
+
+  return in + latency + out;
+}
+
+/* Place the design on the roofline of the platform.
+ * The peak throughput is the number of PE lanes, i.e., the number of PE
+ * instances times the SIMD factor, in operations per cycle.
+ * The operations are counted from the computation statements of the PEs,
+ * and the off-chip traffic from the external memory accesses of the I/O
+ * modules. The operational intensity is their ratio, in operations per byte.
+ * The off-chip bandwidth ("DRAM_BW", or "HBM_BW" with HBM, in GB/s) and the
+ * frequency ("FREQ" in MHz) are read from "hw_info" if provided. Otherwise,
+ * we use the default values of Xilinx Alveo U250.
+ * The design is memory-bound if its operational intensity is below the
+ * ridge point of the roofline, i.e., the peak throughput divided by the
+ * off-chip bandwidth in bytes per cycle, and compute-bound otherwise.
+ * "latency" is the estimated latency of the kernel, compared to the
+ * compute and memory bounds. It is completed with the PCIe transfers
+ * of the arrays between the host and the device into the end-to-end
+ * latency, see sa_estimate_host_transfer and sa_end_to_end_latency.
+ * The roofline summary is printed to "roofline.json".
+ */
+isl_stat sa_estimate_roofline(struct autosa_gen *gen, cJSON *hw_info,
+                              long latency)
+{
+  struct autosa_ast_est_data data;
+  struct autosa_instance_count count;
+  struct autosa_hw_top_module *top = gen->hw_top_module;
+  struct autosa_kernel *kernel = gen->kernel;
+  cJSON *roofline;
+  isl_printer *p_str;
+  char *file_path, *json_str;
+  FILE *fp;
+  double bw = 77, freq = 300;
+  double ops = 0, bytes = 0, bw_cycle, intensity, ridge, attainable;
+  double host_in, host_out, end_to_end;
+  long n_pe = 0, peak, n_tile;
+  cJSON *item;
+
+  if (hw_info)
+  {
+    item = cJSON_GetObjectItemCaseSensitive(hw_info,
+                                            gen->options->autosa->hbm ? "HBM_BW" : "DRAM_BW");
+    if (cJSON_IsNumber(item))
+      bw = item->valuedouble;
+    item = cJSON_GetObjectItemCaseSensitive(hw_info, "FREQ");
+    if (cJSON_IsNumber(item))
+      freq = item->valuedouble;
+  }
+  bw_cycle = bw * 1000 / freq;
+
+  data.module = NULL;
+  data.under_pipeline = 0;
+  data.depth = 0;
+  count.n_fifo = 0;
+  count.fifo_bits = 0;
+  count.fifo_bram18k = 0;
+  for (int i = 0; i < top->n_module_calls; i++)
+    count_top_module_instances(top->module_call_trees[i], &data, 1, &count);
+
+  for (int i = 0; i < gen->n_hw_modules; i++)
+  {
+    struct autosa_hw_module *module = gen->hw_modules[i];
+    double module_ops = 0, module_bytes = 0;
+    long n_inst = count.modules[std::make_pair((void *)module, 0)];
+    long n_boundary = count.modules[std::make_pair((void *)module, 1)];
+
+    if (module->type != PE_MODULE && !module->to_mem)
+      continue;
+    data.module = module;
+    count_module_tree_traffic(module->device_tree, &data, n_inst,
+                              &module_ops, &module_bytes);
+    if (module->boundary)
+      count_module_tree_traffic(module->boundary_tree, &data, n_boundary,
+                                &module_ops, &module_bytes);
+    if (module->type == PE_MODULE)
+    {
+      n_pe += n_inst + n_boundary;
+      ops += module_ops;
+    }
+    else
+    {
+      bytes += module_bytes;
+    }
+  }
+
+  peak = n_pe * kernel->simd_w;
+  intensity = bytes > 0 ? ops / bytes : 0;
+  ridge = peak / bw_cycle;
+  attainable = bytes > 0 ? min((double)peak, intensity * bw_cycle) : peak;
+  n_tile = kernel_array_tile_count(kernel);
+
+  roofline = cJSON_CreateObject();
+  cJSON_AddNumberToObject(roofline, "num_pe", n_pe);
+  cJSON_AddNumberToObject(roofline, "simd", kernel->simd_w);
+  cJSON_AddNumberToObject(roofline, "peak_ops_per_cycle", peak);
+  cJSON_AddNumberToObject(roofline, "ops", ops);
+  cJSON_AddNumberToObject(roofline, "off_chip_bytes", bytes);
+  if (n_tile > 0)
+  {
+    cJSON_AddNumberToObject(roofline, "num_tiles", n_tile);
+    cJSON_AddNumberToObject(roofline, "off_chip_bytes_per_tile", bytes / n_tile);
+  }
+  cJSON_AddNumberToObject(roofline, "operational_intensity", intensity);
+  cJSON_AddNumberToObject(roofline, "bandwidth_GBps", bw);
+  cJSON_AddNumberToObject(roofline, "frequency_MHz", freq);
+  cJSON_AddNumberToObject(roofline, "bandwidth_bytes_per_cycle", bw_cycle);
+  cJSON_AddNumberToObject(roofline, "ridge_point", ridge);
+  cJSON_AddNumberToObject(roofline, "attainable_ops_per_cycle", attainable);
+  cJSON_AddStringToObject(roofline, "bound", intensity < ridge && bytes > 0 ? "memory" : "compute");
+  cJSON_AddNumberToObject(roofline, "compute_cycles", peak > 0 ? ops / peak : 0);
+  cJSON_AddNumberToObject(roofline, "memory_cycles", bytes / bw_cycle);
+  cJSON_AddNumberToObject(roofline, "latency", latency);
+  sa_estimate_host_transfer(kernel, hw_info, freq, &host_in, &host_out);
+  end_to_end = sa_end_to_end_latency(gen->options, latency, host_in, host_out);
+  cJSON_AddNumberToObject(roofline, "host_to_device_cycles", host_in);
+  cJSON_AddNumberToObject(roofline, "device_to_host_cycles", host_out);
+  cJSON_AddNumberToObject(roofline, "end_to_end_latency", end_to_end);
+
+  json_str = cJSON_Print(roofline);
+  p_str = isl_printer_to_str(gen->ctx);
+  p_str = isl_printer_print_str(p_str, gen->options->autosa->output_dir);
+  p_str = isl_printer_print_str(p_str, "/roofline.json");
+  file_path = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  fp = fopen(file_path, "w");
+  if (!fp)
+  {
+    printf("[AutoSA] Error: Cannot open file: %s\n", file_path);
+    exit(1);
+  }
+  free(file_path);
+  fprintf(fp, "%s", json_str);
+  fclose(fp);
+  free(json_str);
+  cJSON_Delete(roofline);
+
+  printf("[AutoSA] Roofline: %.2f ops/byte (ridge point: %.2f), peak: %ld ops/cycle, attainable: %.1f ops/cycle, %s-bound\n",
+         intensity, ridge, peak, attainable,
+         intensity < ridge && bytes > 0 ? "memory" : "compute");
+  printf("[AutoSA] End-to-end latency: %.0f cycles (kernel: %ld, host to device: %.0f, device to host: %.0f, %s)\n",
+         end_to_end, latency, host_in, host_out,
+         gen->options->autosa->host_batch > 1 ? "overlapped" : "serialized");
+
+  return isl_stat_ok;
+}
+
+/* Report the off-chip traffic of each array of the design.
+ * For each I/O or drain module connected to the external memory, the bytes
+ * transferred are counted from its external memory accesses, executed by
+ * all the module instances.
+ * These are compared to the footprint of the I/O group of the module,
+ * i.e., the bounding box of the array elements in the access relation of
+ * the group, which is the minimal traffic if each element is transferred
+ * once. A redundancy above one shows that the elements are re-read or
+ * re-written across the array tiles, as determined by the order of the
+ * array partitioning loops.
+ * The traffic report is printed to "traffic.json".
+ */
+isl_stat sa_estimate_traffic(struct autosa_gen *gen)
+{
+  struct autosa_ast_est_data data;
+  struct autosa_instance_count count;
+  struct autosa_hw_top_module *top = gen->hw_top_module;
+  std::map<std::string, double> read_bytes, write_bytes;
+  cJSON *traffic, *groups, *arrays;
+  isl_printer *p_str;
+  char *file_path, *json_str;
+  FILE *fp;
+  long n_tile;
+
+  data.module = NULL;
+  data.under_pipeline = 0;
+  data.depth = 0;
+  count.n_fifo = 0;
+  count.fifo_bits = 0;
+  count.fifo_bram18k = 0;
+  for (int i = 0; i < top->n_module_calls; i++)
+    count_top_module_instances(top->module_call_trees[i], &data, 1, &count);
+  n_tile = kernel_array_tile_count(gen->kernel);
+
+  traffic = cJSON_CreateObject();
+  if (n_tile > 0)
+    cJSON_AddNumberToObject(traffic, "num_tiles", n_tile);
+  groups = cJSON_CreateObject();
+  cJSON_AddItemToObject(traffic, "groups", groups);
+  for (int i = 0; i < gen->n_hw_modules; i++)
+  {
+    struct autosa_hw_module *module = gen->hw_modules[i];
+    struct autosa_array_ref_group *group;
+    double ops = 0, bytes = 0;
+    long footprint;
+    isl_union_map *access;
+    cJSON *info;
+
+    if (!module->to_mem || module->n_io_group == 0)
+      continue;
+    group = module->io_groups[0];
+    data.module = module;
+    count_module_tree_traffic(module->device_tree, &data,
+                              count.modules[std::make_pair((void *)module, 0)], &ops, &bytes);
+    if (module->boundary)
+      count_module_tree_traffic(module->boundary_tree, &data,
+                                count.modules[std::make_pair((void *)module, 1)], &ops, &bytes);
+    if (module->in)
+      read_bytes[group->array->name] += bytes;
+    else
+      write_bytes[group->array->name] += bytes;
+
+    access = autosa_io_group_access_relation(group, module->in, !module->in);
+    footprint = union_set_box_size(isl_union_map_range(access));
+
+    info = cJSON_CreateObject();
+    cJSON_AddStringToObject(info, "array", group->array->name);
+    cJSON_AddStringToObject(info, "direction", module->in ? "read" : "write");
+    cJSON_AddNumberToObject(info, "bytes", bytes);
+    if (n_tile > 0)
+      cJSON_AddNumberToObject(info, "bytes_per_tile", bytes / n_tile);
+    if (footprint > 0)
+    {
+      double footprint_bytes = (double)footprint * group->array->size;
+      cJSON_AddNumberToObject(info, "footprint_bytes", footprint_bytes);
+      cJSON_AddNumberToObject(info, "redundancy", bytes / footprint_bytes);
+    }
+    cJSON_AddItemToObject(groups, module->name, info);
+  }
+
+  arrays = cJSON_CreateObject();
+  cJSON_AddItemToObject(traffic, "arrays", arrays);
+  for (int i = 0; i < gen->kernel->n_array; i++)
+  {
+    struct autosa_array_info *array = gen->kernel->array[i].array;
+    double read = read_bytes[array->name], write = write_bytes[array->name];
+    cJSON *info;
+
+    if (read == 0 && write == 0)
+      continue;
+    info = cJSON_CreateObject();
+    cJSON_AddNumberToObject(info, "read_bytes", read);
+    cJSON_AddNumberToObject(info, "write_bytes", write);
+    cJSON_AddItemToObject(arrays, array->name, info);
+    printf("[AutoSA] Off-chip traffic of array %s: %.0f bytes read, %.0f bytes written\n",
+           array->name, read, write);
+  }
+
+  json_str = cJSON_Print(traffic);
+  p_str = isl_printer_to_str(gen->ctx);
+  p_str = isl_printer_print_str(p_str, gen->options->autosa->output_dir);
+  p_str = isl_printer_print_str(p_str, "/traffic.json");
+  file_path = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  fp = fopen(file_path, "w");
+  if (!fp)
+  {
+    printf("[AutoSA] Error: Cannot open file: %s\n", file_path);
+    exit(1);
+  }
+  free(file_path);
+  fprintf(fp, "%s", json_str);
+  fclose(fp);
+  free(json_str);
+  cJSON_Delete(traffic);
+
+  return isl_stat_ok;
+}
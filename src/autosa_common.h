@@ -51,6 +51,17 @@ extern "C"
 #define min(a, b) (((a) < (b)) ? (a) : (b))
 #define max(a, b) (((a) > (b)) ? (a) : (b))
 
+/* Latencies (in cycles) of the basic operations assumed by the latency model.
+ * The FIFO depth matches the depth of the FIFOs declared in the generated
+ * designs.
+ */
+#define AUTOSA_LAT_COMPUTE 5
+#define AUTOSA_LAT_FIFO 1
+#define AUTOSA_LAT_BUFFER 2
+#define AUTOSA_LAT_DRAM 64
+#define AUTOSA_LAT_CDC 8
+#define AUTOSA_FIFO_DEPTH 2
+
 enum autosa_group_access_type
 {
   AUTOSA_ACCESS_GLOBAL,
@@ -76,7 +87,8 @@ enum autosa_kernel_stmt_type
   AUTOSA_KERNEL_STMT_IO_MODULE_CALL_INTRA_TRANS,
   AUTOSA_KERNEL_STMT_IO_MODULE_CALL_INTER_INTRA,
   AUTOSA_KERNEL_STMT_IO_MODULE_CALL_INTRA_INTER,
-  AUTOSA_KERNEL_STMT_IO_MODULE_CALL_STATE_HANDLE
+  AUTOSA_KERNEL_STMT_IO_MODULE_CALL_STATE_HANDLE,
+  AUTOSA_KERNEL_STMT_IO_MODULE_CALL_CREDIT
 };
 
 enum autosa_dep_type
@@ -173,6 +185,9 @@ struct autosa_kernel_var
   int n_lane;
   /* Array partition factors */
   int n_part;
+  /* Memory type bound by sa_bind_memory (0: FF 1: LUTRAM 2: BRAM 3: URAM),
+   * or -1 if unbound */
+  int mem_type;
 };
 
 struct autosa_kernel
@@ -191,6 +206,20 @@ struct autosa_kernel
   int time_w;
   int simd_w;
   int lat_hide_len;
+  /* Compiled numbers of array partitions along the array partitioning loops,
+   * executed up to the parameters "n_tile_<i>" set at runtime.
+   */
+  int n_runtime_tile;
+  int *runtime_tile_ub;
+  /* Tiling factors of the array partitioning loops set at runtime. */
+  int *runtime_tile_size;
+  /* Set if the iteration domain is padded to multiples of the array
+   * partitioning tiling factors. The padded statement instances are masked.
+   */
+  int padded_domain;
+  /* Number of PEs in the bounding box of a non-rectangular (e.g., triangular)
+   * array that don't execute any statement instance. */
+  int n_pe_idle;
 
   int type; // AUTOSA_SA_TYPE_ASYNC | AUTOSA_SA_TYPE_SYNC
 
@@ -199,6 +228,9 @@ struct autosa_kernel
   isl_union_map *sizes;
   /* Effectively used (array_part/latency_hiding/simd) sizes for each kernel. */
   isl_union_map *used_sizes;
+  /* Tuning information of the PE optimization stage with missing tile sizes.
+   * Only set in the exploration mode. */
+  cJSON *tuning;
 
   /* Identifier of the kernel. */
   int id;
@@ -230,6 +262,8 @@ struct autosa_kernel
    */
   isl_space *space;
   isl_ast_node *tree;
+  /* AST of the CUDA kernel, only generated for the CUDA target. */
+  isl_ast_node *cuda_tree;
 
   /* Local variables in a kernel. */
   int n_var;
@@ -249,6 +283,11 @@ struct autosa_kernel
    */
   isl_union_set *pe_filter;
 
+  /* The instances of the sums that are the first updates of the array
+   * elements set to zero by the initializations fused into the PE.
+   */
+  isl_union_set *fused_init;
+
   /* The first n_grid elements of grid_dim represent the specified size of 
    * the grid.
    * The first n_block elements of block_dim represent the specified or 
@@ -381,6 +420,8 @@ struct autosa_array_info
   isl_space *space;
   /* Element type. */
   char *type;
+  /* Arbitrary-precision type of the elements in the kernel, NULL if none. */
+  char *hls_type;
   /* Element size. */
   int size;
   /* Name of the array. */
@@ -443,6 +484,8 @@ struct autosa_array_info
   int copy_in;
   /* Is the array to be copied out from the device memory? */
   int copy_out;
+  /* Is the array read through data-dependent indices from a cache? */
+  int irregular;
   /* AutoSA Extended */
 };
 
@@ -542,6 +585,9 @@ struct autosa_array_ref_group
   int copy_in;
   /* Does copy-out module exist? */
   int copy_out;
+  /* Minimal FIFO widths (in bits) at the "pe", "inner" and "dram" I/O levels
+   * raised by the I/O rebalancing, 0 if not raised. */
+  int rebalance_width[3];
   /* AutoSA Extended */
 };
 
@@ -587,8 +633,12 @@ struct autosa_local_array_info
   int n_io_group_refs;
   /* Number of external memory ports that this array is allocated. */
   int n_mem_ports;
+  /* Memory port shared by the read-only I/O groups, -1 if not allocated. */
+  int shared_in_port;
   /* Map from io_group_ref to mem_port. */
   std::vector<std::pair<int, int> > group_ref_mem_port_map;
+  /* Bandwidth demand of each io_group_ref in bytes per cycle. */
+  std::vector<double> group_ref_bw_demand;
 
   /* Default groups */
   int n_group;
@@ -599,6 +649,23 @@ struct autosa_local_array_info
 
   int force_private;
   int global;
+  /* Is the array serialized by the host in the DRAM access order? */
+  int host_serialize;
+  /* Number of DRAM accesses per block of the serialized array if it is
+   * compressed by the host into its non-zero blocks, 0 otherwise. */
+  int host_sparse_block;
+  /* Is the serialized array streamed to the kernel through a QDMA host
+   * stream instead of the external memory? */
+  int host_stream;
+  /* Dimension along which the array is partitioned across the devices of
+   * the multi-device host, and number of rows of this dimension per device.
+   * "device_stride" is 0 if the array is copied to all the devices, or
+   * reduced across the devices if it is written by the kernel. */
+  int device_dim;
+  int device_stride;
+  /* Rows of the dimension "device_dim" written by the first device. */
+  int device_lo;
+  int device_hi;
 
   unsigned n_index;
   isl_multi_pw_aff *bound;
@@ -765,7 +832,10 @@ struct autosa_hw_module
 
   int double_buffer;
 
-  /* Generate credit control */
+  /* Depth of the credit control, i.e., the number of array partitions
+   * the module reading the array may run ahead of the module writing it,
+   * 0 if credit control is disabled.
+   */
   int credit;
 
   /* Data pack factor */
@@ -778,6 +848,16 @@ struct autosa_hw_module
   struct autosa_kernel *kernel;
 };
 
+/* Estimated resource usage of a hardware design. */
+struct autosa_resource
+{
+  long dsp;
+  long bram18k;
+  long uram;
+  long lut;
+  long ff;
+};
+
 struct autosa_gen
 {
   isl_ctx *ctx;
@@ -821,6 +901,9 @@ struct autosa_gen
 
   /* Tuning configuration */
   cJSON *tuning_config;
+
+  /* Compilation profile, NULL if profiling is disabled */
+  struct autosa_profile *profile;
 };
 
 /* Representation of special statements, in particular copy statements
@@ -876,6 +959,14 @@ struct autosa_kernel_stmt
     {
       struct autosa_stmt *stmt;
       isl_id_to_ast_expr *ref2expr;
+      /* Condition masking the padded statement instances, if any. */
+      isl_ast_expr *guard;
+      /* Condition selecting the first update of the accumulator
+       * whose zero initialization is fused into the statement, if any.
+       */
+      isl_ast_expr *init;
+      /* The array of the accumulator selected by "init". */
+      struct autosa_array_info *init_array;
     } d;
     struct
     {
@@ -943,10 +1034,16 @@ struct autosa_node_band_prop
   isl_multi_union_pw_aff *mupa;
 };
 
+/* "iter_bits" is the bit width of the iterator of a for node, inferred
+ * from the bounds of the loop, or 0 if the iterator is kept as an "int".
+ * "iter_signed" is set if the iterator may be negative.
+ */
 struct autosa_ast_node_userinfo
 {
   int is_pipeline;
   int is_unroll;
+  int iter_bits;
+  int iter_signed;
 };
 
 /* The current index is such that if you add "shift",
@@ -1008,6 +1105,32 @@ struct hls_info
 
   enum platform target;
   int hls;          /* Generate HLS host instead of OpenCL host */
+  int host_batch;   /* Number of in-flight batches in OpenCL host */
+  int host_serialize; /* Serialize the arrays in OpenCL host */
+  int host_zero_copy; /* Bind device buffers to host arrays in OpenCL host */
+  int host_xrt;     /* Use the native XRT API in the host */
+  int host_session; /* Generate the persistent device session library */
+  int host_threads; /* Number of threads of the host preparation */
+  int qdma_stream;  /* Stream the selected arrays through QDMA */
+  int host_simd_unpack; /* Unpack the outputs with SIMD copies */
+  int host_bench;   /* Timed kernel repetitions in OpenCL host benchmark */
+  int host_bench_warmup; /* Warmup runs in OpenCL host benchmark */
+  int cpu_sim;      /* Simulate the modules with threads on the CPU */
+  int perf_counters; /* Insert performance counters into the modules */
+  int fifo_trace;   /* Trace the occupancy of the FIFOs */
+  FILE *session_c;  /* Persistent device session of the host */
+  FILE *session_h;
+  FILE *tb_c;       /* Testbench replaying the cached golden data */
+  int tb_cache;     /* Cache the golden data of the HLS host */
+  int tb_sample;    /* Stride of the outputs checked by the testbench */
+  int tile_scheduler; /* Generate the tile scheduler of the host */
+  FILE *aie_c;      /* AI Engine kernels of the PEs */
+  int aie;          /* Map the PEs on the AI Engines */
+  int split_buf_lifted; /* The split buffer is declared by the module */
+  int io_prefetch;  /* Depth of the prefetch FIFOs of the L3 I/O modules */
+  int cache_sets;   /* Number of sets of the caches of the irregular arrays */
+  int cache_ways;   /* Number of ways of the caches of the irregular arrays */
+  int prefetch;     /* Printing the DRAM (1) or body (2) prefetch process */
   char *output_dir; /* Output directory */
   isl_ctx *ctx;
 };
@@ -1024,12 +1147,16 @@ isl_bool is_dep_uniform_at_node(__isl_keep isl_schedule_node *node, void *user);
 isl_bool is_dep_uniform(__isl_keep isl_basic_map *bmap, void *user);
 isl_bool is_dep_uniform_wrap(__isl_keep isl_map *map, void *user);
 isl_bool uniform_dep_check(__isl_keep isl_schedule *schedule, struct ppcg_scop *scop);
+__isl_give isl_schedule *skew_stencil_schedule(__isl_take isl_schedule *schedule,
+                                               struct ppcg_scop *scop);
 __isl_give isl_vec *get_dep_dis_at_schedule(__isl_keep isl_basic_map *dep,
                                             __isl_keep isl_schedule *schedule);
 __isl_give isl_vec *get_dep_dis_at_node(__isl_keep isl_basic_map *dep,
                                         __isl_keep isl_schedule_node *band);
 __isl_give isl_schedule *loop_interchange_at_node(
     __isl_take isl_schedule_node *node, isl_size level1, isl_size level2);
+__isl_give isl_schedule *loop_skew_at_node(
+    __isl_take isl_schedule_node *node, isl_size level, isl_size src, int factor);
 __isl_give isl_schedule_node *get_outermost_permutable_node(
     __isl_keep isl_schedule *schedule);
 __isl_give isl_schedule_node *get_innermost_permutable_node(
@@ -1045,6 +1172,8 @@ __isl_give isl_schedule_node *clear_pe_opt_prop(
 __isl_give isl_schedule_node *restore_node_band_prop(
     __isl_take isl_schedule_node *node,
     __isl_take struct autosa_node_band_prop *prop);
+__isl_give isl_schedule_node *autosa_node_band_permute(
+    __isl_take isl_schedule_node *node, int *order);
 __isl_give isl_schedule_node *autosa_node_interchange(
     __isl_take isl_schedule_node *node);
 __isl_give isl_schedule_node *autosa_node_interchange_up(
@@ -1054,12 +1183,19 @@ isl_bool all_parallel_node(__isl_keep isl_schedule_node *node, void *user);
 isl_bool isl_schedule_node_is_io_mark(__isl_keep isl_schedule_node *node, int io_level);
 int is_node_under_simd(__isl_keep isl_schedule_node *node);
 int is_node_under_latency(__isl_keep isl_schedule_node *node);
+__isl_give isl_schedule_node *autosa_tree_move_up_to_reuse_level(
+    struct autosa_kernel *kernel, __isl_take isl_schedule_node *node,
+    struct autosa_stmt_access *ref);
 int *extract_band_upper_bounds(struct autosa_kernel *kernel,
                                __isl_keep isl_schedule_node *node);
+__isl_give isl_schedule *autosa_schedule_reset_domain(
+    __isl_keep isl_schedule *schedule, __isl_take isl_union_set *domain);
 __isl_give isl_union_set *set_schedule_eq(
     __isl_keep isl_schedule_node *node, __isl_keep isl_id_list *names);
 isl_bool is_flow_dep_carried_by_array_part_loops(__isl_keep isl_schedule *schedule,
                                                  struct autosa_array_ref_group *group, struct autosa_kernel *kernel);
+int flow_dep_array_part_distance(__isl_keep isl_schedule *schedule,
+                                 struct autosa_array_ref_group *group, struct autosa_kernel *kernel);
 
 /* Schedule */
 __isl_give isl_schedule *compute_schedule(struct autosa_gen *gen);
@@ -1074,6 +1210,7 @@ struct autosa_kernel *autosa_kernel_alloc(isl_ctx *ctx, struct ppcg_scop *scop);
 /* AutoSA access */
 isl_bool access_is_stride_zero(__isl_keep isl_map *access, int pos);
 isl_bool access_is_stride_one(__isl_keep isl_map *access, int pos);
+isl_bool access_is_invariant(__isl_keep isl_map *access, int pos);
 void *autosa_acc_free(struct autosa_acc *acc);
 
 /* AutoSA dep */
@@ -1108,6 +1245,7 @@ void *autosa_prog_free(struct autosa_prog *prog);
 /* AutoSA hw module */
 struct autosa_hw_module *autosa_hw_module_alloc(struct autosa_gen *gen);
 void *autosa_hw_module_free(struct autosa_hw_module *module);
+int autosa_hw_module_is_split(struct autosa_hw_module *module);
 struct autosa_hw_top_module *autosa_hw_top_module_alloc();
 void *autosa_hw_top_module_free(struct autosa_hw_top_module *module);
 struct autosa_pe_dummy_module *autosa_pe_dummy_module_alloc();
@@ -1117,16 +1255,26 @@ void *autosa_drain_merge_func_free(struct autosa_drain_merge_func *func);
 
 /* AutoSA AST node */
 struct autosa_ast_node_userinfo *alloc_ast_node_userinfo();
+long autosa_ast_node_for_n_iter(__isl_keep isl_ast_node *node);
+__isl_give isl_ast_node *autosa_ast_node_extract_flatten_nest(
+    __isl_keep isl_ast_node *node, std::vector<isl_ast_node *> &loops,
+    std::vector<long> &n_iters);
+__isl_give isl_ast_expr *autosa_ast_expr_strength_reduce(
+    __isl_take isl_ast_expr *expr);
 
 /* AutoSA PE opt */
 __isl_give isl_set *extract_sa_sizes(__isl_keep isl_union_map *sizes,
                                      const char *type, int id);
 int *read_hbm_tile_sizes(struct autosa_kernel *kernel, int tile_len, char *name);
 int *read_default_hbm_tile_sizes(struct autosa_kernel *sa, int tile_len);
+int read_io_dir_size(struct autosa_kernel *sa, char *name);
+int read_credit_size(struct autosa_kernel *sa, char *name);
 int *read_array_part_tile_sizes(struct autosa_kernel *kernel, int tile_len);
+int *read_array_part_order(struct autosa_kernel *kernel, int tile_len);
 int *read_default_array_part_tile_sizes(struct autosa_kernel *kernel, int tile_len);
 int *read_latency_tile_sizes(struct autosa_kernel *kernel, int tile_len);
-int *read_default_latency_tile_sizes(struct autosa_kernel *kernel, int tile_len);
+int *read_default_latency_tile_sizes(struct autosa_kernel *kernel, int tile_len,
+                                     int *ubs);
 int *read_simd_tile_sizes(struct autosa_kernel *kernel, int tile_len);
 int *read_default_simd_tile_sizes(struct autosa_kernel *kernel, int tile_len);
 int read_space_time_kernel_id(__isl_keep isl_union_map *sizes);
@@ -1139,4 +1287,40 @@ isl_stat sa_extract_array_info(struct autosa_kernel *kernel);
 int extract_memory_type(struct autosa_hw_module *module,
                         struct autosa_kernel_var *var, int uram);
 isl_stat sa_extract_design_info(struct autosa_gen *gen);
+isl_stat sa_estimate_latency(struct autosa_gen *gen, cJSON *calibration,
+                             long *latency, cJSON **modules_info);
+void extract_op_resource(const char *type, struct autosa_resource *res);
+char *autosa_hls_data_type(struct ppcg_options *options, const char *type);
+int autosa_hls_data_type_width(const char *hls_type);
+int autosa_sparse_block_size(struct ppcg_options *options, const char *name);
+int autosa_qdma_stream_selected(struct ppcg_options *options, const char *name);
+__isl_give pet_expr *autosa_stmt_extract_narrow_mac(struct autosa_prog *prog,
+                                                    struct pet_stmt *stmt, __isl_give pet_expr **acc);
+__isl_give pet_expr *autosa_stmt_extract_mac(struct autosa_prog *prog,
+                                             struct pet_stmt *stmt, __isl_give pet_expr **acc);
+isl_bool autosa_stmt_is_reduction(struct pet_stmt *stmt,
+                                  __isl_give isl_id **write_ref, __isl_give isl_id **read_ref);
+isl_bool autosa_stmt_is_sum(struct pet_stmt *stmt,
+                            __isl_give isl_id **write_ref, __isl_give isl_id **read_ref);
+isl_bool autosa_stmt_is_zero_init(struct pet_stmt *stmt);
+int autosa_op_latency(struct ppcg_options *options, const char *type,
+                      enum pet_op_type op);
+int autosa_stmt_update_latency(struct autosa_prog *prog, struct pet_stmt *stmt);
+int autosa_stmt_latency(struct autosa_prog *prog, struct pet_stmt *stmt);
+int autosa_kernel_update_latency(struct autosa_kernel *kernel);
+double autosa_kernel_count_ops(struct autosa_kernel *kernel);
+int autosa_kernel_dsp_pack(struct autosa_kernel *kernel);
+int autosa_fifo_depth(struct autosa_hw_module *module, int n_lane);
+isl_stat sa_bind_memory(struct autosa_gen *gen, cJSON *hw_info);
+isl_stat sa_estimate_resource(struct autosa_gen *gen, cJSON *hw_info,
+                              cJSON *calibration, struct autosa_resource *total);
+void sa_select_compute_units(struct autosa_gen *gen, cJSON *hw_info,
+                             struct autosa_resource *total);
+isl_stat sa_estimate_roofline(struct autosa_gen *gen, cJSON *hw_info,
+                              long latency);
+isl_stat sa_estimate_traffic(struct autosa_gen *gen);
+void sa_estimate_host_transfer(struct autosa_kernel *kernel, cJSON *hw_info,
+                               double freq, double *in, double *out);
+double sa_end_to_end_latency(struct ppcg_options *options, double latency,
+                             double in, double out);
 #endif
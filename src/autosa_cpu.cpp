@@ -0,0 +1,26 @@
+#include <isl/ctx.h>
+
+#include "autosa_cpu.h"
+#include "autosa_xilinx_hls_c.h"
+
+/* Generate a multithreaded CPU simulation of the systolic array.
+ *
+ * The simulation is built from the same hardware modules as the Xilinx HLS C
+ * backend, together with the HLS testbench host. The only differences are in
+ * the kernel header, which includes "autosa_cpu_stream.h" instead of
+ * <hls_stream.h>, and in the top kernel, where autosa_scripts/codegen.py
+ * launches each module call in its own thread.
+ * The threads block on bounded FIFOs, which is why a module is bound to a
+ * thread instead of being a task of a work-stealing scheduler.
+ */
+int generate_autosa_cpu(isl_ctx *ctx, struct ppcg_options *options,
+                        const char *input)
+{
+  if (!options->autosa->hls)
+  {
+    printf("[AutoSA] The CPU simulation uses the HLS host. Option --AutoSA-hls is enabled.\n");
+    options->autosa->hls = 1;
+  }
+
+  return generate_autosa_xilinx_hls_c(ctx, options, input);
+}
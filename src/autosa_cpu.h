@@ -1,13 +1,20 @@
 #ifndef _AUTOSA_CPU_H
 #define _AUTOSA_CPU_H
 
-#include <isl/ctx.h>
-
+#include <pet.h>
+#include "ppcg_options.h"
 #include "ppcg.h"
 
-struct ppcg_options;
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	int generate_autosa_cpu(isl_ctx *ctx, struct ppcg_options *options,
+													const char *input);
 
-int generate_autosa_cpu(isl_ctx *ctx, struct ppcg_options *options,
-												const char *input);
+#ifdef __cplusplus
+}
+#endif
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,567 @@
+/* Defines the CUDA backend of AutoSA.
+ *
+ * The CUDA kernel is generated from the same space-time mapping and array
+ * partitioning as the systolic arrays on FPGAs: the array partitions are
+ * executed by the thread blocks and the PEs by the threads of a block
+ * (see sa_cuda_kernel_generate_code). The threads access the arrays in
+ * the global memory, i.e., the I/O modules of the systolic array are not
+ * generated on the GPU.
+ *
+ * The host code allocates the device arrays, copies the arrays to and from
+ * the device and launches the kernel on the grid of the array partitions.
+ */
+
+#include <limits.h>
+#include <string.h>
+
+#include <isl/ctx.h>
+#include <isl/ast.h>
+
+#include "autosa_cuda.h"
+#include "autosa_common.h"
+#include "autosa_print.h"
+#include "autosa_trans.h"
+#include "autosa_codegen.h"
+#include "print.h"
+
+struct cuda_info
+{
+  FILE *host_c;   /* Host code. */
+  FILE *kernel_c; /* Definition of the kernel. */
+  FILE *kernel_h; /* Declaration of the kernel. */
+  char *output_dir;
+  isl_ctx *ctx;
+};
+
+static const char *cuda_block_ids[] = {"blockIdx.x", "blockIdx.y"};
+static const char *cuda_thread_ids[] = {"threadIdx.x", "threadIdx.y", "threadIdx.z"};
+
+/* Print the macros checking the return values of the CUDA runtime. */
+static void print_cuda_macros(FILE *fp)
+{
+  fprintf(fp, "#define cudaCheckReturn(ret) \\\n");
+  fprintf(fp, "  do { \\\n");
+  fprintf(fp, "    cudaError_t cudaCheckReturn_e = (ret); \\\n");
+  fprintf(fp, "    if (cudaCheckReturn_e != cudaSuccess) { \\\n");
+  fprintf(fp, "      fprintf(stderr, \"CUDA error: %%s\\n\", cudaGetErrorString(cudaCheckReturn_e)); \\\n");
+  fprintf(fp, "      fflush(stderr); \\\n");
+  fprintf(fp, "    } \\\n");
+  fprintf(fp, "    assert(cudaCheckReturn_e == cudaSuccess); \\\n");
+  fprintf(fp, "  } while(0)\n");
+  fprintf(fp, "#define cudaCheckKernel() \\\n");
+  fprintf(fp, "  do { \\\n");
+  fprintf(fp, "    cudaCheckReturn(cudaGetLastError()); \\\n");
+  fprintf(fp, "  } while(0)\n\n");
+}
+
+/* Open the host and kernel files "<output_dir>/src/<input>_host.cu",
+ * "<input>_kernel.cu" and "<input>_kernel.h".
+ */
+static void cuda_open_files(struct cuda_info *info, const char *input)
+{
+  char name[PATH_MAX];
+  char dir[PATH_MAX];
+  int len;
+
+  len = ppcg_extract_base_name(name, input);
+
+  strcpy(name + len, "_host.cu");
+  sprintf(dir, "%s/src/%s", info->output_dir, name);
+  info->host_c = fopen(dir, "w");
+  if (!info->host_c)
+  {
+    printf("[AutoSA] Error: Can't open the file: %s\n", dir);
+    exit(1);
+  }
+
+  strcpy(name + len, "_kernel.cu");
+  sprintf(dir, "%s/src/%s", info->output_dir, name);
+  info->kernel_c = fopen(dir, "w");
+  if (!info->kernel_c)
+  {
+    printf("[AutoSA] Error: Can't open the file: %s\n", dir);
+    exit(1);
+  }
+
+  strcpy(name + len, "_kernel.h");
+  sprintf(dir, "%s/src/%s", info->output_dir, name);
+  info->kernel_h = fopen(dir, "w");
+  if (!info->kernel_h)
+  {
+    printf("[AutoSA] Error: Can't open the file: %s\n", dir);
+    exit(1);
+  }
+
+  fprintf(info->host_c, "#include <assert.h>\n");
+  fprintf(info->host_c, "#include <stdio.h>\n");
+  fprintf(info->host_c, "#include \"%s\"\n", name);
+  fprintf(info->kernel_c, "#include \"%s\"\n", name);
+  fprintf(info->kernel_h, "#include <cuda_runtime.h>\n\n");
+  print_cuda_macros(info->kernel_h);
+}
+
+static void cuda_close_files(struct cuda_info *info)
+{
+  fclose(info->kernel_c);
+  fclose(info->kernel_h);
+  fclose(info->host_c);
+}
+
+/* Print the declaration of the device array of "array", i.e.,
+ * a pointer to the rows of the array if it is not linearized.
+ */
+static __isl_give isl_printer *declare_device_array_cuda(
+    __isl_take isl_printer *p, struct autosa_array_info *array)
+{
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, array->type);
+  p = isl_printer_print_str(p, " ");
+  if (!array->linearize && array->n_index > 1)
+    p = isl_printer_print_str(p, "(");
+  p = isl_printer_print_str(p, "*dev_");
+  p = isl_printer_print_str(p, array->name);
+  if (!array->linearize && array->n_index > 1)
+  {
+    p = isl_printer_print_str(p, ")");
+    for (int i = 1; i < array->n_index; i++)
+    {
+      isl_ast_expr *bound;
+
+      bound = isl_ast_expr_get_op_arg(array->bound_expr, 1 + i);
+      p = isl_printer_print_str(p, "[");
+      p = isl_printer_print_ast_expr(p, bound);
+      p = isl_printer_print_str(p, "]");
+      isl_ast_expr_free(bound);
+    }
+  }
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
+
+  return p;
+}
+
+/* Declare and allocate the device arrays. */
+static __isl_give isl_printer *init_device_cuda(__isl_take isl_printer *p,
+                                                struct autosa_prog *prog)
+{
+  p = autosa_print_local_declarations(p, prog);
+  for (int i = 0; i < prog->n_array; i++)
+  {
+    struct autosa_array_info *array = &prog->array[i];
+    if (!autosa_array_requires_device_allocation(array))
+      continue;
+    p = declare_device_array_cuda(p, array);
+  }
+  p = isl_printer_end_line(p);
+  for (int i = 0; i < prog->n_array; i++)
+  {
+    struct autosa_array_info *array = &prog->array[i];
+    if (!autosa_array_requires_device_allocation(array))
+      continue;
+    p = ppcg_ast_expr_print_macros(array->bound_expr, p);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "cudaCheckReturn(cudaMalloc((void **) &dev_");
+    p = isl_printer_print_str(p, array->name);
+    p = isl_printer_print_str(p, ", ");
+    p = autosa_array_info_print_size(p, array);
+    p = isl_printer_print_str(p, "));");
+    p = isl_printer_end_line(p);
+  }
+  p = isl_printer_end_line(p);
+
+  return p;
+}
+
+/* Free the device arrays. */
+static __isl_give isl_printer *clear_device_cuda(__isl_take isl_printer *p,
+                                                 struct autosa_prog *prog)
+{
+  for (int i = 0; i < prog->n_array; i++)
+  {
+    struct autosa_array_info *array = &prog->array[i];
+    if (!autosa_array_requires_device_allocation(array))
+      continue;
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "cudaCheckReturn(cudaFree(dev_");
+    p = isl_printer_print_str(p, array->name);
+    p = isl_printer_print_str(p, "));");
+    p = isl_printer_end_line(p);
+  }
+
+  return p;
+}
+
+/* Copy "array" to the device if "to_device" is set, and back to the host
+ * otherwise.
+ */
+static __isl_give isl_printer *copy_array_cuda(__isl_take isl_printer *p,
+                                               struct autosa_array_info *array, int to_device)
+{
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "cudaCheckReturn(cudaMemcpy(");
+  if (to_device)
+  {
+    p = isl_printer_print_str(p, "dev_");
+    p = isl_printer_print_str(p, array->name);
+    p = isl_printer_print_str(p, ", ");
+    if (autosa_array_is_scalar(array))
+      p = isl_printer_print_str(p, "&");
+    p = isl_printer_print_str(p, array->name);
+  }
+  else
+  {
+    if (autosa_array_is_scalar(array))
+      p = isl_printer_print_str(p, "&");
+    p = isl_printer_print_str(p, array->name);
+    p = isl_printer_print_str(p, ", dev_");
+    p = isl_printer_print_str(p, array->name);
+  }
+  p = isl_printer_print_str(p, ", ");
+  p = autosa_array_info_print_size(p, array);
+  if (to_device)
+    p = isl_printer_print_str(p, ", cudaMemcpyHostToDevice));");
+  else
+    p = isl_printer_print_str(p, ", cudaMemcpyDeviceToHost));");
+  p = isl_printer_end_line(p);
+
+  return p;
+}
+
+/* Print the host statement "node" that is not a kernel launch. */
+static __isl_give isl_printer *print_device_node_cuda(__isl_take isl_printer *p,
+                                                      __isl_keep isl_ast_node *node, struct autosa_prog *prog)
+{
+  isl_ast_expr *expr, *arg;
+  isl_id *id;
+  const char *name;
+  struct autosa_array_info *array = NULL;
+
+  expr = isl_ast_node_user_get_expr(node);
+  arg = isl_ast_expr_get_op_arg(expr, 0);
+  id = isl_ast_expr_get_id(arg);
+  name = isl_id_get_name(id);
+  if (!prefixcmp(name, "to_device_") || !prefixcmp(name, "from_device_"))
+    array = (struct autosa_array_info *)isl_id_get_user(id);
+  isl_id_free(id);
+  isl_ast_expr_free(arg);
+  isl_ast_expr_free(expr);
+
+  if (!name)
+    return isl_printer_free(p);
+  if (!strcmp(name, "init_device"))
+    return init_device_cuda(p, prog);
+  if (!strcmp(name, "clear_device"))
+    return clear_device_cuda(p, prog);
+  if (!array)
+    return p;
+
+  return copy_array_cuda(p, array, !prefixcmp(name, "to_device_"));
+}
+
+/* Print the arguments of the kernel declaration if "types" is set,
+ * or of the kernel launch otherwise:
+ * - the arrays accessed by the kernel
+ * - the parameters
+ */
+static __isl_give isl_printer *print_kernel_arguments_cuda(
+    __isl_take isl_printer *p, struct autosa_prog *prog,
+    struct autosa_kernel *kernel, int types)
+{
+  int first = 1;
+  unsigned nparam;
+  isl_space *space;
+
+  for (int i = 0; i < kernel->n_array; ++i)
+  {
+    struct autosa_array_info *array = kernel->array[i].array;
+    int required;
+
+    required = autosa_kernel_requires_array_argument(kernel, i);
+    if (required < 0)
+      return isl_printer_free(p);
+    if (!required)
+      continue;
+
+    if (!first)
+      p = isl_printer_print_str(p, ", ");
+    if (types)
+      p = autosa_array_info_print_declaration_argument(p, array, 1, NULL, -1);
+    else
+    {
+      if (!autosa_array_is_read_only_scalar(array))
+        p = isl_printer_print_str(p, "dev_");
+      p = isl_printer_print_str(p, array->name);
+    }
+    first = 0;
+  }
+
+  space = isl_union_set_get_space(kernel->arrays);
+  nparam = isl_space_dim(space, isl_dim_param);
+  for (int i = 0; i < nparam; ++i)
+  {
+    const char *name;
+
+    name = isl_space_get_dim_name(space, isl_dim_param, i);
+    if (!first)
+      p = isl_printer_print_str(p, ", ");
+    if (types)
+      p = isl_printer_print_str(p, "int ");
+    p = isl_printer_print_str(p, name);
+    first = 0;
+  }
+  isl_space_free(space);
+
+  return p;
+}
+
+/* Print the header of the CUDA kernel "kernel". */
+static __isl_give isl_printer *print_kernel_header_cuda(
+    __isl_take isl_printer *p, struct autosa_prog *prog,
+    struct autosa_kernel *kernel)
+{
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "__global__ void kernel");
+  p = isl_printer_print_int(p, kernel->id);
+  p = isl_printer_print_str(p, "(");
+  p = print_kernel_arguments_cuda(p, prog, kernel, 1);
+  p = isl_printer_print_str(p, ")");
+
+  return p;
+}
+
+/* Print the launch of the kernel "kernel" on its grid of thread blocks.
+ * The grid sizes are the extents of the array partitioning loops mapped
+ * to the blocks, and the block sizes are the sizes of the PE array.
+ */
+static __isl_give isl_printer *print_kernel_launch_cuda(
+    __isl_take isl_printer *p, struct autosa_prog *prog,
+    struct autosa_kernel *kernel)
+{
+  p = ppcg_start_block(p);
+
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "dim3 k");
+  p = isl_printer_print_int(p, kernel->id);
+  p = isl_printer_print_str(p, "_dimBlock(");
+  for (int i = 0; i < kernel->n_block; i++)
+  {
+    if (i > 0)
+      p = isl_printer_print_str(p, ", ");
+    p = isl_printer_print_int(p, kernel->block_dim[i]);
+  }
+  p = isl_printer_print_str(p, ");");
+  p = isl_printer_end_line(p);
+
+  if (kernel->grid_size_expr)
+    p = ppcg_ast_expr_print_macros(kernel->grid_size_expr, p);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "dim3 k");
+  p = isl_printer_print_int(p, kernel->id);
+  p = isl_printer_print_str(p, "_dimGrid(");
+  if (!kernel->grid_size_expr)
+    p = isl_printer_print_str(p, "1");
+  for (int i = 0; kernel->grid_size_expr && i < kernel->n_grid; i++)
+  {
+    isl_ast_expr *size;
+
+    size = isl_ast_expr_get_op_arg(kernel->grid_size_expr, 1 + i);
+    if (i > 0)
+      p = isl_printer_print_str(p, ", ");
+    p = isl_printer_print_ast_expr(p, size);
+    isl_ast_expr_free(size);
+  }
+  p = isl_printer_print_str(p, ");");
+  p = isl_printer_end_line(p);
+
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "kernel");
+  p = isl_printer_print_int(p, kernel->id);
+  p = isl_printer_print_str(p, " <<<k");
+  p = isl_printer_print_int(p, kernel->id);
+  p = isl_printer_print_str(p, "_dimGrid, k");
+  p = isl_printer_print_int(p, kernel->id);
+  p = isl_printer_print_str(p, "_dimBlock>>> (");
+  p = print_kernel_arguments_cuda(p, prog, kernel, 0);
+  p = isl_printer_print_str(p, ");");
+  p = isl_printer_end_line(p);
+  p = print_str_new_line(p, "cudaCheckKernel();");
+
+  p = ppcg_end_block(p);
+
+  return p;
+}
+
+/* Print the user statement "node" of the CUDA kernel, i.e., a statement of
+ * the program or the synchronization of the threads of a block.
+ */
+static __isl_give isl_printer *print_kernel_user_cuda(__isl_take isl_printer *p,
+                                                      __isl_take isl_ast_print_options *print_options,
+                                                      __isl_keep isl_ast_node *node, void *user)
+{
+  isl_id *id;
+  struct autosa_kernel_stmt *stmt;
+
+  isl_ast_print_options_free(print_options);
+
+  id = isl_ast_node_get_annotation(node);
+  if (!id)
+    return print_str_new_line(p, "__syncthreads();");
+
+  stmt = (struct autosa_kernel_stmt *)isl_id_get_user(id);
+  isl_id_free(id);
+
+  return autosa_kernel_print_domain(p, stmt);
+}
+
+/* Print the declaration of the CUDA kernel "kernel" to "cuda->kernel_h"
+ * and its definition to "cuda->kernel_c".
+ * The block and thread identifiers mapped by sa_cuda_kernel_generate_code
+ * are bound to the indices of the block and of the thread.
+ */
+static void print_kernel_cuda(struct autosa_prog *prog,
+                              struct autosa_kernel *kernel, struct cuda_info *cuda)
+{
+  isl_printer *p;
+  isl_ast_print_options *print_options;
+
+  p = isl_printer_to_file(cuda->ctx, cuda->kernel_h);
+  p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+  p = print_kernel_header_cuda(p, prog, kernel);
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
+  isl_printer_free(p);
+
+  p = isl_printer_to_file(cuda->ctx, cuda->kernel_c);
+  p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+  p = print_kernel_header_cuda(p, prog, kernel);
+  p = isl_printer_end_line(p);
+  p = ppcg_start_block(p);
+  for (int i = 0; i < isl_id_list_n_id(kernel->block_ids); i++)
+  {
+    isl_id *id = isl_id_list_get_id(kernel->block_ids, i);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "int ");
+    p = isl_printer_print_str(p, isl_id_get_name(id));
+    p = isl_printer_print_str(p, " = ");
+    p = isl_printer_print_str(p, cuda_block_ids[i]);
+    p = isl_printer_print_str(p, ";");
+    p = isl_printer_end_line(p);
+    isl_id_free(id);
+  }
+  for (int i = 0; i < isl_id_list_n_id(kernel->thread_ids); i++)
+  {
+    isl_id *id = isl_id_list_get_id(kernel->thread_ids, i);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "int ");
+    p = isl_printer_print_str(p, isl_id_get_name(id));
+    p = isl_printer_print_str(p, " = ");
+    p = isl_printer_print_str(p, cuda_thread_ids[i]);
+    p = isl_printer_print_str(p, ";");
+    p = isl_printer_end_line(p);
+    isl_id_free(id);
+  }
+  p = isl_printer_end_line(p);
+
+  print_options = isl_ast_print_options_alloc(cuda->ctx);
+  print_options = isl_ast_print_options_set_print_user(print_options,
+                                                       &print_kernel_user_cuda, NULL);
+  p = autosa_print_macros(p, kernel->cuda_tree);
+  p = isl_ast_node_print(kernel->cuda_tree, p, print_options);
+  p = ppcg_end_block(p);
+  p = isl_printer_end_line(p);
+  isl_printer_free(p);
+}
+
+struct print_host_user_data_cuda
+{
+  struct cuda_info *cuda;
+  struct autosa_prog *prog;
+};
+
+/* Print the host statement "node". The kernel launches are annotated
+ * with the kernel objects, and the statements executed on the host
+ * with the kernel statements.
+ */
+static __isl_give isl_printer *print_host_user_cuda(__isl_take isl_printer *p,
+                                                    __isl_take isl_ast_print_options *print_options,
+                                                    __isl_keep isl_ast_node *node, void *user)
+{
+  isl_id *id;
+  int is_user;
+  struct autosa_kernel *kernel;
+  struct autosa_kernel_stmt *stmt;
+  struct print_host_user_data_cuda *data;
+
+  isl_ast_print_options_free(print_options);
+
+  data = (struct print_host_user_data_cuda *)user;
+
+  id = isl_ast_node_get_annotation(node);
+  if (!id)
+    return print_device_node_cuda(p, node, data->prog);
+
+  is_user = !strcmp(isl_id_get_name(id), "user");
+  kernel = is_user ? NULL : (struct autosa_kernel *)isl_id_get_user(id);
+  stmt = is_user ? (struct autosa_kernel_stmt *)isl_id_get_user(id) : NULL;
+  isl_id_free(id);
+
+  if (is_user)
+    return autosa_kernel_print_domain(p, stmt);
+  if (!kernel->cuda_tree)
+    return isl_printer_free(p);
+
+  print_kernel_cuda(data->prog, kernel, data->cuda);
+
+  return print_kernel_launch_cuda(p, data->prog, kernel);
+}
+
+static __isl_give isl_printer *print_cuda(
+    __isl_take isl_printer *p,
+    struct autosa_prog *prog, __isl_keep isl_ast_node *tree,
+    struct autosa_hw_module **modules, int n_modules,
+    struct autosa_hw_top_module *top_module,
+    struct autosa_drain_merge_func **drain_merge_funcs, int n_drain_merge_funcs,
+    struct autosa_types *types, void *user)
+{
+  struct cuda_info *cuda = (struct cuda_info *)user;
+  struct print_host_user_data_cuda data = {cuda, prog};
+  isl_ast_print_options *print_options;
+  isl_printer *kernel;
+
+  kernel = isl_printer_to_file(isl_printer_get_ctx(p), cuda->kernel_h);
+  kernel = isl_printer_set_output_format(kernel, ISL_FORMAT_C);
+  kernel = autosa_print_types(kernel, types, prog);
+  isl_printer_free(kernel);
+
+  if (!kernel)
+    return isl_printer_free(p);
+
+  print_options = isl_ast_print_options_alloc(cuda->ctx);
+  print_options = isl_ast_print_options_set_print_user(print_options,
+                                                       &print_host_user_cuda, &data);
+  p = autosa_print_macros(p, tree);
+  p = isl_ast_node_print(tree, p, print_options);
+
+  return p;
+}
+
+/* Generate the CUDA code of the systolic array.
+ * The tensor cores are not targeted, the PEs execute the statements
+ * of the program with the scalar CUDA cores.
+ */
+int generate_autosa_cuda(isl_ctx *ctx, struct ppcg_options *options,
+                         const char *input)
+{
+  struct cuda_info cuda;
+  int r;
+
+  cuda.ctx = ctx;
+  cuda.output_dir = options->autosa->output_dir;
+  cuda_open_files(&cuda, input);
+
+  r = generate_sa(ctx, input, cuda.host_c, options, &print_cuda, &cuda);
+
+  cuda_close_files(&cuda);
+
+  return r;
+}
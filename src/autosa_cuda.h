@@ -0,0 +1,20 @@
+#ifndef _AUTOSA_CUDA_H
+#define _AUTOSA_CUDA_H
+
+#include <pet.h>
+#include "ppcg_options.h"
+#include "ppcg.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	int generate_autosa_cuda(isl_ctx *ctx, struct ppcg_options *options,
+													 const char *input);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
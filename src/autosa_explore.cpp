@@ -0,0 +1,2421 @@
+/* Defines functions for the in-process design space exploration in AutoSA.
+ *
+ * In the default tuning flow, whenever the tiling factors of a PE
+ * optimization stage are missing, AutoSA dumps out the tuning information
+ * to "tuning.json" and exits, and the whole front end (pet parsing,
+ * scheduling, dependence analysis) has to be run again for every design
+ * point. In the exploration mode, the parsed scop and the dependences stay
+ * resident and all the design points are enumerated in a single process.
+ */
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <random>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <sys/wait.h>
+
+#include "autosa_explore.h"
+#include "autosa_trans.h"
+#include "autosa_utils.h"
+
+/* A (partial) design point read from the exploration journal,
+ * see explore_journal_open.
+ * If "complete" is set, the design points recorded for it are
+ * data->points[first] to data->points[last - 1].
+ * Otherwise, "children" contains the design points expanded from it
+ * at the stage "stage" before pruning, and "partial" the information
+ * of the partially optimized kernel used by explore_prune_point.
+ */
+struct autosa_explore_entry
+{
+  bool complete;
+  int first;
+  int last;
+  std::string stage;
+  struct autosa_explore_point partial;
+  std::vector<std::string> children;
+};
+
+/* Internal data structure for the design space exploration.
+ * "sa_candidates" contains the "num_sa" systolic array candidates generated
+ * by the space-time transformation from "schedule".
+ * "sa" is the expanded kernel of the candidate "sa_id", see explore_candidate.
+ * "pe_opt_en" contains the enable signals of array partitioning,
+ * L2 array partitioning, latency hiding and SIMD vectorization.
+ * "points" contains all the design points evaluated so far.
+ * "n_eval" is the number of (partial) design points evaluated.
+ * "hw_info" contains the hardware information used by the cost model.
+ * "lane" is the resource of a single PE lane.
+ * "dsp_limit", "bram_limit" and "uram_limit" are the resources available
+ * under the utilization target, or negative if unknown.
+ * "n_pruned" is the number of design points pruned without evaluation.
+ * "journal" is the file descriptor of the exploration journal, or -1,
+ * and "known" contains the design points read from it.
+ * "n_resumed" is the number of design points replayed from the journal.
+ */
+struct autosa_explore_data
+{
+  struct autosa_gen *gen;
+  struct autosa_sa_candidate *sa_candidates;
+  isl_size num_sa;
+  isl_schedule *schedule;
+  struct autosa_kernel *sa;
+  int sa_id;
+  bool pe_opt_en[4];
+  char *pe_opt_mode[4];
+  std::vector<struct autosa_explore_point> points;
+  int n_eval;
+  cJSON *hw_info;
+  struct autosa_resource lane;
+  double dsp_limit;
+  double bram_limit;
+  double uram_limit;
+  int n_pruned;
+  int journal;
+  std::map<std::pair<int, std::string>, struct autosa_explore_entry> known;
+  int n_resumed;
+};
+
+/* Return the kernel of the systolic array candidate "kernel_id".
+ * Only the last requested candidate is kept expanded, which is
+ * the candidate of all the design points visited in a row
+ * by a depth-first exploration.
+ */
+static struct autosa_kernel *explore_candidate(struct autosa_explore_data *data,
+                                               int kernel_id)
+{
+  if (data->sa_id != kernel_id)
+  {
+    autosa_kernel_free(data->sa);
+    data->sa = sa_candidate_expand(data->schedule, data->gen->prog->scop,
+                                   &data->sa_candidates[kernel_id]);
+    if (data->sa)
+      data->sa->prog = data->gen->prog;
+    data->sa_id = kernel_id;
+  }
+
+  return data->sa;
+}
+
+/* Return the enable signal of the optimization stage "stage" in the
+ * tuning configuration "config".
+ */
+static bool explore_stage_enabled(cJSON *config, const char *stage)
+{
+  cJSON *stage_json, *en_json;
+
+  stage_json = cJSON_GetObjectItemCaseSensitive(config, stage);
+  en_json = cJSON_GetObjectItemCaseSensitive(stage_json, "enable");
+  if (!en_json)
+    return false;
+
+  return en_json->valueint;
+}
+
+/* Set the optimization stage "stage" in the tuning configuration "config"
+ * to the manual mode, so that the tiling factors of the selected design
+ * are read from the "--sa-sizes" option.
+ */
+static void explore_set_manual_mode(cJSON *config, const char *stage)
+{
+  cJSON *stage_json;
+
+  stage_json = cJSON_GetObjectItemCaseSensitive(config, stage);
+  if (!stage_json)
+    return;
+  cJSON_ReplaceItemInObjectCaseSensitive(stage_json, "mode",
+                                         cJSON_CreateString("manual"));
+}
+
+/* Evaluate the design point "sizes" of the systolic array candidate
+ * "kernel_id" by applying the PE optimization with the tiling factors
+ * specified in "sizes".
+ * Return the optimized kernel if all the tiling factors are specified.
+ * Otherwise, return NULL and store the tuning information of the stage
+ * with missing tiling factors in "tuning", and the number of PEs and
+ * the latency hiding length of the partially optimized kernel in "partial".
+ */
+static struct autosa_kernel *explore_eval_point(
+    struct autosa_explore_data *data, int kernel_id, const std::string &sizes,
+    cJSON **tuning, struct autosa_explore_point *partial)
+{
+  struct autosa_gen *gen = data->gen;
+  struct autosa_kernel *kernel;
+  std::string sa_sizes = "{" + sizes + "}";
+  char *user_sizes;
+  isl_stat r;
+
+  *tuning = NULL;
+  kernel = autosa_kernel_copy(explore_candidate(data, kernel_id));
+  kernel->prog = gen->prog;
+  kernel->options = gen->options;
+  kernel->simd_w = 1;
+  kernel->lat_hide_len = 1;
+  kernel = autosa_kernel_create_local_arrays(kernel, gen->prog);
+  if (!kernel)
+    return NULL;
+
+  user_sizes = gen->options->autosa->sa_sizes;
+  gen->options->autosa->sa_sizes = (char *)sa_sizes.c_str();
+  r = sa_pe_optimize(kernel, data->pe_opt_en, data->pe_opt_mode);
+  gen->options->autosa->sa_sizes = user_sizes;
+
+  if (r < 0)
+  {
+    partial->n_pe = 1;
+    for (int i = 0; i < kernel->n_sa_dim; i++)
+      partial->n_pe *= kernel->sa_dim[i];
+    partial->lat_hide_len = kernel->lat_hide_len;
+    *tuning = kernel->tuning;
+    kernel->tuning = NULL;
+    autosa_kernel_free(kernel);
+    return NULL;
+  }
+
+  return kernel;
+}
+
+/* Collect the candidate tiling factors of a loop with the upper bound "ub".
+ * We consider the power-of-two divisors of "ub" and "ub" itself,
+ * so that the tiled loops are free of partial tiles.
+ * If "one" is set, the tiling factor one is considered as well.
+ */
+static std::vector<int> explore_tile_factors(int ub, bool one)
+{
+  std::vector<int> factors;
+
+  if (ub <= 1)
+  {
+    factors.push_back(1);
+    return factors;
+  }
+  if (one)
+    factors.push_back(1);
+  for (int f = 2; f < ub; f *= 2)
+  {
+    if (ub % f == 0)
+      factors.push_back(f);
+  }
+  factors.push_back(ub);
+
+  return factors;
+}
+
+/* Print the tiling factors "factors" of the stage "stage" in the format
+ * of the "--sa-sizes" option.
+ */
+static std::string explore_sizes_str(const char *stage,
+                                     const std::vector<int> &factors)
+{
+  std::string str = std::string(";kernel[0]->") + stage + "[";
+
+  for (int i = 0; i < factors.size(); i++)
+  {
+    if (i > 0)
+      str += ",";
+    str += std::to_string(factors[i]);
+  }
+  str += "]";
+
+  return str;
+}
+
+/* Expand the partial design point "sizes" with all the combinations of the
+ * tiling factors of the stage described by "tuning".
+ * For array partitioning and latency hiding, we take the cartesian product
+ * of the tiling factors of all the tilable loops.
+ * For SIMD vectorization, at most one legal loop is vectorized.
+ * The new design points are returned in order.
+ */
+static std::vector<std::string> explore_expand_point(const std::string &sizes,
+                                                     cJSON *tuning)
+{
+  std::vector<std::string> expanded;
+  cJSON *stage_json, *loops_json, *legal_json, *loop;
+  const char *stage;
+  std::vector<int> ubs;
+
+  stage_json = tuning->child;
+  if (!stage_json)
+    return expanded;
+  stage = stage_json->string;
+  loops_json = cJSON_GetObjectItemCaseSensitive(stage_json, "tilable_loops");
+  cJSON_ArrayForEach(loop, loops_json)
+  {
+    ubs.push_back(loop->valueint);
+  }
+  if (ubs.size() == 0)
+    return expanded;
+
+  if (!strcmp(stage, "simd"))
+  {
+    std::vector<int> factors(ubs.size(), 1);
+
+    legal_json = cJSON_GetObjectItemCaseSensitive(stage_json, "legal");
+    expanded.push_back(sizes + explore_sizes_str(stage, factors));
+    for (int i = 0; i < ubs.size(); i++)
+    {
+      cJSON *legal = cJSON_GetArrayItem(legal_json, i);
+      if (!legal || !legal->valueint)
+        continue;
+      std::vector<int> loop_factors = explore_tile_factors(ubs[i], false);
+      for (int f : loop_factors)
+      {
+        if (f == 1)
+          continue;
+        factors[i] = f;
+        expanded.push_back(sizes + explore_sizes_str(stage, factors));
+      }
+      factors[i] = 1;
+    }
+  }
+  else
+  {
+    std::vector<std::vector<int> > loop_factors;
+    std::vector<int> idx(ubs.size(), 0);
+    std::vector<int> factors(ubs.size());
+
+    for (int i = 0; i < ubs.size(); i++)
+      loop_factors.push_back(explore_tile_factors(ubs[i], false));
+    while (1)
+    {
+      int i;
+
+      for (i = 0; i < ubs.size(); i++)
+        factors[i] = loop_factors[i][idx[i]];
+      expanded.push_back(sizes + explore_sizes_str(stage, factors));
+      /* Move to the next combination. */
+      for (i = ubs.size() - 1; i >= 0; i--)
+      {
+        if (++idx[i] < loop_factors[i].size())
+          break;
+        idx[i] = 0;
+      }
+      if (i < 0)
+        break;
+    }
+  }
+
+  return expanded;
+}
+
+/* Extract the tiling factors of the stage "stage" from the design point
+ * "sizes". The array partitioning factors are applied to the members of
+ * the outermost permutable band of the systolic array candidate in order.
+ * Return an empty vector if the stage is not applied.
+ */
+static std::vector<int> explore_stage_factors(const std::string &sizes,
+                                              const char *stage)
+{
+  std::vector<int> factors;
+  std::string key = std::string("->") + stage + "[";
+  size_t pos = sizes.find(key);
+
+  if (pos == std::string::npos)
+    return factors;
+  pos += key.size();
+  while (pos < sizes.size() && sizes[pos] != ']')
+  {
+    size_t end;
+    factors.push_back(std::stoi(sizes.substr(pos), &end));
+    pos += end;
+    if (sizes[pos] == ',')
+      pos++;
+  }
+
+  return factors;
+}
+
+/* Compute the resource of a single PE lane of "sa" with the widest data
+ * type in the program.
+ */
+static void explore_lane_resource(struct autosa_kernel *sa,
+                                  struct autosa_resource *op)
+{
+  extract_op_resource("char", op);
+  for (int i = 0; i < sa->scop->pet->n_array; i++)
+  {
+    struct autosa_resource array_op;
+    extract_op_resource(sa->scop->pet->arrays[i]->element_type, &array_op);
+    if (array_op.dsp > op->dsp)
+      *op = array_op;
+  }
+}
+
+/* Internal data structure for explore_estimate_point.
+ * "ubs" and "tiles" contain the upper bounds and the array partitioning
+ * factors of the "n" band members, and "order" the order of the array
+ * partitioning loops from the outermost to the innermost.
+ * "traffic" and "buffer" contain the off-chip traffic (in bytes) and the
+ * on-chip buffer size (in bits) of each array.
+ * "write_dep" is set for the band members that the writes depend on.
+ */
+struct autosa_explore_est_data
+{
+  struct autosa_kernel *sa;
+  int n;
+  int *ubs;
+  std::vector<int> tiles;
+  std::vector<int> order;
+  bool write;
+  std::map<std::string, double> traffic[2];
+  std::map<std::string, double> buffer;
+  std::vector<bool> write_dep;
+};
+
+/* Update the off-chip traffic and the on-chip buffer size of the array
+ * access "map", which maps the band members to the array elements.
+ * Each array partition keeps the footprint of the access on-chip,
+ * which is the product of the tiling factors of the loops that the access
+ * depends on. The footprint is transferred once per array partition,
+ * i.e., the elements are reloaded across the tiles of the loops that
+ * the access doesn't depend on, except for the innermost array partitioning
+ * loops that the access doesn't depend on, across which the I/O buffers
+ * are hoisted and the footprint stays on-chip.
+ * Accesses to the same array from different statements are assumed to
+ * share the same data.
+ */
+static isl_stat explore_access_update(__isl_take isl_map *map, void *user)
+{
+  struct autosa_explore_est_data *data = (struct autosa_explore_est_data *)user;
+  const char *name = isl_map_get_tuple_name(map, isl_dim_out);
+  double footprint = 1, traffic;
+  std::vector<bool> dep(data->n);
+  int ele_size, last;
+
+  if (!name)
+  {
+    isl_map_free(map);
+    return isl_stat_ok;
+  }
+
+  for (int i = 0; i < data->n; i++)
+  {
+    int tile = i < data->tiles.size() ? data->tiles[i] : data->ubs[i];
+    dep[i] = isl_map_involves_dims(map, isl_dim_in, i, 1);
+    if (dep[i])
+      footprint *= tile;
+    if (dep[i] && data->write)
+      data->write_dep[i] = true;
+  }
+  /* Skip the innermost loops that the access doesn't depend on. */
+  for (last = data->n - 1; last >= 0; last--)
+  {
+    if (dep[data->order[last]])
+      break;
+  }
+  traffic = footprint;
+  for (int j = 0; j <= last; j++)
+  {
+    int i = data->order[j];
+    int tile = i < data->tiles.size() ? data->tiles[i] : data->ubs[i];
+    traffic *= (data->ubs[i] + tile - 1) / tile;
+  }
+  ele_size = sa_candidate_array_ele_size(data->sa, name);
+  data->traffic[data->write][name] = max(data->traffic[data->write][name],
+                                         traffic * ele_size);
+  data->buffer[name] = max(data->buffer[name], footprint * ele_size * 8);
+  isl_map_free(map);
+
+  return isl_stat_ok;
+}
+
+/* Return the number of I/O modules at the boundary of the array of
+ * the design point "point" that transfer the array "name" with interior I/O,
+ * i.e., the number of chains of PEs along the space loop selected by
+ * "kernel[0]->io_dir_<name>[dim]" in "sizes". Return zero if no direction
+ * is selected for the array or the array dimensions are unknown.
+ */
+static double explore_interior_io_modules(struct autosa_explore_point *point,
+                                          const std::string &sizes, const std::string &name)
+{
+  std::vector<int> dir = explore_stage_factors(sizes, ("io_dir_" + name).c_str());
+
+  if (dir.size() == 0 || dir[0] < 0 || dir[0] >= point->n_sa_dim ||
+      point->sa_dim[dir[0]] <= 0)
+    return 0;
+
+  return max((double)point->n_pe / point->sa_dim[dir[0]], 1.0);
+}
+
+/* Estimate the latency, the resource usage and the off-chip traffic of
+ * the design point "point" of the systolic array candidate "sa" with
+ * the tiling factors "sizes".
+ * Each PE lane performs one operation per cycle. Without enough latency
+ * hiding, the pipeline is stalled by the compute latency of the
+ * accumulation. The latency is further bounded by the time of
+ * transferring the off-chip data, with the bandwidth and the frequency
+ * read from "hw_info" ("DRAM_BW" in GB/s and "FREQ" in MHz).
+ * The DSPs are estimated from the lanes of the widest data type.
+ * The on-chip buffers are double buffered if enabled and are mapped to
+ * URAM if enabled, or BRAM otherwise.
+ * The arrays with interior I/O are transferred along the space loop selected
+ * in "sizes" by the I/O modules at the boundary of the array, which bounds
+ * the latency by the elements transferred per I/O module,
+ * see explore_interior_io_modules.
+ *
+ * If "max_lanes" is positive, the latency is instead a lower bound of
+ * the latency of any design with at most "max_lanes" PE lanes and enough
+ * latency hiding.
+ *
+ * The results of a single request start to leave the array once the first
+ * output tile is complete, i.e., after the array tiles up to the last tile
+ * of the reduction loops (the loops that the writes don't depend on) for
+ * the first output tile, in the order of the array partitioning loops.
+ * The array is filled and drained through all its PEs along the space
+ * dimensions, each hop costing the compute latency and one FIFO access.
+ * The dimensions of the array are unknown for partial design points,
+ * in which case the fill and the drain are not counted.
+ * The latencies include the PCIe transfers of the arrays between the host
+ * and the device (see sa_estimate_host_transfer), which are overlapped
+ * with the execution of the other requests in the pipelined host,
+ * such that the designs bound by the transfers are not favored.
+ * With "--AutoSA-batch1", the latency objective is the latency of
+ * the last result.
+ */
+static void explore_estimate_point(struct autosa_explore_point *point,
+                                   struct autosa_kernel *sa, const std::string &sizes, cJSON *hw_info,
+                                   double max_lanes = 0)
+{
+  struct autosa_explore_est_data data;
+  struct autosa_resource op;
+  isl_schedule_node *node;
+  isl_union_map *sched, *reads, *writes;
+  double bw = 77, freq = 300;
+  double ops = 1, compute, ii, n_tile = 1, n_first = 1, fill = 0, io = 0;
+  double host_in, host_out;
+  int n_buf = sa->options->autosa->double_buffer ? 2 : 1;
+  cJSON *item;
+
+  point->latency = 0;
+  point->dsp = 0;
+  point->bram18k = 0;
+  point->uram = 0;
+  point->dram_bytes = 0;
+  point->transfer_latency = 0;
+
+  if (hw_info)
+  {
+    item = cJSON_GetObjectItemCaseSensitive(hw_info, "DRAM_BW");
+    if (cJSON_IsNumber(item))
+      bw = item->valuedouble;
+    item = cJSON_GetObjectItemCaseSensitive(hw_info, "FREQ");
+    if (cJSON_IsNumber(item))
+      freq = item->valuedouble;
+  }
+
+  explore_lane_resource(sa, &op);
+  point->dsp = (long)point->n_pe * point->simd_w * op.dsp;
+
+  if (sa->type == AUTOSA_SA_TYPE_SYNC)
+    node = get_innermost_permutable_node(sa->schedule);
+  else
+    node = get_outermost_permutable_node(sa->schedule);
+  data.sa = sa;
+  data.n = isl_schedule_node_band_n_member(node);
+  data.ubs = extract_band_upper_bounds(sa, node);
+  if (!data.ubs)
+  {
+    isl_schedule_node_free(node);
+    return;
+  }
+  data.write_dep.assign(data.n, false);
+  data.tiles = explore_stage_factors(sizes, "array_part");
+  data.order = explore_stage_factors(sizes, "array_part_order");
+  std::vector<int> sorted_order(data.order);
+  std::sort(sorted_order.begin(), sorted_order.end());
+  for (int i = 0; i < sorted_order.size(); i++)
+  {
+    if (sorted_order[i] != i)
+      data.order.clear();
+  }
+  if (data.order.size() != data.n)
+  {
+    data.order.clear();
+    for (int i = 0; i < data.n; i++)
+      data.order.push_back(i);
+  }
+  for (int i = 0; i < data.n; i++)
+    ops *= data.ubs[i];
+
+  sched = isl_schedule_node_band_get_partial_schedule_union_map(node);
+  sched = isl_union_map_intersect_domain(sched, isl_schedule_node_get_domain(node));
+  sched = isl_union_map_reverse(sched);
+  reads = isl_union_map_apply_range(isl_union_map_copy(sched),
+                                    isl_union_map_copy(sa->scop->reads));
+  writes = isl_union_map_apply_range(sched,
+                                     isl_union_map_copy(sa->scop->may_writes));
+  data.write = false;
+  isl_union_map_foreach_map(reads, &explore_access_update, &data);
+  data.write = true;
+  isl_union_map_foreach_map(writes, &explore_access_update, &data);
+  isl_union_map_free(reads);
+  isl_union_map_free(writes);
+  isl_schedule_node_free(node);
+
+  /* Count the array tiles executed until the first output tile is
+   * complete, from the innermost array partitioning loop. */
+  for (int j = data.n - 1; j >= 0; j--)
+  {
+    int i = data.order[j];
+    int tile = i < data.tiles.size() ? data.tiles[i] : data.ubs[i];
+    double n_i = (data.ubs[i] + tile - 1) / tile;
+    if (!data.write_dep[i])
+      n_first += (n_i - 1) * n_tile;
+    n_tile *= n_i;
+  }
+  free(data.ubs);
+
+  for (int i = 0; i < 2; i++)
+    for (auto &it : data.traffic[i])
+      point->dram_bytes += it.second;
+  for (auto &it : data.buffer)
+  {
+    double bits = it.second * n_buf;
+    double n_io = explore_interior_io_modules(point, sizes, it.first);
+
+    /* The buffer of an array with interior I/O is split among the I/O
+     * modules at the array boundary, each transferring the elements of
+     * one chain of PEs at one element per cycle. */
+    if (n_io > 0)
+    {
+      double elems = (data.traffic[0][it.first] + data.traffic[1][it.first]) /
+                     sa_candidate_array_ele_size(sa, it.first.c_str());
+      io = max(io, elems / n_io);
+      bits /= n_io;
+    }
+    else
+    {
+      n_io = 1;
+    }
+    if (sa->options->autosa->uram)
+      point->uram += (long)(n_io * ceil(bits / (4096 * 72)));
+    else
+      point->bram18k += (long)(n_io * ceil(bits / (1024 * 18)));
+  }
+
+  /* Assume a compute latency of 5 cycles to be hidden. */
+  ii = point->lat_hide_len >= 5 ? 1 : ceil(5.0 / point->lat_hide_len);
+  compute = ops / ((double)point->n_pe * point->simd_w) * ii;
+  if (max_lanes > 0)
+    compute = ops / max_lanes;
+  point->latency = max(compute, point->dram_bytes / (bw * 1000 / freq));
+  point->latency = max(point->latency, io);
+
+  for (int i = 0; i < point->n_sa_dim; i++)
+    fill += point->sa_dim[i] * (AUTOSA_LAT_COMPUTE + AUTOSA_LAT_FIFO);
+  /* The data of a request is transferred from the host before its first
+   * result and back to the host after its last result. */
+  sa_estimate_host_transfer(sa, hw_info, freq, &host_in, &host_out);
+  point->transfer_latency = host_in + host_out;
+  point->first_latency = point->latency * n_first / n_tile + 2 * fill + host_in;
+  point->last_latency = point->latency + 2 * fill + host_in + host_out;
+  point->latency = sa_end_to_end_latency(sa->options, point->latency,
+                                         host_in, host_out);
+  if (sa->options->autosa->batch1)
+    point->latency = point->last_latency;
+}
+
+/* Select the order of the array partitioning loops of the design point
+ * "sizes" of the systolic array candidate "kernel_id" that minimizes
+ * the estimated off-chip traffic. "ubs" contains the upper bounds of
+ * the array partitioning loops.
+ * Only the loops with more than one tile are permuted, up to five of them.
+ * The other objectives of the cost model don't depend on the order.
+ * Among the orders with the same traffic, the original order is preferred.
+ * Return "sizes" extended with the selected order if it differs from
+ * the original one.
+ */
+static std::string explore_select_order(struct autosa_explore_data *data,
+                                        int kernel_id, const std::string &sizes, const std::vector<int> &ubs)
+{
+  struct autosa_explore_point point;
+  std::vector<int> tiles = explore_stage_factors(sizes, "array_part");
+  std::vector<int> movable, perm, order, best;
+  double best_bytes = -1;
+
+  for (int i = 0; i < ubs.size() && i < tiles.size(); i++)
+  {
+    if ((ubs[i] + tiles[i] - 1) / tiles[i] > 1)
+      movable.push_back(i);
+    order.push_back(i);
+  }
+  if (movable.size() <= 1 || movable.size() > 5)
+    return sizes;
+
+  perm = movable;
+  do
+  {
+    std::string order_sizes;
+
+    for (int k = 0; k < movable.size(); k++)
+      order[movable[k]] = perm[k];
+    order_sizes = sizes + explore_sizes_str("array_part_order", order);
+    point.n_sa_dim = 0;
+    point.n_pe = 1;
+    point.simd_w = 1;
+    point.lat_hide_len = 1;
+    explore_estimate_point(&point, explore_candidate(data, kernel_id),
+                           order_sizes, data->hw_info);
+    if (best_bytes < 0 || point.dram_bytes < best_bytes)
+    {
+      best_bytes = point.dram_bytes;
+      best = order;
+    }
+  } while (std::next_permutation(perm.begin(), perm.end()));
+
+  for (int i = 0; i < best.size(); i++)
+  {
+    if (best[i] != i)
+      return sizes + explore_sizes_str("array_part_order", best);
+  }
+
+  return sizes;
+}
+
+/* Does the design point "point" exceed the resources available under
+ * the utilization target?
+ */
+static bool explore_point_exceeds(struct autosa_explore_data *data,
+                                  struct autosa_explore_point *point)
+{
+  if (data->dsp_limit >= 0 && point->dsp > data->dsp_limit)
+    return true;
+  if (data->bram_limit >= 0 && point->bram18k > data->bram_limit)
+    return true;
+  if (data->uram_limit >= 0 && point->uram > data->uram_limit)
+    return true;
+
+  return false;
+}
+
+/* Should the design points reachable from the partial design point "sizes"
+ * of the systolic array candidate "kernel_id" be pruned?
+ * "stage" is the stage of which the tiling factors are enumerated in
+ * "sizes", and "partial" contains the information of the partially
+ * optimized kernel before this stage.
+ *
+ * We compute the lower bounds of the objectives of the reachable design
+ * points. In our cost model, the on-chip buffers and the off-chip traffic
+ * only depend on the array partitioning factors and are thus known exactly.
+ * After latency hiding, the number of PEs is known and every SIMD factor
+ * determines a design point exactly. Before that, the number of PEs can
+ * only decrease with latency hiding, and we bound the DSPs with a single PE
+ * and the latency with the maximal number of PE lanes that fit in the DSPs.
+ * The resources are monotone in the tiling factors, therefore,
+ * the reachable design points are pruned if the lower bounds exceed
+ * the available resources, or if an explored design point is no worse
+ * than the lower bounds in all the objectives.
+ * If "bound_latency" is not NULL, the lower bound of the latency is
+ * stored in it.
+ */
+static bool explore_prune_point(struct autosa_explore_data *data,
+                                int kernel_id, const std::string &sizes, const char *stage,
+                                struct autosa_explore_point *partial,
+                                double *bound_latency = NULL)
+{
+  struct autosa_explore_point bound;
+  double max_lanes = 1e18;
+
+  bound.n_sa_dim = 0;
+  bound.n_pe = 1;
+  bound.simd_w = 1;
+  bound.lat_hide_len = partial->lat_hide_len;
+  if (!strcmp(stage, "simd"))
+  {
+    std::vector<int> factors = explore_stage_factors(sizes, "simd");
+    bound.n_pe = partial->n_pe;
+    for (int f : factors)
+      bound.simd_w *= f;
+    max_lanes = 0;
+  }
+  else if (data->dsp_limit >= 0)
+  {
+    max_lanes = max(data->dsp_limit / max(data->lane.dsp, 1L), 1.0);
+  }
+  explore_estimate_point(&bound, explore_candidate(data, kernel_id), sizes,
+                         data->hw_info, max_lanes);
+  if (bound_latency)
+    *bound_latency = bound.latency;
+
+  if (explore_point_exceeds(data, &bound))
+    return true;
+  for (int i = 0; i < data->points.size(); i++)
+  {
+    struct autosa_explore_point *p = &data->points[i];
+    if (p->latency <= bound.latency && p->dsp <= bound.dsp &&
+        p->bram18k <= bound.bram18k && p->uram <= bound.uram &&
+        p->dram_bytes <= bound.dram_bytes)
+      return true;
+  }
+
+  return false;
+}
+
+/* Collect the names of the arrays of "kernel" with interior I/O, i.e.,
+ * with communication pairs that don't cross the PEs. The direction in which
+ * these arrays are transferred is free, see autosa_interior_io_eliminate.
+ * The communication pairs are updated by the PE optimization of "kernel".
+ */
+static std::vector<std::string> explore_interior_io_arrays(
+    struct autosa_kernel *kernel)
+{
+  std::vector<std::string> names;
+
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_array_info *array = kernel->array[i].array;
+    bool interior = false;
+
+    for (int j = 0; j < array->n_ref && !interior; j++)
+    {
+      struct autosa_stmt_access *ref = array->refs[j];
+      for (int k = 0; k < ref->n_io_info && !interior; k++)
+        if (isl_vec_is_zero(ref->io_info[k]->dir))
+          interior = true;
+    }
+    if (interior)
+      names.push_back(array->name);
+  }
+
+  return names;
+}
+
+/* Convert the design point "point" to a JSON object.
+ * If "full" is set, the tiling factors are printed with the enclosing
+ * braces, i.e., in the format of the "--sa-sizes" option.
+ */
+static cJSON *explore_point_to_json(struct autosa_explore_point *point,
+                                    bool full = false)
+{
+  cJSON *point_json = cJSON_CreateObject();
+
+  if (full)
+    cJSON_AddStringToObject(point_json, "sa_sizes",
+                            ("{" + std::string(point->sa_sizes) + "}").c_str());
+  else
+    cJSON_AddStringToObject(point_json, "sa_sizes", point->sa_sizes);
+  cJSON_AddNumberToObject(point_json, "kernel_id", point->kernel_id);
+  cJSON_AddItemToObject(point_json, "sa_dims",
+                        cJSON_CreateIntArray(point->sa_dim, point->n_sa_dim));
+  cJSON_AddNumberToObject(point_json, "n_pe", point->n_pe);
+  cJSON_AddNumberToObject(point_json, "simd", point->simd_w);
+  cJSON_AddNumberToObject(point_json, "latency_hide_len", point->lat_hide_len);
+  cJSON_AddNumberToObject(point_json, "latency", point->latency);
+  cJSON_AddNumberToObject(point_json, "first_result_latency", point->first_latency);
+  cJSON_AddNumberToObject(point_json, "last_result_latency", point->last_latency);
+  cJSON_AddNumberToObject(point_json, "DSP", point->dsp);
+  cJSON_AddNumberToObject(point_json, "BRAM18K", point->bram18k);
+  cJSON_AddNumberToObject(point_json, "URAM", point->uram);
+  cJSON_AddNumberToObject(point_json, "DRAM_bytes", point->dram_bytes);
+  cJSON_AddNumberToObject(point_json, "transfer_latency", point->transfer_latency);
+  if (point->corrected)
+  {
+    cJSON *analytic = cJSON_CreateObject();
+
+    cJSON_AddNumberToObject(analytic, "latency", point->analytic_latency);
+    cJSON_AddNumberToObject(analytic, "DSP", point->analytic_dsp);
+    cJSON_AddNumberToObject(analytic, "BRAM18K", point->analytic_bram18k);
+    cJSON_AddNumberToObject(analytic, "URAM", point->analytic_uram);
+    cJSON_AddItemToObject(point_json, "analytic", analytic);
+  }
+
+  return point_json;
+}
+
+/* Extract the design point from the JSON object "point_json". */
+static struct autosa_explore_point explore_point_from_json(cJSON *point_json)
+{
+  struct autosa_explore_point point;
+  cJSON *dims_json, *dim, *item;
+
+  point.sa_sizes = strdup(cJSON_GetObjectItemCaseSensitive(
+                              point_json, "sa_sizes")
+                              ->valuestring);
+  point.kernel_id = cJSON_GetObjectItemCaseSensitive(point_json, "kernel_id")->valueint;
+  dims_json = cJSON_GetObjectItemCaseSensitive(point_json, "sa_dims");
+  point.n_sa_dim = 0;
+  cJSON_ArrayForEach(dim, dims_json)
+  {
+    point.sa_dim[point.n_sa_dim++] = dim->valueint;
+  }
+  point.n_pe = cJSON_GetObjectItemCaseSensitive(point_json, "n_pe")->valueint;
+  point.simd_w = cJSON_GetObjectItemCaseSensitive(point_json, "simd")->valueint;
+  point.lat_hide_len = cJSON_GetObjectItemCaseSensitive(
+                           point_json, "latency_hide_len")
+                           ->valueint;
+  point.latency = cJSON_GetObjectItemCaseSensitive(point_json, "latency")->valuedouble;
+  point.first_latency = cJSON_GetObjectItemCaseSensitive(point_json, "first_result_latency")->valuedouble;
+  point.last_latency = cJSON_GetObjectItemCaseSensitive(point_json, "last_result_latency")->valuedouble;
+  point.dsp = (long)cJSON_GetObjectItemCaseSensitive(point_json, "DSP")->valuedouble;
+  point.bram18k = (long)cJSON_GetObjectItemCaseSensitive(point_json, "BRAM18K")->valuedouble;
+  point.uram = (long)cJSON_GetObjectItemCaseSensitive(point_json, "URAM")->valuedouble;
+  point.dram_bytes = cJSON_GetObjectItemCaseSensitive(point_json, "DRAM_bytes")->valuedouble;
+  item = cJSON_GetObjectItemCaseSensitive(point_json, "transfer_latency");
+  point.transfer_latency = cJSON_IsNumber(item) ? item->valuedouble : 0;
+  point.corrected = 0;
+
+  return point;
+}
+
+/* Append the entry "entry" of the design point "item" to the exploration
+ * journal of "data", if any, as a single line.
+ * The line is written with a single system call to the journal opened
+ * in the append mode, such that the lines of the exploration workers
+ * sharing the journal are not interleaved, and it survives the process
+ * being killed right after.
+ */
+static void explore_journal_write(struct autosa_explore_data *data,
+                                  const std::pair<int, std::string> &item, cJSON *entry)
+{
+  char *content;
+  std::string line;
+
+  if (data->journal < 0)
+  {
+    cJSON_Delete(entry);
+    return;
+  }
+  cJSON_AddNumberToObject(entry, "kernel_id", item.first);
+  cJSON_AddStringToObject(entry, "sizes", item.second.c_str());
+  content = cJSON_PrintUnformatted(entry);
+  line = std::string(content) + "\n";
+  if (write(data->journal, line.c_str(), line.size()) != (ssize_t)line.size())
+    printf("[AutoSA] Warning: Failed to write the exploration journal.\n");
+  free(content);
+  cJSON_Delete(entry);
+}
+
+/* Journal the complete design point "item", for which the design points
+ * data->points[first] to the last one are recorded.
+ */
+static void explore_journal_complete(struct autosa_explore_data *data,
+                                     const std::pair<int, std::string> &item, int first)
+{
+  cJSON *entry, *points_json;
+
+  if (data->journal < 0)
+    return;
+  entry = cJSON_CreateObject();
+  points_json = cJSON_CreateArray();
+  for (int i = first; i < data->points.size(); i++)
+    cJSON_AddItemToArray(points_json, explore_point_to_json(&data->points[i]));
+  cJSON_AddItemToObject(entry, "points", points_json);
+  explore_journal_write(data, item, entry);
+}
+
+/* Journal the partial design point "item", expanded into "children"
+ * at the stage "stage", with the partially optimized kernel "partial".
+ */
+static void explore_journal_partial(struct autosa_explore_data *data,
+                                    const std::pair<int, std::string> &item, const char *stage,
+                                    struct autosa_explore_point *partial,
+                                    const std::vector<std::string> &children)
+{
+  cJSON *entry, *children_json;
+
+  if (data->journal < 0)
+    return;
+  entry = cJSON_CreateObject();
+  cJSON_AddStringToObject(entry, "stage", stage);
+  cJSON_AddNumberToObject(entry, "n_pe", partial->n_pe);
+  cJSON_AddNumberToObject(entry, "latency_hide_len", partial->lat_hide_len);
+  children_json = cJSON_CreateArray();
+  for (int i = 0; i < children.size(); i++)
+    cJSON_AddItemToArray(children_json,
+                         cJSON_CreateString(children[i].c_str()));
+  cJSON_AddItemToObject(entry, "children", children_json);
+  explore_journal_write(data, item, entry);
+}
+
+/* Read the entry of the exploration journal "line" into "data".
+ * The design points of a complete entry are recorded right away,
+ * so that they bound the pruning from the start of the exploration.
+ * Return false if the line cannot be parsed, e.g., if the previous run
+ * was killed while writing it.
+ */
+static bool explore_journal_read_entry(struct autosa_explore_data *data,
+                                       const char *line)
+{
+  cJSON *entry, *kernel_id, *sizes, *points_json, *item;
+  struct autosa_explore_entry known;
+  std::pair<int, std::string> key;
+
+  entry = cJSON_Parse(line);
+  kernel_id = cJSON_GetObjectItemCaseSensitive(entry, "kernel_id");
+  sizes = cJSON_GetObjectItemCaseSensitive(entry, "sizes");
+  if (!cJSON_IsNumber(kernel_id) || !cJSON_IsString(sizes))
+  {
+    cJSON_Delete(entry);
+    return false;
+  }
+  key = std::make_pair(kernel_id->valueint, std::string(sizes->valuestring));
+  if (data->known.find(key) != data->known.end())
+  {
+    /* Evaluated by more than one sampling worker. */
+    cJSON_Delete(entry);
+    return true;
+  }
+
+  points_json = cJSON_GetObjectItemCaseSensitive(entry, "points");
+  known.complete = points_json != NULL;
+  known.first = data->points.size();
+  cJSON_ArrayForEach(item, points_json)
+  {
+    data->points.push_back(explore_point_from_json(item));
+  }
+  known.last = data->points.size();
+  if (!known.complete)
+  {
+    known.stage = cJSON_GetObjectItemCaseSensitive(entry, "stage")->valuestring;
+    known.partial.n_pe = cJSON_GetObjectItemCaseSensitive(entry, "n_pe")->valueint;
+    known.partial.lat_hide_len = cJSON_GetObjectItemCaseSensitive(
+                                     entry, "latency_hide_len")
+                                     ->valueint;
+    cJSON_ArrayForEach(item, cJSON_GetObjectItemCaseSensitive(entry, "children"))
+    {
+      known.children.push_back(item->valuestring);
+    }
+  }
+  data->known[key] = known;
+  cJSON_Delete(entry);
+
+  return true;
+}
+
+/* Return the signature of the exploration of "schedule" in "data",
+ * i.e., the hash of the schedule, the tuning configuration and
+ * the hardware information, which decide the design points and
+ * their estimates.
+ */
+static std::string explore_journal_signature(struct autosa_explore_data *data,
+                                             __isl_keep isl_schedule *schedule)
+{
+  unsigned long long h = 14695981039346656037ULL;
+  char *strs[3];
+  char buf[32];
+
+  strs[0] = isl_schedule_to_str(schedule);
+  strs[1] = data->gen->tuning_config ? cJSON_PrintUnformatted(data->gen->tuning_config) : NULL;
+  strs[2] = data->hw_info ? cJSON_PrintUnformatted(data->hw_info) : NULL;
+  for (int i = 0; i < 3; i++)
+  {
+    for (char *c = strs[i]; c && *c; c++)
+    {
+      h ^= (unsigned char)*c;
+      h *= 1099511628211ULL;
+    }
+    h ^= 0xff;
+    h *= 1099511628211ULL;
+    free(strs[i]);
+  }
+  sprintf(buf, "%016llx", h);
+
+  return buf;
+}
+
+/* Open the exploration journal "--AutoSA-explore-journal" of "data" for
+ * the exploration of "schedule", and resume from the design points
+ * journaled by a previous run of the same exploration.
+ *
+ * The first line of the journal contains the signature of the exploration,
+ * and every following line a (partial) design point evaluated so far,
+ * see explore_journal_complete and explore_journal_partial.
+ * A journal with a different signature is started over.
+ * The journaled design points are not evaluated again, see explore_step,
+ * and the recorded ones are restored before the search starts, such that
+ * the incumbent design points prune the design space immediately.
+ */
+static void explore_journal_open(struct autosa_explore_data *data,
+                                 __isl_keep isl_schedule *schedule)
+{
+  const char *path = data->gen->options->autosa->explore_journal;
+  std::string signature;
+  FILE *fp;
+  char *line = NULL;
+  size_t n = 0;
+  ssize_t len;
+  bool valid = false, broken = false;
+  int flags = O_WRONLY | O_CREAT | O_APPEND;
+
+  data->journal = -1;
+  if (!path)
+    return;
+  signature = explore_journal_signature(data, schedule);
+  fp = fopen(path, "r");
+  if (fp && (len = getline(&line, &n, fp)) > 0)
+  {
+    cJSON *header = cJSON_Parse(line);
+    cJSON *item = cJSON_GetObjectItemCaseSensitive(header, "signature");
+
+    valid = cJSON_IsString(item) && signature == item->valuestring;
+    cJSON_Delete(header);
+    if (!valid)
+      printf("[AutoSA] Warning: The exploration journal %s belongs to "
+             "another exploration, and is started over.\n", path);
+    while (valid && (len = getline(&line, &n, fp)) > 0)
+    {
+      broken = line[len - 1] != '\n';
+      if (!explore_journal_read_entry(data, line))
+        printf("[AutoSA] Warning: Skip a broken entry in the exploration "
+               "journal %s.\n", path);
+    }
+  }
+  free(line);
+  if (fp)
+    fclose(fp);
+
+  if (!valid)
+    flags |= O_TRUNC;
+  data->journal = open(path, flags, 0644);
+  if (data->journal < 0)
+  {
+    printf("[AutoSA] Warning: Cannot open the exploration journal %s.\n",
+           path);
+    return;
+  }
+  if (!valid)
+  {
+    std::string header = "{\"signature\":\"" + signature + "\"}\n";
+    write(data->journal, header.c_str(), header.size());
+  }
+  else if (broken)
+  {
+    /* Terminate the entry cut off by the previous run. */
+    write(data->journal, "\n", 1);
+  }
+  if (data->known.size() > 0)
+    printf("[AutoSA] Resume the exploration from %d journaled (partial) "
+           "design points, with %d design points recorded.\n",
+           (int)data->known.size(), (int)data->points.size());
+}
+
+/* Record the fully optimized "kernel" with the tiling factors "sizes"
+ * as a design point.
+ * Design points exceeding the available resources are dropped.
+ */
+static void explore_record_io_point(struct autosa_explore_data *data,
+                                    struct autosa_kernel *kernel, int kernel_id, const std::string &sizes)
+{
+  struct autosa_explore_point point;
+
+  point.sa_sizes = strdup(sizes.c_str());
+  point.kernel_id = kernel_id;
+  point.n_sa_dim = kernel->n_sa_dim;
+  point.n_pe = 1;
+  for (int i = 0; i < kernel->n_sa_dim; i++)
+  {
+    point.sa_dim[i] = kernel->sa_dim[i];
+    point.n_pe *= kernel->sa_dim[i];
+  }
+  point.simd_w = kernel->simd_w;
+  point.lat_hide_len = kernel->lat_hide_len;
+  point.corrected = 0;
+  explore_estimate_point(&point, explore_candidate(data, kernel_id), sizes,
+                         data->hw_info);
+  if (explore_point_exceeds(data, &point))
+  {
+    free(point.sa_sizes);
+    data->n_pruned++;
+    return;
+  }
+
+  data->points.push_back(point);
+}
+
+/* Record the fully optimized "kernel" as a design point.
+ * If the array has more than one dimension, the direction of each array
+ * with interior I/O is a design choice: it decides whether the array is
+ * transferred through the rows or the columns of PEs, which changes the
+ * number of I/O modules and the length of the daisy chains. A design point
+ * is recorded for each combination of the directions.
+ */
+static void explore_record_point(struct autosa_explore_data *data,
+                                 struct autosa_kernel *kernel, int kernel_id, const std::string &sizes)
+{
+  std::vector<std::string> arrays;
+  std::vector<int> dirs;
+
+  if (kernel->n_sa_dim > 1)
+    arrays = explore_interior_io_arrays(kernel);
+  dirs.assign(arrays.size(), 0);
+  while (1)
+  {
+    std::string point_sizes = sizes;
+    int i;
+
+    for (i = 0; i < arrays.size(); i++)
+      point_sizes += explore_sizes_str(("io_dir_" + arrays[i]).c_str(),
+                                       std::vector<int>(1, dirs[i]));
+    explore_record_io_point(data, kernel, kernel_id, point_sizes);
+    /* Move to the next combination. */
+    for (i = arrays.size() - 1; i >= 0; i--)
+    {
+      if (++dirs[i] < kernel->n_sa_dim)
+        break;
+      dirs[i] = 0;
+    }
+    if (i < 0)
+      break;
+  }
+}
+
+/* Evaluate the design point "item" and update the design points
+ * in "data".
+ * If the design point is complete, it is recorded.
+ * Otherwise, the new design points expanded from "item" are appended to
+ * "expanded", except for those pruned by explore_prune_point.
+ * If "bounds" is not NULL, the lower bounds of the latency of the new
+ * design points are appended to it.
+ * Every evaluated design point is journaled. The design points found in
+ * the journal are replayed instead: a complete design point is already
+ * recorded, and a partial one is expanded into the journaled design points.
+ */
+static void explore_step(struct autosa_explore_data *data,
+                         const std::pair<int, std::string> &item,
+                         std::vector<std::pair<int, std::string> > &expanded,
+                         std::vector<double> *bounds = NULL)
+{
+  struct autosa_kernel *kernel;
+  struct autosa_explore_point partial;
+  const char *stage = "";
+  cJSON *tuning = NULL;
+  std::vector<std::string> points;
+  std::map<std::pair<int, std::string>, struct autosa_explore_entry>::iterator known;
+
+  known = data->known.find(item);
+  if (known != data->known.end())
+  {
+    data->n_resumed++;
+    if (known->second.complete)
+      return;
+    points = known->second.children;
+    stage = known->second.stage.c_str();
+    partial = known->second.partial;
+  }
+  else
+  {
+    data->n_eval++;
+    partial.n_pe = 1;
+    partial.lat_hide_len = 1;
+    kernel = explore_eval_point(data, item.first, item.second, &tuning,
+                                &partial);
+    if (kernel)
+    {
+      int first = data->points.size();
+
+      explore_record_point(data, kernel, item.first, item.second);
+      autosa_kernel_free(kernel);
+      explore_journal_complete(data, item, first);
+      return;
+    }
+    if (tuning)
+    {
+      points = explore_expand_point(item.second, tuning);
+      stage = tuning->child ? tuning->child->string : "";
+    }
+    if (!strcmp(stage, "array_part"))
+    {
+      /* The order of the array partitioning loops is selected along with
+       * the tiling factors. */
+      std::vector<int> ubs;
+      cJSON *loop;
+
+      cJSON_ArrayForEach(loop, cJSON_GetObjectItemCaseSensitive(tuning->child, "tilable_loops"))
+      {
+        ubs.push_back(loop->valueint);
+      }
+      for (int i = 0; i < points.size(); i++)
+        points[i] = explore_select_order(data, item.first, points[i], ubs);
+    }
+    explore_journal_partial(data, item, stage, &partial, points);
+  }
+  for (int i = 0; i < points.size(); i++)
+  {
+    double bound;
+
+    if (explore_prune_point(data, item.first, points[i], stage, &partial,
+                            &bound))
+    {
+      data->n_pruned++;
+      continue;
+    }
+    expanded.push_back(std::make_pair(item.first, points[i]));
+    if (bounds)
+      bounds->push_back(bound);
+  }
+  cJSON_Delete(tuning);
+}
+
+/* Explore all the design points reachable from the partial design
+ * points in "stack" in a depth-first manner.
+ * At most "max_points" design points are recorded if "max_points" is positive.
+ */
+static void explore_dfs(struct autosa_explore_data *data,
+                        std::vector<std::pair<int, std::string> > &stack, int max_points)
+{
+  while (!stack.empty())
+  {
+    std::pair<int, std::string> item;
+    std::vector<std::pair<int, std::string> > expanded;
+
+    if (max_points > 0 && data->points.size() >= max_points)
+    {
+      printf("[AutoSA] Warning: Exploration stopped after %d design points.\n",
+             max_points);
+      break;
+    }
+
+    item = stack.back();
+    stack.pop_back();
+    explore_step(data, item, expanded);
+    for (int i = expanded.size() - 1; i >= 0; i--)
+      stack.push_back(expanded[i]);
+  }
+}
+
+/* Expand the partial design points in "frontier" in a breadth-first manner,
+ * until there are at least "n" partial design points or no design point
+ * can be expanded any more.
+ */
+static void explore_bfs(struct autosa_explore_data *data,
+                        std::vector<std::pair<int, std::string> > &frontier, int n)
+{
+  while (!frontier.empty() && frontier.size() < n)
+  {
+    std::vector<std::pair<int, std::string> > expanded;
+
+    for (int i = 0; i < frontier.size(); i++)
+      explore_step(data, frontier[i], expanded);
+    frontier = expanded;
+  }
+}
+
+/* A partial or complete design point visited by a sampling search strategy,
+ * see explore_search.
+ * "expanded" is set once the design point is evaluated.
+ * "children" contains the design points expanded from a partial design
+ * point that are not pruned, and "bounds" the lower bounds of their latency.
+ * A design point without any children is complete, and the design points
+ * recorded for it are data->points[first] to data->points[last - 1].
+ * "exhausted" is set once all the design points reachable from this one
+ * are visited.
+ * "n_obs" and "sum_obs" are the number and the sum of the logarithms of
+ * the latencies of the complete design points reached from this one.
+ */
+struct autosa_explore_node
+{
+  bool expanded;
+  bool exhausted;
+  std::vector<std::pair<int, std::string> > children;
+  std::vector<double> bounds;
+  int first;
+  int last;
+  int n_obs;
+  double sum_obs;
+
+  autosa_explore_node() : expanded(false), exhausted(false), first(0),
+                          last(0), n_obs(0), sum_obs(0) {}
+};
+
+/* Internal data structure of the sampling search strategies.
+ * "strategy" is one of "random", "genetic" and "bayes".
+ * "nodes" contains the visited design points, where the root, with
+ * the empty key, has the systolic array candidates as children.
+ * The search stops after "budget" evaluations of (partial) design points
+ * or at the time "deadline", if positive.
+ */
+struct autosa_explore_search
+{
+  struct autosa_explore_data *data;
+  std::string strategy;
+  std::map<std::pair<int, std::string>, struct autosa_explore_node> nodes;
+  std::mt19937 rng;
+  int budget;
+  time_t deadline;
+};
+
+/* The prior standard deviation of the logarithm of the best latency
+ * reachable from a partial design point around its lower bound,
+ * and the standard deviation of the observed latencies, used by
+ * the "bayes" strategy.
+ */
+#define AUTOSA_EXPLORE_PRIOR_STD 1.0
+#define AUTOSA_EXPLORE_OBS_STD 0.5
+/* The population of the "genetic" strategy. */
+#define AUTOSA_EXPLORE_POPULATION 16
+
+/* Return the objective of the design point "point" minimized by
+ * the sampling search strategies.
+ */
+static double explore_point_objective(struct autosa_explore_data *data,
+                                      struct autosa_explore_point *point)
+{
+  if (data->gen->options->autosa->batch1)
+    return point->last_latency;
+  return point->latency;
+}
+
+/* Return the node of the design point "item", evaluated if needed. */
+static struct autosa_explore_node *explore_search_visit(
+    struct autosa_explore_search *search,
+    const std::pair<int, std::string> &item)
+{
+  struct autosa_explore_node *node = &search->nodes[item];
+  std::map<std::pair<int, std::string>, struct autosa_explore_entry>::iterator known;
+
+  if (!node->expanded)
+  {
+    node->expanded = true;
+    node->first = search->data->points.size();
+    explore_step(search->data, item, node->children, &node->bounds);
+    node->last = search->data->points.size();
+    known = search->data->known.find(item);
+    if (known != search->data->known.end() && known->second.complete)
+    {
+      /* Recorded from the journal. */
+      node->first = known->second.first;
+      node->last = known->second.last;
+    }
+    node->exhausted = node->children.empty();
+  }
+
+  return node;
+}
+
+/* Has the search "search" used up its budget?
+ */
+static bool explore_search_done(struct autosa_explore_search *search)
+{
+  struct autosa_explore_data *data = search->data;
+  int max_points = data->gen->options->autosa->explore_max_points;
+
+  if (search->nodes[std::make_pair(-1, std::string())].exhausted)
+    return true;
+  if (data->n_eval >= search->budget)
+    return true;
+  if (max_points > 0 && data->points.size() >= max_points)
+    return true;
+  if (search->deadline > 0 && time(NULL) >= search->deadline)
+    return true;
+
+  return false;
+}
+
+/* Select the child of "node" to descend into, among the children that are
+ * not exhausted.
+ * With the "genetic" strategy, the child is selected by the gene "gene"
+ * (modulo the number of children).
+ * With the "bayes" strategy, the child is selected by Thompson sampling:
+ * the best latency reachable from each child is modelled by a log-normal
+ * distribution, with the lower bound of the cost model as prior and
+ * the latencies of the design points reached from the child so far as
+ * observations, and the child with the lowest sample is selected.
+ * Otherwise, the child is selected uniformly at random.
+ * Return -1 if all the children are exhausted.
+ */
+static int explore_search_select(struct autosa_explore_search *search,
+                                 struct autosa_explore_node *node, unsigned gene)
+{
+  std::vector<int> candidates;
+  std::normal_distribution<double> normal(0, 1);
+  double best = 0;
+  int selected = -1;
+
+  for (int i = 0; i < node->children.size(); i++)
+  {
+    std::map<std::pair<int, std::string>, struct autosa_explore_node>::iterator it;
+
+    it = search->nodes.find(node->children[i]);
+    if (it == search->nodes.end() || !it->second.exhausted)
+      candidates.push_back(i);
+  }
+  if (candidates.empty())
+    return -1;
+  if (search->strategy == "genetic")
+    return candidates[gene % candidates.size()];
+  if (search->strategy != "bayes")
+    return candidates[search->rng() % candidates.size()];
+
+  for (int i : candidates)
+  {
+    double prec0 = 1.0 / (AUTOSA_EXPLORE_PRIOR_STD * AUTOSA_EXPLORE_PRIOR_STD);
+    double prec_obs = 1.0 / (AUTOSA_EXPLORE_OBS_STD * AUTOSA_EXPLORE_OBS_STD);
+    double mean = i < node->bounds.size() ? log(max(node->bounds[i], 1.0)) : 0;
+    double prec = prec0, sample;
+    std::map<std::pair<int, std::string>, struct autosa_explore_node>::iterator it;
+
+    it = search->nodes.find(node->children[i]);
+    if (it != search->nodes.end() && it->second.n_obs > 0)
+    {
+      prec = prec0 + it->second.n_obs * prec_obs;
+      mean = (mean * prec0 + it->second.sum_obs * prec_obs) / prec;
+    }
+    sample = mean + normal(search->rng) / sqrt(prec);
+    if (selected < 0 || sample < best)
+    {
+      best = sample;
+      selected = i;
+    }
+  }
+
+  return selected;
+}
+
+/* Descend from the root of "search" to a complete design point that is
+ * not visited yet, evaluating the design points on the way, and return
+ * the objective of the best design point recorded for it.
+ * Return a negative value if no design point is recorded, e.g., if it
+ * exceeds the available resources or if everything is exhausted.
+ * With the "genetic" strategy, the children are selected by "genes",
+ * which is extended with random genes if the path is longer.
+ * The nodes on the path are updated with the result, and marked
+ * exhausted once all their children are.
+ */
+static double explore_search_descend(struct autosa_explore_search *search,
+                                     std::vector<unsigned> &genes)
+{
+  struct autosa_explore_data *data = search->data;
+  std::vector<struct autosa_explore_node *> path;
+  struct autosa_explore_node *node;
+  double obj = -1;
+
+  node = &search->nodes[std::make_pair(-1, std::string())];
+  while (1)
+  {
+    int i;
+
+    path.push_back(node);
+    if (node->children.empty())
+      break;
+    if (path.size() > genes.size())
+      genes.push_back(search->rng());
+    i = explore_search_select(search, node, genes[path.size() - 1]);
+    if (i < 0)
+    {
+      node->exhausted = true;
+      break;
+    }
+    node = explore_search_visit(search, node->children[i]);
+  }
+
+  for (int i = node->first; i < node->last; i++)
+  {
+    double p = explore_point_objective(data, &data->points[i]);
+    if (obj < 0 || p < obj)
+      obj = p;
+  }
+  for (int j = path.size() - 1; j >= 0; j--)
+  {
+    if (obj > 0)
+    {
+      path[j]->n_obs++;
+      path[j]->sum_obs += log(obj);
+    }
+    if (j + 1 < path.size() && !path[j]->exhausted)
+    {
+      bool exhausted = true;
+      for (int k = 0; k < path[j]->children.size() && exhausted; k++)
+      {
+        std::map<std::pair<int, std::string>, struct autosa_explore_node>::iterator it;
+        it = search->nodes.find(path[j]->children[k]);
+        exhausted = it != search->nodes.end() && it->second.exhausted;
+      }
+      path[j]->exhausted = exhausted;
+    }
+  }
+
+  return obj;
+}
+
+/* Is the result "o1" of the "genetic" strategy better than "o2"?
+ * Negative results have no design point and are the worst.
+ */
+static bool explore_search_better(double o1, double o2)
+{
+  if (o1 < 0)
+    return false;
+  return o2 < 0 || o1 < o2;
+}
+
+/* Run the "genetic" strategy of "search".
+ * A genome is the sequence of the choices of the children from the root
+ * of the design space to a complete design point, i.e., of the systolic
+ * array candidate and of the tiling factors of each stage.
+ * A steady-state genetic algorithm evolves a population of genomes, where
+ * each offspring combines the choices of two parents selected by binary
+ * tournaments with a one-point crossover, and each choice is mutated with
+ * the probability of one over the length of the genome.
+ * The offspring replaces the worst genome of the population if it is
+ * better. The decoding of a genome skips the exhausted subspaces, such that
+ * the offspring that are already visited decode to new neighbours.
+ */
+static void explore_search_genetic(struct autosa_explore_search *search)
+{
+  std::vector<std::pair<double, std::vector<unsigned> > > pop;
+
+  while (pop.size() < AUTOSA_EXPLORE_POPULATION && !explore_search_done(search))
+  {
+    std::vector<unsigned> genes;
+    double obj = explore_search_descend(search, genes);
+    pop.push_back(std::make_pair(obj, genes));
+  }
+  if (pop.size() < 2)
+    return;
+
+  while (!explore_search_done(search))
+  {
+    std::vector<unsigned> parents[2], child;
+    int cut, worst = 0;
+    double obj;
+
+    for (int k = 0; k < 2; k++)
+    {
+      int a = search->rng() % pop.size();
+      int b = search->rng() % pop.size();
+      parents[k] = explore_search_better(pop[b].first, pop[a].first) ?
+                   pop[b].second : pop[a].second;
+    }
+    cut = 1 + search->rng() % max((int)parents[0].size(), 1);
+    for (int i = 0; i < parents[0].size() && i < cut; i++)
+      child.push_back(parents[0][i]);
+    for (int i = child.size(); i < parents[1].size(); i++)
+      child.push_back(parents[1][i]);
+    for (int i = 0; i < child.size(); i++)
+    {
+      if (search->rng() % child.size() == 0)
+        child[i] = search->rng();
+    }
+    obj = explore_search_descend(search, child);
+    for (int i = 1; i < pop.size(); i++)
+    {
+      if (explore_search_better(pop[worst].first, pop[i].first))
+        worst = i;
+    }
+    if (explore_search_better(obj, pop[worst].first))
+      pop[worst] = std::make_pair(obj, child);
+  }
+}
+
+/* Sample the design space from the systolic array candidates "roots" with
+ * the sampling search strategy of "--AutoSA-explore-strategy", until
+ * "budget" (partial) design points are evaluated, or until the time
+ * budget of "--AutoSA-explore-time" (in seconds) is used up, or until all
+ * the design points are visited. "seed" initializes the random numbers.
+ *
+ * Instead of enumerating every combination of the tiling factors, each
+ * sample descends from a systolic array candidate to a complete design
+ * point by selecting one expansion at each stage:
+ * - "random" selects the expansions uniformly at random,
+ * - "genetic" evolves the sequences of selections, see
+ *   explore_search_genetic,
+ * - "bayes" selects the expansions by Thompson sampling over a Bayesian
+ *   model of the latency, with the lower bounds of the cost model as prior,
+ *   see explore_search_select.
+ * The evaluated partial design points are kept, such that the common
+ * prefixes of the samples are only evaluated once, and the branch-and-bound
+ * pruning of explore_prune_point still applies.
+ */
+static void explore_search(struct autosa_explore_data *data,
+                           const std::vector<std::pair<int, std::string> > &roots,
+                           int seed, int budget)
+{
+  struct autosa_explore_search search;
+  struct autosa_explore_node *root;
+  int explore_time = data->gen->options->autosa->explore_time;
+
+  search.data = data;
+  search.strategy = data->gen->options->autosa->explore_strategy;
+  search.rng.seed(seed);
+  search.budget = data->n_eval + budget;
+  search.deadline = explore_time > 0 ? time(NULL) + explore_time : 0;
+  root = &search.nodes[std::make_pair(-1, std::string())];
+  root->expanded = true;
+  root->children = roots;
+  root->exhausted = roots.empty();
+
+  if (search.strategy == "genetic")
+  {
+    explore_search_genetic(&search);
+  }
+  else
+  {
+    while (!explore_search_done(&search))
+    {
+      std::vector<unsigned> genes;
+      explore_search_descend(&search, genes);
+    }
+  }
+  if (root->exhausted)
+    printf("[AutoSA] The design space is completely visited.\n");
+}
+
+/* Return the path of the file "name" under the output directory. */
+static std::string explore_output_path(struct autosa_gen *gen, const std::string &name)
+{
+  return std::string(gen->options->autosa->output_dir) + "/" + name;
+}
+
+/* Write the JSON object "json" to the file "path". */
+static isl_stat explore_write_json(const std::string &path, cJSON *json)
+{
+  FILE *fp;
+  char *content;
+
+  fp = fopen(path.c_str(), "w");
+  if (!fp)
+  {
+    printf("[AutoSA] Error: Cannot open file: %s\n", path.c_str());
+    return isl_stat_error;
+  }
+  content = cJSON_Print(json);
+  fprintf(fp, "%s", content);
+  fclose(fp);
+  free(content);
+
+  return isl_stat_ok;
+}
+
+/* Read the JSON object from the file "path".
+ * Return NULL if the file cannot be read.
+ */
+static cJSON *explore_read_json(const std::string &path)
+{
+  FILE *fp;
+  char *buffer;
+  long length;
+  cJSON *json;
+
+  fp = fopen(path.c_str(), "rb");
+  if (!fp)
+    return NULL;
+  fseek(fp, 0, SEEK_END);
+  length = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  buffer = (char *)malloc(length + 1);
+  if (!buffer)
+  {
+    fclose(fp);
+    return NULL;
+  }
+  buffer[fread(buffer, 1, length, fp)] = '\0';
+  fclose(fp);
+  json = cJSON_Parse(buffer);
+  free(buffer);
+
+  return json;
+}
+
+/* Explore the partial design points in "frontier" using "n_jobs" worker
+ * processes.
+ * isl contexts are not thread-safe, so each worker is forked from
+ * the current process and works on its own copy of the isl context,
+ * the scop and the dependences.
+ * The partial design points are distributed to the workers in
+ * a round-robin manner. Each worker explores its share of the design space
+ * in a depth-first manner and dumps out the design points to
+ * "explore_<id>.json" under the output directory, which are then merged
+ * into "data" once all the workers finish.
+ * The files left over by an earlier run are removed before the workers are
+ * forked, and only the files of the workers that exit successfully are
+ * merged.
+ * If "budget" is positive, each worker instead samples the whole design
+ * space from "frontier" with its own random numbers and its share of
+ * the budget, see explore_search.
+ */
+static isl_stat explore_parallel(struct autosa_explore_data *data,
+                                 std::vector<std::pair<int, std::string> > &frontier,
+                                 int n_jobs, int max_points, int budget = 0)
+{
+  std::vector<pid_t> workers;
+  int worker_max_points = 0;
+
+  if (max_points > 0)
+    worker_max_points = (max_points + n_jobs - 1) / n_jobs;
+
+  for (int id = 0; id < n_jobs; id++)
+    remove(explore_output_path(data->gen,
+                               "explore_" + std::to_string(id) + ".json").c_str());
+
+  fflush(stdout);
+  for (int id = 0; id < n_jobs; id++)
+  {
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+      printf("[AutoSA] Error: Failed to fork the exploration worker.\n");
+      break;
+    }
+    if (pid == 0)
+    {
+      std::vector<std::pair<int, std::string> > stack;
+      cJSON *points_json;
+      /* The design points recorded so far are kept for the pruning. */
+      int first = data->points.size();
+      isl_stat r;
+
+      if (!data->gen->options->autosa->verbose &&
+          !freopen("/dev/null", "w", stdout))
+        _exit(1);
+      if (budget > 0)
+      {
+        explore_search(data, frontier, id, (budget + n_jobs - 1) / n_jobs);
+      }
+      else
+      {
+        for (int i = frontier.size() - 1; i >= 0; i--)
+          if (i % n_jobs == id)
+            stack.push_back(frontier[i]);
+        explore_dfs(data, stack,
+                    worker_max_points > 0 ? first + worker_max_points : 0);
+      }
+
+      points_json = cJSON_CreateArray();
+      for (int i = first; i < data->points.size(); i++)
+        cJSON_AddItemToArray(points_json, explore_point_to_json(&data->points[i]));
+      r = explore_write_json(explore_output_path(data->gen,
+                                                 "explore_" + std::to_string(id) + ".json"),
+                             points_json);
+      _exit(r < 0 ? 1 : 0);
+    }
+    workers.push_back(pid);
+  }
+
+  for (int id = 0; id < workers.size(); id++)
+  {
+    int status;
+    std::string path;
+    cJSON *points_json, *point_json;
+
+    path = explore_output_path(data->gen, "explore_" + std::to_string(id) + ".json");
+    if (waitpid(workers[id], &status, 0) < 0 || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0)
+    {
+      printf("[AutoSA] Warning: Exploration worker %d failed, its design points are skipped.\n", id);
+      remove(path.c_str());
+      continue;
+    }
+    points_json = explore_read_json(path);
+    if (!points_json)
+    {
+      printf("[AutoSA] Warning: Exploration worker %d failed.\n", id);
+      continue;
+    }
+    cJSON_ArrayForEach(point_json, points_json)
+    {
+      data->points.push_back(explore_point_from_json(point_json));
+    }
+    cJSON_Delete(points_json);
+    remove(path.c_str());
+  }
+
+  if (workers.size() == 0)
+    return isl_stat_error;
+
+  return isl_stat_ok;
+}
+
+/* Set up the process heap for the exploration in "gen".
+ *
+ * Every design point builds and frees a large number of small isl objects
+ * (the kernel copy, the access relations, the tiles of the I/O buffers).
+ * With --AutoSA-explore-arena, the freed memory is kept in a single
+ * malloc arena, which is never trimmed, and the large objects are
+ * allocated from the heap instead of being mapped each time,
+ * such that the next design point is served from the warm heap without
+ * system calls or page faults.
+ * The forked exploration workers inherit the warm heap, which is released
+ * as a whole when they exit.
+ */
+static void explore_setup_arena(struct autosa_gen *gen)
+{
+  if (!gen->options->autosa->explore_arena)
+    return;
+#ifdef __GLIBC__
+  mallopt(M_ARENA_MAX, 1);
+  mallopt(M_MMAP_THRESHOLD, 64 * 1024 * 1024);
+  mallopt(M_TRIM_THRESHOLD, -1);
+  mallopt(M_TOP_PAD, 16 * 1024 * 1024);
+#else
+  printf("[AutoSA] Warning: --AutoSA-explore-arena is only supported with glibc.\n");
+#endif
+}
+
+/* The features of a design point used by the learned cost model,
+ * see autosa_scripts/train_cost_model.py, which computes the same features
+ * from the design points dumped in "tuning.json".
+ */
+static const char *cost_model_features[] = {
+    "n_pe", "simd", "latency_hide_len", "sa_dim0", "sa_dim1", "sa_dim2",
+    "io_chain", "log_latency", "DSP", "BRAM18K", "URAM", "log_DRAM_bytes"};
+
+#define N_COST_MODEL_FEATURES \
+  (sizeof(cost_model_features) / sizeof(cost_model_features[0]))
+
+/* A regression tree of the learned cost model.
+ * Node "i" is a leaf with the value "value[i]" if "left[i]" is negative.
+ * Otherwise, the evaluation continues with the node "left[i]" if
+ * the feature "feature[i]" is at most "threshold[i]", and with the node
+ * "right[i]" otherwise.
+ */
+struct autosa_cost_model_tree
+{
+  std::vector<int> feature;
+  std::vector<double> threshold;
+  std::vector<int> left;
+  std::vector<int> right;
+  std::vector<double> value;
+};
+
+/* The gradient-boosted trees that predict the logarithm of the ratio of
+ * the measured value of an objective to its analytic estimate, i.e.,
+ * "base" plus "rate" times the sum of the values of the trees.
+ */
+struct autosa_cost_model_target
+{
+  bool valid;
+  double base;
+  double rate;
+  std::vector<struct autosa_cost_model_tree> trees;
+};
+
+/* The learned cost model.
+ * "feature_map" maps the features of the model to the indices in
+ * cost_model_features.
+ */
+struct autosa_cost_model
+{
+  std::vector<int> feature_map;
+  struct autosa_cost_model_target latency;
+  struct autosa_cost_model_target dsp;
+  struct autosa_cost_model_target bram18k;
+  struct autosa_cost_model_target uram;
+};
+
+/* Compute the features of the design point "point" in "f",
+ * in the order of cost_model_features.
+ */
+static void cost_model_point_features(struct autosa_explore_point *point,
+                                      double *f)
+{
+  int chain = 1;
+
+  f[0] = point->n_pe;
+  f[1] = point->simd_w;
+  f[2] = point->lat_hide_len;
+  for (int i = 0; i < 3; i++)
+  {
+    f[3 + i] = i < point->n_sa_dim ? point->sa_dim[i] : 0;
+    if (i < point->n_sa_dim)
+      chain = max(chain, point->sa_dim[i]);
+  }
+  f[6] = chain;
+  f[7] = log(max(point->latency, 1.0));
+  f[8] = point->dsp;
+  f[9] = point->bram18k;
+  f[10] = point->uram;
+  f[11] = log(max(point->dram_bytes, 1.0));
+}
+
+/* Read the numbers of the JSON array "json" into "v".
+ * Return false if "json" is not an array of numbers.
+ */
+template <typename T>
+static bool cost_model_read_array(cJSON *json, std::vector<T> &v)
+{
+  cJSON *item;
+
+  if (!cJSON_IsArray(json))
+    return false;
+  cJSON_ArrayForEach(item, json)
+  {
+    if (!cJSON_IsNumber(item))
+      return false;
+    v.push_back((T)item->valuedouble);
+  }
+
+  return true;
+}
+
+/* Read the target "name" of the learned cost model from "targets".
+ * The target is left invalid if it is not in the model.
+ * Return false if the target is malformed.
+ */
+static bool cost_model_read_target(cJSON *targets, const char *name,
+                                   int n_feature,
+                                   struct autosa_cost_model_target *target)
+{
+  cJSON *target_json, *trees_json, *tree_json, *item;
+
+  target->valid = false;
+  target_json = cJSON_GetObjectItemCaseSensitive(targets, name);
+  if (!target_json)
+    return true;
+  item = cJSON_GetObjectItemCaseSensitive(target_json, "base");
+  if (!cJSON_IsNumber(item))
+    return false;
+  target->base = item->valuedouble;
+  item = cJSON_GetObjectItemCaseSensitive(target_json, "learning_rate");
+  if (!cJSON_IsNumber(item))
+    return false;
+  target->rate = item->valuedouble;
+  trees_json = cJSON_GetObjectItemCaseSensitive(target_json, "trees");
+  cJSON_ArrayForEach(tree_json, trees_json)
+  {
+    struct autosa_cost_model_tree tree;
+    int n;
+
+    if (!cost_model_read_array(cJSON_GetObjectItemCaseSensitive(tree_json, "feature"), tree.feature) ||
+        !cost_model_read_array(cJSON_GetObjectItemCaseSensitive(tree_json, "threshold"), tree.threshold) ||
+        !cost_model_read_array(cJSON_GetObjectItemCaseSensitive(tree_json, "left"), tree.left) ||
+        !cost_model_read_array(cJSON_GetObjectItemCaseSensitive(tree_json, "right"), tree.right) ||
+        !cost_model_read_array(cJSON_GetObjectItemCaseSensitive(tree_json, "value"), tree.value))
+      return false;
+    n = tree.value.size();
+    if (n == 0 || tree.feature.size() != n || tree.threshold.size() != n ||
+        tree.left.size() != n || tree.right.size() != n)
+      return false;
+    /* The children follow their parents, such that the evaluation of
+     * a well-formed tree terminates. */
+    for (int i = 0; i < n; i++)
+    {
+      if (tree.left[i] < 0)
+        continue;
+      if (tree.left[i] <= i || tree.left[i] >= n || tree.right[i] <= i ||
+          tree.right[i] >= n || tree.feature[i] < 0 ||
+          tree.feature[i] >= n_feature)
+        return false;
+    }
+    target->trees.push_back(tree);
+  }
+  target->valid = true;
+
+  return true;
+}
+
+/* Load the learned cost model from the file "path" into "model".
+ * Return false if the model can't be read.
+ */
+static bool cost_model_load(const char *path, struct autosa_cost_model *model)
+{
+  cJSON *json, *features_json, *feature, *targets;
+  bool ok = true;
+
+  json = explore_read_json(path);
+  if (!json)
+  {
+    printf("[AutoSA] Warning: Can't read the cost model: %s\n", path);
+    return false;
+  }
+  features_json = cJSON_GetObjectItemCaseSensitive(json, "features");
+  cJSON_ArrayForEach(feature, features_json)
+  {
+    int i;
+
+    for (i = 0; i < N_COST_MODEL_FEATURES; i++)
+    {
+      if (cJSON_IsString(feature) &&
+          !strcmp(feature->valuestring, cost_model_features[i]))
+        break;
+    }
+    if (i == N_COST_MODEL_FEATURES)
+    {
+      printf("[AutoSA] Warning: Unknown feature in the cost model: %s\n",
+             cJSON_IsString(feature) ? feature->valuestring : "");
+      ok = false;
+      break;
+    }
+    model->feature_map.push_back(i);
+  }
+  targets = cJSON_GetObjectItemCaseSensitive(json, "targets");
+  if (ok)
+    ok = cost_model_read_target(targets, "latency", model->feature_map.size(),
+                                &model->latency) &&
+         cost_model_read_target(targets, "DSP", model->feature_map.size(),
+                                &model->dsp) &&
+         cost_model_read_target(targets, "BRAM18K", model->feature_map.size(),
+                                &model->bram18k) &&
+         cost_model_read_target(targets, "URAM", model->feature_map.size(),
+                                &model->uram);
+  if (!ok)
+    printf("[AutoSA] Warning: Malformed cost model: %s\n", path);
+  cJSON_Delete(json);
+
+  return ok;
+}
+
+/* Return the correction factor of the target "target" of the learned cost
+ * model "model" for the design point with the features "f".
+ */
+static double cost_model_predict(struct autosa_cost_model *model,
+                                 struct autosa_cost_model_target *target, double *f)
+{
+  double sum = 0;
+
+  if (!target->valid)
+    return 1;
+  for (int t = 0; t < target->trees.size(); t++)
+  {
+    struct autosa_cost_model_tree *tree = &target->trees[t];
+    int i = 0;
+
+    while (tree->left[i] >= 0)
+    {
+      double x = f[model->feature_map[tree->feature[i]]];
+      i = x <= tree->threshold[i] ? tree->left[i] : tree->right[i];
+    }
+    sum += tree->value[i];
+  }
+
+  return exp(target->base + target->rate * sum);
+}
+
+/* Correct the analytic estimates of the design points in "data" with
+ * the learned cost model of "--AutoSA-cost-model", trained on the measured
+ * results of earlier designs.
+ * The exploration itself (the pruning and the resource limits) uses
+ * the analytic estimates, which the learned model only rescores, and which
+ * are kept in the design points as the features of the next training.
+ * Return false if the model can't be applied.
+ */
+static bool explore_apply_cost_model(struct autosa_explore_data *data)
+{
+  struct autosa_cost_model model;
+
+  if (!cost_model_load(data->gen->options->autosa->cost_model, &model))
+    return false;
+
+  for (int i = 0; i < data->points.size(); i++)
+  {
+    struct autosa_explore_point *p = &data->points[i];
+    double f[N_COST_MODEL_FEATURES];
+    double r;
+
+    cost_model_point_features(p, f);
+    p->corrected = 1;
+    p->analytic_latency = p->latency;
+    p->analytic_dsp = p->dsp;
+    p->analytic_bram18k = p->bram18k;
+    p->analytic_uram = p->uram;
+    r = cost_model_predict(&model, &model.latency, f);
+    p->latency *= r;
+    p->first_latency *= r;
+    p->last_latency *= r;
+    p->dsp = (long)ceil(p->dsp * cost_model_predict(&model, &model.dsp, f));
+    p->bram18k = (long)ceil(p->bram18k *
+                            cost_model_predict(&model, &model.bram18k, f));
+    p->uram = (long)ceil(p->uram * cost_model_predict(&model, &model.uram, f));
+  }
+  printf("[AutoSA] Rescore the design points with the cost model %s.\n",
+         data->gen->options->autosa->cost_model);
+
+  return true;
+}
+
+/* Compare two design points for ranking.
+ * For now, we prefer the design with the higher computation parallelism,
+ * i.e., the number of PEs times the SIMD factor.
+ */
+static bool explore_point_cmp(const struct autosa_explore_point &p1,
+                              const struct autosa_explore_point &p2)
+{
+  return (long)p1.n_pe * p1.simd_w > (long)p2.n_pe * p2.simd_w;
+}
+
+/* Compare two design points for ranking with "--AutoSA-batch1".
+ * We prefer the design with the lower latency of the last result of
+ * a single request, and then the smaller design.
+ */
+static bool explore_point_batch1_cmp(const struct autosa_explore_point &p1,
+                                     const struct autosa_explore_point &p2)
+{
+  if (p1.last_latency != p2.last_latency)
+    return p1.last_latency < p2.last_latency;
+  return p1.dsp < p2.dsp;
+}
+
+/* Compare two design points for ranking with the learned cost model.
+ * We prefer the design with the lower corrected latency, and then
+ * the smaller design.
+ */
+static bool explore_point_model_cmp(const struct autosa_explore_point &p1,
+                                    const struct autosa_explore_point &p2)
+{
+  if (p1.latency != p2.latency)
+    return p1.latency < p2.latency;
+  return p1.dsp < p2.dsp;
+}
+
+/* Does the design point "p1" dominate "p2", i.e., is "p1" no worse than
+ * "p2" in all the objectives (latency, DSP, BRAM, URAM and off-chip traffic)
+ * and strictly better in at least one of them?
+ */
+static bool explore_point_dominates(const struct autosa_explore_point &p1,
+                                    const struct autosa_explore_point &p2)
+{
+  if (p1.latency > p2.latency || p1.dsp > p2.dsp ||
+      p1.bram18k > p2.bram18k || p1.uram > p2.uram ||
+      p1.dram_bytes > p2.dram_bytes)
+    return false;
+
+  return p1.latency < p2.latency || p1.dsp < p2.dsp ||
+         p1.bram18k < p2.bram18k || p1.uram < p2.uram ||
+         p1.dram_bytes < p2.dram_bytes;
+}
+
+static bool explore_point_same_objectives(const struct autosa_explore_point &p1,
+                                         const struct autosa_explore_point &p2)
+{
+  return p1.latency == p2.latency && p1.dsp == p2.dsp &&
+         p1.bram18k == p2.bram18k && p1.uram == p2.uram &&
+         p1.dram_bytes == p2.dram_bytes;
+}
+
+static bool explore_point_latency_cmp(const struct autosa_explore_point *p1,
+                                      const struct autosa_explore_point *p2)
+{
+  return p1->latency < p2->latency;
+}
+
+/* Collect the design points on the Pareto front of "points",
+ * sorted by the estimated latency.
+ * Design points with the same objectives are only kept once.
+ */
+static std::vector<struct autosa_explore_point *> explore_pareto_front(
+    std::vector<struct autosa_explore_point> &points)
+{
+  std::vector<struct autosa_explore_point *> front;
+
+  for (int i = 0; i < points.size(); i++)
+  {
+    bool dominated = false;
+    for (int j = 0; j < points.size() && !dominated; j++)
+    {
+      if (explore_point_dominates(points[j], points[i]))
+        dominated = true;
+      else if (j < i && explore_point_same_objectives(points[j], points[i]))
+        dominated = true;
+    }
+    if (!dominated)
+      front.push_back(&points[i]);
+  }
+  std::stable_sort(front.begin(), front.end(), &explore_point_latency_cmp);
+
+  return front;
+}
+
+/* Dump out all the ranked design points and the Pareto front of the design
+ * points into "tuning.json" under the output directory.
+ * The design points on the Pareto front are printed with the "--sa-sizes"
+ * option that reproduces them.
+ */
+static isl_stat explore_dump_points(struct autosa_explore_data *data)
+{
+  cJSON *tuning, *explore_json, *points_json, *pareto_json;
+  std::vector<struct autosa_explore_point *> front;
+  isl_stat r;
+
+  tuning = cJSON_CreateObject();
+  explore_json = cJSON_CreateObject();
+  cJSON_AddItemToObject(tuning, "explore", explore_json);
+  cJSON_AddNumberToObject(explore_json, "n_points", data->points.size());
+  points_json = cJSON_CreateArray();
+  cJSON_AddItemToObject(explore_json, "points", points_json);
+  for (int i = 0; i < data->points.size(); i++)
+    cJSON_AddItemToArray(points_json, explore_point_to_json(&data->points[i]));
+  front = explore_pareto_front(data->points);
+  pareto_json = cJSON_CreateArray();
+  cJSON_AddItemToObject(explore_json, "pareto", pareto_json);
+  for (int i = 0; i < front.size(); i++)
+    cJSON_AddItemToArray(pareto_json, explore_point_to_json(front[i], true));
+  printf("[AutoSA] %d design points on the Pareto front.\n", (int)front.size());
+
+  r = explore_write_json(explore_output_path(data->gen, "tuning.json"), tuning);
+  cJSON_Delete(tuning);
+
+  return r;
+}
+
+/* Return the amount of the resource "name" in "hw_info" available under
+ * the resource utilization target, or -1 if unknown.
+ */
+static double explore_resource_limit(struct autosa_gen *gen, cJSON *hw_info,
+                                     const char *name)
+{
+  cJSON *item = cJSON_GetObjectItemCaseSensitive(hw_info, name);
+
+  if (!cJSON_IsNumber(item))
+    return -1;
+
+  return item->valuedouble * gen->options->autosa->resource_target / 100;
+}
+
+/* Explore the design space of the program with the schedule "schedule"
+ * in-process.
+ * We first generate all the systolic array candidates using the space-time
+ * transformation. Then, starting from each candidate, we apply the PE
+ * optimization stages enabled in the tuning configuration. Whenever a stage
+ * misses the tiling factors, instead of exiting the program, we enumerate
+ * the tiling factors of this stage and continue with each new design point
+ * in a depth-first manner, until all the stages are resolved.
+ * At most "explore_max_points" design points are explored.
+ * Partial design points are pruned using a branch-and-bound approach,
+ * see explore_prune_point.
+ *
+ * If "explore_jobs" is greater than one, the partial design points are first
+ * expanded breadth-first to have enough work for all the workers, and
+ * are then explored by the worker processes in parallel.
+ * With "--AutoSA-explore-strategy" other than "exhaustive", the design
+ * space is sampled within "--AutoSA-explore-budget" evaluations instead,
+ * see explore_search.
+ * With "--AutoSA-explore-journal", the exploration resumes from
+ * the design points journaled by a previous run, see explore_journal_open.
+ *
+ * All the design points are ranked and dumped out to "tuning.json", together
+ * with the Pareto front over the estimated latency, resource usage and
+ * off-chip traffic. With "--AutoSA-batch1", the design points are ranked
+ * by the latency of a single request instead of the parallelism.
+ * With "--AutoSA-cost-model", the estimates of the design points are first
+ * corrected by the learned cost model, and the design points are ranked by
+ * the corrected latency.
+ * The tiling factors of the best design point are then used to update the
+ * "--sa-sizes" option, and all the stages are switched to the manual mode,
+ * so that the regular compilation flow proceeds with the selected design.
+ */
+isl_stat sa_explore(struct autosa_gen *gen, __isl_keep isl_schedule *schedule)
+{
+  struct autosa_explore_data data;
+  std::vector<std::pair<int, std::string> > frontier;
+  int max_points = gen->options->autosa->explore_max_points;
+  int n_jobs = gen->options->autosa->explore_jobs;
+  cJSON *config = gen->tuning_config;
+  char *strategy = gen->options->autosa->explore_strategy;
+  bool model;
+
+  printf("[AutoSA] Explore the design space.\n");
+  if (strategy && strcmp(strategy, "exhaustive") && strcmp(strategy, "random") &&
+      strcmp(strategy, "genetic") && strcmp(strategy, "bayes"))
+  {
+    printf("[AutoSA] Warning: Unknown exploration strategy %s, "
+           "the design space is explored exhaustively.\n", strategy);
+    strategy = NULL;
+  }
+  explore_setup_arena(gen);
+  data.gen = gen;
+  data.n_eval = 0;
+  data.n_pruned = 0;
+  data.n_resumed = 0;
+  data.hw_info = NULL;
+  if (gen->options->autosa->hw_info)
+    data.hw_info = explore_read_json(gen->options->autosa->hw_info);
+  data.dsp_limit = explore_resource_limit(gen, data.hw_info, "DSP");
+  data.bram_limit = explore_resource_limit(gen, data.hw_info, "BRAM");
+  data.uram_limit = explore_resource_limit(gen, data.hw_info, "URAM");
+  explore_journal_open(&data, schedule);
+  data.schedule = schedule;
+  data.sa = NULL;
+  data.sa_id = -1;
+  data.sa_candidates = sa_space_time_transform(schedule, gen->prog->scop,
+                                               &data.num_sa);
+  sa_conv_filter_candidates(schedule, gen->prog->scop, data.sa_candidates,
+                            &data.num_sa);
+  data.pe_opt_en[0] = explore_stage_enabled(config, "array_part");
+  data.pe_opt_en[1] = explore_stage_enabled(config, "array_part_L2");
+  data.pe_opt_en[2] = explore_stage_enabled(config, "latency");
+  data.pe_opt_en[3] = explore_stage_enabled(config, "simd");
+  for (int i = 0; i < 4; i++)
+    data.pe_opt_mode[i] = (char *)"manual";
+  if (data.num_sa > 0)
+    explore_lane_resource(explore_candidate(&data, 0), &data.lane);
+
+  for (int i = 0; i < data.num_sa; i++)
+    frontier.push_back(std::make_pair(i,
+                                      "kernel[0]->space_time[" + std::to_string(i) + "]"));
+
+  if (strategy && strcmp(strategy, "exhaustive"))
+  {
+    int budget = gen->options->autosa->explore_budget;
+
+    printf("[AutoSA] Explore the design space with the %s strategy "
+           "(budget: %d evaluations).\n", strategy, budget);
+    if (n_jobs > 1)
+    {
+      printf("[AutoSA] Explore the design space with %d jobs.\n", n_jobs);
+      explore_parallel(&data, frontier, n_jobs, max_points, max(budget, 1));
+    }
+    else
+    {
+      explore_search(&data, frontier, 0, max(budget, 1));
+      printf("[AutoSA] %d (partial) design points evaluated.\n", data.n_eval);
+    }
+  }
+  else if (n_jobs > 1)
+  {
+    printf("[AutoSA] Explore the design space with %d jobs.\n", n_jobs);
+    explore_bfs(&data, frontier, 4 * n_jobs);
+    if (!frontier.empty())
+      explore_parallel(&data, frontier, n_jobs, max_points);
+  }
+  else
+  {
+    std::reverse(frontier.begin(), frontier.end());
+    explore_dfs(&data, frontier, max_points);
+  }
+
+  autosa_kernel_free(data.sa);
+  free(data.sa_candidates);
+  cJSON_Delete(data.hw_info);
+  if (data.journal >= 0)
+    close(data.journal);
+
+  printf("[AutoSA] %d design points explored.\n", (int)data.points.size());
+  if (data.n_pruned > 0)
+    printf("[AutoSA] %d design points pruned.\n", data.n_pruned);
+  if (data.n_resumed > 0)
+    printf("[AutoSA] %d (partial) design points replayed from the journal.\n",
+           data.n_resumed);
+  if (data.points.size() == 0)
+  {
+    printf("[AutoSA] Warning: No legal design point found.\n");
+    return isl_stat_error;
+  }
+
+  model = gen->options->autosa->cost_model &&
+          explore_apply_cost_model(&data);
+  if (gen->options->autosa->batch1)
+    std::stable_sort(data.points.begin(), data.points.end(),
+                     &explore_point_batch1_cmp);
+  else if (model)
+    std::stable_sort(data.points.begin(), data.points.end(),
+                     &explore_point_model_cmp);
+  else
+    std::stable_sort(data.points.begin(), data.points.end(), &explore_point_cmp);
+  explore_dump_points(&data);
+
+  /* Proceed with the best design point. */
+  printf("[AutoSA] Select the design: {%s}\n", data.points[0].sa_sizes);
+  if (gen->options->autosa->batch1)
+    printf("[AutoSA] Estimated latency of a single request: %.0f cycles to the first result, %.0f cycles to the last result.\n",
+           data.points[0].first_latency, data.points[0].last_latency);
+  free(gen->options->autosa->sa_sizes);
+  gen->options->autosa->sa_sizes = strdup(
+      ("{" + std::string(data.points[0].sa_sizes) + "}").c_str());
+  explore_set_manual_mode(config, "space_time");
+  explore_set_manual_mode(config, "array_part");
+  explore_set_manual_mode(config, "array_part_L2");
+  explore_set_manual_mode(config, "latency");
+  explore_set_manual_mode(config, "simd");
+
+  for (int i = 0; i < data.points.size(); i++)
+    free(data.points[i].sa_sizes);
+
+  return isl_stat_ok;
+}
@@ -0,0 +1,55 @@
+/* Defines functions for the in-process design space exploration in AutoSA. */
+
+#ifndef _AUTOSA_EXPLORE_H
+#define _AUTOSA_EXPLORE_H
+
+#include "autosa_common.h"
+
+/* A design point evaluated during the design space exploration.
+ * "sa_sizes" contains the tiling factors of the design in the format of
+ * the "--sa-sizes" option, without the enclosing braces.
+ * "kernel_id" is the sequence number of the systolic array candidate
+ * generated by the space-time transformation.
+ */
+struct autosa_explore_point
+{
+  char *sa_sizes;
+  int kernel_id;
+
+  int n_sa_dim;
+  int sa_dim[3];
+  int simd_w;
+  int lat_hide_len;
+  /* Total number of PEs in the array. */
+  int n_pe;
+
+  /* Estimated latency in cycles. With "--AutoSA-batch1", this is the
+   * latency of the last result of a single request. */
+  double latency;
+  /* Estimated cycles until the first and the last result of a single
+   * request leave the array. */
+  double first_latency;
+  double last_latency;
+  /* Estimated resource usage. */
+  long dsp;
+  long bram18k;
+  long uram;
+  /* Estimated off-chip traffic in bytes. */
+  double dram_bytes;
+  /* Estimated cycles of the host-device transfers of a request,
+   * included in the latencies above. */
+  double transfer_latency;
+
+  /* Set if the estimates above are corrected by the learned cost model
+   * (--AutoSA-cost-model), in which case the analytic estimates are kept
+   * below. */
+  int corrected;
+  double analytic_latency;
+  long analytic_dsp;
+  long analytic_bram18k;
+  long analytic_uram;
+};
+
+isl_stat sa_explore(struct autosa_gen *gen, __isl_keep isl_schedule *schedule);
+
+#endif
@@ -1,3 +1,9 @@
+#include <sys/stat.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
 #include <isl/ctx.h>
 
 #include "autosa_intel_opencl.h"
@@ -6,6 +12,7 @@
 #include "autosa_trans.h"
 #include "autosa_codegen.h"
 #include "autosa_utils.h"
+#include "autosa_top_gen.h"
 
 struct print_host_user_data
 {
@@ -162,9 +169,301 @@ static void opencl_open_files(struct hls_info *info, const char *input)
   free(file_path);
 }
 
-/* Close all output files. 
+/* Read the lines of the file "path", with the line breaks.
+ */
+static std::vector<std::string> read_lines(const char *path)
+{
+  std::vector<std::string> lines;
+  std::string line;
+  FILE *fp;
+  int c;
+
+  fp = fopen(path, "r");
+  if (!fp)
+    return lines;
+  while ((c = fgetc(fp)) != EOF)
+  {
+    line += (char)c;
+    if (c == '\n')
+    {
+      lines.push_back(line);
+      line.clear();
+    }
+  }
+  if (!line.empty())
+    lines.push_back(line);
+  fclose(fp);
+
+  return lines;
+}
+
+/* Return "s" without the leading and trailing white spaces.
+ */
+static std::string strip(const std::string &s)
+{
+  size_t start = s.find_first_not_of(" \t\r\n");
+  size_t end = s.find_last_not_of(" \t\r\n");
+
+  if (start == std::string::npos)
+    return "";
+  return s.substr(start, end - start + 1);
+}
+
+static bool is_ident_char(char c)
+{
+  return isalnum((unsigned char)c) || c == '_';
+}
+
+/* Replace the occurrences of the identifier "from" in "line" by "to".
+ */
+static std::string replace_ident(const std::string &line,
+                                 const std::string &from, const std::string &to)
+{
+  std::string s = line;
+  size_t pos = 0;
+
+  while ((pos = s.find(from, pos)) != std::string::npos)
+  {
+    size_t end = pos + from.size();
+    if ((pos > 0 && is_ident_char(s[pos - 1])) ||
+        (end < s.size() && is_ident_char(s[end])))
+    {
+      pos = end;
+      continue;
+    }
+    s.replace(pos, from.size(), to);
+    pos += to.size();
+  }
+
+  return s;
+}
+
+/* Extract the arguments of the module definition line "line",
+ * i.e., the comma-separated list between the first pair of parentheses.
+ */
+static std::vector<std::string> extract_def_args(const std::string &line)
+{
+  std::vector<std::string> args;
+  size_t start = line.find('(');
+  size_t end = start == std::string::npos ? start : line.find(')', start);
+
+  if (end == std::string::npos || end == start + 1)
+    return args;
+  std::string list = line.substr(start + 1, end - start - 1);
+  start = 0;
+  while (1)
+  {
+    end = list.find(", ", start);
+    args.push_back(list.substr(start, end == std::string::npos ? end : end - start));
+    if (end == std::string::npos)
+      break;
+    start = end + 2;
+  }
+
+  return args;
+}
+
+/* Collect the lines of "lines" enclosed by pairs of lines containing
+ * "marker" into "blocks", one block per pair.
+ * If "trim" is set, the white spaces around the lines are removed.
+ */
+static void collect_marked_blocks(const std::vector<std::string> &lines,
+                                  const char *marker, int trim,
+                                  std::vector<std::vector<std::string> > &blocks)
+{
+  bool add = false;
+
+  for (size_t i = 0; i < lines.size(); i++)
+  {
+    if (lines[i].find(marker) != std::string::npos)
+    {
+      if (!add)
+        blocks.push_back(std::vector<std::string>());
+      add = !add;
+      continue;
+    }
+    if (add)
+      blocks.back().push_back(trim ? strip(lines[i]) : lines[i]);
+  }
+}
+
+/* Print the definition "def" of the module called by "call" to "fp".
+ * Each argument of the call is preceded by a comment with its type.
+ * The module id and fifo arguments are removed from the definition, and
+ * their uses in the module id initialization and in the channel accesses
+ * are replaced by the arguments of the call.
+ */
+static void print_inlined_module_def(FILE *fp,
+                                     const std::vector<std::string> &def,
+                                     const std::vector<std::string> &call)
+{
+  std::vector<std::string> def_args, call_args, call_types;
+  std::map<std::string, std::string> id_map, fifo_map;
+
+  for (size_t i = 0; i < def.size(); i++)
+  {
+    if (def[i].find("void") == std::string::npos)
+      continue;
+    std::vector<std::string> args = extract_def_args(def[i]);
+    def_args.clear();
+    for (size_t j = 0; j < args.size(); j++)
+    {
+      std::string arg = strip(args[j]);
+      size_t pos = arg.find_last_of(" \t*");
+      def_args.push_back(pos == std::string::npos ? arg : arg.substr(pos + 1));
+    }
+  }
+  for (size_t i = 0; i < call.size(); i++)
+  {
+    size_t start = call[i].find("/*");
+    size_t end = start == std::string::npos ? start : call[i].find("*/", start);
+    if (end == std::string::npos)
+      continue;
+    std::string arg = strip(call[i].substr(end + 2));
+    while (!arg.empty() && arg[arg.size() - 1] == ',')
+      arg.erase(arg.size() - 1);
+    call_types.push_back(strip(call[i].substr(start + 2, end - start - 2)));
+    call_args.push_back(arg);
+  }
+  for (size_t i = 0; i < def_args.size() && i < call_types.size(); i++)
+  {
+    if (call_types[i] == "module id")
+      id_map[def_args[i]] = call_args[i];
+    else if (call_types[i] == "fifo")
+      fifo_map[def_args[i]] = call_args[i];
+  }
+
+  for (size_t i = 0; i < def.size(); i++)
+  {
+    std::string line = def[i];
+    std::map<std::string, std::string> *map = NULL;
+
+    if (line.find("void") != std::string::npos)
+    {
+      std::vector<std::string> args = extract_def_args(line);
+      bool first = true;
+
+      fprintf(fp, "%s(", line.substr(0, line.rfind('(')).c_str());
+      for (size_t j = 0; j < args.size(); j++)
+      {
+        if (j < call_types.size() &&
+            (call_types[j] == "module id" || call_types[j] == "fifo"))
+          continue;
+        fprintf(fp, "%s%s", first ? "" : ", ", args[j].c_str());
+        first = false;
+      }
+      fprintf(fp, ")\n");
+      continue;
+    }
+    if (line.find("// module id") != std::string::npos)
+      map = &id_map;
+    else if (line.find("read_channel_intel") != std::string::npos ||
+             line.find("write_channel_intel") != std::string::npos)
+      map = &fifo_map;
+    if (map)
+    {
+      std::map<std::string, std::string>::iterator it;
+      for (it = map->begin(); it != map->end(); ++it)
+        line = replace_ident(line, it->first, it->second);
+    }
+    fprintf(fp, "%s", line.c_str());
+  }
+}
+
+/* Generate the final kernel file "<input>_kernel.cl" from the module
+ * definitions and the top module generated by AutoSA.
+ * The Intel OpenCL kernels are autorun, such that the definition of
+ * each module is printed once for each of its calls, with the module ids
+ * and the fifos of the call plugged in.
+ * The intermediate files are removed.
+ * If the top module is not generated by AutoSA (no "top.cpp"), the kernel
+ * is left to the post-processing scripts.
+ */
+static void opencl_write_kernel(struct hls_info *info, const char *input)
+{
+  char name[PATH_MAX];
+  int len;
+  std::string dir = std::string(info->output_dir) + "/src/";
+  std::string top = dir + "top.cpp";
+  std::string kernel, modules;
+  std::vector<std::string> top_lines, def_lines;
+  std::vector<std::vector<std::string> > fifo_decls, module_calls, defs;
+  std::map<std::string, std::vector<std::string> > module_defs;
+  FILE *fp;
+  struct stat st;
+
+  if (stat(top.c_str(), &st) != 0)
+    return;
+
+  len = ppcg_extract_base_name(name, input);
+  strcpy(name + len, "_kernel.cl");
+  kernel = dir + name;
+  strcpy(name + len, "_kernel_modules.cl");
+  modules = dir + name;
+
+  top_lines = read_lines(top.c_str());
+  def_lines = read_lines(modules.c_str());
+  collect_marked_blocks(top_lines, "/* FIFO Declaration */", 1, fifo_decls);
+  collect_marked_blocks(top_lines, "/* Module Call */", 1, module_calls);
+  collect_marked_blocks(def_lines, "/* Module Definition */", 0, defs);
+  for (size_t i = 0; i < defs.size(); i++)
+  {
+    for (size_t j = 0; j < defs[i].size(); j++)
+    {
+      size_t start = defs[i][j].find("void ");
+      size_t end = start == std::string::npos ? start : defs[i][j].find('(', start);
+      if (end == std::string::npos)
+        continue;
+      module_defs[defs[i][j].substr(start + 5, end - start - 5)] = defs[i];
+      break;
+    }
+  }
+
+  fp = fopen(kernel.c_str(), "w");
+  if (!fp)
+  {
+    printf("[AutoSA] Error: Can't open the file: %s\n", kernel.c_str());
+    return;
+  }
+  for (size_t i = 0; i < def_lines.size(); i++)
+    if (def_lines[i].find("#include") != std::string::npos)
+      fprintf(fp, "%s\n", strip(def_lines[i]).c_str());
+  fprintf(fp, "\n");
+
+  fprintf(fp, "/* Channel Declaration */\n");
+  for (size_t i = 0; i < fifo_decls.size(); i++)
+    for (size_t j = 0; j < fifo_decls[i].size(); j++)
+      fprintf(fp, "%s\n", fifo_decls[i][j].c_str());
+  fprintf(fp, "/* Channel Declaration */\n\n");
+
+  for (size_t i = 0; i < module_calls.size(); i++)
+  {
+    std::vector<std::string> &call = module_calls[i];
+    std::map<std::string, std::vector<std::string> >::iterator it;
+
+    if (call.empty())
+      continue;
+    it = module_defs.find(call[0].substr(0, call[0].find('(')));
+    if (it == module_defs.end())
+    {
+      printf("[AutoSA] Warning: Can't find the definition of the module: %s\n",
+             call[0].c_str());
+      continue;
+    }
+    fprintf(fp, "/* Module Definition */\n");
+    print_inlined_module_def(fp, it->second, call);
+    fprintf(fp, "/* Module Definition */\n\n");
+  }
+  fclose(fp);
+
+  remove(modules.c_str());
+  remove(top.c_str());
+  printf("[AutoSA] Please find the generated file: %s\n", kernel.c_str());
+}
+
+/* Close all output files and generate the final kernel file.
  */
-static void opencl_close_files(struct hls_info *info)
+static void opencl_close_files(struct hls_info *info, const char *input)
 {
   isl_printer *p_str;
   char *complete;
@@ -179,6 +478,7 @@ static void opencl_close_files(struct hls_info *info)
   }
   fclose(info->top_gen_c);
   fclose(info->top_gen_h);
+  opencl_write_kernel(info, input);
 
   p_str = isl_printer_to_str(info->ctx);
   p_str = isl_printer_print_str(p_str, info->output_dir);
@@ -866,11 +1166,68 @@ static __isl_give isl_printer *find_device_intel(__isl_take isl_printer *p,
   return p;
 }
 
+/* Assign the memory ports of the arrays of "kernel" to "n_bank" memory
+ * banks, balancing the bandwidth demand of the banks as the HBM channel
+ * assignment of the Xilinx backend: the ports are assigned in decreasing
+ * order of their demand to the least loaded bank.
+ * The bank of the memory port "j" of the array "i" is returned
+ * in "bank[i][j]", -1 for the arrays without device buffers.
+ */
+static std::vector<std::vector<int> > assign_mem_banks_intel(
+    struct autosa_kernel *kernel, int n_bank)
+{
+  std::vector<std::vector<int> > bank(kernel->n_array);
+  std::vector<std::pair<int, int> > ports;
+  std::vector<double> demands;
+  std::vector<double> loads(n_bank, 0);
+  std::vector<int> n_port(n_bank, 0);
+  std::vector<bool> done;
+
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+
+    bank[i].assign(local_array->n_mem_ports, -1);
+    if (!autosa_array_requires_device_allocation(local_array->array))
+      continue;
+    for (int j = 0; j < local_array->n_mem_ports; j++)
+    {
+      double demand = 0;
+      for (int k = 0; k < local_array->group_ref_mem_port_map.size(); k++)
+        if (local_array->group_ref_mem_port_map[k].second == j)
+          demand += local_array->group_ref_bw_demand[k];
+      ports.push_back(std::pair<int, int>(i, j));
+      demands.push_back(demand);
+      done.push_back(false);
+    }
+  }
+
+  for (int n = 0; n < ports.size(); n++)
+  {
+    int cur = -1, b = 0;
+    for (int i = 0; i < ports.size(); i++)
+      if (!done[i] && (cur == -1 || demands[i] > demands[cur]))
+        cur = i;
+    for (int c = 1; c < n_bank; c++)
+      if (loads[c] < loads[b] ||
+          (loads[c] == loads[b] && n_port[c] < n_port[b]))
+        b = c;
+    loads[b] += demands[cur];
+    n_port[b]++;
+    bank[ports[cur].first][ports[cur].second] = b;
+    done[cur] = true;
+  }
+
+  return bank;
+}
+
 static __isl_give isl_printer *declare_and_allocate_device_arrays_intel(
     __isl_take isl_printer *p, struct autosa_prog *prog,
     struct autosa_kernel *kernel)
 {
   int indent;
+  int n_bank = kernel->options->autosa->intel_mem_banks;
+  std::vector<std::vector<int> > bank;
   p = print_str_new_line(p, "// Allocate memory in host memory");
   for (int i = 0; i < kernel->n_array; i++)
   {
@@ -1001,6 +1358,13 @@ static __isl_give isl_printer *declare_and_allocate_device_arrays_intel(
   }
   p = isl_printer_end_line(p);
 
+  if (n_bank > 0)
+  {
+    bank = assign_mem_banks_intel(kernel, n_bank);
+    printf("[AutoSA] The device buffers are placed in %d memory banks. Compile the kernel with -no-interleaving=default.\n",
+           n_bank);
+  }
+
   p = print_str_new_line(p, "// Allocate buffers in device memory");
   for (int i = 0; i < kernel->n_array; i++)
   {
@@ -1022,6 +1386,25 @@ static __isl_give isl_printer *declare_and_allocate_device_arrays_intel(
     if (!autosa_array_requires_device_allocation(local_array->array))
       continue;
 
+    if (n_bank > 0)
+    {
+      /* Memory banks of the buffers of the memory ports */
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "const cl_mem_flags bank_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, "[] = {");
+      for (int j = 0; j < local_array->n_mem_ports; j++)
+      {
+        if (j > 0)
+          p = isl_printer_print_str(p, ", ");
+        p = isl_printer_print_str(p, "CL_CHANNEL_");
+        p = isl_printer_print_int(p, bank[i][j] + 1);
+        p = isl_printer_print_str(p, "_INTELFPGA");
+      }
+      p = isl_printer_print_str(p, "};");
+      p = isl_printer_end_line(p);
+    }
+
     //for (int j = 0; j < local_array->n_mem_ports; j++) {
     p = isl_printer_start_line(p);
     p = isl_printer_print_str(p, "for (int i = 0; i < ");
@@ -1051,6 +1434,12 @@ static __isl_give isl_printer *declare_and_allocate_device_arrays_intel(
       else if (local_array->array->copy_out)
         p = isl_printer_print_str(p, "CL_MEM_WRITE_ONLY");
     }
+    if (n_bank > 0)
+    {
+      p = isl_printer_print_str(p, " | bank_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, "[i]");
+    }
     p = isl_printer_print_str(p, ",");
     p = isl_printer_end_line(p);
     p = isl_printer_start_line(p);
@@ -1087,6 +1476,8 @@ static __isl_give isl_printer *declare_and_allocate_device_arrays_intel(
   p = print_str_new_line(p, "auto host_begin = std::chrono::high_resolution_clock::now();");
   p = print_str_new_line(p, "auto fpga_begin = std::chrono::high_resolution_clock::now();");
   p = print_str_new_line(p, "auto fpga_end = std::chrono::high_resolution_clock::now();");
+  p = print_str_new_line(p, "std::vector<cl_event> write_events;");
+  p = print_str_new_line(p, "std::vector<cl_event> read_events;");
   p = isl_printer_end_line(p);
 
   return p;
@@ -1213,10 +1604,50 @@ static __isl_give isl_printer *drain_merge_intel(
   return p;
 }
 
+/* Print code to "p" for waiting for all the events collected in the
+ * host vector "events" and releasing them afterwards.
+ */
+static __isl_give isl_printer *print_wait_for_events_intel(
+    __isl_take isl_printer *p, const char *events)
+{
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "if (!");
+  p = isl_printer_print_str(p, events);
+  p = isl_printer_print_str(p, ".empty()) {");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, 4);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "status = clWaitForEvents(");
+  p = isl_printer_print_str(p, events);
+  p = isl_printer_print_str(p, ".size(), ");
+  p = isl_printer_print_str(p, events);
+  p = isl_printer_print_str(p, ".data()); CHECK(status);");
+  p = isl_printer_end_line(p);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "for (auto &event : ");
+  p = isl_printer_print_str(p, events);
+  p = isl_printer_print_str(p, ")");
+  p = isl_printer_end_line(p);
+  p = print_str_new_line(p, "    clReleaseEvent(event);");
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, events);
+  p = isl_printer_print_str(p, ".clear();");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "}");
+
+  return p;
+}
+
 /* Print code to "p" for copying "array" from the host to the device
  * in its entirety.  The bounds on the extent of "array" have
  * been precomputed in extract_array_info and are used in
  * gpu_array_info_print_size.
+ *
+ * The writes are non-blocking and spread over the command queues so that
+ * the transfers of different memory ports proceed concurrently.
+ * Each write records an event in "write_events", which is waited for
+ * right before the kernels are launched.
  */
 static __isl_give isl_printer *copy_array_to_device_intel(__isl_take isl_printer *p,
                                                           struct autosa_array_info *array)
@@ -1232,19 +1663,20 @@ static __isl_give isl_printer *copy_array_to_device_intel(__isl_take isl_printer
   p = isl_printer_end_line(p);
   p = isl_printer_indent(p, 4);
 
+  p = print_str_new_line(p, "cl_event write_event;");
   p = print_str_new_line(p, "status = clEnqueueWriteBuffer(");
   indent = strlen("status = clEnqueueWriteBuffer(");
   p = isl_printer_indent(p, indent);
   p = isl_printer_start_line(p);
-  p = isl_printer_print_str(p, "cmdQueue[0],");
+  p = isl_printer_print_str(p, "cmdQueue[i % NUM_QUEUES_TO_CREATE],");
   p = isl_printer_end_line(p);
   p = isl_printer_start_line(p);
   p = isl_printer_print_str(p, "buffer_");
   p = isl_printer_print_str(p, array->name);
   p = isl_printer_print_str(p, "[i],");
   p = isl_printer_end_line(p);
-  p = print_str_new_line(p, "CL_TRUE");
-  p = print_str_new_line(p, "0");
+  p = print_str_new_line(p, "CL_FALSE,");
+  p = print_str_new_line(p, "0,");
   p = isl_printer_start_line(p);
   p = autosa_array_info_print_size(p, array);
   p = isl_printer_print_str(p, ",");
@@ -1258,10 +1690,11 @@ static __isl_give isl_printer *copy_array_to_device_intel(__isl_take isl_printer
   }
   p = isl_printer_print_str(p, ".data(),");
   p = isl_printer_end_line(p);
-  p = print_str_new_line(p, "0");
-  p = print_str_new_line(p, "NULL");
-  p = print_str_new_line(p, "NULL); CHECK(status);");
+  p = print_str_new_line(p, "0,");
+  p = print_str_new_line(p, "NULL,");
+  p = print_str_new_line(p, "&write_event); CHECK(status);");
   p = isl_printer_indent(p, -indent);
+  p = print_str_new_line(p, "write_events.push_back(write_event);");
 
   p = isl_printer_indent(p, -4);
   p = print_str_new_line(p, "}");
@@ -1274,6 +1707,10 @@ static __isl_give isl_printer *copy_array_to_device_intel(__isl_take isl_printer
  * in its entirety.  The bounds on the extent of "array" have
  * been precomputed in extract_array_info and are used in
  * polysa_array_info_print_size.
+ *
+ * Similar to copy_array_to_device_intel, the reads are non-blocking and
+ * spread over the command queues. All of them are waited for once
+ * they have been enqueued.
  */
 static __isl_give isl_printer *copy_array_from_device_intel(
     __isl_take isl_printer *p, struct autosa_array_info *array)
@@ -1290,11 +1727,12 @@ static __isl_give isl_printer *copy_array_from_device_intel(
   p = isl_printer_end_line(p);
   p = isl_printer_indent(p, 4);
 
-  p = print_str_new_line(p, "clEnqueueReadBuffer(");
-  indent = strlen("clEnqueueReadBuffer(");
+  p = print_str_new_line(p, "cl_event read_event;");
+  p = print_str_new_line(p, "status = clEnqueueReadBuffer(");
+  indent = strlen("status = clEnqueueReadBuffer(");
   p = isl_printer_indent(p, indent);
   p = isl_printer_start_line(p);
-  p = isl_printer_print_str(p, "cmdQueue[0],");
+  p = isl_printer_print_str(p, "cmdQueue[i % NUM_QUEUES_TO_CREATE],");
   p = isl_printer_end_line(p);
 
   p = isl_printer_start_line(p);
@@ -1303,7 +1741,7 @@ static __isl_give isl_printer *copy_array_from_device_intel(
   p = isl_printer_print_str(p, "[i],");
   p = isl_printer_end_line(p);
 
-  p = print_str_new_line(p, "CL_TRUE,");
+  p = print_str_new_line(p, "CL_FALSE,");
   p = print_str_new_line(p, "0,");
   p = isl_printer_start_line(p);
   p = autosa_array_info_print_size(p, array);
@@ -1322,11 +1760,13 @@ static __isl_give isl_printer *copy_array_from_device_intel(
 
   p = print_str_new_line(p, "0,");
   p = print_str_new_line(p, "NULL,");
-  p = print_str_new_line(p, "NULL); CHECK(status);");
+  p = print_str_new_line(p, "&read_event); CHECK(status);");
 
   p = isl_printer_indent(p, -indent);
+  p = print_str_new_line(p, "read_events.push_back(read_event);");
   p = isl_printer_indent(p, -4);
   p = print_str_new_line(p, "}");
+  p = print_wait_for_events_intel(p, "read_events");
 
   return p;
 }
@@ -1829,11 +2269,9 @@ static __isl_give isl_printer *print_host_user_intel(__isl_take isl_printer *p,
 
   p = print_set_kernel_arguments_intel(p, data->prog, kernel, top);
 
-  p = print_str_new_line(p, "for (int i = 0; i < NUM_QUEUES_TO_CREATE; i++) {");
-  p = isl_printer_indent(p, 4);
-  p = print_str_new_line(p, "status = clFinish(cmdQueue[i]); CHECK(status);");
-  p = isl_printer_indent(p, -4);
-  p = print_str_new_line(p, "}");
+  /* The buffers are written on all queues concurrently, wait for the
+   * transfers before the kernels start. */
+  p = print_wait_for_events_intel(p, "write_events");
   p = print_str_new_line(p, "fpga_begin = std::chrono::high_resolution_clock::now();");
 
   p = print_launch_kernel_intel(p, data->prog, kernel, top);
@@ -2413,7 +2851,7 @@ static __isl_give isl_printer *autosa_print_host_code(__isl_take isl_printer *p,
 
   for (int i = 0; i < n_modules; i++)
   {
-    if (modules[i]->is_filter && modules[i]->is_buffer)
+    if (autosa_hw_module_is_split(modules[i]))
     {
       /* Print out the definitions for inter_trans and intra_trans function calls. */
       /* Intra transfer function */
@@ -2573,6 +3011,83 @@ static __isl_give isl_printer *print_top_module_call_stmt(
   return p;
 }
 
+/* Extract the names of the module counters of the top module.
+ * The number of names is returned in "n".
+ */
+static char **extract_top_module_names(isl_ctx *ctx,
+                                       struct autosa_hw_top_module *top, int *n)
+{
+  int n_module_names = 0;
+  char **module_names = NULL;
+
+  for (int i = 0; i < top->n_hw_modules; i++)
+  {
+    /* Generate module call counter. */
+    struct autosa_hw_module *module = top->hw_modules[i];
+    char *module_name;
+
+    if (autosa_hw_module_is_split(module))
+    {
+      module_name = concat(ctx, module->name, "intra_trans");
+
+      n_module_names++;
+      module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
+      module_names[n_module_names - 1] = module_name;
+
+      module_name = concat(ctx, module->name, "inter_trans");
+
+      n_module_names++;
+      module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
+      module_names[n_module_names - 1] = module_name;
+
+      if (module->boundary)
+      {
+        module_name = concat(ctx, module->name, "inter_trans_boundary");
+
+        n_module_names++;
+        module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
+        module_names[n_module_names - 1] = module_name;
+      }
+    }
+
+    module_name = strdup(module->name);
+
+    n_module_names++;
+    module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
+    module_names[n_module_names - 1] = module_name;
+
+    if (module->boundary)
+    {
+      module_name = concat(ctx, module->name, "boundary");
+
+      n_module_names++;
+      module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
+      module_names[n_module_names - 1] = module_name;
+    }
+
+    if (module->n_pe_dummy_modules > 0)
+    {
+      for (int j = 0; j < module->n_pe_dummy_modules; j++)
+      {
+        struct autosa_pe_dummy_module *dummy_module = module->pe_dummy_modules[j];
+        struct autosa_array_ref_group *group = dummy_module->io_group;
+        isl_printer *p_str = isl_printer_to_str(ctx);
+        p_str = autosa_array_ref_group_print_prefix(group, p_str);
+        p_str = isl_printer_print_str(p_str, "_PE_dummy");
+        module_name = isl_printer_get_str(p_str);
+        isl_printer_free(p_str);
+
+        n_module_names++;
+        module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
+        module_names[n_module_names - 1] = module_name;
+      }
+    }
+  }
+
+  *n = n_module_names;
+  return module_names;
+}
+
 /* This function prints the code that prints out the top function that 
  * calls the hardware modules and declares the fifos.
  */
@@ -2679,70 +3194,7 @@ static void print_top_gen_host_code(
   p = isl_printer_end_line(p);
 
   int n_module_names = 0;
-  char **module_names = NULL;
-  for (int i = 0; i < top->n_hw_modules; i++)
-  {
-    /* Generate module call counter. */
-    struct autosa_hw_module *module = top->hw_modules[i];
-    char *module_name;
-
-    if (module->is_filter && module->is_buffer)
-    {
-      module_name = concat(ctx, module->name, "intra_trans");
-
-      n_module_names++;
-      module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
-      module_names[n_module_names - 1] = module_name;
-
-      module_name = concat(ctx, module->name, "inter_trans");
-
-      n_module_names++;
-      module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
-      module_names[n_module_names - 1] = module_name;
-
-      if (module->boundary)
-      {
-        module_name = concat(ctx, module->name, "inter_trans_boundary");
-
-        n_module_names++;
-        module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
-        module_names[n_module_names - 1] = module_name;
-      }
-    }
-
-    module_name = strdup(module->name);
-
-    n_module_names++;
-    module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
-    module_names[n_module_names - 1] = module_name;
-
-    if (module->boundary)
-    {
-      module_name = concat(ctx, module->name, "boundary");
-
-      n_module_names++;
-      module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
-      module_names[n_module_names - 1] = module_name;
-    }
-
-    if (module->n_pe_dummy_modules > 0)
-    {
-      for (int j = 0; j < module->n_pe_dummy_modules; j++)
-      {
-        struct autosa_pe_dummy_module *dummy_module = module->pe_dummy_modules[j];
-        struct autosa_array_ref_group *group = dummy_module->io_group;
-        isl_printer *p_str = isl_printer_to_str(ctx);
-        p_str = autosa_array_ref_group_print_prefix(group, p_str);
-        p_str = isl_printer_print_str(p_str, "_PE_dummy");
-        module_name = isl_printer_get_str(p_str);
-        isl_printer_free(p_str);
-
-        n_module_names++;
-        module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
-        module_names[n_module_names - 1] = module_name;
-      }
-    }
-  }
+  char **module_names = extract_top_module_names(ctx, top, &n_module_names);
   for (int i = 0; i < n_module_names; i++)
   {
     p = isl_printer_start_line(p);
@@ -2840,14 +3292,175 @@ static void print_top_gen_host_code(
   return;
 }
 
+/* Generate the top function that calls the hardware modules and declares
+ * the fifos directly, by interpreting the code printed by
+ * print_top_gen_host_code, and print it to "output_dir/src/top.cpp",
+ * together with the design information in
+ * "output_dir/resource_est/design_info.dat".
+ * If the top function cannot be generated, neither file is printed, and
+ * the post-processing scripts fall back to the code printed by
+ * print_top_gen_host_code.
+ */
+static isl_stat print_top_module_native(
+    struct autosa_prog *prog, __isl_keep isl_ast_node *node,
+    struct autosa_hw_top_module *top, struct hls_info *hls)
+{
+  isl_ctx *ctx = isl_ast_node_get_ctx(node);
+  isl_printer *p_str, *p_info;
+  struct print_hw_module_data hw_data = {hls, prog, NULL};
+  struct autosa_top_gen *gen;
+  isl_stat r = isl_stat_ok;
+  char *code, *info;
+  char *top_path, *info_path;
+  FILE *fp;
+
+  p_str = isl_printer_to_str(ctx);
+  p_str = isl_printer_print_str(p_str, hls->output_dir);
+  p_str = isl_printer_print_str(p_str, "/src/top.cpp");
+  top_path = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  p_str = isl_printer_to_str(ctx);
+  p_str = isl_printer_print_str(p_str, hls->output_dir);
+  p_str = isl_printer_print_str(p_str, "/resource_est/design_info.dat");
+  info_path = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  remove(top_path);
+
+  gen = autosa_top_gen_alloc(ctx);
+  p_info = isl_printer_to_str(ctx);
+
+  /* Print the headers. */
+  p_str = isl_printer_to_str(ctx);
+  p_str = print_top_module_headers_intel(p_str, prog, top, hls);
+  p_str = print_str_new_line(p_str, "p = isl_printer_indent(p, 4);");
+  p_str = print_str_new_line(p_str, "p = isl_printer_start_line(p);");
+  p_str = print_str_new_line(p_str, "p = isl_printer_print_str(p, \"/* FIFO Declaration */\");");
+  p_str = print_str_new_line(p_str, "p = isl_printer_end_line(p);");
+  code = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  r = autosa_top_gen_exec_str(gen, code);
+  free(code);
+
+  /* Print FIFO declarations. */
+  for (int i = 0; i < top->n_fifo_decls && r == isl_stat_ok; i++)
+  {
+    char *fifo_decl_name = top->fifo_decl_names[i];
+    char *fifo_name = extract_fifo_name_from_fifo_decl_name(ctx, fifo_decl_name);
+    char *fifo_w = extract_fifo_width_from_fifo_decl_name(ctx, fifo_decl_name);
+
+    autosa_top_gen_set_var(gen, "fifo_cnt", 0);
+    r = autosa_top_gen_exec_tree(gen, top->fifo_decl_wrapped_trees[i],
+                                 &print_top_module_fifo_stmt, &hw_data);
+
+    /* fifo:fifo_name:fifo_cnt:fifo_width */
+    p_info = isl_printer_print_str(p_info, "fifo:");
+    p_info = isl_printer_print_str(p_info, fifo_name);
+    p_info = isl_printer_print_str(p_info, ":");
+    p_info = isl_printer_print_int(p_info,
+                                   autosa_top_gen_get_var(gen, "fifo_cnt"));
+    p_info = isl_printer_print_str(p_info, ":");
+    p_info = isl_printer_print_str(p_info, fifo_w);
+    p_info = isl_printer_print_str(p_info, "\n");
+
+    free(fifo_name);
+    free(fifo_w);
+  }
+
+  if (r == isl_stat_ok)
+    r = autosa_top_gen_exec_str(gen,
+                                "p = isl_printer_start_line(p);\n"
+                                "p = isl_printer_print_str(p, \"/* FIFO Declaration */\");\n"
+                                "p = isl_printer_end_line(p);\n"
+                                "p = isl_printer_end_line(p);\n");
+
+  /* Print module calls. */
+  int n_module_names = 0;
+  char **module_names = extract_top_module_names(ctx, top, &n_module_names);
+  for (int i = 0; i < n_module_names; i++)
+  {
+    char *cnt_name = concat(ctx, module_names[i], "cnt");
+    autosa_top_gen_set_var(gen, cnt_name, 0);
+    free(cnt_name);
+  }
+
+  for (int i = 0; i < top->n_module_calls && r == isl_stat_ok; i++)
+  {
+    r = autosa_top_gen_exec_tree(gen, top->module_call_wrapped_trees[i],
+                                 &print_top_module_call_stmt, &hw_data);
+  }
+
+  /* module:module_name:module_cnt */
+  for (int i = 0; i < n_module_names; i++)
+  {
+    char *cnt_name = concat(ctx, module_names[i], "cnt");
+    p_info = isl_printer_print_str(p_info, "module:");
+    p_info = isl_printer_print_str(p_info, module_names[i]);
+    p_info = isl_printer_print_str(p_info, ":");
+    p_info = isl_printer_print_int(p_info, autosa_top_gen_get_var(gen, cnt_name));
+    p_info = isl_printer_print_str(p_info, "\n");
+    free(cnt_name);
+    free(module_names[i]);
+  }
+  free(module_names);
+
+  if (r == isl_stat_ok)
+    r = autosa_top_gen_exec_str(gen,
+                                "p = isl_printer_indent(p, -4);\n"
+                                "p = isl_printer_start_line(p);\n"
+                                "p = isl_printer_print_str(p, \"}\");\n"
+                                "p = isl_printer_end_line(p);\n");
+
+  if (r == isl_stat_ok)
+  {
+    fp = fopen(top_path, "w");
+    if (fp)
+    {
+      r = autosa_top_gen_write(gen, fp, 0);
+      fclose(fp);
+    }
+    else
+    {
+      r = isl_stat_error;
+    }
+  }
+  if (r == isl_stat_ok)
+  {
+    info = isl_printer_get_str(p_info);
+    fp = fopen(info_path, "w");
+    if (fp)
+    {
+      fprintf(fp, "%s", info);
+      fclose(fp);
+    }
+    free(info);
+  }
+  else
+  {
+    remove(top_path);
+    printf("[AutoSA] Warning: Failed to generate the top module natively.\n");
+  }
+
+  isl_printer_free(p_info);
+  autosa_top_gen_free(gen);
+  free(top_path);
+  free(info_path);
+
+  return r;
+}
+
 /* Examine if all autorun modules are legal to be used as autorun.
  * Specifically, for Intel OpenCL, we examine for each non external module 
  * (modules that are not connected to the external memory), if there is only
  * index and fifos in the arguments.
+ * The host only launches the modules connected to the external memory,
+ * all the other modules have to be autorun kernels.
+ * Each module that would take other arguments is reported with the reason.
  */
 static int is_autorun_legal(struct autosa_prog *prog,
                             struct autosa_hw_module **modules, int n_modules)
 {
+  int legal = 1;
+
   for (int i = 0; i < n_modules; i++)
   {
     struct autosa_hw_module *module = modules[i];
@@ -2862,28 +3475,42 @@ static int is_autorun_legal(struct autosa_prog *prog,
     nparam = isl_space_dim(space, isl_dim_param);
     isl_space_free(space);
     if (nparam > 0)
-      return 0;
+    {
+      printf("[AutoSA] Module %s depends on %d parameter(s) and cannot be autorun.\n",
+             module->name, nparam);
+      legal = 0;
+      continue;
+    }
     /* host iter */
     n = isl_space_dim(module->space, isl_dim_set);
     if (n > 0)
-      return 0;
+    {
+      printf("[AutoSA] Module %s is enclosed by %d host loop(s) and cannot be autorun.\n",
+             module->name, n);
+      legal = 0;
+      continue;
+    }
     /* scalar */
     if (module->type == PE_MODULE)
     {
-      for (int i = 0; i < prog->n_array; i++)
+      for (int j = 0; j < prog->n_array; j++)
       {
         int required;
-        required = autosa_kernel_requires_array_argument(module->kernel, i);
+        required = autosa_kernel_requires_array_argument(module->kernel, j);
         if (required)
         {
-          if (autosa_array_is_read_only_scalar(&prog->array[i]))
-            return 0;
+          if (autosa_array_is_read_only_scalar(&prog->array[j]))
+          {
+            printf("[AutoSA] Module %s reads the scalar %s and cannot be autorun.\n",
+                   module->name, prog->array[j].name);
+            legal = 0;
+          }
         }
       }
     }
   }
 
-  return 1;
+  return legal;
 }
 
 /* Given a autosa_prog "prog" and the corresponding tranformed AST
@@ -2924,6 +3551,8 @@ static __isl_give isl_printer *print_hw(
                              drain_merge_funcs, n_drain_merge_funcs, hls);
   /* Print seperate top module code generation function. */
   print_top_gen_host_code(prog, tree, top_module, hls);
+  /* Generate the top module directly. */
+  print_top_module_native(prog, tree, top_module, hls);
 
   return p;
 }
@@ -2938,13 +3567,60 @@ int generate_autosa_intel_opencl(isl_ctx *ctx, struct ppcg_options *options,
 
   hls.target = INTEL_HW;
   hls.hls = 0;
+  hls.host_batch = 1;
+  hls.host_serialize = 0;
+  hls.host_zero_copy = 0;
+  hls.cpu_sim = 0;
+  hls.perf_counters = 0;
+  hls.fifo_trace = 0;
+  hls.split_buf_lifted = 0;
+  hls.io_prefetch = 0;
+  hls.prefetch = 0;
+  hls.cache_sets = 0;
+  hls.cache_ways = 0;
+  if (options->autosa->irregular_cache)
+  {
+    printf("[AutoSA] Warning: The caches of the irregular arrays are not supported for Intel OpenCL. Option --AutoSA-irregular-cache is ignored.\n");
+    free(options->autosa->irregular_cache);
+    options->autosa->irregular_cache = NULL;
+  }
+  if (options->autosa->intel_mem_banks > 7)
+  {
+    /* The host flags address the banks CL_CHANNEL_1_INTELFPGA to
+     * CL_CHANNEL_7_INTELFPGA. */
+    printf("[AutoSA] Warning: At most 7 memory banks are supported for Intel OpenCL. Option --AutoSA-intel-mem-banks is set to 7.\n");
+    options->autosa->intel_mem_banks = 7;
+  }
+  if (options->autosa->compute_units != 1)
+  {
+    printf("[AutoSA] Warning: Multiple compute units are not supported for Intel OpenCL. Option --AutoSA-compute-units is ignored.\n");
+    options->autosa->compute_units = 1;
+  }
+  if (options->autosa->triangular)
+  {
+    printf("[AutoSA] Warning: The triangular arrays are not supported for Intel OpenCL. Option --AutoSA-triangular is ignored.\n");
+    options->autosa->triangular = 0;
+  }
+  if (options->autosa->fifo_trace)
+    printf("[AutoSA] Warning: FIFO traces are not supported for Intel OpenCL. Option --AutoSA-fifo-trace is ignored.\n");
+  if (options->autosa->perf_counters)
+  {
+    printf("[AutoSA] Warning: Performance counters are not supported for Intel OpenCL. Option --AutoSA-perf-counters is ignored.\n");
+    options->autosa->perf_counters = 0;
+  }
   hls.ctx = ctx;
+  if (options->autosa->data_type)
+  {
+    printf("[AutoSA] Warning: Arbitrary-precision data types are not supported for Intel OpenCL. Option --AutoSA-data-type is ignored.\n");
+    free(options->autosa->data_type);
+    options->autosa->data_type = NULL;
+  }
   hls.output_dir = options->autosa->output_dir;
   opencl_open_files(&hls, input);
 
   r = generate_sa(ctx, input, hls.host_c, options, &print_hw, &hls);
 
-  opencl_close_files(&hls);
+  opencl_close_files(&hls, input);
 
   return r;
 }
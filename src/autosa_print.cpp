@@ -99,6 +99,8 @@ static int already_printed(struct autosa_types *types,
 /* Print the definitions of all types prog->scop that have not been
  * printed before (according to "types") on "p".
  * Extend the list of printed types "types" with the newly printed types.
+ * The types given an HLS data type by "--AutoSA-data-type" are defined
+ * as the HLS data type.
  */
 __isl_give isl_printer *autosa_print_types(__isl_take isl_printer *p,
                                            struct autosa_types *types, struct autosa_prog *prog)
@@ -121,14 +123,27 @@ __isl_give isl_printer *autosa_print_types(__isl_take isl_printer *p,
   for (i = 0; i < n; ++i)
   {
     struct pet_type *type = prog->scop->pet->types[i];
+    char *hls_type;
 
     if (already_printed(types, type))
       continue;
 
+    hls_type = autosa_hls_data_type(prog->scop->options, type->name);
     p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, type->definition);
+    if (hls_type)
+    {
+      p = isl_printer_print_str(p, "typedef ");
+      p = isl_printer_print_str(p, hls_type);
+      p = isl_printer_print_str(p, " ");
+      p = isl_printer_print_str(p, type->name);
+    }
+    else
+    {
+      p = isl_printer_print_str(p, type->definition);
+    }
     p = isl_printer_print_str(p, ";");
     p = isl_printer_end_line(p);
+    free(hls_type);
 
     types->name[types->n++] = strdup(type->name);
   }
@@ -236,10 +251,67 @@ __isl_give isl_printer *autosa_print_array_type(__isl_take isl_printer *p,
   return p;
 }
 
+/* Print the body of the domain statement "stmt".
+ * If the zero initialization of the accumulator is fused into the statement,
+ * then the read of the accumulator is replaced by a selection
+ * between zero in the first update and the accumulator otherwise.
+ */
+static __isl_give isl_printer *print_domain_body(__isl_take isl_printer *p,
+                                                 struct autosa_kernel_stmt *stmt)
+{
+  isl_id *write_ref = NULL, *read_ref = NULL;
+  isl_id_to_ast_expr *ref2expr;
+  isl_ast_expr *acc;
+  isl_id *id;
+
+  if (!stmt->u.d.init ||
+      autosa_stmt_is_sum(stmt->u.d.stmt->stmt, &write_ref, &read_ref) != isl_bool_true)
+    return pet_stmt_print_body(stmt->u.d.stmt->stmt, p, stmt->u.d.ref2expr);
+
+  acc = isl_id_to_ast_expr_get(stmt->u.d.ref2expr, isl_id_copy(read_ref));
+  p = print_str_new_line(p, "{");
+  p = isl_printer_indent(p, 2);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, stmt->u.d.init_array->type);
+  p = isl_printer_print_str(p, " acc_init = (");
+  p = isl_printer_print_ast_expr(p, stmt->u.d.init);
+  p = isl_printer_print_str(p, ") ? 0 : ");
+  p = isl_printer_print_ast_expr(p, acc);
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
+  isl_ast_expr_free(acc);
+
+  id = isl_id_alloc(isl_printer_get_ctx(p), "acc_init", NULL);
+  ref2expr = isl_id_to_ast_expr_copy(stmt->u.d.ref2expr);
+  ref2expr = isl_id_to_ast_expr_set(ref2expr, read_ref,
+                                    isl_ast_expr_from_id(id));
+  p = pet_stmt_print_body(stmt->u.d.stmt->stmt, p, ref2expr);
+  isl_id_to_ast_expr_free(ref2expr);
+  isl_id_free(write_ref);
+  p = isl_printer_indent(p, -2);
+  p = print_str_new_line(p, "}");
+
+  return p;
+}
+
 __isl_give isl_printer *autosa_kernel_print_domain(__isl_take isl_printer *p,
                                                    struct autosa_kernel_stmt *stmt)
 {
-  return pet_stmt_print_body(stmt->u.d.stmt->stmt, p, stmt->u.d.ref2expr);
+  if (!stmt->u.d.guard)
+    return print_domain_body(p, stmt);
+
+  /* Mask the padded statement instances. */
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "if (");
+  p = isl_printer_print_ast_expr(p, stmt->u.d.guard);
+  p = isl_printer_print_str(p, ") {");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, 2);
+  p = print_domain_body(p, stmt);
+  p = isl_printer_indent(p, -2);
+  p = print_str_new_line(p, "}");
+
+  return p;
 }
 
 /* Print the declaration of a non-linearized array argument.
@@ -268,6 +340,7 @@ static __isl_give isl_printer *print_non_linearized_declaration_argument(
 
 /* Print the declaration of an array argument.
  * "memory_space" allows to specify a memory space prefix.
+ * The arrays streamed through QDMA are declared as AXI4-Stream ports.
  */
 __isl_give isl_printer *autosa_array_info_print_declaration_argument(
     __isl_take isl_printer *p, struct autosa_array_info *array, int n_lane,
@@ -281,6 +354,22 @@ __isl_give isl_printer *autosa_array_info_print_declaration_argument(
     return p;
   }
 
+  if (array->local_array && array->local_array->host_stream)
+  {
+    p = isl_printer_print_str(p, "hls::stream<");
+    if (n_lane == 1)
+      p = isl_printer_print_str(p, array->type);
+    else
+    {
+      p = isl_printer_print_str(p, array->name);
+      p = isl_printer_print_str(p, "_t");
+      p = isl_printer_print_int(p, n_lane);
+    }
+    p = isl_printer_print_str(p, "> &");
+    p = isl_printer_print_str(p, array->name);
+    return p;
+  }
+
   if (memory_space)
   {
     p = isl_printer_print_str(p, memory_space);
@@ -310,6 +399,61 @@ __isl_give isl_printer *autosa_array_info_print_declaration_argument(
   return p;
 }
 
+/* Return 1 if "kernel" is generated as a persistent kernel on "target",
+ * i.e., the kernel processes "n_batch" consecutive problems per launch.
+ * In this case, "n_batch" is passed to the kernel and to all the hardware
+ * modules, which loop over the problems without draining the array
+ * in between.
+ */
+int autosa_kernel_is_persistent(struct autosa_kernel *kernel,
+                                enum platform target)
+{
+  return target == XILINX_HW && kernel->options->autosa->persistent_kernel;
+}
+
+/* Return 1 if "module" of "kernel" is printed on "target" as a template
+ * on its module identifiers, i.e., the identifiers are passed as template
+ * arguments instead of function arguments, such that HLS specializes
+ * the module for each of its instances.
+ */
+int autosa_module_is_template(struct autosa_kernel *kernel,
+                              struct autosa_hw_module *module,
+                              enum platform target)
+{
+  return target == XILINX_HW && kernel->options->autosa->module_template &&
+         isl_id_list_n_id(module->inst_ids) > 0;
+}
+
+/* Print the template parameters on the module identifiers of "module"
+ * in front of its declaration if "types" is set, or the template
+ * arguments following its name in a call otherwise.
+ */
+__isl_give isl_printer *print_module_template(__isl_take isl_printer *p,
+                                              struct autosa_kernel *kernel,
+                                              struct autosa_hw_module *module,
+                                              int types, enum platform target)
+{
+  const char *dims[] = {"idx", "idy", "idz"};
+  int n;
+
+  if (!autosa_module_is_template(kernel, module, target))
+    return p;
+
+  n = isl_id_list_n_id(module->inst_ids);
+  p = isl_printer_print_str(p, types ? "template <" : "<");
+  for (int i = 0; i < n; i++)
+  {
+    if (i > 0)
+      p = isl_printer_print_str(p, ", ");
+    if (types)
+      p = isl_printer_print_str(p, "int ");
+    p = isl_printer_print_str(p, dims[i]);
+  }
+  p = isl_printer_print_str(p, types ? "> " : ">");
+
+  return p;
+}
+
 /* Print the arguments to a kernel declaration or call.  If "types" is set,
  * then print a declaration (including the types of the arguments).
  *
@@ -317,6 +461,8 @@ __isl_give isl_printer *autosa_array_info_print_declaration_argument(
  * - the arrays accessed by the kernel
  * - the parameters
  * - the host loop iterators
+ * - the performance counters
+ * - the FIFO traces
  */
 __isl_give isl_printer *print_kernel_arguments(__isl_take isl_printer *p,
                                                struct autosa_prog *prog, struct autosa_kernel *kernel,
@@ -397,6 +543,21 @@ __isl_give isl_printer *print_kernel_arguments(__isl_take isl_printer *p,
   }
   isl_space_free(space);
 
+  /* Batch size of the persistent kernel.
+   * The host launches the kernel with a single problem.
+   */
+  if (autosa_kernel_is_persistent(kernel, hls->target))
+  {
+    if (!first)
+      p = isl_printer_print_str(p, ", ");
+    if (types)
+      p = isl_printer_print_str(p, "int n_batch");
+    else
+      p = isl_printer_print_str(p, "1");
+
+    first = 0;
+  }
+
   /* Host loop iterators */
   n = isl_space_dim(kernel->space, isl_dim_set);
   type = isl_options_get_ast_iterator_type(prog->ctx);
@@ -417,6 +578,26 @@ __isl_give isl_printer *print_kernel_arguments(__isl_take isl_printer *p,
     first = 0;
   }
 
+  /* Performance counters */
+  if (hls->perf_counters)
+  {
+    if (!first)
+      p = isl_printer_print_str(p, ", ");
+    p = isl_printer_print_str(p, types ? "unsigned int *perf" : "perf");
+
+    first = 0;
+  }
+
+  /* FIFO traces */
+  if (hls->fifo_trace)
+  {
+    if (!first)
+      p = isl_printer_print_str(p, ", ");
+    p = isl_printer_print_str(p, types ? "unsigned int *trace" : "trace");
+
+    first = 0;
+  }
+
   return p;
 }
 
@@ -654,6 +835,72 @@ __isl_give isl_printer *autosa_module_array_info_print_call_argument(
   return p;
 }
 
+/* Print the performance counters argument to a module declaration or call
+ * if performance counters are inserted into the Xilinx modules of "kernel".
+ * The module drains its counters to the top module through the FIFO
+ * "fifo_perf", while the intra_trans and inter_trans functions
+ * (with "inter" different from -1) update the counters "perf" of the module
+ * calling them.
+ */
+static __isl_give isl_printer *print_perf_counters_argument(
+    __isl_take isl_printer *p, struct autosa_kernel *kernel, int types,
+    enum platform target, int inter, int *first)
+{
+  if (target != XILINX_HW || !kernel->options->autosa->perf_counters)
+    return p;
+
+  if (!(*first))
+    p = isl_printer_print_str(p, ", ");
+  if (inter == -1)
+    p = isl_printer_print_str(p, types ? "hls::stream<autosa_perf_t> &fifo_perf" : "fifo_perf");
+  else
+    p = isl_printer_print_str(p, types ? "autosa_perf_t &perf" : "perf");
+  *first = 0;
+
+  return p;
+}
+
+/* Print the FIFOs connecting the PE module "module" to the caches of
+ * the irregular arrays of "kernel" to a module declaration or call.
+ * The PE sends the indices of its reads to "fifo_[array]_cache_req"
+ * and receives the elements from "fifo_[array]_cache_resp".
+ */
+static __isl_give isl_printer *print_irregular_cache_arguments(
+    __isl_take isl_printer *p, struct autosa_kernel *kernel,
+    struct autosa_hw_module *module, int types, enum platform target,
+    int *first)
+{
+  if (target != XILINX_HW || module->type != PE_MODULE)
+    return p;
+
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_array_info *array = kernel->array[i].array;
+
+    if (!array->irregular)
+      continue;
+    if (!(*first))
+      p = isl_printer_print_str(p, ", ");
+    if (types)
+      p = isl_printer_print_str(p, "hls::stream<int> &");
+    p = isl_printer_print_str(p, "fifo_");
+    p = isl_printer_print_str(p, array->name);
+    p = isl_printer_print_str(p, "_cache_req, ");
+    if (types)
+    {
+      p = isl_printer_print_str(p, "hls::stream<");
+      p = isl_printer_print_str(p, array->type);
+      p = isl_printer_print_str(p, "> &");
+    }
+    p = isl_printer_print_str(p, "fifo_");
+    p = isl_printer_print_str(p, array->name);
+    p = isl_printer_print_str(p, "_cache_resp");
+    *first = 0;
+  }
+
+  return p;
+}
+
 /* Print the arguments to a module declaration or call. If "types" is set,
  * then print a declaration (including the types of the arguments).
  *
@@ -663,7 +910,9 @@ __isl_give isl_printer *autosa_module_array_info_print_call_argument(
  * - the host loop iterators
  * - the arrays accessed by the module
  * - the fifos
+ * - the cache fifos of the irregular arrays
  * - the enable signal
+ * - the performance counters
  */
 __isl_give isl_printer *print_module_arguments(
     __isl_take isl_printer *p,
@@ -680,9 +929,9 @@ __isl_give isl_printer *print_module_arguments(
   const char *type;
 
   type = isl_options_get_ast_iterator_type(prog->ctx);
-  /* Module identifiers */
+  /* Module identifiers, unless they are template arguments */
   const char *dims[] = {"idx", "idy", "idz"};
-  n = isl_id_list_n_id(module->inst_ids);
+  n = autosa_module_is_template(kernel, module, target) ? 0 : isl_id_list_n_id(module->inst_ids);
   for (int i = 0; i < n; ++i)
   {
     if (!first)
@@ -716,6 +965,18 @@ __isl_give isl_printer *print_module_arguments(
   }
   isl_space_free(space);
 
+  /* Batch size of the persistent kernel */
+  if (inter == -1 && autosa_kernel_is_persistent(kernel, target))
+  {
+    if (!first)
+      p = isl_printer_print_str(p, ", ");
+    if (types)
+      p = isl_printer_print_str(p, "int ");
+    p = isl_printer_print_str(p, "n_batch");
+
+    first = 0;
+  }
+
   /* host iters */
   if (inter == -1)
     space = module->space;
@@ -989,6 +1250,9 @@ __isl_give isl_printer *print_module_arguments(
     first = 0;
   }
 
+  /* cache fifos */
+  p = print_irregular_cache_arguments(p, kernel, module, types, target, &first);
+
   /* enable signal */
   if (module->double_buffer && inter != -1)
   {
@@ -1008,6 +1272,9 @@ __isl_give isl_printer *print_module_arguments(
     first = 0;
   }
 
+  /* performance counters */
+  p = print_perf_counters_argument(p, kernel, types, target, inter, &first);
+
   return p;
 }
 
@@ -1020,6 +1287,7 @@ __isl_give isl_printer *print_module_arguments(
  * - the host loop iterators 
  * - the arrays accessed by the module
  * - the fifos
+ * - the performance counters
  */
 __isl_give isl_printer *print_pe_dummy_module_arguments(
     __isl_take isl_printer *p,
@@ -1037,9 +1305,9 @@ __isl_give isl_printer *print_pe_dummy_module_arguments(
   struct autosa_hw_module *module = pe_dummy_module->module;
 
   type = isl_options_get_ast_iterator_type(prog->ctx);
-  /* module identifiers */
+  /* module identifiers, unless they are template arguments */
   const char *dims[] = {"idx", "idy", "idz"};
-  n = isl_id_list_n_id(module->inst_ids);
+  n = autosa_module_is_template(kernel, module, target) ? 0 : isl_id_list_n_id(module->inst_ids);
   for (int i = 0; i < n; ++i)
   {
     if (!first)
@@ -1073,6 +1341,18 @@ __isl_give isl_printer *print_pe_dummy_module_arguments(
   }
   isl_space_free(space);
 
+  /* Batch size of the persistent kernel */
+  if (autosa_kernel_is_persistent(kernel, target))
+  {
+    if (!first)
+      p = isl_printer_print_str(p, ", ");
+    if (types)
+      p = isl_printer_print_str(p, "int ");
+    p = isl_printer_print_str(p, "n_batch");
+
+    first = 0;
+  }
+
   /* host iters */
   space = module->space;
 
@@ -1140,6 +1420,9 @@ __isl_give isl_printer *print_pe_dummy_module_arguments(
                                         group, "in", target);
   first = 0;
 
+  /* performance counters */
+  p = print_perf_counters_argument(p, kernel, types, target, -1, &first);
+
   return p;
 }
 
@@ -1431,7 +1714,11 @@ static __isl_give isl_printer *print_fifo_decl_single(
   if (hls->target == INTEL_HW)
   {
     /* Print fifo attribute */
-    p = print_str_new_line(p, "p = isl_printer_print_str(p, \" __attribute__((depth(2)))\");");
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "p = isl_printer_print_str(p, \" __attribute__((depth(");
+    p = isl_printer_print_int(p, autosa_fifo_depth(module, n_lane));
+    p = isl_printer_print_str(p, ")))\");");
+    p = isl_printer_end_line(p);
   }
   //p = isl_printer_start_line(p);
   //p = isl_printer_print_str(p, "p = isl_printer_print_str(p, \";\");");
@@ -1485,7 +1772,9 @@ static __isl_give isl_printer *print_fifo_decl_single(
       }
     }
     p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "p = isl_printer_print_str(p, \" depth=2\");");
+    p = isl_printer_print_str(p, "p = isl_printer_print_str(p, \" depth=");
+    p = isl_printer_print_int(p, autosa_fifo_depth(module, n_lane));
+    p = isl_printer_print_str(p, "\");");
     p = isl_printer_end_line(p);
 
     p = isl_printer_start_line(p);
@@ -1494,9 +1783,10 @@ static __isl_give isl_printer *print_fifo_decl_single(
 
     /* If depth * width > 512 bits, HLS will use BRAM to implement FIFOs.
      * Instead, we will insert pragmas to use SRL instead.
+     * Deep FIFOs are left in BRAM.
      */
     /* Print fifo resource pragma. */
-    if (n_lane * group->array->size > 32)
+    if (n_lane * group->array->size > 32 && autosa_fifo_depth(module, n_lane) <= 32)
     {
       p = isl_printer_start_line(p);
       p = isl_printer_print_str(p, "p = isl_printer_start_line(p);");
@@ -1765,6 +2055,13 @@ __isl_give isl_printer *print_module_call_upper(__isl_take isl_printer *p,
   }
   isl_space_free(space);
 
+  /* batch size */
+  if (autosa_kernel_is_persistent(module->kernel, target))
+  {
+    p = print_delimiter(p, &first);
+    p = print_str_new_line(p, "p = isl_printer_print_str(p, \"/* batch */ n_batch\");");
+  }
+
   /* host iterators */
   n = isl_space_dim(module->kernel->space, isl_dim_set);
   for (int i = 0; i < n; i++)
@@ -2119,7 +2416,7 @@ __isl_give isl_printer *autosa_kernel_print_module_call(
       p = isl_printer_print_str(p, "_boundary");
     p = isl_printer_print_str(p, "_cnt++;");
     p = isl_printer_end_line(p);
-    if (module->is_filter && module->is_buffer)
+    if (autosa_hw_module_is_split(module))
     {
       /* Print counter for inter_trans and intra_trans module. */
       p = isl_printer_start_line(p);
@@ -2181,7 +2478,7 @@ __isl_give isl_printer *autosa_kernel_print_module_call(
         p = isl_printer_print_str(p, "_boundary");
       p = isl_printer_print_str(p, "_cnt++;");
       p = isl_printer_end_line(p);
-      if (module->is_filter && module->is_buffer)
+      if (autosa_hw_module_is_split(module))
       {
         /* Print counter for inter_trans and intra_trans module */
         p = isl_printer_start_line(p);
@@ -2243,11 +2540,20 @@ __isl_give isl_printer *autosa_kernel_print_module_call(
  *   "[fifo_name].read()"
  * else, print:
  *   "[fifo_name].write("
+ * With performance counters, the FIFO is accessed through
+ * "autosa_perf_read([fifo_name], perf)" and
+ * "autosa_perf_write([fifo_name], perf, " instead.
  */
 __isl_give isl_printer *print_fifo_rw_xilinx(__isl_take isl_printer *p,
-                                             const char *fifo_name, int read)
+                                             const char *fifo_name, int read, struct hls_info *hls)
 {
-  if (read)
+  if (hls->perf_counters)
+  {
+    p = isl_printer_print_str(p, read ? "autosa_perf_read(" : "autosa_perf_write(");
+    p = isl_printer_print_str(p, fifo_name);
+    p = isl_printer_print_str(p, read ? ", perf)" : ", perf, ");
+  }
+  else if (read)
   {
     p = isl_printer_print_str(p, fifo_name);
     p = isl_printer_print_str(p, ".read()");
@@ -2325,7 +2631,7 @@ __isl_give isl_printer *autosa_kernel_print_io(__isl_take isl_printer *p,
     p = isl_printer_start_line(p);
     p = isl_printer_print_str(p, "fifo_data = ");
     if (hls->target == XILINX_HW)
-      p = print_fifo_rw_xilinx(p, fifo_name, 1);
+      p = print_fifo_rw_xilinx(p, fifo_name, 1, hls);
     else if (hls->target == INTEL_HW)
       p = print_fifo_rw_intel(p, fifo_name, 1);
     p = isl_printer_print_str(p, ";");
@@ -2346,7 +2652,7 @@ __isl_give isl_printer *autosa_kernel_print_io(__isl_take isl_printer *p,
     n_arg = isl_ast_expr_get_op_n_arg(local_index_packed);
     arg = isl_ast_expr_get_op_arg(local_index_packed, n_arg - 1);
     div = isl_ast_expr_from_val(isl_val_int_from_si(ctx, data_pack));
-    arg = isl_ast_expr_div(arg, div);
+    arg = autosa_ast_expr_strength_reduce(isl_ast_expr_div(arg, div));
     local_index_packed = isl_ast_expr_set_op_arg(local_index_packed, n_arg - 1, arg);
   }
 
@@ -2359,7 +2665,7 @@ __isl_give isl_printer *autosa_kernel_print_io(__isl_take isl_printer *p,
       p = isl_printer_print_ast_expr(p, local_index_packed);
       p = isl_printer_print_str(p, " = ");
       if (hls->target == XILINX_HW)
-        p = print_fifo_rw_xilinx(p, fifo_name, 1);
+        p = print_fifo_rw_xilinx(p, fifo_name, 1, hls);
       else if (hls->target == INTEL_HW)
         p = print_fifo_rw_intel(p, fifo_name, 1);
     }
@@ -2367,7 +2673,7 @@ __isl_give isl_printer *autosa_kernel_print_io(__isl_take isl_printer *p,
     {
       /* fifo.write(local[]) */
       if (hls->target == XILINX_HW)
-        p = print_fifo_rw_xilinx(p, fifo_name, 0);
+        p = print_fifo_rw_xilinx(p, fifo_name, 0, hls);
       else if (hls->target == INTEL_HW)
         p = print_fifo_rw_intel(p, fifo_name, 0);
       p = isl_printer_print_ast_expr(p, local_index_packed);
@@ -2394,7 +2700,7 @@ __isl_give isl_printer *autosa_kernel_print_io(__isl_take isl_printer *p,
       p = isl_printer_start_line(p);
       p = isl_printer_print_str(p, "fifo_data = ");
       if (hls->target == XILINX_HW)
-        p = print_fifo_rw_xilinx(p, fifo_name, 1);
+        p = print_fifo_rw_xilinx(p, fifo_name, 1, hls);
       else if (hls->target == INTEL_HW)
         p = print_fifo_rw_intel(p, fifo_name, 1);
       p = isl_printer_print_str(p, ";");
@@ -2421,7 +2727,7 @@ __isl_give isl_printer *autosa_kernel_print_io(__isl_take isl_printer *p,
         isl_ast_expr *expr = stmt->u.i.local_index;
         int n_arg = isl_ast_expr_op_get_n_arg(expr);
         /* Union */
-        if (nxt_data_pack == 1)
+        if (nxt_data_pack == 1 && !group->array->hls_type)
         {
           /* union {unsigned int ui; float ut;} u; */
           p = isl_printer_start_line(p);
@@ -2461,14 +2767,25 @@ __isl_give isl_printer *autosa_kernel_print_io(__isl_take isl_printer *p,
           isl_ast_expr_free(op);
         }
 
-        p = isl_printer_print_str(p, " = ");
-        if (nxt_data_pack == 1)
+        if (nxt_data_pack == 1 && group->array->hls_type)
+        {
+          /* local[][n].range(W - 1, 0) = fifo_data(W - 1, 0); */
+          p = isl_printer_print_str(p, ".range(");
+          p = isl_printer_print_int(p, group->array->size * 8 - 1);
+          p = isl_printer_print_str(p, ", 0) = fifo_data(");
+          p = isl_printer_print_int(p, group->array->size * 8 - 1);
+          p = isl_printer_print_str(p, ", 0);");
+          p = isl_printer_end_line(p);
+        }
+        else if (nxt_data_pack == 1)
         {
+          p = isl_printer_print_str(p, " = ");
           p = isl_printer_print_str(p, "u.ut;");
           p = isl_printer_end_line(p);
         }
         else
         {
+          p = isl_printer_print_str(p, " = ");
           p = isl_printer_print_str(p, "fifo_data(");
           p = isl_printer_print_int(p, group->array->size * 8 * nxt_data_pack - 1);
           p = isl_printer_print_str(p, ", 0)");
@@ -2497,7 +2814,7 @@ __isl_give isl_printer *autosa_kernel_print_io(__isl_take isl_printer *p,
     {
       if (hls->target == XILINX_HW)
       {
-        if (nxt_data_pack == 1)
+        if (nxt_data_pack == 1 && !group->array->hls_type)
         {
           /* union {unsigned int ui; float ut;} u1, u0; */
           p = isl_printer_start_line(p);
@@ -2567,7 +2884,7 @@ __isl_give isl_printer *autosa_kernel_print_io(__isl_take isl_printer *p,
           if (!first)
             p = isl_printer_print_str(p, ", ");
 
-          if (nxt_data_pack == 1)
+          if (nxt_data_pack == 1 && !group->array->hls_type)
           {
             p = isl_printer_print_str(p, "ap_uint<");
             p = isl_printer_print_int(p, group->array->size * 8 * nxt_data_pack);
@@ -2577,6 +2894,12 @@ __isl_give isl_printer *autosa_kernel_print_io(__isl_take isl_printer *p,
           }
           else
           {
+            if (nxt_data_pack == 1)
+            {
+              p = isl_printer_print_str(p, "ap_uint<");
+              p = isl_printer_print_int(p, group->array->size * 8);
+              p = isl_printer_print_str(p, ">(");
+            }
             op = isl_ast_expr_op_get_arg(expr, 0);
             p = isl_printer_print_ast_expr(p, op);
             isl_ast_expr_free(op);
@@ -2595,6 +2918,12 @@ __isl_give isl_printer *autosa_kernel_print_io(__isl_take isl_printer *p,
               p = isl_printer_print_str(p, "]");
               isl_ast_expr_free(op);
             }
+            if (nxt_data_pack == 1)
+            {
+              p = isl_printer_print_str(p, ".range(");
+              p = isl_printer_print_int(p, group->array->size * 8 - 1);
+              p = isl_printer_print_str(p, ", 0))");
+            }
           }
           first = 0;
         }
@@ -2602,7 +2931,7 @@ __isl_give isl_printer *autosa_kernel_print_io(__isl_take isl_printer *p,
         p = isl_printer_end_line(p);
 
         p = isl_printer_start_line(p);
-        p = print_fifo_rw_xilinx(p, fifo_name, 0);
+        p = print_fifo_rw_xilinx(p, fifo_name, 0, hls);
         p = isl_printer_print_str(p, "fifo_data);");
         p = isl_printer_end_line(p);
       }
@@ -2675,7 +3004,7 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_default(
     n_arg = isl_ast_expr_get_op_n_arg(local_index_packed);
     arg = isl_ast_expr_get_op_arg(local_index_packed, n_arg - 1);
     div = isl_ast_expr_from_val(isl_val_int_from_si(ctx, n_lane));
-    arg = isl_ast_expr_div(arg, div);
+    arg = autosa_ast_expr_strength_reduce(isl_ast_expr_div(arg, div));
     local_index_packed = isl_ast_expr_set_op_arg(local_index_packed, n_arg - 1, arg);
   }
 
@@ -2702,7 +3031,7 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_default(
     p = isl_printer_print_str(p, "fifo_data");
     p = isl_printer_print_str(p, " = ");
     if (hls->target == XILINX_HW)
-      p = print_fifo_rw_xilinx(p, fifo_name, 1);
+      p = print_fifo_rw_xilinx(p, fifo_name, 1, hls);
     else if (hls->target == INTEL_HW)
       p = print_fifo_rw_intel(p, fifo_name, 1);
     p = isl_printer_print_str(p, ";");
@@ -2736,7 +3065,7 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_default(
       fifo_name = concat(ctx, stmt->u.i.fifo_name, "local_out");
       p = isl_printer_start_line(p);
       if (hls->target == XILINX_HW)
-        p = print_fifo_rw_xilinx(p, fifo_name, 0);
+        p = print_fifo_rw_xilinx(p, fifo_name, 0, hls);
       else if (hls->target == INTEL_HW)
         p = print_fifo_rw_intel(p, fifo_name, 0);
       p = isl_printer_print_str(p, "fifo_data);");
@@ -2756,7 +3085,7 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_default(
       fifo_name = concat(ctx, stmt->u.i.fifo_name, "out");
       p = isl_printer_start_line(p);
       if (hls->target == XILINX_HW)
-        p = print_fifo_rw_xilinx(p, fifo_name, 0);
+        p = print_fifo_rw_xilinx(p, fifo_name, 0, hls);
       else if (hls->target == INTEL_HW)
         p = print_fifo_rw_intel(p, fifo_name, 0);
       p = isl_printer_print_str(p, "fifo_data);");
@@ -2800,7 +3129,7 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_default(
       p = isl_printer_start_line(p);
       p = isl_printer_print_str(p, "fifo_data = ");
       if (hls->target == XILINX_HW)
-        p = print_fifo_rw_xilinx(p, fifo_name, 1);
+        p = print_fifo_rw_xilinx(p, fifo_name, 1, hls);
       else if (hls->target == INTEL_HW)
         p = print_fifo_rw_intel(p, fifo_name, 1);
       p = isl_printer_print_str(p, ";");
@@ -2821,7 +3150,7 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_default(
       p = isl_printer_start_line(p);
       p = isl_printer_print_str(p, "fifo_data = ");
       if (hls->target == XILINX_HW)
-        p = print_fifo_rw_xilinx(p, fifo_name, 1);
+        p = print_fifo_rw_xilinx(p, fifo_name, 1, hls);
       else if (hls->target == INTEL_HW)
         p = print_fifo_rw_intel(p, fifo_name, 1);
       p = isl_printer_print_str(p, ";");
@@ -2838,7 +3167,7 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_default(
     fifo_name = concat(ctx, stmt->u.i.fifo_name, "out");
     p = isl_printer_start_line(p);
     if (hls->target == XILINX_HW)
-      p = print_fifo_rw_xilinx(p, fifo_name, 0);
+      p = print_fifo_rw_xilinx(p, fifo_name, 0, hls);
     else if (hls->target == INTEL_HW)
       p = print_fifo_rw_intel(p, fifo_name, 0);
     p = isl_printer_print_str(p, "fifo_data);");
@@ -2851,6 +3180,64 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_default(
   return p;
 }
 
+/* Print the remainder of the integer division of "expr" by "r",
+ * as a mask if "r" is a power of two.
+ */
+static __isl_give isl_printer *print_mod(__isl_take isl_printer *p,
+                                         const char *expr, int r)
+{
+  p = isl_printer_print_str(p, "(");
+  p = isl_printer_print_str(p, expr);
+  if (r > 0 && (r & (r - 1)) == 0)
+  {
+    p = isl_printer_print_str(p, " & ");
+    p = isl_printer_print_int(p, r - 1);
+  }
+  else
+  {
+    p = isl_printer_print_str(p, " % ");
+    p = isl_printer_print_int(p, r);
+  }
+  p = isl_printer_print_str(p, ")");
+
+  return p;
+}
+
+/* Print the declaration of the buffer "buf_data_split" splitting
+ * the data packed by "n_lane" of the I/O group "group" into the data
+ * packed by "nxt_n_lane".
+ */
+__isl_give isl_printer *autosa_print_io_split_buf(__isl_take isl_printer *p,
+                                                  struct autosa_array_ref_group *group, int n_lane, int nxt_n_lane,
+                                                  struct hls_info *hls)
+{
+  p = isl_printer_start_line(p);
+  if (nxt_n_lane == 1)
+  {
+    p = isl_printer_print_str(p, "ap_uint<");
+    p = isl_printer_print_int(p, group->array->size * 8);
+    p = isl_printer_print_str(p, ">");
+  }
+  else
+  {
+    p = isl_printer_print_str(p, group->array->name);
+    p = isl_printer_print_str(p, "_t");
+    p = isl_printer_print_int(p, nxt_n_lane);
+  }
+  p = isl_printer_print_str(p, " buf_data_split[");
+  p = isl_printer_print_int(p, n_lane / nxt_n_lane);
+  p = isl_printer_print_str(p, "];");
+  p = isl_printer_end_line(p);
+  if (hls->target == XILINX_HW)
+  {
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "#pragma HLS ARRAY_PARTITION variable=buf_data_split complete");
+    p = isl_printer_end_line(p);
+  }
+
+  return p;
+}
+
 /* Print an I/O transfer statement.
  * is_filter = 0
  * is_buf = 1
@@ -2893,6 +3280,8 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_data_pack(
 
   char *fifo_name;
   isl_ast_expr *expr, *op;
+  isl_printer *p_str;
+  char *op_str;
   int n_arg;
   int r;
   isl_val *val;
@@ -2905,7 +3294,7 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_data_pack(
     n_arg = isl_ast_expr_get_op_n_arg(local_index_packed);
     arg = isl_ast_expr_get_op_arg(local_index_packed, n_arg - 1);
     div = isl_ast_expr_from_val(isl_val_int_from_si(ctx, n_lane));
-    arg = isl_ast_expr_div(arg, div);
+    arg = autosa_ast_expr_strength_reduce(isl_ast_expr_div(arg, div));
     local_index_packed = isl_ast_expr_set_op_arg(local_index_packed, n_arg - 1, arg);
   }
 
@@ -2935,39 +3324,18 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_data_pack(
   p = isl_printer_end_line(p);
 
   /* [type] buf_data_split[]; */
-  // TODO: move it outside the loop.
-  p = isl_printer_start_line(p);
-  if (nxt_n_lane == 1)
-  {
-    p = isl_printer_print_str(p, "ap_uint<");
-    p = isl_printer_print_int(p, group->array->size * 8);
-    p = isl_printer_print_str(p, ">");
-  }
-  else
-  {
-    p = isl_printer_print_str(p, group->array->name);
-    p = isl_printer_print_str(p, "_t");
-    p = isl_printer_print_int(p, nxt_n_lane);
-  }
-  p = isl_printer_print_str(p, " buf_data_split[");
-  p = isl_printer_print_int(p, n_lane / nxt_n_lane);
-  p = isl_printer_print_str(p, "];");
-  p = isl_printer_end_line(p);
-  if (hls->target == XILINX_HW)
-  {
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "#pragma HLS ARRAY_PARTITION variable=buf_data_split complete");
-    p = isl_printer_end_line(p);
-  }
+  if (!hls->split_buf_lifted)
+    p = autosa_print_io_split_buf(p, group, n_lane, nxt_n_lane, hls);
 
   if (stmt->u.i.in && stmt->u.i.coalesce_depth >= 0)
   {
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "if (c");
+    char iter[20];
+
     // TODO: print the iterator index.
-    p = isl_printer_print_int(p, stmt->u.i.coalesce_depth);
-    p = isl_printer_print_str(p, " % ");
-    p = isl_printer_print_int(p, n_lane / nxt_n_lane);
+    sprintf(iter, "c%d", stmt->u.i.coalesce_depth);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "if (");
+    p = print_mod(p, iter, n_lane / nxt_n_lane);
     p = isl_printer_print_str(p, " == 0) {");
     p = isl_printer_end_line(p);
     p = isl_printer_indent(p, 4);
@@ -3023,13 +3391,20 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_data_pack(
   r = n_lane / nxt_n_lane;
   val = isl_val_int_from_si(ctx, nxt_n_lane);
   op = isl_ast_expr_div(op, isl_ast_expr_from_val(val));
+  op = autosa_ast_expr_strength_reduce(op);
+  p_str = isl_printer_to_str(ctx);
+  p_str = isl_printer_set_output_format(p_str, ISL_FORMAT_C);
+  p_str = isl_printer_print_str(p_str, "(");
+  p_str = isl_printer_print_ast_expr(p_str, op);
+  p_str = isl_printer_print_str(p_str, ")");
+  op_str = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
   p = isl_printer_start_line(p);
-  p = isl_printer_print_str(p, "int split_i = (");
-  p = isl_printer_print_ast_expr(p, op);
-  p = isl_printer_print_str(p, ") % ");
-  p = isl_printer_print_int(p, r);
+  p = isl_printer_print_str(p, "int split_i = ");
+  p = print_mod(p, op_str, r);
   p = isl_printer_print_str(p, ";");
   p = isl_printer_end_line(p);
+  free(op_str);
   isl_ast_expr_free(op);
   isl_ast_expr_free(expr);
 
@@ -3041,7 +3416,7 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_data_pack(
     p = isl_printer_start_line(p);
     p = isl_printer_print_str(p, "fifo_data = ");
     if (hls->target == XILINX_HW)
-      p = print_fifo_rw_xilinx(p, fifo_name, 1);
+      p = print_fifo_rw_xilinx(p, fifo_name, 1, hls);
     else if (hls->target == INTEL_HW)
       p = print_fifo_rw_intel(p, fifo_name, 1);
     p = isl_printer_print_str(p, ";");
@@ -3049,7 +3424,7 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_data_pack(
 
     if (hls->target == XILINX_HW)
     {
-      if (nxt_n_lane == 1)
+      if (nxt_n_lane == 1 && !group->array->hls_type)
       {
         p = isl_printer_start_line(p);
         p = isl_printer_print_str(p, "union {unsigned int ui; ");
@@ -3068,7 +3443,13 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_data_pack(
     p = isl_printer_print_str(p, "buf_data_split[split_i] = ");
     if (hls->target == XILINX_HW)
     {
-      if (nxt_n_lane == 1)
+      if (nxt_n_lane == 1 && group->array->hls_type)
+      {
+        p = isl_printer_print_str(p, "fifo_data.range(");
+        p = isl_printer_print_int(p, group->array->size * 8 - 1);
+        p = isl_printer_print_str(p, ", 0);");
+      }
+      else if (nxt_n_lane == 1)
       {
         p = isl_printer_print_str(p, "ap_uint<");
         p = isl_printer_print_int(p, group->array->size * 8);
@@ -3083,11 +3464,12 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_data_pack(
 
     if (stmt->u.i.coalesce_depth >= 0)
     {
+      char iter[20];
+
+      sprintf(iter, "c%d", stmt->u.i.coalesce_depth);
       p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "if (c");
-      p = isl_printer_print_int(p, stmt->u.i.coalesce_depth);
-      p = isl_printer_print_str(p, " % ");
-      p = isl_printer_print_int(p, n_lane / nxt_n_lane);
+      p = isl_printer_print_str(p, "if (");
+      p = print_mod(p, iter, n_lane / nxt_n_lane);
       p = isl_printer_print_str(p, " == ");
       p = isl_printer_print_int(p, n_lane / nxt_n_lane);
       p = isl_printer_print_str(p, " - 1 || c");
@@ -3139,7 +3521,7 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_data_pack(
 
     if (hls->target == XILINX_HW)
     {
-      if (nxt_n_lane == 1)
+      if (nxt_n_lane == 1 && !group->array->hls_type)
       {
         p = isl_printer_start_line(p);
         p = isl_printer_print_str(p, "union {unsigned int ui; ");
@@ -3155,10 +3537,23 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_data_pack(
 
     /* fifo_data = Reinterpret<>(buf_data_split[...]); */
     p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "fifo_data = ");
+    if (hls->target == XILINX_HW && nxt_n_lane == 1 && group->array->hls_type)
+    {
+      p = isl_printer_print_str(p, "fifo_data.range(");
+      p = isl_printer_print_int(p, group->array->size * 8 - 1);
+      p = isl_printer_print_str(p, ", 0) = ");
+    }
+    else
+    {
+      p = isl_printer_print_str(p, "fifo_data = ");
+    }
     if (hls->target == XILINX_HW)
     {
-      if (nxt_n_lane == 1)
+      if (nxt_n_lane == 1 && group->array->hls_type)
+      {
+        p = isl_printer_print_str(p, "buf_data_split[split_i]");
+      }
+      else if (nxt_n_lane == 1)
       {
         p = isl_printer_print_str(p, "u.ut");
       }
@@ -3173,7 +3568,7 @@ static __isl_give isl_printer *autosa_kernel_print_io_transfer_data_pack(
     /* fifo.write(fifo_data); */
     p = isl_printer_start_line(p);
     if (hls->target == XILINX_HW)
-      p = print_fifo_rw_xilinx(p, fifo_name, 0);
+      p = print_fifo_rw_xilinx(p, fifo_name, 0, hls);
     else if (hls->target == INTEL_HW)
       p = print_fifo_rw_intel(p, fifo_name, 0);
     p = isl_printer_print_str(p, "fifo_data);");
@@ -3242,6 +3637,31 @@ static __isl_give isl_printer *io_stmt_print_global_index(
   return p;
 }
 
+/* Print an access to the element in the global memory copy
+ * described by the I/O dram statement "stmt".
+ * If the array is serialized by the host, the elements are stored in
+ * the order of the accesses and "serialize_cnt" is used as the index instead,
+ * or the elements are read from the QDMA stream if the array is streamed.
+ */
+static __isl_give isl_printer *io_stmt_print_dram_index(
+    __isl_take isl_printer *p, struct autosa_kernel_stmt *stmt)
+{
+  isl_ast_expr *arg;
+
+  if (!stmt->u.i.local_array->host_serialize)
+    return io_stmt_print_global_index(p, stmt);
+
+  arg = isl_ast_expr_get_op_arg(stmt->u.i.index, 0);
+  p = isl_printer_print_ast_expr(p, arg);
+  isl_ast_expr_free(arg);
+  if (stmt->u.i.local_array->host_stream)
+    p = isl_printer_print_str(p, ".read()");
+  else
+    p = isl_printer_print_str(p, "[serialize_cnt++]");
+
+  return p;
+}
+
 /* Print an drain merge statement.
  *
  * [group_array_prefix]_to[...] = [group_array_prefix]_from[...]
@@ -3333,6 +3753,16 @@ __isl_give isl_printer *autosa_kernel_print_drain_merge(__isl_take isl_printer *
  *  fifo_data = fifo.read();
  *  global = fifo_data;
  *
+ * If the array is compressed by the host into its non-zero blocks,
+ * the header of each block is read first, and zeros are forwarded
+ * for the dropped blocks.
+ *
+ * In the processes of a prefetching I/O module (hls->prefetch set),
+ * the accesses to the external memory are decoupled from the rest of
+ * the statement by the FIFO "fifo_prefetch". The DRAM process
+ * (hls->prefetch = 1) only accesses the external memory and the FIFO,
+ * while the body process (hls->prefetch = 2) accesses the FIFO instead
+ * of the external memory.
  */
 __isl_give isl_printer *autosa_kernel_print_io_dram(__isl_take isl_printer *p,
                                                     struct autosa_kernel_stmt *stmt, struct hls_info *hls)
@@ -3353,7 +3783,7 @@ __isl_give isl_printer *autosa_kernel_print_io_dram(__isl_take isl_printer *p,
     n_arg = isl_ast_expr_get_op_n_arg(local_index_packed);
     arg = isl_ast_expr_get_op_arg(local_index_packed, n_arg - 1);
     div = isl_ast_expr_from_val(isl_val_int_from_si(ctx, n_lane));
-    arg = isl_ast_expr_div(arg, div);
+    arg = autosa_ast_expr_strength_reduce(isl_ast_expr_div(arg, div));
     local_index_packed = isl_ast_expr_set_op_arg(local_index_packed, n_arg - 1, arg);
   }
 
@@ -3378,20 +3808,63 @@ __isl_give isl_printer *autosa_kernel_print_io_dram(__isl_take isl_printer *p,
   p = isl_printer_print_str(p, " fifo_data;");
   p = isl_printer_end_line(p);
 
-  if (stmt->u.i.in)
+  if (stmt->u.i.in && hls->prefetch == 2)
+  {
+    p = print_str_new_line(p, "fifo_data = fifo_prefetch.read();");
+  }
+  else if (stmt->u.i.in && stmt->u.i.local_array->host_sparse_block > 0)
+  {
+    /* Read the header of the block and skip the zero blocks. */
+    p = print_str_new_line(p, "if (sparse_blk == 0)");
+    p = isl_printer_indent(p, 2);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "sparse_valid = (");
+    p = io_stmt_print_dram_index(p, stmt);
+    p = isl_printer_print_str(p, " != 0);");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, -2);
+    p = print_str_new_line(p, "if (sparse_valid)");
+    p = isl_printer_indent(p, 2);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "fifo_data = ");
+    p = io_stmt_print_dram_index(p, stmt);
+    p = isl_printer_print_str(p, ";");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, -2);
+    p = print_str_new_line(p, "else");
+    p = isl_printer_indent(p, 2);
+    p = print_str_new_line(p, "fifo_data = 0;");
+    p = isl_printer_indent(p, -2);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "if (++sparse_blk == ");
+    p = isl_printer_print_int(p, stmt->u.i.local_array->host_sparse_block);
+    p = isl_printer_print_str(p, ")");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, 2);
+    p = print_str_new_line(p, "sparse_blk = 0;");
+    p = isl_printer_indent(p, -2);
+  }
+  else if (stmt->u.i.in)
   {
     p = isl_printer_start_line(p);
     p = isl_printer_print_str(p, "fifo_data = ");
-    p = io_stmt_print_global_index(p, stmt);
+    p = io_stmt_print_dram_index(p, stmt);
     p = isl_printer_print_str(p, ";");
     p = isl_printer_end_line(p);
+  }
 
-    if (!buf)
+  if (stmt->u.i.in)
+  {
+    if (hls->prefetch == 1)
+    {
+      p = print_str_new_line(p, "fifo_prefetch.write(fifo_data);");
+    }
+    else if (!buf)
     {
       fifo_name = concat(ctx, stmt->u.i.fifo_name, "out");
       p = isl_printer_start_line(p);
       if (hls->target == XILINX_HW)
-        p = print_fifo_rw_xilinx(p, fifo_name, 0);
+        p = print_fifo_rw_xilinx(p, fifo_name, 0, hls);
       else if (hls->target == INTEL_HW)
         p = print_fifo_rw_intel(p, fifo_name, 0);
       p = isl_printer_print_str(p, "fifo_data);");
@@ -3408,13 +3881,17 @@ __isl_give isl_printer *autosa_kernel_print_io_dram(__isl_take isl_printer *p,
   }
   else
   {
-    if (!buf)
+    if (hls->prefetch == 1)
+    {
+      p = print_str_new_line(p, "fifo_data = fifo_prefetch.read();");
+    }
+    else if (!buf)
     {
       p = isl_printer_start_line(p);
       p = isl_printer_print_str(p, "fifo_data = ");
       fifo_name = concat(ctx, stmt->u.i.fifo_name, "in");
       if (hls->target == XILINX_HW)
-        p = print_fifo_rw_xilinx(p, fifo_name, 1);
+        p = print_fifo_rw_xilinx(p, fifo_name, 1, hls);
       else if (hls->target == INTEL_HW)
         p = print_fifo_rw_intel(p, fifo_name, 1);
       p = isl_printer_print_str(p, ";");
@@ -3430,10 +3907,17 @@ __isl_give isl_printer *autosa_kernel_print_io_dram(__isl_take isl_printer *p,
       p = isl_printer_end_line(p);
     }
 
-    p = isl_printer_start_line(p);
-    p = io_stmt_print_global_index(p, stmt);
-    p = isl_printer_print_str(p, " = fifo_data;");
-    p = isl_printer_end_line(p);
+    if (hls->prefetch == 2)
+    {
+      p = print_str_new_line(p, "fifo_prefetch.write(fifo_data);");
+    }
+    else
+    {
+      p = isl_printer_start_line(p);
+      p = io_stmt_print_dram_index(p, stmt);
+      p = isl_printer_print_str(p, " = fifo_data;");
+      p = isl_printer_end_line(p);
+    }
   }
 
   p = isl_printer_indent(p, -2);
@@ -3457,6 +3941,7 @@ static __isl_give isl_printer *print_inter_trans_module_call(
   p = isl_printer_print_str(p, "_inter_trans");
   if (boundary)
     p = isl_printer_print_str(p, "_boundary");
+  p = print_module_template(p, kernel, module, 0, hls->target);
   p = isl_printer_print_str(p, "(");
   p = print_module_arguments(p, prog, kernel, module, 0,
                              hls->target, 1, arb, boundary);
@@ -3513,7 +3998,9 @@ static __isl_give isl_printer *print_intra_trans_module_call(
 {
   p = isl_printer_start_line(p);
   p = isl_printer_print_str(p, module->name);
-  p = isl_printer_print_str(p, "_intra_trans(");
+  p = isl_printer_print_str(p, "_intra_trans");
+  p = print_module_template(p, kernel, module, 0, hls->target);
+  p = isl_printer_print_str(p, "(");
   p = print_module_arguments(p, prog, kernel, module, 0, hls->target, 0, arb, 0);
   p = isl_printer_print_str(p, ");");
   p = isl_printer_end_line(p);
@@ -3702,3 +4189,42 @@ __isl_give isl_printer *autosa_kernel_print_state_handle(
 
   return p;
 }
+
+/* Print the credit control of the I/O modules.
+ * The module reading the array waits for a credit before each array
+ * partition once it has run ahead of the module writing the array by
+ * "module->credit" array partitions, which returns a credit after each
+ * array partition.
+ */
+__isl_give isl_printer *autosa_kernel_print_credit(
+    __isl_take isl_printer *p,
+    struct autosa_kernel_stmt *stmt, struct hls_info *hls)
+{
+  struct autosa_hw_module *module = stmt->u.f.module;
+
+  if (hls->target != XILINX_HW)
+    return p;
+
+  if (module->in)
+  {
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "if (credit_cnt == ");
+    p = isl_printer_print_int(p, module->credit);
+    p = isl_printer_print_str(p, ") {");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, 4);
+    p = print_str_new_line(p, "int token = credit.read();");
+    p = isl_printer_indent(p, -4);
+    p = print_str_new_line(p, "} else {");
+    p = isl_printer_indent(p, 4);
+    p = print_str_new_line(p, "credit_cnt++;");
+    p = isl_printer_indent(p, -4);
+    p = print_str_new_line(p, "}");
+  }
+  else
+  {
+    p = print_str_new_line(p, "credit.write(1);");
+  }
+
+  return p;
+}
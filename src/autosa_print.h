@@ -7,7 +7,7 @@
 
 /* Arrays */
 __isl_give isl_printer *autosa_array_info_print_call_argument(
-    __isl_take isl_printer *p, struct autosa_array_info *array);
+    __isl_take isl_printer *p, struct autosa_array_info *array, int n_ref);
 __isl_give isl_printer *autosa_array_ref_group_print_prefix(
     struct autosa_array_ref_group *group, __isl_take isl_printer *p);
 __isl_give isl_printer *autosa_array_ref_group_print_fifo_name(
@@ -86,6 +86,9 @@ __isl_give isl_printer *autosa_kernel_print_io(__isl_take isl_printer *p,
 __isl_give isl_printer *autosa_kernel_print_io_transfer(
     __isl_take isl_printer *p,
     struct autosa_kernel_stmt *stmt, struct hls_info *hls);
+__isl_give isl_printer *autosa_print_io_split_buf(__isl_take isl_printer *p,
+                                                  struct autosa_array_ref_group *group, int n_lane, int nxt_n_lane,
+                                                  struct hls_info *hls);
 __isl_give isl_printer *autosa_kernel_print_io_dram(__isl_take isl_printer *p,
                                                     struct autosa_kernel_stmt *stmt, struct hls_info *hls);
 __isl_give isl_printer *autosa_kernel_print_inter_trans(
@@ -103,15 +106,28 @@ __isl_give isl_printer *autosa_kernel_print_inter_intra(
 __isl_give isl_printer *autosa_kernel_print_state_handle(
     __isl_take isl_printer *p,
     struct autosa_kernel_stmt *stmt, struct hls_info *hls);
+__isl_give isl_printer *autosa_kernel_print_credit(
+    __isl_take isl_printer *p,
+    struct autosa_kernel_stmt *stmt, struct hls_info *hls);
 __isl_give isl_printer *autosa_kernel_print_drain_merge(
     __isl_take isl_printer *p,
     struct autosa_kernel_stmt *stmt, struct hls_info *hls);
 
+int autosa_kernel_is_persistent(struct autosa_kernel *kernel,
+                                enum platform target);
+int autosa_module_is_template(struct autosa_kernel *kernel,
+                              struct autosa_hw_module *module,
+                              enum platform target);
+__isl_give isl_printer *print_module_template(__isl_take isl_printer *p,
+                                              struct autosa_kernel *kernel,
+                                              struct autosa_hw_module *module,
+                                              int types, enum platform target);
+
 /* Xilinx-specific */
 __isl_give isl_printer *print_fifo_type_xilinx(__isl_take isl_printer *p,
                                                struct autosa_array_ref_group *group, int n_lane);
 __isl_give isl_printer *print_fifo_rw_xilinx(__isl_take isl_printer *p,
-                                             const char *fifo_name, int read);
+                                             const char *fifo_name, int read, struct hls_info *hls);
 
 /* Intel-specific */
 __isl_give isl_printer *print_fifo_type_intel(__isl_take isl_printer *p,
@@ -0,0 +1,176 @@
+/* Defines functions for profiling the compilation phases of AutoSA.
+ *
+ * Each phase records its wall time and the peak resident set size of the
+ * process at the end of the phase. Phases can be nested. The phases are
+ * dumped out in the Chrome trace format, which can be viewed in
+ * chrome://tracing or Perfetto.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include <cJSON/cJSON.h>
+
+#include "autosa_profile.h"
+
+/* A profiled phase.
+ * "start" and "dur" are in microseconds.
+ * "rss" is the peak resident set size (in KB) at the end of the phase,
+ * and "rss_inc" is its increase during the phase.
+ */
+struct autosa_profile_event
+{
+  std::string name;
+  std::string cat;
+  int depth;
+  long start;
+  long dur;
+  long rss;
+  long rss_inc;
+};
+
+/* "events" contains all the phases in the order they are started.
+ * "stack" contains the indices of the phases not yet ended.
+ */
+struct autosa_profile
+{
+  long start;
+  std::vector<struct autosa_profile_event> events;
+  std::vector<int> stack;
+};
+
+static long profile_now()
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  return (long)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/* Return the peak resident set size of the process in KB. */
+static long profile_peak_rss()
+{
+  struct rusage usage;
+
+  if (getrusage(RUSAGE_SELF, &usage) < 0)
+    return 0;
+
+  return usage.ru_maxrss;
+}
+
+struct autosa_profile *autosa_profile_alloc()
+{
+  struct autosa_profile *profile = new autosa_profile;
+
+  profile->start = profile_now();
+
+  return profile;
+}
+
+void autosa_profile_free(struct autosa_profile *profile)
+{
+  delete profile;
+}
+
+/* Start the phase "name" of the category "cat".
+ * Nothing is done if profiling is disabled, i.e., "profile" is NULL.
+ */
+void autosa_profile_begin(struct autosa_profile *profile, const char *name,
+                          const char *cat)
+{
+  struct autosa_profile_event event;
+
+  if (!profile)
+    return;
+
+  event.name = name;
+  event.cat = cat;
+  event.depth = profile->stack.size();
+  event.start = profile_now() - profile->start;
+  event.dur = 0;
+  event.rss = profile_peak_rss();
+  event.rss_inc = 0;
+  profile->stack.push_back(profile->events.size());
+  profile->events.push_back(event);
+}
+
+/* End the most recently started phase. */
+void autosa_profile_end(struct autosa_profile *profile)
+{
+  struct autosa_profile_event *event;
+  long rss;
+
+  if (!profile || profile->stack.empty())
+    return;
+
+  event = &profile->events[profile->stack.back()];
+  profile->stack.pop_back();
+  rss = profile_peak_rss();
+  event->dur = profile_now() - profile->start - event->start;
+  event->rss_inc = rss - event->rss;
+  event->rss = rss;
+}
+
+/* Dump out the profiled phases to the file "path" in the Chrome trace
+ * format and print the summary of the top-level phases.
+ * The phases not yet ended are ended first.
+ */
+isl_stat autosa_profile_dump(struct autosa_profile *profile, const char *path)
+{
+  cJSON *trace, *events_json;
+  FILE *fp;
+  char *content;
+
+  if (!profile)
+    return isl_stat_ok;
+
+  while (!profile->stack.empty())
+    autosa_profile_end(profile);
+
+  trace = cJSON_CreateObject();
+  events_json = cJSON_CreateArray();
+  cJSON_AddItemToObject(trace, "traceEvents", events_json);
+  for (int i = 0; i < profile->events.size(); i++)
+  {
+    struct autosa_profile_event *event = &profile->events[i];
+    cJSON *event_json = cJSON_CreateObject();
+    cJSON *args_json = cJSON_CreateObject();
+
+    cJSON_AddItemToObject(event_json, "name", cJSON_CreateString(event->name.c_str()));
+    cJSON_AddItemToObject(event_json, "cat", cJSON_CreateString(event->cat.c_str()));
+    cJSON_AddItemToObject(event_json, "ph", cJSON_CreateString("X"));
+    cJSON_AddItemToObject(event_json, "ts", cJSON_CreateNumber(event->start));
+    cJSON_AddItemToObject(event_json, "dur", cJSON_CreateNumber(event->dur));
+    cJSON_AddItemToObject(event_json, "pid", cJSON_CreateNumber(1));
+    cJSON_AddItemToObject(event_json, "tid", cJSON_CreateNumber(1));
+    cJSON_AddItemToObject(args_json, "peak_rss_kb", cJSON_CreateNumber(event->rss));
+    cJSON_AddItemToObject(args_json, "peak_rss_inc_kb", cJSON_CreateNumber(event->rss_inc));
+    cJSON_AddItemToObject(event_json, "args", args_json);
+    cJSON_AddItemToArray(events_json, event_json);
+
+    if (event->depth <= 1)
+      printf("[AutoSA] Profile: %*s%s: %.3f s, peak RSS: %ld KB\n",
+             2 * event->depth, "", event->name.c_str(), event->dur / 1e6,
+             event->rss);
+  }
+
+  fp = fopen(path, "w");
+  if (!fp)
+  {
+    printf("[AutoSA] Error: Cannot open file: %s\n", path);
+    cJSON_Delete(trace);
+    return isl_stat_error;
+  }
+  content = cJSON_Print(trace);
+  fprintf(fp, "%s", content);
+  fclose(fp);
+  free(content);
+  cJSON_Delete(trace);
+
+  return isl_stat_ok;
+}
@@ -0,0 +1,17 @@
+/* Defines functions for profiling the compilation phases of AutoSA. */
+
+#ifndef _AUTOSA_PROFILE_H
+#define _AUTOSA_PROFILE_H
+
+#include <isl/ctx.h>
+
+struct autosa_profile;
+
+struct autosa_profile *autosa_profile_alloc();
+void autosa_profile_free(struct autosa_profile *profile);
+void autosa_profile_begin(struct autosa_profile *profile, const char *name,
+                          const char *cat);
+void autosa_profile_end(struct autosa_profile *profile);
+isl_stat autosa_profile_dump(struct autosa_profile *profile, const char *path);
+
+#endif
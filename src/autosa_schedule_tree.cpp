@@ -5,6 +5,8 @@
 #include "autosa_common.h"
 #include "autosa_utils.h"
 #include "autosa_schedule_tree.h"
+#include "autosa_cache.h"
+#include "hybrid.h"
 
 static __isl_give isl_multi_val *multi_val_from_int_list(
     __isl_take isl_space *space, int *list)
@@ -364,6 +366,91 @@ isl_bool uniform_dep_check(__isl_keep isl_schedule *schedule, struct ppcg_scop *
   return isl_bool_true;
 }
 
+/* Skew the stencil found at the outermost band of "schedule", if any,
+ * such that its time loop and its space loops form a single fully
+ * permutable band that can be mapped to a systolic array.
+ *
+ * The stencil is detected with the input pattern of the hybrid tiling
+ * (see hybrid.c), i.e., an outer band with a single (time) member,
+ * whose child is a band with only coincident (space) members.
+ * The bounds on the relative dependence distances computed by
+ * ppcg_ht_compute_bounds satisfy d_i >= -lower_i d_0 for each space
+ * dimension i, such that each space dimension is skewed as
+ *
+ *	s_i' = s_i + ceil(lower_i) t
+ *
+ * to make all the dependence distances non-negative.
+ * Since the skewing factors are constants, the uniform dependences
+ * remain uniform.
+ * The schedule is returned unchanged if no such pattern is found.
+ */
+__isl_give isl_schedule *skew_stencil_schedule(__isl_take isl_schedule *schedule,
+                                               struct ppcg_scop *scop)
+{
+  isl_schedule_node *node, *child;
+  isl_multi_union_pw_aff *time, *space;
+  isl_union_pw_aff *t;
+  ppcg_ht_bounds *bounds;
+  isl_bool valid;
+  int n;
+
+  node = isl_schedule_get_root(schedule);
+  node = isl_schedule_node_child(node, 0);
+  valid = ppcg_ht_has_input_pattern(node);
+  if (valid != isl_bool_true)
+  {
+    isl_schedule_node_free(node);
+    return schedule;
+  }
+
+  bounds = ppcg_ht_compute_bounds(scop, node);
+  valid = ppcg_ht_bounds_is_valid(bounds);
+  if (valid != isl_bool_true)
+  {
+    printf("[AutoSA] Warning: The dependence distances of the stencil are not bounded, no skewing is applied.\n");
+    ppcg_ht_bounds_free(bounds);
+    isl_schedule_node_free(node);
+    return schedule;
+  }
+
+  time = isl_schedule_node_band_get_partial_schedule(node);
+  child = isl_schedule_node_get_child(node, 0);
+  space = isl_schedule_node_band_get_partial_schedule(child);
+  n = isl_schedule_node_band_n_member(child);
+  isl_schedule_node_free(child);
+
+  t = isl_multi_union_pw_aff_get_union_pw_aff(time, 0);
+  printf("[AutoSA] Stencil detected, the space loops are skewed by the time loop with factors: [");
+  for (int i = 0; i < n; i++)
+  {
+    isl_val *lower = ppcg_ht_bounds_get_lower(bounds, i);
+    isl_union_pw_aff *s;
+
+    lower = isl_val_ceil(lower);
+    printf("%s%ld", i > 0 ? "," : "", isl_val_get_num_si(lower));
+    s = isl_multi_union_pw_aff_get_union_pw_aff(space, i);
+    s = isl_union_pw_aff_add(s,
+                             isl_union_pw_aff_scale_val(isl_union_pw_aff_copy(t), lower));
+    space = isl_multi_union_pw_aff_set_union_pw_aff(space, i, s);
+  }
+  printf("]\n");
+  isl_union_pw_aff_free(t);
+  ppcg_ht_bounds_free(bounds);
+
+  /* Replace the pair of bands by the skewed band. */
+  node = isl_schedule_node_delete(node);
+  node = isl_schedule_node_delete(node);
+  node = isl_schedule_node_insert_partial_schedule(node,
+                                                   isl_multi_union_pw_aff_flat_range_product(time, space));
+  node = isl_schedule_node_band_set_permutable(node, 1);
+
+  isl_schedule_free(schedule);
+  schedule = isl_schedule_node_get_schedule(node);
+  isl_schedule_node_free(node);
+
+  return schedule;
+}
+
 /* Set *depth (initialized to 0 by the caller) to the maximum
  * of the schedule depths of the leaf nodes for which this function is called.
  */
@@ -603,6 +690,57 @@ __isl_give isl_schedule *loop_interchange_at_node(
   return schedule;
 }
 
+/* Skew the loop "level" of the band node "node" by the loop "src" with
+ * the factor "factor", i.e., replace the loop "level" by
+ * level + factor * src.
+ * The skewed loop is only coincident if both loops are coincident.
+ * The caller is responsible for checking the legality of the skew.
+ */
+__isl_give isl_schedule *loop_skew_at_node(
+    __isl_take isl_schedule_node *node, isl_size level, isl_size src, int factor)
+{
+  /* Obtain the partial schedule of the node. */
+  isl_multi_union_pw_aff *sc = isl_schedule_node_band_get_partial_schedule(node);
+  isl_ctx *ctx = isl_schedule_node_get_ctx(node);
+
+  /* Skew the schedule at level by the schedule at src. */
+  isl_union_pw_aff *upa = isl_multi_union_pw_aff_get_union_pw_aff(sc, level);
+  isl_union_pw_aff *upa_src = isl_multi_union_pw_aff_get_union_pw_aff(sc, src);
+  upa_src = isl_union_pw_aff_scale_val(upa_src, isl_val_int_from_si(ctx, factor));
+  upa = isl_union_pw_aff_add(upa, upa_src);
+  isl_multi_union_pw_aff *new_sc = isl_multi_union_pw_aff_copy(sc);
+  new_sc = isl_multi_union_pw_aff_set_union_pw_aff(new_sc, level, upa);
+
+  /* Insert a new schedule node with the new schedule. */
+  struct autosa_node_band_prop *prop = extract_node_band_prop(node);
+  node = isl_schedule_node_insert_partial_schedule(node, new_sc);
+
+  /* Update the properties of the new node. */
+  node = isl_schedule_node_band_set_permutable(node, 1);
+  for (int i = 0; i < isl_schedule_node_band_n_member(node); i++)
+  {
+    node = isl_schedule_node_band_member_set_coincident(node, i, prop->coincident[i]);
+    node = isl_schedule_node_band_member_set_pe_opt(node, i, prop->pe_opt[i]);
+    node = isl_schedule_node_band_member_set_space_time(node, i, prop->space_time[i]);
+  }
+  node = isl_schedule_node_band_member_set_coincident(node, level,
+                                                      prop->coincident[level] && prop->coincident[src]);
+
+  autosa_node_band_prop_free(prop);
+
+  /* Delete the old node after the current node */
+  node = isl_schedule_node_child(node, 0);
+  node = isl_schedule_node_delete(node);
+
+  /* Obtain the schedule from the schedule node. */
+  isl_schedule *schedule = isl_schedule_node_get_schedule(node);
+
+  isl_schedule_node_free(node);
+  isl_multi_union_pw_aff_free(sc);
+
+  return schedule;
+}
+
 /* Examine if the node is a permutable band node. If so,
  * since the schedule tree is visited top-down,
  * return such a node immediately.
@@ -984,6 +1122,50 @@ __isl_give isl_schedule_node *autosa_node_interchange(
   return node;
 }
 
+/* Permute the members of the band node "node", such that the member
+ * "order[i]" of the original band becomes the member "i" of the new band.
+ * The band properties are permuted along with the members.
+ * Return a pointer to the new band node.
+ */
+__isl_give isl_schedule_node *autosa_node_band_permute(
+    __isl_take isl_schedule_node *node, int *order)
+{
+  struct autosa_node_band_prop *prop;
+  isl_multi_union_pw_aff *mupa;
+  int *coincident;
+  enum autosa_loop_type *pe_opt, *space_time;
+
+  prop = extract_node_band_prop(node);
+  mupa = isl_multi_union_pw_aff_copy(prop->mupa);
+  coincident = (int *)malloc(prop->n_member * sizeof(int));
+  pe_opt = (enum autosa_loop_type *)malloc(prop->n_member * sizeof(enum autosa_loop_type));
+  space_time = (enum autosa_loop_type *)malloc(prop->n_member * sizeof(enum autosa_loop_type));
+  for (int i = 0; i < prop->n_member; i++)
+  {
+    mupa = isl_multi_union_pw_aff_set_union_pw_aff(mupa, i,
+                                                   isl_multi_union_pw_aff_get_union_pw_aff(prop->mupa, order[i]));
+    coincident[i] = prop->coincident[order[i]];
+    pe_opt[i] = prop->pe_opt[order[i]];
+    space_time[i] = prop->space_time[order[i]];
+  }
+  isl_multi_union_pw_aff_free(prop->mupa);
+  prop->mupa = mupa;
+  memcpy(prop->coincident, coincident, prop->n_member * sizeof(int));
+  memcpy(prop->pe_opt, pe_opt, prop->n_member * sizeof(enum autosa_loop_type));
+  memcpy(prop->space_time, space_time, prop->n_member * sizeof(enum autosa_loop_type));
+  free(coincident);
+  free(pe_opt);
+  free(space_time);
+
+  /* Replace the band node. */
+  node = isl_schedule_node_delete(node);
+  node = isl_schedule_node_insert_partial_schedule(node,
+                                                   isl_multi_union_pw_aff_copy(prop->mupa));
+  node = restore_node_band_prop(node, prop);
+
+  return node;
+}
+
 /* Given two nested nodes,
  * N2
  * |
@@ -1153,6 +1335,110 @@ isl_bool is_flow_dep_carried_by_array_part_loops(__isl_keep isl_schedule *schedu
   return carried;
 }
 
+/* Compute the minimal number of array partitions between the source and
+ * the sink of the flow dependences associated with the I/O group "group"
+ * that are carried by the loops above the "array" mark, i.e., the number
+ * of array partitions the module reading the group may run ahead of
+ * the module writing it.
+ * The array partitions are counted in the order of the array part loops,
+ * whose iterations are linearized with the extents of the loops.
+ * Return 0 if no flow dependence is carried, and 1 if the distance
+ * can't be bounded.
+ */
+int flow_dep_array_part_distance(__isl_keep isl_schedule *schedule,
+                                 struct autosa_array_ref_group *group, struct autosa_kernel *kernel)
+{
+  isl_bool carried;
+  isl_ctx *ctx;
+  isl_schedule_node *node;
+  isl_union_map *prefix, *dep;
+  isl_set *range, *delta;
+  isl_space *space;
+  isl_aff *dist;
+  isl_val *val;
+  long weight = 1;
+  int n, distance = 1;
+
+  carried = is_flow_dep_carried_by_array_part_loops(schedule, group, kernel);
+  if (carried < 0)
+    return -1;
+  if (!carried)
+    return 0;
+
+  ctx = isl_schedule_get_ctx(schedule);
+  node = isl_schedule_get_root(schedule);
+  node = autosa_tree_move_down_to_array(node, kernel->core);
+  prefix = isl_schedule_node_get_prefix_schedule_union_map(node);
+  isl_schedule_node_free(node);
+
+  dep = isl_union_map_empty(isl_union_map_get_space(prefix));
+  for (int i = 0; i < group->n_ref; i++)
+  {
+    struct autosa_stmt_access *ref = group->refs[i];
+    for (int j = 0; j < ref->n_io_info; j++)
+    {
+      struct autosa_io_info *io_info = ref->io_info[j];
+      if (io_info->dep->type != AUTOSA_DEP_RAW ||
+          io_info->io_type != group->io_type ||
+          isl_vec_cmp(io_info->dir, group->dir))
+        continue;
+      dep = isl_union_map_union(dep, isl_union_map_from_map(
+                                         isl_map_factor_domain(
+                                             isl_map_from_basic_map(isl_basic_map_copy(io_info->dep->isl_dep)))));
+    }
+  }
+  dep = isl_union_map_apply_domain(dep, isl_union_map_copy(prefix));
+  dep = isl_union_map_apply_range(dep, isl_union_map_copy(prefix));
+  range = isl_set_from_union_set(isl_union_map_range(prefix));
+  delta = isl_set_from_union_set(isl_union_map_deltas(dep));
+
+  /* Linearize the distances, the innermost loop being the fastest. */
+  n = isl_set_dim(range, isl_dim_set);
+  space = isl_set_get_space(delta);
+  dist = isl_aff_zero_on_domain(isl_local_space_from_space(isl_space_copy(space)));
+  for (int i = n - 1; i >= 0 && weight > 0; i--)
+  {
+    isl_aff *var;
+    isl_val *max, *min;
+
+    var = isl_aff_var_on_domain(isl_local_space_from_space(isl_set_get_space(range)),
+                                isl_dim_set, i);
+    max = isl_set_max_val(range, var);
+    min = isl_set_min_val(range, var);
+    isl_aff_free(var);
+    if (isl_val_is_int(max) && isl_val_is_int(min))
+    {
+      var = isl_aff_var_on_domain(isl_local_space_from_space(isl_space_copy(space)),
+                                  isl_dim_set, i);
+      var = isl_aff_scale_val(var, isl_val_int_from_si(ctx, weight));
+      dist = isl_aff_add(dist, var);
+      weight *= isl_val_get_num_si(max) - isl_val_get_num_si(min) + 1;
+    }
+    else
+    {
+      /* The extent of the loop is not bounded. */
+      weight = 0;
+    }
+    isl_val_free(max);
+    isl_val_free(min);
+  }
+  isl_space_free(space);
+  isl_set_free(range);
+
+  if (weight > 0)
+  {
+    delta = isl_set_intersect(delta, isl_pw_aff_pos_set(isl_pw_aff_from_aff(isl_aff_copy(dist))));
+    val = isl_set_min_val(delta, dist);
+    if (isl_val_is_int(val))
+      distance = isl_val_get_num_si(val);
+    isl_val_free(val);
+  }
+  isl_aff_free(dist);
+  isl_set_free(delta);
+
+  return distance < 1 ? 1 : distance;
+}
+
 /* Examines if the current schedule node is a io mark at the level "io_level".
  * Specifically, the io mark at the level "io_level" has the name as "io_L[io_level]".
  */
@@ -1247,6 +1533,87 @@ int is_node_under_latency(__isl_keep isl_schedule_node *node)
   return 0;
 }
 
+/* Examine if the array access "ref" is invariant in all the loops of the
+ * band node "band". "node" is the child of "band".
+ */
+static isl_bool band_is_invariant(__isl_keep isl_schedule_node *band,
+                                  __isl_keep isl_schedule_node *node, struct autosa_stmt_access *ref)
+{
+  isl_union_map *prefix, *umap;
+  isl_map *acc;
+  int depth, n;
+  isl_bool invariant = isl_bool_true;
+
+  prefix = isl_schedule_node_get_prefix_schedule_union_map(node);
+  umap = isl_union_map_from_map(isl_map_copy(ref->access));
+  umap = isl_union_map_apply_domain(umap, prefix);
+  if (isl_union_map_n_map(umap) != 1)
+  {
+    isl_union_map_free(umap);
+    return isl_bool_false;
+  }
+  acc = isl_map_from_union_map(umap);
+
+  depth = isl_schedule_node_get_schedule_depth(node);
+  n = isl_schedule_node_band_n_member(band);
+  for (int i = depth - n; i < depth; i++)
+  {
+    invariant = access_is_invariant(acc, i);
+    if (invariant != isl_bool_true)
+      break;
+  }
+  isl_map_free(acc);
+
+  return invariant;
+}
+
+/* Move the leaf node "node" of the statement containing the array access "ref"
+ * up across the innermost loops in which the array element accessed by "ref"
+ * is invariant, when "--AutoSA-reg-reuse" is set.
+ * The data transfer statements inserted at the returned node load the element
+ * once into the registers of the PE, where it is reused by all the iterations
+ * of these loops, instead of transferring it at each iteration.
+ * Only band nodes and "latency" marks are crossed, i.e., the statement is
+ * the only one below the returned node.
+ * Nodes under the "simd" mark are left unchanged, since the data transfers
+ * are packed at the "simd" mark.
+ */
+__isl_give isl_schedule_node *autosa_tree_move_up_to_reuse_level(
+    struct autosa_kernel *kernel, __isl_take isl_schedule_node *node,
+    struct autosa_stmt_access *ref)
+{
+  if (!kernel->options->autosa->reg_reuse)
+    return node;
+  if (is_node_under_simd(node))
+    return node;
+
+  while (node && isl_schedule_node_has_parent(node))
+  {
+    isl_schedule_node *parent;
+    isl_bool cross = isl_bool_false;
+
+    parent = isl_schedule_node_parent(isl_schedule_node_copy(node));
+    if (isl_schedule_node_get_type(parent) == isl_schedule_node_mark)
+    {
+      isl_id *id = isl_schedule_node_mark_get_id(parent);
+      if (!strcmp(isl_id_get_name(id), "latency"))
+        cross = isl_bool_true;
+      isl_id_free(id);
+    }
+    else if (isl_schedule_node_get_type(parent) == isl_schedule_node_band)
+      cross = band_is_invariant(parent, node, ref);
+    if (cross != isl_bool_true)
+    {
+      isl_schedule_node_free(parent);
+      break;
+    }
+    isl_schedule_node_free(node);
+    node = parent;
+  }
+
+  return node;
+}
+
 /* Compute a box hull of the time domain of the schedule node, and return the 
  * box dimensions in an array.
  */
@@ -1303,6 +1670,124 @@ int *extract_band_upper_bounds(struct autosa_kernel *kernel,
   return ubs;
 }
 
+/* Copy the subtree rooted at "src" to the position of the leaf "dst",
+ * keeping the band properties.
+ * Return the pointer to the copied root, or NULL if the subtree contains
+ * nodes that can't be inserted, i.e., expansion and extension nodes.
+ */
+static __isl_give isl_schedule_node *copy_subtree(
+    __isl_take isl_schedule_node *dst, __isl_keep isl_schedule_node *src)
+{
+  enum isl_schedule_node_type type = isl_schedule_node_get_type(src);
+  isl_ctx *ctx = isl_schedule_node_get_ctx(src);
+  isl_schedule_node *child;
+
+  switch (type)
+  {
+  case isl_schedule_node_leaf:
+    return dst;
+  case isl_schedule_node_band:
+  {
+    struct autosa_node_band_prop *prop = extract_node_band_prop(src);
+    dst = isl_schedule_node_insert_partial_schedule(dst,
+                                                    isl_multi_union_pw_aff_copy(prop->mupa));
+    dst = isl_schedule_node_band_set_permutable(dst, prop->permutable);
+    for (int i = 0; i < prop->n_member; i++)
+    {
+      dst = isl_schedule_node_band_member_set_coincident(dst, i, prop->coincident[i]);
+      dst = isl_schedule_node_band_member_set_space_time(dst, i, prop->space_time[i]);
+      dst = isl_schedule_node_band_member_set_pe_opt(dst, i, prop->pe_opt[i]);
+    }
+    autosa_node_band_prop_free(prop);
+    break;
+  }
+  case isl_schedule_node_filter:
+    dst = isl_schedule_node_insert_filter(dst, isl_schedule_node_filter_get_filter(src));
+    break;
+  case isl_schedule_node_mark:
+    dst = isl_schedule_node_insert_mark(dst, isl_schedule_node_mark_get_id(src));
+    break;
+  case isl_schedule_node_context:
+    dst = isl_schedule_node_insert_context(dst, isl_schedule_node_context_get_context(src));
+    break;
+  case isl_schedule_node_guard:
+    dst = isl_schedule_node_insert_guard(dst, isl_schedule_node_guard_get_guard(src));
+    break;
+  case isl_schedule_node_sequence:
+  case isl_schedule_node_set:
+  {
+    int n = isl_schedule_node_n_children(src);
+    isl_union_set_list *filters = isl_union_set_list_alloc(ctx, n);
+
+    for (int i = 0; i < n; i++)
+    {
+      child = isl_schedule_node_get_child(src, i);
+      filters = isl_union_set_list_add(filters, isl_schedule_node_filter_get_filter(child));
+      isl_schedule_node_free(child);
+    }
+    if (type == isl_schedule_node_sequence)
+      dst = isl_schedule_node_insert_sequence(dst, filters);
+    else
+      dst = isl_schedule_node_insert_set(dst, filters);
+    /* The filters are inserted together with the sequence. */
+    for (int i = 0; i < n && dst; i++)
+    {
+      isl_schedule_node *grandchild;
+
+      child = isl_schedule_node_get_child(src, i);
+      grandchild = isl_schedule_node_get_child(child, 0);
+      dst = isl_schedule_node_child(dst, i);
+      dst = isl_schedule_node_child(dst, 0);
+      dst = copy_subtree(dst, grandchild);
+      isl_schedule_node_free(grandchild);
+      isl_schedule_node_free(child);
+      if (!dst)
+        return NULL;
+      dst = isl_schedule_node_parent(dst);
+      dst = isl_schedule_node_parent(dst);
+    }
+    return dst;
+  }
+  default:
+    return isl_schedule_node_free(dst);
+  }
+
+  child = isl_schedule_node_get_child(src, 0);
+  dst = isl_schedule_node_child(dst, 0);
+  dst = copy_subtree(dst, child);
+  isl_schedule_node_free(child);
+  if (!dst)
+    return NULL;
+
+  return isl_schedule_node_parent(dst);
+}
+
+/* Return a copy of "schedule" with the domain replaced by "domain".
+ * The tree below the domain node is rebuilt on the new domain, keeping the
+ * band properties.
+ * Return NULL if the tree contains expansion or extension nodes.
+ */
+__isl_give isl_schedule *autosa_schedule_reset_domain(
+    __isl_keep isl_schedule *schedule, __isl_take isl_union_set *domain)
+{
+  isl_schedule_node *root, *child, *node;
+  isl_schedule *new_schedule;
+
+  root = isl_schedule_get_root(schedule);
+  child = isl_schedule_node_get_child(root, 0);
+  isl_schedule_node_free(root);
+  node = isl_schedule_node_from_domain(domain);
+  node = isl_schedule_node_child(node, 0);
+  node = copy_subtree(node, child);
+  isl_schedule_node_free(child);
+  if (!node)
+    return NULL;
+  new_schedule = isl_schedule_node_get_schedule(node);
+  isl_schedule_node_free(node);
+
+  return new_schedule;
+}
+
 /* Return an isl_multi_aff, with as elements the parameters in "space"
  * that have the names specified by the elements in "names".
  * If (some of) these parameters do not already appear in "space",
@@ -1666,14 +2151,32 @@ static __isl_give isl_schedule *compute_or_set_properties(void *user)
     return determine_properties_original_schedule(gen);
 }
 
+/* Restore the schedule from the compilation cache if available.
+ * Otherwise, compute a schedule or determine the properties of
+ * the original schedule, and store the result in the cache.
+ */
+static __isl_give isl_schedule *load_or_compute_schedule(void *user)
+{
+  struct autosa_gen *gen = (struct autosa_gen *)user;
+  isl_schedule *schedule;
+
+  schedule = autosa_cache_load_schedule(gen->prog->scop);
+  if (schedule)
+    return schedule;
+  schedule = compute_or_set_properties(user);
+  autosa_cache_save_schedule(gen->prog->scop, schedule);
+
+  return schedule;
+}
+
 /* Obtain a schedule for the scop, by reading it from
- * a file, by computing one or by determining the properties
- * of the original schedule. 
+ * a file, by restoring it from the compilation cache, by computing one
+ * or by determining the properties of the original schedule. 
  */
 __isl_give isl_schedule *get_schedule(struct autosa_gen *gen)
 {
   return ppcg_get_schedule(gen->ctx, gen->options,
-                           &compute_or_set_properties, gen);
+                           &load_or_compute_schedule, gen);
 }
 
 /* Is "node" a mark node with an identifier called "name"?
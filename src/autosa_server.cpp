@@ -0,0 +1,323 @@
+/* Defines the compile server of AutoSA.
+ *
+ * "autosa --server=<socket>" listens on the Unix domain socket "socket"
+ * and serves compile requests, such that the clients issuing many small
+ * compilations (e.g., the tuning scripts) don't pay the start-up of the
+ * compiler for each of them.
+ * A request consists of the working directory of the client followed by
+ * the arguments of the compilation (without the program name), each
+ * terminated by a NUL byte, and ends with an empty string.
+ * The server answers with the output of the compilation, followed by
+ * a NUL byte and the exit status of the compilation in decimal.
+ *
+ * Each request is compiled in its own process forked from the server,
+ * with its own isl_ctx, such that
+ * - the requests are compiled concurrently, up to "n_job" at once,
+ * - the loading and the static initialization of clang, pet and isl are
+ *   only paid once by the server,
+ * - a compilation that fails or exits doesn't affect the server or the
+ *   other compilations.
+ * The JSON files named by the requests (--AutoSA-config, --AutoSA-hw-info
+ * and --AutoSA-calibration) are parsed once by the server and inherited
+ * by the compile processes, until they are modified.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "autosa_server.h"
+#include "ppcg.h"
+
+/* A JSON file parsed by the server, with the modification time and
+ * the size of the file when it was parsed.
+ */
+struct autosa_server_config
+{
+  cJSON *json;
+  time_t mtime;
+  off_t size;
+};
+
+/* The JSON files parsed by the server, by absolute path. */
+static std::map<std::string, struct autosa_server_config> server_configs;
+
+/* Return the JSON file "path" parsed by the server, or NULL if it
+ * was not parsed or if it has been modified since.
+ * The caller owns the returned copy.
+ */
+cJSON *autosa_server_get_config(const char *path)
+{
+  char key[PATH_MAX];
+  struct stat st;
+  std::map<std::string, struct autosa_server_config>::iterator it;
+
+  if (server_configs.empty() || !realpath(path, key))
+    return NULL;
+  it = server_configs.find(key);
+  if (it == server_configs.end())
+    return NULL;
+  if (stat(key, &st) != 0 || st.st_mtime != it->second.mtime ||
+      st.st_size != it->second.size)
+    return NULL;
+
+  return cJSON_Duplicate(it->second.json, 1);
+}
+
+/* Parse the JSON file "path" relative to the directory "cwd", unless it
+ * has already been parsed and has not been modified since.
+ */
+static void server_load_config(const std::string &cwd, const char *path)
+{
+  char key[PATH_MAX];
+  std::string full = path[0] == '/' ? path : cwd + "/" + path;
+  struct autosa_server_config config;
+  struct stat st;
+  std::map<std::string, struct autosa_server_config>::iterator it;
+  FILE *f;
+  char *buffer;
+
+  if (!realpath(full.c_str(), key) || stat(key, &st) != 0)
+    return;
+  it = server_configs.find(key);
+  if (it != server_configs.end())
+  {
+    if (st.st_mtime == it->second.mtime && st.st_size == it->second.size)
+      return;
+    cJSON_Delete(it->second.json);
+    server_configs.erase(it);
+  }
+
+  f = fopen(key, "rb");
+  if (!f)
+    return;
+  buffer = (char *)malloc(st.st_size + 1);
+  if (!buffer)
+  {
+    fclose(f);
+    return;
+  }
+  buffer[fread(buffer, 1, st.st_size, f)] = '\0';
+  fclose(f);
+  config.json = cJSON_Parse(buffer);
+  free(buffer);
+  if (!config.json)
+    return;
+  config.mtime = st.st_mtime;
+  config.size = st.st_size;
+  server_configs[key] = config;
+}
+
+/* Parse the JSON files named by the arguments "args" of a request
+ * whose working directory is args[0].
+ * The options may be given with or without the "AutoSA-" prefix.
+ */
+static void server_load_configs(std::vector<std::string> &args)
+{
+  const char *opts[] = {"--AutoSA-config=", "--AutoSA-hw-info=",
+                        "--AutoSA-calibration=", "--config=", "--hw-info=",
+                        "--calibration="};
+
+  for (size_t i = 1; i < args.size(); i++)
+  {
+    for (int j = 0; j < 6; j++)
+    {
+      size_t len = strlen(opts[j]);
+      if (args[i].compare(0, len, opts[j]) == 0 && args[i].size() > len)
+        server_load_config(args[0], args[i].c_str() + len);
+    }
+  }
+}
+
+/* Read a request from the connection "fd" into "args", the working
+ * directory of the client followed by the arguments of the compilation.
+ * Return 0 on success and -1 if the request is incomplete.
+ */
+static int server_read_request(int fd, std::vector<std::string> &args)
+{
+  std::string buffer;
+  size_t start = 0;
+  char chunk[4096];
+
+  args.clear();
+  while (1)
+  {
+    size_t end;
+    ssize_t n = read(fd, chunk, sizeof(chunk));
+
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    buffer.append(chunk, n);
+    while ((end = buffer.find('\0', start)) != std::string::npos)
+    {
+      if (end == start)
+        return args.empty() ? -1 : 0;
+      args.push_back(buffer.substr(start, end - start));
+      start = end + 1;
+    }
+  }
+}
+
+/* Write the "n" bytes of "data" to the connection "fd".
+ */
+static void server_write(int fd, const char *data, size_t n)
+{
+  while (n > 0)
+  {
+    ssize_t written = write(fd, data, n);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return;
+    data += written;
+    n -= written;
+  }
+}
+
+/* Compile the request "args" and send the output and the exit status of
+ * the compilation through the connection "fd".
+ * The compilation runs in a child process with its output redirected to
+ * the connection, such that the exit status can be sent even if the
+ * compiler exits on an error.
+ */
+static void server_compile(int fd, std::vector<std::string> &args)
+{
+  pid_t pid;
+  int status, r;
+  std::string tail;
+
+  pid = fork();
+  if (pid == 0)
+  {
+    std::vector<char *> argv;
+
+    dup2(fd, STDOUT_FILENO);
+    dup2(fd, STDERR_FILENO);
+    close(fd);
+    if (chdir(args[0].c_str()) != 0)
+    {
+      printf("[AutoSA] Error: Can't change to the directory: %s\n",
+             args[0].c_str());
+      exit(1);
+    }
+    argv.push_back((char *)"autosa");
+    for (size_t i = 1; i < args.size(); i++)
+      argv.push_back((char *)args[i].c_str());
+    argv.push_back(NULL);
+    exit(autosa_main_wrap(argv.size() - 1, argv.data()));
+  }
+
+  if (pid < 0)
+    r = 1;
+  else if (waitpid(pid, &status, 0) < 0)
+    r = 1;
+  else if (WIFEXITED(status))
+    r = WEXITSTATUS(status);
+  else
+    r = 128 + WTERMSIG(status);
+  if (pid < 0)
+  {
+    std::string msg = "[AutoSA] Error: Can't start the compilation.\n";
+    server_write(fd, msg.c_str(), msg.size());
+  }
+  tail = std::string(1, '\0') + std::to_string(r);
+  server_write(fd, tail.c_str(), tail.size());
+}
+
+/* Serve the compile requests sent to the Unix domain socket "path",
+ * with at most "n_job" compilations at once.
+ * Return only on an error.
+ */
+int autosa_server_main(const char *path, int n_job)
+{
+  int sock;
+  int n_active = 0;
+  struct sockaddr_un addr;
+
+  if (strlen(path) >= sizeof(addr.sun_path))
+  {
+    printf("[AutoSA] Error: The socket path is too long: %s\n", path);
+    return EXIT_FAILURE;
+  }
+  sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0)
+  {
+    printf("[AutoSA] Error: Can't create the socket: %s\n", strerror(errno));
+    return EXIT_FAILURE;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  unlink(path);
+  if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(sock, 64) < 0)
+  {
+    printf("[AutoSA] Error: Can't listen on the socket %s: %s\n", path,
+           strerror(errno));
+    close(sock);
+    return EXIT_FAILURE;
+  }
+  if (n_job < 1)
+    n_job = 1;
+  printf("[AutoSA] Compile server listening on %s (%d jobs).\n", path, n_job);
+
+  while (1)
+  {
+    std::vector<std::string> args;
+    pid_t pid;
+    int fd;
+
+    /* Wait for a compilation to finish if all the jobs are busy. */
+    while (n_active >= n_job && waitpid(-1, NULL, 0) > 0)
+      n_active--;
+    fd = accept(sock, NULL, NULL);
+    if (fd < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      printf("[AutoSA] Error: Can't accept the connection: %s\n",
+             strerror(errno));
+      break;
+    }
+    while (n_active > 0 && waitpid(-1, NULL, WNOHANG) > 0)
+      n_active--;
+
+    if (server_read_request(fd, args) < 0)
+    {
+      close(fd);
+      continue;
+    }
+    server_load_configs(args);
+
+    /* The buffered output of the server is not inherited. */
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0)
+    {
+      close(sock);
+      server_compile(fd, args);
+      close(fd);
+      _exit(0);
+    }
+    close(fd);
+    if (pid > 0)
+      n_active++;
+  }
+  close(sock);
+
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,18 @@
+#ifndef _AUTOSA_SERVER_H
+#define _AUTOSA_SERVER_H
+
+#include <cJSON/cJSON.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	int autosa_server_main(const char *path, int n_job);
+	cJSON *autosa_server_get_config(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,888 @@
+/* Defines functions for the cycle-approximate simulation of the generated
+ * systolic arrays.
+ *
+ * The module instances and the FIFOs connecting them are extracted from the
+ * top module, which is interpreted by autosa_top_gen in the same way as
+ * when the top module is generated natively. Each module instance is
+ * characterized by the latency of its module in the analytical latency
+ * model, i.e., the number of cycles it takes without stalls.
+ * The work of an instance is split into at most AUTOSA_SIM_CHUNKS chunks of
+ * equal duration, over which the instance reads and writes its FIFOs at a
+ * uniform rate. A chunk of an instance starts when the previous chunk
+ * is finished, and can't finish before
+ * - the producers of its input FIFOs have produced the data consumed up to
+ *   the end of the chunk;
+ * - the consumers of its output FIFOs have freed enough space for the data
+ *   produced up to the end of the chunk, given the FIFO depth.
+ * The chunks are simulated in the order of these dependences with an event
+ * queue, so the simulation time depends on the number of chunks and FIFOs,
+ * not on the number of cycles.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <isl/ast.h>
+#include <isl/id.h>
+#include <isl/printer.h>
+
+#include "autosa_sim.h"
+#include "autosa_common.h"
+#include "autosa_print.h"
+#include "autosa_top_gen.h"
+#include "autosa_utils.h"
+
+/* Maximal number of chunks of the work of a module instance */
+#define AUTOSA_SIM_CHUNKS 256
+/* Latency of a FIFO access */
+#define AUTOSA_SIM_LAT_FIFO 1
+#define AUTOSA_SIM_EPS 1e-9
+
+/* A FIFO written by the instance "src" and read by the instance "dst".
+ * "tokens" is the number of tokens transferred through the FIFO.
+ * "stall" is the number of cycles "src" is blocked by the FIFO being full,
+ * and "starve" the number of cycles "dst" waits on the FIFO being empty.
+ */
+struct autosa_sim_fifo
+{
+  std::string name;
+  int depth;
+  int src;
+  int dst;
+  double tokens;
+  double stall;
+  double starve;
+  double max_occupancy;
+};
+
+/* A chunk of the work of a module instance.
+ * The end of the chunk waits for the end of the chunk "finish_chunk"
+ * of the instance "finish_inst", which is -1 if the chunk ends with
+ * its own work.
+ */
+struct autosa_sim_chunk
+{
+  double start;
+  double finish;
+  int finish_inst;
+  int finish_chunk;
+};
+
+/* A module instance "name" of the module "module".
+ * "in" and "out" are the input and output FIFOs.
+ * "stall_in" and "stall_out" accumulate the cycles the instance waits on
+ * the input and output FIFOs.
+ */
+struct autosa_sim_inst
+{
+  std::string name;
+  std::string module;
+  double latency;
+  int n_chunk;
+  double dur;
+  std::vector<int> in;
+  std::vector<int> out;
+  std::vector<struct autosa_sim_chunk> chunks;
+  double stall_in;
+  double stall_out;
+  bool queued;
+};
+
+struct autosa_sim
+{
+  std::vector<struct autosa_sim_inst> insts;
+  std::vector<struct autosa_sim_fifo> fifos;
+  std::map<std::string, int> fifo_ids;
+};
+
+/* The hardware module called under the name "name" in the top module,
+ * where "boundary" is set for the boundary module and "dummy" for the
+ * PE dummy modules.
+ */
+struct autosa_sim_module
+{
+  struct autosa_hw_module *module;
+  int boundary;
+  int dummy;
+};
+
+static std::string sim_strip(const std::string &line)
+{
+  size_t first = line.find_first_not_of(" \t\r\n");
+  size_t last = line.find_last_not_of(" \t\r\n");
+
+  if (first == std::string::npos)
+    return "";
+  return line.substr(first, last - first + 1);
+}
+
+static int sim_get_fifo(struct autosa_sim *sim, const std::string &name)
+{
+  std::map<std::string, int>::iterator it = sim->fifo_ids.find(name);
+  struct autosa_sim_fifo fifo;
+
+  if (it != sim->fifo_ids.end())
+    return it->second;
+
+  fifo.name = name;
+  fifo.depth = 2;
+  fifo.src = -1;
+  fifo.dst = -1;
+  fifo.tokens = 1;
+  fifo.stall = 0;
+  fifo.starve = 0;
+  fifo.max_occupancy = 0;
+  sim->fifos.push_back(fifo);
+  sim->fifo_ids[name] = sim->fifos.size() - 1;
+
+  return sim->fifos.size() - 1;
+}
+
+/* Extract the FIFO depths from the lines
+ *   #pragma HLS STREAM variable=[fifo_name] depth=[depth]
+ * of the FIFO declarations in "lines".
+ */
+static void sim_parse_fifo_decls(struct autosa_sim *sim,
+                                 const std::vector<std::string> &lines)
+{
+  const char *var = "#pragma HLS STREAM variable=";
+
+  for (size_t i = 0; i < lines.size(); i++)
+  {
+    size_t pos = lines[i].find(var);
+    size_t end, depth;
+    int id;
+
+    if (pos == std::string::npos)
+      continue;
+    pos += strlen(var);
+    end = lines[i].find(' ', pos);
+    id = sim_get_fifo(sim, lines[i].substr(pos, end - pos));
+    depth = lines[i].find("depth=", pos);
+    if (depth != std::string::npos)
+      sim->fifos[id].depth = atoi(lines[i].c_str() + depth + strlen("depth="));
+  }
+}
+
+/* Compute the directions of the FIFO arguments in a call of "module",
+ * in the order they are printed by print_module_call_upper and
+ * print_module_call_lower: 1 for the FIFOs read by the module and 0 for
+ * the FIFOs written by the module.
+ * The FIFO to the lower-level modules of an I/O module is only found in
+ * the calls with a lower part, it is added if "lower" is set.
+ */
+static std::vector<int> sim_fifo_dirs(struct autosa_sim_module *m, int lower)
+{
+  struct autosa_hw_module *module = m->module;
+  std::vector<int> dirs;
+
+  if (module->type == PE_MODULE)
+  {
+    if (m->dummy)
+    {
+      dirs.push_back(1);
+      return dirs;
+    }
+    for (int i = 0; i < module->n_io_group; i++)
+    {
+      struct autosa_array_ref_group *group = module->io_groups[i];
+      if (group->pe_io_dir == IO_INOUT)
+      {
+        dirs.push_back(1);
+        dirs.push_back(0);
+      }
+      else
+      {
+        dirs.push_back(group->pe_io_dir == IO_IN ? 1 : 0);
+      }
+    }
+    return dirs;
+  }
+
+  if (!module->to_mem)
+  {
+    for (int i = 0; i < module->n_io_group; i++)
+    {
+      if (module->in)
+      {
+        dirs.push_back(1);
+        if (!m->boundary)
+          dirs.push_back(0);
+      }
+      else
+      {
+        if (!m->boundary)
+          dirs.push_back(1);
+        dirs.push_back(0);
+      }
+    }
+  }
+  if (lower)
+    dirs.push_back(module->in ? 0 : 1);
+
+  return dirs;
+}
+
+/* Add the module instance of the call in lines[begin, end) to "sim".
+ * The first line is the name of the called function, followed by one
+ * line per argument. The instance is named after the module and
+ * the module identifiers.
+ * The latency of the instance is taken from "modules".
+ */
+static isl_stat sim_add_inst(struct autosa_sim *sim,
+                             const std::vector<std::string> &lines, size_t begin, size_t end,
+                             std::map<std::string, struct autosa_sim_module> &module_map,
+                             cJSON *modules)
+{
+  const char *id_prefix = "/* module id */ ";
+  const char *fifo_prefix = "/* fifo */ ";
+  std::map<std::string, struct autosa_sim_module>::iterator it;
+  std::string call, name;
+  std::vector<std::string> fifos;
+  std::vector<int> dirs;
+  struct autosa_sim_inst inst;
+  cJSON *info, *lat;
+  int id;
+
+  call = sim_strip(lines[begin]);
+  if (call.empty() || call[call.size() - 1] != '(')
+    return isl_stat_error;
+  name = call.substr(0, call.size() - 1);
+  if (name.size() > 8 && name.compare(name.size() - 8, 8, "_wrapper") == 0)
+    name = name.substr(0, name.size() - 8);
+  it = module_map.find(name);
+  if (it == module_map.end())
+  {
+    printf("[AutoSA] Warning: Unknown module %s in the simulation.\n",
+           name.c_str());
+    return isl_stat_error;
+  }
+
+  inst.module = name;
+  inst.name = name;
+  for (size_t i = begin + 1; i < end; i++)
+  {
+    std::string arg = sim_strip(lines[i]);
+    if (!arg.empty() && arg[arg.size() - 1] == ',')
+      arg = sim_strip(arg.substr(0, arg.size() - 1));
+    if (arg.compare(0, strlen(id_prefix), id_prefix) == 0)
+      inst.name += "_" + arg.substr(strlen(id_prefix));
+    else if (arg.compare(0, strlen(fifo_prefix), fifo_prefix) == 0)
+      fifos.push_back(arg.substr(strlen(fifo_prefix)));
+  }
+
+  dirs = sim_fifo_dirs(&it->second, 0);
+  if (fifos.size() == dirs.size() + 1 && it->second.module->type != PE_MODULE)
+    dirs = sim_fifo_dirs(&it->second, 1);
+  if (fifos.size() != dirs.size())
+  {
+    printf("[AutoSA] Warning: Failed to connect the FIFOs of %s in the simulation.\n",
+           inst.name.c_str());
+    return isl_stat_error;
+  }
+
+  inst.latency = 1;
+  info = cJSON_GetObjectItemCaseSensitive(modules, name.c_str());
+  lat = info ? cJSON_GetObjectItemCaseSensitive(info, "latency") : NULL;
+  if (cJSON_IsNumber(lat) && lat->valuedouble > 1)
+    inst.latency = lat->valuedouble;
+  inst.n_chunk = inst.latency < AUTOSA_SIM_CHUNKS ? (int)inst.latency : AUTOSA_SIM_CHUNKS;
+  if (inst.n_chunk < 1)
+    inst.n_chunk = 1;
+  inst.dur = inst.latency / inst.n_chunk;
+  inst.stall_in = 0;
+  inst.stall_out = 0;
+  inst.queued = false;
+
+  id = sim->insts.size();
+  for (size_t i = 0; i < fifos.size(); i++)
+  {
+    int f = sim_get_fifo(sim, fifos[i]);
+    if (dirs[i])
+    {
+      sim->fifos[f].dst = id;
+      inst.in.push_back(f);
+    }
+    else
+    {
+      sim->fifos[f].src = id;
+      inst.out.push_back(f);
+    }
+  }
+  sim->insts.push_back(inst);
+
+  return isl_stat_ok;
+}
+
+/* Add the module instances called in "lines" to "sim".
+ * Each module call is enclosed by a pair of "Module Call" comments.
+ */
+static isl_stat sim_parse_module_calls(struct autosa_sim *sim,
+                                       const std::vector<std::string> &lines,
+                                       std::map<std::string, struct autosa_sim_module> &module_map,
+                                       cJSON *modules)
+{
+  for (size_t pos = 0; pos < lines.size(); pos++)
+  {
+    size_t end;
+
+    if (lines[pos].find("/* Module Call */") == std::string::npos)
+      continue;
+    for (end = pos + 1; end < lines.size(); end++)
+      if (lines[end].find("/* Module Call */") != std::string::npos)
+        break;
+    if (end >= lines.size())
+      break;
+    if (sim_add_inst(sim, lines, pos + 1, end, module_map, modules) < 0)
+      return isl_stat_error;
+    pos = end;
+  }
+
+  return isl_stat_ok;
+}
+
+static bool sim_fifo_is_connected(struct autosa_sim_fifo *fifo)
+{
+  return fifo->src >= 0 && fifo->dst >= 0;
+}
+
+/* Simulate as many chunks of the instance "id" as possible, given the
+ * chunks simulated so far.
+ * The chunk k of an instance with n chunks covers the fraction
+ * [k/n, (k+1)/n) of its work.
+ * Before finishing the chunk, the producer of each input FIFO should have
+ * produced the fraction (k+1)/n of the data, and the consumer of each
+ * output FIFO should have consumed the fraction (k+1)/n of the data,
+ * minus the part that fits in the FIFO. The consumer is never required to
+ * consume the data produced by the chunk itself.
+ * Return true if any chunk is simulated.
+ */
+static bool sim_advance(struct autosa_sim *sim, int id)
+{
+  struct autosa_sim_inst *inst = &sim->insts[id];
+  bool advanced = false;
+
+  while ((int)inst->chunks.size() < inst->n_chunk)
+  {
+    int k = inst->chunks.size();
+    double b = (double)k / inst->n_chunk;
+    double e = (double)(k + 1) / inst->n_chunk;
+    struct autosa_sim_chunk c;
+    int bound = -1;
+    bool ready = true;
+
+    c.start = k > 0 ? inst->chunks[k - 1].finish : 0;
+    c.finish = c.start + inst->dur;
+    c.finish_inst = -1;
+    c.finish_chunk = -1;
+    for (size_t i = 0; i < inst->in.size() && ready; i++)
+    {
+      struct autosa_sim_fifo *fifo = &sim->fifos[inst->in[i]];
+      struct autosa_sim_inst *prod;
+      double t;
+      int j;
+
+      if (!sim_fifo_is_connected(fifo))
+        continue;
+      prod = &sim->insts[fifo->src];
+      j = (int)ceil(e * prod->n_chunk - AUTOSA_SIM_EPS) - 1;
+      if (j >= prod->n_chunk)
+        j = prod->n_chunk - 1;
+      if (j >= (int)prod->chunks.size())
+      {
+        ready = false;
+        break;
+      }
+      t = prod->chunks[j].finish + AUTOSA_SIM_LAT_FIFO;
+      if (t > c.finish)
+      {
+        c.finish = t;
+        c.finish_inst = fifo->src;
+        c.finish_chunk = j;
+        bound = inst->in[i];
+      }
+    }
+    for (size_t i = 0; i < inst->out.size() && ready; i++)
+    {
+      struct autosa_sim_fifo *fifo = &sim->fifos[inst->out[i]];
+      struct autosa_sim_inst *cons;
+      double slack;
+      int m, m_max;
+
+      if (!sim_fifo_is_connected(fifo))
+        continue;
+      cons = &sim->insts[fifo->dst];
+      slack = fifo->depth / fifo->tokens;
+      m = (int)ceil((e - slack) * cons->n_chunk - AUTOSA_SIM_EPS) - 1;
+      m_max = (int)floor(b * cons->n_chunk + AUTOSA_SIM_EPS) - 1;
+      if (m > m_max)
+        m = m_max;
+      if (m < 0)
+        continue;
+      if (m >= (int)cons->chunks.size())
+      {
+        ready = false;
+        break;
+      }
+      if (cons->chunks[m].finish > c.finish)
+      {
+        c.finish = cons->chunks[m].finish;
+        c.finish_inst = fifo->dst;
+        c.finish_chunk = m;
+        bound = inst->out[i];
+      }
+    }
+    if (!ready)
+      break;
+
+    if (bound >= 0)
+    {
+      double stall = c.finish - c.start - inst->dur;
+      if (sim->fifos[bound].dst == id)
+      {
+        inst->stall_in += stall;
+        sim->fifos[bound].starve += stall;
+      }
+      else
+      {
+        inst->stall_out += stall;
+        sim->fifos[bound].stall += stall;
+      }
+    }
+    inst->chunks.push_back(c);
+    advanced = true;
+  }
+
+  return advanced;
+}
+
+static void sim_enqueue(struct autosa_sim *sim, std::deque<int> &queue, int id)
+{
+  if (id < 0 || sim->insts[id].queued)
+    return;
+  sim->insts[id].queued = true;
+  queue.push_back(id);
+}
+
+/* Simulate all the chunks of all the instances in "sim".
+ * Whenever an instance makes progress, its producers and consumers are
+ * queued to be checked again.
+ * Return isl_stat_error if the instances get stuck, i.e., if the design
+ * deadlocks in the simulation.
+ */
+static isl_stat sim_run(struct autosa_sim *sim)
+{
+  std::deque<int> queue;
+
+  for (size_t i = 0; i < sim->fifos.size(); i++)
+  {
+    struct autosa_sim_fifo *fifo = &sim->fifos[i];
+    if (!sim_fifo_is_connected(fifo))
+      continue;
+    fifo->tokens = min(sim->insts[fifo->src].latency,
+                       sim->insts[fifo->dst].latency);
+    if (fifo->tokens < 1)
+      fifo->tokens = 1;
+  }
+
+  for (size_t i = 0; i < sim->insts.size(); i++)
+    sim_enqueue(sim, queue, i);
+  while (!queue.empty())
+  {
+    int id = queue.front();
+    struct autosa_sim_inst *inst = &sim->insts[id];
+
+    queue.pop_front();
+    inst->queued = false;
+    if (!sim_advance(sim, id))
+      continue;
+    for (size_t i = 0; i < inst->in.size(); i++)
+      sim_enqueue(sim, queue, sim->fifos[inst->in[i]].src);
+    for (size_t i = 0; i < inst->out.size(); i++)
+      sim_enqueue(sim, queue, sim->fifos[inst->out[i]].dst);
+  }
+
+  for (size_t i = 0; i < sim->insts.size(); i++)
+  {
+    if ((int)sim->insts[i].chunks.size() < sim->insts[i].n_chunk)
+    {
+      printf("[AutoSA] Warning: The simulation is stuck at module %s.\n",
+             sim->insts[i].name.c_str());
+      return isl_stat_error;
+    }
+  }
+
+  return isl_stat_ok;
+}
+
+/* Compute the maximal occupancy of each FIFO, sampled at the end of each
+ * chunk of its producer.
+ */
+static void sim_fifo_occupancy(struct autosa_sim *sim)
+{
+  for (size_t i = 0; i < sim->fifos.size(); i++)
+  {
+    struct autosa_sim_fifo *fifo = &sim->fifos[i];
+    struct autosa_sim_inst *prod, *cons;
+    std::vector<double> cons_finish;
+
+    if (!sim_fifo_is_connected(fifo))
+      continue;
+    prod = &sim->insts[fifo->src];
+    cons = &sim->insts[fifo->dst];
+    for (size_t k = 0; k < cons->chunks.size(); k++)
+      cons_finish.push_back(cons->chunks[k].finish);
+    for (size_t k = 0; k < prod->chunks.size(); k++)
+    {
+      double t = prod->chunks[k].finish;
+      long n_cons = std::upper_bound(cons_finish.begin(), cons_finish.end(), t) -
+                    cons_finish.begin();
+      double occ = ((double)(k + 1) / prod->n_chunk -
+                    (double)n_cons / cons->n_chunk) *
+                   fifo->tokens;
+      if (occ > fifo->depth)
+        occ = fifo->depth;
+      if (occ > fifo->max_occupancy)
+        fifo->max_occupancy = occ;
+    }
+  }
+}
+
+/* Follow the critical path backwards from the instance finishing last and
+ * return the instance that contributes the most cycles of its own work
+ * to the path.
+ */
+static int sim_bottleneck(struct autosa_sim *sim, double *latency)
+{
+  std::vector<double> busy(sim->insts.size(), 0);
+  int id = -1, k, best = -1;
+
+  *latency = 0;
+  for (size_t i = 0; i < sim->insts.size(); i++)
+  {
+    struct autosa_sim_inst *inst = &sim->insts[i];
+    if (inst->chunks.back().finish > *latency || id < 0)
+    {
+      *latency = inst->chunks.back().finish;
+      id = i;
+    }
+  }
+  if (id < 0)
+    return -1;
+
+  /* Each chunk on the path is simulated before the previous one. */
+  k = sim->insts[id].n_chunk - 1;
+  while (k >= 0)
+  {
+    struct autosa_sim_chunk *c = &sim->insts[id].chunks[k];
+    if (c->finish_inst >= 0)
+    {
+      id = c->finish_inst;
+      k = c->finish_chunk;
+      continue;
+    }
+    busy[id] += sim->insts[id].dur;
+    k--;
+  }
+
+  for (size_t i = 0; i < busy.size(); i++)
+    if (best < 0 || busy[i] > busy[best])
+      best = i;
+
+  return best;
+}
+
+/* Print the simulation results to "latency_est/sim_info.json" and
+ * report the bottleneck.
+ */
+static isl_stat sim_report(struct autosa_gen *gen, struct autosa_sim *sim,
+                           long model_latency)
+{
+  cJSON *sim_info, *insts, *fifos;
+  isl_printer *p_str;
+  char *file_path, *json_str;
+  double latency;
+  int bottleneck;
+  FILE *fp;
+
+  sim_fifo_occupancy(sim);
+  bottleneck = sim_bottleneck(sim, &latency);
+
+  sim_info = cJSON_CreateObject();
+  cJSON_AddItemToObject(sim_info, "latency", cJSON_CreateNumber((long)ceil(latency)));
+  cJSON_AddItemToObject(sim_info, "model_latency", cJSON_CreateNumber(model_latency));
+  if (bottleneck >= 0)
+    cJSON_AddStringToObject(sim_info, "bottleneck",
+                            sim->insts[bottleneck].name.c_str());
+
+  insts = cJSON_CreateObject();
+  cJSON_AddItemToObject(sim_info, "modules", insts);
+  for (size_t i = 0; i < sim->insts.size(); i++)
+  {
+    struct autosa_sim_inst *inst = &sim->insts[i];
+    cJSON *info = cJSON_CreateObject();
+    cJSON_AddStringToObject(info, "module", inst->module.c_str());
+    cJSON_AddItemToObject(info, "latency", cJSON_CreateNumber(inst->latency));
+    cJSON_AddItemToObject(info, "utilization",
+                          cJSON_CreateNumber(latency > 0 ? inst->latency / latency : 0));
+    cJSON_AddItemToObject(info, "stall_in", cJSON_CreateNumber((long)inst->stall_in));
+    cJSON_AddItemToObject(info, "stall_out", cJSON_CreateNumber((long)inst->stall_out));
+    cJSON_AddItemToObject(insts, inst->name.c_str(), info);
+  }
+
+  fifos = cJSON_CreateObject();
+  cJSON_AddItemToObject(sim_info, "fifos", fifos);
+  for (size_t i = 0; i < sim->fifos.size(); i++)
+  {
+    struct autosa_sim_fifo *fifo = &sim->fifos[i];
+    cJSON *info;
+
+    if (!sim_fifo_is_connected(fifo))
+      continue;
+    info = cJSON_CreateObject();
+    cJSON_AddStringToObject(info, "src", sim->insts[fifo->src].name.c_str());
+    cJSON_AddStringToObject(info, "dst", sim->insts[fifo->dst].name.c_str());
+    cJSON_AddItemToObject(info, "depth", cJSON_CreateNumber(fifo->depth));
+    cJSON_AddItemToObject(info, "max_occupancy", cJSON_CreateNumber(fifo->max_occupancy));
+    cJSON_AddItemToObject(info, "stall", cJSON_CreateNumber((long)fifo->stall));
+    cJSON_AddItemToObject(info, "starve", cJSON_CreateNumber((long)fifo->starve));
+    cJSON_AddItemToObject(fifos, fifo->name.c_str(), info);
+  }
+
+  json_str = cJSON_Print(sim_info);
+  p_str = isl_printer_to_str(gen->ctx);
+  p_str = isl_printer_print_str(p_str, gen->options->autosa->output_dir);
+  p_str = isl_printer_print_str(p_str, "/latency_est/sim_info.json");
+  file_path = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  fp = fopen(file_path, "w");
+  if (!fp)
+  {
+    printf("[AutoSA] Error: Cannot open file: %s\n", file_path);
+    exit(1);
+  }
+  free(file_path);
+  fprintf(fp, "%s", json_str);
+  fclose(fp);
+  free(json_str);
+  cJSON_Delete(sim_info);
+
+  printf("[AutoSA] Simulated latency: %ld cycles (estimated: %ld cycles)\n",
+         (long)ceil(latency), model_latency);
+  if (bottleneck >= 0)
+    printf("[AutoSA] Simulated bottleneck: %s (%.1f%% utilized)\n",
+           sim->insts[bottleneck].name.c_str(),
+           latency > 0 ? 100.0 * sim->insts[bottleneck].latency / latency : 0);
+
+  return isl_stat_ok;
+}
+
+struct autosa_sim_print_data
+{
+  struct autosa_prog *prog;
+  struct hls_info *hls;
+};
+
+static __isl_give isl_printer *sim_print_fifo_decl_stmt(
+    __isl_take isl_printer *p,
+    __isl_take isl_ast_print_options *print_options,
+    __isl_keep isl_ast_node *node, void *user)
+{
+  struct autosa_sim_print_data *data = (struct autosa_sim_print_data *)user;
+  struct autosa_kernel_stmt *stmt;
+  isl_id *id;
+
+  id = isl_ast_node_get_annotation(node);
+  stmt = (struct autosa_kernel_stmt *)isl_id_get_user(id);
+  isl_id_free(id);
+  isl_ast_print_options_free(print_options);
+
+  if (stmt->type == AUTOSA_KERNEL_STMT_FIFO_DECL)
+    p = autosa_kernel_print_fifo_decl(p, stmt, data->prog, data->hls);
+
+  return p;
+}
+
+static __isl_give isl_printer *sim_print_module_call_stmt(
+    __isl_take isl_printer *p,
+    __isl_take isl_ast_print_options *print_options,
+    __isl_keep isl_ast_node *node, void *user)
+{
+  struct autosa_sim_print_data *data = (struct autosa_sim_print_data *)user;
+  struct autosa_kernel_stmt *stmt;
+  isl_id *id;
+
+  id = isl_ast_node_get_annotation(node);
+  stmt = (struct autosa_kernel_stmt *)isl_id_get_user(id);
+  isl_id_free(id);
+  isl_ast_print_options_free(print_options);
+
+  if (stmt->type == AUTOSA_KERNEL_STMT_MODULE_CALL)
+    p = autosa_kernel_print_module_call(p, stmt, data->prog,
+                                        data->hls->target);
+
+  return p;
+}
+
+/* Print the FIFO declarations and the module calls of the top module
+ * and split them into lines.
+ */
+static isl_stat sim_top_module_lines(struct autosa_gen *gen,
+                                     std::vector<std::string> &lines)
+{
+  struct autosa_hw_top_module *top = gen->hw_top_module;
+  struct autosa_sim_print_data data;
+  struct autosa_top_gen *top_gen;
+  struct hls_info hls;
+  isl_stat r = isl_stat_ok;
+  char *str;
+
+  memset(&hls, 0, sizeof(hls));
+  hls.target = XILINX_HW;
+  hls.ctx = gen->ctx;
+  hls.output_dir = gen->options->autosa->output_dir;
+  data.prog = gen->prog;
+  data.hls = &hls;
+
+  top_gen = autosa_top_gen_alloc(gen->ctx);
+  for (int i = 0; i < top->n_fifo_decls && r == isl_stat_ok; i++)
+  {
+    autosa_top_gen_set_var(top_gen, "fifo_cnt", 0);
+    r = autosa_top_gen_exec_tree(top_gen, top->fifo_decl_wrapped_trees[i],
+                                 &sim_print_fifo_decl_stmt, &data);
+  }
+  for (int i = 0; i < top->n_module_calls && r == isl_stat_ok; i++)
+    r = autosa_top_gen_exec_tree(top_gen, top->module_call_wrapped_trees[i],
+                                 &sim_print_module_call_stmt, &data);
+
+  str = r == isl_stat_ok ? autosa_top_gen_get_str(top_gen) : NULL;
+  autosa_top_gen_free(top_gen);
+  if (!str)
+    return isl_stat_error;
+
+  for (char *start = str; *start;)
+  {
+    char *end = strchr(start, '\n');
+    if (!end)
+      end = start + strlen(start);
+    lines.push_back(std::string(start, end - start));
+    start = *end ? end + 1 : end;
+  }
+  free(str);
+
+  return isl_stat_ok;
+}
+
+/* Map the names of the functions called in the top module to the
+ * "n_hw_modules" hardware modules "hw_modules" in "module_map".
+ * The boundary and dummy modules are called through their own functions.
+ */
+static void sim_build_module_map(isl_ctx *ctx, int n_hw_modules,
+                                 struct autosa_hw_module **hw_modules,
+                                 std::map<std::string, struct autosa_sim_module> &module_map)
+{
+  for (int i = 0; i < n_hw_modules; i++)
+  {
+    struct autosa_hw_module *module = hw_modules[i];
+    struct autosa_sim_module m = {module, 0, 0};
+
+    module_map[module->name] = m;
+    if (module->boundary)
+    {
+      char *name = concat(ctx, module->name, "boundary");
+      m.boundary = 1;
+      module_map[name] = m;
+      free(name);
+      m.boundary = 0;
+    }
+    for (int j = 0; j < module->n_pe_dummy_modules; j++)
+    {
+      isl_printer *p_str = isl_printer_to_str(ctx);
+      char *name;
+
+      p_str = autosa_array_ref_group_print_prefix(
+          module->pe_dummy_modules[j]->io_group, p_str);
+      p_str = isl_printer_print_str(p_str, "_PE_dummy");
+      name = isl_printer_get_str(p_str);
+      isl_printer_free(p_str);
+      m.dummy = 1;
+      module_map[name] = m;
+      free(name);
+      m.dummy = 0;
+    }
+  }
+}
+
+/* Return the direction of the FIFO argument "pos" among the "n_fifo"
+ * FIFO arguments of a call of the function "func" in the top module,
+ * given the "n_hw_modules" hardware modules "hw_modules":
+ * 1 if the FIFO is read by the called module, 0 if it is written,
+ * and -1 if the call does not match any module.
+ */
+int autosa_sim_fifo_arg_dir(isl_ctx *ctx, int n_hw_modules,
+                            struct autosa_hw_module **hw_modules, const char *func, int pos,
+                            int n_fifo)
+{
+  std::map<std::string, struct autosa_sim_module> module_map;
+  std::map<std::string, struct autosa_sim_module>::iterator it;
+  std::string name = func;
+  std::vector<int> dirs;
+
+  if (name.size() > 8 && name.compare(name.size() - 8, 8, "_wrapper") == 0)
+    name = name.substr(0, name.size() - 8);
+  sim_build_module_map(ctx, n_hw_modules, hw_modules, module_map);
+  it = module_map.find(name);
+  if (it == module_map.end())
+    return -1;
+
+  dirs = sim_fifo_dirs(&it->second, 0);
+  if (n_fifo == (int)dirs.size() + 1 && it->second.module->type != PE_MODULE)
+    dirs = sim_fifo_dirs(&it->second, 1);
+  if (n_fifo != (int)dirs.size() || pos < 0 || pos >= n_fifo)
+    return -1;
+
+  return dirs[pos];
+}
+
+/* Simulate the systolic array of "gen" at the granularity of the module
+ * instances, where "modules" contains the latencies of the modules
+ * computed by sa_estimate_latency and "latency" is the estimated
+ * latency of the kernel.
+ * The latency of the kernel, the utilization and stalls of each instance,
+ * and the occupancy and stalls of each FIFO are printed to
+ * "latency_est/sim_info.json".
+ */
+isl_stat sa_simulate(struct autosa_gen *gen, cJSON *modules, long latency)
+{
+  std::map<std::string, struct autosa_sim_module> module_map;
+  std::vector<std::string> lines;
+  struct autosa_sim sim;
+
+  if (!gen->hw_top_module || !modules)
+    return isl_stat_error;
+
+  sim_build_module_map(gen->ctx, gen->n_hw_modules, gen->hw_modules,
+                       module_map);
+
+  if (sim_top_module_lines(gen, lines) < 0)
+  {
+    printf("[AutoSA] Warning: Failed to extract the top module. The simulation is skipped.\n");
+    return isl_stat_error;
+  }
+  sim_parse_fifo_decls(&sim, lines);
+  if (sim_parse_module_calls(&sim, lines, module_map, modules) < 0 ||
+      sim.insts.empty() || sim_run(&sim) < 0)
+  {
+    printf("[AutoSA] Warning: The simulation is skipped.\n");
+    return isl_stat_error;
+  }
+
+  return sim_report(gen, &sim, latency);
+}
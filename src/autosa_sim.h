@@ -0,0 +1,19 @@
+/* Defines functions for the cycle-approximate simulation of the generated
+ * systolic arrays. */
+
+#ifndef _AUTOSA_SIM_H
+#define _AUTOSA_SIM_H
+
+#include <isl/ctx.h>
+
+#include <cJSON/cJSON.h>
+
+struct autosa_gen;
+struct autosa_hw_module;
+
+isl_stat sa_simulate(struct autosa_gen *gen, cJSON *modules, long latency);
+int autosa_sim_fifo_arg_dir(isl_ctx *ctx, int n_hw_modules,
+                            struct autosa_hw_module **hw_modules, const char *func, int pos,
+                            int n_fifo);
+
+#endif
@@ -0,0 +1,2621 @@
+/* Defines functions for generating the top module natively in AutoSA.
+ *
+ * The statements of the top module ASTs print out code that prints the
+ * top module, i.e., lines of the form
+ *   p = isl_printer_start_line(p);
+ *   p = isl_printer_print_str(p, "...");
+ *   p = isl_printer_print_int(p, c0 + 1);
+ *   p = isl_printer_end_line(p);
+ *   p = isl_printer_indent(p, 4);
+ *   C_drain_IO_L1_out_cnt++;
+ * Previously, this code was embedded in the generated "top_gen.cpp", which
+ * was compiled and executed to produce the top module.
+ * Here we walk through the top module ASTs directly and interpret these
+ * lines, with the loop iterators and the module counters kept in
+ * "autosa_top_gen".
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <isl/ast.h>
+#include <isl/id.h>
+
+#include "autosa_top_gen.h"
+
+/* Minimal depth of the FIFOs crossing SLRs */
+#define AUTOSA_SLR_FIFO_DEPTH 16
+/* Minimal depth of the FIFOs of the pipeline stages in the I/O chains */
+#define AUTOSA_CHAIN_FIFO_DEPTH 4
+/* Depth of the clock-crossing FIFOs between the PE kernel and the I/O
+ * modules */
+#define AUTOSA_CDC_FIFO_DEPTH 16
+
+/* Cache of the irregular array "array" of element type "type" and of
+ * "size" elements, with "sets" sets of "ways" ways.
+ */
+struct top_gen_cache
+{
+  std::string array;
+  std::string type;
+  std::string size;
+  int sets;
+  int ways;
+};
+
+/* "p" prints out the top module code.
+ * "vars" contains the values of the loop iterators and the counters.
+ * "n_slr" is the number of SLRs the module calls are floorplanned on.
+ * "chain_pipeline" is the number of hops between the pipeline stages
+ * inserted in the I/O daisy chains, 0 if no stage is inserted.
+ * After the code is written out, "inst_slr" contains the SLR of each
+ * HLS instance of the module calls and "port_slr" the SLR of the module
+ * accessing each kernel port.
+ * If "perf_counters" is set, the module calls are connected to the
+ * performance counters, and "perf_names" contains the names of the module
+ * instances in the order of their counters.
+ * "trace_fifos" are the FIFOs whose occupancy is traced, and "fifo_dir"
+ * returns the direction of a FIFO argument of a module call, as
+ * autosa_sim_fifo_arg_dir. After the code is written out, "trace_names"
+ * contains the traced FIFOs in the order of their traces.
+ * "credits" maps the name of each module under credit control to its
+ * credit FIFO, and "credit_depth" contains the depth of each credit FIFO.
+ * If "aie" is set, the PEs are mapped on the AI Engines. After the code
+ * is written out, "aie_pes" contains the module identifiers and the FIFOs
+ * of the PEs removed from the top module, "aie_dirs" and "aie_types" the
+ * direction (as "fifo_dir") and the element type of each FIFO argument
+ * of the PEs, and "aie_plios" the FIFOs connecting the PEs to the I/O
+ * modules with their direction.
+ * If "pe_clock" is positive, the PEs are moved to their own kernel clocked
+ * at "pe_clock" MHz. After the code is written out, "pe_kernel_name" is
+ * the name of the PE kernel and "pe_ports" contains the FIFOs connecting
+ * the PEs to the other modules with their direction.
+ * If "threads" is set, each module call is run in its own thread, for
+ * the CPU simulation.
+ * "caches" contains the caches of the irregular arrays the PEs are
+ * connected to.
+ * If "module_template" is set, the module identifiers are passed to the
+ * modules as template arguments.
+ */
+struct autosa_top_gen
+{
+  isl_ctx *ctx;
+  isl_printer *p;
+  std::map<std::string, long> vars;
+  int n_slr;
+  int chain_pipeline;
+  int perf_counters;
+  std::vector<std::string> perf_names;
+  std::vector<std::string> trace_fifos;
+  int (*fifo_dir)(const char *func, int pos, int n_fifo, void *user);
+  void *fifo_dir_user;
+  std::vector<std::string> trace_names;
+  std::map<std::string, std::string> credits;
+  std::map<std::string, int> credit_depth;
+  std::vector<std::pair<std::string, int> > inst_slr;
+  std::map<std::string, int> port_slr;
+  int aie;
+  std::vector<std::pair<std::vector<long>, std::vector<std::string> > > aie_pes;
+  std::vector<int> aie_dirs;
+  std::vector<std::string> aie_types;
+  std::vector<std::pair<std::string, int> > aie_plios;
+  int pe_clock;
+  std::string pe_kernel_name;
+  std::vector<std::pair<std::string, int> > pe_ports;
+  int threads;
+  std::vector<struct top_gen_cache> caches;
+  int module_template;
+};
+
+struct autosa_top_gen *autosa_top_gen_alloc(isl_ctx *ctx)
+{
+  struct autosa_top_gen *gen = new autosa_top_gen;
+
+  gen->ctx = ctx;
+  gen->p = isl_printer_to_str(ctx);
+  gen->n_slr = 1;
+  gen->chain_pipeline = 0;
+  gen->perf_counters = 0;
+  gen->fifo_dir = NULL;
+  gen->fifo_dir_user = NULL;
+  gen->aie = 0;
+  gen->pe_clock = 0;
+  gen->threads = 0;
+  gen->module_template = 0;
+
+  return gen;
+}
+
+void autosa_top_gen_free(struct autosa_top_gen *gen)
+{
+  if (!gen)
+    return;
+
+  isl_printer_free(gen->p);
+  delete gen;
+}
+
+void autosa_top_gen_set_var(struct autosa_top_gen *gen, const char *name,
+                            long val)
+{
+  gen->vars[name] = val;
+}
+
+long autosa_top_gen_get_var(struct autosa_top_gen *gen, const char *name)
+{
+  std::map<std::string, long>::iterator it = gen->vars.find(name);
+
+  if (it == gen->vars.end())
+    return 0;
+  return it->second;
+}
+
+/* Evaluator of the integer expressions in C syntax found in the
+ * top module code, either printed from the AST expressions or found
+ * in the "isl_printer_print_int" calls.
+ * "pos" is the current position in "str".
+ * "error" is set if the expression cannot be evaluated.
+ */
+struct top_gen_expr
+{
+  const char *str;
+  int pos;
+  int error;
+  std::map<std::string, long> *vars;
+};
+
+static long top_gen_eval_ternary(struct top_gen_expr *e);
+
+static void top_gen_skip_space(struct top_gen_expr *e)
+{
+  while (isspace(e->str[e->pos]))
+    e->pos++;
+}
+
+/* Consume "tok" if it is the next token in "e".
+ */
+static int top_gen_accept(struct top_gen_expr *e, const char *tok)
+{
+  int len = strlen(tok);
+
+  top_gen_skip_space(e);
+  if (strncmp(e->str + e->pos, tok, len))
+    return 0;
+  /* Do not split "<=", ">=", "==", "&&" and "||". */
+  if (len == 1 && (tok[0] == '<' || tok[0] == '>' || tok[0] == '=' ||
+                   tok[0] == '!') &&
+      e->str[e->pos + 1] == '=')
+    return 0;
+  if (len == 1 && (tok[0] == '&' || tok[0] == '|') &&
+      e->str[e->pos + 1] == tok[0])
+    return 0;
+  e->pos += len;
+
+  return 1;
+}
+
+static void top_gen_expect(struct top_gen_expr *e, const char *tok)
+{
+  if (!top_gen_accept(e, tok))
+    e->error = 1;
+}
+
+/* Return the floor of "a" / "b".
+ */
+static long top_gen_floord(struct top_gen_expr *e, long a, long b)
+{
+  long q;
+
+  if (b == 0)
+  {
+    e->error = 1;
+    return 0;
+  }
+  q = a / b;
+  if ((a % b != 0) && ((a < 0) != (b < 0)))
+    q--;
+
+  return q;
+}
+
+static long top_gen_eval_primary(struct top_gen_expr *e)
+{
+  top_gen_skip_space(e);
+  if (e->error)
+    return 0;
+
+  if (top_gen_accept(e, "("))
+  {
+    long val = top_gen_eval_ternary(e);
+    top_gen_expect(e, ")");
+    return val;
+  }
+
+  if (isdigit(e->str[e->pos]))
+  {
+    char *end;
+    long val = strtol(e->str + e->pos, &end, 10);
+    e->pos = end - e->str;
+    return val;
+  }
+
+  if (isalpha(e->str[e->pos]) || e->str[e->pos] == '_')
+  {
+    int start = e->pos;
+    while (isalnum(e->str[e->pos]) || e->str[e->pos] == '_')
+      e->pos++;
+    std::string name(e->str + start, e->pos - start);
+
+    if (top_gen_accept(e, "("))
+    {
+      long a, b;
+      a = top_gen_eval_ternary(e);
+      top_gen_expect(e, ",");
+      b = top_gen_eval_ternary(e);
+      top_gen_expect(e, ")");
+      if (name == "floord")
+        return top_gen_floord(e, a, b);
+      if (name == "min")
+        return a < b ? a : b;
+      if (name == "max")
+        return a > b ? a : b;
+      e->error = 1;
+      return 0;
+    }
+
+    std::map<std::string, long>::iterator it = e->vars->find(name);
+    if (it == e->vars->end())
+    {
+      e->error = 1;
+      return 0;
+    }
+    return it->second;
+  }
+
+  e->error = 1;
+  return 0;
+}
+
+static long top_gen_eval_unary(struct top_gen_expr *e)
+{
+  if (top_gen_accept(e, "-"))
+    return -top_gen_eval_unary(e);
+  if (top_gen_accept(e, "+"))
+    return top_gen_eval_unary(e);
+  if (top_gen_accept(e, "!"))
+    return !top_gen_eval_unary(e);
+  return top_gen_eval_primary(e);
+}
+
+static long top_gen_eval_mul(struct top_gen_expr *e)
+{
+  long val = top_gen_eval_unary(e);
+
+  while (!e->error)
+  {
+    if (top_gen_accept(e, "*"))
+    {
+      val *= top_gen_eval_unary(e);
+    }
+    else if (top_gen_accept(e, "/") || top_gen_accept(e, "%"))
+    {
+      int is_div = e->str[e->pos - 1] == '/';
+      long rhs = top_gen_eval_unary(e);
+      if (rhs == 0)
+      {
+        e->error = 1;
+        return 0;
+      }
+      val = is_div ? val / rhs : val % rhs;
+    }
+    else
+      break;
+  }
+
+  return val;
+}
+
+static long top_gen_eval_add(struct top_gen_expr *e)
+{
+  long val = top_gen_eval_mul(e);
+
+  while (!e->error)
+  {
+    if (top_gen_accept(e, "+"))
+      val += top_gen_eval_mul(e);
+    else if (top_gen_accept(e, "-"))
+      val -= top_gen_eval_mul(e);
+    else
+      break;
+  }
+
+  return val;
+}
+
+static long top_gen_eval_rel(struct top_gen_expr *e)
+{
+  long val = top_gen_eval_add(e);
+
+  while (!e->error)
+  {
+    if (top_gen_accept(e, "<="))
+      val = val <= top_gen_eval_add(e);
+    else if (top_gen_accept(e, ">="))
+      val = val >= top_gen_eval_add(e);
+    else if (top_gen_accept(e, "<"))
+      val = val < top_gen_eval_add(e);
+    else if (top_gen_accept(e, ">"))
+      val = val > top_gen_eval_add(e);
+    else if (top_gen_accept(e, "=="))
+      val = val == top_gen_eval_add(e);
+    else if (top_gen_accept(e, "!="))
+      val = val != top_gen_eval_add(e);
+    else
+      break;
+  }
+
+  return val;
+}
+
+static long top_gen_eval_and(struct top_gen_expr *e)
+{
+  long val = top_gen_eval_rel(e);
+
+  while (!e->error && top_gen_accept(e, "&&"))
+  {
+    long rhs = top_gen_eval_rel(e);
+    val = val && rhs;
+  }
+
+  return val;
+}
+
+static long top_gen_eval_or(struct top_gen_expr *e)
+{
+  long val = top_gen_eval_and(e);
+
+  while (!e->error && top_gen_accept(e, "||"))
+  {
+    long rhs = top_gen_eval_and(e);
+    val = val || rhs;
+  }
+
+  return val;
+}
+
+static long top_gen_eval_ternary(struct top_gen_expr *e)
+{
+  long cond = top_gen_eval_or(e);
+
+  if (!e->error && top_gen_accept(e, "?"))
+  {
+    long then_val, else_val;
+    then_val = top_gen_eval_ternary(e);
+    top_gen_expect(e, ":");
+    else_val = top_gen_eval_ternary(e);
+    return cond ? then_val : else_val;
+  }
+
+  return cond;
+}
+
+/* Evaluate the expression "str" under the current values of the variables
+ * in "gen".
+ */
+static isl_stat top_gen_eval_str(struct autosa_top_gen *gen,
+                                 const std::string &str, long *val)
+{
+  struct top_gen_expr e = {str.c_str(), 0, 0, &gen->vars};
+
+  *val = top_gen_eval_ternary(&e);
+  top_gen_skip_space(&e);
+  if (e.error || e.str[e.pos] != '\0')
+  {
+    printf("[AutoSA] Error: Cannot evaluate the expression \"%s\" in the top module.\n",
+           str.c_str());
+    return isl_stat_error;
+  }
+
+  return isl_stat_ok;
+}
+
+static isl_stat top_gen_eval_expr(struct autosa_top_gen *gen,
+                                  __isl_take isl_ast_expr *expr, long *val)
+{
+  char *str;
+  isl_stat r;
+
+  if (!expr)
+    return isl_stat_error;
+
+  str = isl_ast_expr_to_C_str(expr);
+  isl_ast_expr_free(expr);
+  if (!str)
+    return isl_stat_error;
+  r = top_gen_eval_str(gen, str, val);
+  free(str);
+
+  return r;
+}
+
+/* Extract the C string literal starting at the first quote in "line".
+ */
+static isl_stat top_gen_extract_str(const std::string &line, std::string &str)
+{
+  size_t pos = line.find('"');
+
+  if (pos == std::string::npos)
+    return isl_stat_error;
+  for (pos = pos + 1; pos < line.size(); pos++)
+  {
+    char ch = line[pos];
+    if (ch == '"')
+      return isl_stat_ok;
+    if (ch == '\\' && pos + 1 < line.size())
+    {
+      ch = line[++pos];
+      if (ch == 'n')
+        ch = '\n';
+      else if (ch == 't')
+        ch = '\t';
+    }
+    str.push_back(ch);
+  }
+
+  return isl_stat_error;
+}
+
+/* Extract the second argument of the printer call in "line", i.e.,
+ * the text between the first ", " and the last ")".
+ */
+static isl_stat top_gen_extract_arg(const std::string &line, std::string &arg)
+{
+  size_t start = line.find(',');
+  size_t end = line.rfind(')');
+
+  if (start == std::string::npos || end == std::string::npos || end < start)
+    return isl_stat_error;
+  arg = line.substr(start + 1, end - start - 1);
+
+  return isl_stat_ok;
+}
+
+/* Interpret a single line of the top module code.
+ */
+static isl_stat top_gen_exec_line(struct autosa_top_gen *gen,
+                                  const std::string &line)
+{
+  std::string arg;
+  const char *prefix = "p = isl_printer_";
+  long val;
+
+  if (line.empty() || line == "{" || line == "}" ||
+      line.compare(0, 2, "//") == 0)
+    return isl_stat_ok;
+
+  if (line.compare(0, strlen(prefix), prefix) == 0)
+  {
+    std::string call = line.substr(strlen(prefix));
+    if (call.compare(0, 10, "start_line") == 0)
+    {
+      gen->p = isl_printer_start_line(gen->p);
+      return isl_stat_ok;
+    }
+    if (call.compare(0, 8, "end_line") == 0)
+    {
+      gen->p = isl_printer_end_line(gen->p);
+      return isl_stat_ok;
+    }
+    if (call.compare(0, 9, "print_str") == 0)
+    {
+      if (top_gen_extract_str(call, arg) < 0)
+        goto error;
+      gen->p = isl_printer_print_str(gen->p, arg.c_str());
+      return isl_stat_ok;
+    }
+    if (call.compare(0, 9, "print_int") == 0)
+    {
+      if (top_gen_extract_arg(call, arg) < 0 ||
+          top_gen_eval_str(gen, arg, &val) < 0)
+        goto error;
+      gen->p = isl_printer_print_int(gen->p, val);
+      return isl_stat_ok;
+    }
+    if (call.compare(0, 6, "indent") == 0)
+    {
+      if (top_gen_extract_arg(call, arg) < 0 ||
+          top_gen_eval_str(gen, arg, &val) < 0)
+        goto error;
+      gen->p = isl_printer_indent(gen->p, val);
+      return isl_stat_ok;
+    }
+    goto error;
+  }
+
+  if (line.size() > 3 && line.compare(line.size() - 3, 3, "++;") == 0)
+  {
+    gen->vars[line.substr(0, line.size() - 3)]++;
+    return isl_stat_ok;
+  }
+
+error:
+  printf("[AutoSA] Error: Unsupported statement \"%s\" in the top module.\n",
+         line.c_str());
+  return isl_stat_error;
+}
+
+/* Interpret the top module code "code", which contains one statement
+ * per line.
+ */
+isl_stat autosa_top_gen_exec_str(struct autosa_top_gen *gen, const char *code)
+{
+  const char *start = code;
+
+  if (!code)
+    return isl_stat_error;
+
+  while (*start)
+  {
+    const char *end = strchr(start, '\n');
+    if (!end)
+      end = start + strlen(start);
+    const char *first = start;
+    const char *last = end;
+    while (first < last && isspace(*first))
+      first++;
+    while (last > first && isspace(*(last - 1)))
+      last--;
+    if (top_gen_exec_line(gen, std::string(first, last - first)) < 0)
+      return isl_stat_error;
+    start = *end ? end + 1 : end;
+  }
+
+  return isl_stat_ok;
+}
+
+/* Interpret the top module AST "tree".
+ * The user statements are printed by "print_user" to obtain the top module
+ * code, which is then interpreted.
+ */
+isl_stat autosa_top_gen_exec_tree(struct autosa_top_gen *gen,
+                                  __isl_keep isl_ast_node *tree,
+                                  __isl_give isl_printer *(*print_user)(
+                                      __isl_take isl_printer *p,
+                                      __isl_take isl_ast_print_options *options,
+                                      __isl_keep isl_ast_node *node, void *user),
+                                  void *user)
+{
+  isl_stat r = isl_stat_ok;
+
+  if (!tree)
+    return isl_stat_error;
+
+  switch (isl_ast_node_get_type(tree))
+  {
+  case isl_ast_node_for:
+  {
+    isl_ast_expr *iterator;
+    isl_id *id;
+    isl_ast_node *body;
+    std::string name;
+    long init, inc, cond;
+    int has_prev;
+    long prev = 0;
+
+    iterator = isl_ast_node_for_get_iterator(tree);
+    id = isl_ast_expr_get_id(iterator);
+    name = isl_id_get_name(id);
+    isl_id_free(id);
+    isl_ast_expr_free(iterator);
+
+    has_prev = gen->vars.count(name);
+    if (has_prev)
+      prev = gen->vars[name];
+
+    if (top_gen_eval_expr(gen, isl_ast_node_for_get_init(tree), &init) < 0 ||
+        top_gen_eval_expr(gen, isl_ast_node_for_get_inc(tree), &inc) < 0)
+      return isl_stat_error;
+    if (inc <= 0)
+      return isl_stat_error;
+
+    body = isl_ast_node_for_get_body(tree);
+    for (gen->vars[name] = init;; gen->vars[name] += inc)
+    {
+      r = top_gen_eval_expr(gen, isl_ast_node_for_get_cond(tree), &cond);
+      if (r < 0 || !cond)
+        break;
+      r = autosa_top_gen_exec_tree(gen, body, print_user, user);
+      if (r < 0)
+        break;
+    }
+    isl_ast_node_free(body);
+
+    if (has_prev)
+      gen->vars[name] = prev;
+    else
+      gen->vars.erase(name);
+    break;
+  }
+  case isl_ast_node_if:
+  {
+    isl_ast_node *child = NULL;
+    long cond;
+
+    if (top_gen_eval_expr(gen, isl_ast_node_if_get_cond(tree), &cond) < 0)
+      return isl_stat_error;
+    if (cond)
+      child = isl_ast_node_if_get_then(tree);
+    else if (isl_ast_node_if_has_else(tree))
+      child = isl_ast_node_if_get_else(tree);
+    if (child)
+      r = autosa_top_gen_exec_tree(gen, child, print_user, user);
+    isl_ast_node_free(child);
+    break;
+  }
+  case isl_ast_node_block:
+  {
+    isl_ast_node_list *children = isl_ast_node_block_get_children(tree);
+    int n = isl_ast_node_list_n_ast_node(children);
+    for (int i = 0; i < n && r == isl_stat_ok; i++)
+    {
+      isl_ast_node *child = isl_ast_node_list_get_ast_node(children, i);
+      r = autosa_top_gen_exec_tree(gen, child, print_user, user);
+      isl_ast_node_free(child);
+    }
+    isl_ast_node_list_free(children);
+    break;
+  }
+  case isl_ast_node_mark:
+  {
+    isl_ast_node *child = isl_ast_node_mark_get_node(tree);
+    r = autosa_top_gen_exec_tree(gen, child, print_user, user);
+    isl_ast_node_free(child);
+    break;
+  }
+  case isl_ast_node_user:
+  {
+    isl_printer *p_str;
+    char *code;
+
+    p_str = isl_printer_to_str(gen->ctx);
+    p_str = isl_printer_set_output_format(p_str, ISL_FORMAT_C);
+    p_str = print_user(p_str, isl_ast_print_options_alloc(gen->ctx), tree,
+                       user);
+    code = isl_printer_get_str(p_str);
+    isl_printer_free(p_str);
+    r = autosa_top_gen_exec_str(gen, code);
+    free(code);
+    break;
+  }
+  default:
+    r = isl_stat_error;
+  }
+
+  return r;
+}
+
+static std::string top_gen_strip(const std::string &line)
+{
+  size_t first = line.find_first_not_of(" \t\r\n");
+  size_t last = line.find_last_not_of(" \t\r\n");
+
+  if (first == std::string::npos)
+    return "";
+  return line.substr(first, last - first + 1);
+}
+
+/* Drop the last "n" characters of "str".
+ */
+static std::string top_gen_drop_tail(const std::string &str, size_t n)
+{
+  if (str.size() <= n)
+    return "";
+  return str.substr(0, str.size() - n);
+}
+
+/* Drop "suffix" from the end of "str" if present.
+ */
+static std::string top_gen_drop_suffix(const std::string &str,
+                                       const char *suffix)
+{
+  size_t n = strlen(suffix);
+
+  if (str.size() > n && str.compare(str.size() - n, n, suffix) == 0)
+    return str.substr(0, str.size() - n);
+  return str;
+}
+
+/* Return the name of the module called by the function "func",
+ * i.e., without the "_wrapper" and "_boundary" suffixes.
+ */
+static std::string top_gen_module_name(const std::string &func)
+{
+  return top_gen_drop_suffix(top_gen_drop_suffix(func, "_wrapper"),
+                             "_boundary");
+}
+
+/* Reorder the module calls in "lines".
+ * For I/O modules, we reverse the sequence of calls for output modules.
+ * Starting from the first module, we enlist the module calls until the
+ * boundary module is met, reverse the list and insert it back.
+ * This follows the module call reordering in autosa_scripts/codegen.py.
+ * The lines are processed in a single pass, with the reversed module calls
+ * replacing the tail of the output lines.
+ */
+static void top_gen_reorder_module_calls(std::vector<std::string> &lines)
+{
+  int code_len = lines.size();
+  std::vector<std::string> out;
+  std::vector<std::vector<std::string> > module_calls;
+  std::vector<std::string> module_call;
+  int module_start = 0;
+  int output_io = 0;
+  int boundary = 0;
+  int new_module = 0;
+  int reset = 0;
+  int first_line = -1;
+  std::string prev_module_name;
+
+  out.reserve(code_len);
+  for (int pos = 0; pos < code_len; pos++)
+  {
+    const std::string &line = lines[pos];
+    int emitted = 0;
+    if (line.find("/* Module Call */") != std::string::npos)
+    {
+      module_start = !module_start;
+
+      if (module_start && pos + 1 < code_len)
+      {
+        /* Examine if the module is an output I/O module. */
+        std::string nxt_line = lines[pos + 1];
+        if (nxt_line.find("IO") != std::string::npos &&
+            nxt_line.find("out") != std::string::npos)
+        {
+          output_io = 1;
+          /* Examine if the module is a boundary module. */
+          if (nxt_line.find("boundary") != std::string::npos)
+            boundary = 1;
+        }
+        /* Extract the module name. */
+        std::string module_name = top_gen_drop_tail(top_gen_strip(nxt_line), 9);
+        if (boundary)
+          module_name = top_gen_drop_tail(module_name, 9);
+        if (prev_module_name.empty())
+        {
+          prev_module_name = module_name;
+          first_line = out.size();
+        }
+        else if (prev_module_name != module_name)
+        {
+          new_module = 1;
+          prev_module_name = module_name;
+          first_line = out.size();
+          reset = 0;
+        }
+        else
+        {
+          if (reset)
+          {
+            first_line = out.size();
+            reset = 0;
+          }
+          new_module = 0;
+        }
+      }
+
+      if (!module_start && output_io)
+      {
+        module_call.push_back(line);
+        module_calls.push_back(module_call);
+        module_call.clear();
+        if (boundary)
+        {
+          out.resize(first_line);
+          for (int i = module_calls.size() - 1; i >= 0; i--)
+          {
+            if (i != (int)module_calls.size() - 1)
+              out.push_back("\n");
+            out.insert(out.end(), module_calls[i].begin(),
+                       module_calls[i].end());
+          }
+          emitted = 1;
+          module_calls.clear();
+          boundary = 0;
+          output_io = 0;
+          reset = 1;
+        }
+        if (new_module && !module_calls.empty())
+        {
+          /* Pop out the previous module calls except the last one. */
+          module_calls.erase(module_calls.begin(), module_calls.end() - 1);
+        }
+      }
+    }
+
+    if (module_start && output_io)
+      module_call.push_back(line);
+    if (!emitted)
+      out.push_back(line);
+  }
+
+  lines.swap(out);
+}
+
+/* A module call in the top module.
+ * "func" is the called function, "ids" are the module identifiers,
+ * "fifos" are the FIFO arguments and "arrays" the kernel ports.
+ */
+struct top_gen_call
+{
+  std::string func;
+  std::vector<long> ids;
+  std::vector<std::string> fifos;
+  std::vector<std::string> arrays;
+  int slr;
+};
+
+/* Return the argument following "prefix" in "line", or an empty string.
+ */
+static std::string top_gen_call_arg(const std::string &line,
+                                    const char *prefix)
+{
+  std::string arg = top_gen_strip(line);
+
+  if (arg.compare(0, strlen(prefix), prefix) != 0)
+    return "";
+  arg = arg.substr(strlen(prefix));
+  if (!arg.empty() && arg[arg.size() - 1] == ',')
+    arg = arg.substr(0, arg.size() - 1);
+  return top_gen_strip(arg);
+}
+
+/* Extract the module calls from "lines".
+ * Each module call is enclosed by a pair of "Module Call" comments.
+ */
+static std::vector<struct top_gen_call> top_gen_extract_calls(
+    const std::vector<std::string> &lines)
+{
+  std::vector<struct top_gen_call> calls;
+  int code_len = lines.size();
+
+  for (int pos = 0; pos < code_len; pos++)
+  {
+    struct top_gen_call call;
+    std::string arg;
+
+    if (lines[pos].find("/* Module Call */") == std::string::npos ||
+        pos + 1 >= code_len)
+      continue;
+    call.func = top_gen_drop_tail(top_gen_strip(lines[pos + 1]), 1);
+    call.slr = -1;
+    for (pos += 2; pos < code_len; pos++)
+    {
+      if (lines[pos].find("/* Module Call */") != std::string::npos)
+        break;
+      if (!(arg = top_gen_call_arg(lines[pos], "/* module id */ ")).empty())
+        call.ids.push_back(atol(arg.c_str()));
+      else if (!(arg = top_gen_call_arg(lines[pos], "/* fifo */ ")).empty())
+        call.fifos.push_back(arg);
+      else if (!(arg = top_gen_call_arg(lines[pos], "/* array */ ")).empty())
+        call.arrays.push_back(arg);
+    }
+    calls.push_back(call);
+  }
+
+  return calls;
+}
+
+/* Assign the module calls in "calls" to "n_slr" SLRs.
+ * The PEs are split into "n_slr" bands of consecutive PEs along
+ * the longest dimension of the array.
+ * Every other module is placed on the SLR of a module it is connected to
+ * by a FIFO, in breadth-first order starting from the PEs, such that the
+ * I/O modules feeding a band of PEs are placed next to it.
+ */
+static void top_gen_assign_slrs(std::vector<struct top_gen_call> &calls,
+                                int n_slr)
+{
+  std::map<std::string, std::vector<int> > fifo_calls;
+  std::vector<long> extent;
+  std::deque<int> queue;
+  int dim = 0;
+
+  for (size_t i = 0; i < calls.size(); i++)
+  {
+    if (calls[i].func != "PE_wrapper")
+      continue;
+    for (size_t j = 0; j < calls[i].ids.size(); j++)
+    {
+      if (extent.size() <= j)
+        extent.push_back(0);
+      if (calls[i].ids[j] + 1 > extent[j])
+        extent[j] = calls[i].ids[j] + 1;
+    }
+  }
+  for (size_t j = 1; j < extent.size(); j++)
+    if (extent[j] > extent[dim])
+      dim = j;
+
+  for (size_t i = 0; i < calls.size(); i++)
+  {
+    for (size_t j = 0; j < calls[i].fifos.size(); j++)
+      fifo_calls[calls[i].fifos[j]].push_back(i);
+    if (calls[i].func != "PE_wrapper" || (int)calls[i].ids.size() <= dim)
+      continue;
+    calls[i].slr = calls[i].ids[dim] * n_slr / extent[dim];
+    queue.push_back(i);
+  }
+
+  while (!queue.empty())
+  {
+    int i = queue.front();
+    queue.pop_front();
+    for (size_t j = 0; j < calls[i].fifos.size(); j++)
+    {
+      std::vector<int> &neighbors = fifo_calls[calls[i].fifos[j]];
+      for (size_t k = 0; k < neighbors.size(); k++)
+      {
+        if (calls[neighbors[k]].slr >= 0)
+          continue;
+        calls[neighbors[k]].slr = calls[i].slr;
+        queue.push_back(neighbors[k]);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < calls.size(); i++)
+    if (calls[i].slr < 0)
+      calls[i].slr = 0;
+}
+
+/* Set the depth of the FIFOs in "fifos" to at least "min_depth" in the
+ * FIFO declarations in "lines".
+ */
+static void top_gen_deepen_fifos(std::vector<std::string> &lines,
+                                 const std::set<std::string> &fifos, int min_depth)
+{
+  const char *var = "#pragma HLS STREAM variable=";
+
+  for (size_t i = 0; i < lines.size(); i++)
+  {
+    size_t pos = lines[i].find(var), end, depth, depth_end;
+    char buf[32];
+
+    if (pos == std::string::npos)
+      continue;
+    pos += strlen(var);
+    end = lines[i].find(' ', pos);
+    depth = lines[i].find("depth=", pos);
+    if (end == std::string::npos || depth == std::string::npos ||
+        !fifos.count(lines[i].substr(pos, end - pos)))
+      continue;
+    depth += strlen("depth=");
+    if (atoi(lines[i].c_str() + depth) >= min_depth)
+      continue;
+    depth_end = lines[i].find_first_not_of("0123456789", depth);
+    snprintf(buf, sizeof(buf), "%d", min_depth);
+    lines[i].replace(depth, depth_end == std::string::npos ?
+                                std::string::npos : depth_end - depth, buf);
+  }
+}
+
+/* Floorplan the module calls in "lines" on the SLRs of "gen".
+ * The FIFOs connecting modules on different SLRs are deepened to
+ * AUTOSA_SLR_FIFO_DEPTH, so that the pipeline registers inserted by Vivado
+ * on the SLR crossings do not throttle the streams.
+ * The HLS instances of the calls to the same function are numbered in
+ * the order of the calls, as "func_U0", "func_1_U0", ...
+ */
+static void top_gen_floorplan(struct autosa_top_gen *gen,
+                              std::vector<std::string> &lines)
+{
+  std::vector<struct top_gen_call> calls = top_gen_extract_calls(lines);
+  std::map<std::string, std::vector<int> > fifo_slrs;
+  std::map<std::string, std::vector<int> >::iterator it;
+  std::map<std::string, int> n_inst;
+  std::set<std::string> crossings;
+
+  top_gen_assign_slrs(calls, gen->n_slr);
+
+  gen->inst_slr.clear();
+  gen->port_slr.clear();
+  for (size_t i = 0; i < calls.size(); i++)
+  {
+    struct top_gen_call *call = &calls[i];
+    int id = n_inst[call->func]++;
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "_%d", id);
+    gen->inst_slr.push_back(std::pair<std::string, int>(
+        call->func + (id > 0 ? buf : "") + "_U0", call->slr));
+    for (size_t j = 0; j < call->arrays.size(); j++)
+      gen->port_slr[call->arrays[j]] = call->slr;
+    for (size_t j = 0; j < call->fifos.size(); j++)
+      fifo_slrs[call->fifos[j]].push_back(call->slr);
+  }
+
+  for (it = fifo_slrs.begin(); it != fifo_slrs.end(); it++)
+    if (it->second.size() == 2 && it->second[0] != it->second[1])
+      crossings.insert(it->first);
+  top_gen_deepen_fifos(lines, crossings, AUTOSA_SLR_FIFO_DEPTH);
+
+  printf("[AutoSA] %d modules are floorplanned on %d SLRs with %d SLR crossings.\n",
+         (int)calls.size(), gen->n_slr, (int)crossings.size());
+}
+
+/* Insert a pipeline stage every "n" hops in the I/O daisy chains of the
+ * module calls in "lines", i.e., in the chains of calls to the same
+ * I/O module connected by FIFOs.
+ * Each stage is implemented by deepening the FIFO of the hop to
+ * AUTOSA_CHAIN_FIFO_DEPTH, such that the FIFO can be retimed into
+ * registers without throttling the stream.
+ */
+static void top_gen_pipeline_chains(struct autosa_top_gen *gen,
+                                    std::vector<std::string> &lines)
+{
+  std::vector<struct top_gen_call> calls = top_gen_extract_calls(lines);
+  std::map<std::string, std::vector<int> > fifo_calls;
+  std::vector<std::vector<std::string> > hops(calls.size());
+  std::vector<bool> visited(calls.size(), false);
+  std::set<std::string> stages;
+  int n = gen->chain_pipeline;
+
+  for (size_t i = 0; i < calls.size(); i++)
+    for (size_t j = 0; j < calls[i].fifos.size(); j++)
+      fifo_calls[calls[i].fifos[j]].push_back(i);
+  for (size_t i = 0; i < calls.size(); i++)
+  {
+    if (calls[i].func.find("_IO_") == std::string::npos)
+      continue;
+    for (size_t j = 0; j < calls[i].fifos.size(); j++)
+    {
+      std::vector<int> &ends = fifo_calls[calls[i].fifos[j]];
+      int other;
+      if (ends.size() != 2)
+        continue;
+      other = ends[0] == (int)i ? ends[1] : ends[0];
+      if (top_gen_module_name(calls[other].func) ==
+          top_gen_module_name(calls[i].func))
+        hops[i].push_back(calls[i].fifos[j]);
+    }
+  }
+
+  /* Walk along each chain from one of its ends. */
+  for (size_t i = 0; i < calls.size(); i++)
+  {
+    int cur = i, hop = 0;
+    std::string prev;
+
+    if (visited[i] || hops[i].size() != 1)
+      continue;
+    while (cur >= 0 && !visited[cur])
+    {
+      int next = -1;
+      visited[cur] = true;
+      for (size_t j = 0; j < hops[cur].size(); j++)
+      {
+        std::vector<int> &ends = fifo_calls[hops[cur][j]];
+        if (hops[cur][j] == prev)
+          continue;
+        prev = hops[cur][j];
+        next = ends[0] == cur ? ends[1] : ends[0];
+        if (++hop % n == 0)
+          stages.insert(prev);
+        break;
+      }
+      cur = next;
+    }
+  }
+  top_gen_deepen_fifos(lines, stages, AUTOSA_CHAIN_FIFO_DEPTH);
+
+  printf("[AutoSA] %d pipeline stages are inserted in the I/O daisy chains.\n",
+         (int)stages.size());
+}
+
+/* Return the name of the FIFO declared by "line", i.e.,
+ * "hls::stream<[type]> [name];", and its element type in "type",
+ * or an empty string if "line" is not a FIFO declaration.
+ */
+static std::string top_gen_fifo_decl(const std::string &line,
+                                     std::string &type)
+{
+  std::string decl = top_gen_strip(line);
+  const char *prefix = "hls::stream<";
+  size_t start = decl.find(prefix), end = decl.rfind('>');
+
+  if (start == std::string::npos || end == std::string::npos ||
+      end < start || decl.empty() || decl[decl.size() - 1] != ';' ||
+      decl.find('&') != std::string::npos)
+    return "";
+  start += strlen(prefix);
+  type = top_gen_strip(decl.substr(start, end - start));
+
+  return top_gen_strip(decl.substr(end + 1, decl.size() - end - 2));
+}
+
+/* Return the FIFO named by the pragma "line", i.e.,
+ * "#pragma HLS ... variable=[name] ...", or an empty string.
+ */
+static std::string top_gen_pragma_fifo(const std::string &line)
+{
+  const char *var = "variable=";
+  size_t pos = line.find(var), end;
+
+  if (line.find("#pragma HLS") == std::string::npos || pos == std::string::npos)
+    return "";
+  pos += strlen(var);
+  end = line.find_first_of(" \t\r\n", pos);
+
+  return line.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+}
+
+/* Map the PEs of the module calls in "lines" on the AI Engines.
+ * The calls to the PEs are removed from the top module and recorded in
+ * "aie_pes". The FIFOs between two PEs become AI Engine streams and their
+ * declarations are removed as well, while the FIFOs between a PE and
+ * another module become AXI4-Stream ports of the kernel, to be connected
+ * to the PLIOs of the AI Engine graph. The other modules stay in
+ * the programmable logic.
+ * If the directions or the types of the FIFO arguments of the PEs can't
+ * be found, the module calls are left untouched and "aie_pes" is empty.
+ */
+static void top_gen_partition_aie(struct autosa_top_gen *gen,
+                                  std::vector<std::string> &lines)
+{
+  std::vector<struct top_gen_call> calls = top_gen_extract_calls(lines);
+  std::map<std::string, std::vector<int> > fifo_calls;
+  std::map<std::string, std::string> fifo_types;
+  std::map<std::string, int> pe_fifos;
+  std::map<std::string, int>::iterator it;
+  std::vector<std::string> out;
+  std::string args, pragmas;
+  int first = -1;
+
+  gen->aie_pes.clear();
+  gen->aie_dirs.clear();
+  gen->aie_types.clear();
+  gen->aie_plios.clear();
+  for (size_t i = 0; i < lines.size(); i++)
+  {
+    std::string type, name = top_gen_fifo_decl(lines[i], type);
+    if (!name.empty())
+      fifo_types[name] = type;
+  }
+  for (size_t i = 0; i < calls.size(); i++)
+  {
+    for (size_t j = 0; j < calls[i].fifos.size(); j++)
+      fifo_calls[calls[i].fifos[j]].push_back(i);
+    if (calls[i].func == "PE_wrapper" && first < 0)
+      first = i;
+  }
+  if (first < 0)
+    return;
+
+  /* The FIFO arguments of the PEs, in the order of the calls. */
+  for (size_t j = 0; j < calls[first].fifos.size(); j++)
+  {
+    int dir = gen->fifo_dir ? gen->fifo_dir("PE_wrapper", j,
+                                            calls[first].fifos.size(), gen->fifo_dir_user)
+                            : -1;
+    if (dir < 0 || !fifo_types.count(calls[first].fifos[j]))
+    {
+      gen->aie_dirs.clear();
+      gen->aie_types.clear();
+      printf("[AutoSA] Warning: Failed to map the PEs on the AI Engines.\n");
+      return;
+    }
+    gen->aie_dirs.push_back(dir);
+    gen->aie_types.push_back(fifo_types[calls[first].fifos[j]]);
+  }
+
+  for (size_t i = 0; i < calls.size(); i++)
+  {
+    if (calls[i].func != "PE_wrapper")
+      continue;
+    gen->aie_pes.push_back(std::make_pair(calls[i].ids, calls[i].fifos));
+    for (size_t j = 0; j < calls[i].fifos.size() && j < gen->aie_dirs.size(); j++)
+    {
+      std::vector<int> &ends = fifo_calls[calls[i].fifos[j]];
+      int plio = 0;
+      for (size_t k = 0; k < ends.size(); k++)
+        if (calls[ends[k]].func != "PE_wrapper")
+          plio = 1;
+      if (ends.size() < 2)
+        plio = 1;
+      if (plio && !pe_fifos.count(calls[i].fifos[j]))
+        gen->aie_plios.push_back(std::make_pair(calls[i].fifos[j],
+                                                gen->aie_dirs[j]));
+      pe_fifos[calls[i].fifos[j]] = plio;
+    }
+  }
+
+  for (size_t i = 0; i < gen->aie_plios.size(); i++)
+  {
+    const std::string &fifo = gen->aie_plios[i].first;
+    args += ", hls::stream<" + fifo_types[fifo] + "> &" + fifo;
+    pragmas += "#pragma HLS INTERFACE axis port=" + fifo + "\n";
+  }
+
+  /* Drop the PEs and their FIFOs, and add the AXI4-Stream ports. */
+  out.reserve(lines.size());
+  for (size_t pos = 0; pos < lines.size(); pos++)
+  {
+    std::string line = top_gen_strip(lines[pos]), type;
+
+    if (line.find("/* Module Call */") != std::string::npos &&
+        pos + 1 < lines.size() &&
+        top_gen_strip(lines[pos + 1]) == "PE_wrapper(")
+    {
+      for (pos += 2; pos < lines.size(); pos++)
+        if (lines[pos].find("/* Module Call */") != std::string::npos)
+          break;
+      if (pos + 1 < lines.size() && top_gen_strip(lines[pos + 1]).empty())
+        pos++;
+      continue;
+    }
+    if (pe_fifos.count(top_gen_fifo_decl(lines[pos], type)) ||
+        pe_fifos.count(top_gen_pragma_fifo(lines[pos])))
+      continue;
+    if (line.compare(0, 11, "void kernel") == 0 && !line.empty() &&
+        line[line.size() - 1] == ')')
+    {
+      std::string header = lines[pos];
+      size_t close = header.rfind(')');
+      std::string arg_list = args;
+      if (header[header.find('(') + 1] == ')' && !arg_list.empty())
+        arg_list = arg_list.substr(2);
+      header.insert(close, arg_list);
+      out.push_back(header);
+      continue;
+    }
+    if (line.find("#pragma HLS INTERFACE s_axilite port=return") != std::string::npos)
+      out.push_back(pragmas);
+    out.push_back(lines[pos]);
+  }
+  lines.swap(out);
+
+  printf("[AutoSA] %d PEs are mapped on the AI Engines with %d PLIOs.\n",
+         (int)gen->aie_pes.size(), (int)gen->aie_plios.size());
+}
+
+/* Move the PEs of the module calls in "lines" to their own kernel
+ * "[kernel]_pe", to be run in the PE clock.
+ * The FIFOs between two PEs are declared in the PE kernel, while the FIFOs
+ * between a PE and another module become AXI4-Stream ports of both
+ * kernels, to be connected through the clock-crossing FIFOs by
+ * the linker. The other modules, including the dummy PEs, stay in
+ * the kernel in the kernel clock.
+ * The PE kernel has no control interface (ap_ctrl_none), i.e., it runs
+ * freely and is driven by the streams, such that the host only launches
+ * the kernel of the I/O modules. The PE kernel is appended to "lines",
+ * its name is stored in "pe_kernel_name" and the boundary FIFOs are
+ * recorded in "pe_ports" with their direction from the PEs.
+ * If the directions or the types of the FIFO arguments of the PEs can't
+ * be found, or if the PEs take other arguments than their identifiers and
+ * their FIFOs, the module calls are left untouched and "pe_kernel_name"
+ * is empty.
+ */
+static void top_gen_partition_pe_clock(struct autosa_top_gen *gen,
+                                       std::vector<std::string> &lines)
+{
+  std::vector<struct top_gen_call> calls = top_gen_extract_calls(lines);
+  std::map<std::string, std::vector<int> > fifo_calls;
+  std::map<std::string, std::string> fifo_types;
+  std::map<std::string, int> pe_fifos;
+  std::vector<int> dirs;
+  std::vector<std::string> out, decls, pe_calls, pe;
+  std::string args, pragmas, kernel;
+  int first = -1, n_pe = 0;
+
+  gen->pe_kernel_name.clear();
+  gen->pe_ports.clear();
+  for (size_t i = 0; i < lines.size(); i++)
+  {
+    std::string type, name = top_gen_fifo_decl(lines[i], type);
+    if (!name.empty())
+      fifo_types[name] = type;
+  }
+  for (size_t i = 0; i < calls.size(); i++)
+  {
+    for (size_t j = 0; j < calls[i].fifos.size(); j++)
+      fifo_calls[calls[i].fifos[j]].push_back(i);
+    if (calls[i].func == "PE_wrapper" && first < 0)
+      first = i;
+  }
+  if (first < 0)
+    return;
+
+  for (size_t j = 0; j < calls[first].fifos.size(); j++)
+  {
+    int dir = gen->fifo_dir ? gen->fifo_dir("PE_wrapper", j,
+                                            calls[first].fifos.size(), gen->fifo_dir_user)
+                            : -1;
+    if (dir < 0 || !fifo_types.count(calls[first].fifos[j]))
+    {
+      printf("[AutoSA] Warning: Failed to move the PEs to the PE clock.\n");
+      return;
+    }
+    dirs.push_back(dir);
+  }
+
+  for (size_t i = 0; i < calls.size(); i++)
+  {
+    if (calls[i].func != "PE_wrapper")
+      continue;
+    n_pe++;
+    if (!calls[i].arrays.empty())
+    {
+      printf("[AutoSA] Warning: The PEs access the external memory. The PEs are kept in the kernel clock.\n");
+      gen->pe_ports.clear();
+      return;
+    }
+    for (size_t j = 0; j < calls[i].fifos.size() && j < dirs.size(); j++)
+    {
+      std::vector<int> &ends = fifo_calls[calls[i].fifos[j]];
+      int port = ends.size() < 2;
+      for (size_t k = 0; k < ends.size(); k++)
+        if (calls[ends[k]].func != "PE_wrapper")
+          port = 1;
+      if (port && !pe_fifos.count(calls[i].fifos[j]))
+        gen->pe_ports.push_back(std::make_pair(calls[i].fifos[j], dirs[j]));
+      pe_fifos[calls[i].fifos[j]] = port;
+    }
+  }
+
+  for (size_t i = 0; i < gen->pe_ports.size(); i++)
+  {
+    const std::string &fifo = gen->pe_ports[i].first;
+    args += ", hls::stream<" + fifo_types[fifo] + "> &" + fifo;
+    pragmas += "#pragma HLS INTERFACE axis port=" + fifo + "\n";
+  }
+
+  /* Drop the PEs and their FIFOs from the top module, and add the
+   * AXI4-Stream ports. */
+  out.reserve(lines.size());
+  for (size_t pos = 0; pos < lines.size(); pos++)
+  {
+    std::string line = top_gen_strip(lines[pos]), type, name;
+
+    if (line.find("/* Module Call */") != std::string::npos &&
+        pos + 1 < lines.size() &&
+        top_gen_strip(lines[pos + 1]) == "PE_wrapper(")
+    {
+      pe_calls.push_back(lines[pos]);
+      for (pos++; pos < lines.size(); pos++)
+      {
+        pe_calls.push_back(lines[pos]);
+        if (lines[pos].find("/* Module Call */") != std::string::npos)
+          break;
+      }
+      if (pos + 1 < lines.size() && top_gen_strip(lines[pos + 1]).empty())
+        pe_calls.push_back(lines[++pos]);
+      continue;
+    }
+    name = top_gen_fifo_decl(lines[pos], type);
+    if (name.empty())
+      name = top_gen_pragma_fifo(lines[pos]);
+    if (pe_fifos.count(name))
+    {
+      if (!pe_fifos[name])
+        decls.push_back(lines[pos]);
+      continue;
+    }
+    if (line.compare(0, 11, "void kernel") == 0 && !line.empty() &&
+        line[line.size() - 1] == ')')
+    {
+      std::string header = lines[pos];
+      size_t close = header.rfind(')');
+      std::string arg_list = args;
+      kernel = line.substr(5, line.find('(') - 5);
+      if (header[header.find('(') + 1] == ')' && !arg_list.empty())
+        arg_list = arg_list.substr(2);
+      header.insert(close, arg_list);
+      out.push_back(header);
+      continue;
+    }
+    if (line.find("#pragma HLS INTERFACE s_axilite port=return") != std::string::npos)
+      out.push_back(pragmas);
+    out.push_back(lines[pos]);
+  }
+  if (kernel.empty())
+  {
+    printf("[AutoSA] Warning: Failed to move the PEs to the PE clock.\n");
+    gen->pe_ports.clear();
+    return;
+  }
+  lines.swap(out);
+
+  /* Print the PE kernel. */
+  args = args.empty() ? "" : args.substr(2);
+  pe.push_back("extern \"C\" {\n");
+  pe.push_back("void " + kernel + "_pe(" + args + ")\n");
+  pe.push_back("{\n");
+  pe.push_back(pragmas);
+  pe.push_back("#pragma HLS INTERFACE ap_ctrl_none port=return\n");
+  pe.push_back("\n");
+  pe.push_back("#pragma HLS DATAFLOW\n");
+  pe.push_back("\n");
+  pe.push_back("    /* FIFO Declaration */\n");
+  pe.insert(pe.end(), decls.begin(), decls.end());
+  pe.push_back("    /* FIFO Declaration */\n");
+  pe.push_back("\n");
+  pe.insert(pe.end(), pe_calls.begin(), pe_calls.end());
+  pe.push_back("}\n");
+  pe.push_back("}\n");
+  lines.push_back("\n");
+  lines.insert(lines.end(), pe.begin(), pe.end());
+  gen->pe_kernel_name = kernel + "_pe";
+
+  printf("[AutoSA] %d PEs are moved to the kernel %s in the %d MHz clock with %d clock-crossing FIFOs.\n",
+         n_pe, gen->pe_kernel_name.c_str(), gen->pe_clock, (int)gen->pe_ports.size());
+}
+
+/* Connect the module calls in "lines" to the performance counters.
+ * The k-th module call drains its counters through the FIFO fifo_perf[k],
+ * declared at the end of the FIFO declarations, and the counters of all
+ * the calls are written out to the kernel argument "perf" by
+ * autosa_perf_collect after the module calls.
+ * The instances are named after the modules and the module identifiers.
+ */
+/* Append the argument "arg" to the module call spanning the lines
+ * from "pos", the opening comment of the call, to "end", the closing
+ * parenthesis.
+ */
+static void top_gen_append_call_arg(std::vector<std::string> &lines,
+                                    size_t pos, size_t end, const std::string &arg)
+{
+  std::string &prev = lines[end - 1];
+  std::string indent = prev.substr(0, prev.find_first_not_of(" \t"));
+
+  if (end - 1 > pos + 1)
+    prev.insert(prev.find_last_not_of("\r\n") + 1, ",");
+  else
+    indent = lines[end].substr(0, lines[end].find_first_not_of(" \t")) + "    ";
+  lines.insert(lines.begin() + end, indent + arg + "\n");
+}
+
+/* Connect the modules under credit control to their credit FIFOs,
+ * declared after the other FIFOs.
+ * Each credit FIFO should connect the module reading an array to
+ * the module writing it.
+ */
+static void top_gen_insert_credits(struct autosa_top_gen *gen,
+                                   std::vector<std::string> &lines)
+{
+  std::map<std::string, int> n_calls;
+  std::map<std::string, int>::iterator it;
+  int last_decl = -1;
+  char buf[64];
+
+  for (size_t pos = 0; pos < lines.size(); pos++)
+  {
+    std::map<std::string, std::string>::iterator credit;
+    std::string name;
+    size_t end;
+
+    if (lines[pos].find("/* FIFO Declaration */") != std::string::npos)
+      last_decl = pos;
+    if (lines[pos].find("/* Module Call */") == std::string::npos ||
+        pos + 1 >= lines.size())
+      continue;
+
+    name = top_gen_drop_suffix(top_gen_drop_tail(top_gen_strip(lines[pos + 1]), 1),
+                               "_wrapper");
+    for (end = pos + 2; end < lines.size(); end++)
+      if (top_gen_strip(lines[end]) == ");")
+        break;
+    if (end >= lines.size())
+      break;
+
+    credit = gen->credits.find(name);
+    if (credit != gen->credits.end())
+    {
+      top_gen_append_call_arg(lines, pos, end, "/* credit */ " + credit->second);
+      n_calls[credit->second]++;
+      end++;
+    }
+
+    /* Skip to the closing comment of the call. */
+    for (pos = end + 1; pos < lines.size(); pos++)
+      if (lines[pos].find("/* Module Call */") != std::string::npos)
+        break;
+  }
+
+  if (last_decl < 0)
+    return;
+  std::string indent = lines[last_decl].substr(0, lines[last_decl].find_first_not_of(" \t"));
+  for (it = n_calls.begin(); it != n_calls.end(); it++)
+  {
+    if (it->second != 2)
+      printf("[AutoSA] Warning: The credit FIFO %s is connected to %d modules.\n",
+             it->first.c_str(), it->second);
+    snprintf(buf, sizeof(buf), "%d", gen->credit_depth[it->first]);
+    lines.insert(lines.begin() + last_decl, indent + "#pragma HLS STREAM variable=" +
+                                                it->first + " depth=" + buf + "\n");
+    lines.insert(lines.begin() + last_decl, indent + "hls::stream<int> " + it->first + ";\n");
+  }
+  if (!n_calls.empty())
+    lines.insert(lines.begin() + last_decl, indent + "/* Credit FIFOs */\n");
+}
+
+/* Connect the PEs in "lines" to the caches of the irregular arrays.
+ * The k-th PE call sends its requests to fifo_[array]_cache_req[k] and
+ * receives the elements from fifo_[array]_cache_resp[k], declared after
+ * the other FIFOs.  The caches are called after the module calls.
+ */
+static void top_gen_insert_caches(struct autosa_top_gen *gen,
+                                  std::vector<std::string> &lines)
+{
+  int last_decl = -1, last_call = -1, n_pe = 0;
+  char buf[64];
+
+  for (size_t pos = 0; pos < lines.size(); pos++)
+  {
+    size_t end;
+
+    if (lines[pos].find("/* FIFO Declaration */") != std::string::npos)
+      last_decl = pos;
+    if (lines[pos].find("/* Module Call */") == std::string::npos ||
+        pos + 1 >= lines.size())
+      continue;
+
+    for (end = pos + 2; end < lines.size(); end++)
+      if (top_gen_strip(lines[end]) == ");")
+        break;
+    if (end >= lines.size())
+      break;
+
+    if (top_gen_strip(lines[pos + 1]) == "PE_wrapper(")
+    {
+      for (size_t i = 0; i < gen->caches.size(); i++)
+      {
+        const std::string &array = gen->caches[i].array;
+
+        snprintf(buf, sizeof(buf), "[%d]", n_pe);
+        top_gen_append_call_arg(lines, pos, end,
+                                "/* cache */ fifo_" + array + "_cache_req" + buf);
+        end++;
+        top_gen_append_call_arg(lines, pos, end,
+                                "/* cache */ fifo_" + array + "_cache_resp" + buf);
+        end++;
+      }
+      n_pe++;
+    }
+
+    /* Skip to the closing comment of the call. */
+    for (pos = end + 1; pos < lines.size(); pos++)
+      if (lines[pos].find("/* Module Call */") != std::string::npos)
+        break;
+    last_call = pos;
+  }
+
+  if (n_pe == 0 || last_decl < 0 || last_call < 0 ||
+      last_call >= (int)lines.size())
+  {
+    printf("[AutoSA] Warning: Failed to connect the PEs to the caches of the irregular arrays.\n");
+    return;
+  }
+
+  std::string indent = lines[last_call].substr(0,
+                                               lines[last_call].find_first_not_of(" \t"));
+  for (size_t i = gen->caches.size(); i-- > 0;)
+  {
+    const struct top_gen_cache &cache = gen->caches[i];
+
+    snprintf(buf, sizeof(buf), "<%s, %d, %d, %d>(", cache.type.c_str(), n_pe,
+             cache.sets, cache.ways);
+    lines.insert(lines.begin() + last_call + 1,
+                 indent + "autosa_cache" + buf + cache.array + ", fifo_" +
+                     cache.array + "_cache_req, fifo_" + cache.array +
+                     "_cache_resp, " + cache.size + ");\n");
+  }
+  lines.insert(lines.begin() + last_call + 1, "\n");
+
+  indent = lines[last_decl].substr(0, lines[last_decl].find_first_not_of(" \t"));
+  for (size_t i = gen->caches.size(); i-- > 0;)
+  {
+    const struct top_gen_cache &cache = gen->caches[i];
+    std::string req = "fifo_" + cache.array + "_cache_req";
+    std::string resp = "fifo_" + cache.array + "_cache_resp";
+
+    snprintf(buf, sizeof(buf), "[%d];\n", n_pe);
+    lines.insert(lines.begin() + last_decl, indent + "#pragma HLS STREAM variable=" +
+                                                resp + " depth=2\n");
+    lines.insert(lines.begin() + last_decl, indent + "hls::stream<" + cache.type +
+                                                "> " + resp + buf);
+    lines.insert(lines.begin() + last_decl, indent + "#pragma HLS STREAM variable=" +
+                                                req + " depth=2\n");
+    lines.insert(lines.begin() + last_decl, indent + "hls::stream<int> " + req + buf);
+  }
+  lines.insert(lines.begin() + last_decl, indent + "/* Cache FIFOs */\n");
+
+  printf("[AutoSA] %d PEs are connected to the caches of %d irregular arrays.\n",
+         n_pe, (int)gen->caches.size());
+}
+
+static void top_gen_insert_perf_counters(struct autosa_top_gen *gen,
+                                         std::vector<std::string> &lines)
+{
+  const char *id_prefix = "/* module id */ ";
+  int last_decl = -1, last_call = -1;
+  char buf[64];
+
+  gen->perf_names.clear();
+  for (size_t pos = 0; pos < lines.size(); pos++)
+  {
+    std::string name, arg;
+    size_t end;
+
+    if (lines[pos].find("/* FIFO Declaration */") != std::string::npos)
+      last_decl = pos;
+    if (lines[pos].find("/* Module Call */") == std::string::npos ||
+        pos + 1 >= lines.size())
+      continue;
+
+    name = top_gen_drop_suffix(top_gen_drop_tail(top_gen_strip(lines[pos + 1]), 1),
+                               "_wrapper");
+    for (end = pos + 2; end < lines.size(); end++)
+    {
+      if (top_gen_strip(lines[end]) == ");")
+        break;
+      if (!(arg = top_gen_call_arg(lines[end], id_prefix)).empty())
+        name += "_" + arg;
+    }
+    if (end >= lines.size())
+      break;
+
+    /* Append the FIFO of the counters to the arguments. */
+    snprintf(buf, sizeof(buf), "/* perf */ fifo_perf[%d]",
+             (int)gen->perf_names.size());
+    top_gen_append_call_arg(lines, pos, end, buf);
+    gen->perf_names.push_back(name);
+
+    /* Skip to the closing comment of the call. */
+    for (pos = end + 2; pos < lines.size(); pos++)
+      if (lines[pos].find("/* Module Call */") != std::string::npos)
+        break;
+    last_call = pos;
+  }
+
+  if (gen->perf_names.empty() || last_decl < 0 || last_call < 0 ||
+      last_call >= (int)lines.size())
+  {
+    gen->perf_names.clear();
+    printf("[AutoSA] Warning: Failed to connect the modules to the performance counters.\n");
+    return;
+  }
+
+  std::string indent = lines[last_call].substr(0,
+                                               lines[last_call].find_first_not_of(" \t"));
+  snprintf(buf, sizeof(buf), "autosa_perf_collect<%d>(fifo_perf, perf);\n",
+           (int)gen->perf_names.size());
+  lines.insert(lines.begin() + last_call + 1, indent + buf);
+  lines.insert(lines.begin() + last_call + 1, "\n");
+
+  indent = lines[last_decl].substr(0, lines[last_decl].find_first_not_of(" \t"));
+  snprintf(buf, sizeof(buf), "hls::stream<autosa_perf_t> fifo_perf[%d];\n",
+           (int)gen->perf_names.size());
+  lines.insert(lines.begin() + last_decl, indent + "#pragma HLS STREAM variable=fifo_perf depth=2\n");
+  lines.insert(lines.begin() + last_decl, indent + buf);
+  lines.insert(lines.begin() + last_decl, indent + "/* Performance Counters */\n");
+
+  printf("[AutoSA] %d modules are connected to the performance counters.\n",
+         (int)gen->perf_names.size());
+}
+
+/* Pass the module identifiers of the module calls in "lines" as template
+ * arguments, i.e., drop the arguments tagged as module identifiers,
+ * which are the leading arguments of the calls, and append them as
+ * template arguments to the called functions, e.g., "PE_wrapper<0, 1>(".
+ */
+static void top_gen_template_module_calls(std::vector<std::string> &lines)
+{
+  const char *id_prefix = "/* module id */ ";
+  std::vector<std::string> out;
+  int n_call = 0;
+
+  for (size_t pos = 0; pos < lines.size(); pos++)
+  {
+    std::string func, ids, arg;
+    std::vector<std::string> args;
+    size_t end, open;
+
+    out.push_back(lines[pos]);
+    if (lines[pos].find("/* Module Call */") == std::string::npos ||
+        pos + 1 >= lines.size())
+      continue;
+
+    for (end = pos + 2; end < lines.size(); end++)
+      if (top_gen_strip(lines[end]) == ");")
+        break;
+    if (end >= lines.size())
+      break;
+
+    func = lines[pos + 1];
+    open = func.rfind('(');
+    for (size_t i = pos + 2; i < end; i++)
+    {
+      if (open != std::string::npos &&
+          !(arg = top_gen_call_arg(lines[i], id_prefix)).empty())
+        ids += (ids.empty() ? "" : ", ") + arg;
+      else
+        args.push_back(lines[i]);
+    }
+    if (!ids.empty())
+    {
+      func.insert(open, "<" + ids + ">");
+      n_call++;
+    }
+    out.push_back(func);
+    out.insert(out.end(), args.begin(), args.end());
+    pos = end - 1;
+  }
+  lines.swap(out);
+
+  printf("[AutoSA] %d module calls are specialized on their module identifiers.\n",
+         n_call);
+}
+
+/* Replace the identifier "from" by "to" in "line".
+ */
+static std::string top_gen_rename(const std::string &line,
+                                  const std::string &from, const std::string &to)
+{
+  std::string str = line;
+  size_t pos = 0;
+
+  while ((pos = str.find(from, pos)) != std::string::npos)
+  {
+    size_t end = pos + from.size();
+    if ((pos == 0 || !(isalnum(str[pos - 1]) || str[pos - 1] == '_')) &&
+        (end >= str.size() || !(isalnum(str[end]) || str[end] == '_')))
+    {
+      str.replace(pos, from.size(), to);
+      end = pos + to.size();
+    }
+    pos = end;
+  }
+
+  return str;
+}
+
+/* Find the argument line of the FIFO "fifo" in the module call reading it
+ * in "lines", and the argument line of its performance counters.
+ * Return the argument line of the FIFO, or -1 if it is not found.
+ */
+static int top_gen_find_fifo_reader(struct autosa_top_gen *gen,
+                                    std::vector<std::string> &lines, const std::string &fifo, int *perf)
+{
+  const char *fifo_prefix = "/* fifo */ ";
+
+  for (size_t pos = 0; pos < lines.size(); pos++)
+  {
+    std::vector<int> fifo_lines;
+    std::string func;
+    size_t end;
+
+    if (lines[pos].find("/* Module Call */") == std::string::npos ||
+        pos + 1 >= lines.size())
+      continue;
+    func = top_gen_drop_tail(top_gen_strip(lines[pos + 1]), 1);
+    *perf = -1;
+    for (end = pos + 2; end < lines.size(); end++)
+    {
+      if (lines[end].find("/* Module Call */") != std::string::npos)
+        break;
+      if (!top_gen_call_arg(lines[end], fifo_prefix).empty())
+        fifo_lines.push_back(end);
+      else if (!top_gen_call_arg(lines[end], "/* perf */ ").empty())
+        *perf = end;
+    }
+    for (size_t j = 0; j < fifo_lines.size(); j++)
+    {
+      if (top_gen_call_arg(lines[fifo_lines[j]], fifo_prefix) != fifo)
+        continue;
+      if (*perf >= 0 && gen->fifo_dir(func.c_str(), j, fifo_lines.size(),
+                                      gen->fifo_dir_user) == 1)
+        return fifo_lines[j];
+    }
+    pos = end;
+  }
+
+  return -1;
+}
+
+/* Trace the occupancy of the FIFOs "trace_fifos" of "gen" in "lines".
+ * Each traced FIFO "F" is split into the FIFOs "F" and "F_trace" around
+ * an autosa_fifo_trace process, which holds the elements in a buffer of
+ * the depth of "F" and samples the occupancy of the buffer.
+ * The process stops once the module reading the FIFO has drained its
+ * performance counters, which it forwards to autosa_perf_collect.
+ * The samples of all the traced FIFOs are written out to the kernel
+ * argument "trace" by autosa_trace_collect.
+ * This is called once the module calls are connected to the performance
+ * counters.
+ */
+static void top_gen_insert_fifo_trace(struct autosa_top_gen *gen,
+                                      std::vector<std::string> &lines)
+{
+  const char *var = "#pragma HLS STREAM variable=";
+  std::vector<std::string> taps;
+  int collect = -1, perf_decl = -1;
+  char buf[64];
+
+  gen->trace_names.clear();
+  for (size_t t = 0; t < gen->trace_fifos.size(); t++)
+  {
+    const std::string &fifo = gen->trace_fifos[t];
+    std::string trace_fifo = fifo + "_trace", perf_arg, tap;
+    std::vector<std::string> decls;
+    int reader, perf, decl = -1, depth = -1;
+    size_t pos;
+
+    reader = gen->fifo_dir ? top_gen_find_fifo_reader(gen, lines, fifo, &perf) : -1;
+    for (size_t i = 0; i < lines.size() && reader >= 0; i++)
+    {
+      std::string line = top_gen_strip(lines[i]);
+      if (line.find("hls::stream<") != std::string::npos &&
+          line.size() > fifo.size() + 1 &&
+          line.compare(line.size() - fifo.size() - 2, fifo.size() + 2,
+                       " " + fifo + ";") == 0)
+        decl = i;
+      else if (decl >= 0 && line.find("variable=" + fifo + " ") != std::string::npos)
+      {
+        if (line.find(var) != std::string::npos &&
+            (pos = line.find("depth=")) != std::string::npos)
+          depth = atoi(line.c_str() + pos + strlen("depth="));
+        decls.push_back(lines[i]);
+      }
+      else if (decl >= 0)
+        break;
+    }
+    if (reader < 0 || decl < 0 || depth <= 0)
+    {
+      printf("[AutoSA] Warning: FIFO %s is not found in the top module, it is not traced.\n",
+             fifo.c_str());
+      continue;
+    }
+
+    /* Connect the reader to the second half of the FIFO, and forward its
+     * performance counters through the trace process.
+     */
+    lines[reader] = top_gen_rename(lines[reader], fifo, trace_fifo);
+    perf_arg = top_gen_call_arg(lines[perf], "/* perf */ ");
+    snprintf(buf, sizeof(buf), "fifo_perf_trace[%d]", (int)gen->trace_names.size());
+    pos = lines[perf].find(perf_arg, lines[perf].find("/* perf */ "));
+    lines[perf].replace(pos, perf_arg.size(), buf);
+
+    /* Both halves of the FIFO are shallow, the buffer of the trace process
+     * takes over the depth of the FIFO.
+     */
+    decls.insert(decls.begin(), lines[decl]);
+    for (size_t i = 0; i < decls.size(); i++)
+    {
+      std::string line = top_gen_rename(decls[i], fifo, trace_fifo);
+      if ((pos = line.find(var)) != std::string::npos &&
+          (pos = line.find("depth=", pos)) != std::string::npos)
+      {
+        size_t end = line.find_first_not_of("0123456789", pos + strlen("depth="));
+        line.replace(pos, end - pos, "depth=2");
+        lines[decl + i] = top_gen_rename(line, trace_fifo, fifo);
+      }
+      decls[i] = line;
+    }
+    lines.insert(lines.begin() + decl + decls.size(), decls.begin(), decls.end());
+
+    snprintf(buf, sizeof(buf), "autosa_fifo_trace<%d>(", depth);
+    tap = buf + fifo + ", " + trace_fifo + ", ";
+    snprintf(buf, sizeof(buf), "fifo_perf_trace[%d], ", (int)gen->trace_names.size());
+    tap += buf + perf_arg + ", ";
+    snprintf(buf, sizeof(buf), "fifo_trace[%d]);\n", (int)gen->trace_names.size());
+    taps.push_back(tap + buf);
+    gen->trace_names.push_back(fifo);
+  }
+
+  for (size_t i = 0; i < lines.size(); i++)
+  {
+    if (lines[i].find("autosa_perf_collect<") != std::string::npos)
+      collect = i;
+    else if (lines[i].find("/* Performance Counters */") != std::string::npos)
+      perf_decl = i;
+  }
+  if (taps.empty() || collect < 0 || perf_decl < 0)
+  {
+    gen->trace_names.clear();
+    printf("[AutoSA] Warning: No FIFO is traced.\n");
+    return;
+  }
+
+  std::string indent = lines[collect].substr(0,
+                                             lines[collect].find_first_not_of(" \t"));
+  snprintf(buf, sizeof(buf), "autosa_trace_collect<%d>(fifo_trace, trace);\n",
+           (int)taps.size());
+  lines.insert(lines.begin() + collect + 1, indent + buf);
+  for (int i = taps.size() - 1; i >= 0; i--)
+    lines.insert(lines.begin() + collect, indent + taps[i]);
+
+  /* The declarations follow the performance counters. */
+  indent = lines[perf_decl].substr(0, lines[perf_decl].find_first_not_of(" \t"));
+  std::vector<std::string> decls;
+  decls.push_back(indent + "/* FIFO Trace */\n");
+  snprintf(buf, sizeof(buf), "hls::stream<autosa_perf_t> fifo_perf_trace[%d];\n",
+           (int)taps.size());
+  decls.push_back(indent + buf);
+  decls.push_back(indent + "#pragma HLS STREAM variable=fifo_perf_trace depth=2\n");
+  snprintf(buf, sizeof(buf), "hls::stream<unsigned int> fifo_trace[%d];\n",
+           (int)taps.size());
+  decls.push_back(indent + buf);
+  decls.push_back(indent + "#pragma HLS STREAM variable=fifo_trace depth=2\n");
+  lines.insert(lines.begin() + perf_decl + 3, decls.begin(), decls.end());
+
+  printf("[AutoSA] %d FIFOs are traced.\n", (int)taps.size());
+}
+
+/* Connect the module "module" to the credit FIFO "fifo" of depth "depth"
+ * when the code is written out.
+ */
+void autosa_top_gen_add_credit(struct autosa_top_gen *gen, const char *module,
+                               const char *fifo, int depth)
+{
+  gen->credits[module] = fifo;
+  gen->credit_depth[fifo] = depth;
+}
+
+/* Pass the module identifiers to the modules as template arguments
+ * when the code is written out.
+ */
+void autosa_top_gen_set_module_template(struct autosa_top_gen *gen,
+                                        int module_template)
+{
+  gen->module_template = module_template;
+}
+
+/* Connect the PEs to a cache of "sets" sets of "ways" ways in front of
+ * the irregular array "array" of element type "type" and of "size" elements
+ * when the code is written out.
+ */
+void autosa_top_gen_add_cache(struct autosa_top_gen *gen, const char *array,
+                              const char *type, const char *size, int sets,
+                              int ways)
+{
+  struct top_gen_cache cache = {array, type, size, sets, ways};
+
+  gen->caches.push_back(cache);
+}
+
+/* Floorplan the module calls on "n_slr" SLRs when the code is written out.
+ */
+void autosa_top_gen_set_n_slr(struct autosa_top_gen *gen, int n_slr)
+{
+  gen->n_slr = n_slr < 1 ? 1 : n_slr;
+}
+
+/* Insert a pipeline stage every "n" hops in the I/O daisy chains
+ * when the code is written out.
+ */
+void autosa_top_gen_set_chain_pipeline(struct autosa_top_gen *gen, int n)
+{
+  gen->chain_pipeline = n < 0 ? 0 : n;
+}
+
+/* Connect the module calls to the performance counters when the code is
+ * written out.
+ */
+void autosa_top_gen_set_perf_counters(struct autosa_top_gen *gen, int perf)
+{
+  gen->perf_counters = perf;
+}
+
+/* Trace the occupancy of the FIFOs in the comma-separated list "fifos"
+ * when the code is written out. The module reading each FIFO is found
+ * through "fifo_dir".
+ */
+void autosa_top_gen_set_fifo_trace(struct autosa_top_gen *gen,
+                                   const char *fifos,
+                                   int (*fifo_dir)(const char *func, int pos, int n_fifo, void *user),
+                                   void *user)
+{
+  std::string list = fifos ? fifos : "";
+  size_t start = 0;
+
+  gen->trace_fifos.clear();
+  while (start <= list.size())
+  {
+    size_t end = list.find(',', start);
+    std::string fifo;
+    if (end == std::string::npos)
+      end = list.size();
+    fifo = top_gen_strip(list.substr(start, end - start));
+    if (!fifo.empty())
+      gen->trace_fifos.push_back(fifo);
+    start = end + 1;
+  }
+  gen->fifo_dir = fifo_dir;
+  gen->fifo_dir_user = user;
+}
+
+/* Print the host function writing out the FIFO traces to a VCD file
+ * to "fp". The trace of the k-th traced FIFO starts at
+ * k * (AUTOSA_TRACE_DEPTH + 1) with the number of samples, followed by
+ * the samples, each packing the occupancy of the FIFO in the lower
+ * 16 bits, and the cycles of the sampling period during which the FIFO
+ * was empty and full in the next two bytes.
+ * The VCD time unit is a kernel cycle.
+ */
+static void top_gen_write_fifo_trace(struct autosa_top_gen *gen, FILE *fp)
+{
+  int n = gen->trace_names.size();
+
+  fprintf(fp, "\n#define AUTOSA_N_TRACE %d\n", n);
+  fprintf(fp, "#define AUTOSA_TRACE_DEPTH %d\n", AUTOSA_FIFO_TRACE_DEPTH);
+  fprintf(fp, "#define AUTOSA_TRACE_PERIOD %d\n", AUTOSA_FIFO_TRACE_PERIOD);
+  fprintf(fp, "#define AUTOSA_TRACE_SIZE %d\n\n",
+          n > 0 ? n * (AUTOSA_FIFO_TRACE_DEPTH + 1) : 1);
+  if (n == 0)
+  {
+    fprintf(fp, "static void autosa_trace_write(const unsigned int *trace, const char *path)\n");
+    fprintf(fp, "{\n");
+    fprintf(fp, "}\n");
+    return;
+  }
+
+  fprintf(fp, "static const char *autosa_trace_names[AUTOSA_N_TRACE] = {\n");
+  for (int i = 0; i < n; i++)
+    fprintf(fp, "    \"%s\"%s\n", gen->trace_names[i].c_str(),
+            i + 1 < n ? "," : "");
+  fprintf(fp, "};\n\n");
+
+  fprintf(fp, "static void autosa_trace_print_value(FILE *fp, unsigned int val, const char *id, int i)\n");
+  fprintf(fp, "{\n");
+  fprintf(fp, "    int bit = 31;\n");
+  fprintf(fp, "    while (bit > 0 && !(val >> bit))\n");
+  fprintf(fp, "        bit--;\n");
+  fprintf(fp, "    fprintf(fp, \"b\");\n");
+  fprintf(fp, "    for (; bit >= 0; bit--)\n");
+  fprintf(fp, "        fprintf(fp, \"%%u\", (val >> bit) & 1);\n");
+  fprintf(fp, "    fprintf(fp, \" %%s%%d\\n\", id, i);\n");
+  fprintf(fp, "}\n\n");
+
+  fprintf(fp, "static void autosa_trace_write(const unsigned int *trace, const char *path)\n");
+  fprintf(fp, "{\n");
+  fprintf(fp, "    FILE *fp = fopen(path, \"w\");\n");
+  fprintf(fp, "    unsigned int n_sample = 0;\n");
+  fprintf(fp, "    if (!fp) {\n");
+  fprintf(fp, "        printf(\"Cannot open the trace file %%s\\n\", path);\n");
+  fprintf(fp, "        return;\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "    fprintf(fp, \"$timescale 1ns $end\\n\");\n");
+  fprintf(fp, "    fprintf(fp, \"$comment time unit: one kernel cycle, sampled every %%d cycles $end\\n\", AUTOSA_TRACE_PERIOD);\n");
+  fprintf(fp, "    fprintf(fp, \"$scope module kernel $end\\n\");\n");
+  fprintf(fp, "    for (int i = 0; i < AUTOSA_N_TRACE; i++) {\n");
+  fprintf(fp, "        fprintf(fp, \"$var integer 16 o%%d %%s_occupancy $end\\n\", i, autosa_trace_names[i]);\n");
+  fprintf(fp, "        fprintf(fp, \"$var integer 8 e%%d %%s_empty $end\\n\", i, autosa_trace_names[i]);\n");
+  fprintf(fp, "        fprintf(fp, \"$var integer 8 f%%d %%s_full $end\\n\", i, autosa_trace_names[i]);\n");
+  fprintf(fp, "        if (trace[i * (AUTOSA_TRACE_DEPTH + 1)] > n_sample)\n");
+  fprintf(fp, "            n_sample = trace[i * (AUTOSA_TRACE_DEPTH + 1)];\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "    fprintf(fp, \"$upscope $end\\n$enddefinitions $end\\n\");\n");
+  fprintf(fp, "    for (unsigned int s = 0; s < n_sample; s++) {\n");
+  fprintf(fp, "        fprintf(fp, \"#%%lu\\n\", (unsigned long)(s + 1) * AUTOSA_TRACE_PERIOD);\n");
+  fprintf(fp, "        for (int i = 0; i < AUTOSA_N_TRACE; i++) {\n");
+  fprintf(fp, "            const unsigned int *t = trace + i * (AUTOSA_TRACE_DEPTH + 1);\n");
+  fprintf(fp, "            if (s >= t[0])\n");
+  fprintf(fp, "                continue;\n");
+  fprintf(fp, "            autosa_trace_print_value(fp, t[1 + s] & 0xffff, \"o\", i);\n");
+  fprintf(fp, "            autosa_trace_print_value(fp, (t[1 + s] >> 16) & 0xff, \"e\", i);\n");
+  fprintf(fp, "            autosa_trace_print_value(fp, t[1 + s] >> 24, \"f\", i);\n");
+  fprintf(fp, "        }\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "    fclose(fp);\n");
+  fprintf(fp, "    printf(\"FIFO traces are written to %%s\\n\", path);\n");
+  fprintf(fp, "}\n");
+}
+
+/* Print the names of the module instances connected to the performance
+ * counters and the host function printing out the counters to "fp".
+ * The utilization of a module instance is the percentage of its FIFO
+ * accesses served without stalling.
+ * If FIFOs are traced, the host function writing out the traces is
+ * printed as well.
+ */
+isl_stat autosa_top_gen_write_perf_counters(struct autosa_top_gen *gen,
+                                            FILE *fp)
+{
+  int n = gen->perf_names.size();
+
+  if (n == 0)
+    return isl_stat_error;
+
+  fprintf(fp, "#include <stdio.h>\n\n");
+  fprintf(fp, "#define AUTOSA_N_PERF %d\n\n", n);
+  fprintf(fp, "static const char *autosa_perf_names[AUTOSA_N_PERF] = {\n");
+  for (int i = 0; i < n; i++)
+    fprintf(fp, "    \"%s\"%s\n", gen->perf_names[i].c_str(),
+            i + 1 < n ? "," : "");
+  fprintf(fp, "};\n\n");
+
+  fprintf(fp, "static void autosa_perf_print(const unsigned int *perf)\n");
+  fprintf(fp, "{\n");
+  fprintf(fp, "    printf(\"%%-32s %%12s %%12s %%12s %%8s\\n\", \"Module\", \"Active\", \"Empty\", \"Full\", \"Util\");\n");
+  fprintf(fp, "    for (int i = 0; i < AUTOSA_N_PERF; i++) {\n");
+  fprintf(fp, "        unsigned long total = (unsigned long)perf[3 * i] + perf[3 * i + 1] + perf[3 * i + 2];\n");
+  fprintf(fp, "        printf(\"%%-32s %%12u %%12u %%12u %%7.2f%%%%\\n\", autosa_perf_names[i],\n");
+  fprintf(fp, "               perf[3 * i], perf[3 * i + 1], perf[3 * i + 2],\n");
+  fprintf(fp, "               total ? 100.0 * perf[3 * i] / total : 0.0);\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "}\n");
+  if (!gen->trace_fifos.empty())
+    top_gen_write_fifo_trace(gen, fp);
+
+  return isl_stat_ok;
+}
+
+/* Return the SLR of the module accessing the kernel port "port",
+ * or -1 if the port is not accessed or the code is not floorplanned.
+ */
+int autosa_top_gen_get_port_slr(struct autosa_top_gen *gen, const char *port)
+{
+  std::map<std::string, int>::iterator it = gen->port_slr.find(port);
+
+  if (it == gen->port_slr.end())
+    return -1;
+  return it->second;
+}
+
+/* Print the floorplan of the module calls of the kernel "kernel" as
+ * Vivado pblock constraints to "fp", with one pblock per SLR.
+ */
+isl_stat autosa_top_gen_write_pblocks(struct autosa_top_gen *gen, FILE *fp,
+                                      const char *kernel)
+{
+  if (gen->n_slr <= 1 || gen->inst_slr.empty())
+    return isl_stat_ok;
+
+  fprintf(fp, "# Floorplan of the modules of %s on %d SLRs\n", kernel,
+          gen->n_slr);
+  for (int i = 0; i < gen->n_slr; i++)
+  {
+    fprintf(fp, "create_pblock pblock_%s_SLR%d\n", kernel, i);
+    fprintf(fp, "resize_pblock pblock_%s_SLR%d -add SLR%d\n", kernel, i, i);
+  }
+  for (size_t i = 0; i < gen->inst_slr.size(); i++)
+    fprintf(fp, "add_cells_to_pblock -quiet pblock_%s_SLR%d "
+                "[get_cells -quiet -hier -filter {NAME =~ */%s_1/*/%s}]\n",
+            kernel, gen->inst_slr[i].second, kernel,
+            gen->inst_slr[i].first.c_str());
+
+  return isl_stat_ok;
+}
+
+/* Map the PEs on the AI Engines when the code is written out.
+ * The directions of the FIFO arguments of the PEs are found through
+ * "fifo_dir".
+ */
+void autosa_top_gen_set_aie(struct autosa_top_gen *gen, int aie,
+                            int (*fifo_dir)(const char *func, int pos, int n_fifo, void *user),
+                            void *user)
+{
+  gen->aie = aie;
+  gen->fifo_dir = fifo_dir;
+  gen->fifo_dir_user = user;
+}
+
+/* Move the PEs to their own kernel in the clock of "pe_clock" MHz when
+ * the code is written out, if "pe_clock" is positive.
+ * The directions of the FIFO arguments of the PEs are found through
+ * "fifo_dir".
+ */
+void autosa_top_gen_set_pe_clock(struct autosa_top_gen *gen, int pe_clock,
+                                 int (*fifo_dir)(const char *func, int pos, int n_fifo, void *user),
+                                 void *user)
+{
+  gen->pe_clock = pe_clock;
+  gen->fifo_dir = fifo_dir;
+  gen->fifo_dir_user = user;
+}
+
+/* Print the Vitis linker configuration of the clocks of the compute units
+ * of "kernel" and of its PE kernel to "fp", with the kernel clock of
+ * "kernel_clock" MHz.
+ * The boundary FIFOs of the PE kernel are connected to the compute unit
+ * of "kernel" through AXI4-Stream FIFOs, which cross the clock domains.
+ */
+isl_stat autosa_top_gen_write_clock_config(struct autosa_top_gen *gen,
+                                           FILE *fp, const char *kernel, int kernel_clock)
+{
+  const char *pe_kernel = gen->pe_kernel_name.c_str();
+
+  if (gen->pe_kernel_name.empty())
+    return isl_stat_error;
+
+  fprintf(fp, "[connectivity]\n");
+  fprintf(fp, "nk=%s:1:%s_1\n", pe_kernel, pe_kernel);
+  for (size_t i = 0; i < gen->pe_ports.size(); i++)
+  {
+    const char *fifo = gen->pe_ports[i].first.c_str();
+    if (gen->pe_ports[i].second == 1)
+      fprintf(fp, "stream_connect=%s_1.%s:%s_1.%s:%d\n", kernel, fifo,
+              pe_kernel, fifo, AUTOSA_CDC_FIFO_DEPTH);
+    else
+      fprintf(fp, "stream_connect=%s_1.%s:%s_1.%s:%d\n", pe_kernel, fifo,
+              kernel, fifo, AUTOSA_CDC_FIFO_DEPTH);
+  }
+  fprintf(fp, "\n[clock]\n");
+  fprintf(fp, "freqHz=%ld:%s_1\n", (long)kernel_clock * 1000000, kernel);
+  fprintf(fp, "freqHz=%ld:%s_1\n", (long)gen->pe_clock * 1000000, pe_kernel);
+
+  return isl_stat_ok;
+}
+
+/* Run each module call in its own thread when the code is written out. */
+void autosa_top_gen_set_threads(struct autosa_top_gen *gen, int threads)
+{
+  gen->threads = threads;
+}
+
+/* Launch each module call in "lines" in its own thread.
+ * Each module call enclosed by the module call markers is wrapped
+ * in a lambda that is run by a new thread. The threads are joined after
+ * the last module call.
+ */
+static void top_gen_spawn_threads(std::vector<std::string> &lines)
+{
+  std::vector<std::string> out;
+  std::string indent;
+  bool in_call = false;
+  bool declared = false;
+  int last = -1;
+
+  for (size_t i = 0; i < lines.size(); i++)
+  {
+    const std::string &line = lines[i];
+
+    if (line.find("/* Module Call */") == std::string::npos)
+    {
+      out.push_back(line);
+      continue;
+    }
+    indent = line.substr(0, line.find_first_not_of(" \t"));
+    if (!in_call)
+    {
+      if (!declared)
+        out.push_back(indent + "std::vector<std::thread> autosa_threads;\n");
+      declared = true;
+      out.push_back(line);
+      out.push_back(indent + "autosa_threads.emplace_back([&]() {\n");
+    }
+    else
+    {
+      out.push_back(indent + "});\n");
+      out.push_back(line);
+      last = out.size();
+    }
+    in_call = !in_call;
+  }
+  if (last != -1)
+  {
+    out.insert(out.begin() + last, indent + "for (auto &t : autosa_threads)\n");
+    out.insert(out.begin() + last + 1, indent + "  t.join();\n");
+  }
+  lines.swap(out);
+}
+
+/* Return the number of PEs mapped on the AI Engines. */
+int autosa_top_gen_get_n_aie_pe(struct autosa_top_gen *gen)
+{
+  return gen->aie_pes.size();
+}
+
+/* Print the template arguments, the module identifiers, of
+ * the AI Engine kernel of the PEs to "fp".
+ */
+static void top_gen_write_aie_ids(struct autosa_top_gen *gen, FILE *fp)
+{
+  fprintf(fp, "template <");
+  for (size_t i = 0; i < gen->aie_pes[0].first.size(); i++)
+    fprintf(fp, "%sint id%d", i > 0 ? ", " : "", (int)i);
+  fprintf(fp, ">\n");
+}
+
+/* Print the AI Engine kernel of the PEs, "PE_aie", to "fp" and its
+ * declaration to "fp_h".
+ * The kernel takes the module identifiers as template arguments and
+ * the FIFOs of the PE as AI Engine streams, and calls the PE on the
+ * HLS streams mapped on these streams by autosa_aie.h.
+ */
+isl_stat autosa_top_gen_write_aie_kernels(struct autosa_top_gen *gen,
+                                          FILE *fp_h, FILE *fp)
+{
+  int n_id;
+
+  if (gen->aie_pes.empty())
+    return isl_stat_error;
+  n_id = gen->aie_pes[0].first.size();
+
+  fprintf(fp_h, "#ifndef _AUTOSA_AIE_KERNELS_H\n");
+  fprintf(fp_h, "#define _AUTOSA_AIE_KERNELS_H\n\n");
+  fprintf(fp_h, "#include <adf.h>\n\n");
+  top_gen_write_aie_ids(gen, fp_h);
+  fprintf(fp_h, "void PE_aie(");
+  for (size_t j = 0; j < gen->aie_dirs.size(); j++)
+    fprintf(fp_h, "%s%s_stream<int32> *s%d", j > 0 ? ", " : "",
+            gen->aie_dirs[j] == 1 ? "input" : "output", (int)j);
+  fprintf(fp_h, ");\n\n");
+  fprintf(fp_h, "#endif\n");
+
+  fprintf(fp, "/* AI Engine kernel of the PEs */\n");
+  top_gen_write_aie_ids(gen, fp);
+  fprintf(fp, "void PE_aie(");
+  for (size_t j = 0; j < gen->aie_dirs.size(); j++)
+    fprintf(fp, "%s%s_stream<int32> *s%d", j > 0 ? ", " : "",
+            gen->aie_dirs[j] == 1 ? "input" : "output", (int)j);
+  fprintf(fp, ")\n");
+  fprintf(fp, "{\n");
+  for (size_t j = 0; j < gen->aie_types.size(); j++)
+    fprintf(fp, "    hls::stream<%s> f%d(s%d);\n", gen->aie_types[j].c_str(),
+            (int)j, (int)j);
+  fprintf(fp, "    PE(");
+  for (int i = 0; i < n_id; i++)
+    fprintf(fp, "%sid%d", i > 0 ? ", " : "", i);
+  for (size_t j = 0; j < gen->aie_types.size(); j++)
+    fprintf(fp, "%sf%d", n_id + j > 0 ? ", " : "", (int)j);
+  fprintf(fp, ");\n");
+  fprintf(fp, "}\n");
+
+  return isl_stat_ok;
+}
+
+/* Compute the AI Engine tile of each PE in "gen", as the column and
+ * the row in "tiles".
+ * The PEs of 2D arrays are placed on the rows and the columns of
+ * the AI Engine array following their module identifiers, transposed
+ * if needed, and the PEs of 1D arrays are folded over the rows.
+ * Return false if the array doesn't fit on the AI Engine array, in which
+ * case the PEs are placed by the AI Engine compiler.
+ */
+static bool top_gen_place_aie(struct autosa_top_gen *gen,
+                              std::vector<std::pair<int, int> > &tiles)
+{
+  std::vector<long> extent;
+  int transpose;
+
+  for (size_t i = 0; i < gen->aie_pes.size(); i++)
+  {
+    const std::vector<long> &ids = gen->aie_pes[i].first;
+    for (size_t j = 0; j < ids.size(); j++)
+    {
+      if (extent.size() <= j)
+        extent.push_back(0);
+      if (ids[j] + 1 > extent[j])
+        extent[j] = ids[j] + 1;
+    }
+  }
+
+  tiles.clear();
+  if (extent.size() == 1 && extent[0] <= AUTOSA_AIE_COLS * AUTOSA_AIE_ROWS)
+  {
+    for (size_t i = 0; i < gen->aie_pes.size(); i++)
+    {
+      long id = gen->aie_pes[i].first[0];
+      tiles.push_back(std::make_pair(id % AUTOSA_AIE_COLS, id / AUTOSA_AIE_COLS));
+    }
+    return true;
+  }
+  if (extent.size() != 2)
+    return false;
+  if (extent[0] <= AUTOSA_AIE_ROWS && extent[1] <= AUTOSA_AIE_COLS)
+    transpose = 0;
+  else if (extent[1] <= AUTOSA_AIE_ROWS && extent[0] <= AUTOSA_AIE_COLS)
+    transpose = 1;
+  else
+    return false;
+  for (size_t i = 0; i < gen->aie_pes.size(); i++)
+  {
+    const std::vector<long> &ids = gen->aie_pes[i].first;
+    tiles.push_back(transpose ? std::make_pair((int)ids[0], (int)ids[1]) : std::make_pair((int)ids[1], (int)ids[0]));
+  }
+
+  return true;
+}
+
+/* Print the AI Engine graph "[kernel]_graph" of the PEs in "gen" to "fp".
+ * Each PE is an instance of the kernel PE_aie placed on its own tile.
+ * The FIFOs between two PEs are AI Engine streams, and the FIFOs between
+ * a PE and an I/O module are PLIOs named after the FIFOs, connected to
+ * the AXI4-Stream ports of the kernel in the programmable logic.
+ */
+isl_stat autosa_top_gen_write_aie_graph(struct autosa_top_gen *gen, FILE *fp,
+                                        const char *kernel)
+{
+  std::map<std::string, std::pair<int, int> > src, dst;
+  std::map<std::string, std::pair<int, int> >::iterator it;
+  std::vector<std::pair<int, int> > tiles;
+  std::set<std::string> plios;
+  int n_pe = gen->aie_pes.size();
+  bool placed;
+
+  if (gen->aie_pes.empty())
+    return isl_stat_error;
+  placed = top_gen_place_aie(gen, tiles);
+  if (!placed)
+    printf("[AutoSA] Warning: The %d PEs don't fit on the %dx%d AI Engine array, they are placed by the AI Engine compiler.\n",
+           n_pe, AUTOSA_AIE_COLS, AUTOSA_AIE_ROWS);
+
+  /* "src" and "dst" contain the PE and the port writing and reading
+   * each FIFO. */
+  for (int i = 0; i < n_pe; i++)
+  {
+    const std::vector<std::string> &fifos = gen->aie_pes[i].second;
+    int n_in = 0, n_out = 0;
+    for (size_t j = 0; j < fifos.size() && j < gen->aie_dirs.size(); j++)
+    {
+      if (gen->aie_dirs[j] == 1)
+        dst[fifos[j]] = std::make_pair(i, n_in++);
+      else
+        src[fifos[j]] = std::make_pair(i, n_out++);
+    }
+  }
+  for (size_t i = 0; i < gen->aie_plios.size(); i++)
+    plios.insert(gen->aie_plios[i].first);
+
+  fprintf(fp, "/* AI Engine graph of the PEs of %s */\n", kernel);
+  fprintf(fp, "#ifndef _AUTOSA_AIE_GRAPH_H\n");
+  fprintf(fp, "#define _AUTOSA_AIE_GRAPH_H\n\n");
+  fprintf(fp, "#include <adf.h>\n");
+  fprintf(fp, "#include \"kernels.h\"\n\n");
+  fprintf(fp, "using namespace adf;\n\n");
+  fprintf(fp, "class %s_graph : public graph\n", kernel);
+  fprintf(fp, "{\n");
+  fprintf(fp, "public:\n");
+  fprintf(fp, "    kernel pe[%d];\n", n_pe);
+  for (size_t i = 0; i < gen->aie_plios.size(); i++)
+    fprintf(fp, "    %s_plio %s;\n", gen->aie_plios[i].second == 1 ? "input" : "output",
+            gen->aie_plios[i].first.c_str());
+  fprintf(fp, "\n");
+  fprintf(fp, "    %s_graph()\n", kernel);
+  fprintf(fp, "    {\n");
+  for (int i = 0; i < n_pe; i++)
+  {
+    const std::vector<long> &ids = gen->aie_pes[i].first;
+    fprintf(fp, "        pe[%d] = kernel::create(PE_aie<", i);
+    for (size_t j = 0; j < ids.size(); j++)
+      fprintf(fp, "%s%ld", j > 0 ? ", " : "", ids[j]);
+    fprintf(fp, ">);\n");
+    fprintf(fp, "        source(pe[%d]) = \"kernels.cc\";\n", i);
+    fprintf(fp, "        runtime<ratio>(pe[%d]) = 0.9;\n", i);
+    if (placed)
+      fprintf(fp, "        location<kernel>(pe[%d]) = tile(%d, %d);\n", i,
+              tiles[i].first, tiles[i].second);
+  }
+  fprintf(fp, "\n");
+  for (size_t i = 0; i < gen->aie_plios.size(); i++)
+  {
+    const std::string &fifo = gen->aie_plios[i].first;
+    if (gen->aie_plios[i].second == 1)
+    {
+      fprintf(fp, "        %s = input_plio::create(\"%s\", plio_128_bits, \"data/%s.txt\");\n",
+              fifo.c_str(), fifo.c_str(), fifo.c_str());
+      fprintf(fp, "        connect<stream>(%s.out[0], pe[%d].in[%d]);\n", fifo.c_str(),
+              dst[fifo].first, dst[fifo].second);
+    }
+    else
+    {
+      fprintf(fp, "        %s = output_plio::create(\"%s\", plio_128_bits, \"data/%s.txt\");\n",
+              fifo.c_str(), fifo.c_str(), fifo.c_str());
+      fprintf(fp, "        connect<stream>(pe[%d].out[%d], %s.in[0]);\n",
+              src[fifo].first, src[fifo].second, fifo.c_str());
+    }
+  }
+  for (it = src.begin(); it != src.end(); it++)
+  {
+    if (plios.count(it->first) || !dst.count(it->first))
+      continue;
+    fprintf(fp, "        connect<stream>(pe[%d].out[%d], pe[%d].in[%d]);\n",
+            it->second.first, it->second.second, dst[it->first].first,
+            dst[it->first].second);
+  }
+  fprintf(fp, "    }\n");
+  fprintf(fp, "};\n\n");
+  fprintf(fp, "#endif\n");
+
+  return isl_stat_ok;
+}
+
+/* Print the Vitis connectivity of the PLIOs of the AI Engine graph to
+ * the AXI4-Stream ports of the compute unit of "kernel" to "fp".
+ */
+isl_stat autosa_top_gen_write_aie_connectivity(struct autosa_top_gen *gen,
+                                               FILE *fp, const char *kernel)
+{
+  if (gen->aie_pes.empty())
+    return isl_stat_error;
+
+  fprintf(fp, "[connectivity]\n");
+  for (size_t i = 0; i < gen->aie_plios.size(); i++)
+  {
+    const char *fifo = gen->aie_plios[i].first.c_str();
+    if (gen->aie_plios[i].second == 1)
+      fprintf(fp, "stream_connect=%s_1.%s:ai_engine_0.%s\n", kernel, fifo, fifo);
+    else
+      fprintf(fp, "stream_connect=ai_engine_0.%s:%s_1.%s\n", fifo, kernel, fifo);
+  }
+
+  return isl_stat_ok;
+}
+
+/* Return the top module code printed so far. */
+char *autosa_top_gen_get_str(struct autosa_top_gen *gen)
+{
+  return isl_printer_get_str(gen->p);
+}
+
+/* Write out the top module code printed so far to "fp".
+ * If "reorder" is set, the module calls are reordered the same way
+ * as in autosa_scripts/codegen.py before being written out.
+ * The module calls are floorplanned if more than one SLR is set, and
+ * the I/O daisy chains are pipelined if "chain_pipeline" is set.
+ * If "aie" is set, the PEs are first removed from the top module to be
+ * mapped on the AI Engines, and if "pe_clock" is set, they are moved to
+ * the PE kernel in the PE clock.
+ * The module calls are connected to the credit FIFOs and to
+ * the performance counters last, once their order is final, followed by
+ * the FIFO traces.
+ * If "threads" is set, the module calls are finally run in their own
+ * threads.
+ */
+isl_stat autosa_top_gen_write(struct autosa_top_gen *gen, FILE *fp,
+                              int reorder)
+{
+  char *str;
+  std::vector<std::string> lines;
+
+  str = isl_printer_get_str(gen->p);
+  if (!str)
+    return isl_stat_error;
+
+  const char *start = str;
+  while (*start)
+  {
+    const char *end = strchr(start, '\n');
+    end = end ? end + 1 : start + strlen(start);
+    lines.push_back(std::string(start, end - start));
+    start = end;
+  }
+  free(str);
+
+  if (reorder)
+    top_gen_reorder_module_calls(lines);
+  if (gen->aie)
+    top_gen_partition_aie(gen, lines);
+  if (gen->pe_clock > 0)
+    top_gen_partition_pe_clock(gen, lines);
+  if (gen->n_slr > 1)
+    top_gen_floorplan(gen, lines);
+  if (gen->chain_pipeline > 0)
+    top_gen_pipeline_chains(gen, lines);
+  if (!gen->credits.empty())
+    top_gen_insert_credits(gen, lines);
+  if (!gen->caches.empty())
+    top_gen_insert_caches(gen, lines);
+  if (gen->perf_counters)
+    top_gen_insert_perf_counters(gen, lines);
+  if (gen->perf_counters && !gen->perf_names.empty() &&
+      !gen->trace_fifos.empty())
+    top_gen_insert_fifo_trace(gen, lines);
+  if (gen->module_template)
+    top_gen_template_module_calls(lines);
+  if (gen->threads)
+    top_gen_spawn_threads(lines);
+
+  for (size_t i = 0; i < lines.size(); i++)
+    fputs(lines[i].c_str(), fp);
+
+  return isl_stat_ok;
+}
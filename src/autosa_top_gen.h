@@ -0,0 +1,74 @@
+/* Defines functions for generating the top module natively in AutoSA. */
+
+#ifndef _AUTOSA_TOP_GEN_H
+#define _AUTOSA_TOP_GEN_H
+
+#include <stdio.h>
+
+#include <isl/ctx.h>
+#include <isl/ast.h>
+#include <isl/printer.h>
+
+/* Number of samples of the trace of a FIFO */
+#define AUTOSA_FIFO_TRACE_DEPTH 1024
+/* Number of cycles between two samples of a FIFO trace */
+#define AUTOSA_FIFO_TRACE_PERIOD 64
+/* Number of columns and rows of the AI Engine array (VC1902) */
+#define AUTOSA_AIE_COLS 50
+#define AUTOSA_AIE_ROWS 8
+
+struct autosa_top_gen;
+
+struct autosa_top_gen *autosa_top_gen_alloc(isl_ctx *ctx);
+void autosa_top_gen_free(struct autosa_top_gen *gen);
+isl_stat autosa_top_gen_exec_str(struct autosa_top_gen *gen, const char *code);
+isl_stat autosa_top_gen_exec_tree(struct autosa_top_gen *gen,
+                                  __isl_keep isl_ast_node *tree,
+                                  __isl_give isl_printer *(*print_user)(
+                                      __isl_take isl_printer *p,
+                                      __isl_take isl_ast_print_options *options,
+                                      __isl_keep isl_ast_node *node, void *user),
+                                  void *user);
+void autosa_top_gen_set_var(struct autosa_top_gen *gen, const char *name,
+                            long val);
+long autosa_top_gen_get_var(struct autosa_top_gen *gen, const char *name);
+char *autosa_top_gen_get_str(struct autosa_top_gen *gen);
+void autosa_top_gen_set_n_slr(struct autosa_top_gen *gen, int n_slr);
+void autosa_top_gen_set_chain_pipeline(struct autosa_top_gen *gen, int n);
+void autosa_top_gen_set_perf_counters(struct autosa_top_gen *gen, int perf);
+void autosa_top_gen_add_credit(struct autosa_top_gen *gen, const char *module,
+                               const char *fifo, int depth);
+void autosa_top_gen_add_cache(struct autosa_top_gen *gen, const char *array,
+                              const char *type, const char *size, int sets,
+                              int ways);
+void autosa_top_gen_set_fifo_trace(struct autosa_top_gen *gen,
+                                   const char *fifos,
+                                   int (*fifo_dir)(const char *func, int pos, int n_fifo, void *user),
+                                   void *user);
+isl_stat autosa_top_gen_write_perf_counters(struct autosa_top_gen *gen,
+                                            FILE *fp);
+int autosa_top_gen_get_port_slr(struct autosa_top_gen *gen, const char *port);
+isl_stat autosa_top_gen_write_pblocks(struct autosa_top_gen *gen, FILE *fp,
+                                      const char *kernel);
+isl_stat autosa_top_gen_write(struct autosa_top_gen *gen, FILE *fp,
+                              int reorder);
+void autosa_top_gen_set_aie(struct autosa_top_gen *gen, int aie,
+                            int (*fifo_dir)(const char *func, int pos, int n_fifo, void *user),
+                            void *user);
+int autosa_top_gen_get_n_aie_pe(struct autosa_top_gen *gen);
+void autosa_top_gen_set_pe_clock(struct autosa_top_gen *gen, int pe_clock,
+                                 int (*fifo_dir)(const char *func, int pos, int n_fifo, void *user),
+                                 void *user);
+isl_stat autosa_top_gen_write_clock_config(struct autosa_top_gen *gen,
+                                           FILE *fp, const char *kernel, int kernel_clock);
+void autosa_top_gen_set_threads(struct autosa_top_gen *gen, int threads);
+void autosa_top_gen_set_module_template(struct autosa_top_gen *gen,
+                                        int module_template);
+isl_stat autosa_top_gen_write_aie_kernels(struct autosa_top_gen *gen,
+                                          FILE *fp_h, FILE *fp);
+isl_stat autosa_top_gen_write_aie_graph(struct autosa_top_gen *gen, FILE *fp,
+                                        const char *kernel);
+isl_stat autosa_top_gen_write_aie_connectivity(struct autosa_top_gen *gen,
+                                               FILE *fp, const char *kernel);
+
+#endif
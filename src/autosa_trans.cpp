@@ -1,10 +1,19 @@
+#include <math.h>
+#include <algorithm>
+#include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 #include "autosa_trans.h"
 #include "autosa_utils.h"
 #include "autosa_schedule_tree.h"
 #include "autosa_comm.h"
 #include "autosa_codegen.h"
+#include "autosa_explore.h"
+#include "autosa_profile.h"
+#include "autosa_server.h"
+#include "autosa_sim.h"
 
 /* A program is legal to be transformed to systolic array if and only if 
  * it satisfies the following constraints:
@@ -39,7 +48,10 @@ isl_bool sa_legality_check(__isl_keep isl_schedule *schedule, struct ppcg_scop *
   return isl_bool_true;
 }
 
-/* Load the tuning configuration file.  
+/* Load the JSON configuration file, e.g., the tuning configuration or 
+ * the hardware resource information.
+ * Under the compile server, the copy parsed by the server is used
+ * if the file has not been modified since.
  */
 static cJSON *load_tuning_config(char *config_file)
 {
@@ -48,6 +60,10 @@ static cJSON *load_tuning_config(char *config_file)
   cJSON *config = NULL;
   long length;
 
+  config = autosa_server_get_config(config_file);
+  if (config)
+    return config;
+
   f = fopen(config_file, "rb");
   if (f)
   {
@@ -77,200 +93,391 @@ static cJSON *load_tuning_config(char *config_file)
   return config;
 }
 
-/* Generate asyncrhonized systolic arrays with the given dimension.
- * For sync arrays, time loops are placed inside the space loops.
- * We will first select space loop candidates from the outermost loop band 
- * which carry dependences with distance less than or equal to 1. 
- * Then we will enumerate different space loop combinations by picking up "dim" 
- * space loops from the candidate pool.
+/* Dump out the tuning information "tuning" of the current PE optimization
+ * stage, which is missing the user-specified tiling factors.
+ * By default, the information is written to "tuning.json" under the output
+ * directory and the program exits.
+ * In the exploration mode, the information is attached to "sa" instead and
+ * isl_stat_error is returned so that the caller can abort the current stage
+ * and the design space explorer can enumerate the tiling factors in-process.
  */
-struct autosa_kernel **sa_space_time_transform_at_dim_async(
-    __isl_keep isl_schedule *schedule, struct ppcg_scop *scop,
-    isl_size dim, isl_size *num_sa)
+static isl_stat sa_tuning_info_dump(struct autosa_kernel *sa, cJSON *tuning)
 {
-  struct autosa_kernel **sas = NULL;
+  FILE *fp;
+  char *content;
+  isl_printer *p_str;
+  char *tuning_path;
 
-  /* Select space loop candidates.
-   * Space loops carry dependences with distance less or equal to 1.
-   */
-  isl_schedule_node *band = get_outermost_permutable_node(schedule);
-  isl_size band_w = isl_schedule_node_band_n_member(band);
-  isl_size *is_space_loop = (isl_size *)malloc(band_w * sizeof(isl_size));
-  isl_union_map *dep_flow = scop->dep_flow;
-  isl_union_map *dep_rar = scop->dep_rar;
-  isl_union_map *dep_total = isl_union_map_union(isl_union_map_copy(dep_flow),
-                                                 isl_union_map_copy(dep_rar));
-  isl_basic_map_list *deps = isl_union_map_get_basic_map_list(dep_total);
-  isl_size ndeps = isl_union_map_n_basic_map(dep_total);
+  if (sa->options->autosa->explore)
+  {
+    cJSON_Delete(sa->tuning);
+    sa->tuning = tuning;
+    return isl_stat_error;
+  }
 
-  for (int h = 0; h < band_w; h++)
+  p_str = isl_printer_to_str(sa->ctx);
+  p_str = isl_printer_print_str(p_str, sa->options->autosa->output_dir);
+  p_str = isl_printer_print_str(p_str, "/tuning.json");
+  tuning_path = isl_printer_get_str(p_str);
+  fp = fopen(tuning_path, "w");
+  if (!fp)
   {
-    int n;
-    for (n = 0; n < ndeps; n++)
+    printf("[AutoSA] Error: Cannot open file: %s\n", tuning_path);
+    exit(1);
+  }
+  content = cJSON_Print(tuning);
+  fprintf(fp, "%s", content);
+  fclose(fp);
+  free(content);
+  cJSON_Delete(tuning);
+  isl_printer_free(p_str);
+  free(tuning_path);
+  exit(0);
+}
+
+/* Return the distances of the dependences in "deps" at the loops of
+ * the permutable band "band" with "band_w" members, as an array of rows
+ * of "band_w" elements, and store the number of dependences in "n_dep".
+ * If "tagged" is set, the dependences are tagged with the references and
+ * are untagged first.
+ */
+static int *sa_band_dep_distances(__isl_keep isl_schedule_node *band,
+                                  __isl_keep isl_union_map *deps, isl_size band_w, int tagged, int *n_dep)
+{
+  isl_basic_map_list *list = isl_union_map_get_basic_map_list(deps);
+  isl_size ndeps = isl_union_map_n_basic_map(deps);
+  int *dis = (int *)malloc((ndeps * band_w + 1) * sizeof(int));
+
+  for (int n = 0; n < ndeps; n++)
+  {
+    isl_basic_map *dep = isl_basic_map_list_get_basic_map(list, n);
+    isl_vec *dep_dis;
+
+    if (tagged)
+      dep = isl_basic_map_from_map(isl_map_factor_domain(
+          isl_map_from_basic_map(dep)));
+    dep_dis = get_dep_dis_at_node(dep, band);
+    for (int h = 0; h < band_w; h++)
     {
-      isl_basic_map *dep = isl_basic_map_list_get_basic_map(deps, n);
-      isl_vec *dep_dis = get_dep_dis_at_node(dep, band);
       isl_val *val = isl_vec_get_element_val(dep_dis, h);
-      if (!(isl_val_is_one(val) || isl_val_is_zero(val)))
-      {
-        isl_vec_free(dep_dis);
-        isl_val_free(val);
-        isl_basic_map_free(dep);
-        break;
-      }
-
+      dis[n * band_w + h] = isl_val_get_num_si(val);
       isl_val_free(val);
-      isl_vec_free(dep_dis);
-      isl_basic_map_free(dep);
     }
-    is_space_loop[h] = (n == ndeps);
+    isl_vec_free(dep_dis);
+    isl_basic_map_free(dep);
+  }
+
+  isl_basic_map_list_free(list);
+  *n_dep = ndeps;
+
+  return dis;
+}
+
+/* Return the distances of the dependences of "scop" at the loops of
+ * the permutable band "band" of the systolic array candidates of type
+ * "type".
+ * All the candidates of the same type are derived from the same band by
+ * permuting (and possibly skewing) its loops, such that their dependence
+ * distances follow from those at the band. The distances are therefore
+ * computed once and cached in "scop", and only recomputed if
+ * the partial schedule of the band has changed.
+ */
+static struct autosa_dep_dis_table *sa_band_dep_dis_table(
+    __isl_keep isl_schedule_node *band, struct ppcg_scop *scop, int type)
+{
+  struct autosa_dep_dis_table *table = &scop->dep_dis[type];
+  isl_multi_union_pw_aff *partial;
+  isl_union_map *dep_total;
+  isl_size band_w = isl_schedule_node_band_n_member(band);
+
+  partial = isl_schedule_node_band_get_partial_schedule(band);
+  if (table->band && table->band_w == band_w &&
+      isl_multi_union_pw_aff_plain_is_equal(table->band, partial) == isl_bool_true)
+  {
+    isl_multi_union_pw_aff_free(partial);
+    return table;
   }
 
-  /* Perform loop permutation to generate all candidates. */
-  if (dim == 1)
+  isl_multi_union_pw_aff_free(table->band);
+  free(table->dis);
+  free(table->tagged_rar_dis);
+  free(table->tagged_flow_dis);
+  table->band = partial;
+  table->band_w = band_w;
+  dep_total = isl_union_map_union(isl_union_map_copy(scop->dep_flow),
+                                  isl_union_map_copy(scop->dep_rar));
+  table->dis = sa_band_dep_distances(band, dep_total, band_w, 0,
+                                     &table->n_dep);
+  isl_union_map_free(dep_total);
+  table->tagged_rar_dis = sa_band_dep_distances(band, scop->tagged_dep_rar,
+                                                band_w, 1, &table->n_tagged_rar);
+  table->tagged_flow_dis = sa_band_dep_distances(band, scop->tagged_dep_flow,
+                                                 band_w, 1, &table->n_tagged_flow);
+
+  return table;
+}
+
+/* Mark the loops of the band with the dependence distances "table" that
+ * are space loop candidates in "is_space_loop".
+ * Space loops carry dependences with distance less or equal to 1.
+ */
+static void sa_space_loop_candidates(struct autosa_dep_dis_table *table,
+                                     isl_size *is_space_loop)
+{
+  for (int h = 0; h < table->band_w; h++)
   {
-    for (int i = 0; i < band_w; i++)
+    int n;
+    for (n = 0; n < table->n_dep; n++)
     {
-      if (is_space_loop[i])
-      {
-        isl_schedule *new_schedule = isl_schedule_dup(schedule);
-        /* Make the loop i the outermost loop. */
-        for (int d = i; d > 0; d--)
-        {
-          isl_schedule_node *band = get_outermost_permutable_node(new_schedule);
-          isl_schedule_free(new_schedule);
-          new_schedule = loop_interchange_at_node(band, d, d - 1);
-        }
+      int d = table->dis[n * table->band_w + h];
+      if (d != 0 && d != 1)
+        break;
+    }
+    is_space_loop[h] = (n == table->n_dep);
+  }
+}
 
-        /* Update the hyperplane types. */
-        struct autosa_kernel *sa = autosa_kernel_from_schedule(new_schedule);
-        sa->scop = scop;
-        sa->type = AUTOSA_SA_TYPE_ASYNC;
-
-        /* Update the array dimension. */
-        sa->n_sa_dim = dim;
-        sa->array_part_w = 0;
-        sa->space_w = dim;
-        // TODO: incorrect, to fix.
-        sa->time_w = band_w - dim;
-
-        /* Add the new variant into the list. */
-        sas = (struct autosa_kernel **)realloc(sas, (*num_sa + 1) *
-                                                        sizeof(struct autosa_kernel *));
-        sas[*num_sa] = sa;
-        *num_sa = *num_sa + 1;
-      }
+/* Enumerate all the combinations of "dim" space loops from the space loop
+ * candidates "is_space_loop" of a band with "band_w" loops, and append
+ * the corresponding candidates of type "type" to "sas".
+ */
+static struct autosa_sa_candidate *sa_space_loop_combinations(
+    isl_size *is_space_loop, isl_size band_w, isl_size dim, int type,
+    struct autosa_sa_candidate *sas, isl_size *num_sa)
+{
+  int loops[3];
+  int m = 0;
+
+  /* Enumerate the increasing sequences of loops by backtracking. */
+  loops[0] = -1;
+  while (m >= 0)
+  {
+    loops[m]++;
+    while (loops[m] < band_w && !is_space_loop[loops[m]])
+      loops[m]++;
+    if (loops[m] >= band_w)
+    {
+      m--;
+      continue;
+    }
+    if (m < dim - 1)
+    {
+      loops[m + 1] = loops[m];
+      m++;
+      continue;
     }
+
+    sas = (struct autosa_sa_candidate *)realloc(sas, (*num_sa + 1) *
+                                                         sizeof(struct autosa_sa_candidate));
+    sas[*num_sa].type = type;
+    sas[*num_sa].n_sa_dim = dim;
+    sas[*num_sa].band_w = band_w;
+    for (int i = 0; i < dim; i++)
+      sas[*num_sa].space_loops[i] = loops[i];
+    sas[*num_sa].space_time_id = *num_sa;
+    sas[*num_sa].skew_loop = -1;
+    sas[*num_sa].skew_src = -1;
+    sas[*num_sa].skew_factor = 0;
+    sas[*num_sa].dataflow = 0;
+    *num_sa = *num_sa + 1;
+  }
+
+  return sas;
+}
+
+/* The maximal absolute value of the skewing factors searched by
+ * sa_space_loop_skew.
+ */
+#define AUTOSA_MAX_SKEW_FACTOR 2
+
+/* Is the skew of the loop "h" of the permutable band "band" by the loop
+ * "g" with the factor "factor" legal?
+ * That is, are the distances of all the validity dependences that are
+ * not carried by the outer bands non-negative at the skewed loop,
+ * such that the band remains permutable?
+ */
+static isl_bool sa_space_loop_skew_is_legal(__isl_keep isl_schedule_node *band,
+                                            struct ppcg_scop *scop, int h, int g, int factor)
+{
+  isl_ctx *ctx = isl_schedule_node_get_ctx(band);
+  isl_multi_union_pw_aff *prefix, *partial;
+  isl_union_pw_multi_aff *contraction;
+  isl_union_pw_aff *upa, *upa_src;
+  isl_union_map *dep, *umap;
+  isl_union_set *delta, *nonneg;
+  isl_bool legal;
+
+  prefix = isl_schedule_node_get_prefix_schedule_multi_union_pw_aff(band);
+  partial = isl_schedule_node_band_get_partial_schedule(band);
+  contraction = isl_schedule_node_get_subtree_contraction(band);
+  partial = isl_multi_union_pw_aff_pullback_union_pw_multi_aff(partial, contraction);
+  upa = isl_multi_union_pw_aff_get_union_pw_aff(partial, h);
+  upa_src = isl_multi_union_pw_aff_get_union_pw_aff(partial, g);
+  upa_src = isl_union_pw_aff_scale_val(upa_src, isl_val_int_from_si(ctx, factor));
+  upa = isl_union_pw_aff_add(upa, upa_src);
+  isl_multi_union_pw_aff_free(partial);
+
+  dep = isl_union_map_copy(scop->dep_flow);
+  if (scop->options->live_range_reordering)
+  {
+    dep = isl_union_map_union(dep, isl_union_map_copy(scop->dep_forced));
+    dep = isl_union_map_union(dep, isl_union_map_copy(scop->dep_order));
   }
-  else if (dim == 2)
+  else
   {
-    for (int i = 0; i < band_w; i++)
+    dep = isl_union_map_union(dep, isl_union_map_copy(scop->dep_false));
+  }
+  dep = isl_union_map_eq_at_multi_union_pw_aff(dep, prefix);
+  umap = isl_union_map_from_union_pw_aff(upa);
+  dep = isl_union_map_apply_domain(dep, isl_union_map_copy(umap));
+  dep = isl_union_map_apply_range(dep, umap);
+  delta = isl_union_map_deltas(dep);
+  nonneg = isl_union_set_from_set(isl_set_read_from_str(ctx, "{ [x] : x >= 0 }"));
+  legal = isl_union_set_is_subset(delta, nonneg);
+  isl_union_set_free(delta);
+  isl_union_set_free(nonneg);
+
+  return legal;
+}
+
+/* Search a skew of the loop "h" of the permutable band "band" that makes
+ * it a space loop candidate, given the dependence distances "dis" at the
+ * band computed by sa_band_dep_dis_table.
+ * The loop "h" is replaced by h + factor * g for another loop "g" of the
+ * band, with a non-zero factor of at most AUTOSA_MAX_SKEW_FACTOR in
+ * absolute value, such that the flow and RAR dependences have distance
+ * 0 or 1 at the skewed loop. Since the skewing factor is a constant,
+ * the uniform dependences remain uniform.
+ * The skews with the smallest factors are tried first.
+ * Return isl_bool_true and set "src" and "factor" if such a legal skew
+ * is found.
+ */
+static isl_bool sa_space_loop_skew(__isl_keep isl_schedule_node *band,
+                                   struct ppcg_scop *scop, int *dis, int n_dep, isl_size band_w,
+                                   int h, int *src, int *factor)
+{
+  for (int f = 1; f <= AUTOSA_MAX_SKEW_FACTOR; f++)
+  {
+    for (int sign = -1; sign <= 1; sign += 2)
     {
-      if (is_space_loop[i])
+      for (int g = 0; g < band_w; g++)
       {
-        for (int j = i + 1; j < band_w; j++)
-        {
-          if (is_space_loop[j])
-          {
-            isl_schedule *new_schedule = isl_schedule_dup(schedule);
-            /* Make the loop i, j the outermost loops. */
-            for (int d = j; d > 0; d--)
-            {
-              isl_schedule_node *band = get_outermost_permutable_node(new_schedule);
-              isl_schedule_free(new_schedule);
-              new_schedule = loop_interchange_at_node(band, d, d - 1);
-            }
-            for (int d = i + 1; d > 0; d--)
-            {
-              isl_schedule_node *band = get_outermost_permutable_node(new_schedule);
-              isl_schedule_free(new_schedule);
-              new_schedule = loop_interchange_at_node(band, d, d - 1);
-            }
+        int n;
+        isl_bool legal;
 
-            /* Update the hyperplane types. */
-            struct autosa_kernel *sa = autosa_kernel_from_schedule(new_schedule);
-            sa->scop = scop;
-            sa->type = AUTOSA_SA_TYPE_ASYNC;
-
-            /* Update the array dimension. */
-            sa->n_sa_dim = dim;
-            sa->array_part_w = 0;
-            sa->space_w = dim;
-            // TODO: incorrect, to fix.
-            sa->time_w = band_w - dim;
-
-            /* Add the new variant into the list. */
-            sas = (struct autosa_kernel **)realloc(sas, (*num_sa + 1) *
-                                                            sizeof(struct autosa_kernel *));
-            sas[*num_sa] = sa;
-            *num_sa = *num_sa + 1;
-          }
+        if (g == h)
+          continue;
+        for (n = 0; n < n_dep; n++)
+        {
+          int d = dis[n * band_w + h] + sign * f * dis[n * band_w + g];
+          if (d != 0 && d != 1)
+            break;
         }
+        if (n < n_dep)
+          continue;
+        legal = sa_space_loop_skew_is_legal(band, scop, h, g, sign * f);
+        if (legal < 0)
+          return isl_bool_error;
+        if (!legal)
+          continue;
+        *src = g;
+        *factor = sign * f;
+        return isl_bool_true;
       }
     }
   }
-  else if (dim == 3)
+
+  return isl_bool_false;
+}
+
+/* Append to "sas" the candidates of type "type" with "dim" space loops
+ * that are only exposed by skewing a loop of the permutable band "band",
+ * given the space loop candidates "is_space_loop" of the unskewed band.
+ * For each loop that is not a space loop candidate, a skew that makes
+ * it one is searched by sa_space_loop_skew, and the combinations of
+ * space loops that contain the skewed loop are appended.
+ * Only one loop is skewed in each candidate.
+ */
+static struct autosa_sa_candidate *sa_skewed_space_loop_combinations(
+    __isl_keep isl_schedule_node *band, struct ppcg_scop *scop,
+    isl_size *is_space_loop, isl_size band_w, isl_size dim, int type,
+    struct autosa_sa_candidate *sas, isl_size *num_sa)
+{
+  struct autosa_dep_dis_table *table = sa_band_dep_dis_table(band, scop, type);
+  int n_dep = table->n_dep;
+  int *dis = table->dis;
+  isl_size *is_skewed_space_loop = (isl_size *)malloc(band_w * sizeof(isl_size));
+
+  for (int h = 0; h < band_w; h++)
   {
+    int src, factor;
+    isl_size n_skewed = 0;
+    struct autosa_sa_candidate *skewed = NULL;
+    isl_bool found;
+
+    if (is_space_loop[h])
+      continue;
+    found = sa_space_loop_skew(band, scop, dis, n_dep, band_w, h, &src, &factor);
+    if (found != isl_bool_true)
+      continue;
+    if (scop->options->autosa->verbose)
+      printf("[AutoSA] Loop %d is skewed by loop %d with the factor %d to become a space loop.\n",
+             h, src, factor);
+
     for (int i = 0; i < band_w; i++)
+      is_skewed_space_loop[i] = is_space_loop[i] || i == h;
+    skewed = sa_space_loop_combinations(is_skewed_space_loop, band_w, dim,
+                                        type, skewed, &n_skewed);
+    for (int i = 0; i < n_skewed; i++)
     {
-      if (is_space_loop[i])
-      {
-        for (int j = i + 1; j < band_w; j++)
-        {
-          if (is_space_loop[j])
-          {
-            for (int k = j + 1; k < band_w; k++)
-            {
-              if (is_space_loop[k])
-              {
-                isl_schedule *new_schedule = isl_schedule_dup(schedule);
-                /* Make the loop i, j, k the outermost loops. */
-                for (int d = k; d > 0; d--)
-                {
-                  isl_schedule_node *band = get_outermost_permutable_node(new_schedule);
-                  isl_schedule_free(new_schedule);
-                  new_schedule = loop_interchange_at_node(band, d, d - 1);
-                }
-                for (int d = j + 1; d > 0; d--)
-                {
-                  isl_schedule_node *band = get_outermost_permutable_node(new_schedule);
-                  isl_schedule_free(new_schedule);
-                  new_schedule = loop_interchange_at_node(band, d, d - 1);
-                }
-                for (int d = i + 2; d > 0; d--)
-                {
-                  isl_schedule_node *band = get_outermost_permutable_node(new_schedule);
-                  isl_schedule_free(new_schedule);
-                  new_schedule = loop_interchange_at_node(band, d, d - 1);
-                }
-
-                /* Update the hyperplane types. */
-                struct autosa_kernel *sa = autosa_kernel_from_schedule(new_schedule);
-                sa->scop = scop;
-                sa->type = AUTOSA_SA_TYPE_ASYNC;
-
-                /* Update the array dimension. */
-                sa->n_sa_dim = dim;
-                sa->array_part_w = 0;
-                sa->space_w = dim;
-                // TODO: incorrect, to fix.
-                sa->time_w = band_w - dim;
-
-                /* Add the new variant into the list. */
-                sas = (struct autosa_kernel **)realloc(sas, (*num_sa + 1) *
-                                                                sizeof(struct autosa_kernel *));
-                sas[*num_sa] = sa;
-                *num_sa = *num_sa + 1;
-              }
-            }
-          }
-        }
-      }
+      int has_h = 0;
+      for (int j = 0; j < dim; j++)
+        has_h |= skewed[i].space_loops[j] == h;
+      if (!has_h)
+        continue;
+      skewed[i].skew_loop = h;
+      skewed[i].skew_src = src;
+      skewed[i].skew_factor = factor;
+      skewed[i].space_time_id = *num_sa;
+      sas = (struct autosa_sa_candidate *)realloc(sas, (*num_sa + 1) *
+                                                           sizeof(struct autosa_sa_candidate));
+      sas[*num_sa] = skewed[i];
+      *num_sa = *num_sa + 1;
     }
+    free(skewed);
   }
 
-  isl_basic_map_list_free(deps);
-  isl_union_map_free(dep_total);
+  free(is_skewed_space_loop);
+
+  return sas;
+}
+
+/* Generate asyncrhonized systolic arrays with the given dimension.
+ * For sync arrays, time loops are placed inside the space loops.
+ * We will first select space loop candidates from the outermost loop band 
+ * which carry dependences with distance less than or equal to 1. 
+ * Then we will enumerate different space loop combinations by picking up "dim" 
+ * space loops from the candidate pool.
+ * The candidates are only described by their space loops, and are
+ * expanded into kernels by sa_candidate_expand.
+ */
+struct autosa_sa_candidate *sa_space_time_transform_at_dim_async(
+    __isl_keep isl_schedule *schedule, struct ppcg_scop *scop,
+    isl_size dim, isl_size *num_sa)
+{
+  struct autosa_sa_candidate *sas = NULL;
+  isl_schedule_node *band = get_outermost_permutable_node(schedule);
+  isl_size band_w = isl_schedule_node_band_n_member(band);
+  isl_size *is_space_loop = (isl_size *)malloc(band_w * sizeof(isl_size));
+
+  sa_space_loop_candidates(sa_band_dep_dis_table(band, scop, AUTOSA_SA_TYPE_ASYNC),
+                           is_space_loop);
+  sas = sa_space_loop_combinations(is_space_loop, band_w, dim,
+                                   AUTOSA_SA_TYPE_ASYNC, sas, num_sa);
+  if (scop->options->autosa->loop_skew)
+    sas = sa_skewed_space_loop_combinations(band, scop, is_space_loop, band_w,
+                                            dim, AUTOSA_SA_TYPE_ASYNC, sas, num_sa);
+
   isl_schedule_node_free(band);
   free(is_space_loop);
 
@@ -283,193 +490,26 @@ struct autosa_kernel **sa_space_time_transform_at_dim_async(
  * which carry dependences with distance less than or equal to 1. 
  * Then we will enumerate different space loop combinations by picking up "dim" 
  * space loops from the candidate pool.
+ * The candidates are only described by their space loops, and are
+ * expanded into kernels by sa_candidate_expand.
  */
-struct autosa_kernel **sa_space_time_transform_at_dim_sync(
+struct autosa_sa_candidate *sa_space_time_transform_at_dim_sync(
     __isl_keep isl_schedule *schedule, struct ppcg_scop *scop,
     isl_size dim, isl_size *num_sa)
 {
-  struct autosa_kernel **sas = NULL;
-
-  /* Select space loop candidates.
-   * Space loops carry dependences with distance less or equal to 1.
-   */
+  struct autosa_sa_candidate *sas = NULL;
   isl_schedule_node *band = get_innermost_permutable_node(schedule);
   isl_size band_w = isl_schedule_node_band_n_member(band);
   isl_size *is_space_loop = (isl_size *)malloc(band_w * sizeof(isl_size));
-  isl_union_map *dep_flow = scop->dep_flow;
-  isl_union_map *dep_rar = scop->dep_rar;
-  isl_union_map *dep_total = isl_union_map_union(isl_union_map_copy(dep_flow),
-                                                 isl_union_map_copy(dep_rar));
-  isl_basic_map_list *deps = isl_union_map_get_basic_map_list(dep_total);
-  isl_size ndeps = isl_union_map_n_basic_map(dep_total);
-
-  for (int h = 0; h < band_w; h++)
-  {
-    int n;
-    for (n = 0; n < ndeps; n++)
-    {
-      isl_basic_map *dep = isl_basic_map_list_get_basic_map(deps, n);
-      isl_vec *dep_dis = get_dep_dis_at_node(dep, band);
-      isl_val *val = isl_vec_get_element_val(dep_dis, h);
-      if (!(isl_val_is_one(val) || isl_val_is_zero(val)))
-      {
-        isl_vec_free(dep_dis);
-        isl_val_free(val);
-        isl_basic_map_free(dep);
-        break;
-      }
-
-      isl_val_free(val);
-      isl_vec_free(dep_dis);
-      isl_basic_map_free(dep);
-    }
-    is_space_loop[h] = (n == ndeps);
-  }
-
-  /* Perform loop permutation to generate all candidates. */
-  if (dim == 1)
-  {
-    for (int i = 0; i < band_w; i++)
-    {
-      if (is_space_loop[i])
-      {
-        isl_schedule *new_schedule = isl_schedule_dup(schedule);
-        /* Make the loop i the innermost loop. */
-        for (int d = i; d < band_w - 1; d++)
-        {
-          isl_schedule_node *band = get_innermost_permutable_node(new_schedule);
-          isl_schedule_free(new_schedule);
-          new_schedule = loop_interchange_at_node(band, d, d + 1);
-        }
 
-        /* Update the hyperplane types. */
-        struct autosa_kernel *sa = autosa_kernel_from_schedule(new_schedule);
-        sa->scop = scop;
-        sa->type = AUTOSA_SA_TYPE_SYNC;
-
-        /* Update the array dimension. */
-        sa->n_sa_dim = dim;
-        sa->array_part_w = 0;
-        sa->space_w = dim;
-        // TODO: this is incorrect, we need to consider other loop bands.
-        sa->time_w = band_w - dim;
-
-        /* Add the new variant into the list. */
-        sas = (struct autosa_kernel **)realloc(sas, (*num_sa + 1) *
-                                                        sizeof(struct autosa_kernel *));
-        sas[*num_sa] = sa;
-        *num_sa = *num_sa + 1;
-      }
-    }
-  }
-  else if (dim == 2)
-  {
-    for (int i = 0; i < band_w; i++)
-    {
-      if (is_space_loop[i])
-      {
-        for (int j = i + 1; j < band_w; j++)
-        {
-          if (is_space_loop[j])
-          {
-            isl_schedule *new_schedule = isl_schedule_dup(schedule);
-            /* Make the loop i, j the innermost loops. */
-            for (int d = i; d < band_w - 1; d++)
-            {
-              isl_schedule_node *band = get_innermost_permutable_node(new_schedule);
-              isl_schedule_free(new_schedule);
-              new_schedule = loop_interchange_at_node(band, d, d + 1);
-            }
-            for (int d = j - 1; d < band_w - 1; d++)
-            {
-              isl_schedule_node *band = get_innermost_permutable_node(new_schedule);
-              isl_schedule_free(new_schedule);
-              new_schedule = loop_interchange_at_node(band, d, d + 1);
-            }
-
-            /* Update the hyperplane types. */
-            struct autosa_kernel *sa = autosa_kernel_from_schedule(new_schedule);
-            sa->scop = scop;
-            sa->type = AUTOSA_SA_TYPE_SYNC;
-
-            /* Update the array dimension. */
-            sa->n_sa_dim = dim;
-            sa->array_part_w = 0;
-            sa->space_w = dim;
-            // TODO: incorrect, to fix.
-            sa->time_w = band_w - dim;
-
-            /* Add the new variant into the list. */
-            sas = (struct autosa_kernel **)realloc(sas, (*num_sa + 1) *
-                                                            sizeof(struct autosa_kernel *));
-            sas[*num_sa] = sa;
-            *num_sa = *num_sa + 1;
-          }
-        }
-      }
-    }
-  }
-  else if (dim == 3)
-  {
-    for (int i = 0; i < band_w; i++)
-    {
-      if (is_space_loop[i])
-      {
-        for (int j = i + 1; j < band_w; j++)
-        {
-          if (is_space_loop[j])
-          {
-            for (int k = j + 1; k < band_w; k++)
-            {
-              if (is_space_loop[k])
-              {
-                isl_schedule *new_schedule = isl_schedule_dup(schedule);
-                /* Make the loop i, j, k the innermost loops. */
-                for (int d = i; d < band_w - 1; d++)
-                {
-                  isl_schedule_node *band = get_innermost_permutable_node(new_schedule);
-                  isl_schedule_free(new_schedule);
-                  new_schedule = loop_interchange_at_node(band, d, d + 1);
-                }
-                for (int d = j - 1; d < band_w - 1; d++)
-                {
-                  isl_schedule_node *band = get_innermost_permutable_node(new_schedule);
-                  isl_schedule_free(new_schedule);
-                  new_schedule = loop_interchange_at_node(band, d, d + 1);
-                }
-                for (int d = k - 2; d < band_w - 1; d++)
-                {
-                  isl_schedule_node *band = get_innermost_permutable_node(new_schedule);
-                  isl_schedule_free(new_schedule);
-                  new_schedule = loop_interchange_at_node(band, d, d + 1);
-                }
-
-                /* Update the hyperplane types. */
-                struct autosa_kernel *sa = autosa_kernel_from_schedule(new_schedule);
-                sa->scop = scop;
-                sa->type = AUTOSA_SA_TYPE_SYNC;
-
-                /* Update the array dimension. */
-                sa->n_sa_dim = dim;
-                sa->array_part_w = 0;
-                sa->space_w = dim;
-                sa->time_w = band_w - dim;
-
-                /* Add the new variant into the list. */
-                sas = (struct autosa_kernel **)realloc(sas, (*num_sa + 1) *
-                                                                sizeof(struct autosa_kernel *));
-                sas[*num_sa] = sa;
-                *num_sa = *num_sa + 1;
-              }
-            }
-          }
-        }
-      }
-    }
-  }
+  sa_space_loop_candidates(sa_band_dep_dis_table(band, scop, AUTOSA_SA_TYPE_SYNC),
+                           is_space_loop);
+  sas = sa_space_loop_combinations(is_space_loop, band_w, dim,
+                                   AUTOSA_SA_TYPE_SYNC, sas, num_sa);
+  if (scop->options->autosa->loop_skew)
+    sas = sa_skewed_space_loop_combinations(band, scop, is_space_loop, band_w,
+                                            dim, AUTOSA_SA_TYPE_SYNC, sas, num_sa);
 
-  isl_basic_map_list_free(deps);
-  isl_union_map_free(dep_total);
   isl_schedule_node_free(band);
   free(is_space_loop);
 
@@ -480,7 +520,7 @@ struct autosa_kernel **sa_space_time_transform_at_dim_sync(
  * Depending on the systolic array type set by users, we will generate 
  * async or sync arrays.
  */
-struct autosa_kernel **sa_space_time_transform_at_dim(
+struct autosa_sa_candidate *sa_space_time_transform_at_dim(
     __isl_keep isl_schedule *schedule, struct ppcg_scop *scop,
     isl_size dim, isl_size *num_sa)
 {
@@ -496,89 +536,118 @@ struct autosa_kernel **sa_space_time_transform_at_dim(
   return NULL;
 }
 
-/* Apply space-time transformation to generate different systolic array candidates. */
-struct autosa_kernel **sa_space_time_transform(__isl_take isl_schedule *schedule,
-                                               struct ppcg_scop *scop, isl_size *num_sa)
+/* Expand the systolic array candidate "cand" of the schedule "schedule"
+ * into a kernel.
+ * For async arrays, the space loops are made the outermost loops of
+ * the outermost permutable band.
+ * For sync arrays, the space loops are made the innermost loops of
+ * the innermost permutable band.
+ * The loop of the band to be skewed, if any, is skewed first.
+ */
+struct autosa_kernel *sa_candidate_expand(__isl_keep isl_schedule *schedule,
+                                          struct ppcg_scop *scop, struct autosa_sa_candidate *cand)
 {
-  struct autosa_kernel **sa_list = NULL;
-  isl_size n_sa = 0;
+  isl_schedule *new_schedule = isl_schedule_dup(schedule);
+  int dim = cand->n_sa_dim;
+  int band_w = cand->band_w;
 
-  isl_schedule_node *band = get_outermost_permutable_node(schedule);
-  isl_size band_w = isl_schedule_node_band_n_member(band);
-  /* Explore 1D systolic array */
-  if (scop->options->autosa->max_sa_dim >= 1 && band_w >= 1)
+  if (cand->skew_factor != 0)
   {
-    if (scop->options->autosa->verbose)
-    {
-      printf("AutoSA] Explore 1D systolic array.\n");
-    }
-    isl_size n_sa_dim = 0;
-    struct autosa_kernel **sa_dim_list = sa_space_time_transform_at_dim(
-        schedule, scop, 1, &n_sa_dim);
-    if (scop->options->autosa->verbose)
-    {
-      printf("[AutoSA] %d candidates generated.\n", n_sa_dim);
-    }
-    sa_list = (struct autosa_kernel **)realloc(sa_list,
-                                               (n_sa + n_sa_dim) * sizeof(struct autosa_kernel *));
-    for (int i = 0; i < n_sa_dim; i++)
-    {
-      sa_list[n_sa + i] = sa_dim_list[i];
-      sa_list[n_sa + i]->space_time_id = n_sa + i;
-    }
-    free(sa_dim_list);
-    n_sa += n_sa_dim;
+    isl_schedule_node *band;
+    if (cand->type == AUTOSA_SA_TYPE_ASYNC)
+      band = get_outermost_permutable_node(new_schedule);
+    else
+      band = get_innermost_permutable_node(new_schedule);
+    isl_schedule_free(new_schedule);
+    new_schedule = loop_skew_at_node(band, cand->skew_loop, cand->skew_src,
+                                     cand->skew_factor);
   }
-  /* Explore 2D systolic array */
-  if (scop->options->autosa->max_sa_dim >= 2 && band_w >= 2)
+
+  if (cand->type == AUTOSA_SA_TYPE_ASYNC)
   {
-    if (scop->options->autosa->verbose)
-    {
-      printf("[AutoSA] Explore 2D systolic array.\n");
-    }
-    isl_size n_sa_dim = 0;
-    struct autosa_kernel **sa_dim_list = sa_space_time_transform_at_dim(
-        schedule, scop, 2, &n_sa_dim);
-    if (scop->options->autosa->verbose)
+    /* Move the space loops to the front, starting from the last one.
+     * The loops in front of a space loop have been shifted by the space
+     * loops moved before it. */
+    for (int m = dim - 1; m >= 0; m--)
     {
-      printf("[AutoSA] %d candidates generated.\n", n_sa_dim);
+      for (int d = cand->space_loops[m] + dim - 1 - m; d > 0; d--)
+      {
+        isl_schedule_node *band = get_outermost_permutable_node(new_schedule);
+        isl_schedule_free(new_schedule);
+        new_schedule = loop_interchange_at_node(band, d, d - 1);
+      }
     }
-    sa_list = (struct autosa_kernel **)realloc(sa_list,
-                                               (n_sa + n_sa_dim) * sizeof(struct autosa_kernel *));
-    for (int i = 0; i < n_sa_dim; i++)
+  }
+  else
+  {
+    /* Move the space loops to the back, starting from the first one. */
+    for (int m = 0; m < dim; m++)
     {
-      sa_list[n_sa + i] = sa_dim_list[i];
-      sa_list[n_sa + i]->space_time_id = n_sa + i;
+      for (int d = cand->space_loops[m] - m; d < band_w - 1; d++)
+      {
+        isl_schedule_node *band = get_innermost_permutable_node(new_schedule);
+        isl_schedule_free(new_schedule);
+        new_schedule = loop_interchange_at_node(band, d, d + 1);
+      }
     }
-    free(sa_dim_list);
-    n_sa += n_sa_dim;
   }
-  /* Explore 3D systolic array */
-  if (scop->options->autosa->max_sa_dim >= 3 && band_w >= 3)
+
+  /* Update the hyperplane types. */
+  struct autosa_kernel *sa = autosa_kernel_from_schedule(new_schedule);
+  sa->scop = scop;
+  sa->type = cand->type;
+
+  /* Update the array dimension. */
+  sa->n_sa_dim = dim;
+  sa->array_part_w = 0;
+  sa->space_w = dim;
+  // TODO: incorrect, to fix.
+  sa->time_w = band_w - dim;
+  sa->space_time_id = cand->space_time_id;
+
+  return sa;
+}
+
+/* Apply space-time transformation to generate different systolic array
+ * candidates. The candidates are expanded into kernels on demand
+ * by sa_candidate_expand, so that only few of them are kept in memory
+ * at the same time.
+ */
+struct autosa_sa_candidate *sa_space_time_transform(
+    __isl_keep isl_schedule *schedule, struct ppcg_scop *scop, isl_size *num_sa)
+{
+  struct autosa_sa_candidate *sa_list = NULL;
+  isl_size n_sa = 0;
+
+  isl_schedule_node *band = get_outermost_permutable_node(schedule);
+  isl_size band_w = isl_schedule_node_band_n_member(band);
+  for (int dim = 1; dim <= 3; dim++)
   {
+    isl_size n_sa_dim = 0;
+    struct autosa_sa_candidate *sa_dim_list;
+
+    if (scop->options->autosa->max_sa_dim < dim || band_w < dim)
+      break;
     if (scop->options->autosa->verbose)
     {
-      printf("[AutoSA] Explore 3D systolic array.\n");
+      printf("[AutoSA] Explore %dD systolic array.\n", dim);
     }
-    isl_size n_sa_dim = 0;
-    struct autosa_kernel **sa_dim_list = sa_space_time_transform_at_dim(
-        schedule, scop, 3, &n_sa_dim);
+    sa_dim_list = sa_space_time_transform_at_dim(schedule, scop, dim, &n_sa_dim);
     if (scop->options->autosa->verbose)
     {
       printf("[AutoSA] %d candidates generated.\n", n_sa_dim);
     }
-    sa_list = (struct autosa_kernel **)realloc(sa_list,
-                                               (n_sa + n_sa_dim) * sizeof(struct autosa_kernel *));
+    sa_list = (struct autosa_sa_candidate *)realloc(sa_list,
+                                                    (n_sa + n_sa_dim) * sizeof(struct autosa_sa_candidate));
     for (int i = 0; i < n_sa_dim; i++)
     {
       sa_list[n_sa + i] = sa_dim_list[i];
-      sa_list[n_sa + i]->space_time_id = n_sa + i;
+      sa_list[n_sa + i].space_time_id = n_sa + i;
     }
     free(sa_dim_list);
     n_sa += n_sa_dim;
   }
 
-  isl_schedule_free(schedule);
   isl_schedule_node_free(band);
   *num_sa = n_sa;
   return sa_list;
@@ -670,14 +739,6 @@ isl_stat sa_space_time_loop_setup(struct autosa_kernel *sa)
   return isl_stat_ok;
 }
 
-/* Internal struct used for sa_candidates_smart_pick. */
-struct sa_candidates_smart_pick_update_data
-{
-  int score;
-  struct autosa_kernel *sa;
-  enum autosa_dep_type dep_type;
-};
-
 /* Internal struct used for not_carrried_at_space. */
 struct dep_space_test_internal_data
 {
@@ -743,107 +804,442 @@ static isl_bool not_carried_at_space(__isl_keep isl_schedule_node *node, void *u
   return isl_bool_true;
 }
 
-/* Update the score for the array. 
- * Specifically, add one credit if RAR is carried by space loops or 
- * RAW is carried by time loops.
+/* Is the dependence with the distances "dis" at the base band of
+ * the candidate "cand" carried by the space loops of the candidate?
+ * The space loops of the candidate are the loops cand->space_loops of
+ * the base band, where the skewed loop, if any, has the distance of
+ * the loop plus cand->skew_factor times the distance of the skewing loop.
  */
-static isl_bool sa_candidates_smart_pick_update(__isl_keep isl_map *map, void *user)
+static int sa_candidate_dep_carried_at_space(struct autosa_sa_candidate *cand,
+                                             int *dis)
 {
-  isl_basic_map_list *bmap_list = isl_map_get_basic_map_list(map);
-  struct sa_candidates_smart_pick_update_data *data =
-      (struct sa_candidates_smart_pick_update_data *)user;
-  struct autosa_kernel *sa = data->sa;
-  isl_schedule_node *node = isl_schedule_get_root(sa->schedule);
-
-  for (int i = 0; i < isl_map_n_basic_map(map); i++)
+  for (int i = 0; i < cand->n_sa_dim; i++)
   {
-    isl_basic_map *dep = isl_basic_map_list_get_basic_map(bmap_list, i);
-    struct dep_space_test_internal_data internal_data = {NULL, dep};
-    int is_carried_at_space = !isl_schedule_node_every_descendant(node,
-                                                                  not_carried_at_space, &internal_data);
-    if (is_carried_at_space && data->dep_type == AUTOSA_DEP_RAR)
-      data->score += 1;
-    else if (!is_carried_at_space && data->dep_type == AUTOSA_DEP_RAW)
-      data->score += 1;
-
-    isl_vec_free(internal_data.dirvec);
-    isl_basic_map_free(dep);
+    int h = cand->space_loops[i];
+    int d = dis[h];
+    if (h == cand->skew_loop)
+      d += cand->skew_factor * dis[cand->skew_src];
+    if (d > 0)
+      return 1;
   }
+
+  return 0;
+}
+
+/* Internal struct used for sa_candidate_estimate_throughput. */
+struct sa_candidate_throughput_data
+{
+  struct autosa_kernel *sa;
+  /* Number of band members */
+  int n;
+  /* Upper bounds of the band members */
+  int *ubs;
+  /* Number of PEs along each space loop, 0 for time loops */
+  int *pe_dims;
+  /* Tiling factor of the time loops used for estimating on-chip reuse */
+  int tile;
+  long n_pe;
+  /* Off-chip traffic in bytes per cycle */
+  double bytes;
+};
+
+/* Return the element size of the array "name" in bytes. */
+int sa_candidate_array_ele_size(struct autosa_kernel *sa, const char *name)
+{
+  struct pet_scop *pet = sa->scop->pet;
+
+  for (int i = 0; i < pet->n_array; i++)
+  {
+    const char *array_name = isl_set_get_tuple_name(pet->arrays[i]->extent);
+    if (array_name && !strcmp(array_name, name))
+      return pet->arrays[i]->element_size;
+  }
+
+  return 4;
+}
+
+/* Update the off-chip traffic of the array access "map", which maps the
+ * band members to the array elements.
+ * Each PE consumes (or produces) one element per cycle. The element is 
+ * reused across the PEs along the space loops that the access doesn't 
+ * depend on, and is reused on-chip across the tiles of the time loops 
+ * that the access doesn't depend on.
+ */
+static isl_stat sa_candidate_access_update(__isl_take isl_map *map, void *user)
+{
+  struct sa_candidate_throughput_data *data =
+      (struct sa_candidate_throughput_data *)user;
+  const char *name = isl_map_get_tuple_name(map, isl_dim_out);
+  double reuse = 1;
+
+  for (int i = 0; i < data->n; i++)
+  {
+    if (isl_map_involves_dims(map, isl_dim_in, i, 1))
+      continue;
+    if (data->pe_dims[i] > 0)
+      reuse *= data->pe_dims[i];
+    else
+      reuse *= min(data->ubs[i], data->tile);
+  }
+  if (name)
+    data->bytes += (double)data->n_pe / reuse *
+                   sa_candidate_array_ele_size(data->sa, name);
+  isl_map_free(map);
+
+  return isl_stat_ok;
+}
+
+/* Read the DSPs, the off-chip bandwidth (in GB/s) and the frequency (in MHz)
+ * from "hw_info" into "dsp", "bw" and "freq", and the resource per PE of
+ * the widest data type of "scop" into "op". If not provided, we use
+ * the default values of Xilinx Alveo U250.
+ */
+static void sa_candidate_hw_info(struct ppcg_scop *scop, cJSON *hw_info,
+                                 double *dsp, double *bw, double *freq, struct autosa_resource *op)
+{
+  cJSON *item;
+
+  *dsp = 6840;
+  *bw = 77;
+  *freq = 300;
+  if (hw_info)
+  {
+    item = cJSON_GetObjectItemCaseSensitive(hw_info, "DSP");
+    if (cJSON_IsNumber(item))
+      *dsp = item->valuedouble;
+    item = cJSON_GetObjectItemCaseSensitive(hw_info, "DRAM_BW");
+    if (cJSON_IsNumber(item))
+      *bw = item->valuedouble;
+    item = cJSON_GetObjectItemCaseSensitive(hw_info, "FREQ");
+    if (cJSON_IsNumber(item))
+      *freq = item->valuedouble;
+  }
+
+  extract_op_resource("char", op);
+  for (int i = 0; i < scop->pet->n_array; i++)
+  {
+    struct autosa_resource array_op;
+    extract_op_resource(scop->pet->arrays[i]->element_type, &array_op);
+    if (array_op.dsp > op->dsp)
+      *op = array_op;
+  }
+}
+
+/* Compute the off-chip traffic (in bytes per cycle) of the PEs described
+ * by "data" from the accesses of the band "node".
+ */
+static void sa_candidate_band_traffic(struct sa_candidate_throughput_data *data,
+                                      __isl_keep isl_schedule_node *node)
+{
+  isl_union_map *sched, *access;
+
+  sched = isl_schedule_node_band_get_partial_schedule_union_map(node);
+  sched = isl_union_map_intersect_domain(sched, isl_schedule_node_get_domain(node));
+  sched = isl_union_map_reverse(sched);
+  access = isl_union_map_union(isl_union_map_copy(data->sa->scop->reads),
+                               isl_union_map_copy(data->sa->scop->may_writes));
+  access = isl_union_map_apply_range(sched, access);
+  data->bytes = 0;
+  isl_union_map_foreach_map(access, &sa_candidate_access_update, data);
+  isl_union_map_free(access);
+}
+
+/* Estimate the throughput (in GOPs) of the systolic array candidate "sa".
+ * The number of PEs is bounded by the DSPs available under the resource 
+ * utilization target, and is split evenly among the space loops, limited 
+ * by the loop bounds. Each PE performs one operation per cycle.
+ * The achievable ops/cycle are further bounded by the off-chip bandwidth 
+ * required to feed the PEs.
+ * The achievable frequency is derated with the DSP utilization, as larger
+ * arrays are harder to route.
+ * The hardware information is read from "hw_info", see sa_candidate_hw_info.
+ */
+static double sa_candidate_estimate_throughput(struct autosa_kernel *sa,
+                                               cJSON *hw_info)
+{
+  struct sa_candidate_throughput_data data;
+  struct autosa_resource op;
+  isl_schedule_node *node;
+  double dsp, bw, freq;
+  double util, ops, max_pe;
+  int target = sa->scop->options->autosa->resource_target;
+  int pe_per_dim;
+
+  sa_candidate_hw_info(sa->scop, hw_info, &dsp, &bw, &freq, &op);
+  max_pe = dsp * target / 100 / op.dsp;
+  pe_per_dim = (int)floor(pow(max_pe, 1.0 / sa->n_sa_dim));
+  if (pe_per_dim < 1)
+    pe_per_dim = 1;
+
+  if (sa->type == AUTOSA_SA_TYPE_SYNC)
+    node = get_innermost_permutable_node(sa->schedule);
+  else
+    node = get_outermost_permutable_node(sa->schedule);
+  data.sa = sa;
+  data.n = isl_schedule_node_band_n_member(node);
+  data.ubs = extract_band_upper_bounds(sa, node);
+  if (!data.ubs)
+  {
+    isl_schedule_node_free(node);
+    return 0;
+  }
+  data.pe_dims = (int *)malloc(data.n * sizeof(int));
+  data.tile = sa->scop->options->autosa->sa_tile_size;
+  data.n_pe = 1;
+  for (int i = 0; i < data.n; i++)
+  {
+    data.pe_dims[i] = 0;
+    if (isl_schedule_node_band_member_get_space_time(node, i) == autosa_loop_space)
+    {
+      data.pe_dims[i] = min(data.ubs[i], pe_per_dim);
+      data.n_pe *= data.pe_dims[i];
+    }
+  }
+
+  /* Compute the off-chip traffic */
+  sa_candidate_band_traffic(&data, node);
   isl_schedule_node_free(node);
-  isl_basic_map_list_free(bmap_list);
-  return isl_bool_true;
+
+  /* Bound the ops/cycle by the off-chip bandwidth */
+  ops = data.n_pe;
+  if (data.bytes > 0 && data.bytes > bw * 1000 / freq)
+    ops *= bw * 1000 / freq / data.bytes;
+  util = data.n_pe * op.dsp / dsp;
+  freq *= (1 - 0.25 * min(util, 1.0));
+
+  if (sa->scop->options->autosa->verbose)
+    printf("[AutoSA] Candidate %d: %ld PEs, %.2f bytes/cycle, %.2f GOPs\n",
+           sa->space_time_id, data.n_pe, data.bytes, ops * freq / 1000);
+
+  free(data.ubs);
+  free(data.pe_dims);
+
+  return ops * freq / 1000;
+}
+
+/* Compute an upper bound of the throughput (in GOPs) estimated by
+ * sa_candidate_estimate_throughput for the systolic array candidate "cand"
+ * from the candidate alone, i.e., without expanding it into a kernel.
+ * "sa" is a kernel with the original schedule "sa->schedule" and "ubs"
+ * contains the upper bounds of the members of its base band "node",
+ * from which the candidates of the same type are derived.
+ *
+ * The space loops of the candidate are members of the base band, such that
+ * the number of PEs along each of them follows from their upper bounds.
+ * The loop skewed by the candidate, if any, spans at most its own range plus
+ * the skewing factor times the range of the skewing loop. Skewing can only
+ * add the skewing loop to the loops that an access depends on, so that the
+ * reuse of the operands across the PEs and the tiles of the time loops,
+ * and hence the per-PE operand bandwidth, is bounded by that at
+ * the base band.
+ * Since the operations per cycle are capped by both the number of PEs and
+ * the off-chip bandwidth, the frequency derating is only applied to
+ * the compute bound, where the derated throughput grows with
+ * the number of PEs.
+ */
+static double sa_candidate_throughput_bound(struct autosa_kernel *sa,
+                                            __isl_keep isl_schedule_node *node, int *ubs,
+                                            struct autosa_sa_candidate *cand, cJSON *hw_info)
+{
+  struct sa_candidate_throughput_data data;
+  struct autosa_resource op;
+  double dsp, bw, freq;
+  double compute, ops, max_pe;
+  int target = sa->scop->options->autosa->resource_target;
+  int pe_per_dim;
+
+  sa_candidate_hw_info(sa->scop, hw_info, &dsp, &bw, &freq, &op);
+  max_pe = dsp * target / 100 / op.dsp;
+  pe_per_dim = (int)floor(pow(max_pe, 1.0 / cand->n_sa_dim));
+  if (pe_per_dim < 1)
+    pe_per_dim = 1;
+
+  data.sa = sa;
+  data.n = cand->band_w;
+  data.ubs = (int *)malloc(data.n * sizeof(int));
+  data.pe_dims = (int *)malloc(data.n * sizeof(int));
+  data.tile = sa->scop->options->autosa->sa_tile_size;
+  data.n_pe = 1;
+  for (int i = 0; i < data.n; i++)
+  {
+    data.ubs[i] = ubs[i];
+    data.pe_dims[i] = 0;
+  }
+  if (cand->skew_factor != 0)
+    data.ubs[cand->skew_loop] += abs(cand->skew_factor) *
+                                 max(ubs[cand->skew_src] - 1, 0);
+  for (int i = 0; i < cand->n_sa_dim; i++)
+  {
+    int h = cand->space_loops[i];
+    data.pe_dims[h] = min(data.ubs[h], pe_per_dim);
+    data.n_pe *= data.pe_dims[h];
+  }
+  sa_candidate_band_traffic(&data, node);
+
+  compute = data.n_pe * (1 - 0.25 * min(data.n_pe * op.dsp / dsp, 1.0));
+  ops = compute;
+  if (data.bytes > 0)
+    ops = min(compute, bw * 1000 / freq * data.n_pe / data.bytes);
+
+  free(data.ubs);
+  free(data.pe_dims);
+
+  return ops * freq / 1000;
 }
 
-/* Select one systolic array design based on heuristics. 
- * Heuristic:
+/* Compute the dependence score of the systolic array candidate "cand",
+ * given the dependence distances "table" at its base band.
  * We favor designs with the following features:
  * - RAR carried by space loops. 
  * - RAW carried by time loops. 
- * We compute a score for each design and select the one with the highest score.
  * The score is computed as :
  * score = 1 * (RAR carried by space || RAW carried by time loop)
  * Namely, for each dependnece, if it is a RAR carried by space or a RAW carried by 
  * time loops, it will contriute one credit to the total score.
- * Besides, between 1D and 2D systolic arrays, we prefer 2D systolic arrays for now.
+ * Besides, we prefer the higher-dimensional arrays, which reuse the data
+ * along more space loops, with one more credit for each array dimension
+ * beyond the first one.
+ * The distances at the space loops of the candidate are looked up in
+ * "table" instead of being recomputed on the expanded schedule.
+ */
+static int sa_candidate_dep_score(struct autosa_sa_candidate *cand,
+                                  struct autosa_dep_dis_table *table)
+{
+  int score = 0;
+
+  for (int n = 0; n < table->n_tagged_rar; n++)
+    if (sa_candidate_dep_carried_at_space(cand,
+                                          table->tagged_rar_dis + n * table->band_w))
+      score += 1;
+  for (int n = 0; n < table->n_tagged_flow; n++)
+    if (!sa_candidate_dep_carried_at_space(cand,
+                                           table->tagged_flow_dis + n * table->band_w))
+      score += 1;
+  /* Add one more credit for each array dimension beyond the first one. */
+  score += cand->n_sa_dim - 1;
+
+  return score;
+}
+
+/* Select one systolic array design based on the cost model.
+ * We estimate the throughput of each design, subject to the off-chip 
+ * bandwidth and resource limits, and select the design with the highest
+ * throughput. Designs with the same throughput are ranked by the 
+ * dependence score computed by sa_candidate_dep_score, and then by
+ * their order in "sa_list".
+ * The candidates are visited in the decreasing order of the upper bounds of
+ * their throughput computed by sa_candidate_throughput_bound, which don't
+ * require expanding them. Once the bound of a candidate is below
+ * the throughput of the incumbent, neither this candidate nor the remaining
+ * ones can be selected, and they are rejected without being expanded.
  */
 struct autosa_kernel *sa_candidates_smart_pick(
-    struct autosa_kernel **sa_list, __isl_keep isl_size num_sa)
+    __isl_keep isl_schedule *schedule, struct ppcg_scop *scop,
+    struct autosa_sa_candidate *sa_list, __isl_keep isl_size num_sa)
 {
   assert(num_sa > 0);
   int max_score = -1;
-  struct autosa_kernel *sa_opt;
+  double max_throughput = -1;
+  struct autosa_kernel *sa_opt, *base;
   int opt_id;
-  isl_union_map *dep_rar, *dep_flow;
-
+  int n_rejected = 0;
+  cJSON *hw_info = NULL;
+  char *hw_info_file = scop->options->autosa->hw_info;
+  isl_schedule_node *base_band[2] = {NULL, NULL};
+  int *base_ubs[2] = {NULL, NULL};
+  std::vector<double> bounds(num_sa);
+  std::vector<std::pair<double, int> > order(num_sa);
+
+  if (hw_info_file)
+    hw_info = load_tuning_config(hw_info_file);
+
+  base = autosa_kernel_from_schedule(isl_schedule_copy(schedule));
+  base->scop = scop;
   for (int i = 0; i < num_sa; i++)
   {
-    struct autosa_kernel *sa = sa_list[i];
-    struct sa_candidates_smart_pick_update_data data;
-    data.score = 0;
-    data.sa = sa;
+    int type = sa_list[i].type;
+
+    if (!base_band[type])
+    {
+      base_band[type] = type == AUTOSA_SA_TYPE_ASYNC ?
+                            get_outermost_permutable_node(base->schedule) :
+                            get_innermost_permutable_node(base->schedule);
+      base_ubs[type] = extract_band_upper_bounds(base, base_band[type]);
+    }
+    bounds[i] = HUGE_VAL;
+    if (base_ubs[type])
+      bounds[i] = sa_candidate_throughput_bound(base, base_band[type],
+                                                base_ubs[type], &sa_list[i], hw_info);
+    order[i] = std::make_pair(-bounds[i], i);
+  }
+  std::sort(order.begin(), order.end());
+
+  for (int k = 0; k < num_sa; k++)
+  {
+    int i = order[k].second;
+    struct autosa_kernel *sa;
+    isl_schedule_node *band;
+    double throughput;
+    int score;
+
+    if (bounds[i] < max_throughput * (1 - 1e-6))
+    {
+      n_rejected = num_sa - k;
+      break;
+    }
+    sa = sa_candidate_expand(schedule, scop, &sa_list[i]);
     /* Initialize the autosa_loop_types. */
     sa_loop_init(sa);
     /* Set up the space_time properties. */
     sa_space_time_loop_setup(sa);
 
-    dep_rar = sa->scop->tagged_dep_rar;
-    dep_flow = sa->scop->tagged_dep_flow;
-
-    data.dep_type = AUTOSA_DEP_RAR;
-    isl_union_map_every_map(dep_rar, &sa_candidates_smart_pick_update, &data);
-    data.dep_type = AUTOSA_DEP_RAW;
-    isl_union_map_every_map(dep_flow, &sa_candidates_smart_pick_update, &data);
-    /* Add one more credit for 2D arrays. */
-    if (sa->n_sa_dim == 2)
-      data.score += 1;
-    if (data.score > max_score)
+    throughput = sa_candidate_estimate_throughput(sa, hw_info);
+    band = sa_list[i].type == AUTOSA_SA_TYPE_ASYNC ?
+               get_outermost_permutable_node(schedule) :
+               get_innermost_permutable_node(schedule);
+    score = sa_candidate_dep_score(&sa_list[i],
+                                   sa_band_dep_dis_table(band, scop, sa_list[i].type));
+    isl_schedule_node_free(band);
+    if (throughput > max_throughput * (1 + 1e-6) ||
+        (throughput >= max_throughput * (1 - 1e-6) &&
+         (score > max_score || (score == max_score && i < opt_id))))
     {
       opt_id = i;
-      max_score = data.score;
+      max_throughput = throughput;
+      max_score = score;
     }
-    //#ifdef _DEBUG
-    //    DBGVAR(std::cout, i);
-    //    DBGVAR(std::cout, data.score);
-    //#endif
+    autosa_kernel_free(sa);
+  }
+  for (int type = 0; type < 2; type++)
+  {
+    isl_schedule_node_free(base_band[type]);
+    free(base_ubs[type]);
   }
+  autosa_kernel_free(base);
+  cJSON_Delete(hw_info);
+  if (n_rejected > 0)
+    printf("[AutoSA] %d candidates rejected by the throughput bound.\n",
+           n_rejected);
+  printf("[AutoSA] Candidate %d is selected with the estimated throughput of %.2f GOPs.\n",
+         opt_id, max_throughput);
 
   //DBGVAR(std::cout, opt_id);
-  sa_opt = autosa_kernel_copy(sa_list[opt_id]);
-  for (int i = 0; i < num_sa; i++)
-    autosa_kernel_free(sa_list[i]);
+  sa_opt = sa_candidate_expand(schedule, scop, &sa_list[opt_id]);
+  sa_loop_init(sa_opt);
+  sa_space_time_loop_setup(sa_opt);
   free(sa_list);
 
   return sa_opt;
 }
 
 /* Return the selected systolic array design and free the rest. */
-struct autosa_kernel *sa_candidates_manual_pick(struct autosa_kernel **sa_list,
-                                                isl_size num_sa, int sa_id)
+struct autosa_kernel *sa_candidates_manual_pick(
+    __isl_keep isl_schedule *schedule, struct ppcg_scop *scop,
+    struct autosa_sa_candidate *sa_list, isl_size num_sa, int sa_id)
 {
-  struct autosa_kernel *sa_opt = autosa_kernel_copy(sa_list[sa_id]);
+  struct autosa_kernel *sa_opt = sa_candidate_expand(schedule, scop,
+                                                     &sa_list[sa_id]);
 
-  for (int i = 0; i < num_sa; i++)
-    autosa_kernel_free(sa_list[i]);
   free(sa_list);
 
   return sa_opt;
@@ -855,7 +1251,7 @@ struct autosa_kernel *sa_candidates_manual_pick(struct autosa_kernel **sa_list,
  * Initialize the "array" field of each local array to point 
  * to the corresponding array in "prog".
  */
-static struct autosa_kernel *autosa_kernel_create_local_arrays(
+struct autosa_kernel *autosa_kernel_create_local_arrays(
     struct autosa_kernel *kernel, struct autosa_prog *prog)
 {
   int i;
@@ -878,6 +1274,7 @@ static struct autosa_kernel *autosa_kernel_create_local_arrays(
     /* Initialize the fields. */
     kernel->array[i].n_io_group_refs = 0;
     kernel->array[i].n_mem_ports = 0;
+    kernel->array[i].shared_in_port = -1;
   }
 
   return kernel;
@@ -957,93 +1354,1564 @@ isl_stat data_transfer_update(__isl_keep isl_basic_map *dep, struct data_transfe
     access->io_info[access->n_io_info - 1]->old_dir = isl_vec_dup(internal_data.dirvec);
   }
 
-  isl_schedule_node_free(node);
-  data->is_update = isl_bool_true;
+  isl_schedule_node_free(node);
+  data->is_update = isl_bool_true;
+
+  return isl_stat_ok;
+}
+
+/* Examine each dependence as basic maps in the "map".
+ */
+static isl_bool data_transfer_update_wrap(__isl_keep isl_map *map, void *user)
+{
+  isl_basic_map_list *bmap_list = isl_map_get_basic_map_list(map);
+  for (int i = 0; i < isl_map_n_basic_map(map); i++)
+  {
+    isl_basic_map *dep = isl_basic_map_list_get_basic_map(bmap_list, i);
+    struct data_transfer_opt_data *opt_data = (struct data_transfer_opt_data *)user;
+    data_transfer_update(dep, opt_data);
+    isl_basic_map_free(dep);
+  }
+  isl_basic_map_list_free(bmap_list);
+  return isl_bool_true;
+}
+
+/* This function extracts the communication pairs from the kernel.
+ * Each access is paired with the dependence it is associated with.
+ * We consider three types of deps: RAR, RAW, WAW.
+ * For each comm pair <access, dep>, we update two properties:
+ * - I/O type: exterior I/O or interior I/O.
+ * - I/O direction: the dependence vector on the space loops.
+ */
+static isl_stat sa_io_update(struct autosa_kernel *sa)
+{
+  struct autosa_local_array_info *local_array;
+  /* Initialize the IO info */
+  for (int i = 0; i < sa->n_array; i++)
+  {
+    local_array = &sa->array[i];
+    for (int j = 0; j < sa->array[i].array->n_ref; j++)
+    {
+      struct autosa_stmt_access *access = sa->array[i].array->refs[j];
+      access->n_io_info = 0;
+      access->io_info = NULL;
+    }
+    local_array->n_lane = 0;
+    local_array->array->n_lane = 0;
+  }
+
+  /* Update the IO information */
+  for (int i = 0; i < sa->n_array; i++)
+  {
+    local_array = &sa->array[i];
+    for (int j = 0; j < local_array->array->n_ref; j++)
+    {
+      struct autosa_stmt_access *access = local_array->array->refs[j];
+      isl_union_map *dep_rar = sa->scop->tagged_dep_rar;
+      isl_union_map *dep_flow = sa->scop->tagged_dep_flow;
+      isl_union_map *dep_waw = ppcg_scop_get_tagged_dep_waw(
+          sa->scop, local_array->array->name);
+      struct data_transfer_opt_data opt_data =
+          {access, sa, AUTOSA_DEP_UNKNOWN, isl_bool_false};
+
+      opt_data.dep_type = AUTOSA_DEP_RAR;
+      isl_union_map_every_map(dep_rar, &data_transfer_update_wrap, &opt_data);
+      if (opt_data.is_update == isl_bool_true)
+      {
+        local_array->array_type = AUTOSA_EXT_ARRAY;
+        opt_data.is_update = isl_bool_false;
+      }
+
+      opt_data.dep_type = AUTOSA_DEP_RAW;
+      isl_union_map_every_map(dep_flow, &data_transfer_update_wrap, &opt_data);
+      if (opt_data.is_update == isl_bool_true)
+      {
+        local_array->array_type = AUTOSA_INT_ARRAY;
+        opt_data.is_update = isl_bool_false;
+      }
+
+      opt_data.dep_type = AUTOSA_DEP_WAW;
+      isl_union_map_every_map(dep_waw, &data_transfer_update_wrap, &opt_data);
+    }
+  }
+
+  return isl_stat_ok;
+}
+
+/* Replace the statement instances under "node" by "domain" in the schedule
+ * containing "node", keeping the other statement instances.
+ * If "domain" is a subset of the instances under "node", the domain of the
+ * schedule is intersected in place. Otherwise, the schedule tree is rebuilt
+ * on the new domain.
+ * Return the pointer to the same node in the updated schedule, or NULL
+ * if the schedule tree can't be rebuilt.
+ */
+static __isl_give isl_schedule_node *sa_node_reset_domain(
+    __isl_keep isl_schedule_node *node, __isl_take isl_union_set *domain)
+{
+  int depth;
+  int *pos;
+  isl_bool subset;
+  isl_union_set *node_domain;
+  isl_schedule_node *root;
+  isl_schedule *schedule, *new_schedule;
+
+  node_domain = isl_schedule_node_get_domain(node);
+  subset = isl_union_set_is_subset(domain, node_domain);
+
+  depth = isl_schedule_node_get_tree_depth(node);
+  pos = (int *)malloc(depth * sizeof(int));
+  root = isl_schedule_node_copy(node);
+  for (int i = depth - 1; i >= 0; i--)
+  {
+    pos[i] = isl_schedule_node_get_child_position(root);
+    root = isl_schedule_node_parent(root);
+  }
+  domain = isl_union_set_union(domain,
+                               isl_union_set_subtract(isl_schedule_node_domain_get_domain(root), node_domain));
+
+  if (subset == isl_bool_true)
+  {
+    root = isl_schedule_node_domain_intersect_domain(root, domain);
+  }
+  else
+  {
+    schedule = isl_schedule_node_get_schedule(root);
+    isl_schedule_node_free(root);
+    new_schedule = autosa_schedule_reset_domain(schedule, domain);
+    isl_schedule_free(schedule);
+    if (!new_schedule)
+    {
+      free(pos);
+      return NULL;
+    }
+    root = isl_schedule_get_root(new_schedule);
+    isl_schedule_free(new_schedule);
+  }
+
+  for (int i = 0; i < depth; i++)
+    root = isl_schedule_node_child(root, pos[i]);
+  free(pos);
+
+  return root;
+}
+
+/* Pad the iteration domain so that the tile sizes "tile_size" of the array
+ * partitioning band "node" divide the loop bounds, i.e., the last array
+ * partition along each loop is a full tile, and all the hardware modules
+ * follow the same schedule in every array partition.
+ * The padded statement instances are masked in the PEs by guarding the
+ * statements with their original domains (see create_domain_leaf_module).
+ * The I/O modules only transfer the array elements inside the array bounds
+ * (see group_tile), so that the arrays are not padded in the external memory.
+ * The domain is only padded if the statement instances under the band form
+ * a box in the band coordinates starting from zero.
+ * Return the pointer to the same band in the updated schedule.
+ */
+static __isl_give isl_schedule_node *sa_array_part_pad_domain(
+    struct autosa_kernel *sa, __isl_take isl_schedule_node *node,
+    int *tile_size)
+{
+  int n, pad = 0;
+  int *ubs;
+  isl_space *space;
+  isl_set *box, *padded;
+  isl_union_map *sched;
+  isl_union_set *band_domain, *box_domain, *domain;
+  isl_schedule_node *new_node;
+  isl_bool equal;
+
+  ubs = extract_band_upper_bounds(sa, node);
+  if (!ubs)
+    return node;
+  n = isl_schedule_node_band_n_member(node);
+  for (int i = 0; i < n; i++)
+  {
+    if (ubs[i] % tile_size[i] != 0)
+      pad = 1;
+  }
+  if (!pad)
+  {
+    free(ubs);
+    return node;
+  }
+
+  space = isl_space_set_alloc(sa->ctx, 0, n);
+  box = isl_set_universe(isl_space_copy(space));
+  padded = isl_set_universe(space);
+  for (int i = 0; i < n; i++)
+  {
+    int padded_ub = (ubs[i] + tile_size[i] - 1) / tile_size[i] * tile_size[i];
+    box = isl_set_lower_bound_si(box, isl_dim_set, i, 0);
+    box = isl_set_upper_bound_si(box, isl_dim_set, i, ubs[i] - 1);
+    padded = isl_set_lower_bound_si(padded, isl_dim_set, i, 0);
+    padded = isl_set_upper_bound_si(padded, isl_dim_set, i, padded_ub - 1);
+  }
+  free(ubs);
+
+  band_domain = isl_schedule_node_get_domain(node);
+  sched = isl_schedule_node_band_get_partial_schedule_union_map(node);
+  sched = isl_union_map_intersect_domain(sched, isl_union_set_universe(band_domain));
+  box_domain = isl_union_map_domain(
+      isl_union_map_intersect_range(isl_union_map_copy(sched), isl_union_set_from_set(box)));
+  band_domain = isl_schedule_node_get_domain(node);
+  equal = isl_union_set_is_equal(box_domain, band_domain);
+  isl_union_set_free(box_domain);
+  isl_union_set_free(band_domain);
+  if (equal != isl_bool_true)
+  {
+    printf("[AutoSA] Warning: The iteration domain is not a box in the array partitioning loops. The tiling factors should be sub-multiples of the loop bounds.\n");
+    isl_union_map_free(sched);
+    isl_set_free(padded);
+    return node;
+  }
+  domain = isl_union_map_domain(
+      isl_union_map_intersect_range(sched, isl_union_set_from_set(padded)));
+
+  new_node = sa_node_reset_domain(node, domain);
+  if (!new_node)
+  {
+    printf("[AutoSA] Warning: The iteration domain can't be padded. The tiling factors should be sub-multiples of the loop bounds.\n");
+    return node;
+  }
+  isl_schedule_node_free(node);
+  sa->padded_domain = 1;
+  printf("[AutoSA] The iteration domain is padded to multiples of the array partitioning tiling factors.\n");
+
+  return new_node;
+}
+
+/* Bound the tile loops of the array partitioning band "node" by the
+ * parameters "n_tile_<i>", so that the number of array partitions executed
+ * by the kernel can be set at runtime while the array and the tile sizes
+ * stay fixed.
+ * As in extract_band_upper_bounds, the tile loops are assumed to start
+ * from zero. The compiled numbers of array partitions are stored in
+ * "sa->runtime_tile_ub" and the tiling factors "tile_size" of the band
+ * in "sa->runtime_tile_size".
+ * The domain of the whole schedule is restricted to the first "n_tile_<i>"
+ * array partitions along each tile loop, so that the parameters appear in
+ * the loop bounds of all the hardware modules and are passed to the kernel
+ * as scalar arguments. The statement instances outside of the band are kept.
+ * Return the pointer to the same band in the updated schedule.
+ */
+static __isl_give isl_schedule_node *sa_array_part_runtime_tiles(
+    struct autosa_kernel *sa, __isl_take isl_schedule_node *node,
+    int *tile_size)
+{
+  int n;
+  int *ubs;
+  isl_space *space;
+  isl_local_space *ls;
+  isl_set *tiles;
+  isl_union_map *umap;
+  isl_union_set *domain;
+  isl_schedule_node *new_node;
+
+  ubs = extract_band_upper_bounds(sa, node);
+  if (!ubs)
+  {
+    printf("[AutoSA] Warning: The number of array partitions is not bounded by a constant. The number of array partitions is fixed.\n");
+    return node;
+  }
+
+  n = isl_schedule_node_band_n_member(node);
+  space = isl_space_set_alloc(sa->ctx, n, n);
+  for (int i = 0; i < n; i++)
+  {
+    std::string name = "n_tile_" + std::to_string(i);
+    space = isl_space_set_dim_id(space, isl_dim_param, i,
+                                 isl_id_alloc(sa->ctx, name.c_str(), NULL));
+  }
+  tiles = isl_set_universe(isl_space_copy(space));
+  ls = isl_local_space_from_space(space);
+  for (int i = 0; i < n; i++)
+  {
+    /* t_i <= n_tile_i - 1 */
+    isl_constraint *c = isl_constraint_alloc_inequality(isl_local_space_copy(ls));
+    c = isl_constraint_set_coefficient_si(c, isl_dim_param, i, 1);
+    c = isl_constraint_set_coefficient_si(c, isl_dim_set, i, -1);
+    c = isl_constraint_set_constant_si(c, -1);
+    tiles = isl_set_add_constraint(tiles, c);
+  }
+  isl_local_space_free(ls);
+
+  umap = isl_schedule_node_band_get_partial_schedule_union_map(node);
+  umap = isl_union_map_intersect_domain(umap, isl_schedule_node_get_domain(node));
+  umap = isl_union_map_intersect_range(umap, isl_union_set_from_set(tiles));
+  domain = isl_union_map_domain(umap);
+
+  /* The restricted domain is intersected in place. */
+  new_node = sa_node_reset_domain(node, domain);
+  isl_schedule_node_free(node);
+  node = new_node;
+
+  printf("[AutoSA] The number of array partitions is set at runtime by the parameters n_tile_0-%d (at most:", n - 1);
+  for (int i = 0; i < n; i++)
+    printf(" %d", ubs[i]);
+  printf(").\n");
+  free(sa->runtime_tile_ub);
+  free(sa->runtime_tile_size);
+  sa->n_runtime_tile = n;
+  sa->runtime_tile_ub = ubs;
+  sa->runtime_tile_size = (int *)malloc(n * sizeof(int));
+  for (int i = 0; i < n; i++)
+    sa->runtime_tile_size[i] = tile_size[i];
+
+  return node;
+}
+
+/* A statement of the multi-device partitioning (see sa_multi_device_partition)
+ * with its instances "domain" under the array partitioning band.
+ * The outermost band member is "x_dim + offset" for the loop iterator
+ * "x_dim" of the statement, or a constant if "dim" is -1.
+ */
+struct sa_multi_device_stmt
+{
+  struct autosa_stmt *stmt;
+  isl_set *domain;
+  int dim;
+  int offset;
+};
+
+/* Return the input dimension "k" if "aff" is of the form "x_k + c" with
+ * an integer constant "c", -1 if "aff" is an integer constant and
+ * -2 otherwise.
+ */
+static int aff_unit_dim(__isl_keep isl_aff *aff)
+{
+  int n, dim = -1;
+  isl_val *v;
+
+  if (isl_aff_dim(aff, isl_dim_div) > 0 ||
+      isl_aff_involves_dims(aff, isl_dim_param, 0,
+                            isl_aff_dim(aff, isl_dim_param)))
+    return -2;
+  v = isl_aff_get_constant_val(aff);
+  if (isl_val_is_int(v) != isl_bool_true)
+    dim = -2;
+  isl_val_free(v);
+  if (dim == -2)
+    return dim;
+
+  n = isl_aff_dim(aff, isl_dim_in);
+  for (int i = 0; i < n && dim != -2; i++)
+  {
+    v = isl_aff_get_coefficient_val(aff, isl_dim_in, i);
+    if (isl_val_is_zero(v) == isl_bool_true)
+      ;
+    else if (isl_val_is_one(v) == isl_bool_true && dim == -1)
+      dim = i;
+    else
+      dim = -2;
+    isl_val_free(v);
+  }
+
+  return dim;
+}
+
+/* Store the affine expression of the single piece of a piecewise expression
+ * in "user", or fail if there are several pieces.
+ */
+static isl_stat extract_single_piece(__isl_take isl_set *set,
+                                     __isl_take isl_aff *aff, void *user)
+{
+  isl_aff **single = (isl_aff **)user;
+
+  isl_set_free(set);
+  if (*single)
+  {
+    isl_aff_free(aff);
+    return isl_stat_error;
+  }
+  *single = aff;
+
+  return isl_stat_ok;
+}
+
+static isl_stat extract_single_multi_piece(__isl_take isl_set *set,
+                                           __isl_take isl_multi_aff *ma, void *user)
+{
+  isl_multi_aff **single = (isl_multi_aff **)user;
+
+  isl_set_free(set);
+  if (*single)
+  {
+    isl_multi_aff_free(ma);
+    return isl_stat_error;
+  }
+  *single = ma;
+
+  return isl_stat_ok;
+}
+
+static isl_stat collect_set(__isl_take isl_set *set, void *user)
+{
+  std::vector<isl_set *> *sets = (std::vector<isl_set *> *)user;
+
+  sets->push_back(set);
+
+  return isl_stat_ok;
+}
+
+/* Collect the statements with instances in "domain", the instances under
+ * the array partitioning band "node", and the loop iterator that the
+ * outermost member of the band follows in each statement.
+ * The bounds of this band member over the statements that are not
+ * constant in the loop are stored in "lo" and "hi".
+ * Return an empty string on success and the reason of the failure otherwise.
+ */
+static std::string multi_device_extract_stmts(struct autosa_prog *prog,
+                                              __isl_keep isl_schedule_node *node, __isl_keep isl_union_set *domain,
+                                              std::vector<struct sa_multi_device_stmt> &stmts, int *lo, int *hi)
+{
+  isl_multi_union_pw_aff *mupa;
+  isl_union_pw_aff *upa;
+  isl_set *range = NULL;
+  std::vector<isl_set *> sets;
+  std::string error;
+
+  mupa = isl_schedule_node_band_get_partial_schedule(node);
+  upa = isl_multi_union_pw_aff_get_union_pw_aff(mupa, 0);
+  isl_multi_union_pw_aff_free(mupa);
+  isl_union_set_foreach_set(domain, &collect_set, &sets);
+
+  for (size_t i = 0; i < sets.size(); i++)
+  {
+    struct sa_multi_device_stmt info;
+    isl_id *id;
+    isl_space *space;
+    isl_pw_aff *pa;
+    isl_aff *aff = NULL;
+
+    id = isl_set_get_tuple_id(sets[i]);
+    info.stmt = find_stmt(prog, id);
+    isl_id_free(id);
+    info.domain = sets[i];
+    info.dim = -2;
+    info.offset = 0;
+    stmts.push_back(info);
+    if (!info.stmt || !error.empty())
+    {
+      if (error.empty())
+        error = "A statement of the kernel can't be found.";
+      continue;
+    }
+
+    space = isl_space_from_domain(isl_set_get_space(info.domain));
+    space = isl_space_add_dims(space, isl_dim_out, 1);
+    pa = isl_union_pw_aff_extract_pw_aff(upa, space);
+    if (isl_pw_aff_foreach_piece(pa, &extract_single_piece, &aff) < 0)
+      aff = isl_aff_free(aff);
+    if (aff)
+      stmts.back().dim = aff_unit_dim(aff);
+    if (stmts.back().dim >= 0)
+    {
+      isl_val *v = isl_aff_get_constant_val(aff);
+      stmts.back().offset = isl_val_get_num_si(v);
+      isl_val_free(v);
+      isl_set *set = isl_set_apply(isl_set_copy(info.domain),
+                                   isl_map_from_pw_aff(isl_pw_aff_copy(pa)));
+      range = range ? isl_set_union(range, set) : set;
+    }
+    else if (stmts.back().dim == -2)
+    {
+      error = std::string("The outermost array partitioning loop is not a loop iterator of the statement ") +
+              isl_id_get_name(info.stmt->id) + ".";
+    }
+    isl_aff_free(aff);
+    isl_pw_aff_free(pa);
+  }
+  isl_union_pw_aff_free(upa);
+
+  if (error.empty() && !range)
+    error = "No statement depends on the outermost array partitioning loop.";
+  if (error.empty())
+  {
+    isl_val *min = isl_set_dim_min_val(isl_set_copy(range), 0);
+    isl_val *max = isl_set_dim_max_val(isl_set_copy(range), 0);
+    if (isl_val_is_int(min) == isl_bool_true && isl_val_is_int(max) == isl_bool_true)
+    {
+      *lo = isl_val_get_num_si(min);
+      *hi = isl_val_get_num_si(max);
+    }
+    else
+    {
+      error = "The outermost array partitioning loop is not bounded by constants.";
+    }
+    isl_val_free(min);
+    isl_val_free(max);
+  }
+  isl_set_free(range);
+
+  return error;
+}
+
+/* Return the instances of "stmt" executed by the device "d" of the
+ * multi-device partitioning, i.e., the instances in the slice
+ * [lo + d * n_iter, lo + (d + 1) * n_iter - 1] of the outermost band member.
+ */
+static __isl_give isl_set *multi_device_stmt_slice(
+    struct sa_multi_device_stmt *stmt, int lo, int n_iter, int d)
+{
+  isl_set *slice;
+  int first = lo - stmt->offset + d * n_iter;
+
+  slice = isl_set_copy(stmt->domain);
+  slice = isl_set_lower_bound_si(slice, isl_dim_set, stmt->dim, first);
+  slice = isl_set_upper_bound_si(slice, isl_dim_set, stmt->dim,
+                                 first + n_iter - 1);
+
+  return slice;
+}
+
+/* Examine if the instances of "stmt" executed by each device are those
+ * executed by the first device, shifted along the loop iterator of the
+ * outermost band member.
+ */
+static isl_bool multi_device_stmt_is_invariant(
+    struct sa_multi_device_stmt *stmt, int lo, int n_iter, int n_device)
+{
+  isl_bool equal = isl_bool_true;
+  isl_set *slice0;
+
+  slice0 = multi_device_stmt_slice(stmt, lo, n_iter, 0);
+  for (int d = 1; d < n_device && equal == isl_bool_true; d++)
+  {
+    isl_multi_aff *shift;
+    isl_aff *aff;
+    isl_set *slice, *shifted;
+
+    shift = isl_multi_aff_identity(isl_space_map_from_set(isl_set_get_space(slice0)));
+    aff = isl_multi_aff_get_aff(shift, stmt->dim);
+    aff = isl_aff_add_constant_si(aff, -d * n_iter);
+    shift = isl_multi_aff_set_aff(shift, stmt->dim, aff);
+    shifted = isl_set_preimage_multi_aff(isl_set_copy(slice0), shift);
+    slice = multi_device_stmt_slice(stmt, lo, n_iter, d);
+    equal = isl_set_is_equal(slice, shifted);
+    isl_set_free(slice);
+    isl_set_free(shifted);
+  }
+  isl_set_free(slice0);
+
+  return equal;
+}
+
+/* Return the array dimension that the access "access" of "stmt" follows
+ * along the loop iterator of the outermost band member, i.e.,
+ * the only index expression in which the iterator appears, with
+ * a unit coefficient. Return -1 if the access doesn't depend on
+ * the iterator and -2 if the access is not of this form.
+ */
+static int multi_device_access_dim(struct sa_multi_device_stmt *stmt,
+                                   struct autosa_stmt_access *access)
+{
+  isl_pw_multi_aff *pma;
+  isl_multi_aff *ma = NULL;
+  int dim = -1;
+  int n;
+
+  if (stmt->dim < 0)
+    return -1;
+  if (isl_map_is_single_valued(access->access) != isl_bool_true)
+    return -2;
+  pma = isl_pw_multi_aff_from_map(isl_map_copy(access->access));
+  if (isl_pw_multi_aff_foreach_piece(pma, &extract_single_multi_piece, &ma) < 0)
+    ma = isl_multi_aff_free(ma);
+  isl_pw_multi_aff_free(pma);
+  if (!ma)
+    return -2;
+
+  n = isl_multi_aff_dim(ma, isl_dim_out);
+  for (int i = 0; i < n && dim != -2; i++)
+  {
+    isl_aff *aff = isl_multi_aff_get_aff(ma, i);
+    isl_val *v = isl_aff_get_coefficient_val(aff, isl_dim_in, stmt->dim);
+    if (isl_aff_dim(aff, isl_dim_div) > 0)
+      dim = -2;
+    else if (isl_val_is_zero(v) == isl_bool_true)
+      ;
+    else if (isl_val_is_one(v) == isl_bool_true && dim == -1)
+      dim = i;
+    else
+      dim = -2;
+    isl_val_free(v);
+    isl_aff_free(aff);
+  }
+  isl_multi_aff_free(ma);
+
+  return dim;
+}
+
+/* Return the index of the array in "prog" accessed by "access", or -1
+ * if it is not found.
+ */
+static int multi_device_access_array(struct autosa_prog *prog,
+                                     struct autosa_stmt_access *access)
+{
+  for (int i = 0; i < prog->n_array; i++)
+  {
+    for (int j = 0; j < prog->array[i].n_ref; j++)
+      if (prog->array[i].refs[j] == access)
+        return i;
+  }
+
+  return -1;
+}
+
+/* Analyze the accesses of the statements "stmts" for the multi-device
+ * partitioning.
+ * The dimension along which each array is partitioned across the devices
+ * is stored in "array_dim" (-1 if the array is copied to all the devices),
+ * and the elements written by the first device in "written".
+ * "sliced" contains the instances executed by the first device.
+ * If "reduce" is set, the outermost band member carries dependences and
+ * the written arrays should only be updated by sums, and set to zero
+ * by the statements that don't depend on the band member.
+ * Return an empty string on success and the reason of the failure otherwise.
+ */
+static std::string multi_device_check_accesses(struct autosa_prog *prog,
+                                               std::vector<struct sa_multi_device_stmt> &stmts,
+                                               __isl_keep isl_union_set *sliced, int reduce,
+                                               std::vector<int> &array_dim, std::vector<isl_set *> &written)
+{
+  for (size_t i = 0; i < stmts.size(); i++)
+  {
+    struct sa_multi_device_stmt *stmt = &stmts[i];
+    struct autosa_stmt_access *access;
+    isl_set *domain;
+    const char *name = isl_id_get_name(stmt->stmt->id);
+    std::string error;
+
+    if (stmt->dim < 0 &&
+        (!reduce || autosa_stmt_is_zero_init(stmt->stmt->stmt) != isl_bool_true))
+      return std::string("The statement ") + name +
+             " doesn't depend on the outermost array partitioning loop.";
+
+    domain = isl_union_set_extract_set(sliced, isl_set_get_space(stmt->domain));
+    for (access = stmt->stmt->accesses; access && error.empty(); access = access->next)
+    {
+      int a = multi_device_access_array(prog, access);
+      int dim = multi_device_access_dim(stmt, access);
+      isl_set *elements;
+
+      if (a < 0 || dim == -2 ||
+          isl_map_range_is_wrapping(access->access) != isl_bool_false)
+      {
+        error = std::string("An access of the statement ") + name +
+                " is not an affine function of the outermost array partitioning loop.";
+        break;
+      }
+      if (array_dim[a] != -2 && array_dim[a] != dim)
+      {
+        error = std::string("The array ") + prog->array[a].name +
+                " is accessed along different dimensions by the outermost array partitioning loop.";
+        break;
+      }
+      array_dim[a] = dim;
+      if (!access->write)
+        continue;
+
+      elements = isl_set_apply(isl_set_copy(domain), isl_map_copy(access->access));
+      written[a] = written[a] ? isl_set_union(written[a], elements) : elements;
+      if (prog->array[a].n_index == 0)
+        error = std::string("The scalar ") + prog->array[a].name +
+                " is written by the kernel.";
+      else if (!reduce && dim < 0)
+        error = std::string("The array ") + prog->array[a].name +
+                " is written by all the devices.";
+      else if (reduce && dim >= 0)
+        error = std::string("The array ") + prog->array[a].name +
+                " is partitioned across the devices, but the outermost array partitioning loop carries dependences.";
+    }
+    isl_set_free(domain);
+    if (!error.empty())
+      return error;
+  }
+
+  /* The arrays reduced across the devices should only be accessed by
+   * the accumulations and the zero initializations. */
+  for (size_t i = 0; reduce && i < stmts.size(); i++)
+  {
+    struct sa_multi_device_stmt *stmt = &stmts[i];
+    struct autosa_stmt_access *access;
+    isl_id *write_ref = NULL, *read_ref = NULL;
+    isl_bool is_sum = isl_bool_false;
+    int ok = 1;
+
+    if (stmt->dim < 0)
+      continue;
+    is_sum = autosa_stmt_is_sum(stmt->stmt->stmt, &write_ref, &read_ref);
+    for (access = stmt->stmt->accesses; access && ok; access = access->next)
+    {
+      int a = multi_device_access_array(prog, access);
+      if (!written[a])
+        continue;
+      ok = is_sum == isl_bool_true &&
+           (access->ref_id == write_ref || access->ref_id == read_ref);
+    }
+    isl_id_free(write_ref);
+    isl_id_free(read_ref);
+    if (!ok)
+      return std::string("The statement ") + isl_id_get_name(stmt->stmt->id) +
+             " is not a sum into the arrays reduced across the devices.";
+  }
+
+  return "";
+}
+
+/* The sliding-window accesses of the convolutions (--AutoSA-conv).
+ * "sliding" contains the names of the arrays read through a sliding window,
+ * e.g., the input feature maps.
+ * "window" maps the name of each statement to the marks of its loop
+ * iterators that are kernel window iterators.
+ */
+struct sa_conv_info
+{
+  std::set<std::string> sliding;
+  std::map<std::string, std::vector<int> > window;
+};
+
+static isl_stat collect_map(__isl_take isl_map *map, void *user)
+{
+  std::vector<isl_map *> *maps = (std::vector<isl_map *> *)user;
+
+  maps->push_back(map);
+
+  return isl_stat_ok;
+}
+
+/* Return the single affine expression of the access "map", or NULL
+ * if it is not single-valued or has several pieces.
+ */
+static __isl_give isl_multi_aff *conv_access_multi_aff(__isl_keep isl_map *map)
+{
+  isl_pw_multi_aff *pma;
+  isl_multi_aff *ma = NULL;
+
+  if (isl_map_is_single_valued(map) != isl_bool_true)
+    return NULL;
+  pma = isl_pw_multi_aff_from_map(isl_map_copy(map));
+  if (isl_pw_multi_aff_foreach_piece(pma, &extract_single_multi_piece, &ma) < 0)
+    ma = isl_multi_aff_free(ma);
+  isl_pw_multi_aff_free(pma);
+
+  return ma;
+}
+
+/* Extract the sliding-window accesses of the scop "scop" into "info".
+ * An index expression of a read is a sliding window if it is the sum of
+ * two loop iterators with positive integer coefficients (and a constant),
+ * one of which has a unit coefficient and doesn't appear in the writes of
+ * the statement, e.g., "r + p" with the output loop "r" and the kernel
+ * window loop "p". The latter is a kernel window iterator of the statement.
+ */
+static void sa_conv_extract(struct ppcg_scop *scop, struct sa_conv_info *info)
+{
+  std::vector<isl_map *> writes, reads;
+  std::map<std::string, std::vector<int> > written;
+
+  isl_union_map_foreach_map(scop->may_writes, &collect_map, &writes);
+  isl_union_map_foreach_map(scop->reads, &collect_map, &reads);
+
+  for (size_t i = 0; i < writes.size(); i++)
+  {
+    const char *stmt = isl_map_get_tuple_name(writes[i], isl_dim_in);
+    int n = isl_map_dim(writes[i], isl_dim_in);
+    std::vector<int> &used = written[stmt ? stmt : ""];
+
+    used.resize(n, 0);
+    for (int j = 0; j < n; j++)
+      if (isl_map_involves_dims(writes[i], isl_dim_in, j, 1) == isl_bool_true)
+        used[j] = 1;
+    isl_map_free(writes[i]);
+  }
+
+  for (size_t i = 0; i < reads.size(); i++)
+  {
+    const char *stmt = isl_map_get_tuple_name(reads[i], isl_dim_in);
+    const char *array = isl_map_get_tuple_name(reads[i], isl_dim_out);
+    int n = isl_map_dim(reads[i], isl_dim_in);
+    isl_multi_aff *ma = conv_access_multi_aff(reads[i]);
+    std::vector<int> &used = written[stmt ? stmt : ""];
+    std::vector<int> &window = info->window[stmt ? stmt : ""];
+
+    used.resize(n, 0);
+    window.resize(n, 0);
+    for (int d = 0; ma && array && d < isl_multi_aff_dim(ma, isl_dim_out); d++)
+    {
+      isl_aff *aff = isl_multi_aff_get_aff(ma, d);
+      std::vector<int> iters;
+      int ok = isl_aff_dim(aff, isl_dim_div) == 0;
+      int win = -1;
+
+      for (int j = 0; j < n && ok; j++)
+      {
+        isl_val *v = isl_aff_get_coefficient_val(aff, isl_dim_in, j);
+        if (isl_val_is_zero(v) != isl_bool_true)
+        {
+          ok = isl_val_is_int(v) == isl_bool_true && isl_val_is_pos(v) == isl_bool_true;
+          iters.push_back(j);
+          if (isl_val_is_one(v) == isl_bool_true && !used[j])
+            win = win == -1 ? j : -2;
+        }
+        isl_val_free(v);
+      }
+      isl_aff_free(aff);
+      if (!ok || iters.size() != 2 || win < 0)
+        continue;
+      window[win] = 1;
+      info->sliding.insert(array);
+    }
+    isl_multi_aff_free(ma);
+    isl_map_free(reads[i]);
+  }
+}
+
+/* Return the marks of the members of the band "node" that are kernel window
+ * loops, given the sliding-window accesses "info".
+ * A band member is a kernel window loop if it follows a kernel window
+ * iterator in all the statements under the band that depend on it.
+ */
+static std::vector<int> sa_conv_band_window_loops(
+    __isl_keep isl_schedule_node *node, struct sa_conv_info *info)
+{
+  isl_multi_union_pw_aff *mupa;
+  isl_union_set *domain;
+  std::vector<isl_set *> sets;
+  int n = isl_schedule_node_band_n_member(node);
+  std::vector<int> window(n, 0);
+
+  mupa = isl_schedule_node_band_get_partial_schedule(node);
+  domain = isl_schedule_node_get_domain(node);
+  isl_union_set_foreach_set(domain, &collect_set, &sets);
+  isl_union_set_free(domain);
+
+  for (int m = 0; m < n; m++)
+  {
+    isl_union_pw_aff *upa = isl_multi_union_pw_aff_get_union_pw_aff(mupa, m);
+    int found = 0, ok = 1;
+
+    for (size_t i = 0; i < sets.size() && ok; i++)
+    {
+      const char *stmt = isl_set_get_tuple_name(sets[i]);
+      std::map<std::string, std::vector<int> >::iterator it;
+      isl_space *space;
+      isl_pw_aff *pa;
+      isl_aff *aff = NULL;
+      int dim = -2;
+
+      space = isl_space_from_domain(isl_set_get_space(sets[i]));
+      space = isl_space_add_dims(space, isl_dim_out, 1);
+      pa = isl_union_pw_aff_extract_pw_aff(upa, space);
+      if (isl_pw_aff_foreach_piece(pa, &extract_single_piece, &aff) < 0)
+        aff = isl_aff_free(aff);
+      if (aff)
+        dim = aff_unit_dim(aff);
+      isl_aff_free(aff);
+      isl_pw_aff_free(pa);
+      if (dim == -1)
+        continue;
+      it = info->window.find(stmt ? stmt : "");
+      if (dim >= 0 && it != info->window.end() &&
+          dim < (int)it->second.size() && it->second[dim])
+        found = 1;
+      else
+        ok = 0;
+    }
+    isl_union_pw_aff_free(upa);
+    window[m] = found && ok;
+  }
+  for (size_t i = 0; i < sets.size(); i++)
+    isl_set_free(sets[i]);
+  isl_multi_union_pw_aff_free(mupa);
+
+  return window;
+}
+
+/* Return the names of the arrays accessed by the sources of the tagged
+ * dependences "deps", in the order of the basic maps of "deps", given
+ * the tagged accesses "accesses".
+ */
+static std::vector<std::string> sa_conv_dep_arrays(
+    __isl_keep isl_union_map *deps, __isl_keep isl_union_map *accesses)
+{
+  std::vector<std::string> arrays;
+  isl_basic_map_list *list = isl_union_map_get_basic_map_list(deps);
+  isl_size n = isl_union_map_n_basic_map(deps);
+
+  for (int i = 0; i < n; i++)
+  {
+    isl_basic_map *dep = isl_basic_map_list_get_basic_map(list, i);
+    isl_space *space = isl_space_domain(isl_basic_map_get_space(dep));
+    isl_union_map *acc;
+    std::vector<isl_map *> maps;
+    const char *name = NULL;
+
+    acc = isl_union_map_intersect_domain(isl_union_map_copy(accesses),
+                                         isl_union_set_from_set(isl_set_universe(space)));
+    isl_union_map_foreach_map(acc, &collect_map, &maps);
+    isl_union_map_free(acc);
+    if (!maps.empty())
+      name = isl_map_get_tuple_name(maps[0], isl_dim_out);
+    arrays.push_back(name ? name : "");
+    for (size_t j = 0; j < maps.size(); j++)
+      isl_map_free(maps[j]);
+    isl_basic_map_free(dep);
+  }
+  isl_basic_map_list_free(list);
+
+  return arrays;
+}
+
+/* Mark the members of the band with the dependence distances "table" that
+ * are group loops of a grouped convolution in "is_group_loop".
+ * A group loop carries no dependence at all, not even a RAR dependence,
+ * e.g., the channel loop of a depthwise convolution, such that the PEs
+ * along a group loop don't share any data.
+ * Return the number of group loops.
+ */
+static int sa_conv_group_loops(struct autosa_dep_dis_table *table,
+                               std::vector<int> &is_group_loop)
+{
+  int n_group = 0;
+
+  is_group_loop.assign(table->band_w, 1);
+  for (int h = 0; h < table->band_w; h++)
+  {
+    for (int n = 0; n < table->n_dep && is_group_loop[h]; n++)
+      if (table->dis[n * table->band_w + h] != 0)
+        is_group_loop[h] = 0;
+    for (int n = 0; n < table->n_tagged_rar && is_group_loop[h]; n++)
+      if (table->tagged_rar_dis[n * table->band_w + h] != 0)
+        is_group_loop[h] = 0;
+    for (int n = 0; n < table->n_tagged_flow && is_group_loop[h]; n++)
+      if (table->tagged_flow_dis[n * table->band_w + h] != 0)
+        is_group_loop[h] = 0;
+    n_group += is_group_loop[h];
+  }
+
+  return n_group;
+}
+
+/* Label the systolic array candidates "sa_list" of the schedule "schedule"
+ * with their dataflow for the convolutions (--AutoSA-conv), and keep only
+ * the candidates with the dataflow --AutoSA-conv-dataflow and the group
+ * mapping --AutoSA-conv-group, if set.
+ * The weights are the arrays that are read, but neither written nor read
+ * through a sliding window. A candidate is weight-stationary if none of
+ * the RAR dependences of the weights is carried by its space loops, i.e.,
+ * the weights stay in the PEs, and output-stationary if none of the flow
+ * dependences of the written arrays is carried by its space loops, i.e.,
+ * the outputs are accumulated in the PEs.
+ * A candidate is grouped if its outermost space loop is a group loop
+ * (see sa_conv_group_loops), i.e., each row of the array computes its own
+ * groups of a grouped or depthwise convolution. With
+ * --AutoSA-conv-group=row, only the grouped candidates are kept, and with
+ * --AutoSA-conv-group=time, only the candidates without any group loop
+ * among their space loops are kept, such that the groups are batched over
+ * the time loops and all the PEs share the data of the same group.
+ * The remaining candidates are renumbered and their number is updated
+ * in "num_sa". If no candidate is left, all the candidates are kept.
+ */
+void sa_conv_filter_candidates(__isl_keep isl_schedule *schedule,
+                               struct ppcg_scop *scop, struct autosa_sa_candidate *sa_list,
+                               isl_size *num_sa)
+{
+  struct sa_conv_info info;
+  std::vector<std::string> rar_arrays, flow_arrays;
+  std::set<std::string> read, written;
+  std::vector<isl_map *> maps;
+  isl_union_map *accesses;
+  const char *dataflow = scop->options->autosa->conv_dataflow;
+  const char *group = scop->options->autosa->conv_group;
+  std::vector<int> kept;
+  int keep = 0, group_keep = 0, n_group = 0, n = 0;
+
+  if (!scop->options->autosa->conv || *num_sa == 0)
+    return;
+  sa_conv_extract(scop, &info);
+  if (info.sliding.empty())
+    printf("[AutoSA] Warning: No sliding-window access found. Only the group loops are mapped.\n");
+  if (dataflow && !strcmp(dataflow, "ws"))
+    keep = 1;
+  else if (dataflow && !strcmp(dataflow, "os"))
+    keep = 2;
+  else if (dataflow)
+    printf("[AutoSA] Warning: Unknown convolution dataflow %s. All the candidates are kept.\n",
+           dataflow);
+  if (info.sliding.empty())
+    keep = 0;
+  if (group && !strcmp(group, "row"))
+    group_keep = 1;
+  else if (group && !strcmp(group, "time"))
+    group_keep = 2;
+  else if (group)
+    printf("[AutoSA] Warning: Unknown convolution group mapping %s. All the candidates are kept.\n",
+           group);
+
+  isl_union_map_foreach_map(scop->may_writes, &collect_map, &maps);
+  for (size_t i = 0; i < maps.size(); i++)
+  {
+    const char *name = isl_map_get_tuple_name(maps[i], isl_dim_out);
+    if (name)
+      written.insert(name);
+    isl_map_free(maps[i]);
+  }
+  maps.clear();
+  isl_union_map_foreach_map(scop->reads, &collect_map, &maps);
+  for (size_t i = 0; i < maps.size(); i++)
+  {
+    const char *name = isl_map_get_tuple_name(maps[i], isl_dim_out);
+    if (name && isl_map_dim(maps[i], isl_dim_out) > 0)
+      read.insert(name);
+    isl_map_free(maps[i]);
+  }
+  accesses = isl_union_map_union(isl_union_map_copy(scop->tagged_reads),
+                                 isl_union_map_copy(scop->tagged_may_writes));
+  rar_arrays = sa_conv_dep_arrays(scop->tagged_dep_rar, accesses);
+  flow_arrays = sa_conv_dep_arrays(scop->tagged_dep_flow, accesses);
+  isl_union_map_free(accesses);
+
+  for (int i = 0; i < *num_sa; i++)
+  {
+    struct autosa_sa_candidate *cand = &sa_list[i];
+    struct autosa_dep_dis_table *table;
+    isl_schedule_node *band;
+    std::vector<int> is_group_loop;
+    int ws = 0, os = 0, grouped = 0;
+    int keep_cand;
+
+    band = cand->type == AUTOSA_SA_TYPE_ASYNC ?
+               get_outermost_permutable_node(schedule) :
+               get_innermost_permutable_node(schedule);
+    table = sa_band_dep_dis_table(band, scop, cand->type);
+    isl_schedule_node_free(band);
+    for (int d = 0; d < table->n_tagged_rar && ws >= 0 && !info.sliding.empty(); d++)
+    {
+      const std::string &array = rar_arrays[d];
+      if (!read.count(array) || written.count(array) || info.sliding.count(array))
+        continue;
+      ws = sa_candidate_dep_carried_at_space(cand,
+                                             table->tagged_rar_dis + d * table->band_w) ? -1 : 1;
+    }
+    for (int d = 0; d < table->n_tagged_flow && os >= 0 && !info.sliding.empty(); d++)
+    {
+      if (!written.count(flow_arrays[d]))
+        continue;
+      os = sa_candidate_dep_carried_at_space(cand,
+                                             table->tagged_flow_dis + d * table->band_w) ? -1 : 1;
+    }
+    if (sa_conv_group_loops(table, is_group_loop) > 0)
+    {
+      n_group++;
+      grouped = is_group_loop[cand->space_loops[0]] ? 1 : -1;
+      for (int j = 1; j < cand->n_sa_dim && grouped < 0; j++)
+        if (is_group_loop[cand->space_loops[j]])
+          grouped = 0;
+    }
+    cand->dataflow = (ws > 0 ? 1 : 0) | (os > 0 ? 2 : 0) | (grouped > 0 ? 4 : 0);
+    if (scop->options->autosa->verbose)
+      printf("[AutoSA] Candidate %d is%s%s%s%s.\n", i,
+             cand->dataflow & 1 ? " weight-stationary" : "",
+             (cand->dataflow & 3) == 3 ? " and" : "",
+             cand->dataflow & 2 ? " output-stationary" :
+             cand->dataflow & 1 ? "" : " neither weight- nor output-stationary",
+             cand->dataflow & 4 ? ", with the groups on the rows" : "");
+    keep_cand = !keep || (cand->dataflow & keep);
+    if (group_keep == 1)
+      keep_cand = keep_cand && grouped > 0;
+    else if (group_keep == 2)
+      keep_cand = keep_cand && grouped < 0;
+    kept.push_back(keep_cand);
+    n += keep_cand;
+  }
+
+  if (group_keep && n_group == 0)
+    printf("[AutoSA] Warning: No group loop found for --AutoSA-conv-group.\n");
+  if ((keep || group_keep) && n == 0)
+  {
+    printf("[AutoSA] Warning: No systolic array with the requested convolution mapping found. All the candidates are kept.\n");
+    return;
+  }
+  if (keep || group_keep)
+  {
+    n = 0;
+    for (int i = 0; i < *num_sa; i++)
+    {
+      if (!kept[i])
+        continue;
+      sa_list[n] = sa_list[i];
+      sa_list[n].space_time_id = n;
+      n++;
+    }
+    printf("[AutoSA] %d systolic arrays kept for the convolution mapping.\n", n);
+    *num_sa = n;
+  }
+}
+
+/* Keep the kernel window loops of the array partitioning band "node"
+ * inside the array partitions (--AutoSA-conv), by setting their tiling
+ * factors "tile_size" to their upper bounds.
+ * The L2 I/O buffers of the arrays read through the sliding windows then
+ * contain the overlapping windows of the whole partition, such that each
+ * element is loaded once per partition, instead of once per position of
+ * the kernel window.
+ */
+static void sa_conv_array_part_tile_sizes(struct autosa_kernel *sa,
+                                          __isl_keep isl_schedule_node *node, int *tile_size)
+{
+  struct sa_conv_info info;
+  std::vector<int> window;
+  int *ubs;
+
+  if (!sa->options->autosa->conv)
+    return;
+  sa_conv_extract(sa->scop, &info);
+  if (info.sliding.empty())
+    return;
+  window = sa_conv_band_window_loops(node, &info);
+  ubs = extract_band_upper_bounds(sa, node);
+  if (!ubs)
+    return;
+  for (size_t i = 0; i < window.size(); i++)
+  {
+    if (!window[i] || tile_size[i] == ubs[i])
+      continue;
+    printf("[AutoSA] The kernel window loop %d is kept inside the array partitions (tiling factor %d to %d).\n",
+           (int)i, tile_size[i], ubs[i]);
+    tile_size[i] = ubs[i];
+  }
+  free(ubs);
+}
+
+/* Distribute the outermost member of the array partitioning band "node"
+ * across the devices of the multi-device host (--AutoSA-multi-device).
+ * The iterations of the band member are split into one slice of
+ * consecutive iterations per device, and each device runs the same kernel
+ * on its slice. The kernel is built for the slice of the first device,
+ * by restricting the statement instances under the band, and the host
+ * shifts the data of the other devices such that they compute their
+ * slices in the same coordinates:
+ * - the arrays accessed along the loop iterator of the band member
+ *   (with a unit coefficient in one index expression) are partitioned
+ *   across the devices along this dimension,
+ * - the other arrays are copied to all the devices.
+ * This requires each statement to be scheduled by one loop iterator
+ * in the band member, and its instances to be invariant under the shift
+ * from one slice to the next.
+ * If the band member is parallel, the written arrays should be partitioned
+ * and the host concatenates the partitions written by the devices.
+ * Otherwise, the written arrays should only be updated by sums (and set to
+ * zero by the statements outside of the band member), and the host adds up
+ * the partial sums of the devices.
+ * If the kernel can't be distributed, it runs on a single device.
+ * Return the pointer to the same band in the updated schedule.
+ */
+static __isl_give isl_schedule_node *sa_multi_device_partition(
+    struct autosa_kernel *sa, __isl_take isl_schedule_node *node)
+{
+  struct autosa_prog *prog = sa->prog;
+  int n_device = sa->options->autosa->multi_device;
+  int reduce, lo = 0, hi = -1, n_iter = 0;
+  isl_union_set *domain, *sliced = NULL;
+  isl_schedule_node *new_node;
+  std::vector<struct sa_multi_device_stmt> stmts;
+  std::vector<int> array_dim(prog->n_array, -2);
+  std::vector<isl_set *> written(prog->n_array, NULL);
+  std::string error;
+
+  if (n_device <= 1)
+    return node;
+  if (sa->options->target != AUTOSA_TARGET_XILINX_HLS_C)
+    error = "Multiple devices are only supported for Xilinx targets.";
+  else if (sa->options->autosa->runtime_tiles)
+    error = "Runtime numbers of array partitions are not supported on multiple devices.";
+
+  reduce = isl_schedule_node_band_member_get_coincident(node, 0) != isl_bool_true;
+  domain = isl_schedule_node_get_domain(node);
+  domain = isl_union_set_intersect_params(domain, isl_set_copy(prog->context));
+  if (error.empty())
+    error = multi_device_extract_stmts(prog, node, domain, stmts, &lo, &hi);
+  isl_union_set_free(domain);
+  if (error.empty() && (hi - lo + 1) % n_device != 0)
+    error = "The " + std::to_string(hi - lo + 1) +
+            " iterations of the outermost array partitioning loop can't be split evenly across the devices.";
+  n_iter = (hi - lo + 1) / n_device;
+
+  /* The instances executed by the first device. */
+  if (error.empty())
+    sliced = isl_union_set_empty(isl_set_get_space(prog->context));
+  for (size_t i = 0; i < stmts.size() && error.empty(); i++)
+  {
+    struct sa_multi_device_stmt *stmt = &stmts[i];
+    isl_set *slice;
+
+    if (stmt->dim < 0)
+    {
+      slice = isl_set_copy(stmt->domain);
+    }
+    else
+    {
+      if (multi_device_stmt_is_invariant(stmt, lo, n_iter, n_device) != isl_bool_true)
+        error = std::string("The instances of the statement ") +
+                isl_id_get_name(stmt->stmt->id) + " differ from one device to the next.";
+      slice = multi_device_stmt_slice(stmt, lo, n_iter, 0);
+    }
+    sliced = isl_union_set_add_set(sliced, slice);
+  }
+  if (error.empty())
+    error = multi_device_check_accesses(prog, stmts, sliced, reduce, array_dim, written);
+
+  /* The partitions written by the devices should not overlap. */
+  for (int i = 0; i < prog->n_array && error.empty(); i++)
+  {
+    struct autosa_local_array_info *local = &sa->array[i];
+    isl_val *min, *max;
+
+    if (!written[i] || array_dim[i] < 0)
+      continue;
+    min = isl_set_dim_min_val(isl_set_copy(written[i]), array_dim[i]);
+    max = isl_set_dim_max_val(isl_set_copy(written[i]), array_dim[i]);
+    if (isl_val_is_int(min) == isl_bool_true && isl_val_is_int(max) == isl_bool_true)
+    {
+      local->device_lo = isl_val_get_num_si(min);
+      local->device_hi = isl_val_get_num_si(max);
+    }
+    if (isl_val_is_int(min) != isl_bool_true || isl_val_is_int(max) != isl_bool_true ||
+        local->device_hi - local->device_lo + 1 > n_iter)
+      error = std::string("The partitions of the array ") + prog->array[i].name +
+              " written by the devices overlap.";
+    isl_val_free(min);
+    isl_val_free(max);
+  }
+
+  if (error.empty())
+  {
+    new_node = sa_node_reset_domain(node, isl_union_set_copy(sliced));
+    if (new_node)
+    {
+      isl_schedule_node_free(node);
+      node = new_node;
+    }
+    else
+    {
+      error = "The iteration domain can't be restricted to the first device.";
+    }
+  }
+
+  if (!error.empty())
+  {
+    printf("[AutoSA] Warning: %s The kernel runs on a single device.\n", error.c_str());
+    sa->options->autosa->multi_device = 1;
+    for (int i = 0; i < prog->n_array; i++)
+      sa->array[i].device_lo = sa->array[i].device_hi = 0;
+  }
+  else
+  {
+    printf("[AutoSA] The outermost array partitioning loop is distributed across %d devices, %d iterations per device.\n",
+           n_device, n_iter);
+  }
+  for (int i = 0; i < prog->n_array && error.empty(); i++)
+  {
+    struct autosa_local_array_info *local = &sa->array[i];
+
+    if (array_dim[i] >= 0)
+    {
+      local->device_dim = array_dim[i];
+      local->device_stride = n_iter;
+      printf("[AutoSA] Array %s is partitioned across the devices along the dimension %d.\n",
+             prog->array[i].name, array_dim[i]);
+    }
+    else if (written[i])
+    {
+      printf("[AutoSA] The partial sums of the array %s are added up across the devices.\n",
+             prog->array[i].name);
+    }
+  }
+
+  for (size_t i = 0; i < stmts.size(); i++)
+    isl_set_free(stmts[i].domain);
+  for (int i = 0; i < prog->n_array; i++)
+    isl_set_free(written[i]);
+  isl_union_set_free(sliced);
+
+  return node;
+}
+
+/* Return the order of the members of the array partitioning band "node"
+ * that keeps the outputs resident on-chip across the reduction
+ * (--AutoSA-output-resident), i.e., the coincident members in their
+ * original order, followed by the members carrying the flow dependences
+ * of the outputs, e.g., the tile loop of the reduction loop "k" of
+ * a matrix multiplication.
+ * The array partitions of the same output tile are then consecutive, such
+ * that the partial sums are accumulated in the PEs and the drain modules
+ * until the last reduction tile, and each output is drained once.
+ * Return NULL if the members are already in this order.
+ */
+static int *sa_array_part_output_resident_order(struct autosa_kernel *sa,
+                                                __isl_keep isl_schedule_node *node)
+{
+  int n = isl_schedule_node_band_n_member(node);
+  int *order;
+  int pos = 0, changed = 0;
+
+  order = isl_alloc_array(sa->ctx, int, n);
+  if (!order)
+    return NULL;
+  for (int i = 0; i < n; i++)
+    if (isl_schedule_node_band_member_get_coincident(node, i) == isl_bool_true)
+      order[pos++] = i;
+  for (int i = 0; i < n; i++)
+    if (isl_schedule_node_band_member_get_coincident(node, i) != isl_bool_true)
+      order[pos++] = i;
+  for (int i = 0; i < n; i++)
+    if (order[i] != i)
+      changed = 1;
+  if (!changed)
+  {
+    free(order);
+    return NULL;
+  }
+
+  return order;
+}
+
+/* Internal data structure for sa_band_access_deps.
+ * "dep" contains, for each array read (0) or written (1) in the band with
+ * "n" members, the band members that any of these accesses depends on.
+ */
+struct sa_band_access_data
+{
+  int n;
+  int write;
+  std::map<std::string, std::vector<bool> > dep[2];
+};
+
+/* Update the band members that the accesses to the array accessed by "map",
+ * which maps the band members to the array elements, depend on.
+ */
+static isl_stat sa_band_access_update(__isl_take isl_map *map, void *user)
+{
+  struct sa_band_access_data *data = (struct sa_band_access_data *)user;
+  const char *name = isl_map_get_tuple_name(map, isl_dim_out);
+
+  if (name)
+  {
+    std::vector<bool> &dep = data->dep[data->write][name];
+    if (dep.empty())
+      dep.assign(data->n, false);
+    for (int i = 0; i < data->n; i++)
+      if (isl_map_involves_dims(map, isl_dim_in, i, 1))
+        dep[i] = true;
+  }
+  isl_map_free(map);
 
   return isl_stat_ok;
 }
 
-/* Examine each dependence as basic maps in the "map".
+/* Collect the band members of the band "node" that the array accesses
+ * of "sa" depend on into "data".
  */
-static isl_bool data_transfer_update_wrap(__isl_keep isl_map *map, void *user)
+static void sa_band_access_deps(struct autosa_kernel *sa,
+                                __isl_keep isl_schedule_node *node, struct sa_band_access_data *data)
 {
-  isl_basic_map_list *bmap_list = isl_map_get_basic_map_list(map);
-  for (int i = 0; i < isl_map_n_basic_map(map); i++)
+  isl_union_map *sched, *access;
+
+  data->n = isl_schedule_node_band_n_member(node);
+  sched = isl_schedule_node_band_get_partial_schedule_union_map(node);
+  sched = isl_union_map_intersect_domain(sched, isl_schedule_node_get_domain(node));
+  sched = isl_union_map_reverse(sched);
+  for (int write = 0; write < 2; write++)
   {
-    isl_basic_map *dep = isl_basic_map_list_get_basic_map(bmap_list, i);
-    struct data_transfer_opt_data *opt_data = (struct data_transfer_opt_data *)user;
-    data_transfer_update(dep, opt_data);
-    isl_basic_map_free(dep);
+    access = isl_union_map_apply_range(isl_union_map_copy(sched),
+                                       isl_union_map_copy(write ? sa->scop->may_writes : sa->scop->reads));
+    data->write = write;
+    isl_union_map_foreach_map(access, &sa_band_access_update, data);
+    isl_union_map_free(access);
   }
-  isl_basic_map_list_free(bmap_list);
-  return isl_bool_true;
+  isl_union_map_free(sched);
 }
 
-/* This function extracts the communication pairs from the kernel.
- * Each access is paired with the dependence it is associated with.
- * We consider three types of deps: RAR, RAW, WAW.
- * For each comm pair <access, dep>, we update two properties:
- * - I/O type: exterior I/O or interior I/O.
- * - I/O direction: the dependence vector on the space loops.
+/* Select the second-level array partitioning factors of the array
+ * partitioning tile band "node" in the auto mode.
+ *
+ * The L2 I/O buffers of an array keep the footprint of the accesses in
+ * a second-level array partition on-chip, which is the footprint in
+ * an array partition (the product of the array partitioning factors of
+ * the loops that the accesses depend on) times the L2 factors of the tile
+ * loops that they depend on. The footprint is then transferred once per
+ * second-level array partition, i.e., it is reused across the tiles of
+ * the tile loops that the accesses don't depend on inside the second-level
+ * array partitions.
+ * Among the power-of-two divisors of the tile counts and the tile counts
+ * themselves, we select the factors that minimize the off-chip traffic,
+ * and then the on-chip memory, such that the L2 buffers fit in the BRAMs,
+ * or the URAMs with "--AutoSA-uram", left after the L1 buffers (one array
+ * partition per array) under the resource utilization target.
+ * The amounts of memory are read from "--AutoSA-hw-info" ("BRAM" and "URAM"),
+ * with the default values of Xilinx Alveo U250.
+ * With "--AutoSA-output-resident", the reduction loops are kept inside
+ * the second-level array partitions.
+ * The projected off-chip traffic is reported against factors of one.
  */
-static isl_stat sa_io_update(struct autosa_kernel *sa)
+static int *sa_array_part_L2_auto_tile_sizes(struct autosa_kernel *sa,
+                                             __isl_keep isl_schedule_node *node)
 {
-  struct autosa_local_array_info *local_array;
-  /* Initialize the IO info */
-  for (int i = 0; i < sa->n_array; i++)
+  struct sa_band_access_data tile_data, part_data;
+  isl_schedule_node *part;
+  cJSON *hw_info = NULL, *item;
+  int tile_len = isl_schedule_node_band_n_member(node);
+  int *ubs, *part_ubs = NULL, *tile_size, *best;
+  int uram = sa->options->autosa->uram;
+  int n_buf = sa->options->autosa->double_buffer ? 2 : 1;
+  double block = uram ? 4096 * 72 : 1024 * 18;
+  double limit = uram ? 1280 : 5376;
+  double l1 = 0, base = -1, best_bytes = -1, best_blocks = -1;
+  std::map<std::string, double> fp[2];
+  std::vector<std::vector<int> > factors(tile_len);
+  std::vector<int> pos(tile_len, 0);
+
+  ubs = extract_band_upper_bounds(sa, node);
+  if (!ubs)
+    return NULL;
+
+  if (sa->options->autosa->hw_info)
+    hw_info = load_tuning_config(sa->options->autosa->hw_info);
+  item = cJSON_GetObjectItemCaseSensitive(hw_info, uram ? "URAM" : "BRAM");
+  if (cJSON_IsNumber(item))
+    limit = item->valuedouble;
+  limit = limit * sa->options->autosa->resource_target / 100;
+  cJSON_Delete(hw_info);
+
+  /* Compute the footprints (in elements) in an array partition from
+   * the point loops under the "array" mark. */
+  sa_band_access_deps(sa, node, &tile_data);
+  part = isl_schedule_node_child(isl_schedule_node_copy(node), 0);
+  if (isl_schedule_node_get_type(part) == isl_schedule_node_mark)
+    part = isl_schedule_node_child(part, 0);
+  if (isl_schedule_node_get_type(part) == isl_schedule_node_band)
   {
-    local_array = &sa->array[i];
-    for (int j = 0; j < sa->array[i].array->n_ref; j++)
+    sa_band_access_deps(sa, part, &part_data);
+    part_ubs = extract_band_upper_bounds(sa, part);
+  }
+  for (int write = 0; write < 2; write++)
+  {
+    for (auto &it : tile_data.dep[write])
     {
-      struct autosa_stmt_access *access = sa->array[i].array->refs[j];
-      access->n_io_info = 0;
-      access->io_info = NULL;
+      double f = 1;
+      std::map<std::string, std::vector<bool> >::iterator dep =
+          part_data.dep[write].find(it.first);
+      if (part_ubs && dep != part_data.dep[write].end())
+        for (int i = 0; i < part_data.n; i++)
+          if (dep->second[i])
+            f *= part_ubs[i];
+      fp[write][it.first] = f;
     }
-    local_array->n_lane = 0;
-    local_array->array->n_lane = 0;
+  }
+  isl_schedule_node_free(part);
+  free(part_ubs);
+  for (auto &it : tile_data.dep[0])
+    l1 += ceil(fp[0][it.first] * sa_candidate_array_ele_size(sa, it.first.c_str()) *
+               8 * n_buf / block);
+  for (auto &it : tile_data.dep[1])
+  {
+    if (tile_data.dep[0].count(it.first) == 0)
+      l1 += ceil(fp[1][it.first] * sa_candidate_array_ele_size(sa, it.first.c_str()) *
+                 8 * n_buf / block);
   }
 
-  /* Update the IO information */
-  for (int i = 0; i < sa->n_array; i++)
+  for (int i = 0; i < tile_len; i++)
   {
-    local_array = &sa->array[i];
-    for (int j = 0; j < local_array->array->n_ref; j++)
+    if (sa->options->autosa->output_resident &&
+        isl_schedule_node_band_member_get_coincident(node, i) != isl_bool_true)
     {
-      struct autosa_stmt_access *access = local_array->array->refs[j];
-      isl_union_map *dep_rar = sa->scop->tagged_dep_rar;
-      isl_union_map *dep_flow = sa->scop->tagged_dep_flow;
-      isl_union_map *dep_waw = sa->scop->tagged_dep_waw;
-      struct data_transfer_opt_data opt_data =
-          {access, sa, AUTOSA_DEP_UNKNOWN, isl_bool_false};
+      factors[i].push_back(ubs[i]);
+      continue;
+    }
+    for (int f = 1; f < ubs[i]; f *= 2)
+      if (ubs[i] % f == 0)
+        factors[i].push_back(f);
+    factors[i].push_back(ubs[i]);
+  }
 
-      opt_data.dep_type = AUTOSA_DEP_RAR;
-      isl_union_map_every_map(dep_rar, &data_transfer_update_wrap, &opt_data);
-      if (opt_data.is_update == isl_bool_true)
-      {
-        local_array->array_type = AUTOSA_EXT_ARRAY;
-        opt_data.is_update = isl_bool_false;
-      }
+  tile_size = isl_alloc_array(sa->ctx, int, tile_len);
+  best = isl_alloc_array(sa->ctx, int, tile_len);
+  while (1)
+  {
+    double bytes = 0, blocks = 0;
+    std::map<std::string, double> buffer;
+    int i;
 
-      opt_data.dep_type = AUTOSA_DEP_RAW;
-      isl_union_map_every_map(dep_flow, &data_transfer_update_wrap, &opt_data);
-      if (opt_data.is_update == isl_bool_true)
+    for (i = 0; i < tile_len; i++)
+      tile_size[i] = factors[i][pos[i]];
+    for (int write = 0; write < 2; write++)
+    {
+      for (auto &it : tile_data.dep[write])
       {
-        local_array->array_type = AUTOSA_INT_ARRAY;
-        opt_data.is_update = isl_bool_false;
+        int ele_size = sa_candidate_array_ele_size(sa, it.first.c_str());
+        double elems = fp[write][it.first], traffic;
+
+        for (int j = 0; j < tile_len; j++)
+          if (it.second[j])
+            elems *= tile_size[j];
+        traffic = elems * ele_size;
+        for (int j = 0; j < tile_len; j++)
+          traffic *= (ubs[j] + tile_size[j] - 1) / tile_size[j];
+        bytes += traffic;
+        buffer[it.first] = max(buffer[it.first], elems * ele_size * 8 * n_buf);
       }
-
-      opt_data.dep_type = AUTOSA_DEP_WAW;
-      isl_union_map_every_map(dep_waw, &data_transfer_update_wrap, &opt_data);
     }
+    for (auto &it : buffer)
+      blocks += ceil(it.second / block);
+    if (base < 0)
+      base = bytes;
+    if (best_bytes < 0 ||
+        (blocks <= limit - l1 &&
+         (best_blocks > limit - l1 || bytes < best_bytes ||
+          (bytes == best_bytes && blocks < best_blocks))))
+    {
+      best_bytes = bytes;
+      best_blocks = blocks;
+      for (int j = 0; j < tile_len; j++)
+        best[j] = tile_size[j];
+    }
+    /* Move to the next combination. */
+    for (i = tile_len - 1; i >= 0; i--)
+    {
+      if (++pos[i] < factors[i].size())
+        break;
+      pos[i] = 0;
+    }
+    if (i < 0)
+      break;
   }
-
-  return isl_stat_ok;
+  free(tile_size);
+  free(ubs);
+
+  printf("[AutoSA] Second-level array partitioning factors selected:");
+  for (int i = 0; i < tile_len; i++)
+    printf(" %d", best[i]);
+  printf(".\n");
+  if (best_blocks > limit - l1)
+    printf("[AutoSA] Warning: The L2 buffers (%.0f %s) exceed the on-chip memory left after the L1 buffers (%.0f %s).\n",
+           best_blocks, uram ? "URAM" : "BRAM18K", max(limit - l1, 0.0),
+           uram ? "URAM" : "BRAM18K");
+  else if (base > 0)
+    printf("[AutoSA] Projected off-chip traffic: %.0f bytes (%.1f%% lower than without second-level reuse), with %.0f %s for the L2 buffers.\n",
+           best_bytes, 100 * (1 - best_bytes / base), best_blocks,
+           uram ? "URAM" : "BRAM18K");
+
+  return best;
 }
 
 /* Apply array partitioning.
  * Apply loop tiling on the band that contains the space loops.
  * In addition, if L2 array partitioning is abled, we will tile the tile loops
  * from the previous array partitioning again to generate two-level tiling.
+ * If "array_part_order" is specified, the tile loops are permuted into
+ * the given order before the L2 array partitioning.
  * TODO: Reorganize the array partitioning loops and place them following the
  * ascending order of the dependence distances. 
  * 
@@ -1057,7 +2925,7 @@ isl_stat sa_array_partitioning_optimize(struct autosa_kernel *sa,
 {
   int tile_len;
   isl_schedule *schedule;
-  int *tile_size;
+  int *tile_size, *order;
   isl_id *id;
 
   /* Fetch the band that contains the space loops. */
@@ -1076,6 +2944,9 @@ isl_stat sa_array_partitioning_optimize(struct autosa_kernel *sa,
             "systolic array type not supported", return isl_stat_error);
   }
 
+  /* Distribute the outermost loop across multiple devices. */
+  node = sa_multi_device_partition(sa, node);
+
   if (!en)
   {
     /* Array partitioning is disabled, we will simply add an "array" mark before
@@ -1121,11 +2992,7 @@ isl_stat sa_array_partitioning_optimize(struct autosa_kernel *sa,
        * we will dump out the number and upper bounds of array_part loops 
        * and exit the program. */
       int *ubs = extract_band_upper_bounds(sa, node);
-      FILE *fp;
-      char *content;
       cJSON *tuning, *array_part_json, *loops_json, *n_sa_dim_json;
-      isl_printer *p_str;
-      char *tuning_path;
 
       tuning = cJSON_CreateObject();
       array_part_json = cJSON_CreateObject();
@@ -1140,17 +3007,9 @@ isl_stat sa_array_partitioning_optimize(struct autosa_kernel *sa,
       /* Add the sa_dim */
       n_sa_dim_json = cJSON_CreateNumber(sa->n_sa_dim);
       cJSON_AddItemToObject(array_part_json, "n_sa_dim", n_sa_dim_json);
-      p_str = isl_printer_to_str(sa->ctx);
-      p_str = isl_printer_print_str(p_str, sa->options->autosa->output_dir);
-      p_str = isl_printer_print_str(p_str, "/tuning.json");
-      tuning_path = isl_printer_get_str(p_str);
-      fp = fopen(tuning_path, "w");
-      content = cJSON_Print(tuning);
-      fprintf(fp, "%s", content);
-      cJSON_Delete(tuning);
-      isl_printer_free(p_str);
-      free(tuning_path);
-      exit(0);
+      free(ubs);
+      isl_schedule_node_free(node);
+      return sa_tuning_info_dump(sa, tuning);
     }
   }
   else
@@ -1166,6 +3025,7 @@ isl_stat sa_array_partitioning_optimize(struct autosa_kernel *sa,
     isl_schedule_node_free(node);
     return isl_stat_error;
   }
+  sa_conv_array_part_tile_sizes(sa, node, tile_size);
 
   /* Update the systolic aray dimensions. */
   if (sa->type == AUTOSA_SA_TYPE_SYNC)
@@ -1202,8 +3062,10 @@ isl_stat sa_array_partitioning_optimize(struct autosa_kernel *sa,
     }
   }
 
+  /* Pad the domain for the partial array partitions. */
+  node = sa_array_part_pad_domain(sa, node, tile_size);
+
   node = autosa_tile_band(node, tile_size);
-  free(tile_size);
 
   /* Add the array marker */
   node = isl_schedule_node_child(node, 0);
@@ -1211,34 +3073,79 @@ isl_stat sa_array_partitioning_optimize(struct autosa_kernel *sa,
   node = isl_schedule_node_insert_mark(node, id);
   node = isl_schedule_node_parent(node);
 
+  /* Set the number of array partitions at runtime. */
+  if (sa->options->autosa->runtime_tiles)
+  {
+    if (sa->options->target == AUTOSA_TARGET_XILINX_HLS_C)
+      node = sa_array_part_runtime_tiles(sa, node, tile_size);
+    else
+      printf("[AutoSA] Warning: Runtime numbers of array partitions are only supported for Xilinx targets.\n");
+  }
+  free(tile_size);
+
+  /* Permute the array partitioning loops.
+   * The order of the tile loops determines which array tiles stay on-chip
+   * across consecutive array partitions, and therefore the off-chip traffic.
+   */
+  order = read_array_part_order(sa, tile_len);
+  if (order && sa->options->autosa->output_resident)
+  {
+    for (int i = 1; i < tile_len; i++)
+      if (isl_schedule_node_band_member_get_coincident(node, order[i - 1]) != isl_bool_true &&
+          isl_schedule_node_band_member_get_coincident(node, order[i]) == isl_bool_true)
+      {
+        printf("[AutoSA] Warning: The order of the array partitioning loops places a reduction loop outside a parallel loop. The outputs are not kept resident on-chip across the reduction.\n");
+        break;
+      }
+  }
+  else if (sa->options->autosa->output_resident)
+  {
+    order = sa_array_part_output_resident_order(sa, node);
+    if (!order)
+      printf("[AutoSA] The reduction loops are already the innermost array partitioning loops.\n");
+  }
+  if (order)
+  {
+    if (isl_schedule_node_band_get_permutable(node) == isl_bool_true)
+    {
+      printf("[AutoSA] Permute the array partitioning loops to the order:");
+      for (int i = 0; i < tile_len; i++)
+        printf(" %d", order[i]);
+      printf(".\n");
+      node = autosa_node_band_permute(node, order);
+    }
+    else
+    {
+      printf("[AutoSA] Warning: The array partitioning band is not permutable. The original order is kept.\n");
+    }
+    free(order);
+  }
+
   /* Examine if there is any flow dep carried in the array_part band. 
-   * For this case, we need to implement a credit-based dependence queue to 
+   * For this case, the I/O modules use a credit-based dependence queue to 
    * force the possible data dependence between two array partitions. 
-   * TODO: implement this feature. 
+   * The credits are exchanged once per array partition, which assumes
+   * that the I/O modules do not prefetch the next array partition.
+   * Double buffering is therefore disabled under credit control.
    */
-  if (!sa->options->autosa->credit_control)
+  for (int i = 0; i < isl_schedule_node_band_n_member(node); i++)
   {
-    for (int i = 0; i < isl_schedule_node_band_n_member(node); i++)
+    if (!isl_schedule_node_band_member_get_coincident(node, i))
     {
-      if (!isl_schedule_node_band_member_get_coincident(node, i))
+      if (!sa->options->autosa->credit_control)
       {
         printf("[AutoSA] Warning: Flow deps carried in the array partitioning band.\n");
         printf("[AutoSA] Warning: Using simple task pipelining could lead to potential data hazards.\n");
         printf("[AutoSA] Warning: The program will proceed as usual. You could consider enabling credit control.\n");
-        break;
       }
+      else if (sa->options->autosa->double_buffer)
+      {
+        printf("[AutoSA] Warning: Double buffering is not supported with credit control. Option --autosa-double-buffer is disabled.\n");
+        sa->options->autosa->double_buffer = 0;
+      }
+      break;
     }
   }
-  else
-  {
-    printf("[AutoSA] Error: Credit control is not supported yet!\n");
-    exit(1);
-    // TODO: modify the schedule to add credit rd/wr for I/O modules
-    // TODO: modify the module decls and fifo decls for credit fifos
-    // TODO: disable double buffering.
-    //    /* Disable double-buffering */
-    //    sa->options->autosa->double_buffer = 0;
-  }
 
   /* If two-level buffering is enabled, we will need to apply a second-level tiling
    * on the tile band from the previous array partitioning. 
@@ -1260,7 +3167,7 @@ isl_stat sa_array_partitioning_optimize(struct autosa_kernel *sa,
       /* Tile the band again */
       printf("[AutoSA] Two-level buffering is set. Apply second-level array partitioning.\n");
       tile_len = isl_schedule_node_band_n_member(node);
-      if (!strcmp(mode, "manual"))
+      if (!strcmp(L2_mode, "manual"))
       {
         tile_size = read_array_part_L2_tile_sizes(sa, tile_len);
         if (!tile_size)
@@ -1268,11 +3175,7 @@ isl_stat sa_array_partitioning_optimize(struct autosa_kernel *sa,
           /* Dump out the number of and upper bounds of array_part loops and exit the program. */
           int *ubs = extract_band_upper_bounds(sa, node);
           int *loop_coincident = (int *)malloc(sizeof(int) * tile_len);
-          FILE *fp;
-          char *content;
           cJSON *tuning, *array_part_json, *loops_json;
-          isl_printer *p_str;
-          char *tuning_path;
 
           for (int i = 0; i < tile_len; i++)
           {
@@ -1296,32 +3199,17 @@ isl_stat sa_array_partitioning_optimize(struct autosa_kernel *sa,
             cJSON *loop = cJSON_CreateNumber(loop_coincident[i]);
             cJSON_AddItemToArray(loops_json, loop);
           }
-          p_str = isl_printer_to_str(sa->ctx);
-          p_str = isl_printer_print_str(p_str, sa->options->autosa->output_dir);
-          p_str = isl_printer_print_str(p_str, "/tuning.json");
-          tuning_path = isl_printer_get_str(p_str);
-          fp = fopen(tuning_path, "w");
-          content = cJSON_Print(tuning);
-          fprintf(fp, "%s", content);
-          cJSON_Delete(tuning);
-          free(tuning_path);
           free(loop_coincident);
-          isl_printer_free(p_str);
           free(ubs);
-          exit(0);
+          isl_schedule_node_free(node);
+          return sa_tuning_info_dump(sa, tuning);
         }
       }
       else
       {
-        /* Perform second-level array partitioning following the default policy. */
-        // tile_size = read_default_array_part_L2_tile_sizes(sa, tile_len);
-        int *ubs = extract_band_upper_bounds(sa, node);
-        tile_size = isl_alloc_array(sa->ctx, int, tile_len);
-        for (int i = 0; i < tile_len; i++)
-        {
-          tile_size[i] = ubs[i];
-        }
-        free(ubs);
+        /* Select the second-level array partitioning factors from
+         * the on-chip memory and the off-chip traffic. */
+        tile_size = sa_array_part_L2_auto_tile_sizes(sa, node);
       }
 
       if (!tile_size)
@@ -1329,6 +3217,23 @@ isl_stat sa_array_partitioning_optimize(struct autosa_kernel *sa,
         isl_schedule_node_free(node);
         return isl_stat_error;
       }
+      /* Keep the reduction loops inside the second-level array partitions,
+       * such that the outputs stay in the L2 drain buffers across the
+       * reduction tiles. */
+      if (sa->options->autosa->output_resident)
+      {
+        int *ubs = extract_band_upper_bounds(sa, node);
+        for (int i = 0; ubs && i < tile_len; i++)
+        {
+          if (isl_schedule_node_band_member_get_coincident(node, i) == isl_bool_true ||
+              tile_size[i] == ubs[i])
+            continue;
+          printf("[AutoSA] The reduction loop %d is kept inside the second-level array partitions (tiling factor %d to %d).\n",
+                 i, tile_size[i], ubs[i]);
+          tile_size[i] = ubs[i];
+        }
+        free(ubs);
+      }
       node = autosa_tile_band(node, tile_size);
       free(tile_size);
 
@@ -1787,11 +3692,7 @@ static __isl_give isl_schedule_node *autosa_latency_tile_loop(
     {
       /* Dump out the number and upper bounds of latency loops and exit the program. */
       int *ubs = data.ubs;
-      FILE *fp;
-      char *content;
       cJSON *tuning, *latency_json, *loops_json;
-      char *tuning_path;
-      isl_printer *p_str;
 
       tuning = cJSON_CreateObject();
       latency_json = cJSON_CreateObject();
@@ -1803,23 +3704,16 @@ static __isl_give isl_schedule_node *autosa_latency_tile_loop(
         cJSON *loop = cJSON_CreateNumber(ubs[i]);
         cJSON_AddItemToArray(loops_json, loop);
       }
-      p_str = isl_printer_to_str(sa->ctx);
-      p_str = isl_printer_print_str(p_str, sa->options->autosa->output_dir);
-      p_str = isl_printer_print_str(p_str, "/tuning.json");
-      tuning_path = isl_printer_get_str(p_str);
-      fp = fopen(tuning_path, "w");
-      content = cJSON_Print(tuning);
-      fprintf(fp, "%s", content);
-      cJSON_Delete(tuning);
-      isl_printer_free(p_str);
-      free(tuning_path);
-      exit(0);
+      free(data.ubs);
+      isl_schedule_node_free(node);
+      sa_tuning_info_dump(sa, tuning);
+      return NULL;
     }
   }
   else
   {
     /* Perform the latency hiding following the default policy. */
-    tile_size = read_default_latency_tile_sizes(sa, tile_len);
+    tile_size = read_default_latency_tile_sizes(sa, tile_len, data.ubs);
   }
 
   free(data.ubs);
@@ -1837,6 +3731,13 @@ static __isl_give isl_schedule_node *autosa_latency_tile_loop(
     if (tile_size[i] != -1)
       sa->lat_hide_len *= tile_size[i];
   }
+  if (!strcmp(mode, "manual"))
+  {
+    int lat = autosa_kernel_update_latency(sa);
+    if (sa->lat_hide_len < lat)
+      printf("[AutoSA] Warning: The latency hiding factor (%d) is smaller than the update latency (%d), the PEs won't achieve II=1.\n",
+             sa->lat_hide_len, lat);
+  }
   for (i = 0; i < tile_len; i++)
   {
     if (tile_size[i] > 1)
@@ -1937,6 +3838,11 @@ isl_stat sa_latency_hiding_optimize(struct autosa_kernel *sa, bool en, char *mod
    * it is tiled and permuted to the innermost of the time loop band. 
    * A latency hiding marker is added. */
   node = autosa_latency_tile_loop(node, sa, mode);
+  if (!node)
+  {
+    sa->schedule = NULL;
+    return isl_stat_error;
+  }
 
   /* Clean up the band pe_opt properties. */
   schedule = isl_schedule_node_get_schedule(node);
@@ -2199,9 +4105,200 @@ static float is_stride_coalesced(__isl_keep isl_schedule_node *node,
   return coalesced ? data.score : -1;
 }
 
+/* Return the pairs of statement instances reaching the band node "node"
+ * that are scheduled at the same iteration of the outer loops and
+ * at different iterations of the band member "pos".
+ */
+static __isl_give isl_union_map *band_member_carried_pairs(
+    __isl_keep isl_schedule_node *node, int pos)
+{
+  isl_union_map *prefix, *same, *sched, *ne;
+  isl_multi_union_pw_aff *mupa;
+
+  prefix = isl_schedule_node_get_prefix_schedule_union_map(node);
+  same = isl_union_map_apply_range(isl_union_map_copy(prefix),
+                                   isl_union_map_reverse(prefix));
+  mupa = isl_schedule_node_band_get_partial_schedule(node);
+  for (int i = 0; i < pos; i++)
+  {
+    sched = isl_union_map_from_union_pw_aff(
+        isl_multi_union_pw_aff_get_union_pw_aff(mupa, i));
+    same = isl_union_map_intersect(same,
+                                   isl_union_map_apply_range(isl_union_map_copy(sched),
+                                                             isl_union_map_reverse(isl_union_map_copy(sched))));
+    isl_union_map_free(sched);
+  }
+  sched = isl_union_map_from_union_pw_aff(
+      isl_multi_union_pw_aff_get_union_pw_aff(mupa, pos));
+  isl_multi_union_pw_aff_free(mupa);
+  ne = isl_union_map_union(
+      isl_union_map_lex_lt_union_map(isl_union_map_copy(sched),
+                                     isl_union_map_copy(sched)),
+      isl_union_map_lex_gt_union_map(isl_union_map_copy(sched),
+                                     isl_union_map_copy(sched)));
+  isl_union_map_free(sched);
+
+  return isl_union_map_intersect(same, ne);
+}
+
+/* Internal struct used in is_reduction_loop. */
+struct reduction_loop_data
+{
+  struct autosa_kernel *kernel;
+  isl_union_map *carried;
+  int n_carried;
+};
+
+/* Examine if the untagged dependence "dep" is carried, i.e., if it relates
+ * any of the pairs of statement instances in "data->carried".
+ */
+static isl_bool dep_is_carried(__isl_take isl_map *dep,
+                               struct reduction_loop_data *data)
+{
+  isl_union_map *umap;
+  isl_bool empty;
+
+  umap = isl_union_map_intersect(isl_union_map_from_map(dep),
+                                 isl_union_map_copy(data->carried));
+  empty = isl_union_map_is_empty(umap);
+  isl_union_map_free(umap);
+
+  return isl_bool_not(empty);
+}
+
+/* Return the statement of the tuple "type" of the dependence space "space",
+ * if it is an associative update, and store the reference ids of its
+ * accumulator in "write_ref" and "read_ref".
+ */
+static struct autosa_stmt *reduction_stmt(struct autosa_kernel *kernel,
+                                          __isl_keep isl_space *space, enum isl_dim_type type,
+                                          isl_id **write_ref, isl_id **read_ref)
+{
+  isl_id *id;
+  struct autosa_stmt *stmt;
+
+  id = isl_space_get_tuple_id(space, type);
+  stmt = find_stmt(kernel->prog, id);
+  isl_id_free(id);
+  if (!stmt ||
+      autosa_stmt_is_reduction(stmt->stmt, write_ref, read_ref) != isl_bool_true)
+    return NULL;
+
+  return stmt;
+}
+
+/* Examine if the tagged dependence "dep" is either not carried,
+ * or carried between the references to the accumulator of the same
+ * associative update.
+ */
+static isl_bool tagged_dep_is_reduction(__isl_keep isl_map *dep, void *user)
+{
+  struct reduction_loop_data *data = (struct reduction_loop_data *)user;
+  isl_space *space, *src, *dst;
+  isl_id *write_ref = NULL, *read_ref = NULL;
+  isl_id *src_ref, *dst_ref, *id;
+  struct autosa_stmt *stmt1, *stmt2;
+  isl_bool carried, is_reduction;
+
+  carried = dep_is_carried(isl_map_factor_domain(isl_map_copy(dep)), data);
+  if (carried != isl_bool_true)
+    return isl_bool_not(carried);
+  data->n_carried++;
+
+  space = isl_map_get_space(dep);
+  src = isl_space_unwrap(isl_space_domain(isl_space_copy(space)));
+  dst = isl_space_unwrap(isl_space_range(space));
+  stmt1 = reduction_stmt(data->kernel, src, isl_dim_in, &write_ref, &read_ref);
+  id = isl_space_get_tuple_id(dst, isl_dim_in);
+  stmt2 = find_stmt(data->kernel->prog, id);
+  isl_id_free(id);
+  src_ref = isl_space_get_tuple_id(src, isl_dim_out);
+  dst_ref = isl_space_get_tuple_id(dst, isl_dim_out);
+  is_reduction = (stmt1 && stmt1 == stmt2 &&
+                  (src_ref == write_ref || src_ref == read_ref) &&
+                  (dst_ref == write_ref || dst_ref == read_ref))
+                     ? isl_bool_true
+                     : isl_bool_false;
+  isl_id_free(src_ref);
+  isl_id_free(dst_ref);
+  isl_id_free(write_ref);
+  isl_id_free(read_ref);
+  isl_space_free(src);
+  isl_space_free(dst);
+
+  return is_reduction;
+}
+
+/* Examine if the untagged dependence "dep" is either not carried,
+ * or carried between the instances of the same associative update.
+ */
+static isl_bool dep_is_reduction(__isl_keep isl_map *dep, void *user)
+{
+  struct reduction_loop_data *data = (struct reduction_loop_data *)user;
+  isl_space *space;
+  isl_id *write_ref = NULL, *read_ref = NULL;
+  struct autosa_stmt *stmt1, *stmt2;
+  isl_bool carried;
+
+  carried = dep_is_carried(isl_map_copy(dep), data);
+  if (carried != isl_bool_true)
+    return isl_bool_not(carried);
+
+  space = isl_map_get_space(dep);
+  stmt1 = reduction_stmt(data->kernel, space, isl_dim_in, &write_ref, &read_ref);
+  isl_id_free(write_ref);
+  isl_id_free(read_ref);
+  write_ref = read_ref = NULL;
+  stmt2 = reduction_stmt(data->kernel, space, isl_dim_out, &write_ref, &read_ref);
+  isl_id_free(write_ref);
+  isl_id_free(read_ref);
+  isl_space_free(space);
+
+  return (stmt1 && stmt1 == stmt2) ? isl_bool_true : isl_bool_false;
+}
+
+/* Examine if the band member "pos" of the band node "node" is a reduction
+ * loop, derived from the dependences of the scop.
+ * The loop is a reduction loop if it carries flow or output dependences,
+ * all of which are self-dependences between the references to the
+ * accumulator of an associative update "acc op= e" or "acc = acc op e",
+ * and if all the false dependences it carries are self-dependences of
+ * such updates.
+ * Such dependences only reflect the order of the updates,
+ * which can be reassociated.
+ */
+static isl_bool is_reduction_loop(__isl_keep isl_schedule_node *node, int pos,
+                                  struct autosa_kernel *kernel)
+{
+  struct ppcg_scop *scop = kernel->scop;
+  struct reduction_loop_data data;
+  isl_bool is_reduction;
+
+  data.kernel = kernel;
+  data.carried = band_member_carried_pairs(node, pos);
+  data.n_carried = 0;
+
+  is_reduction = isl_union_map_every_map(scop->tagged_dep_flow,
+                                         &tagged_dep_is_reduction, &data);
+  if (is_reduction == isl_bool_true)
+    is_reduction = isl_union_map_every_map(
+        ppcg_scop_get_tagged_dep_waw(scop, NULL), &tagged_dep_is_reduction,
+        &data);
+  if (is_reduction == isl_bool_true && scop->dep_false)
+    is_reduction = isl_union_map_every_map(scop->dep_false,
+                                           &dep_is_reduction, &data);
+  isl_union_map_free(data.carried);
+  if (is_reduction < 0)
+    return isl_bool_error;
+
+  return (is_reduction && data.n_carried > 0) ? isl_bool_true : isl_bool_false;
+}
+
 /* A loop is identified to be vectorizable if it is:
  * - a parallel or reduction loop
  * - with stride-0/1 access.
+ * The reduction loops are detected from the dependences, unless the SIMD
+ * information is provided by the user.
  * Only time loops are considered.
  * For each candidate loop, we compute the score:
  * score = 2 * is_loop_parallel + 4 * is_loop_reduction)
@@ -2250,7 +4347,18 @@ static isl_schedule_node *detect_simd_vectorization_loop(
         int layout_transform = 0;
         float score_i;
 
-        if (!isl_schedule_node_band_member_get_coincident(node, i) && !strcmp(data->mode, "manual"))
+        if (!isl_schedule_node_band_member_get_coincident(node, i) &&
+            !sa->options->autosa->simd_info)
+        {
+          /* Detect the reduction loop from the dependences. */
+          is_reduction = is_reduction_loop(node, i, sa) == isl_bool_true;
+          if (is_reduction)
+          {
+            printf("[AutoSA] Band member position: %d\n", i);
+            printf("[AutoSA] Reduction loop detected.\n");
+          }
+        }
+        else if (!isl_schedule_node_band_member_get_coincident(node, i) && !strcmp(data->mode, "manual"))
         {
           /* At present, we can't analyze reduction loop by AutoSA.
            * We will print each node and follow the user guidance.
@@ -2697,11 +4805,7 @@ isl_stat sa_simd_vectorization_optimize(struct autosa_kernel *sa, char *mode)
          * and exit the program. 
          */
         int *ubs = data.ubs;
-        FILE *fp;
-        char *content;
         cJSON *tuning, *simd_json, *loops_json, *scores_json, *legal_json;
-        isl_printer *p_str;
-        char *tuning_path;
 
         tuning = cJSON_CreateObject();
         simd_json = cJSON_CreateObject();
@@ -2734,17 +4838,12 @@ isl_stat sa_simd_vectorization_optimize(struct autosa_kernel *sa, char *mode)
           cJSON *loop = cJSON_CreateNumber(sa->sa_dim[i]);
           cJSON_AddItemToArray(loops_json, loop);
         }
-        p_str = isl_printer_to_str(sa->ctx);
-        p_str = isl_printer_print_str(p_str, sa->options->autosa->output_dir);
-        p_str = isl_printer_print_str(p_str, "/tuning.json");
-        tuning_path = isl_printer_get_str(p_str);
-        fp = fopen(tuning_path, "w");
-        content = cJSON_Print(tuning);
-        fprintf(fp, "%s", content);
-        cJSON_Delete(tuning);
-        free(tuning_path);
-        isl_printer_free(p_str);
-        exit(0);
+        free(data.ubs);
+        free(data.legal);
+        free(data.scores);
+        isl_schedule_node_free(node);
+        sa->schedule = NULL;
+        return sa_tuning_info_dump(sa, tuning);
       }
     }
 
@@ -2801,12 +4900,16 @@ isl_stat sa_pe_optimize(struct autosa_kernel *sa, bool pass_en[], char *pass_mod
   sa->core = isl_union_set_universe(domain);
 
   /* Array partitioning. */
-  sa_array_partitioning_optimize(sa, pass_en[0], pass_mode[0], pass_en[1], pass_mode[1]);
+  if (sa_array_partitioning_optimize(sa, pass_en[0], pass_mode[0],
+                                     pass_en[1], pass_mode[1]) < 0)
+    return isl_stat_error;
   /* Latency hiding. */
-  sa_latency_hiding_optimize(sa, pass_en[2], pass_mode[2]);
+  if (sa_latency_hiding_optimize(sa, pass_en[2], pass_mode[2]) < 0)
+    return isl_stat_error;
   /* SIMD vectorization. */
   if (pass_en[3])
-    sa_simd_vectorization_optimize(sa, pass_mode[3]);
+    if (sa_simd_vectorization_optimize(sa, pass_mode[3]) < 0)
+      return isl_stat_error;
 
   return isl_stat_ok;
 }
@@ -3114,7 +5217,7 @@ static __isl_give isl_schedule_node *compute_and_comm_optimize(
     struct autosa_gen *gen, __isl_take isl_schedule_node *node)
 {
   isl_size num_sa = 0;
-  struct autosa_kernel **sa_candidates;
+  struct autosa_sa_candidate *sa_candidates;
   struct autosa_kernel *sa_opt, *kernel;
   isl_schedule *schedule;
   /* Enable for array partitioning, L2 array partitioning, latency hiding, SIMD. */
@@ -3137,7 +5240,18 @@ static __isl_give isl_schedule_node *compute_and_comm_optimize(
   /* Generate systolic arrays using space-time mapping. */
   schedule = isl_schedule_node_get_schedule(node);
   isl_schedule_node_free(node);
+  /* In the exploration mode, we explore all the tiling factors in-process
+   * and proceed with the best design found. */
+  if (gen->options->autosa->explore)
+  {
+    autosa_profile_begin(gen->profile, "sa_explore", "phase");
+    sa_explore(gen, schedule);
+    autosa_profile_end(gen->profile);
+  }
+  autosa_profile_begin(gen->profile, "sa_space_time_transform", "phase");
   sa_candidates = sa_space_time_transform(schedule, gen->prog->scop, &num_sa);
+  sa_conv_filter_candidates(schedule, gen->prog->scop, sa_candidates, &num_sa);
+  autosa_profile_end(gen->profile);
   if (num_sa > 0)
     printf("[AutoSA] %d systolic arrays generated.\n", num_sa);
   space_time_json = cJSON_GetObjectItemCaseSensitive(gen->tuning_config, "space_time");
@@ -3148,7 +5262,8 @@ static __isl_give isl_schedule_node *compute_and_comm_optimize(
     /* Space-time transformation is set in AUTO mode. We will pick up
      * one systolic array to proceed based on heuristics. 
      */
-    kernel = sa_candidates_smart_pick(sa_candidates, num_sa);
+    kernel = sa_candidates_smart_pick(schedule, gen->prog->scop,
+                                      sa_candidates, num_sa);
   }
   else
   {
@@ -3173,6 +5288,24 @@ static __isl_give isl_schedule_node *compute_and_comm_optimize(
       space_time_json = cJSON_CreateObject();
       n_sa_json = cJSON_CreateNumber(num_sa);
       cJSON_AddItemToObject(space_time_json, "n_kernel", n_sa_json);
+      if (gen->options->autosa->conv)
+      {
+        /* The dataflow of each candidate for the convolutions */
+        cJSON *dataflow_json = cJSON_CreateArray();
+        for (int i = 0; i < num_sa; i++)
+        {
+          int dataflow = sa_candidates[i].dataflow;
+          std::string label;
+          if (dataflow & 1)
+            label += "ws";
+          if (dataflow & 2)
+            label += label.empty() ? "os" : "+os";
+          if (dataflow & 4)
+            label += label.empty() ? "group" : "+group";
+          cJSON_AddItemToArray(dataflow_json, cJSON_CreateString(label.c_str()));
+        }
+        cJSON_AddItemToObject(space_time_json, "dataflow", dataflow_json);
+      }
       cJSON_AddItemToObject(tuning, "space_time", space_time_json);
       p_str = isl_printer_to_str(gen->ctx);
       p_str = isl_printer_print_str(p_str, gen->options->autosa->output_dir);
@@ -3188,9 +5321,11 @@ static __isl_give isl_schedule_node *compute_and_comm_optimize(
     }
     else
     {
-      kernel = sa_candidates_manual_pick(sa_candidates, num_sa, kernel_id);
+      kernel = sa_candidates_manual_pick(schedule, gen->prog->scop,
+                                         sa_candidates, num_sa, kernel_id);
     }
   }
+  isl_schedule_free(schedule);
 
   /* #ifdef _DEBUG
   isl_printer *pd = isl_printer_to_file(kernel->ctx, stdout);
@@ -3233,7 +5368,9 @@ static __isl_give isl_schedule_node *compute_and_comm_optimize(
   pe_opt_mode[2] = latency_mode_json->valuestring;
   pe_opt_mode[3] = simd_mode_json->valuestring;
 
+  autosa_profile_begin(gen->profile, "sa_pe_optimize", "phase");
   sa_pe_optimize(kernel, pe_opt_en, pe_opt_mode);
+  autosa_profile_end(gen->profile);
 
   /* Create the autosa_kernel object and attach to the schedule. */
   if (!kernel)
@@ -3324,7 +5461,9 @@ static __isl_give isl_schedule_node *compute_and_comm_optimize(
   kernel->schedule = isl_schedule_node_get_schedule(node);
 
   /* Communication Management */
+  autosa_profile_begin(gen->profile, "sa_comm_management", "phase");
   sa_comm_management(kernel, gen);
+  autosa_profile_end(gen->profile);
 
   /* Localize the array bounds using parameters from the host domain. */
   localize_bounds(kernel, host_domain);
@@ -3567,6 +5706,7 @@ static void create_kernel_var(isl_ctx *ctx,
   var->array = group->array;
 
   var->type = autosa_array_ref_group_type(group);
+  var->mem_type = -1;
   tile = autosa_array_ref_group_tile(group);
 
   p = isl_printer_to_str(ctx);
@@ -3749,7 +5889,9 @@ __isl_give isl_schedule *sa_map_to_device(struct autosa_gen *gen,
 
   /* Perform compute and comm optimization.
    */
+  autosa_profile_begin(gen->profile, "compute_and_comm_optimize", "phase");
   node = compute_and_comm_optimize(gen, node);
+  autosa_profile_end(gen->profile);
 
   id = isl_schedule_node_mark_get_id(node);
   kernel = (struct autosa_kernel *)isl_id_get_user(id);
@@ -3762,7 +5904,16 @@ __isl_give isl_schedule *sa_map_to_device(struct autosa_gen *gen,
   //  pd = isl_printer_free(pd);
   //#endif
   /* Generate hw modules in the systolic array. */
+  autosa_profile_begin(gen->profile, "generate_hw_modules", "phase");
   generate_hw_modules(schedule, gen, kernel);
+  autosa_profile_end(gen->profile);
+  if (gen->options->target == AUTOSA_TARGET_CUDA)
+  {
+    /* Map the array partitions and the PEs to the CUDA thread blocks
+     * and threads. */
+    if (sa_cuda_kernel_generate_code(gen, kernel) < 0)
+      printf("[AutoSA] Error: Failed to generate the CUDA kernel.\n");
+  }
 
   /* Add copy statements for the default schedule (used for correctness verification). */
   node = sa_add_copies(gen, node);
@@ -3871,10 +6022,22 @@ static __isl_give isl_printer *generate(__isl_take isl_printer *p,
 
   gen->prog = prog;
   /* Scheduling */
+  autosa_profile_begin(gen->profile, "get_schedule", "phase");
   schedule = get_schedule(gen);
+  autosa_profile_end(gen->profile);
+
+  /* Stencil skewing */
+  if (options->autosa->stencil_skew)
+  {
+    autosa_profile_begin(gen->profile, "skew_stencil_schedule", "phase");
+    schedule = skew_stencil_schedule(schedule, scop);
+    autosa_profile_end(gen->profile);
+  }
 
   /* Legality check */
+  autosa_profile_begin(gen->profile, "sa_legality_check", "phase");
   isl_bool is_legal = sa_legality_check(schedule, scop);
+  autosa_profile_end(gen->profile);
   if (is_legal < 0 || !is_legal)
   {
     if (is_legal < 0)
@@ -3888,14 +6051,25 @@ static __isl_give isl_printer *generate(__isl_take isl_printer *p,
     /* Perform opt. stages:
      * Computation Management -> Communication Management     
      */
+    autosa_profile_begin(gen->profile, "sa_map_to_device", "phase");
     gen->schedule = sa_map_to_device(gen, schedule);
+    autosa_profile_end(gen->profile);
 
     /* Generate the AST tree. */
+    autosa_profile_begin(gen->profile, "sa_generate_code", "phase");
     gen->tree = sa_generate_code(gen, gen->schedule);
+    autosa_profile_end(gen->profile);
+    autosa_profile_begin(gen->profile, "sa_module_generate_code", "phase");
+    /* The module ASTs are generated one after the other.
+     * They are built within the single isl_ctx of the program, which is not
+     * thread-safe, and the AST annotations point to the kernel statements
+     * and hardware modules of this process, so the trees can neither be
+     * built in separate isl contexts nor in forked workers.
+     */
     for (int i = 0; i < gen->n_hw_modules; i++)
     {
-      if (gen->hw_modules[i]->is_filter == 1 &&
-          gen->hw_modules[i]->is_buffer == 1)
+      autosa_profile_begin(gen->profile, gen->hw_modules[i]->name, "module");
+      if (autosa_hw_module_is_split(gen->hw_modules[i]))
       {
         sa_filter_buffer_io_module_generate_code(gen, gen->hw_modules[i]);
       }
@@ -3903,13 +6077,29 @@ static __isl_give isl_printer *generate(__isl_take isl_printer *p,
       {
         sa_module_generate_code(gen, gen->hw_modules[i]);
       }
+      autosa_profile_end(gen->profile);
     }
+    autosa_profile_end(gen->profile);
+    autosa_profile_begin(gen->profile, "sa_top_module_generate_code", "phase");
     sa_top_module_generate_code(gen);
     for (int i = 0; i < gen->n_drain_merge_funcs; i++)
     {
       sa_drain_merge_generate_code(gen, gen->drain_merge_funcs[i]);
     }
-
+    autosa_profile_end(gen->profile);
+
+    autosa_profile_begin(gen->profile, "estimation", "phase");
+    cJSON *hw_info = NULL;
+    if (gen->options->autosa->hw_info)
+      hw_info = load_tuning_config(gen->options->autosa->hw_info);
+    /* Bind the local buffers to the memory resources of the board */
+    if (gen->options->autosa->mem_binding)
+    {
+      if (hw_info)
+        sa_bind_memory(gen, hw_info);
+      else
+        printf("[AutoSA] Warning: The memory binding requires the hardware information (--AutoSA-hw-info), it is skipped.\n");
+    }
     /* Extract loop structure for latency estimation */
     for (int i = 0; i < gen->n_hw_modules; i++)
     {
@@ -3919,13 +6109,47 @@ static __isl_give isl_printer *generate(__isl_take isl_printer *p,
     sa_extract_array_info(gen->kernel);
     /* Extract design information for resource estimation */
     sa_extract_design_info(gen);
-
-    /* Code generation */
-    p = ppcg_set_macro_names(p);
-    p = ppcg_print_exposed_declarations(p, prog->scop);
-    p = gen->print(p, gen->prog, gen->tree, gen->hw_modules, gen->n_hw_modules,
-                   gen->hw_top_module, gen->drain_merge_funcs, gen->n_drain_merge_funcs,
-                   &gen->types, gen->print_user);
+    /* Estimate the kernel latency */
+    long latency;
+    cJSON *modules_info = NULL;
+    cJSON *calibration = NULL;
+    if (gen->options->autosa->calibration)
+      calibration = load_tuning_config(gen->options->autosa->calibration);
+    sa_estimate_latency(gen, calibration, &latency, &modules_info);
+    /* Simulate the array to validate the estimated latency */
+    if (gen->options->autosa->simulate)
+      sa_simulate(gen, modules_info, latency);
+    cJSON_Delete(modules_info);
+    /* Estimate the resource usage and check it against the board */
+    struct autosa_resource resource;
+    /* Place the design on the roofline of the board */
+    sa_estimate_roofline(gen, hw_info, latency);
+    /* Report the off-chip traffic of the arrays */
+    sa_estimate_traffic(gen);
+    isl_stat fit = sa_estimate_resource(gen, hw_info, calibration, &resource);
+    /* Replicate the kernel as compute units in the spare resources */
+    if (fit >= 0)
+      sa_select_compute_units(gen, hw_info, &resource);
+    cJSON_Delete(hw_info);
+    cJSON_Delete(calibration);
+    autosa_profile_end(gen->profile);
+
+    if (fit < 0)
+    {
+      printf("[AutoSA] Error: The design exceeds the resource utilization target. Code generation is skipped.\n");
+      p = isl_printer_free(p);
+    }
+    else
+    {
+      /* Code generation */
+      autosa_profile_begin(gen->profile, "print", "phase");
+      p = ppcg_set_macro_names(p);
+      p = ppcg_print_exposed_declarations(p, prog->scop);
+      p = gen->print(p, gen->prog, gen->tree, gen->hw_modules, gen->n_hw_modules,
+                     gen->hw_top_module, gen->drain_merge_funcs, gen->n_drain_merge_funcs,
+                     &gen->types, gen->print_user);
+      autosa_profile_end(gen->profile);
+    }
 
     /* Clean up */
     isl_ast_node_free(gen->tree);
@@ -3991,6 +6215,14 @@ int generate_sa(isl_ctx *ctx, const char *input, FILE *out,
   gen.schedule = NULL;
   gen.kernel = NULL;
   gen.tuning_config = NULL;
+  gen.profile = options->autosa->profile ? autosa_profile_alloc() : NULL;
+
+  if (options->autosa->batch1 && !options->autosa->double_buffer)
+  {
+    /* The drain of each tile overlaps the computation of the next one. */
+    printf("[AutoSA] The batch-1 latency mode overlaps the drain with the computation. Option --autosa-double-buffer is enabled.\n");
+    options->autosa->double_buffer = 1;
+  }
 
   if (options->debug->dump_sizes)
   {
@@ -3998,7 +6230,16 @@ int generate_sa(isl_ctx *ctx, const char *input, FILE *out,
     gen.used_sizes = isl_union_map_empty(space);
   }
 
+  autosa_profile_begin(gen.profile, "total", "phase");
   r = ppcg_transform(ctx, input, out, options, &generate_wrap, &gen);
+  autosa_profile_end(gen.profile);
+  if (gen.profile)
+  {
+    std::string profile_path = std::string(options->autosa->output_dir) +
+                               "/profile.json";
+    autosa_profile_dump(gen.profile, profile_path.c_str());
+    autosa_profile_free(gen.profile);
+  }
 
   if (options->debug->dump_sizes)
   {
@@ -39,21 +39,54 @@ __isl_give isl_schedule *sa_map_to_device(struct autosa_gen *gen,
 isl_bool sa_legality_check(__isl_keep isl_schedule *schedule, struct ppcg_scop *scop);
 
 /* Space-Time transformation */
-struct autosa_kernel **sa_space_time_transform_at_dim_async(
+/* A systolic array candidate generated by the space-time transformation.
+ * "space_loops" contains the "n_sa_dim" space loops picked from the
+ * permutable band with "band_w" loops, which is the outermost band for
+ * async arrays and the innermost band for sync arrays.
+ * If "skew_factor" is not zero, the loop "skew_loop" of the band is first
+ * skewed as skew_loop + skew_factor * skew_src to become a space loop.
+ * "dataflow" is set by sa_conv_filter_candidates, with the bit 0 set
+ * for weight-stationary arrays, the bit 1 for output-stationary arrays and
+ * the bit 2 for the arrays with the convolution groups on the rows.
+ */
+struct autosa_sa_candidate
+{
+    int type;
+    int n_sa_dim;
+    int space_loops[3];
+    int band_w;
+    int space_time_id;
+    int skew_loop;
+    int skew_src;
+    int skew_factor;
+    int dataflow;
+};
+
+struct autosa_sa_candidate *sa_space_time_transform_at_dim_async(
     __isl_keep isl_schedule *schedule, struct ppcg_scop *scop,
     isl_size dim, isl_size *num_sa);
-struct autosa_kernel **sa_space_time_transform_at_dim_sync(
+struct autosa_sa_candidate *sa_space_time_transform_at_dim_sync(
     __isl_keep isl_schedule *schedule, struct ppcg_scop *scop,
     isl_size dim, isl_size *num_sa);
-struct autosa_kernel **sa_space_time_transform_at_dim(
+struct autosa_sa_candidate *sa_space_time_transform_at_dim(
     __isl_keep isl_schedule *schedule, struct ppcg_scop *scop,
     isl_size dim, isl_size *num_sa);
+struct autosa_kernel *sa_candidate_expand(__isl_keep isl_schedule *schedule,
+                                          struct ppcg_scop *scop, struct autosa_sa_candidate *cand);
+int sa_candidate_array_ele_size(struct autosa_kernel *sa, const char *name);
 struct autosa_kernel *sa_candidates_smart_pick(
-    struct autosa_kernel **sa_list, __isl_keep isl_size num_sa);
+    __isl_keep isl_schedule *schedule, struct ppcg_scop *scop,
+    struct autosa_sa_candidate *sa_list, __isl_keep isl_size num_sa);
 struct autosa_kernel *sa_candidates_manual_pick(
-    struct autosa_kernel **sa_list, isl_size num_sa, int sa_id);
-struct autosa_kernel **sa_space_time_transform(
-    __isl_take isl_schedule *schedule, struct ppcg_scop *scop, isl_size *num_sa);
+    __isl_keep isl_schedule *schedule, struct ppcg_scop *scop,
+    struct autosa_sa_candidate *sa_list, isl_size num_sa, int sa_id);
+struct autosa_sa_candidate *sa_space_time_transform(
+    __isl_keep isl_schedule *schedule, struct ppcg_scop *scop, isl_size *num_sa);
+void sa_conv_filter_candidates(__isl_keep isl_schedule *schedule,
+                               struct ppcg_scop *scop, struct autosa_sa_candidate *sa_list,
+                               isl_size *num_sa);
+struct autosa_kernel *autosa_kernel_create_local_arrays(
+    struct autosa_kernel *kernel, struct autosa_prog *prog);
 
 /* PE Optimization */
 isl_stat sa_array_partitioning_optimize(
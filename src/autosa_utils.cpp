@@ -290,6 +290,25 @@ int suffixcmp(const char *s, const char *suffix)
     return strncmp(s + start, suffix, strlen(suffix));
 }
 
+/* Append the content of the file "path" to "out".
+ * Return -1 if "path" can't be read.
+ */
+int append_file(FILE *out, const char *path)
+{
+  FILE *in;
+  char buffer[4096];
+  size_t n;
+
+  in = fopen(path, "r");
+  if (!in)
+    return -1;
+  while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+    fwrite(buffer, 1, n, out);
+  fclose(in);
+
+  return 0;
+}
+
 /* Add "len" parameters p[i] with identifiers "ids" and intersect "set"
  * with
  *
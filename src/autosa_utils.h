@@ -31,6 +31,7 @@ int isl_vec_cmp(__isl_keep isl_vec *vec1, __isl_keep isl_vec *vec2);
 char *concat(isl_ctx *ctx, const char *a, const char *b);
 bool isl_vec_is_zero(__isl_keep isl_vec *vec);
 int suffixcmp(const char *s, const char *suffix);
+int append_file(FILE *out, const char *path);
 
 __isl_give isl_set *add_bounded_parameters_dynamic(
     __isl_take isl_set *set, __isl_keep isl_multi_pw_aff *size,
@@ -1,3 +1,11 @@
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
 #include <isl/ctx.h>
 
 #include "autosa_xilinx_hls_c.h"
@@ -6,6 +14,8 @@
 #include "autosa_trans.h"
 #include "autosa_codegen.h"
 #include "autosa_utils.h"
+#include "autosa_top_gen.h"
+#include "autosa_sim.h"
 
 struct print_host_user_data
 {
@@ -25,6 +35,7 @@ struct print_hw_module_data
  */
 static void print_xilinx_host_header(FILE *fp)
 {
+  fprintf(fp, "#include <algorithm>\n");
   fprintf(fp, "#include <iostream>\n");
   fprintf(fp, "#include <vector>\n");
   fprintf(fp, "#include <fstream>\n\n");
@@ -106,8 +117,797 @@ static void print_xilinx_host_header(FILE *fp)
   fprintf(fp, "}\n\n");
 }
 
+/* Print the includes for the native XRT host.
+ * The host buffers are allocated as in the OpenCL host, and copied to and
+ * from the buffer objects in device memory.
+ */
+static void print_xrt_host_header(FILE *fp)
+{
+  fprintf(fp, "#include <algorithm>\n");
+  fprintf(fp, "#include <chrono>\n");
+  fprintf(fp, "#include <iostream>\n");
+  fprintf(fp, "#include <vector>\n\n");
+
+  fprintf(fp, "#include <xrt/xrt_bo.h>\n");
+  fprintf(fp, "#include <xrt/xrt_device.h>\n");
+  fprintf(fp, "#include <xrt/xrt_kernel.h>\n\n");
+
+  fprintf(fp, "template <typename T>\n");
+  fprintf(fp, "struct aligned_allocator\n");
+  fprintf(fp, "{\n");
+  fprintf(fp, "  using value_type = T;\n");
+  fprintf(fp, "  T* allocate(std::size_t num)\n");
+  fprintf(fp, "  {\n");
+  fprintf(fp, "    void* ptr = nullptr;\n");
+  fprintf(fp, "    if (posix_memalign(&ptr,4096,num*sizeof(T)))\n");
+  fprintf(fp, "      throw std::bad_alloc();\n");
+  fprintf(fp, "    return reinterpret_cast<T*>(ptr);\n");
+  fprintf(fp, "  }\n");
+  fprintf(fp, "  void deallocate(T* p, std::size_t num)\n");
+  fprintf(fp, "  {\n");
+  fprintf(fp, "    free(p);\n");
+  fprintf(fp, "  }\n");
+  fprintf(fp, "};\n\n");
+}
+
+/* Print the functions computing the statistics of the benchmark mode
+ * of the OpenCL host.
+ * The commands are timed by the OpenCL profiling events, and the
+ * percentiles are taken by the nearest-rank method.
+ */
+static void print_host_bench_header_xilinx(FILE *fp)
+{
+  fprintf(fp, "double autosa_event_time(cl::Event &event)\n");
+  fprintf(fp, "{\n");
+  fprintf(fp, "    cl_ulong start = event.getProfilingInfo<CL_PROFILING_COMMAND_START>();\n");
+  fprintf(fp, "    cl_ulong end = event.getProfilingInfo<CL_PROFILING_COMMAND_END>();\n");
+  fprintf(fp, "    return (end - start) * 1e-9;\n");
+  fprintf(fp, "}\n\n");
+
+  fprintf(fp, "double autosa_percentile(std::vector<double> t, int pct)\n");
+  fprintf(fp, "{\n");
+  fprintf(fp, "    std::sort(t.begin(), t.end());\n");
+  fprintf(fp, "    size_t rank = (t.size() * pct + 99) / 100;\n");
+  fprintf(fp, "    return t[rank > 0 ? rank - 1 : 0];\n");
+  fprintf(fp, "}\n\n");
+
+  fprintf(fp, "void autosa_bench_print(const char *name, std::vector<double> &t)\n");
+  fprintf(fp, "{\n");
+  fprintf(fp, "    if (t.empty())\n");
+  fprintf(fp, "        return;\n");
+  fprintf(fp, "    std::cout << name << \" Time: median \" << autosa_percentile(t, 50)\n");
+  fprintf(fp, "              << \" s, p99 \" << autosa_percentile(t, 99)\n");
+  fprintf(fp, "              << \" s, min \" << *std::min_element(t.begin(), t.end()) << \" s\" << std::endl;\n");
+  fprintf(fp, "}\n\n");
+}
+
+/* Print the multithreaded copy of the host preparation with "n_thread"
+ * threads.
+ * The threads are bound to the CPUs of the NUMA node of the device, given
+ * by the environment variable AUTOSA_NUMA_NODE (all the CPUs if unset),
+ * and so is the main thread before the host buffers are allocated, such
+ * that the buffers are first touched, and hence placed, on that node.
+ * Each thread copies a contiguous chunk, which std::copy vectorizes for
+ * the trivially copyable element types.
+ */
+static void print_host_threads_header_xilinx(FILE *fp, int n_thread)
+{
+  fprintf(fp, "#include <cstdlib>\n");
+  fprintf(fp, "#include <fstream>\n");
+  fprintf(fp, "#include <sched.h>\n");
+  fprintf(fp, "#include <thread>\n\n");
+
+  fprintf(fp, "#define AUTOSA_HOST_THREADS %d\n", n_thread);
+  fprintf(fp, "/* Number of elements below which the copies are not split */\n");
+  fprintf(fp, "#define AUTOSA_HOST_COPY_MIN 65536\n\n");
+
+  fprintf(fp, "cpu_set_t autosa_numa_cpus()\n");
+  fprintf(fp, "{\n");
+  fprintf(fp, "  cpu_set_t set;\n");
+  fprintf(fp, "  CPU_ZERO(&set);\n");
+  fprintf(fp, "  const char *node = getenv(\"AUTOSA_NUMA_NODE\");\n");
+  fprintf(fp, "  if (node) {\n");
+  fprintf(fp, "    std::ifstream list(std::string(\"/sys/devices/system/node/node\") + node + \"/cpulist\");\n");
+  fprintf(fp, "    std::string range;\n");
+  fprintf(fp, "    while (std::getline(list, range, ',')) {\n");
+  fprintf(fp, "      int lo, hi;\n");
+  fprintf(fp, "      int n = sscanf(range.c_str(), \"%%d-%%d\", &lo, &hi);\n");
+  fprintf(fp, "      if (n < 1)\n");
+  fprintf(fp, "        continue;\n");
+  fprintf(fp, "      if (n == 1)\n");
+  fprintf(fp, "        hi = lo;\n");
+  fprintf(fp, "      for (int c = lo; c <= hi; c++)\n");
+  fprintf(fp, "        CPU_SET(c, &set);\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "  }\n");
+  fprintf(fp, "  if (CPU_COUNT(&set) == 0)\n");
+  fprintf(fp, "    sched_getaffinity(0, sizeof(set), &set);\n");
+  fprintf(fp, "  return set;\n");
+  fprintf(fp, "}\n\n");
+
+  fprintf(fp, "void autosa_numa_bind()\n");
+  fprintf(fp, "{\n");
+  fprintf(fp, "  static const cpu_set_t set = autosa_numa_cpus();\n");
+  fprintf(fp, "  sched_setaffinity(0, sizeof(set), &set);\n");
+  fprintf(fp, "}\n\n");
+
+  fprintf(fp, "template <typename InputIt, typename OutputIt>\n");
+  fprintf(fp, "void autosa_parallel_copy(InputIt first, InputIt last, OutputIt d_first)\n");
+  fprintf(fp, "{\n");
+  fprintf(fp, "  long n = last - first;\n");
+  fprintf(fp, "  if (n < AUTOSA_HOST_COPY_MIN) {\n");
+  fprintf(fp, "    std::copy(first, last, d_first);\n");
+  fprintf(fp, "    return;\n");
+  fprintf(fp, "  }\n");
+  fprintf(fp, "  long chunk = (n + AUTOSA_HOST_THREADS - 1) / AUTOSA_HOST_THREADS;\n");
+  fprintf(fp, "  std::vector<std::thread> threads;\n");
+  fprintf(fp, "  for (long lo = 0; lo < n; lo += chunk) {\n");
+  fprintf(fp, "    long hi = std::min(n, lo + chunk);\n");
+  fprintf(fp, "    threads.emplace_back([=]() {\n");
+  fprintf(fp, "      autosa_numa_bind();\n");
+  fprintf(fp, "      std::copy(first + lo, first + hi, d_first + lo);\n");
+  fprintf(fp, "    });\n");
+  fprintf(fp, "  }\n");
+  fprintf(fp, "  for (auto &thread : threads)\n");
+  fprintf(fp, "    thread.join();\n");
+  fprintf(fp, "}\n\n");
+}
+
+/* Print the function unpacking the "N" elements of a DRAM word from
+ * the serialized outputs into the host arrays.
+ * The lanes of a DRAM word are consecutive elements of the host array,
+ * such that the word is moved with full-width AVX-512 or AVX2 loads and
+ * stores, and the remaining bytes, or all of them without these extensions,
+ * are copied element by element.
+ */
+static void print_host_simd_unpack_header_xilinx(FILE *fp)
+{
+  fprintf(fp, "#if defined(__AVX512F__) || defined(__AVX2__)\n");
+  fprintf(fp, "#include <immintrin.h>\n");
+  fprintf(fp, "#endif\n\n");
+
+  fprintf(fp, "template <int N, typename T>\n");
+  fprintf(fp, "inline void autosa_unpack(T *dst, const T *src)\n");
+  fprintf(fp, "{\n");
+  fprintf(fp, "  const int n_byte = N * sizeof(T);\n");
+  fprintf(fp, "  const char *s = reinterpret_cast<const char *>(src);\n");
+  fprintf(fp, "  char *d = reinterpret_cast<char *>(dst);\n");
+  fprintf(fp, "  int i = 0;\n");
+  fprintf(fp, "#if defined(__AVX512F__)\n");
+  fprintf(fp, "  for (; i + 64 <= n_byte; i += 64)\n");
+  fprintf(fp, "    _mm512_storeu_si512(reinterpret_cast<void *>(d + i), _mm512_loadu_si512(reinterpret_cast<const void *>(s + i)));\n");
+  fprintf(fp, "#endif\n");
+  fprintf(fp, "#if defined(__AVX2__)\n");
+  fprintf(fp, "  for (; i + 32 <= n_byte; i += 32)\n");
+  fprintf(fp, "    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + i), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i)));\n");
+  fprintf(fp, "#endif\n");
+  fprintf(fp, "  for (int j = i / sizeof(T); j < N; j++)\n");
+  fprintf(fp, "    dst[j] = src[j];\n");
+  fprintf(fp, "}\n\n");
+}
+
+/* Print the QDMA stream functions of the Xilinx OpenCL extensions,
+ * which are loaded from the platform of the device by autosa_stream_init.
+ */
+static void print_qdma_stream_header_xilinx(FILE *fp)
+{
+  fprintf(fp, "/* Timeout of the transfers of the QDMA streams in ms */\n");
+  fprintf(fp, "#define AUTOSA_STREAM_TIMEOUT 100000\n\n");
+
+  fprintf(fp, "decltype(&clCreateStream) autosa_create_stream;\n");
+  fprintf(fp, "decltype(&clReleaseStream) autosa_release_stream;\n");
+  fprintf(fp, "decltype(&clWriteStream) autosa_write_stream;\n");
+  fprintf(fp, "decltype(&clPollStreams) autosa_poll_streams;\n\n");
+
+  fprintf(fp, "void autosa_stream_init(cl_platform_id platform)\n");
+  fprintf(fp, "{\n");
+  fprintf(fp, "  autosa_create_stream = (decltype(&clCreateStream))clGetExtensionFunctionAddressForPlatform(platform, \"clCreateStream\");\n");
+  fprintf(fp, "  autosa_release_stream = (decltype(&clReleaseStream))clGetExtensionFunctionAddressForPlatform(platform, \"clReleaseStream\");\n");
+  fprintf(fp, "  autosa_write_stream = (decltype(&clWriteStream))clGetExtensionFunctionAddressForPlatform(platform, \"clWriteStream\");\n");
+  fprintf(fp, "  autosa_poll_streams = (decltype(&clPollStreams))clGetExtensionFunctionAddressForPlatform(platform, \"clPollStreams\");\n");
+  fprintf(fp, "}\n\n");
+}
+
+/* Print the start of a copy between the host arrays and the host buffers,
+ * split across the threads of the host if --AutoSA-host-threads is set.
+ */
+static __isl_give isl_printer *print_host_copy_start(__isl_take isl_printer *p,
+                                                     struct autosa_kernel *kernel)
+{
+  if (kernel->options->autosa->host_threads > 1)
+    return isl_printer_print_str(p, "autosa_parallel_copy(");
+  return isl_printer_print_str(p, "std::copy(");
+}
+
+/* Are the outputs of the host merged across their memory ports, or
+ * deserialized, directly into the host arrays?
+ * This is the case with "--AutoSA-host-simd-unpack" in the OpenCL or
+ * XRT host with a single batch on a single device, where the host buffers
+ * of the outputs are otherwise only copied back to the host arrays.
+ * The host buffers are initialized from the host arrays, such that
+ * the elements not written by the kernel are the same either way.
+ */
+static int host_unpack_fused(struct autosa_kernel *kernel, int hls,
+                             int n_slot, int n_device)
+{
+  return !hls && kernel->options->autosa->host_simd_unpack &&
+         n_slot <= 1 && n_device <= 1;
+}
+
+/* Print the performance counters of the hardware modules and the functions
+ * accessing the FIFOs through them.
+ * A read issued on an empty FIFO is counted as an empty stall, a write
+ * issued on a full FIFO as a full stall, and the other accesses as active.
+ * The counters of all the module instances are collected from the FIFOs
+ * "fifo_perf" and written to the external memory by autosa_perf_collect.
+ */
+static void print_perf_counters_header_xilinx(FILE *fp)
+{
+  fprintf(fp, "/* Performance counters of a hardware module */\n");
+  fprintf(fp, "typedef struct {\n");
+  fprintf(fp, "  unsigned int active;\n");
+  fprintf(fp, "  unsigned int empty;\n");
+  fprintf(fp, "  unsigned int full;\n");
+  fprintf(fp, "} autosa_perf_t;\n\n");
+
+  fprintf(fp, "template <typename T>\n");
+  fprintf(fp, "T autosa_perf_read(hls::stream<T> &fifo, autosa_perf_t &perf) {\n");
+  fprintf(fp, "#pragma HLS INLINE\n");
+  fprintf(fp, "  if (fifo.empty())\n");
+  fprintf(fp, "    perf.empty++;\n");
+  fprintf(fp, "  else\n");
+  fprintf(fp, "    perf.active++;\n");
+  fprintf(fp, "  return fifo.read();\n");
+  fprintf(fp, "}\n\n");
+
+  fprintf(fp, "template <typename T, typename D>\n");
+  fprintf(fp, "void autosa_perf_write(hls::stream<T> &fifo, autosa_perf_t &perf, const D &data) {\n");
+  fprintf(fp, "#pragma HLS INLINE\n");
+  fprintf(fp, "  if (fifo.full())\n");
+  fprintf(fp, "    perf.full++;\n");
+  fprintf(fp, "  else\n");
+  fprintf(fp, "    perf.active++;\n");
+  fprintf(fp, "  fifo.write(data);\n");
+  fprintf(fp, "}\n\n");
+
+  fprintf(fp, "template <int N>\n");
+  fprintf(fp, "void autosa_perf_collect(hls::stream<autosa_perf_t> fifo_perf[N], unsigned int *perf) {\n");
+  fprintf(fp, "#pragma HLS INLINE OFF\n");
+  fprintf(fp, "  for (int i = 0; i < N; i++) {\n");
+  fprintf(fp, "#pragma HLS PIPELINE II=1\n");
+  fprintf(fp, "    autosa_perf_t data = fifo_perf[i].read();\n");
+  fprintf(fp, "    perf[3 * i] = data.active;\n");
+  fprintf(fp, "    perf[3 * i + 1] = data.empty;\n");
+  fprintf(fp, "    perf[3 * i + 2] = data.full;\n");
+  fprintf(fp, "  }\n");
+  fprintf(fp, "}\n\n");
+}
+
+/* Print the caches of the irregular arrays.
+ * autosa_cache_read reads the element "idx" of an irregular array through
+ * the request and response FIFOs of its cache.
+ * autosa_cache serves the requests of the N PEs to the array "mem" of
+ * "n_elem" elements from a set-associative cache of SETS sets of WAYS ways.
+ * The PEs are polled in a round-robin order. On a miss, the line of
+ * AUTOSA_CACHE_LINE bytes holding the element is fetched in the way
+ * following the last filled way of the set. The cache stops once it has
+ * received the final token (-1) of each PE.
+ */
+static void print_irregular_cache_header_xilinx(FILE *fp)
+{
+  fprintf(fp, "/* Caches of the irregular arrays */\n");
+  fprintf(fp, "#define AUTOSA_CACHE_LINE 64\n\n");
+
+  fprintf(fp, "template <typename T>\n");
+  fprintf(fp, "T autosa_cache_read(hls::stream<int> &req, hls::stream<T> &resp, int idx) {\n");
+  fprintf(fp, "#pragma HLS INLINE\n");
+  fprintf(fp, "  req.write(idx);\n");
+  fprintf(fp, "  return resp.read();\n");
+  fprintf(fp, "}\n\n");
+
+  fprintf(fp, "template <typename T, int N, int SETS, int WAYS>\n");
+  fprintf(fp, "void autosa_cache(T *mem, hls::stream<int> req[N], hls::stream<T> resp[N], int n_elem) {\n");
+  fprintf(fp, "#pragma HLS INLINE OFF\n");
+  fprintf(fp, "  const int LINE = AUTOSA_CACHE_LINE / sizeof(T) > 0 ? AUTOSA_CACHE_LINE / sizeof(T) : 1;\n");
+  fprintf(fp, "  T data[SETS][WAYS][LINE];\n");
+  fprintf(fp, "#pragma HLS ARRAY_PARTITION variable=data complete dim=2\n");
+  fprintf(fp, "  int tag[SETS][WAYS];\n");
+  fprintf(fp, "#pragma HLS ARRAY_PARTITION variable=tag complete dim=2\n");
+  fprintf(fp, "  int victim[SETS];\n");
+  fprintf(fp, "  for (int s = 0; s < SETS; s++) {\n");
+  fprintf(fp, "#pragma HLS PIPELINE II=1\n");
+  fprintf(fp, "    victim[s] = 0;\n");
+  fprintf(fp, "    for (int w = 0; w < WAYS; w++)\n");
+  fprintf(fp, "      tag[s][w] = -1;\n");
+  fprintf(fp, "  }\n");
+  fprintf(fp, "  int n_done = 0, pe = 0;\n");
+  fprintf(fp, "  while (n_done < N) {\n");
+  fprintf(fp, "    int idx;\n");
+  fprintf(fp, "    if (req[pe].read_nb(idx)) {\n");
+  fprintf(fp, "      if (idx < 0) {\n");
+  fprintf(fp, "        n_done++;\n");
+  fprintf(fp, "      } else {\n");
+  fprintf(fp, "        int line = idx / LINE;\n");
+  fprintf(fp, "        int set = line %% SETS;\n");
+  fprintf(fp, "        int way = -1;\n");
+  fprintf(fp, "        for (int w = 0; w < WAYS; w++) {\n");
+  fprintf(fp, "#pragma HLS UNROLL\n");
+  fprintf(fp, "          if (tag[set][w] == line)\n");
+  fprintf(fp, "            way = w;\n");
+  fprintf(fp, "        }\n");
+  fprintf(fp, "        if (way < 0) {\n");
+  fprintf(fp, "          way = victim[set];\n");
+  fprintf(fp, "          victim[set] = way == WAYS - 1 ? 0 : way + 1;\n");
+  fprintf(fp, "          tag[set][way] = line;\n");
+  fprintf(fp, "          for (int e = 0; e < LINE; e++) {\n");
+  fprintf(fp, "#pragma HLS PIPELINE II=1\n");
+  fprintf(fp, "            if (line * LINE + e < n_elem)\n");
+  fprintf(fp, "              data[set][way][e] = mem[line * LINE + e];\n");
+  fprintf(fp, "          }\n");
+  fprintf(fp, "        }\n");
+  fprintf(fp, "        resp[pe].write(data[set][way][idx %% LINE]);\n");
+  fprintf(fp, "      }\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "    pe = pe == N - 1 ? 0 : pe + 1;\n");
+  fprintf(fp, "  }\n");
+  fprintf(fp, "}\n\n");
+}
+
+/* Print the processes tracing the occupancy of the FIFOs.
+ * autosa_fifo_trace forwards the elements of a FIFO through a buffer of
+ * depth D, and samples the occupancy of the buffer every
+ * AUTOSA_TRACE_PERIOD cycles, together with the number of cycles of the
+ * period during which the buffer was empty with no incoming element, and
+ * full with the outgoing FIFO full.
+ * It stops once the reader of the FIFO drains its performance counters,
+ * which are forwarded, and writes out its samples to "fifo_trace".
+ * autosa_trace_collect writes the samples of the N traced FIFOs to the
+ * external memory, AUTOSA_TRACE_DEPTH + 1 words per FIFO, starting with
+ * the number of samples.
+ */
+static void print_fifo_trace_header_xilinx(FILE *fp)
+{
+  fprintf(fp, "/* FIFO traces */\n");
+  fprintf(fp, "#define AUTOSA_TRACE_DEPTH %d\n", AUTOSA_FIFO_TRACE_DEPTH);
+  fprintf(fp, "#define AUTOSA_TRACE_PERIOD %d\n\n", AUTOSA_FIFO_TRACE_PERIOD);
+
+  fprintf(fp, "template <int D, typename T>\n");
+  fprintf(fp, "void autosa_fifo_trace(hls::stream<T> &fifo_in, hls::stream<T> &fifo_out,\n");
+  fprintf(fp, "                       hls::stream<autosa_perf_t> &perf_in, hls::stream<autosa_perf_t> &perf_out,\n");
+  fprintf(fp, "                       hls::stream<unsigned int> &fifo_trace) {\n");
+  fprintf(fp, "#pragma HLS INLINE OFF\n");
+  fprintf(fp, "  T buf[D];\n");
+  fprintf(fp, "#pragma HLS DEPENDENCE variable=buf inter false\n");
+  fprintf(fp, "  unsigned int samples[AUTOSA_TRACE_DEPTH];\n");
+  fprintf(fp, "  unsigned int head = 0, tail = 0, occ = 0;\n");
+  fprintf(fp, "  unsigned int cycle = 0, n_sample = 0, empty = 0, full = 0;\n");
+  fprintf(fp, "  bool done = false;\n");
+  fprintf(fp, "  while (!done) {\n");
+  fprintf(fp, "#pragma HLS PIPELINE II=1\n");
+  fprintf(fp, "    bool push = occ < D && !fifo_in.empty();\n");
+  fprintf(fp, "    bool pop = occ > 0 && !fifo_out.full();\n");
+  fprintf(fp, "    if (occ == 0 && !push)\n");
+  fprintf(fp, "      empty++;\n");
+  fprintf(fp, "    if (occ > 0 && !pop)\n");
+  fprintf(fp, "      full++;\n");
+  fprintf(fp, "    if (push) {\n");
+  fprintf(fp, "      buf[tail] = fifo_in.read();\n");
+  fprintf(fp, "      tail = tail == D - 1 ? 0 : tail + 1;\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "    if (pop) {\n");
+  fprintf(fp, "      fifo_out.write(buf[head]);\n");
+  fprintf(fp, "      head = head == D - 1 ? 0 : head + 1;\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "    occ = occ + push - pop;\n");
+  fprintf(fp, "    if (++cycle == AUTOSA_TRACE_PERIOD) {\n");
+  fprintf(fp, "      if (n_sample < AUTOSA_TRACE_DEPTH)\n");
+  fprintf(fp, "        samples[n_sample++] = occ | (empty << 16) | (full << 24);\n");
+  fprintf(fp, "      cycle = 0;\n");
+  fprintf(fp, "      empty = 0;\n");
+  fprintf(fp, "      full = 0;\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "    if (occ == 0 && !perf_in.empty()) {\n");
+  fprintf(fp, "      perf_out.write(perf_in.read());\n");
+  fprintf(fp, "      done = true;\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "  }\n");
+  fprintf(fp, "  fifo_trace.write(n_sample);\n");
+  fprintf(fp, "  for (unsigned int i = 0; i < n_sample; i++) {\n");
+  fprintf(fp, "#pragma HLS PIPELINE II=1\n");
+  fprintf(fp, "    fifo_trace.write(samples[i]);\n");
+  fprintf(fp, "  }\n");
+  fprintf(fp, "}\n\n");
+
+  fprintf(fp, "template <int N>\n");
+  fprintf(fp, "void autosa_trace_collect(hls::stream<unsigned int> fifo_trace[N], unsigned int *trace) {\n");
+  fprintf(fp, "#pragma HLS INLINE OFF\n");
+  fprintf(fp, "  for (int i = 0; i < N; i++) {\n");
+  fprintf(fp, "    unsigned int n_sample = fifo_trace[i].read();\n");
+  fprintf(fp, "    trace[i * (AUTOSA_TRACE_DEPTH + 1)] = n_sample;\n");
+  fprintf(fp, "    for (unsigned int j = 0; j < n_sample; j++) {\n");
+  fprintf(fp, "#pragma HLS PIPELINE II=1\n");
+  fprintf(fp, "      trace[i * (AUTOSA_TRACE_DEPTH + 1) + 1 + j] = fifo_trace[i].read();\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "  }\n");
+  fprintf(fp, "}\n\n");
+}
+
+/* Print the tile scheduler "autosa_tile_scheduler.h" of the host, which
+ * runs the jobs of different problem sizes on the same array with the
+ * runtime numbers of array partitions, to "fp".
+ */
+static void print_tile_scheduler_header_xilinx(FILE *fp)
+{
+  fprintf(fp, "#ifndef AUTOSA_TILE_SCHEDULER_H\n");
+  fprintf(fp, "#define AUTOSA_TILE_SCHEDULER_H\n\n");
+
+  fprintf(fp, "#include <stddef.h>\n");
+  fprintf(fp, "#include <functional>\n");
+  fprintf(fp, "#include <vector>\n\n");
+
+  fprintf(fp, "/* A job run on the systolic array, with the numbers of array partitions\n");
+  fprintf(fp, " * \"n_tile\" along the array partitioning loops and the host buffers\n");
+  fprintf(fp, " * \"operand\" of the arrays.\n");
+  fprintf(fp, " */\n");
+  fprintf(fp, "template <int N_TILE, int N_OPERAND>\n");
+  fprintf(fp, "struct autosa_job {\n");
+  fprintf(fp, "  int id;\n");
+  fprintf(fp, "  int n_tile[N_TILE];\n");
+  fprintf(fp, "  const void *operand[N_OPERAND];\n");
+  fprintf(fp, "};\n\n");
+
+  fprintf(fp, "/* Schedule the jobs of different problem sizes on the same systolic array,\n");
+  fprintf(fp, " * whose numbers of array partitions n_tile_<i> are set at runtime.\n");
+  fprintf(fp, " * The jobs are run in an order that keeps the operands resident on the\n");
+  fprintf(fp, " * device between consecutive jobs, i.e., each job is preceded by the\n");
+  fprintf(fp, " * queued job sharing the most host buffers with it.\n");
+  fprintf(fp, " */\n");
+  fprintf(fp, "template <int N_TILE, int N_OPERAND>\n");
+  fprintf(fp, "class autosa_tile_scheduler {\n");
+  fprintf(fp, "public:\n");
+  fprintf(fp, "  typedef autosa_job<N_TILE, N_OPERAND> job_t;\n\n");
+
+  fprintf(fp, "  /* \"tile_size\" are the array partition sizes and \"max_tile\" the compiled\n");
+  fprintf(fp, "   * numbers of array partitions along the array partitioning loops.\n");
+  fprintf(fp, "   */\n");
+  fprintf(fp, "  autosa_tile_scheduler(const int *tile_size, const int *max_tile) {\n");
+  fprintf(fp, "    for (int i = 0; i < N_TILE; i++) {\n");
+  fprintf(fp, "      this->tile_size[i] = tile_size[i];\n");
+  fprintf(fp, "      this->max_tile[i] = max_tile[i];\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "  }\n\n");
+
+  fprintf(fp, "  /* Queue a job with the problem extents \"extent\" along the array\n");
+  fprintf(fp, "   * partitioning loops and the host buffers \"operand\".\n");
+  fprintf(fp, "   * The host buffers are padded to a multiple of the array partition size\n");
+  fprintf(fp, "   * and laid out with the compiled array sizes.\n");
+  fprintf(fp, "   * Return the id of the job, or -1 if the job doesn't fit on the array.\n");
+  fprintf(fp, "   */\n");
+  fprintf(fp, "  int push(const int *extent, const void *const *operand) {\n");
+  fprintf(fp, "    job_t job;\n\n");
+
+  fprintf(fp, "    job.id = next_id;\n");
+  fprintf(fp, "    for (int i = 0; i < N_TILE; i++) {\n");
+  fprintf(fp, "      job.n_tile[i] = (extent[i] + tile_size[i] - 1) / tile_size[i];\n");
+  fprintf(fp, "      if (job.n_tile[i] < 1 || job.n_tile[i] > max_tile[i])\n");
+  fprintf(fp, "        return -1;\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "    for (int i = 0; i < N_OPERAND; i++)\n");
+  fprintf(fp, "      job.operand[i] = operand[i];\n");
+  fprintf(fp, "    jobs.push_back(job);\n\n");
+
+  fprintf(fp, "    return next_id++;\n");
+  fprintf(fp, "  }\n\n");
+
+  fprintf(fp, "  /* Return the extent along the array partitioning loop \"i\" the host\n");
+  fprintf(fp, "   * buffers of \"job\" are padded to.\n");
+  fprintf(fp, "   */\n");
+  fprintf(fp, "  int padded_extent(const job_t &job, int i) const {\n");
+  fprintf(fp, "    return job.n_tile[i] * tile_size[i];\n");
+  fprintf(fp, "  }\n\n");
+
+  fprintf(fp, "  /* Order the queued jobs greedily, starting from the first queued job,\n");
+  fprintf(fp, "   * such that each job is followed by the remaining job sharing the most\n");
+  fprintf(fp, "   * host buffers with it, in the queue order for the ties.\n");
+  fprintf(fp, "   */\n");
+  fprintf(fp, "  void order() {\n");
+  fprintf(fp, "    std::vector<job_t> ordered;\n\n");
+
+  fprintf(fp, "    while (!jobs.empty()) {\n");
+  fprintf(fp, "      size_t best = 0;\n");
+  fprintf(fp, "      int best_shared = -1;\n\n");
+
+  fprintf(fp, "      for (size_t j = 0; j < jobs.size() && !ordered.empty(); j++) {\n");
+  fprintf(fp, "        int shared = n_shared(ordered.back(), jobs[j]);\n");
+  fprintf(fp, "        if (shared > best_shared) {\n");
+  fprintf(fp, "          best = j;\n");
+  fprintf(fp, "          best_shared = shared;\n");
+  fprintf(fp, "        }\n");
+  fprintf(fp, "      }\n");
+  fprintf(fp, "      ordered.push_back(jobs[best]);\n");
+  fprintf(fp, "      jobs.erase(jobs.begin() + best);\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "    jobs.swap(ordered);\n");
+  fprintf(fp, "  }\n\n");
+
+  fprintf(fp, "  /* Run the queued jobs in order by calling \"launch\" on each of them,\n");
+  fprintf(fp, "   * and clear the queue.\n");
+  fprintf(fp, "   * \"resident[k]\" is set if the operand \"k\" is the host buffer of the\n");
+  fprintf(fp, "   * previous job, such that its transfer to the device can be skipped\n");
+  fprintf(fp, "   * if the array is not written by the kernel.\n");
+  fprintf(fp, "   * The kernel arguments n_tile_<i> are set to job.n_tile[i] by \"launch\".\n");
+  fprintf(fp, "   * Return the number of transfers skipped.\n");
+  fprintf(fp, "   */\n");
+  fprintf(fp, "  int run(std::function<void(const job_t &, const bool *)> launch) {\n");
+  fprintf(fp, "    int n_resident = 0;\n\n");
+
+  fprintf(fp, "    for (size_t j = 0; j < jobs.size(); j++) {\n");
+  fprintf(fp, "      bool resident[N_OPERAND > 0 ? N_OPERAND : 1];\n");
+  fprintf(fp, "      for (int k = 0; k < N_OPERAND; k++) {\n");
+  fprintf(fp, "        resident[k] = j > 0 && jobs[j].operand[k] == jobs[j - 1].operand[k];\n");
+  fprintf(fp, "        n_resident += resident[k];\n");
+  fprintf(fp, "      }\n");
+  fprintf(fp, "      launch(jobs[j], resident);\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "    jobs.clear();\n\n");
+
+  fprintf(fp, "    return n_resident;\n");
+  fprintf(fp, "  }\n\n");
+
+  fprintf(fp, "  size_t size() const { return jobs.size(); }\n\n");
+
+  fprintf(fp, "private:\n");
+  fprintf(fp, "  /* Return the number of host buffers shared by the jobs \"a\" and \"b\". */\n");
+  fprintf(fp, "  static int n_shared(const job_t &a, const job_t &b) {\n");
+  fprintf(fp, "    int n = 0;\n");
+  fprintf(fp, "    for (int k = 0; k < N_OPERAND; k++)\n");
+  fprintf(fp, "      n += a.operand[k] == b.operand[k];\n");
+  fprintf(fp, "    return n;\n");
+  fprintf(fp, "  }\n\n");
+
+  fprintf(fp, "  int tile_size[N_TILE];\n");
+  fprintf(fp, "  int max_tile[N_TILE];\n");
+  fprintf(fp, "  int next_id = 0;\n");
+  fprintf(fp, "  std::vector<job_t> jobs;\n");
+  fprintf(fp, "};\n\n");
+
+  fprintf(fp, "#endif\n");
+}
+
+/* Print the functions caching the golden data of the HLS host to "fp"
+ * and mapping them back in the cached testbench.
+ * All the files are kept in the directory AUTOSA_TB_DIR.
+ * The cached files are mapped with private pages, such that the kernel
+ * can update its inputs in place without modifying the files.
+ * autosa_tb_check compares the elements of an output with the stride
+ * "stride" and the last element, with a relative tolerance for
+ * the floating-point types.
+ */
+static void print_tb_cache_header_xilinx(FILE *fp)
+{
+  fprintf(fp, "#ifndef AUTOSA_TB_CACHE_H\n");
+  fprintf(fp, "#define AUTOSA_TB_CACHE_H\n\n");
+  fprintf(fp, "#include <fcntl.h>\n");
+  fprintf(fp, "#include <math.h>\n");
+  fprintf(fp, "#include <stdio.h>\n");
+  fprintf(fp, "#include <stdlib.h>\n");
+  fprintf(fp, "#include <string.h>\n");
+  fprintf(fp, "#include <sys/mman.h>\n");
+  fprintf(fp, "#include <sys/stat.h>\n");
+  fprintf(fp, "#include <unistd.h>\n");
+  fprintf(fp, "#include <type_traits>\n\n");
+  fprintf(fp, "#define AUTOSA_TB_DIR \"tb_data\"\n\n");
+
+  fprintf(fp, "/* Write the \"size\" bytes of \"data\" to the cached file \"name\". */\n");
+  fprintf(fp, "static void autosa_tb_record(const char *name, const void *data, size_t size) {\n");
+  fprintf(fp, "  char path[1024];\n");
+  fprintf(fp, "  snprintf(path, sizeof(path), \"%%s/%%s\", AUTOSA_TB_DIR, name);\n");
+  fprintf(fp, "  mkdir(AUTOSA_TB_DIR, 0755);\n");
+  fprintf(fp, "  FILE *fp = fopen(path, \"wb\");\n");
+  fprintf(fp, "  if (!fp || fwrite(data, 1, size, fp) != size)\n");
+  fprintf(fp, "    fprintf(stderr, \"[AutoSA] Warning: Can't cache the file: %%s\\n\", path);\n");
+  fprintf(fp, "  if (fp)\n");
+  fprintf(fp, "    fclose(fp);\n");
+  fprintf(fp, "}\n\n");
+
+  fprintf(fp, "/* A cached file mapped into memory. */\n");
+  fprintf(fp, "struct autosa_tb_buffer {\n");
+  fprintf(fp, "  void *data;\n");
+  fprintf(fp, "  size_t size;\n\n");
+  fprintf(fp, "  autosa_tb_buffer(const char *name) : data(NULL), size(0) {\n");
+  fprintf(fp, "    char path[1024];\n");
+  fprintf(fp, "    struct stat st;\n");
+  fprintf(fp, "    snprintf(path, sizeof(path), \"%%s/%%s\", AUTOSA_TB_DIR, name);\n");
+  fprintf(fp, "    int fd = open(path, O_RDONLY);\n");
+  fprintf(fp, "    if (fd < 0 || fstat(fd, &st) != 0) {\n");
+  fprintf(fp, "      fprintf(stderr, \"[AutoSA] Error: Can't open the cached file: %%s. Run the host once to cache the golden data.\\n\", path);\n");
+  fprintf(fp, "      exit(1);\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "    size = st.st_size;\n");
+  fprintf(fp, "    if (size > 0)\n");
+  fprintf(fp, "      data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);\n");
+  fprintf(fp, "    close(fd);\n");
+  fprintf(fp, "    if (data == MAP_FAILED) {\n");
+  fprintf(fp, "      fprintf(stderr, \"[AutoSA] Error: Can't map the cached file: %%s\\n\", path);\n");
+  fprintf(fp, "      exit(1);\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "  }\n\n");
+  fprintf(fp, "  ~autosa_tb_buffer() {\n");
+  fprintf(fp, "    if (data)\n");
+  fprintf(fp, "      munmap(data, size);\n");
+  fprintf(fp, "  }\n\n");
+  fprintf(fp, "  template <typename T>\n");
+  fprintf(fp, "  operator T *() const { return (T *)data; }\n\n");
+  fprintf(fp, "  template <typename T>\n");
+  fprintf(fp, "  T value() const {\n");
+  fprintf(fp, "    T v;\n");
+  fprintf(fp, "    memcpy(&v, data, sizeof(T));\n");
+  fprintf(fp, "    return v;\n");
+  fprintf(fp, "  }\n");
+  fprintf(fp, "};\n\n");
+
+  fprintf(fp, "/* Compare the output \"out\" of the array \"name\" against \"golden\".\n");
+  fprintf(fp, " * Return the number of mismatches. */\n");
+  fprintf(fp, "template <typename T>\n");
+  fprintf(fp, "long autosa_tb_check(const char *name, const autosa_tb_buffer &out,\n");
+  fprintf(fp, "                     const autosa_tb_buffer &golden, long stride) {\n");
+  fprintf(fp, "  const T *o = (const T *)out.data;\n");
+  fprintf(fp, "  const T *g = (const T *)golden.data;\n");
+  fprintf(fp, "  long n = golden.size / sizeof(T);\n");
+  fprintf(fp, "  long n_check = 0, n_err = 0;\n");
+  fprintf(fp, "  if (out.size != golden.size) {\n");
+  fprintf(fp, "    printf(\"[AutoSA] Error: The size of %%s doesn't match the golden data.\\n\", name);\n");
+  fprintf(fp, "    return 1;\n");
+  fprintf(fp, "  }\n");
+  fprintf(fp, "  if (stride < 1)\n");
+  fprintf(fp, "    stride = 1;\n");
+  fprintf(fp, "  for (long i = 0; i < n; i = (i < n - 1 && i + stride >= n) ? n - 1 : i + stride) {\n");
+  fprintf(fp, "    bool ok;\n");
+  fprintf(fp, "    if (std::is_floating_point<T>::value)\n");
+  fprintf(fp, "      ok = fabs((double)o[i] - (double)g[i]) <= 1e-3 * fmax(1.0, fabs((double)g[i]));\n");
+  fprintf(fp, "    else\n");
+  fprintf(fp, "      ok = !memcmp(&o[i], &g[i], sizeof(T));\n");
+  fprintf(fp, "    if (!ok && n_err++ < 10)\n");
+  fprintf(fp, "      printf(\"[AutoSA] Mismatch of %%s at element %%ld.\\n\", name, i);\n");
+  fprintf(fp, "    n_check++;\n");
+  fprintf(fp, "    if (i == n - 1)\n");
+  fprintf(fp, "      break;\n");
+  fprintf(fp, "  }\n");
+  fprintf(fp, "  printf(\"[AutoSA] %%s: %%ld of %%ld elements checked, %%ld mismatches.\\n\", name, n_check, n, n_err);\n");
+  fprintf(fp, "  return n_err;\n");
+  fprintf(fp, "}\n\n");
+  fprintf(fp, "#endif\n");
+}
+
+/* Print the support library of the AI Engine kernels to "fp".
+ * The PEs mapped on the AI Engines are compiled from the same code as
+ * the HLS PEs: "hls::stream" is mapped on the 32-bit AI Engine streams,
+ * each element being sent as consecutive words from the least significant
+ * one, and "ap_uint" is implemented on an array of 32-bit words with
+ * the bit ranges, shifts and concatenations used to pack the data.
+ */
+static void print_aie_header_xilinx(FILE *fp)
+{
+  fprintf(fp, "#ifndef _AUTOSA_AIE_H\n");
+  fprintf(fp, "#define _AUTOSA_AIE_H\n\n");
+  fprintf(fp, "#include <adf.h>\n");
+  fprintf(fp, "#include <string.h>\n\n");
+
+  fprintf(fp, "template <int W>\n");
+  fprintf(fp, "struct ap_uint {\n");
+  fprintf(fp, "  static const int N = (W + 31) / 32;\n");
+  fprintf(fp, "  unsigned int w[N];\n\n");
+  fprintf(fp, "  /* The bits [hi, lo] of an ap_uint. */\n");
+  fprintf(fp, "  struct range_ref {\n");
+  fprintf(fp, "    ap_uint *v;\n");
+  fprintf(fp, "    int hi, lo;\n\n");
+  fprintf(fp, "    operator unsigned int() const { return v->get(hi, lo); }\n");
+  fprintf(fp, "    template <int K>\n");
+  fprintf(fp, "    operator ap_uint<K>() const { return v->template slice<K>(hi, lo); }\n");
+  fprintf(fp, "    range_ref &operator=(unsigned int x) { v->set(hi, lo, ap_uint<32>(x)); return *this; }\n");
+  fprintf(fp, "    template <int K>\n");
+  fprintf(fp, "    range_ref &operator=(const ap_uint<K> &x) { v->set(hi, lo, x); return *this; }\n");
+  fprintf(fp, "  };\n\n");
+  fprintf(fp, "  ap_uint() { for (int i = 0; i < N; i++) w[i] = 0; }\n");
+  fprintf(fp, "  ap_uint(unsigned int x) {\n");
+  fprintf(fp, "    for (int i = 0; i < N; i++) w[i] = 0;\n");
+  fprintf(fp, "    w[0] = W < 32 ? x & ((1u << (W %% 32)) - 1) : x;\n");
+  fprintf(fp, "  }\n\n");
+  fprintf(fp, "  unsigned int bit(int i) const { return (w[i / 32] >> (i %% 32)) & 1; }\n");
+  fprintf(fp, "  void set_bit(int i, unsigned int b) { w[i / 32] = (w[i / 32] & ~(1u << (i %% 32))) | (b << (i %% 32)); }\n\n");
+  fprintf(fp, "  /* Return the bits [hi, lo], at most 32 of them. */\n");
+  fprintf(fp, "  unsigned int get(int hi, int lo) const {\n");
+  fprintf(fp, "    unsigned int x = 0;\n");
+  fprintf(fp, "    if (lo %% 32 == 0 && hi - lo == 31)\n");
+  fprintf(fp, "      return w[lo / 32];\n");
+  fprintf(fp, "    for (int i = hi; i >= lo; i--)\n");
+  fprintf(fp, "      x = (x << 1) | bit(i);\n");
+  fprintf(fp, "    return x;\n");
+  fprintf(fp, "  }\n\n");
+  fprintf(fp, "  template <int K>\n");
+  fprintf(fp, "  ap_uint<K> slice(int hi, int lo) const {\n");
+  fprintf(fp, "    ap_uint<K> x;\n");
+  fprintf(fp, "    if (lo %% 32 == 0 && (hi - lo + 1) %% 32 == 0) {\n");
+  fprintf(fp, "      for (int i = 0; i < (hi - lo + 1) / 32 && i < ap_uint<K>::N; i++)\n");
+  fprintf(fp, "        x.w[i] = w[lo / 32 + i];\n");
+  fprintf(fp, "      return x;\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "    for (int i = 0; i <= hi - lo && i < K; i++)\n");
+  fprintf(fp, "      x.set_bit(i, bit(lo + i));\n");
+  fprintf(fp, "    return x;\n");
+  fprintf(fp, "  }\n\n");
+  fprintf(fp, "  template <int K>\n");
+  fprintf(fp, "  void set(int hi, int lo, const ap_uint<K> &x) {\n");
+  fprintf(fp, "    if (lo %% 32 == 0 && (hi - lo + 1) %% 32 == 0) {\n");
+  fprintf(fp, "      for (int i = 0; i < (hi - lo + 1) / 32; i++)\n");
+  fprintf(fp, "        w[lo / 32 + i] = i < ap_uint<K>::N ? x.w[i] : 0;\n");
+  fprintf(fp, "      return;\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "    for (int i = 0; i <= hi - lo; i++)\n");
+  fprintf(fp, "      set_bit(lo + i, i < K ? x.bit(i) : 0);\n");
+  fprintf(fp, "  }\n\n");
+  fprintf(fp, "  range_ref operator()(int hi, int lo) { range_ref r = {this, hi, lo}; return r; }\n");
+  fprintf(fp, "  range_ref range(int hi, int lo) { return (*this)(hi, lo); }\n\n");
+  fprintf(fp, "  ap_uint operator>>(int n) const {\n");
+  fprintf(fp, "    ap_uint x;\n");
+  fprintf(fp, "    if (n %% 32 == 0) {\n");
+  fprintf(fp, "      for (int i = 0; i + n / 32 < N; i++)\n");
+  fprintf(fp, "        x.w[i] = w[i + n / 32];\n");
+  fprintf(fp, "      return x;\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "    for (int i = 0; i + n < W; i++)\n");
+  fprintf(fp, "      x.set_bit(i, bit(i + n));\n");
+  fprintf(fp, "    return x;\n");
+  fprintf(fp, "  }\n");
+  fprintf(fp, "};\n\n");
+
+  fprintf(fp, "/* Concatenate \"hi\" and \"lo\". */\n");
+  fprintf(fp, "template <int A, int B>\n");
+  fprintf(fp, "ap_uint<A + B> operator,(const ap_uint<A> &hi, const ap_uint<B> &lo) {\n");
+  fprintf(fp, "  ap_uint<A + B> x;\n");
+  fprintf(fp, "  x.set(B - 1, 0, lo);\n");
+  fprintf(fp, "  x.set(A + B - 1, B, hi);\n");
+  fprintf(fp, "  return x;\n");
+  fprintf(fp, "}\n\n");
+
+  fprintf(fp, "namespace hls {\n\n");
+  fprintf(fp, "/* An HLS stream mapped on an AI Engine stream. */\n");
+  fprintf(fp, "template <typename T>\n");
+  fprintf(fp, "class stream {\n");
+  fprintf(fp, "public:\n");
+  fprintf(fp, "  static const int N = (sizeof(T) + 3) / 4;\n\n");
+  fprintf(fp, "  stream(input_stream<int32> *in) : in(in), out(NULL) {}\n");
+  fprintf(fp, "  stream(output_stream<int32> *out) : in(NULL), out(out) {}\n\n");
+  fprintf(fp, "  T read() {\n");
+  fprintf(fp, "    int32 w[N];\n");
+  fprintf(fp, "    T x;\n");
+  fprintf(fp, "    for (int i = 0; i < N; i++)\n");
+  fprintf(fp, "      w[i] = readincr(in);\n");
+  fprintf(fp, "    memcpy(&x, w, sizeof(T));\n");
+  fprintf(fp, "    return x;\n");
+  fprintf(fp, "  }\n\n");
+  fprintf(fp, "  void write(const T &x) {\n");
+  fprintf(fp, "    int32 w[N] = {0};\n");
+  fprintf(fp, "    memcpy(w, &x, sizeof(T));\n");
+  fprintf(fp, "    for (int i = 0; i < N; i++)\n");
+  fprintf(fp, "      writeincr(out, w[i]);\n");
+  fprintf(fp, "  }\n\n");
+  fprintf(fp, "private:\n");
+  fprintf(fp, "  input_stream<int32> *in;\n");
+  fprintf(fp, "  output_stream<int32> *out;\n");
+  fprintf(fp, "};\n\n");
+  fprintf(fp, "}\n\n");
+  fprintf(fp, "#endif\n");
+}
+
 /* Open the host .cpp file and the kernel .h and .cpp files for writing.
  * Add the necessary includes.
+ * With the cached testbench, the testbench .cpp file and the header
+ * "autosa_tb_cache.h" are written as well.
+ * With the host session, the session .h and .cpp files are written as well.
+ * With the tile scheduler, the header "autosa_tile_scheduler.h" is written.
+ * If the PEs are mapped on the AI Engines, the AI Engine kernels are
+ * written to "aie/kernels.cc", with the support library "aie/autosa_aie.h".
  */
 static void hls_open_files(struct hls_info *info, const char *input)
 {
@@ -138,11 +938,22 @@ static void hls_open_files(struct hls_info *info, const char *input)
 
   if (!info->hls)
   {
-    /* OpenCL host */
+    /* OpenCL or XRT host */
     strcpy(name + len, "_host.hpp");
     strcpy(dir + len_dir, name);
     info->host_h = fopen(dir, "w");
-    print_xilinx_host_header(info->host_h);
+    if (info->host_xrt)
+      print_xrt_host_header(info->host_h);
+    else
+      print_xilinx_host_header(info->host_h);
+    if (info->host_bench)
+      print_host_bench_header_xilinx(info->host_h);
+    if (info->host_threads > 1)
+      print_host_threads_header_xilinx(info->host_h, info->host_threads);
+    if (info->qdma_stream)
+      print_qdma_stream_header_xilinx(info->host_h);
+    if (info->host_simd_unpack)
+      print_host_simd_unpack_header_xilinx(info->host_h);
     fprintf(info->host_c, "#include \"%s\"\n", name);
   }
 
@@ -168,10 +979,117 @@ static void hls_open_files(struct hls_info *info, const char *input)
   fprintf(info->host_c, "#include <stdio.h>\n");
   if (info->hls)
     fprintf(info->host_c, "#include \"%s\"\n\n", name);
+  if (info->perf_counters)
+    fprintf(info->host_c, "#include \"perf_counters.h\"\n\n");
 
   if (info->hls)
     fprintf(info->kernel_c, "#include \"%s\"\n", name);
 
+  info->tb_c = NULL;
+  if (info->tb_cache)
+  {
+    FILE *fp;
+
+    strcpy(dir + len_dir, "autosa_tb_cache.h");
+    fp = fopen(dir, "w");
+    if (!fp)
+    {
+      printf("[AutoSA] Error: Can't open the file: %s\n", dir);
+      exit(1);
+    }
+    print_tb_cache_header_xilinx(fp);
+    fclose(fp);
+    fprintf(info->host_c, "#include \"autosa_tb_cache.h\"\n\n");
+
+    strcpy(name + len, "_tb.cpp");
+    strcpy(dir + len_dir, name);
+    info->tb_c = fopen(dir, "w");
+    if (!info->tb_c)
+    {
+      printf("[AutoSA] Error: Can't open the file: %s\n", dir);
+      exit(1);
+    }
+    strcpy(name + len, "_kernel.h");
+    fprintf(info->tb_c, "#include \"autosa_tb_cache.h\"\n");
+    fprintf(info->tb_c, "#include \"%s\"\n\n", name);
+  }
+
+  info->session_c = NULL;
+  info->session_h = NULL;
+  if (info->host_session)
+  {
+    strcpy(name + len, "_session.h");
+    strcpy(dir + len_dir, name);
+    info->session_h = fopen(dir, "w");
+    if (!info->session_h)
+    {
+      printf("[AutoSA] Error: Can't open the file: %s\n", dir);
+      exit(1);
+    }
+
+    strcpy(name + len, "_session.cpp");
+    strcpy(dir + len_dir, name);
+    info->session_c = fopen(dir, "w");
+    if (!info->session_c)
+    {
+      printf("[AutoSA] Error: Can't open the file: %s\n", dir);
+      exit(1);
+    }
+    strcpy(name + len, "_session.h");
+    fprintf(info->session_c, "#include <iostream>\n");
+    fprintf(info->session_c, "#include <memory>\n");
+    fprintf(info->session_c, "#include <mutex>\n");
+    fprintf(info->session_c, "#include <vector>\n\n");
+    fprintf(info->session_c, "#include <xrt/xrt_bo.h>\n");
+    fprintf(info->session_c, "#include <xrt/xrt_device.h>\n");
+    fprintf(info->session_c, "#include <xrt/xrt_kernel.h>\n\n");
+    fprintf(info->session_c, "#include \"%s\"\n\n", name);
+  }
+
+  if (info->tile_scheduler)
+  {
+    FILE *fp;
+
+    strcpy(dir + len_dir, "autosa_tile_scheduler.h");
+    fp = fopen(dir, "w");
+    if (!fp)
+    {
+      printf("[AutoSA] Error: Can't open the file: %s\n", dir);
+      exit(1);
+    }
+    print_tile_scheduler_header_xilinx(fp);
+    fclose(fp);
+    fprintf(info->host_c, "#include \"autosa_tile_scheduler.h\"\n\n");
+  }
+
+  info->aie_c = NULL;
+  if (info->aie)
+  {
+    FILE *fp;
+
+    strcpy(dir + len_dir, "aie");
+    mkdir(dir, 0755);
+    strcpy(dir + len_dir, "aie/autosa_aie.h");
+    fp = fopen(dir, "w");
+    if (!fp)
+    {
+      printf("[AutoSA] Error: Can't open the file: %s\n", dir);
+      exit(1);
+    }
+    print_aie_header_xilinx(fp);
+    fclose(fp);
+
+    strcpy(dir + len_dir, "aie/kernels.cc");
+    info->aie_c = fopen(dir, "w");
+    if (!info->aie_c)
+    {
+      printf("[AutoSA] Error: Can't open the file: %s\n", dir);
+      exit(1);
+    }
+    fprintf(info->aie_c, "#include \"autosa_aie.h\"\n");
+    fprintf(info->aie_c, "#include \"kernels.h\"\n\n");
+  }
+
   strcpy(name + len, "_top_gen.cpp");
   strcpy(dir + len_dir, name);
   info->top_gen_c = fopen(dir, "w");
@@ -184,15 +1102,74 @@ static void hls_open_files(struct hls_info *info, const char *input)
   fprintf(info->top_gen_c, "#include \"%s\"\n", name);
 
   fprintf(info->kernel_h, "#include <ap_int.h>\n");
-  fprintf(info->kernel_h, "#include <hls_stream.h>\n");
+  if (info->cpu_sim)
+    fprintf(info->kernel_h, "#include \"autosa_cpu_stream.h\"\n");
+  else
+    fprintf(info->kernel_h, "#include <hls_stream.h>\n");
   fprintf(info->kernel_h, "\n");
+  if (info->perf_counters)
+    print_perf_counters_header_xilinx(info->kernel_h);
+  if (info->fifo_trace)
+    print_fifo_trace_header_xilinx(info->kernel_h);
+  if (info->cache_sets > 0)
+    print_irregular_cache_header_xilinx(info->kernel_h);
 
   free(file_path);
 }
 
-/* Close all output files.
+/* Stitch the module definitions and the top module generated by AutoSA
+ * into the final kernel file "<input>_kernel.cpp".
+ * The kernel header is merged into the kernel file for the OpenCL host.
+ * The intermediate files are removed.
+ * If the top module is not generated by AutoSA (no "top.cpp"), the kernel
+ * is left to the post-processing scripts.
+ */
+static void hls_write_kernel(struct hls_info *info, const char *input)
+{
+  char name[PATH_MAX];
+  int len;
+  std::string dir = std::string(info->output_dir) + "/src/";
+  std::string top = dir + "top.cpp";
+  std::string kernel, modules, header;
+  FILE *fp;
+  struct stat st;
+
+  if (stat(top.c_str(), &st) != 0)
+    return;
+
+  len = ppcg_extract_base_name(name, input);
+  strcpy(name + len, "_kernel.cpp");
+  kernel = dir + name;
+  strcpy(name + len, "_kernel_modules.cpp");
+  modules = dir + name;
+  strcpy(name + len, "_kernel.h");
+  header = dir + name;
+
+  fp = fopen(kernel.c_str(), "w");
+  if (!fp)
+  {
+    printf("[AutoSA] Error: Can't open the file: %s\n", kernel.c_str());
+    return;
+  }
+  if (!info->hls && !info->cpu_sim)
+  {
+    append_file(fp, header.c_str());
+    fprintf(fp, "\n");
+  }
+  append_file(fp, modules.c_str());
+  append_file(fp, top.c_str());
+  fclose(fp);
+
+  if (!info->hls && !info->cpu_sim)
+    remove(header.c_str());
+  remove(modules.c_str());
+  remove(top.c_str());
+  printf("[AutoSA] Please find the generated file: %s\n", kernel.c_str());
+}
+
+/* Close all output files and generate the final kernel file.
  */
-static void hls_close_files(struct hls_info *info)
+static void hls_close_files(struct hls_info *info, const char *input)
 {
   isl_printer *p_str;
   char *complete;
@@ -207,6 +1184,16 @@ static void hls_close_files(struct hls_info *info)
   }
   fclose(info->top_gen_c);
   fclose(info->top_gen_h);
+  if (info->tb_c)
+    fclose(info->tb_c);
+  if (info->session_c)
+  {
+    fclose(info->session_c);
+    fclose(info->session_h);
+  }
+  if (info->aie_c)
+    fclose(info->aie_c);
+  hls_write_kernel(info, input);
 
   p_str = isl_printer_to_str(info->ctx);
   p_str = isl_printer_print_str(p_str, info->output_dir);
@@ -271,16 +1258,16 @@ static int *extract_data_pack_factors(int *data_pack_factors,
 
 /* Examine the local buffers of each array group. 
  * Extract the data pack factors and build the data types 
- * required by the program. 
+ * required by the program, printed to "fp".
  */
 static isl_stat print_data_types_xilinx(
-    struct autosa_hw_top_module *top, struct hls_info *hls)
+    struct autosa_hw_top_module *top, FILE *fp)
 {
   isl_printer *p;
   struct autosa_kernel *kernel;
 
   kernel = top->kernel;
-  p = isl_printer_to_file(kernel->ctx, hls->kernel_h);
+  p = isl_printer_to_file(kernel->ctx, fp);
   p = isl_printer_set_output_format(p, ISL_FORMAT_C);
   p = print_str_new_line(p, "/* Data Type */");
   for (int i = 0; i < kernel->n_array; i++)
@@ -324,32 +1311,161 @@ static isl_stat print_data_types_xilinx(
   return isl_stat_ok;
 }
 
-static __isl_give isl_printer *find_device_xilinx(__isl_take isl_printer *p)
+/* Print the code for finding the device and loading the kernel.
+ * If "n_slot" is larger than one, the host runs multiple batches with
+ * "n_slot" batches in flight, and the number of batches can be passed
+ * from the command line. An out-of-order command queue is created so that
+ * the transfers of one batch overlap the kernel execution of another one.
+ * If "n_rep" is positive, the host runs in the benchmark mode, with "n_rep"
+ * timed repetitions of the kernel after "n_warmup" warmup runs by default,
+ * and the command queue is created with profiling enabled.
+ * If "xrt" is set, the device is opened through the native XRT API instead,
+ * and the batches in flight are run on separate run handles.
+ * If "n_cu" is larger than one, a kernel object is created for each of
+ * the compute units, see print_batch_launch_xilinx.
+ */
+static __isl_give isl_printer *find_device_xilinx(__isl_take isl_printer *p,
+                                                  int n_slot, int n_rep, int n_warmup, int xrt, int n_device,
+                                                  int n_cu)
 {
-  p = print_str_new_line(p, "if (argc != 2) {");
-  p = isl_printer_indent(p, 4);
-  p = print_str_new_line(p, "std::cout << \"Usage: \" << argv[0] << \" <XCLBIN File>\" << std::endl;");
+  if (n_slot > 1)
+  {
+    p = print_str_new_line(p, "if (argc != 2 && argc != 3) {");
+    p = isl_printer_indent(p, 4);
+    p = print_str_new_line(p, "std::cout << \"Usage: \" << argv[0] << \" <XCLBIN File> [<Number of Batches>]\" << std::endl;");
+  }
+  else if (n_rep > 0)
+  {
+    p = print_str_new_line(p, "if (argc < 2 || argc > 4) {");
+    p = isl_printer_indent(p, 4);
+    p = print_str_new_line(p, "std::cout << \"Usage: \" << argv[0] << \" <XCLBIN File> [<Number of Repetitions> [<Number of Warmup Runs>]]\" << std::endl;");
+  }
+  else
+  {
+    p = print_str_new_line(p, "if (argc != 2) {");
+    p = isl_printer_indent(p, 4);
+    p = print_str_new_line(p, "std::cout << \"Usage: \" << argv[0] << \" <XCLBIN File>\" << std::endl;");
+  }
   p = print_str_new_line(p, "return EXIT_FAILURE;");
   p = isl_printer_indent(p, -4);
   p = print_str_new_line(p, "}");
   p = isl_printer_end_line(p);
+  if (n_slot > 1)
+  {
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "int n_batch = (argc == 3)? atoi(argv[2]) : ");
+    p = isl_printer_print_int(p, 2 * n_slot);
+    p = isl_printer_print_str(p, ";");
+    p = isl_printer_end_line(p);
+    p = isl_printer_end_line(p);
+  }
+  else if (n_rep > 0)
+  {
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "int n_rep = std::max((argc >= 3)? atoi(argv[2]) : ");
+    p = isl_printer_print_int(p, n_rep);
+    p = isl_printer_print_str(p, ", 1);");
+    p = isl_printer_end_line(p);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "int n_warmup = std::max((argc == 4)? atoi(argv[3]) : ");
+    p = isl_printer_print_int(p, n_warmup);
+    p = isl_printer_print_str(p, ", 0);");
+    p = isl_printer_end_line(p);
+    p = isl_printer_end_line(p);
+  }
+
+  if (xrt)
+  {
+    p = print_str_new_line(p, "// Open the device and load the XCLBIN");
+    p = print_str_new_line(p, "xrt::device device(0);");
+    p = print_str_new_line(p, "xrt::uuid uuid = device.load_xclbin(argv[1]);");
+    p = print_str_new_line(p, "xrt::kernel krnl(device, uuid, \"kernel0\");");
+    p = isl_printer_end_line(p);
+
+    return p;
+  }
+
+  if (n_device > 1)
+  {
+    p = print_str_new_line(p, "cl_int err;");
+    p = print_str_new_line(p, "std::vector<cl::Device> devices = get_devices();");
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "if (devices.size() < ");
+    p = isl_printer_print_int(p, n_device);
+    p = isl_printer_print_str(p, ") {");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, 4);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "std::cout << \"Found \" << devices.size() << \" devices, ");
+    p = isl_printer_print_int(p, n_device);
+    p = isl_printer_print_str(p, " are required\" << std::endl;");
+    p = isl_printer_end_line(p);
+    p = print_str_new_line(p, "return EXIT_FAILURE;");
+    p = isl_printer_indent(p, -4);
+    p = print_str_new_line(p, "}");
+    p = print_str_new_line(p, "// Import XCLBIN");
+    p = print_str_new_line(p, "xclbin_file_name = argv[1];");
+    p = print_str_new_line(p, "cl::Program::Binaries kernel_bins = import_binary_file();");
+    p = print_str_new_line(p, "// Create one context, command queue and kernel for each device");
+    p = print_str_new_line(p, "std::vector<cl::Context> contexts;");
+    p = print_str_new_line(p, "std::vector<cl::CommandQueue> queues;");
+    p = print_str_new_line(p, "std::vector<cl::Kernel> krnls;");
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "for (int d = 0; d < ");
+    p = isl_printer_print_int(p, n_device);
+    p = isl_printer_print_str(p, "; d++) {");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, 4);
+    p = print_str_new_line(p, "std::cout << \"Found Device=\" << devices[d].getInfo<CL_DEVICE_NAME>().c_str() << std::endl;");
+    p = print_str_new_line(p, "contexts.push_back(cl::Context(devices[d]));");
+    p = print_str_new_line(p, "queues.push_back(cl::CommandQueue(contexts[d], devices[d]));");
+    p = print_str_new_line(p, "std::vector<cl::Device> program_devices(1, devices[d]);");
+    p = print_str_new_line(p, "cl::Program program(contexts[d], program_devices, kernel_bins);");
+    p = print_str_new_line(p, "krnls.push_back(cl::Kernel(program, \"kernel0\"));");
+    p = isl_printer_indent(p, -4);
+    p = print_str_new_line(p, "}");
+    p = isl_printer_end_line(p);
+
+    return p;
+  }
+
+  p = print_str_new_line(p, "cl_int err;");
+  p = print_str_new_line(p, "std::vector<cl::Device> devices = get_devices();");
+  p = print_str_new_line(p, "cl::Device device = devices[0];");
+  p = print_str_new_line(p, "std::string device_name = device.getInfo<CL_DEVICE_NAME>();");
+  p = print_str_new_line(p, "std::cout << \"Found Device=\" << device_name.c_str() << std::endl;");
+  p = print_str_new_line(p, "// Creating Context and Command Queue for selected device");
+  p = print_str_new_line(p, "cl::Context context(device);");
+  if (n_slot > 1)
+    p = print_str_new_line(p, "cl::CommandQueue q(context, device, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE);");
+  else if (n_rep > 0)
+    p = print_str_new_line(p, "cl::CommandQueue q(context, device, CL_QUEUE_PROFILING_ENABLE);");
+  else
+    p = print_str_new_line(p, "cl::CommandQueue q(context, device);");
+  p = print_str_new_line(p, "// Import XCLBIN");
+  p = print_str_new_line(p, "xclbin_file_name = argv[1];");
+  p = print_str_new_line(p, "cl::Program::Binaries kernel_bins = import_binary_file();");
+  p = print_str_new_line(p, "// Create Program and Kernel");
+  p = print_str_new_line(p, "devices.resize(1);");
+  p = print_str_new_line(p, "cl::Program program(context, devices, kernel_bins);");
+  if (n_cu > 1)
+  {
+    p = print_str_new_line(p, "// Create a kernel object for each compute unit");
+    p = print_str_new_line(p, "std::vector<cl::Kernel> krnls;");
+    for (int c = 0; c < n_cu; c++)
+    {
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "krnls.push_back(cl::Kernel(program, \"kernel0:{kernel0_");
+      p = isl_printer_print_int(p, c + 1);
+      p = isl_printer_print_str(p, "}\"));");
+      p = isl_printer_end_line(p);
+    }
+  }
+  else
+  {
+    p = print_str_new_line(p, "cl::Kernel krnl(program, \"kernel0\");");
+  }
 
-  p = print_str_new_line(p, "cl_int err;");
-  p = print_str_new_line(p, "std::vector<cl::Device> devices = get_devices();");
-  p = print_str_new_line(p, "cl::Device device = devices[0];");
-  p = print_str_new_line(p, "std::string device_name = device.getInfo<CL_DEVICE_NAME>();");
-  p = print_str_new_line(p, "std::cout << \"Found Device=\" << device_name.c_str() << std::endl;");
-  p = print_str_new_line(p, "// Creating Context and Command Queue for selected device");
-  p = print_str_new_line(p, "cl::Context context(device);");
-  p = print_str_new_line(p, "cl::CommandQueue q(context, device);");
-  p = print_str_new_line(p, "// Import XCLBIN");
-  p = print_str_new_line(p, "xclbin_file_name = argv[1];");
-  p = print_str_new_line(p, "cl::Program::Binaries kernel_bins = import_binary_file();");
-  p = print_str_new_line(p, "// Create Program and Kernel");
-  p = print_str_new_line(p, "devices.resize(1);");
-  p = print_str_new_line(p, "cl::Program program(context, devices, kernel_bins);");
-  p = print_str_new_line(p, "cl::Kernel krnl(program, \"kernel0\");");
-
   //  p = print_str_new_line(p, "std::string binaryFile = argv[1];");
   //  p = print_str_new_line(p, "cl_int err;");
   //  p = print_str_new_line(p, "cl::Context context;");
@@ -399,83 +1515,167 @@ static __isl_give isl_printer *find_device_xilinx(__isl_take isl_printer *p)
   return p;
 }
 
-static __isl_give isl_printer *declare_and_allocate_device_arrays_xilinx(
-    __isl_take isl_printer *p, struct autosa_prog *prog, struct autosa_kernel *kernel)
+/* Is the host buffer of "local_array" bound to the host array directly?
+ * This is the case if "zero_copy" is set and the array doesn't use
+ * multiple host buffers and is not serialized.
+ */
+static int host_array_is_zero_copy(struct autosa_local_array_info *local_array,
+                                   int zero_copy)
 {
-  p = print_str_new_line(p, "// Allocate memory in host memory");
+  return zero_copy && !local_array->host_serialize &&
+         !(local_array->n_mem_ports > 1 && local_array->array->copy_out);
+}
+
+/* Print the name of the host function that serializes "array" into
+ * the DRAM access order if it is read by the kernel, or deserializes it
+ * if it is written by the kernel.
+ */
+static __isl_give isl_printer *print_host_serialize_func_name(
+    __isl_take isl_printer *p, struct autosa_array_info *array)
+{
+  p = isl_printer_print_str(p, array->copy_in ? "host_serialize_" :
+                                                "host_deserialize_");
+  p = isl_printer_print_str(p, array->name);
+
+  return p;
+}
+
+/* Return the position of the kernel argument bound to the memory port
+ * "port" of "local_array", in the order of print_set_kernel_arguments_xilinx,
+ * or -1 if the port is not bound to any argument.
+ */
+static int xrt_kernel_arg_pos(struct autosa_kernel *kernel,
+                              struct autosa_local_array_info *local_array, int port)
+{
+  int n_arg = 0;
+
+  for (int i = 0; i < kernel->n_array; ++i)
+  {
+    struct autosa_local_array_info *cur = &kernel->array[i];
+    if (!autosa_kernel_requires_array_argument(kernel, i))
+      continue;
+    if (autosa_array_is_scalar(cur->array))
+    {
+      n_arg++;
+      continue;
+    }
+    for (int j = 0; j < cur->n_io_group_refs; j++)
+    {
+      if (cur == local_array && cur->group_ref_mem_port_map[j].second == port)
+        return n_arg;
+      n_arg++;
+    }
+  }
+
+  return -1;
+}
+
+/* Print the size in bytes of the host buffer of "local_array".
+ */
+static __isl_give isl_printer *print_host_buffer_size_xilinx(
+    __isl_take isl_printer *p, struct autosa_local_array_info *local_array)
+{
+  if (!local_array->host_serialize)
+    return autosa_array_info_print_size(p, local_array->array);
+
+  p = isl_printer_print_str(p, "sizeof(");
+  p = isl_printer_print_str(p, local_array->array->type);
+  p = isl_printer_print_str(p, ") * dev_");
+  p = isl_printer_print_str(p, local_array->array->name);
+  p = isl_printer_print_str(p, "_serialize.size()");
+
+  return p;
+}
+
+/* Print the code copying the host buffers of "local_array" to the buffer
+ * objects of the XRT host if "in" is set, or back otherwise.
+ * The buffer objects are synchronized on the range of the host buffer only.
+ * If "batch" is set, the buffers of the batch in "slot" are used.
+ */
+static __isl_give isl_printer *print_xrt_sync(__isl_take isl_printer *p,
+                                              struct autosa_local_array_info *local_array, int in, int batch,
+                                              int zero_copy)
+{
+  const char *name = local_array->array->name;
+  const char *bo = batch ? "[slot][i]" : "[i]";
+
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "for (int i = 0; i < ");
+  p = isl_printer_print_int(p, local_array->n_mem_ports);
+  p = isl_printer_print_str(p, "; i++) {");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, 4);
+
+  for (int k = 0; k < 2; k++)
+  {
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "buffer_");
+    p = isl_printer_print_str(p, name);
+    p = isl_printer_print_str(p, bo);
+    if (in == (k == 1))
+    {
+      p = isl_printer_print_str(p, in ? ".sync(XCL_BO_SYNC_BO_TO_DEVICE, " :
+                                        ".sync(XCL_BO_SYNC_BO_FROM_DEVICE, ");
+      p = print_host_buffer_size_xilinx(p, local_array);
+      p = isl_printer_print_str(p, ", 0);");
+    }
+    else
+    {
+      p = isl_printer_print_str(p, in ? ".write(dev_" : ".read(dev_");
+      p = isl_printer_print_str(p, name);
+      if (local_array->host_serialize)
+        p = isl_printer_print_str(p, "_serialize");
+      if (batch && local_array->array->copy_out)
+        p = isl_printer_print_str(p, "_slot[slot]");
+      if (local_array->n_mem_ports > 1 && local_array->array->copy_out)
+        p = isl_printer_print_str(p, "[i]");
+      if (!host_array_is_zero_copy(local_array, zero_copy))
+        p = isl_printer_print_str(p, ".data()");
+      p = isl_printer_print_str(p, ", ");
+      p = print_host_buffer_size_xilinx(p, local_array);
+      p = isl_printer_print_str(p, ", 0);");
+    }
+    p = isl_printer_end_line(p);
+  }
+
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "}");
+
+  return p;
+}
+
+/* Print the code allocating the buffer objects of the XRT host in the
+ * memory banks of the kernel arguments they are bound to.
+ * If "n_slot" is larger than one, "n_slot" sets of buffer objects are
+ * allocated, one for each batch in flight.
+ */
+static __isl_give isl_printer *allocate_device_buffers_xrt(
+    __isl_take isl_printer *p, struct autosa_kernel *kernel, int n_slot)
+{
+  p = print_str_new_line(p, "// Allocate buffer objects in device memory");
   for (int i = 0; i < kernel->n_array; i++)
   {
     struct autosa_local_array_info *local_array = &kernel->array[i];
     if (!autosa_array_requires_device_allocation(local_array->array))
       continue;
 
-    if (local_array->n_mem_ports > 1 && local_array->array->copy_out)
+    p = isl_printer_start_line(p);
+    if (n_slot > 1)
     {
-      /* Create multiple host buffers. */
-      p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "std::vector<std::vector<");
-      p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, ", aligned_allocator<");
-      p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, ">>> ");
-      p = isl_printer_print_str(p, "dev_");
-      p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, ";");
-      p = isl_printer_end_line(p);
-
-      p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "for (int i = 0; i < ");
-      p = isl_printer_print_int(p, local_array->n_mem_ports);
-      p = isl_printer_print_str(p, "; i++) {");
-      p = isl_printer_end_line(p);
-      p = isl_printer_indent(p, 4);
-
-      p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "std::vector<");
-      p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, ", aligned_allocator<");
-      p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, ">> ");
-      p = isl_printer_print_str(p, "dev_");
+      p = isl_printer_print_str(p, "std::vector<std::vector<xrt::bo>> buffer_");
       p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, "_tmp");
       p = isl_printer_print_str(p, "(");
-      p = autosa_array_info_print_data_size(p, local_array->array);
+      p = isl_printer_print_int(p, n_slot);
       p = isl_printer_print_str(p, ");");
-      p = isl_printer_end_line(p);
-
-      p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "dev_");
-      p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, ".push_back(dev_");
-      p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, "_tmp);");
-      p = isl_printer_end_line(p);
-
-      p = isl_printer_indent(p, -4);
-      p = print_str_new_line(p, "}");
     }
     else
     {
-      /* Create a single host buffer. */
-      p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "std::vector<");
-      p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, ", aligned_allocator<");
-      p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, ">> ");
-      p = isl_printer_print_str(p, "dev_");
+      p = isl_printer_print_str(p, "std::vector<xrt::bo> buffer_");
       p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, "(");
-      p = autosa_array_info_print_data_size(p, local_array->array);
-      p = isl_printer_print_str(p, ");");
-      p = isl_printer_end_line(p);
+      p = isl_printer_print_str(p, ";");
     }
+    p = isl_printer_end_line(p);
   }
-  p = isl_printer_end_line(p);
-
-  /* Initialize buffer. */
-  p = print_str_new_line(p, "// Initialize host buffers");
 
   for (int i = 0; i < kernel->n_array; i++)
   {
@@ -483,156 +1683,320 @@ static __isl_give isl_printer *declare_and_allocate_device_arrays_xilinx(
     if (!autosa_array_requires_device_allocation(local_array->array))
       continue;
 
-    if (local_array->n_mem_ports > 1 && local_array->array->copy_out)
+    if (n_slot > 1)
     {
       p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "for (int i = 0; i < ");
-      p = isl_printer_print_int(p, local_array->n_mem_ports);
-      p = isl_printer_print_str(p, "; i++) {");
+      p = isl_printer_print_str(p, "for (int s = 0; s < ");
+      p = isl_printer_print_int(p, n_slot);
+      p = isl_printer_print_str(p, "; s++) {");
       p = isl_printer_end_line(p);
       p = isl_printer_indent(p, 4);
+    }
+    for (int j = 0; j < local_array->n_mem_ports; j++)
+    {
+      int pos = xrt_kernel_arg_pos(kernel, local_array, j);
+      if (pos < 0)
+        return isl_printer_free(p);
 
       p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "std::copy(reinterpret_cast<");
-      p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, " *>(");
-      p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, "), reinterpret_cast<");
-      p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, " *>(");
-      p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, ") + ");
-      p = autosa_array_info_print_data_size(p, local_array->array);
-      p = isl_printer_print_str(p, ", dev_");
+      p = isl_printer_print_str(p, "buffer_");
       p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, "[i]");
-      p = isl_printer_print_str(p, ".begin());");
+      if (n_slot > 1)
+        p = isl_printer_print_str(p, "[s]");
+      p = isl_printer_print_str(p, ".push_back(xrt::bo(device, ");
+      p = print_host_buffer_size_xilinx(p, local_array);
+      p = isl_printer_print_str(p, ", krnl.group_id(");
+      p = isl_printer_print_int(p, pos);
+      p = isl_printer_print_str(p, ")));");
       p = isl_printer_end_line(p);
-
-      p = isl_printer_indent(p, -4);
-      p = print_str_new_line(p, "}");
     }
-    else
+    if (n_slot > 1)
     {
-      p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "std::copy(reinterpret_cast<");
-      p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, " *>(");
-      p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, "), reinterpret_cast<");
-      p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, " *>(");
-      p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, ") + ");
-      p = autosa_array_info_print_data_size(p, local_array->array);
-      p = isl_printer_print_str(p, ", dev_");
-      p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, ".begin());");
-      p = isl_printer_end_line(p);
+      p = isl_printer_indent(p, -4);
+      p = print_str_new_line(p, "}");
     }
   }
   p = isl_printer_end_line(p);
 
-  p = print_str_new_line(p, "// Allocate buffers in device memory");
-  p = print_str_new_line(p, "// Buffers are allocated using CL_MEM_USE_HOST_PTR for efficient memory and");
-  p = print_str_new_line(p, "// device-to-host communication");
-  for (int i = 0; i < kernel->n_array; i++)
+  return p;
+}
+
+/* Insert profiling information.
+ */
+static __isl_give isl_printer *print_host_timers_xilinx(__isl_take isl_printer *p)
+{
+  p = print_str_new_line(p, "auto host_begin = std::chrono::high_resolution_clock::now();");
+  p = print_str_new_line(p, "auto fpga_begin = std::chrono::high_resolution_clock::now();");
+  p = print_str_new_line(p, "auto fpga_end = std::chrono::high_resolution_clock::now();");
+  p = isl_printer_end_line(p);
+
+  return p;
+}
+
+/* Does "local_array" get one host buffer per device or per batch in flight?
+ * With "n_slot" batches in flight, this is the case for the arrays that
+ * are written by the kernel. With "n_device" devices, this is also the case
+ * for the arrays that are partitioned across the devices.
+ */
+static int host_array_has_slots(struct autosa_local_array_info *local_array,
+                                int n_slot, int n_device)
+{
+  if (n_device > 1)
+    return local_array->array->copy_out || local_array->device_stride > 0;
+  return n_slot > 1 && local_array->array->copy_out;
+}
+
+/* Print the product of the bounds of the dimensions "first" to "last" - 1
+ * of "array", or 1 if there is no such dimension.
+ */
+static __isl_give isl_printer *print_array_bound_product(
+    __isl_take isl_printer *p, struct autosa_array_info *array,
+    int first, int last)
+{
+  if (first >= last)
+    return isl_printer_print_str(p, "1");
+
+  for (int i = first; i < last; i++)
   {
-    struct autosa_local_array_info *local_array = &kernel->array[i];
-    if (!autosa_array_requires_device_allocation(local_array->array))
-      continue;
+    isl_ast_expr *bound;
 
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "std::vector<cl::Buffer> buffer_");
-    p = isl_printer_print_str(p, local_array->array->name);
-    p = isl_printer_print_str(p, ";");
-    p = isl_printer_end_line(p);
+    if (i > first)
+      p = isl_printer_print_str(p, " * ");
+    p = isl_printer_print_str(p, "(");
+    bound = isl_ast_expr_get_op_arg(array->bound_expr, 1 + i);
+    p = isl_printer_print_ast_expr(p, bound);
+    isl_ast_expr_free(bound);
+    p = isl_printer_print_str(p, ")");
   }
 
-  for (int i = 0; i < kernel->n_array; i++)
-  {
-    int indent1, indent2;
-    struct autosa_local_array_info *local_array = &kernel->array[i];
-    if (!autosa_array_requires_device_allocation(local_array->array))
-      continue;
+  return p;
+}
 
-    //for (int j = 0; j < local_array->n_mem_ports; j++) {
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "for (int i = 0; i < ");
-    p = isl_printer_print_int(p, local_array->n_mem_ports);
-    p = isl_printer_print_str(p, "; i++) {");
-    p = isl_printer_end_line(p);
-    p = isl_printer_indent(p, 4);
+/* Print the code copying the rows "first" to "last" of the dimension of
+ * "local_array" partitioned across the devices from the host buffer "src"
+ * to the rows shifted by "shift" in the host buffer "dst".
+ * "first", "last" and "shift" are expressions, and "shift" includes its
+ * sign. The elements of each row are contiguous in the inner dimensions.
+ */
+static __isl_give isl_printer *print_device_rows_copy_xilinx(
+    __isl_take isl_printer *p, struct autosa_local_array_info *local_array,
+    const char *src, const char *dst, const char *first, const char *last,
+    const char *shift)
+{
+  struct autosa_array_info *array = local_array->array;
+  int dim = local_array->device_dim;
+
+  p = print_str_new_line(p, "{");
+  p = isl_printer_indent(p, 4);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "int outer = ");
+  p = print_array_bound_product(p, array, 0, dim);
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "int rows = ");
+  p = print_array_bound_product(p, array, dim, dim + 1);
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "int inner = ");
+  p = print_array_bound_product(p, array, dim + 1, array->n_index);
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
+
+  p = print_str_new_line(p, "for (int o = 0; o < outer; o++)");
+  p = isl_printer_indent(p, 4);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "for (int r = ");
+  p = isl_printer_print_str(p, first);
+  p = isl_printer_print_str(p, "; r <= ");
+  p = isl_printer_print_str(p, last);
+  p = isl_printer_print_str(p, "; r++)");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, 4);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "std::copy(");
+  p = isl_printer_print_str(p, src);
+  p = isl_printer_print_str(p, ".begin() + (o * rows + r) * inner, ");
+  p = isl_printer_print_str(p, src);
+  p = isl_printer_print_str(p, ".begin() + (o * rows + r + 1) * inner, ");
+  p = isl_printer_print_str(p, dst);
+  p = isl_printer_print_str(p, ".begin() + (o * rows + r");
+  p = isl_printer_print_str(p, shift);
+  p = isl_printer_print_str(p, ") * inner);");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, -8);
+
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "}");
+
+  return p;
+}
+
+/* Print the code initializing the host buffers of the devices other than
+ * the first one, for "n_device" devices.
+ * The devices compute their slices of the array partitions in the
+ * coordinates of the first device:
+ * - the arrays partitioned across the devices are shifted by the rows of
+ *   the preceding devices,
+ * - the partial sums of the arrays reduced across the devices start from
+ *   zero, such that the initial values are only accumulated by the first
+ *   device.
+ */
+static __isl_give isl_printer *print_multi_device_host_buffers_xilinx(
+    __isl_take isl_printer *p, struct autosa_kernel *kernel, int n_device)
+{
+  p = print_str_new_line(p, "// Initialize the host buffers of the other devices");
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    const char *name = local_array->array->name;
+    int multi_port = local_array->n_mem_ports > 1 && local_array->array->copy_out;
+    std::string src, dst, first, shift;
+
+    if (!autosa_array_requires_device_allocation(local_array->array))
+      continue;
+    if (!local_array->array->copy_in)
+      continue;
+    if (local_array->device_stride == 0 && !local_array->array->copy_out)
+      continue;
 
-    p = print_str_new_line(p, "OCL_CHECK(err,");
-    indent1 = strlen("OCL_CHECK(");
-    p = isl_printer_indent(p, indent1);
     p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "cl::Buffer buffer_");
-    p = isl_printer_print_str(p, local_array->array->name);
-    p = isl_printer_print_str(p, "_tmp");
-    p = isl_printer_print_str(p, "(context,");
+    p = isl_printer_print_str(p, "for (int d = 1; d < ");
+    p = isl_printer_print_int(p, n_device);
+    p = isl_printer_print_str(p, "; d++) {");
     p = isl_printer_end_line(p);
-    p = isl_printer_indent(p, strlen("cl::Buffer buffer_") +
-                                  strlen(local_array->array->name) + strlen("_tmp") + 1);
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "CL_MEM_USE_HOST_PTR | ");
-    if (local_array->array->copy_in && local_array->array->copy_out)
+    p = isl_printer_indent(p, 4);
+    if (multi_port)
     {
-      p = isl_printer_print_str(p, "CL_MEM_READ_WRITE");
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "for (int i = 0; i < ");
+      p = isl_printer_print_int(p, local_array->n_mem_ports);
+      p = isl_printer_print_str(p, "; i++)");
+      p = isl_printer_end_line(p);
+      p = isl_printer_indent(p, 4);
     }
-    else
+
+    src = std::string("dev_") + name + (multi_port ? "[i]" : "");
+    dst = std::string("dev_") + name + "_slot[d]" + (multi_port ? "[i]" : "");
+    if (local_array->device_stride > 0)
     {
-      if (local_array->array->copy_in)
-        p = isl_printer_print_str(p, "CL_MEM_READ_ONLY");
-      else if (local_array->array->copy_out)
-        p = isl_printer_print_str(p, "CL_MEM_WRITE_ONLY");
+      first = "d * " + std::to_string(local_array->device_stride);
+      shift = " - d * " + std::to_string(local_array->device_stride);
+      p = print_device_rows_copy_xilinx(p, local_array, src.c_str(),
+                                        dst.c_str(), first.c_str(), "rows - 1", shift.c_str());
     }
-    p = isl_printer_print_str(p, ",");
-    p = isl_printer_end_line(p);
-    p = isl_printer_start_line(p);
-    p = autosa_array_info_print_size(p, local_array->array);
-    p = isl_printer_print_str(p, ",");
-    p = isl_printer_end_line(p);
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "dev_");
-    p = isl_printer_print_str(p, local_array->array->name);
-    if (local_array->n_mem_ports > 1 && local_array->array->copy_out)
+    else
     {
-      p = isl_printer_print_str(p, "[i]");
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "std::fill(");
+      p = isl_printer_print_str(p, dst.c_str());
+      p = isl_printer_print_str(p, ".begin(), ");
+      p = isl_printer_print_str(p, dst.c_str());
+      p = isl_printer_print_str(p, ".end(), 0);");
+      p = isl_printer_end_line(p);
     }
-    p = isl_printer_print_str(p, ".data(),");
-    p = isl_printer_end_line(p);
-    p = print_str_new_line(p, "&err));");
-    p = isl_printer_indent(p, -(strlen("cl::Buffer buffer_") +
-                                strlen(local_array->array->name) + strlen("_tmp") + 1));
-    p = isl_printer_indent(p, -indent1);
-
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "buffer_");
-    p = isl_printer_print_str(p, local_array->array->name);
-    p = isl_printer_print_str(p, ".push_back(std::move(buffer_");
-    p = isl_printer_print_str(p, local_array->array->name);
-    p = isl_printer_print_str(p, "_tmp));");
-    p = isl_printer_end_line(p);
 
+    if (multi_port)
+      p = isl_printer_indent(p, -4);
     p = isl_printer_indent(p, -4);
     p = print_str_new_line(p, "}");
   }
   p = isl_printer_end_line(p);
 
-  /* Insert profiling information. */
-  p = print_str_new_line(p, "auto host_begin = std::chrono::high_resolution_clock::now();");
-  p = print_str_new_line(p, "auto fpga_begin = std::chrono::high_resolution_clock::now();");
-  p = print_str_new_line(p, "auto fpga_end = std::chrono::high_resolution_clock::now();");
-  p = isl_printer_end_line(p);
+  return p;
+}
+
+/* Print the code merging the outputs of the device "slot" into the host
+ * buffers of the written arrays, for "n_device" devices.
+ * If "multi_port" is set, the arrays written through multiple memory ports
+ * are merged, from the host buffer of their first port, after the outputs
+ * of the ports are merged (see drain_merge_xilinx).
+ * Otherwise, the other written arrays are merged.
+ * The partitions written by the device are copied to their rows in the
+ * arrays partitioned across the devices, and the partial sums of the device
+ * are added to the arrays reduced across the devices.
+ */
+static __isl_give isl_printer *print_multi_device_merge_xilinx(
+    __isl_take isl_printer *p, struct autosa_kernel *kernel, int multi_port)
+{
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    const char *name = local_array->array->name;
+    std::string src, dst, first, last, shift;
+
+    if (!autosa_array_requires_device_allocation(local_array->array))
+      continue;
+    if (!local_array->array->copy_out)
+      continue;
+    if ((local_array->n_mem_ports > 1) != (multi_port != 0))
+      continue;
+
+    src = std::string("dev_") + name + "_slot[slot]" + (multi_port ? "[0]" : "");
+    dst = std::string("dev_") + name + (multi_port ? "[0]" : "");
+    if (local_array->device_stride > 0)
+    {
+      first = std::to_string(local_array->device_lo);
+      last = std::to_string(local_array->device_hi);
+      shift = " + slot * " + std::to_string(local_array->device_stride);
+      p = print_device_rows_copy_xilinx(p, local_array, src.c_str(),
+                                        dst.c_str(), first.c_str(), last.c_str(), shift.c_str());
+      continue;
+    }
+
+    p = print_str_new_line(p, "if (slot == 0)");
+    p = isl_printer_indent(p, 4);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, dst.c_str());
+    p = isl_printer_print_str(p, " = ");
+    p = isl_printer_print_str(p, src.c_str());
+    p = isl_printer_print_str(p, ";");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, -4);
+    p = print_str_new_line(p, "else");
+    p = isl_printer_indent(p, 4);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "for (size_t e = 0; e < ");
+    p = isl_printer_print_str(p, dst.c_str());
+    p = isl_printer_print_str(p, ".size(); e++)");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, 4);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, dst.c_str());
+    p = isl_printer_print_str(p, "[e] += ");
+    p = isl_printer_print_str(p, src.c_str());
+    p = isl_printer_print_str(p, "[e];");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, -8);
+  }
 
   return p;
 }
 
-static __isl_give isl_printer *declare_and_allocate_cpu_arrays_xilinx(
-    __isl_take isl_printer *p, struct autosa_prog *prog, struct autosa_kernel *kernel)
+/* Print the code for allocating the host and device buffers.
+ * If "n_slot" is larger than one, "n_slot" sets of device buffers are
+ * allocated, one for each batch in flight. The batches share the host
+ * buffers of the arrays that are only read by the kernel, while each batch
+ * gets its own copy "dev_<array>_slot" of the host buffers of the arrays
+ * that are written by the kernel.
+ * If "zero_copy" is set, the device buffers are bound to the host arrays
+ * directly if they are 4 KiB-aligned, and to an aligned copy only
+ * otherwise. The host arrays that are only written by the kernel are not
+ * copied in this case.
+ * If "xrt" is set, the device buffers are XRT buffer objects, which are
+ * copied from and to the host buffers.
+ * If "n_device" is larger than one, one set of device buffers is allocated
+ * in the context of each device, and each device gets its own copy
+ * "dev_<array>_slot" of the host buffers of the arrays that are written
+ * by the kernel or partitioned across the devices.
+ */
+static __isl_give isl_printer *declare_and_allocate_device_arrays_xilinx(
+    __isl_take isl_printer *p, struct autosa_prog *prog, struct autosa_kernel *kernel,
+    int n_slot, int zero_copy, int xrt, int n_device)
 {
+  int n_buf = n_device > 1 ? n_device : n_slot;
+
   p = print_str_new_line(p, "// Allocate memory in host memory");
   for (int i = 0; i < kernel->n_array; i++)
   {
@@ -644,9 +2008,11 @@ static __isl_give isl_printer *declare_and_allocate_cpu_arrays_xilinx(
     {
       /* Create multiple host buffers. */
       p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "std::vector<");
+      p = isl_printer_print_str(p, "std::vector<std::vector<");
       p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, " *> ");
+      p = isl_printer_print_str(p, ", aligned_allocator<");
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, ">>> ");
       p = isl_printer_print_str(p, "dev_");
       p = isl_printer_print_str(p, local_array->array->name);
       p = isl_printer_print_str(p, ";");
@@ -660,17 +2026,17 @@ static __isl_give isl_printer *declare_and_allocate_cpu_arrays_xilinx(
       p = isl_printer_indent(p, 4);
 
       p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "std::vector<");
       p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, " *dev_");
+      p = isl_printer_print_str(p, ", aligned_allocator<");
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, ">> ");
+      p = isl_printer_print_str(p, "dev_");
       p = isl_printer_print_str(p, local_array->array->name);
       p = isl_printer_print_str(p, "_tmp");
-      p = isl_printer_print_str(p, " = (");
-      p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, " *)malloc(");
+      p = isl_printer_print_str(p, "(");
       p = autosa_array_info_print_data_size(p, local_array->array);
-      p = isl_printer_print_str(p, " * sizeof(");
-      p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, "));");
+      p = isl_printer_print_str(p, ");");
       p = isl_printer_end_line(p);
 
       p = isl_printer_start_line(p);
@@ -684,41 +2050,131 @@ static __isl_give isl_printer *declare_and_allocate_cpu_arrays_xilinx(
       p = isl_printer_indent(p, -4);
       p = print_str_new_line(p, "}");
     }
+    else if (host_array_is_zero_copy(local_array, zero_copy))
+    {
+      /* Use the host array if it is aligned. */
+      const char *type = local_array->array->type;
+      const char *name = local_array->array->name;
+
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "std::vector<");
+      p = isl_printer_print_str(p, type);
+      p = isl_printer_print_str(p, ", aligned_allocator<");
+      p = isl_printer_print_str(p, type);
+      p = isl_printer_print_str(p, ">> dev_");
+      p = isl_printer_print_str(p, name);
+      p = isl_printer_print_str(p, "_aligned;");
+      p = isl_printer_end_line(p);
+
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, type);
+      p = isl_printer_print_str(p, " *dev_");
+      p = isl_printer_print_str(p, name);
+      p = isl_printer_print_str(p, " = reinterpret_cast<");
+      p = isl_printer_print_str(p, type);
+      p = isl_printer_print_str(p, " *>(");
+      p = isl_printer_print_str(p, name);
+      p = isl_printer_print_str(p, ");");
+      p = isl_printer_end_line(p);
+
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "if (reinterpret_cast<size_t>(dev_");
+      p = isl_printer_print_str(p, name);
+      p = isl_printer_print_str(p, ") % 4096 != 0) {");
+      p = isl_printer_end_line(p);
+      p = isl_printer_indent(p, 4);
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "dev_");
+      p = isl_printer_print_str(p, name);
+      p = isl_printer_print_str(p, "_aligned.resize(");
+      p = autosa_array_info_print_data_size(p, local_array->array);
+      p = isl_printer_print_str(p, ");");
+      p = isl_printer_end_line(p);
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "dev_");
+      p = isl_printer_print_str(p, name);
+      p = isl_printer_print_str(p, " = dev_");
+      p = isl_printer_print_str(p, name);
+      p = isl_printer_print_str(p, "_aligned.data();");
+      p = isl_printer_end_line(p);
+      p = isl_printer_indent(p, -4);
+      p = print_str_new_line(p, "}");
+    }
     else
     {
       /* Create a single host buffer. */
       p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "std::vector<");
       p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, " *dev_");
-      p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, " = (");
+      p = isl_printer_print_str(p, ", aligned_allocator<");
       p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, " *)malloc(");
+      p = isl_printer_print_str(p, ">> ");
+      p = isl_printer_print_str(p, "dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, "(");
       p = autosa_array_info_print_data_size(p, local_array->array);
-      p = isl_printer_print_str(p, " * sizeof(");
+      p = isl_printer_print_str(p, ");");
+      p = isl_printer_end_line(p);
+    }
+
+    if (local_array->host_serialize)
+    {
+      /* Create the host buffer in the DRAM access order. */
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "std::vector<");
       p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, "));");
+      p = isl_printer_print_str(p, ", aligned_allocator<");
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, ">> dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, "_serialize(");
+      p = print_host_serialize_func_name(p, local_array->array);
+      p = isl_printer_print_str(p, "(NULL, NULL));");
       p = isl_printer_end_line(p);
     }
-    //    p = isl_printer_print_str(p, " = (");
-    //    p = autosa_print_array_type(p, array);
-    //    p = isl_printer_print_str(p, " *)malloc(");
-    //    p = autosa_array_info_print_data_size(p, array);
-    //    p = isl_printer_print_str(p, " * sizeof(");
-    //    p = isl_printer_print_str(p, array->type);
-    //    p = isl_printer_print_str(p, "));");
-    //    p = isl_printer_end_line(p);
   }
   p = isl_printer_end_line(p);
 
   /* Initialize buffer. */
   p = print_str_new_line(p, "// Initialize host buffers");
+
   for (int i = 0; i < kernel->n_array; i++)
   {
     struct autosa_local_array_info *local_array = &kernel->array[i];
     if (!autosa_array_requires_device_allocation(local_array->array))
       continue;
 
+    if (host_array_is_zero_copy(local_array, zero_copy))
+    {
+      /* Copy the host array only if it is misaligned and read. */
+      if (!local_array->array->copy_in)
+        continue;
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "if (!dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, "_aligned.empty())");
+      p = isl_printer_end_line(p);
+      p = isl_printer_indent(p, 4);
+      p = isl_printer_start_line(p);
+      p = print_host_copy_start(p, kernel);
+      p = isl_printer_print_str(p, "reinterpret_cast<");
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, " *>(");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, "), reinterpret_cast<");
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, " *>(");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, ") + ");
+      p = autosa_array_info_print_data_size(p, local_array->array);
+      p = isl_printer_print_str(p, ", dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, ");");
+      p = isl_printer_end_line(p);
+      p = isl_printer_indent(p, -4);
+      continue;
+    }
+
     if (local_array->n_mem_ports > 1 && local_array->array->copy_out)
     {
       p = isl_printer_start_line(p);
@@ -729,16 +2185,21 @@ static __isl_give isl_printer *declare_and_allocate_cpu_arrays_xilinx(
       p = isl_printer_indent(p, 4);
 
       p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "memcpy(dev_");
+      p = print_host_copy_start(p, kernel);
+      p = isl_printer_print_str(p, "reinterpret_cast<");
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, " *>(");
       p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, "[i]");
-      p = isl_printer_print_str(p, ", ");
+      p = isl_printer_print_str(p, "), reinterpret_cast<");
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, " *>(");
       p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, ", ");
+      p = isl_printer_print_str(p, ") + ");
       p = autosa_array_info_print_data_size(p, local_array->array);
-      p = isl_printer_print_str(p, " * sizeof(");
-      p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, "));");
+      p = isl_printer_print_str(p, ", dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, "[i]");
+      p = isl_printer_print_str(p, ".begin());");
       p = isl_printer_end_line(p);
 
       p = isl_printer_indent(p, -4);
@@ -747,33 +2208,109 @@ static __isl_give isl_printer *declare_and_allocate_cpu_arrays_xilinx(
     else
     {
       p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "memcpy(dev_");
+      p = print_host_copy_start(p, kernel);
+      p = isl_printer_print_str(p, "reinterpret_cast<");
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, " *>(");
       p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, ", ");
+      p = isl_printer_print_str(p, "), reinterpret_cast<");
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, " *>(");
       p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, ", ");
+      p = isl_printer_print_str(p, ") + ");
       p = autosa_array_info_print_data_size(p, local_array->array);
-      p = isl_printer_print_str(p, " * sizeof(");
-      p = isl_printer_print_str(p, local_array->array->type);
-      p = isl_printer_print_str(p, "));");
+      p = isl_printer_print_str(p, ", dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, ".begin());");
+      p = isl_printer_end_line(p);
+    }
+
+    if (local_array->host_serialize && local_array->array->copy_in)
+    {
+      /* The compressed array is shrunk to its non-zero blocks. */
+      p = isl_printer_start_line(p);
+      if (local_array->host_sparse_block > 0)
+      {
+        p = isl_printer_print_str(p, "dev_");
+        p = isl_printer_print_str(p, local_array->array->name);
+        p = isl_printer_print_str(p, "_serialize.resize(");
+      }
+      p = print_host_serialize_func_name(p, local_array->array);
+      p = isl_printer_print_str(p, "(dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, "_serialize.data(), dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, ".data())");
+      if (local_array->host_sparse_block > 0)
+        p = isl_printer_print_str(p, ")");
+      p = isl_printer_print_str(p, ";");
       p = isl_printer_end_line(p);
     }
   }
   p = isl_printer_end_line(p);
 
+  if (n_buf > 1)
+  {
+    if (n_device > 1)
+      p = print_str_new_line(p, "// Allocate host buffers for the devices");
+    else
+      p = print_str_new_line(p, "// Allocate host buffers for the outputs of the batches in flight");
+    for (int i = 0; i < kernel->n_array; i++)
+    {
+      struct autosa_local_array_info *local_array = &kernel->array[i];
+      if (!autosa_array_requires_device_allocation(local_array->array))
+        continue;
+      if (!host_array_has_slots(local_array, n_slot, n_device))
+        continue;
+
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "std::vector<decltype(dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, ")> dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, "_slot(");
+      p = isl_printer_print_int(p, n_buf);
+      p = isl_printer_print_str(p, ", dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, ");");
+      p = isl_printer_end_line(p);
+    }
+    p = isl_printer_end_line(p);
+  }
+  if (n_device > 1)
+    p = print_multi_device_host_buffers_xilinx(p, kernel, n_device);
+
+  if (xrt)
+  {
+    p = allocate_device_buffers_xrt(p, kernel, n_slot);
+    return print_host_timers_xilinx(p);
+  }
+
   p = print_str_new_line(p, "// Allocate buffers in device memory");
+  p = print_str_new_line(p, "// Buffers are allocated using CL_MEM_USE_HOST_PTR for efficient memory and");
+  p = print_str_new_line(p, "// device-to-host communication");
   for (int i = 0; i < kernel->n_array; i++)
   {
     struct autosa_local_array_info *local_array = &kernel->array[i];
-    if (!autosa_array_requires_device_allocation(local_array->array))
+    if (!autosa_array_requires_device_allocation(local_array->array) ||
+        local_array->host_stream)
       continue;
 
     p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "std::vector<");
-    p = autosa_print_array_type(p, local_array->array);
-    p = isl_printer_print_str(p, " *> buffer_");
-    p = isl_printer_print_str(p, local_array->array->name);
-    p = isl_printer_print_str(p, ";");
+    if (n_buf > 1)
+    {
+      p = isl_printer_print_str(p, "std::vector<std::vector<cl::Buffer>> buffer_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, "(");
+      p = isl_printer_print_int(p, n_buf);
+      p = isl_printer_print_str(p, ");");
+    }
+    else
+    {
+      p = isl_printer_print_str(p, "std::vector<cl::Buffer> buffer_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, ";");
+    }
     p = isl_printer_end_line(p);
   }
 
@@ -781,9 +2318,21 @@ static __isl_give isl_printer *declare_and_allocate_cpu_arrays_xilinx(
   {
     int indent1, indent2;
     struct autosa_local_array_info *local_array = &kernel->array[i];
-    if (!autosa_array_requires_device_allocation(local_array->array))
+    if (!autosa_array_requires_device_allocation(local_array->array) ||
+        local_array->host_stream)
       continue;
 
+    if (n_buf > 1)
+    {
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "for (int s = 0; s < ");
+      p = isl_printer_print_int(p, n_buf);
+      p = isl_printer_print_str(p, "; s++) {");
+      p = isl_printer_end_line(p);
+      p = isl_printer_indent(p, 4);
+    }
+
+    //for (int j = 0; j < local_array->n_mem_ports; j++) {
     p = isl_printer_start_line(p);
     p = isl_printer_print_str(p, "for (int i = 0; i < ");
     p = isl_printer_print_int(p, local_array->n_mem_ports);
@@ -791,81 +2340,175 @@ static __isl_give isl_printer *declare_and_allocate_cpu_arrays_xilinx(
     p = isl_printer_end_line(p);
     p = isl_printer_indent(p, 4);
 
+    p = print_str_new_line(p, "OCL_CHECK(err,");
+    indent1 = strlen("OCL_CHECK(");
+    p = isl_printer_indent(p, indent1);
     p = isl_printer_start_line(p);
-    p = autosa_print_array_type(p, local_array->array);
-    p = isl_printer_print_str(p, " *buffer_");
+    p = isl_printer_print_str(p, "cl::Buffer buffer_");
     p = isl_printer_print_str(p, local_array->array->name);
-    p = isl_printer_print_str(p, "_tmp = (");
-    p = autosa_print_array_type(p, local_array->array);
-    p = isl_printer_print_str(p, " *)malloc(");
-    p = autosa_array_info_print_size(p, local_array->array);
-    p = isl_printer_print_str(p, ");");
+    p = isl_printer_print_str(p, "_tmp");
+    p = isl_printer_print_str(p, n_device > 1 ? "(contexts[s]," : "(context,");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, strlen("cl::Buffer buffer_") +
+                                  strlen(local_array->array->name) + strlen("_tmp") + 1);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "CL_MEM_USE_HOST_PTR | ");
+    if (local_array->array->copy_in && local_array->array->copy_out)
+    {
+      p = isl_printer_print_str(p, "CL_MEM_READ_WRITE");
+    }
+    else
+    {
+      if (local_array->array->copy_in)
+        p = isl_printer_print_str(p, "CL_MEM_READ_ONLY");
+      else if (local_array->array->copy_out)
+        p = isl_printer_print_str(p, "CL_MEM_WRITE_ONLY");
+    }
+    p = isl_printer_print_str(p, ",");
+    p = isl_printer_end_line(p);
+    p = isl_printer_start_line(p);
+    if (local_array->host_serialize)
+    {
+      p = isl_printer_print_str(p, "sizeof(");
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, ") * dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, "_serialize.size()");
+    }
+    else
+      p = autosa_array_info_print_size(p, local_array->array);
+    p = isl_printer_print_str(p, ",");
+    p = isl_printer_end_line(p);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "dev_");
+    p = isl_printer_print_str(p, local_array->array->name);
+    if (local_array->host_serialize)
+      p = isl_printer_print_str(p, "_serialize");
+    if (host_array_has_slots(local_array, n_slot, n_device))
+    {
+      p = isl_printer_print_str(p, "_slot[s]");
+    }
+    if (local_array->n_mem_ports > 1 && local_array->array->copy_out)
+    {
+      p = isl_printer_print_str(p, "[i]");
+    }
+    if (host_array_is_zero_copy(local_array, zero_copy))
+      p = isl_printer_print_str(p, ",");
+    else
+      p = isl_printer_print_str(p, ".data(),");
     p = isl_printer_end_line(p);
+    p = print_str_new_line(p, "&err));");
+    p = isl_printer_indent(p, -(strlen("cl::Buffer buffer_") +
+                                strlen(local_array->array->name) + strlen("_tmp") + 1));
+    p = isl_printer_indent(p, -indent1);
 
     p = isl_printer_start_line(p);
     p = isl_printer_print_str(p, "buffer_");
     p = isl_printer_print_str(p, local_array->array->name);
-    p = isl_printer_print_str(p, ".push_back(buffer_");
+    if (n_buf > 1)
+      p = isl_printer_print_str(p, "[s]");
+    p = isl_printer_print_str(p, ".push_back(std::move(buffer_");
     p = isl_printer_print_str(p, local_array->array->name);
-    p = isl_printer_print_str(p, "_tmp);");
+    p = isl_printer_print_str(p, "_tmp));");
     p = isl_printer_end_line(p);
 
     p = isl_printer_indent(p, -4);
     p = print_str_new_line(p, "}");
-  }
-  p = isl_printer_end_line(p);
-
-  return p;
-}
 
-/* Print code for initializing the device for execution of the transformed
- * code. This includes declaring locally defined variables as well as
- * declaring and allocating the required copies of arrays on the device.
- */
-static __isl_give isl_printer *init_device_xilinx(__isl_take isl_printer *p,
-                                                  struct autosa_prog *prog, struct autosa_kernel *kernel, int hls)
-{
-  p = autosa_print_local_declarations(p, prog);
-  if (!hls)
-  {
-    p = find_device_xilinx(p);
-    p = declare_and_allocate_device_arrays_xilinx(p, prog, kernel);
-  }
-  else
-  {
-    p = declare_and_allocate_cpu_arrays_xilinx(p, prog, kernel);
+    if (n_buf > 1)
+    {
+      p = isl_printer_indent(p, -4);
+      p = print_str_new_line(p, "}");
+    }
   }
+  p = isl_printer_end_line(p);
 
-  return p;
+  return print_host_timers_xilinx(p);
 }
 
-static __isl_give isl_printer *autosa_free_cpu_arrays_xilinx(
+static __isl_give isl_printer *declare_and_allocate_cpu_arrays_xilinx(
     __isl_take isl_printer *p, struct autosa_prog *prog, struct autosa_kernel *kernel)
 {
-  p = print_str_new_line(p, "// Clean up resources");
+  p = print_str_new_line(p, "// Allocate memory in host memory");
   for (int i = 0; i < kernel->n_array; i++)
   {
     struct autosa_local_array_info *local_array = &kernel->array[i];
     if (!autosa_array_requires_device_allocation(local_array->array))
       continue;
 
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "for (int i = 0; i < ");
-    p = isl_printer_print_int(p, local_array->n_mem_ports);
-    p = isl_printer_print_str(p, "; i++) {");
-    p = isl_printer_end_line(p);
-    p = isl_printer_indent(p, 4);
+    if (local_array->n_mem_ports > 1 && local_array->array->copy_out)
+    {
+      /* Create multiple host buffers. */
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "std::vector<");
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, " *> ");
+      p = isl_printer_print_str(p, "dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, ";");
+      p = isl_printer_end_line(p);
 
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "free(buffer_");
-    p = isl_printer_print_str(p, local_array->array->name);
-    p = isl_printer_print_str(p, "[i]);");
-    p = isl_printer_end_line(p);
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "for (int i = 0; i < ");
+      p = isl_printer_print_int(p, local_array->n_mem_ports);
+      p = isl_printer_print_str(p, "; i++) {");
+      p = isl_printer_end_line(p);
+      p = isl_printer_indent(p, 4);
 
-    p = isl_printer_indent(p, -4);
-    p = print_str_new_line(p, "}");
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, " *dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, "_tmp");
+      p = isl_printer_print_str(p, " = (");
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, " *)malloc(");
+      p = autosa_array_info_print_data_size(p, local_array->array);
+      p = isl_printer_print_str(p, " * sizeof(");
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, "));");
+      p = isl_printer_end_line(p);
+
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, ".push_back(dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, "_tmp);");
+      p = isl_printer_end_line(p);
+
+      p = isl_printer_indent(p, -4);
+      p = print_str_new_line(p, "}");
+    }
+    else
+    {
+      /* Create a single host buffer. */
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, " *dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, " = (");
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, " *)malloc(");
+      p = autosa_array_info_print_data_size(p, local_array->array);
+      p = isl_printer_print_str(p, " * sizeof(");
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, "));");
+      p = isl_printer_end_line(p);
+    }
+    //    p = isl_printer_print_str(p, " = (");
+    //    p = autosa_print_array_type(p, array);
+    //    p = isl_printer_print_str(p, " *)malloc(");
+    //    p = autosa_array_info_print_data_size(p, array);
+    //    p = isl_printer_print_str(p, " * sizeof(");
+    //    p = isl_printer_print_str(p, array->type);
+    //    p = isl_printer_print_str(p, "));");
+    //    p = isl_printer_end_line(p);
   }
+  p = isl_printer_end_line(p);
 
+  /* Initialize buffer. */
+  p = print_str_new_line(p, "// Initialize host buffers");
   for (int i = 0; i < kernel->n_array; i++)
   {
     struct autosa_local_array_info *local_array = &kernel->array[i];
@@ -882,9 +2525,16 @@ static __isl_give isl_printer *autosa_free_cpu_arrays_xilinx(
       p = isl_printer_indent(p, 4);
 
       p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "free(dev_");
+      p = isl_printer_print_str(p, "memcpy(dev_");
       p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, "[i]);");
+      p = isl_printer_print_str(p, "[i]");
+      p = isl_printer_print_str(p, ", ");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, ", ");
+      p = autosa_array_info_print_data_size(p, local_array->array);
+      p = isl_printer_print_str(p, " * sizeof(");
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, "));");
       p = isl_printer_end_line(p);
 
       p = isl_printer_indent(p, -4);
@@ -893,13 +2543,175 @@ static __isl_give isl_printer *autosa_free_cpu_arrays_xilinx(
     else
     {
       p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "free(dev_");
+      p = isl_printer_print_str(p, "memcpy(dev_");
       p = isl_printer_print_str(p, local_array->array->name);
-      p = isl_printer_print_str(p, ");");
-      p = isl_printer_end_line(p);
-    }
-  }
-
+      p = isl_printer_print_str(p, ", ");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, ", ");
+      p = autosa_array_info_print_data_size(p, local_array->array);
+      p = isl_printer_print_str(p, " * sizeof(");
+      p = isl_printer_print_str(p, local_array->array->type);
+      p = isl_printer_print_str(p, "));");
+      p = isl_printer_end_line(p);
+    }
+  }
+  p = isl_printer_end_line(p);
+
+  p = print_str_new_line(p, "// Allocate buffers in device memory");
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    if (!autosa_array_requires_device_allocation(local_array->array))
+      continue;
+
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "std::vector<");
+    p = autosa_print_array_type(p, local_array->array);
+    p = isl_printer_print_str(p, " *> buffer_");
+    p = isl_printer_print_str(p, local_array->array->name);
+    p = isl_printer_print_str(p, ";");
+    p = isl_printer_end_line(p);
+  }
+
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    int indent1, indent2;
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    if (!autosa_array_requires_device_allocation(local_array->array))
+      continue;
+
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "for (int i = 0; i < ");
+    p = isl_printer_print_int(p, local_array->n_mem_ports);
+    p = isl_printer_print_str(p, "; i++) {");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, 4);
+
+    p = isl_printer_start_line(p);
+    p = autosa_print_array_type(p, local_array->array);
+    p = isl_printer_print_str(p, " *buffer_");
+    p = isl_printer_print_str(p, local_array->array->name);
+    p = isl_printer_print_str(p, "_tmp = (");
+    p = autosa_print_array_type(p, local_array->array);
+    p = isl_printer_print_str(p, " *)malloc(");
+    p = autosa_array_info_print_size(p, local_array->array);
+    p = isl_printer_print_str(p, ");");
+    p = isl_printer_end_line(p);
+
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "buffer_");
+    p = isl_printer_print_str(p, local_array->array->name);
+    p = isl_printer_print_str(p, ".push_back(buffer_");
+    p = isl_printer_print_str(p, local_array->array->name);
+    p = isl_printer_print_str(p, "_tmp);");
+    p = isl_printer_end_line(p);
+
+    p = isl_printer_indent(p, -4);
+    p = print_str_new_line(p, "}");
+  }
+  p = isl_printer_end_line(p);
+
+  return p;
+}
+
+/* Print code for initializing the device for execution of the transformed
+ * code. This includes declaring locally defined variables as well as
+ * declaring and allocating the required copies of arrays on the device.
+ */
+static __isl_give isl_printer *init_device_xilinx(__isl_take isl_printer *p,
+                                                  struct autosa_prog *prog, struct autosa_kernel *kernel, int hls,
+                                                  int n_slot, int zero_copy, int n_rep, int n_warmup, int xrt,
+                                                  int n_device)
+{
+  p = autosa_print_local_declarations(p, prog);
+  if (!hls)
+  {
+    p = find_device_xilinx(p, n_slot, n_rep, n_warmup, xrt, n_device,
+                           kernel->options->autosa->compute_units);
+    if (kernel->options->autosa->host_threads > 1)
+    {
+      p = print_str_new_line(p, "// Prepare the host buffers on the NUMA node of the device");
+      p = print_str_new_line(p, "autosa_numa_bind();");
+      p = isl_printer_end_line(p);
+    }
+    p = declare_and_allocate_device_arrays_xilinx(p, prog, kernel, n_slot,
+                                                  zero_copy, xrt, n_device);
+    if (n_rep > 0)
+    {
+      p = print_str_new_line(p, "// Times of the benchmark repetitions");
+      p = print_str_new_line(p, "std::vector<double> h2d_time, kernel_time, d2h_time;");
+      p = isl_printer_end_line(p);
+    }
+  }
+  else
+  {
+    p = declare_and_allocate_cpu_arrays_xilinx(p, prog, kernel);
+  }
+
+  return p;
+}
+
+static __isl_give isl_printer *autosa_free_cpu_arrays_xilinx(
+    __isl_take isl_printer *p, struct autosa_prog *prog, struct autosa_kernel *kernel)
+{
+  p = print_str_new_line(p, "// Clean up resources");
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    if (!autosa_array_requires_device_allocation(local_array->array))
+      continue;
+
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "for (int i = 0; i < ");
+    p = isl_printer_print_int(p, local_array->n_mem_ports);
+    p = isl_printer_print_str(p, "; i++) {");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, 4);
+
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "free(buffer_");
+    p = isl_printer_print_str(p, local_array->array->name);
+    p = isl_printer_print_str(p, "[i]);");
+    p = isl_printer_end_line(p);
+
+    p = isl_printer_indent(p, -4);
+    p = print_str_new_line(p, "}");
+  }
+
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    if (!autosa_array_requires_device_allocation(local_array->array))
+      continue;
+
+    if (local_array->n_mem_ports > 1 && local_array->array->copy_out)
+    {
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "for (int i = 0; i < ");
+      p = isl_printer_print_int(p, local_array->n_mem_ports);
+      p = isl_printer_print_str(p, "; i++) {");
+      p = isl_printer_end_line(p);
+      p = isl_printer_indent(p, 4);
+
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "free(dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, "[i]);");
+      p = isl_printer_end_line(p);
+
+      p = isl_printer_indent(p, -4);
+      p = print_str_new_line(p, "}");
+    }
+    else
+    {
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "free(dev_");
+      p = isl_printer_print_str(p, local_array->array->name);
+      p = isl_printer_print_str(p, ");");
+      p = isl_printer_end_line(p);
+    }
+  }
+
   //  for (int i = 0; i < prog->n_array; i++) {
   //    struct autosa_array_info *array = &prog->array[i];
   //    if (!autosa_array_requires_device_allocation(&prog->array[i]))
@@ -917,18 +2729,51 @@ static __isl_give isl_printer *autosa_free_cpu_arrays_xilinx(
 
 /* Print code for clearing the device after execution of the transformed code.
  * In particular, free the memory that was allocated on the device.
+ * With "n_device" devices, the outputs of the devices written through
+ * multiple memory ports are merged first.
+ * The outputs merged or deserialized directly into the host arrays
+ * (see host_unpack_fused) are not copied back.
  */
 static __isl_give isl_printer *clear_device_xilinx(__isl_take isl_printer *p,
-                                                   struct autosa_prog *prog, struct autosa_kernel *kernel, int hls)
+                                                   struct autosa_prog *prog, struct autosa_kernel *kernel, int hls,
+                                                   int n_slot, int zero_copy, int n_rep, int xrt, int n_device)
 {
+  int fused = host_unpack_fused(kernel, hls, n_slot, n_device);
+
+  if (!hls && n_device > 1)
+  {
+    p = print_str_new_line(p, "// Merge the outputs of the devices");
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "for (int slot = 0; slot < ");
+    p = isl_printer_print_int(p, n_device);
+    p = isl_printer_print_str(p, "; slot++) {");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, 4);
+    p = print_multi_device_merge_xilinx(p, kernel, 1);
+    p = isl_printer_indent(p, -4);
+    p = print_str_new_line(p, "}");
+  }
   if (!hls)
   {
-    p = print_str_new_line(p, "q.finish();");
+    if (!xrt && n_device <= 1)
+      p = print_str_new_line(p, "q.finish();");
     p = print_str_new_line(p, "auto host_end = std::chrono::high_resolution_clock::now();");
     p = isl_printer_end_line(p);
     p = print_str_new_line(p, "// Calculate time");
-    p = print_str_new_line(p, "std::chrono::duration<double> fpga_duration = fpga_end - fpga_begin;");
-    p = print_str_new_line(p, "std::cout << \"FPGA Time: \" << fpga_duration.count() << \" s\" << std::endl;");
+    if (n_rep > 0)
+    {
+      /* The FPGA time is the median kernel time of the benchmark. */
+      p = print_str_new_line(p, "std::cout << \"FPGA Time: \" << autosa_percentile(kernel_time, 50) << \" s (median of \" << n_rep << \" repetitions)\" << std::endl;");
+    }
+    else
+    {
+      p = print_str_new_line(p, "std::chrono::duration<double> fpga_duration = fpga_end - fpga_begin;");
+      p = print_str_new_line(p, "std::cout << \"FPGA Time: \" << fpga_duration.count() << \" s\" << std::endl;");
+    }
+    if (n_slot > 1)
+    {
+      p = print_str_new_line(p, "std::cout << \"FPGA Time per Batch: \" << fpga_duration.count() / n_batch << \" s (\" << n_batch << \" batches)\" << std::endl;");
+    }
     p = print_str_new_line(p, "std::chrono::duration<double> host_duration = host_end - host_begin;");
     p = print_str_new_line(p, "std::cout << \"Host Time: \" << host_duration.count() << \" s\" << std::endl;");
     p = isl_printer_end_line(p);
@@ -974,10 +2819,63 @@ static __isl_give isl_printer *clear_device_xilinx(__isl_take isl_printer *p,
       if (!autosa_array_requires_device_allocation(array))
         continue;
 
-      if (array->copy_out)
+      if (array->copy_out && host_array_is_zero_copy(array->local_array, zero_copy))
+      {
+        /* Copy back only if the aligned copy was used. */
+        p = isl_printer_start_line(p);
+        p = isl_printer_print_str(p, "if (!dev_");
+        p = isl_printer_print_str(p, array->name);
+        p = isl_printer_print_str(p, "_aligned.empty())");
+        p = isl_printer_end_line(p);
+        p = isl_printer_indent(p, 4);
+        p = isl_printer_start_line(p);
+        p = print_host_copy_start(p, kernel);
+        p = isl_printer_print_str(p, "dev_");
+        p = isl_printer_print_str(p, array->name);
+        p = isl_printer_print_str(p, "_aligned.begin(), dev_");
+        p = isl_printer_print_str(p, array->name);
+        p = isl_printer_print_str(p, "_aligned.end(), reinterpret_cast<");
+        p = isl_printer_print_str(p, array->type);
+        p = isl_printer_print_str(p, " *>(");
+        p = isl_printer_print_str(p, array->name);
+        p = isl_printer_print_str(p, "));");
+        p = isl_printer_end_line(p);
+        p = isl_printer_indent(p, -4);
+      }
+      else if (array->copy_out && fused &&
+               (array->local_array->host_serialize ||
+                array->local_array->n_mem_ports > 1))
+      {
+        /* The ports have been merged into the host array already. */
+        if (!array->local_array->host_serialize)
+          continue;
+        p = isl_printer_start_line(p);
+        p = print_host_serialize_func_name(p, array);
+        p = isl_printer_print_str(p, "(reinterpret_cast<");
+        p = isl_printer_print_str(p, array->type);
+        p = isl_printer_print_str(p, " *>(");
+        p = isl_printer_print_str(p, array->name);
+        p = isl_printer_print_str(p, "), dev_");
+        p = isl_printer_print_str(p, array->name);
+        p = isl_printer_print_str(p, "_serialize.data());");
+        p = isl_printer_end_line(p);
+      }
+      else if (array->copy_out)
       {
+        if (array->local_array->host_serialize)
+        {
+          p = isl_printer_start_line(p);
+          p = print_host_serialize_func_name(p, array);
+          p = isl_printer_print_str(p, "(dev_");
+          p = isl_printer_print_str(p, array->name);
+          p = isl_printer_print_str(p, ".data(), dev_");
+          p = isl_printer_print_str(p, array->name);
+          p = isl_printer_print_str(p, "_serialize.data());");
+          p = isl_printer_end_line(p);
+        }
         p = isl_printer_start_line(p);
-        p = isl_printer_print_str(p, "std::copy(dev_");
+        p = print_host_copy_start(p, kernel);
+        p = isl_printer_print_str(p, "dev_");
         p = isl_printer_print_str(p, array->name);
         if (array->local_array->n_mem_ports > 1)
         {
@@ -1010,6 +2908,8 @@ static __isl_give isl_printer *clear_device_xilinx(__isl_take isl_printer *p,
  * - the parameters
  * - the host loop iterators
  * - the arrays accssed by the module
+ * If "fused" is set, the ports are merged directly into the host array,
+ * see host_unpack_fused.
  */
 static __isl_give isl_printer *print_drain_merge_arguments_xilinx(
     __isl_take isl_printer *p,
@@ -1017,7 +2917,9 @@ static __isl_give isl_printer *print_drain_merge_arguments_xilinx(
     struct autosa_array_ref_group *group,
     struct autosa_drain_merge_func *func,
     int types,
-    int hls)
+    int hls,
+    int multi_device,
+    int fused)
 {
   int first = 1;
   int nparam;
@@ -1088,7 +2990,7 @@ static __isl_give isl_printer *print_drain_merge_arguments_xilinx(
     p = isl_printer_print_str(p, ", ");
   if (types)
   {
-    if (hls)
+    if (hls || fused)
     {
       p = isl_printer_print_str(p, local_array->array->type);
       p = isl_printer_print_str(p, " *");
@@ -1104,10 +3006,20 @@ static __isl_give isl_printer *print_drain_merge_arguments_xilinx(
     p = isl_printer_print_str(p, local_array->array->name);
     p = isl_printer_print_str(p, "_to");
   }
+  else if (fused)
+  {
+    p = isl_printer_print_str(p, "reinterpret_cast<");
+    p = isl_printer_print_str(p, local_array->array->type);
+    p = isl_printer_print_str(p, " *>(");
+    p = isl_printer_print_str(p, local_array->array->name);
+    p = isl_printer_print_str(p, ")");
+  }
   else
   {
     p = isl_printer_print_str(p, "dev_");
     p = isl_printer_print_str(p, local_array->array->name);
+    if (multi_device)
+      p = isl_printer_print_str(p, "_slot[slot]");
     p = isl_printer_print_str(p, "[0]");
   }
   first = 0;
@@ -1136,6 +3048,8 @@ static __isl_give isl_printer *print_drain_merge_arguments_xilinx(
   {
     p = isl_printer_print_str(p, "dev_");
     p = isl_printer_print_str(p, local_array->array->name);
+    if (multi_device)
+      p = isl_printer_print_str(p, "_slot[slot]");
     p = isl_printer_print_str(p, "[idx]");
   }
   first = 0;
@@ -1146,10 +3060,20 @@ static __isl_give isl_printer *print_drain_merge_arguments_xilinx(
 static __isl_give isl_printer *drain_merge_xilinx(
     __isl_take isl_printer *p, struct autosa_prog *prog,
     struct autosa_drain_merge_func *func,
-    int hls)
+    int hls, int n_slot, int n_device)
 {
   struct autosa_array_ref_group *group = func->group;
   p = print_str_new_line(p, "// Merge results");
+  if (n_device > 1)
+  {
+    /* Merge the ports of each device. */
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "for (int slot = 0; slot < ");
+    p = isl_printer_print_int(p, n_device);
+    p = isl_printer_print_str(p, "; slot++)");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, 4);
+  }
   p = isl_printer_start_line(p);
   p = isl_printer_print_str(p, "for (int idx = ");
   p = isl_printer_print_int(p, group->mem_port_id);
@@ -1162,12 +3086,16 @@ static __isl_give isl_printer *drain_merge_xilinx(
   p = isl_printer_start_line(p);
   p = autosa_array_ref_group_print_prefix(group, p);
   p = isl_printer_print_str(p, "_drain_merge(");
-  p = print_drain_merge_arguments_xilinx(p, func->kernel, group, func, 0, hls);
+  p = print_drain_merge_arguments_xilinx(p, func->kernel, group, func, 0, hls,
+                                         n_device > 1,
+                                         host_unpack_fused(func->kernel, hls, n_slot, n_device));
   p = isl_printer_print_str(p, ");");
   p = isl_printer_end_line(p);
 
   p = isl_printer_indent(p, -4);
   p = print_str_new_line(p, "}");
+  if (n_device > 1)
+    p = isl_printer_indent(p, -4);
   p = isl_printer_end_line(p);
   return p;
 }
@@ -1329,9 +3257,14 @@ static __isl_give isl_printer *copy_array_from_device_xilinx(
  *
  * Extract the array (if any) from the identifier and call
  * init_device, clear_device, copy_array_to_device or copy_array_from_device.
+ *
+ * When multiple batches are in flight in the OpenCL or XRT host, the arrays
+ * are copied to and from the device together with the kernel launch
+ * (see print_batch_launch_xilinx and print_batch_launch_xrt).
  */
 static __isl_give isl_printer *print_device_node_xilinx(__isl_take isl_printer *p,
-                                                        __isl_keep isl_ast_node *node, struct autosa_prog *prog, int hls)
+                                                        __isl_keep isl_ast_node *node, struct autosa_prog *prog,
+                                                        struct hls_info *hls)
 {
   isl_ast_expr *expr, *arg;
   isl_id *id;
@@ -1339,6 +3272,7 @@ static __isl_give isl_printer *print_device_node_xilinx(__isl_take isl_printer *
   struct autosa_array_info *array;
   struct autosa_kernel *kernel;
   struct autosa_drain_merge_func *func;
+  int n_device;
 
   expr = isl_ast_node_user_get_expr(node);
   arg = isl_ast_expr_get_op_arg(expr, 0);
@@ -1356,19 +3290,68 @@ static __isl_give isl_printer *print_device_node_xilinx(__isl_take isl_printer *
 
   if (!name)
     return isl_printer_free(p);
+  n_device = prog->scop->options->autosa->multi_device;
   if (!strcmp(name, "init_device"))
-    return init_device_xilinx(p, prog, kernel, hls);
+    return init_device_xilinx(p, prog, kernel, hls->hls, hls->host_batch,
+                              hls->host_zero_copy, hls->host_bench,
+                              hls->host_bench_warmup, hls->host_xrt, n_device);
   if (!strcmp(name, "clear_device"))
-    return clear_device_xilinx(p, prog, kernel, hls);
+    return clear_device_xilinx(p, prog, kernel, hls->hls, hls->host_batch,
+                               hls->host_zero_copy, hls->host_bench,
+                               hls->host_xrt, n_device);
   if (!strcmp(name, "drain_merge"))
-    return drain_merge_xilinx(p, prog, func, hls);
+    return drain_merge_xilinx(p, prog, func, hls->hls, hls->host_batch,
+                              n_device);
   if (!array)
     return isl_printer_free(p);
 
+  /* The transfers are issued at the kernel launch. */
+  if (!hls->hls && (hls->host_batch > 1 || n_device > 1))
+    return p;
+  /* The streamed arrays are written to their QDMA streams at the launch. */
+  if (!hls->hls && array->local_array->host_stream)
+    return p;
+  if (!hls->hls && hls->host_xrt)
+  {
+    p = print_xrt_sync(p, array->local_array, !prefixcmp(name, "to_device"),
+                       0, hls->host_zero_copy);
+    return isl_printer_end_line(p);
+  }
   if (!prefixcmp(name, "to_device"))
-    return copy_array_to_device_xilinx(p, array, hls);
+    return copy_array_to_device_xilinx(p, array, hls->hls);
   else
-    return copy_array_from_device_xilinx(p, array, hls);
+    return copy_array_from_device_xilinx(p, array, hls->hls);
+
+  return p;
+}
+
+/* Print the start of the statement setting the kernel argument "n_arg",
+ * on the XRT run handle "run" if it is not NULL, and on the OpenCL kernel
+ * otherwise.
+ */
+static __isl_give isl_printer *print_set_kernel_arg_start(
+    __isl_take isl_printer *p, int n_arg, const char *run)
+{
+  p = isl_printer_start_line(p);
+  if (run)
+  {
+    p = isl_printer_print_str(p, run);
+    p = isl_printer_print_str(p, ".set_arg(");
+  }
+  else
+  {
+    p = isl_printer_print_str(p, "OCL_CHECK(err, err = krnl.setArg(");
+  }
+  p = isl_printer_print_int(p, n_arg);
+
+  return p;
+}
+
+static __isl_give isl_printer *print_set_kernel_arg_end(
+    __isl_take isl_printer *p, const char *run)
+{
+  p = isl_printer_print_str(p, run ? ");" : "));");
+  p = isl_printer_end_line(p);
 
   return p;
 }
@@ -1377,10 +3360,13 @@ static __isl_give isl_printer *print_device_node_xilinx(__isl_take isl_printer *
  * - arrays
  * - parameters
  * - host iterators
+ * If "batch" is set, the device buffers of the batch in "slot" are used.
+ * If "run" is not NULL, the arguments are set on the XRT run handle "run".
  */
 static __isl_give isl_printer *print_set_kernel_arguments_xilinx(
     __isl_take isl_printer *p,
-    struct autosa_prog *prog, struct autosa_kernel *kernel)
+    struct autosa_prog *prog, struct autosa_kernel *kernel, int batch,
+    const char *run)
 {
   int n_arg = 0, n;
   unsigned nparam;
@@ -1416,13 +3402,15 @@ static __isl_give isl_printer *print_set_kernel_arguments_xilinx(
       if (autosa_array_is_scalar(local_array->array))
       {
         /* Scalar */
-        p = isl_printer_start_line(p);
-        p = isl_printer_print_str(p, "OCL_CHECK(err, err = krnl.setArg(");
-        p = isl_printer_print_int(p, n_arg);
+        p = print_set_kernel_arg_start(p, n_arg, run);
         p = isl_printer_print_str(p, ", ");
         p = isl_printer_print_str(p, local_array->array->name);
-        p = isl_printer_print_str(p, "));");
-        p = isl_printer_end_line(p);
+        p = print_set_kernel_arg_end(p, run);
+        n_arg++;
+      }
+      else if (local_array->host_stream)
+      {
+        /* The QDMA stream is bound to the argument at the launch. */
         n_arg++;
       }
       else
@@ -1430,16 +3418,16 @@ static __isl_give isl_printer *print_set_kernel_arguments_xilinx(
         for (int j = 0; j < local_array->n_io_group_refs; j++)
         {
           std::pair<int, int> ref_port_map = local_array->group_ref_mem_port_map[j];
-          p = isl_printer_start_line(p);
-          p = isl_printer_print_str(p, "OCL_CHECK(err, err = krnl.setArg(");
-          p = isl_printer_print_int(p, n_arg);
+          p = print_set_kernel_arg_start(p, n_arg, run);
           p = isl_printer_print_str(p, ", buffer_");
           p = isl_printer_print_str(p, local_array->array->name);
+          if (batch)
+            p = isl_printer_print_str(p, "[slot]");
           p = isl_printer_print_str(p, "[");
           //p = isl_printer_print_int(p, j);
           p = isl_printer_print_int(p, ref_port_map.second);
-          p = isl_printer_print_str(p, "]));");
-          p = isl_printer_end_line(p);
+          p = isl_printer_print_str(p, "]");
+          p = print_set_kernel_arg_end(p, run);
           n_arg++;
         }
       }
@@ -1454,17 +3442,23 @@ static __isl_give isl_printer *print_set_kernel_arguments_xilinx(
     const char *name;
     name = isl_space_get_dim_name(space, isl_dim_param, i);
 
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "OCL_CHECK(err, err = krnl.setArg(");
-    p = isl_printer_print_int(p, n_arg);
+    p = print_set_kernel_arg_start(p, n_arg, run);
     p = isl_printer_print_str(p, ", ");
     p = isl_printer_print_str(p, name);
-    p = isl_printer_print_str(p, "));");
-    p = isl_printer_end_line(p);
+    p = print_set_kernel_arg_end(p, run);
     n_arg++;
   }
   isl_space_free(space);
 
+  /* batch size of the persistent kernel */
+  if (autosa_kernel_is_persistent(kernel, XILINX_HW))
+  {
+    p = print_set_kernel_arg_start(p, n_arg, run);
+    p = isl_printer_print_str(p, ", 1");
+    p = print_set_kernel_arg_end(p, run);
+    n_arg++;
+  }
+
   /* host iterator */
   n = isl_space_dim(kernel->space, isl_dim_set);
   type = isl_options_get_ast_iterator_type(prog->ctx);
@@ -1473,493 +3467,3276 @@ static __isl_give isl_printer *print_set_kernel_arguments_xilinx(
     const char *name;
     name = isl_space_get_dim_name(kernel->space, isl_dim_set, i);
 
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "OCL_CHECK(err, err = krnl.setArg(");
-    p = isl_printer_print_int(p, n_arg);
+    p = print_set_kernel_arg_start(p, n_arg, run);
     p = isl_printer_print_str(p, ", ");
     p = isl_printer_print_str(p, name);
-    p = isl_printer_print_str(p, "));");
-    p = isl_printer_end_line(p);
+    p = print_set_kernel_arg_end(p, run);
+    n_arg++;
+  }
+
+  /* performance counters */
+  if (kernel->options->autosa->perf_counters)
+  {
+    p = print_set_kernel_arg_start(p, n_arg, run);
+    p = isl_printer_print_str(p, ", buffer_perf");
+    p = print_set_kernel_arg_end(p, run);
+    n_arg++;
+  }
+
+  /* FIFO traces */
+  if (kernel->options->autosa->fifo_trace)
+  {
+    p = print_set_kernel_arg_start(p, n_arg, run);
+    p = isl_printer_print_str(p, ", buffer_trace");
+    p = print_set_kernel_arg_end(p, run);
     n_arg++;
   }
 
   return p;
 }
 
-/* Print the header of the given kernel to both gen->hls.kernel_h
- * and gen->hls.kernel_c.
+/* Return the position of the argument of "local_array" of "kernel"
+ * among the kernel arguments, in the order of
+ * print_set_kernel_arguments_xilinx.
  */
-static void print_kernel_headers_xilinx(struct autosa_prog *prog,
-                                        struct autosa_kernel *kernel, struct hls_info *hls)
+static int kernel_array_argument_pos_xilinx(struct autosa_kernel *kernel,
+                                            struct autosa_local_array_info *local_array)
 {
-  isl_printer *p;
+  int n_arg = 0;
 
-  p = isl_printer_to_file(prog->ctx, hls->kernel_h);
-  p = isl_printer_set_output_format(p, ISL_FORMAT_C);
-  if (!hls->hls)
-  {
-    p = print_str_new_line(p, "extern \"C\" {");
-  }
-  p = print_kernel_header(p, prog, kernel, hls);
-  p = isl_printer_print_str(p, ";");
-  p = isl_printer_end_line(p);
-  if (!hls->hls)
+  for (int i = 0; i < kernel->n_array; i++)
   {
-    p = print_str_new_line(p, "}");
+    if (&kernel->array[i] == local_array)
+      break;
+    if (!autosa_kernel_requires_array_argument(kernel, i))
+      continue;
+    if (autosa_array_is_scalar(kernel->array[i].array) ||
+        kernel->array[i].host_stream)
+      n_arg++;
+    else
+      n_arg += kernel->array[i].n_io_group_refs;
   }
-  isl_printer_free(p);
+
+  return n_arg;
 }
 
-/* Print the user statement of the host code to "p".
- *
- * The host code may contain original user statements, kernel launches,
- * statements that copy data to/from the device and statements
- * the initialize or clear the device.
- * The original user statements and the kernel launches have
- * an associated annotation, while the other statements do not.
- * The latter are handled by print_device_node.
- * The annotation on the user statements is called "user".
- *
- * In case of a kernel launch, print a block of statements that
- * defines the grid and the block and then launches the kernel.
+/* Print the code that creates the QDMA streams of the arrays of "kernel"
+ * streamed to the kernel if "write" is not set, and the code that writes
+ * the serialized arrays to the streams, waits for the transfers and
+ * releases the streams otherwise.
+ * The streams are created before the kernel is enqueued and written
+ * after, and the writes are non-blocking such that the kernel can
+ * consume all its streams at once.
  */
-static __isl_give isl_printer *print_host_user_xilinx(__isl_take isl_printer *p,
-                                                      __isl_take isl_ast_print_options *print_options,
-                                                      __isl_keep isl_ast_node *node, void *user)
+static __isl_give isl_printer *print_qdma_streams_xilinx(
+    __isl_take isl_printer *p, struct autosa_kernel *kernel, int write)
 {
-  isl_id *id;
-  int is_user;
-  struct autosa_kernel *kernel;
-  struct autosa_kernel_stmt *stmt;
-  struct print_host_user_data *data;
-  struct hls_info *hls;
-
-  isl_ast_print_options_free(print_options);
+  int n_stream = 0;
 
-  data = (struct print_host_user_data *)user;
-  hls = data->hls;
+  for (int i = 0; i < kernel->n_array; i++)
+    if (kernel->array[i].host_stream &&
+        autosa_kernel_requires_array_argument(kernel, i))
+      n_stream++;
+  if (n_stream == 0)
+    return p;
 
-  id = isl_ast_node_get_annotation(node);
-  if (!id)
+  if (!write)
   {
-    return print_device_node_xilinx(p, node, data->prog, hls->hls);
+    p = print_str_new_line(p, "// Create the QDMA streams of the streamed arrays");
+    p = print_str_new_line(p, "autosa_stream_init(device.getInfo<CL_DEVICE_PLATFORM>());");
   }
-
-  is_user = !strcmp(isl_id_get_name(id), "user");
-  kernel = is_user ? NULL : (struct autosa_kernel *)isl_id_get_user(id);
-  stmt = is_user ? (struct autosa_kernel_stmt *)isl_id_get_user(id) : NULL;
-  isl_id_free(id);
-
-  if (is_user)
-    return autosa_kernel_print_domain(p, stmt);
-
-  if (!hls->hls)
+  else
+    p = print_str_new_line(p, "// Write the streamed arrays to the kernel");
+  for (int i = 0; i < kernel->n_array; i++)
   {
-    /* Print OpenCL host. */
-    p = ppcg_start_block(p);
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    const char *name = local_array->array->name;
 
-    p = print_set_kernel_arguments_xilinx(p, data->prog, kernel);
-    p = print_str_new_line(p, "q.finish();");
-    p = print_str_new_line(p, "fpga_begin = std::chrono::high_resolution_clock::now();");
+    if (!local_array->host_stream ||
+        !autosa_kernel_requires_array_argument(kernel, i))
+      continue;
+    if (!write)
+    {
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "cl_mem_ext_ptr_t ext_");
+      p = isl_printer_print_str(p, name);
+      p = isl_printer_print_str(p, " = {");
+      p = isl_printer_print_int(p, kernel_array_argument_pos_xilinx(kernel, local_array));
+      p = isl_printer_print_str(p, ", NULL, krnl.get()};");
+      p = isl_printer_end_line(p);
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "OCL_CHECK(err, cl_stream stream_");
+      p = isl_printer_print_str(p, name);
+      p = isl_printer_print_str(p, " = autosa_create_stream(device.get(), CL_STREAM_READ_ONLY, CL_STREAM, &ext_");
+      p = isl_printer_print_str(p, name);
+      p = isl_printer_print_str(p, ", &err));");
+      p = isl_printer_end_line(p);
+      continue;
+    }
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "cl_stream_xfer_req req_");
+    p = isl_printer_print_str(p, name);
+    p = isl_printer_print_str(p, " = {0};");
     p = isl_printer_end_line(p);
-    p = print_str_new_line(p, "// Launch the kernel");
-    p = print_str_new_line(p, "OCL_CHECK(err, err = q.enqueueTask(krnl));");
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "req_");
+    p = isl_printer_print_str(p, name);
+    p = isl_printer_print_str(p, ".flags = CL_STREAM_EOT | CL_STREAM_NONBLOCKING;");
     p = isl_printer_end_line(p);
-    p = print_str_new_line(p, "q.finish();");
-    p = print_str_new_line(p, "fpga_end = std::chrono::high_resolution_clock::now();");
-
-    /* Print the top kernel generation function */
-    /* Disabled by default */
-    //    p = isl_printer_start_line(p);
-    //    p = isl_printer_print_str(p, "/* Top Function Generation */");
-    //    p = isl_printer_end_line(p);
-    //
-    //    p = isl_printer_start_line(p);
-    //    p = isl_printer_print_str(p, "FILE *f = fopen(\"top.cpp\", \"w\");");
-    //    p = isl_printer_end_line(p);
-    //    p = isl_printer_start_line(p);
-    //    p = isl_printer_print_str(p, "top_generate(");
-    //    p = print_top_gen_arguments(p, data->prog, kernel, 0);
-    //    p = isl_printer_print_str(p, ");");
-    //    p = isl_printer_end_line(p);
-    //    p = isl_printer_start_line(p);
-    //    p = isl_printer_print_str(p, "fclose(f);");
-    //    p = isl_printer_end_line(p);
-    //    p = isl_printer_start_line(p);
-    //    p = isl_printer_print_str(p, "/* Top Function Generation */");
-    //    p = isl_printer_end_line(p);
-
-    p = ppcg_end_block(p);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "req_");
+    p = isl_printer_print_str(p, name);
+    p = isl_printer_print_str(p, ".priv_data = (void *)\"");
+    p = isl_printer_print_str(p, name);
+    p = isl_printer_print_str(p, "\";");
+    p = isl_printer_end_line(p);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "OCL_CHECK(err, autosa_write_stream(stream_");
+    p = isl_printer_print_str(p, name);
+    p = isl_printer_print_str(p, ", dev_");
+    p = isl_printer_print_str(p, name);
+    p = isl_printer_print_str(p, "_serialize.data(), sizeof(");
+    p = isl_printer_print_str(p, local_array->array->type);
+    p = isl_printer_print_str(p, ") * dev_");
+    p = isl_printer_print_str(p, name);
+    p = isl_printer_print_str(p, "_serialize.size(), &req_");
+    p = isl_printer_print_str(p, name);
+    p = isl_printer_print_str(p, ", &err));");
     p = isl_printer_end_line(p);
   }
-  else
+  if (!write)
+    return isl_printer_end_line(p);
+
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "std::vector<cl_streams_poll_req_completions> stream_compl(");
+  p = isl_printer_print_int(p, n_stream);
+  p = isl_printer_print_str(p, ");");
+  p = isl_printer_end_line(p);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "cl_int n_stream_compl = ");
+  p = isl_printer_print_int(p, n_stream);
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "OCL_CHECK(err, err = autosa_poll_streams(device.get(), stream_compl.data(), ");
+  p = isl_printer_print_int(p, n_stream);
+  p = isl_printer_print_str(p, ", ");
+  p = isl_printer_print_int(p, n_stream);
+  p = isl_printer_print_str(p, ", &n_stream_compl, AUTOSA_STREAM_TIMEOUT, &err));");
+  p = isl_printer_end_line(p);
+  for (int i = 0; i < kernel->n_array; i++)
   {
-    /* Print HLS host. */
-    p = ppcg_start_block(p);
+    struct autosa_local_array_info *local_array = &kernel->array[i];
 
-    p = print_str_new_line(p, "// Launch the kernel");
+    if (!local_array->host_stream ||
+        !autosa_kernel_requires_array_argument(kernel, i))
+      continue;
     p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "kernel");
-    p = isl_printer_print_int(p, kernel->id);
-    p = isl_printer_print_str(p, "(");
-    p = print_kernel_arguments(p, data->prog, kernel, 0, hls);
-    p = isl_printer_print_str(p, ");");
+    p = isl_printer_print_str(p, "OCL_CHECK(err, err = autosa_release_stream(stream_");
+    p = isl_printer_print_str(p, local_array->array->name);
+    p = isl_printer_print_str(p, "));");
     p = isl_printer_end_line(p);
-
-    p = ppcg_end_block(p);
   }
-  /* Print the top kernel header. */
-  print_kernel_headers_xilinx(data->prog, kernel, data->hls);
+  p = isl_printer_end_line(p);
 
   return p;
 }
 
-/* Print the header of the given module.
+/* Print the code that collects the device buffers of the batch in "slot"
+ * for the arrays that are copied in (if "in" is set) or copied out
+ * (otherwise) into "objs".
+ * If "batch" is not set, the device buffers of the single batch are
+ * collected instead, and the arrays that are also copied in are left out
+ * of the outputs, so that their host buffers keep the initial data
+ * across the repetitions of the benchmark mode.
+ * The number of arrays collected is returned in "n".
  */
-static __isl_give isl_printer *print_module_header_xilinx(
-    __isl_take isl_printer *p,
-    struct autosa_prog *prog, struct autosa_hw_module *module,
-    int inter, int boundary)
+static __isl_give isl_printer *print_batch_mem_objects_xilinx(
+    __isl_take isl_printer *p, struct autosa_kernel *kernel, int in,
+    const char *objs, int batch, int *n)
 {
-  p = isl_printer_start_line(p);
-  p = isl_printer_print_str(p, "void ");
-  p = isl_printer_print_str(p, module->name);
-  if (inter == 0)
-    p = isl_printer_print_str(p, "_intra_trans");
-  else if (inter == 1)
-    p = isl_printer_print_str(p, "_inter_trans");
-  if (boundary)
-    p = isl_printer_print_str(p, "_boundary");
-  p = isl_printer_print_str(p, "(");
-  p = print_module_arguments(p, prog, module->kernel, module, 1, XILINX_HW, inter, -1, boundary);
-  p = isl_printer_print_str(p, ")");
+  *n = 0;
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    if (!autosa_array_requires_device_allocation(local_array->array))
+      continue;
+    if (in ? !local_array->array->copy_in : !local_array->array->copy_out)
+      continue;
+    if (!batch && !in && local_array->array->copy_in)
+      continue;
+
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "for (int i = 0; i < ");
+    p = isl_printer_print_int(p, in ? local_array->n_mem_ports : local_array->n_io_group_refs);
+    p = isl_printer_print_str(p, "; i++)");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, 4);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, objs);
+    p = isl_printer_print_str(p, ".push_back(buffer_");
+    p = isl_printer_print_str(p, local_array->array->name);
+    p = isl_printer_print_str(p, batch ? "[slot][i]);" : "[i]);");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, -4);
+    (*n)++;
+  }
 
   return p;
 }
 
-/* Print the header of the given module to both gen->hls.kernel_h
- * and gen->hls.kernel_c
- * If "inter" is -1, this is a normal module call.
- * If "inter" is 0, this is a intra_trans module call.
- * If "inter" is 1, this is a inter_trans module call.
+/* Print the kernel launch in the OpenCL host with "n_slot" batches
+ * in flight.
+ * The batch "b" uses the device buffers in slot "b % n_slot".
+ * The transfers are ordered through events only, so that the transfers
+ * of one batch overlap the kernel execution of the other batches:
+ * - the inputs of a batch are migrated to the device once the outputs of
+ *   the previous batch in the same slot have been migrated back,
+ * - the kernel waits for the inputs of its own batch,
+ * - the outputs are migrated back once the kernel is finished.
+ * The host buffers of the arrays that are both read and written by the
+ * kernel are refreshed from the initial data before they are reused,
+ * as each batch is assumed to be an independent problem instance.
+ * At the end, the outputs of the last batch are restored.
+ * With multiple compute units, the batches are distributed to
+ * the compute units in a round-robin manner, where the number of slots
+ * is a multiple of the number of compute units (see print_hw), and
+ * the batches run concurrently on the out-of-order command queue.
  */
-static isl_stat print_module_headers_xilinx(
-    struct autosa_prog *prog, struct autosa_hw_module *module,
-    struct hls_info *hls, int inter, int boundary)
+static __isl_give isl_printer *print_batch_launch_xilinx(
+    __isl_take isl_printer *p, struct autosa_prog *prog,
+    struct autosa_kernel *kernel, int n_slot)
 {
-  isl_printer *p;
+  int n_in, n_out;
+  int n_cu = kernel->options->autosa->compute_units;
 
-  p = isl_printer_to_file(prog->ctx, hls->kernel_h);
-  p = isl_printer_set_output_format(p, ISL_FORMAT_C);
-  p = print_module_header_xilinx(p, prog, module, inter, boundary);
-  p = isl_printer_print_str(p, ";");
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "std::vector<std::vector<cl::Event>> read_events(");
+  p = isl_printer_print_int(p, n_slot);
+  p = isl_printer_print_str(p, ");");
   p = isl_printer_end_line(p);
-  isl_printer_free(p);
-
-  p = isl_printer_to_file(prog->ctx, hls->kernel_c);
-  p = isl_printer_set_output_format(p, ISL_FORMAT_C);
-  p = print_module_header_xilinx(p, prog, module, inter, boundary);
+  p = print_str_new_line(p, "q.finish();");
+  p = print_str_new_line(p, "fpga_begin = std::chrono::high_resolution_clock::now();");
   p = isl_printer_end_line(p);
-  isl_printer_free(p);
-
-  return isl_stat_ok;
-}
-
-/* Print out variable declarations on Xilinx platforms.
- * The local variable can be mapped to different memory resources:
- * FF, LUTRAM, BRAM, URAM.
- */
-static __isl_give isl_printer *print_module_var_xilinx(
-    __isl_take isl_printer *p,
-    struct autosa_kernel_var *var, int double_buffer,
-    struct autosa_hw_module *module)
-{
-  int j;
-  int use_memory = 0; // 0: FF 1: LUTRAM 2: BRAM 3: URAM
-  use_memory = extract_memory_type(module, var, module->options->autosa->uram);
 
+  p = print_str_new_line(p, "for (int b = 0; b < n_batch; b++) {");
+  p = isl_printer_indent(p, 4);
   p = isl_printer_start_line(p);
-  if (var->n_lane == 1)
-    p = isl_printer_print_str(p, var->array->type);
-  else
-  {
-    p = isl_printer_print_str(p, var->array->name);
-    p = isl_printer_print_str(p, "_t");
-    p = isl_printer_print_int(p, var->n_lane);
-  }
-  p = isl_printer_print_str(p, " ");
-  p = isl_printer_print_str(p, var->name);
-  if (double_buffer)
-    p = isl_printer_print_str(p, "_ping");
-  for (j = 0; j < isl_vec_size(var->size); ++j)
-  {
-    isl_val *v;
-
-    p = isl_printer_print_str(p, "[");
-    v = isl_vec_get_element_val(var->size, j);
-    p = isl_printer_print_val(p, v);
-    isl_val_free(v);
-    p = isl_printer_print_str(p, "]");
-  }
+  p = isl_printer_print_str(p, "int slot = b % ");
+  p = isl_printer_print_int(p, n_slot);
   p = isl_printer_print_str(p, ";");
   p = isl_printer_end_line(p);
-  if (use_memory && var->n_part != 1)
+  if (n_cu > 1)
   {
     p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "#pragma HLS ARRAY_PARTITION variable=");
-    p = isl_printer_print_str(p, var->name);
-    if (double_buffer)
-      p = isl_printer_print_str(p, "_ping");
-    p = isl_printer_print_str(p, " dim=");
-    p = isl_printer_print_int(p, isl_vec_size(var->size));
-    p = isl_printer_print_str(p, " factor=");
-    p = isl_printer_print_int(p, var->n_part);
-    p = isl_printer_print_str(p, " cyclic");
+    p = isl_printer_print_str(p, "cl::Kernel &krnl = krnls[slot % ");
+    p = isl_printer_print_int(p, n_cu);
+    p = isl_printer_print_str(p, "];");
     p = isl_printer_end_line(p);
   }
-  if (use_memory)
+  p = print_str_new_line(p, "std::vector<cl::Event> write_events(1);");
+  p = print_str_new_line(p, "std::vector<cl::Event> kernel_events(1);");
+  p = print_str_new_line(p, "std::vector<cl::Memory> in_objs;");
+  p = print_str_new_line(p, "std::vector<cl::Memory> out_objs;");
+  p = print_batch_mem_objects_xilinx(p, kernel, 1, "in_objs", 1, &n_in);
+  p = print_batch_mem_objects_xilinx(p, kernel, 0, "out_objs", 1, &n_out);
+  p = isl_printer_end_line(p);
+
+  /* Refresh the host buffers that are overwritten by the previous batch. */
+  for (int i = 0; i < kernel->n_array; i++)
   {
-    if (double_buffer)
-    {
-      p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "#pragma HLS ARRAY_MAP variable=");
-      p = isl_printer_print_str(p, var->name);
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    if (!autosa_array_requires_device_allocation(local_array->array))
+      continue;
+    if (!local_array->array->copy_in || !local_array->array->copy_out)
+      continue;
+
+    p = print_str_new_line(p, "if (!read_events[slot].empty()) {");
+    p = isl_printer_indent(p, 4);
+    p = print_str_new_line(p, "// Wait for the previous batch in this slot");
+    p = print_str_new_line(p, "OCL_CHECK(err, err = cl::Event::waitForEvents(read_events[slot]));");
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "dev_");
+    p = isl_printer_print_str(p, local_array->array->name);
+    p = isl_printer_print_str(p, "_slot[slot] = dev_");
+    p = isl_printer_print_str(p, local_array->array->name);
+    p = isl_printer_print_str(p, ";");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, -4);
+    p = print_str_new_line(p, "}");
+  }
+
+  if (n_in > 0)
+  {
+    p = print_str_new_line(p, "// Copy the inputs of the batch once the slot is released");
+    p = print_str_new_line(p, "OCL_CHECK(err, err = q.enqueueMigrateMemObjects(in_objs, 0, &read_events[slot], &write_events[0]));");
+  }
+  p = isl_printer_end_line(p);
+  p = print_set_kernel_arguments_xilinx(p, prog, kernel, 1, NULL);
+  p = isl_printer_end_line(p);
+  p = print_str_new_line(p, "// Launch the kernel");
+  if (n_in > 0)
+    p = print_str_new_line(p, "OCL_CHECK(err, err = q.enqueueTask(krnl, &write_events, &kernel_events[0]));");
+  else
+    p = print_str_new_line(p, "OCL_CHECK(err, err = q.enqueueTask(krnl, &read_events[slot], &kernel_events[0]));");
+  p = isl_printer_end_line(p);
+  p = print_str_new_line(p, "// Copy the outputs of the batch back once the kernel is finished");
+  p = print_str_new_line(p, "read_events[slot].resize(1);");
+  if (n_out > 0)
+    p = print_str_new_line(p, "OCL_CHECK(err, err = q.enqueueMigrateMemObjects(out_objs, CL_MIGRATE_MEM_OBJECT_HOST, &kernel_events, &read_events[slot][0]));");
+  else
+    p = print_str_new_line(p, "read_events[slot][0] = kernel_events[0];");
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "}");
+  p = print_str_new_line(p, "q.finish();");
+  p = print_str_new_line(p, "fpga_end = std::chrono::high_resolution_clock::now();");
+  p = isl_printer_end_line(p);
+
+  /* Restore the outputs of the last batch. */
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    if (!autosa_array_requires_device_allocation(local_array->array))
+      continue;
+    if (!local_array->array->copy_out)
+      continue;
+
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "dev_");
+    p = isl_printer_print_str(p, local_array->array->name);
+    p = isl_printer_print_str(p, " = dev_");
+    p = isl_printer_print_str(p, local_array->array->name);
+    p = isl_printer_print_str(p, "_slot[(n_batch - 1) % ");
+    p = isl_printer_print_int(p, n_slot);
+    p = isl_printer_print_str(p, "];");
+    p = isl_printer_end_line(p);
+  }
+
+  return p;
+}
+
+/* Print the kernel launch in the OpenCL host with "n_device" devices.
+ * Each device runs the kernel on its own slice of the array partitions,
+ * with the host buffers in the slot of the device. All the devices are
+ * launched at once through their own command queues, and the outputs of
+ * each device are merged as soon as it is finished, while the following
+ * devices may still be running.
+ * The arrays written through multiple memory ports are merged after their
+ * ports (see drain_merge_xilinx).
+ */
+static __isl_give isl_printer *print_multi_device_launch_xilinx(
+    __isl_take isl_printer *p, struct autosa_prog *prog,
+    struct autosa_kernel *kernel, int n_device)
+{
+  int n_in, n_out;
+
+  p = print_str_new_line(p, "fpga_begin = std::chrono::high_resolution_clock::now();");
+  p = isl_printer_end_line(p);
+  p = print_str_new_line(p, "// Launch the kernel on each device");
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "for (int slot = 0; slot < ");
+  p = isl_printer_print_int(p, n_device);
+  p = isl_printer_print_str(p, "; slot++) {");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, 4);
+  p = print_str_new_line(p, "cl::CommandQueue &q = queues[slot];");
+  p = print_str_new_line(p, "cl::Kernel &krnl = krnls[slot];");
+  p = print_str_new_line(p, "std::vector<cl::Memory> in_objs;");
+  p = print_str_new_line(p, "std::vector<cl::Memory> out_objs;");
+  p = print_batch_mem_objects_xilinx(p, kernel, 1, "in_objs", 1, &n_in);
+  p = print_batch_mem_objects_xilinx(p, kernel, 0, "out_objs", 1, &n_out);
+  p = isl_printer_end_line(p);
+  if (n_in > 0)
+    p = print_str_new_line(p, "OCL_CHECK(err, err = q.enqueueMigrateMemObjects(in_objs, 0));");
+  p = print_set_kernel_arguments_xilinx(p, prog, kernel, 1, NULL);
+  p = print_str_new_line(p, "OCL_CHECK(err, err = q.enqueueTask(krnl));");
+  if (n_out > 0)
+    p = print_str_new_line(p, "OCL_CHECK(err, err = q.enqueueMigrateMemObjects(out_objs, CL_MIGRATE_MEM_OBJECT_HOST));");
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "}");
+  p = isl_printer_end_line(p);
+
+  p = print_str_new_line(p, "// Merge the outputs of each device once it is finished");
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "for (int slot = 0; slot < ");
+  p = isl_printer_print_int(p, n_device);
+  p = isl_printer_print_str(p, "; slot++) {");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, 4);
+  p = print_str_new_line(p, "queues[slot].finish();");
+  p = print_multi_device_merge_xilinx(p, kernel, 0);
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "}");
+  p = print_str_new_line(p, "fpga_end = std::chrono::high_resolution_clock::now();");
+
+  return p;
+}
+
+/* Print the kernel launch in the XRT host with "n_slot" batches in flight.
+ * The batch "b" uses the buffer objects and the run handle in slot
+ * "b % n_slot". The run handles are created and bound to the buffer objects
+ * of their slot once, and only started for each batch, such that the
+ * transfers of one batch overlap the kernel execution of the other batches:
+ * - the outputs of the previous batch in the slot are copied back once
+ *   its run is finished,
+ * - the inputs of the batch are copied to the device and the run is
+ *   started without waiting for it.
+ * As in the OpenCL host, the host buffers of the arrays that are both read
+ * and written by the kernel are refreshed from the initial data before
+ * they are reused, and the outputs of the last batch are restored.
+ */
+static __isl_give isl_printer *print_batch_launch_xrt(
+    __isl_take isl_printer *p, struct autosa_prog *prog,
+    struct autosa_kernel *kernel, int n_slot)
+{
+  p = print_str_new_line(p, "std::vector<xrt::run> runs;");
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "for (int slot = 0; slot < ");
+  p = isl_printer_print_int(p, n_slot);
+  p = isl_printer_print_str(p, "; slot++) {");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, 4);
+  p = print_str_new_line(p, "runs.push_back(xrt::run(krnl));");
+  p = print_set_kernel_arguments_xilinx(p, prog, kernel, 1, "runs[slot]");
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "}");
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "std::vector<bool> busy(");
+  p = isl_printer_print_int(p, n_slot);
+  p = isl_printer_print_str(p, ", false);");
+  p = isl_printer_end_line(p);
+  p = print_str_new_line(p, "fpga_begin = std::chrono::high_resolution_clock::now();");
+  p = isl_printer_end_line(p);
+
+  p = print_str_new_line(p, "for (int b = 0; b < n_batch; b++) {");
+  p = isl_printer_indent(p, 4);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "int slot = b % ");
+  p = isl_printer_print_int(p, n_slot);
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
+  p = print_str_new_line(p, "if (busy[slot]) {");
+  p = isl_printer_indent(p, 4);
+  p = print_str_new_line(p, "// Wait for the previous batch in this slot");
+  p = print_str_new_line(p, "runs[slot].wait();");
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    if (!autosa_array_requires_device_allocation(local_array->array))
+      continue;
+    if (!local_array->array->copy_out)
+      continue;
+    p = print_xrt_sync(p, local_array, 0, 1, 0);
+  }
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "}");
+
+  /* Refresh the host buffers that are overwritten by the previous batch. */
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    if (!autosa_array_requires_device_allocation(local_array->array))
+      continue;
+    if (!local_array->array->copy_in || !local_array->array->copy_out)
+      continue;
+
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "dev_");
+    p = isl_printer_print_str(p, local_array->array->name);
+    p = isl_printer_print_str(p, "_slot[slot] = dev_");
+    p = isl_printer_print_str(p, local_array->array->name);
+    p = isl_printer_print_str(p, ";");
+    p = isl_printer_end_line(p);
+  }
+
+  p = print_str_new_line(p, "// Copy the inputs of the batch and launch the kernel");
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    if (!autosa_array_requires_device_allocation(local_array->array))
+      continue;
+    if (!local_array->array->copy_in)
+      continue;
+    p = print_xrt_sync(p, local_array, 1, 1, 0);
+  }
+  p = print_str_new_line(p, "runs[slot].start();");
+  p = print_str_new_line(p, "busy[slot] = true;");
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "}");
+
+  p = print_str_new_line(p, "// Wait for the last batches");
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "for (int slot = 0; slot < ");
+  p = isl_printer_print_int(p, n_slot);
+  p = isl_printer_print_str(p, "; slot++) {");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, 4);
+  p = print_str_new_line(p, "if (!busy[slot])");
+  p = isl_printer_indent(p, 4);
+  p = print_str_new_line(p, "continue;");
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "runs[slot].wait();");
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    if (!autosa_array_requires_device_allocation(local_array->array))
+      continue;
+    if (!local_array->array->copy_out)
+      continue;
+    p = print_xrt_sync(p, local_array, 0, 1, 0);
+  }
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "}");
+  p = print_str_new_line(p, "fpga_end = std::chrono::high_resolution_clock::now();");
+  p = isl_printer_end_line(p);
+
+  /* Restore the outputs of the last batch. */
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    if (!autosa_array_requires_device_allocation(local_array->array))
+      continue;
+    if (!local_array->array->copy_out)
+      continue;
+
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "dev_");
+    p = isl_printer_print_str(p, local_array->array->name);
+    p = isl_printer_print_str(p, " = dev_");
+    p = isl_printer_print_str(p, local_array->array->name);
+    p = isl_printer_print_str(p, "_slot[(n_batch - 1) % ");
+    p = isl_printer_print_int(p, n_slot);
+    p = isl_printer_print_str(p, "];");
+    p = isl_printer_end_line(p);
+  }
+
+  return p;
+}
+
+/* Print the kernel launch in the benchmark mode of the OpenCL host.
+ * The kernel is launched "n_warmup" times, and then "n_rep" times,
+ * with the numbers set at the host command line.
+ * Each run migrates the inputs to the device, executes the kernel
+ * and migrates the outputs back, and the three commands of the timed runs
+ * are timed separately by the OpenCL profiling events, so that the PCIe
+ * transfers are separated from the kernel time.
+ * The arrays that are both read and written by the kernel are only
+ * migrated back after the benchmark, so that each run starts from
+ * the initial data.
+ * The throughput is computed from the number of arithmetic operations
+ * of the kernel and the median kernel time, if the number of operations
+ * is known at compile time.
+ */
+static __isl_give isl_printer *print_bench_launch_xilinx(
+    __isl_take isl_printer *p, struct autosa_kernel *kernel)
+{
+  int n_in, n_out;
+  double ops;
+  char ops_str[32];
+
+  p = print_str_new_line(p, "std::vector<cl::Memory> in_objs;");
+  p = print_str_new_line(p, "std::vector<cl::Memory> out_objs;");
+  p = print_batch_mem_objects_xilinx(p, kernel, 1, "in_objs", 0, &n_in);
+  p = print_batch_mem_objects_xilinx(p, kernel, 0, "out_objs", 0, &n_out);
+  p = print_str_new_line(p, "q.finish();");
+  p = isl_printer_end_line(p);
+
+  p = print_str_new_line(p, "// Benchmark the kernel");
+  p = print_str_new_line(p, "for (int rep = -n_warmup; rep < n_rep; rep++) {");
+  p = isl_printer_indent(p, 4);
+  p = print_str_new_line(p, "cl::Event write_event, kernel_event, read_event;");
+  if (n_in > 0)
+    p = print_str_new_line(p, "OCL_CHECK(err, err = q.enqueueMigrateMemObjects(in_objs, 0, nullptr, &write_event));");
+  p = print_str_new_line(p, "OCL_CHECK(err, err = q.enqueueTask(krnl, nullptr, &kernel_event));");
+  if (n_out > 0)
+    p = print_str_new_line(p, "OCL_CHECK(err, err = q.enqueueMigrateMemObjects(out_objs, CL_MIGRATE_MEM_OBJECT_HOST, nullptr, &read_event));");
+  p = print_str_new_line(p, "q.finish();");
+  p = print_str_new_line(p, "if (rep < 0)");
+  p = isl_printer_indent(p, 4);
+  p = print_str_new_line(p, "continue;");
+  p = isl_printer_indent(p, -4);
+  if (n_in > 0)
+    p = print_str_new_line(p, "h2d_time.push_back(autosa_event_time(write_event));");
+  p = print_str_new_line(p, "kernel_time.push_back(autosa_event_time(kernel_event));");
+  if (n_out > 0)
+    p = print_str_new_line(p, "d2h_time.push_back(autosa_event_time(read_event));");
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "}");
+  p = isl_printer_end_line(p);
+
+  p = print_str_new_line(p, "std::cout << \"Benchmark: \" << n_rep << \" repetitions after \" << n_warmup << \" warmup runs\" << std::endl;");
+  p = print_str_new_line(p, "autosa_bench_print(\"Kernel\", kernel_time);");
+  p = print_str_new_line(p, "autosa_bench_print(\"H2D Transfer\", h2d_time);");
+  p = print_str_new_line(p, "autosa_bench_print(\"D2H Transfer\", d2h_time);");
+  ops = autosa_kernel_count_ops(kernel);
+  if (ops >= 0)
+  {
+    snprintf(ops_str, sizeof(ops_str), "%.17g", ops);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "std::cout << \"Throughput: \" << ");
+    p = isl_printer_print_str(p, ops_str);
+    p = isl_printer_print_str(p, " / autosa_percentile(kernel_time, 50) / 1e9 << \" GFLOP/s (");
+    p = isl_printer_print_str(p, ops_str);
+    p = isl_printer_print_str(p, " operations)\" << std::endl;");
+    p = isl_printer_end_line(p);
+  }
+
+  return p;
+}
+
+/* Print the header of the given kernel to both gen->hls.kernel_h
+ * and gen->hls.kernel_c.
+ */
+static void print_kernel_headers_xilinx(struct autosa_prog *prog,
+                                        struct autosa_kernel *kernel, struct hls_info *hls)
+{
+  isl_printer *p;
+
+  p = isl_printer_to_file(prog->ctx, hls->kernel_h);
+  p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+  if (!hls->hls)
+  {
+    p = print_str_new_line(p, "extern \"C\" {");
+  }
+  p = print_kernel_header(p, prog, kernel, hls);
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
+  if (!hls->hls)
+  {
+    p = print_str_new_line(p, "}");
+  }
+  isl_printer_free(p);
+}
+
+/* An argument of the kernel launch in the HLS host.
+ * "expr" is the argument in the host.
+ * "type" is the element type of an array argument or the type of
+ * a scalar argument, and is empty for a constant argument.
+ * "size" is the size of an array argument in bytes, and is empty for
+ * the scalar arguments.
+ * "copy_out" is set if the array argument is copied out.
+ * "array" is the array of an array or a read-only scalar argument, and is
+ * NULL for the other arguments.
+ */
+struct autosa_tb_arg
+{
+  std::string expr;
+  std::string type;
+  std::string size;
+  int copy_out;
+  struct autosa_array_info *array;
+};
+
+/* Return the string printed by "fn" on "array".
+ */
+static std::string tb_array_str(isl_ctx *ctx, struct autosa_array_info *array,
+                                __isl_give isl_printer *(*fn)(__isl_take isl_printer *p,
+                                                              struct autosa_array_info *array))
+{
+  isl_printer *p = isl_printer_to_str(ctx);
+  char *str;
+  std::string ret;
+
+  p = fn(p, array);
+  str = isl_printer_get_str(p);
+  isl_printer_free(p);
+  ret = str;
+  free(str);
+
+  return ret;
+}
+
+/* Collect the arguments of the launch of "kernel" in the HLS host,
+ * in the order of print_kernel_arguments.
+ * The performance counters and the FIFO traces are not supported
+ * with the cached testbench.
+ */
+static std::vector<struct autosa_tb_arg> tb_kernel_arguments(
+    struct autosa_prog *prog, struct autosa_kernel *kernel)
+{
+  std::vector<struct autosa_tb_arg> args;
+  isl_space *space;
+  const char *type;
+  int n;
+
+  for (int i = 0; i < kernel->n_array; ++i)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    struct autosa_array_info *array = local_array->array;
+
+    if (autosa_kernel_requires_array_argument(kernel, i) <= 0)
+      continue;
+    if (autosa_array_is_read_only_scalar(array))
+    {
+      struct autosa_tb_arg arg = {array->name, array->type, "", 0, array};
+      args.push_back(arg);
+      continue;
+    }
+    for (int j = 0; j < local_array->n_io_group_refs; j++)
+    {
+      struct autosa_tb_arg arg;
+      isl_printer *p = isl_printer_to_str(prog->ctx);
+      char *str;
+
+      p = autosa_array_info_print_call_argument(p, array, j);
+      str = isl_printer_get_str(p);
+      isl_printer_free(p);
+      arg.expr = str;
+      free(str);
+      arg.type = array->type;
+      arg.size = tb_array_str(prog->ctx, array, &autosa_array_info_print_size);
+      arg.copy_out = array->copy_out;
+      arg.array = array;
+      args.push_back(arg);
+    }
+  }
+
+  space = isl_union_set_get_space(kernel->arrays);
+  for (int i = 0; i < isl_space_dim(space, isl_dim_param); ++i)
+  {
+    struct autosa_tb_arg arg = {isl_space_get_dim_name(space, isl_dim_param, i),
+                                "int", "", 0, NULL};
+    args.push_back(arg);
+  }
+  isl_space_free(space);
+
+  if (autosa_kernel_is_persistent(kernel, XILINX_HW))
+  {
+    struct autosa_tb_arg arg = {"1", "", "", 0, NULL};
+    args.push_back(arg);
+  }
+
+  n = isl_space_dim(kernel->space, isl_dim_set);
+  type = isl_options_get_ast_iterator_type(prog->ctx);
+  for (int i = 0; i < n; ++i)
+  {
+    struct autosa_tb_arg arg = {isl_space_get_dim_name(kernel->space, isl_dim_set, i),
+                                type, "", 0, NULL};
+    args.push_back(arg);
+  }
+
+  return args;
+}
+
+/* Print the name of the cached file of the argument "i" of "kernel"
+ * to "p", with the suffix ".golden" for the golden output if "golden"
+ * is set.
+ */
+static __isl_give isl_printer *print_tb_file_name(__isl_take isl_printer *p,
+                                                  struct autosa_kernel *kernel, int i, int golden)
+{
+  p = isl_printer_print_str(p, "\"kernel");
+  p = isl_printer_print_int(p, kernel->id);
+  p = isl_printer_print_str(p, "_arg");
+  p = isl_printer_print_int(p, i);
+  p = isl_printer_print_str(p, golden ? ".golden.bin\"" : ".bin\"");
+
+  return p;
+}
+
+/* Print the statements of the HLS host to "p" caching the inputs of
+ * the launch of "kernel" if "golden" is not set, or the outputs as
+ * the golden data of the cached testbench otherwise.
+ * The outputs of a run of the host that passes the checks of the program
+ * are then replayed by the testbench printed by print_tb_main_xilinx.
+ */
+static __isl_give isl_printer *print_tb_record_xilinx(__isl_take isl_printer *p,
+                                                      struct autosa_prog *prog, struct autosa_kernel *kernel, int golden)
+{
+  std::vector<struct autosa_tb_arg> args = tb_kernel_arguments(prog, kernel);
+
+  if (golden)
+    p = print_str_new_line(p, "// Cache the outputs of the kernel as the golden data of the testbench");
+  else
+    p = print_str_new_line(p, "// Cache the inputs of the kernel for the testbench");
+  for (int i = 0; i < args.size(); i++)
+  {
+    if (args[i].type.empty() || (golden && !args[i].copy_out) ||
+        (golden && args[i].size.empty()))
+      continue;
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "autosa_tb_record(");
+    p = print_tb_file_name(p, kernel, i, golden);
+    p = isl_printer_print_str(p, ", ");
+    if (args[i].size.empty())
+    {
+      p = isl_printer_print_str(p, "&");
+      p = isl_printer_print_str(p, args[i].expr.c_str());
+      p = isl_printer_print_str(p, ", sizeof(");
+      p = isl_printer_print_str(p, args[i].expr.c_str());
+      p = isl_printer_print_str(p, ")");
+    }
+    else
+    {
+      p = isl_printer_print_str(p, args[i].expr.c_str());
+      p = isl_printer_print_str(p, ", ");
+      p = isl_printer_print_str(p, args[i].size.c_str());
+    }
+    p = isl_printer_print_str(p, ");");
+    p = isl_printer_end_line(p);
+  }
+
+  return p;
+}
+
+/* Print the cached testbench of "kernel" to hls->tb_c.
+ * The testbench maps the inputs cached by the HLS host, launches the
+ * kernel and checks every hls->tb_sample-th element (or the stride given
+ * as the first argument of the testbench) of the outputs against the
+ * cached golden data, such that the C simulation neither regenerates
+ * the inputs nor recomputes the golden outputs.
+ */
+static void print_tb_main_xilinx(struct autosa_prog *prog,
+                                 struct autosa_kernel *kernel, struct hls_info *hls)
+{
+  std::vector<struct autosa_tb_arg> args = tb_kernel_arguments(prog, kernel);
+  isl_printer *p;
+
+  p = isl_printer_to_file(prog->ctx, hls->tb_c);
+  p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+  p = print_str_new_line(p, "int main(int argc, char **argv) {");
+  p = isl_printer_indent(p, 2);
+  p = print_str_new_line(p, "// Stride of the checked output elements");
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "long stride = argc > 1 ? atol(argv[1]) : ");
+  p = isl_printer_print_int(p, hls->tb_sample);
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
+  p = print_str_new_line(p, "long n_err = 0;");
+  p = isl_printer_end_line(p);
+
+  p = print_str_new_line(p, "// Map the cached inputs of the kernel");
+  for (int i = 0; i < args.size(); i++)
+  {
+    if (args[i].type.empty())
+      continue;
+    p = isl_printer_start_line(p);
+    if (args[i].size.empty())
+    {
+      p = isl_printer_print_str(p, args[i].type.c_str());
+      p = isl_printer_print_str(p, " arg");
+      p = isl_printer_print_int(p, i);
+      p = isl_printer_print_str(p, " = autosa_tb_buffer(");
+      p = print_tb_file_name(p, kernel, i, 0);
+      p = isl_printer_print_str(p, ").value<");
+      p = isl_printer_print_str(p, args[i].type.c_str());
+      p = isl_printer_print_str(p, ">();");
+    }
+    else
+    {
+      p = isl_printer_print_str(p, "autosa_tb_buffer arg");
+      p = isl_printer_print_int(p, i);
+      p = isl_printer_print_str(p, "(");
+      p = print_tb_file_name(p, kernel, i, 0);
+      p = isl_printer_print_str(p, ");");
+    }
+    p = isl_printer_end_line(p);
+  }
+  p = isl_printer_end_line(p);
+
+  p = print_str_new_line(p, "// Launch the kernel");
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "kernel");
+  p = isl_printer_print_int(p, kernel->id);
+  p = isl_printer_print_str(p, "(");
+  for (int i = 0; i < args.size(); i++)
+  {
+    if (i > 0)
+      p = isl_printer_print_str(p, ", ");
+    if (args[i].type.empty())
+    {
+      p = isl_printer_print_str(p, args[i].expr.c_str());
+      continue;
+    }
+    p = isl_printer_print_str(p, "arg");
+    p = isl_printer_print_int(p, i);
+  }
+  p = isl_printer_print_str(p, ");");
+  p = isl_printer_end_line(p);
+  p = isl_printer_end_line(p);
+
+  p = print_str_new_line(p, "// Check the outputs against the cached golden data");
+  for (int i = 0; i < args.size(); i++)
+  {
+    if (args[i].size.empty() || !args[i].copy_out)
+      continue;
+    p = print_str_new_line(p, "{");
+    p = isl_printer_indent(p, 2);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "autosa_tb_buffer golden(");
+    p = print_tb_file_name(p, kernel, i, 1);
+    p = isl_printer_print_str(p, ");");
+    p = isl_printer_end_line(p);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "n_err += autosa_tb_check<");
+    p = isl_printer_print_str(p, args[i].type.c_str());
+    p = isl_printer_print_str(p, ">(\"");
+    p = isl_printer_print_str(p, args[i].expr.c_str());
+    p = isl_printer_print_str(p, "\", arg");
+    p = isl_printer_print_int(p, i);
+    p = isl_printer_print_str(p, ", golden, stride);");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, -2);
+    p = print_str_new_line(p, "}");
+  }
+  p = isl_printer_end_line(p);
+
+  p = print_str_new_line(p, "if (n_err > 0) {");
+  p = print_str_new_line(p, "  printf(\"Failed!\\n\");");
+  p = print_str_new_line(p, "  return 1;");
+  p = print_str_new_line(p, "}");
+  p = print_str_new_line(p, "printf(\"Passed!\\n\");");
+  p = print_str_new_line(p, "return 0;");
+  p = isl_printer_indent(p, -2);
+  p = print_str_new_line(p, "}");
+  isl_printer_free(p);
+}
+
+/* Print the persistent device session of "kernel" to hls->session_h and
+ * hls->session_c.
+ * The session exports three C functions to the application:
+ * kernel<id>_session_init loads the bitstream and allocates one buffer
+ * object per array argument in the memory bank of the argument, once per
+ * process, and binds the buffers and the parameters to a run handle.
+ * kernel<id>_session_run copies the inputs into the buffers, launches
+ * the kernel and copies the outputs back, and can be called repeatedly
+ * without reprogramming the device.  The runs are serialized by a mutex.
+ * kernel<id>_session_teardown releases the device.
+ * The kernels launched inside host loops and the outputs written through
+ * multiple memory ports, which are merged by the host, are not supported.
+ */
+static void print_host_session_xilinx(struct autosa_prog *prog,
+                                      struct autosa_kernel *kernel, struct hls_info *hls)
+{
+  std::vector<struct autosa_tb_arg> args = tb_kernel_arguments(prog, kernel);
+  FILE *h = hls->session_h;
+  FILE *c = hls->session_c;
+  std::string name = "kernel" + std::to_string(kernel->id);
+  std::string init_args = "const char *xclbin";
+  std::string run_args;
+  std::set<std::string> run_arrays;
+  int n_bo;
+
+  if (isl_space_dim(kernel->space, isl_dim_set) > 0)
+  {
+    printf("[AutoSA] Warning: The host session does not support the kernels launched inside host loops. Option --AutoSA-host-session is ignored.\n");
+    return;
+  }
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+
+    if (autosa_kernel_requires_array_argument(kernel, i) <= 0)
+      continue;
+    if (local_array->n_mem_ports > 1 && local_array->array->copy_out)
+    {
+      printf("[AutoSA] Warning: The host session does not support the outputs written through multiple memory ports. Option --AutoSA-host-session is ignored.\n");
+      return;
+    }
+  }
+
+  for (int i = 0; i < args.size(); i++)
+  {
+    if (args[i].type.empty())
+      continue;
+    if (!args[i].array)
+    {
+      init_args += ", " + args[i].type + " " + args[i].expr;
+      continue;
+    }
+    if (run_arrays.count(args[i].array->name))
+      continue;
+    run_arrays.insert(args[i].array->name);
+    if (!run_args.empty())
+      run_args += ", ";
+    if (args[i].size.empty())
+      run_args += args[i].type + " " + args[i].expr;
+    else
+      run_args += args[i].type + " *" + args[i].array->name;
+  }
+  if (run_args.empty())
+    run_args = "void";
+
+  /* Header */
+  fprintf(h, "#ifdef __cplusplus\n");
+  fprintf(h, "extern \"C\" {\n");
+  fprintf(h, "#endif\n\n");
+  fprintf(h, "/* Load the bitstream and allocate the device buffers, once per process. */\n");
+  fprintf(h, "int %s_session_init(%s);\n", name.c_str(), init_args.c_str());
+  fprintf(h, "/* Copy the inputs to the device, run the kernel and copy the outputs back. */\n");
+  fprintf(h, "int %s_session_run(%s);\n", name.c_str(), run_args.c_str());
+  fprintf(h, "/* Release the device. */\n");
+  fprintf(h, "void %s_session_teardown(void);\n\n", name.c_str());
+  fprintf(h, "#ifdef __cplusplus\n");
+  fprintf(h, "}\n");
+  fprintf(h, "#endif\n");
+
+  /* Session state */
+  fprintf(c, "struct %s_session\n", name.c_str());
+  fprintf(c, "{\n");
+  fprintf(c, "  xrt::device device;\n");
+  fprintf(c, "  xrt::kernel krnl;\n");
+  fprintf(c, "  xrt::run run;\n");
+  fprintf(c, "  std::vector<xrt::bo> bo;\n");
+  fprintf(c, "  std::mutex lock;\n");
+  fprintf(c, "};\n\n");
+  fprintf(c, "static std::unique_ptr<struct %s_session> session;\n\n", name.c_str());
+
+  /* Initialization */
+  fprintf(c, "int %s_session_init(%s)\n", name.c_str(), init_args.c_str());
+  fprintf(c, "{\n");
+  fprintf(c, "  if (session)\n");
+  fprintf(c, "    return 0;\n");
+  fprintf(c, "  try {\n");
+  fprintf(c, "    std::unique_ptr<struct %s_session> s(new %s_session);\n",
+          name.c_str(), name.c_str());
+  fprintf(c, "    s->device = xrt::device(0);\n");
+  fprintf(c, "    xrt::uuid uuid = s->device.load_xclbin(xclbin);\n");
+  fprintf(c, "    s->krnl = xrt::kernel(s->device, uuid, \"%s\");\n", name.c_str());
+  fprintf(c, "    s->run = xrt::run(s->krnl);\n");
+  n_bo = 0;
+  for (int i = 0; i < args.size(); i++)
+  {
+    if (!args[i].size.empty())
+    {
+      fprintf(c, "    s->bo.push_back(xrt::bo(s->device, %s, s->krnl.group_id(%d)));\n",
+              args[i].size.c_str(), i);
+      fprintf(c, "    s->run.set_arg(%d, s->bo[%d]);\n", i, n_bo);
+      n_bo++;
+    }
+    else if (!args[i].array)
+      fprintf(c, "    s->run.set_arg(%d, %s);\n", i, args[i].expr.c_str());
+  }
+  fprintf(c, "    session = std::move(s);\n");
+  fprintf(c, "  } catch (const std::exception &e) {\n");
+  fprintf(c, "    std::cerr << \"[AutoSA] Error: %s_session_init: \" << e.what() << std::endl;\n",
+          name.c_str());
+  fprintf(c, "    return -1;\n");
+  fprintf(c, "  }\n");
+  fprintf(c, "  return 0;\n");
+  fprintf(c, "}\n\n");
+
+  /* Run */
+  fprintf(c, "int %s_session_run(%s)\n", name.c_str(), run_args.c_str());
+  fprintf(c, "{\n");
+  fprintf(c, "  if (!session) {\n");
+  fprintf(c, "    std::cerr << \"[AutoSA] Error: %s_session_run: the session is not initialized\" << std::endl;\n",
+          name.c_str());
+  fprintf(c, "    return -1;\n");
+  fprintf(c, "  }\n");
+  fprintf(c, "  std::lock_guard<std::mutex> guard(session->lock);\n");
+  fprintf(c, "  try {\n");
+  n_bo = 0;
+  for (int i = 0; i < args.size(); i++)
+  {
+    if (!args[i].array)
+      continue;
+    if (args[i].size.empty())
+    {
+      fprintf(c, "    session->run.set_arg(%d, %s);\n", i, args[i].expr.c_str());
+      continue;
+    }
+    if (args[i].array->copy_in)
+    {
+      fprintf(c, "    session->bo[%d].write(%s);\n", n_bo, args[i].array->name);
+      fprintf(c, "    session->bo[%d].sync(XCL_BO_SYNC_BO_TO_DEVICE);\n", n_bo);
+    }
+    n_bo++;
+  }
+  fprintf(c, "    session->run.start();\n");
+  fprintf(c, "    session->run.wait();\n");
+  n_bo = 0;
+  for (int i = 0; i < args.size(); i++)
+  {
+    if (args[i].size.empty())
+      continue;
+    if (args[i].copy_out)
+    {
+      fprintf(c, "    session->bo[%d].sync(XCL_BO_SYNC_BO_FROM_DEVICE);\n", n_bo);
+      fprintf(c, "    session->bo[%d].read(%s);\n", n_bo, args[i].array->name);
+    }
+    n_bo++;
+  }
+  fprintf(c, "  } catch (const std::exception &e) {\n");
+  fprintf(c, "    std::cerr << \"[AutoSA] Error: %s_session_run: \" << e.what() << std::endl;\n",
+          name.c_str());
+  fprintf(c, "    return -1;\n");
+  fprintf(c, "  }\n");
+  fprintf(c, "  return 0;\n");
+  fprintf(c, "}\n\n");
+
+  /* Teardown */
+  fprintf(c, "void %s_session_teardown(void)\n", name.c_str());
+  fprintf(c, "{\n");
+  fprintf(c, "  session.reset();\n");
+  fprintf(c, "}\n");
+}
+
+/* Print the user statement of the host code to "p".
+ *
+ * The host code may contain original user statements, kernel launches,
+ * statements that copy data to/from the device and statements
+ * the initialize or clear the device.
+ * The original user statements and the kernel launches have
+ * an associated annotation, while the other statements do not.
+ * The latter are handled by print_device_node.
+ * The annotation on the user statements is called "user".
+ *
+ * In case of a kernel launch, print a block of statements that
+ * defines the grid and the block and then launches the kernel.
+ */
+static __isl_give isl_printer *print_host_user_xilinx(__isl_take isl_printer *p,
+                                                      __isl_take isl_ast_print_options *print_options,
+                                                      __isl_keep isl_ast_node *node, void *user)
+{
+  isl_id *id;
+  int is_user;
+  struct autosa_kernel *kernel;
+  struct autosa_kernel_stmt *stmt;
+  struct print_host_user_data *data;
+  struct hls_info *hls;
+
+  isl_ast_print_options_free(print_options);
+
+  data = (struct print_host_user_data *)user;
+  hls = data->hls;
+
+  id = isl_ast_node_get_annotation(node);
+  if (!id)
+  {
+    return print_device_node_xilinx(p, node, data->prog, hls);
+  }
+
+  is_user = !strcmp(isl_id_get_name(id), "user");
+  kernel = is_user ? NULL : (struct autosa_kernel *)isl_id_get_user(id);
+  stmt = is_user ? (struct autosa_kernel_stmt *)isl_id_get_user(id) : NULL;
+  isl_id_free(id);
+
+  if (is_user)
+    return autosa_kernel_print_domain(p, stmt);
+
+  if (hls->session_c)
+  {
+    /* Only the first kernel is exported by the host session. */
+    print_host_session_xilinx(data->prog, kernel, hls);
+    fclose(hls->session_c);
+    fclose(hls->session_h);
+    hls->session_c = NULL;
+    hls->session_h = NULL;
+  }
+
+  if (!hls->hls && hls->host_xrt)
+  {
+    /* Print XRT host. */
+    p = ppcg_start_block(p);
+
+    if (hls->host_batch > 1)
+    {
+      p = print_batch_launch_xrt(p, data->prog, kernel, hls->host_batch);
+    }
+    else
+    {
+      p = print_str_new_line(p, "xrt::run run(krnl);");
+      p = print_set_kernel_arguments_xilinx(p, data->prog, kernel, 0, "run");
+      p = print_str_new_line(p, "fpga_begin = std::chrono::high_resolution_clock::now();");
+      p = isl_printer_end_line(p);
+      p = print_str_new_line(p, "// Launch the kernel");
+      p = print_str_new_line(p, "run.start();");
+      p = print_str_new_line(p, "run.wait();");
+      p = isl_printer_end_line(p);
+      p = print_str_new_line(p, "fpga_end = std::chrono::high_resolution_clock::now();");
+    }
+
+    p = ppcg_end_block(p);
+    p = isl_printer_end_line(p);
+  }
+  else if (!hls->hls)
+  {
+    /* Print OpenCL host. */
+    p = ppcg_start_block(p);
+
+    if (hls->host_batch > 1)
+    {
+      p = print_batch_launch_xilinx(p, data->prog, kernel, hls->host_batch);
+    }
+    else if (kernel->options->autosa->multi_device > 1)
+    {
+      p = print_multi_device_launch_xilinx(p, data->prog, kernel,
+                                           kernel->options->autosa->multi_device);
+    }
+    else
+    {
+      if (hls->perf_counters)
+      {
+        p = print_str_new_line(p, "// Allocate the performance counters");
+        p = print_str_new_line(p, "std::vector<unsigned int, aligned_allocator<unsigned int>> perf(3 * AUTOSA_N_PERF, 0);");
+        p = print_str_new_line(p, "OCL_CHECK(err, cl::Buffer buffer_perf(context, CL_MEM_USE_HOST_PTR | CL_MEM_WRITE_ONLY, sizeof(unsigned int) * perf.size(), perf.data(), &err));");
+        p = isl_printer_end_line(p);
+      }
+      if (hls->fifo_trace)
+      {
+        p = print_str_new_line(p, "// Allocate the FIFO traces");
+        p = print_str_new_line(p, "std::vector<unsigned int, aligned_allocator<unsigned int>> trace(AUTOSA_TRACE_SIZE, 0);");
+        p = print_str_new_line(p, "OCL_CHECK(err, cl::Buffer buffer_trace(context, CL_MEM_USE_HOST_PTR | CL_MEM_WRITE_ONLY, sizeof(unsigned int) * trace.size(), trace.data(), &err));");
+        p = isl_printer_end_line(p);
+      }
+      p = print_set_kernel_arguments_xilinx(p, data->prog, kernel, 0, NULL);
+      if (hls->host_bench > 0)
+      {
+        p = print_bench_launch_xilinx(p, kernel);
+      }
+      else
+      {
+        p = print_str_new_line(p, "q.finish();");
+        p = print_qdma_streams_xilinx(p, kernel, 0);
+        p = print_str_new_line(p, "fpga_begin = std::chrono::high_resolution_clock::now();");
+        p = isl_printer_end_line(p);
+        p = print_str_new_line(p, "// Launch the kernel");
+        p = print_str_new_line(p, "OCL_CHECK(err, err = q.enqueueTask(krnl));");
+        p = isl_printer_end_line(p);
+        p = print_qdma_streams_xilinx(p, kernel, 1);
+        p = print_str_new_line(p, "q.finish();");
+        p = print_str_new_line(p, "fpga_end = std::chrono::high_resolution_clock::now();");
+      }
+      if (hls->perf_counters)
+      {
+        p = isl_printer_end_line(p);
+        p = print_str_new_line(p, "// Print the performance counters");
+        p = print_str_new_line(p, "OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_perf}, CL_MIGRATE_MEM_OBJECT_HOST));");
+        p = print_str_new_line(p, "q.finish();");
+        p = print_str_new_line(p, "autosa_perf_print(perf.data());");
+      }
+      if (hls->fifo_trace)
+      {
+        p = isl_printer_end_line(p);
+        p = print_str_new_line(p, "// Write out the FIFO traces");
+        p = print_str_new_line(p, "OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_trace}, CL_MIGRATE_MEM_OBJECT_HOST));");
+        p = print_str_new_line(p, "q.finish();");
+        p = print_str_new_line(p, "autosa_trace_write(trace.data(), \"fifo_trace.vcd\");");
+      }
+    }
+
+    /* Print the top kernel generation function */
+    /* Disabled by default */
+    //    p = isl_printer_start_line(p);
+    //    p = isl_printer_print_str(p, "/* Top Function Generation */");
+    //    p = isl_printer_end_line(p);
+    //
+    //    p = isl_printer_start_line(p);
+    //    p = isl_printer_print_str(p, "FILE *f = fopen(\"top.cpp\", \"w\");");
+    //    p = isl_printer_end_line(p);
+    //    p = isl_printer_start_line(p);
+    //    p = isl_printer_print_str(p, "top_generate(");
+    //    p = print_top_gen_arguments(p, data->prog, kernel, 0);
+    //    p = isl_printer_print_str(p, ");");
+    //    p = isl_printer_end_line(p);
+    //    p = isl_printer_start_line(p);
+    //    p = isl_printer_print_str(p, "fclose(f);");
+    //    p = isl_printer_end_line(p);
+    //    p = isl_printer_start_line(p);
+    //    p = isl_printer_print_str(p, "/* Top Function Generation */");
+    //    p = isl_printer_end_line(p);
+
+    p = ppcg_end_block(p);
+    p = isl_printer_end_line(p);
+  }
+  else
+  {
+    /* Print HLS host. */
+    p = ppcg_start_block(p);
+
+    if (hls->perf_counters)
+      p = print_str_new_line(p, "unsigned int perf[3 * AUTOSA_N_PERF];");
+    if (hls->fifo_trace)
+      p = print_str_new_line(p, "static unsigned int trace[AUTOSA_TRACE_SIZE];");
+    if (hls->tb_c)
+      p = print_tb_record_xilinx(p, data->prog, kernel, 0);
+    p = print_str_new_line(p, "// Launch the kernel");
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "kernel");
+    p = isl_printer_print_int(p, kernel->id);
+    p = isl_printer_print_str(p, "(");
+    p = print_kernel_arguments(p, data->prog, kernel, 0, hls);
+    p = isl_printer_print_str(p, ");");
+    p = isl_printer_end_line(p);
+    if (hls->tb_c)
+    {
+      /* Only the first kernel is replayed by the testbench. */
+      p = print_tb_record_xilinx(p, data->prog, kernel, 1);
+      print_tb_main_xilinx(data->prog, kernel, hls);
+      fclose(hls->tb_c);
+      hls->tb_c = NULL;
+    }
+    if (hls->perf_counters)
+      p = print_str_new_line(p, "autosa_perf_print(perf);");
+    if (hls->fifo_trace)
+      p = print_str_new_line(p, "autosa_trace_write(trace, \"fifo_trace.vcd\");");
+
+    p = ppcg_end_block(p);
+  }
+  /* Print the top kernel header. */
+  print_kernel_headers_xilinx(data->prog, kernel, data->hls);
+
+  return p;
+}
+
+/* Print the header of the given module.
+ */
+static __isl_give isl_printer *print_module_header_xilinx(
+    __isl_take isl_printer *p,
+    struct autosa_prog *prog, struct autosa_hw_module *module,
+    int inter, int boundary)
+{
+  p = isl_printer_start_line(p);
+  p = print_module_template(p, module->kernel, module, 1, XILINX_HW);
+  p = isl_printer_print_str(p, "void ");
+  p = isl_printer_print_str(p, module->name);
+  if (inter == 0)
+    p = isl_printer_print_str(p, "_intra_trans");
+  else if (inter == 1)
+    p = isl_printer_print_str(p, "_inter_trans");
+  if (boundary)
+    p = isl_printer_print_str(p, "_boundary");
+  p = isl_printer_print_str(p, "(");
+  p = print_module_arguments(p, prog, module->kernel, module, 1, XILINX_HW, inter, -1, boundary);
+  p = isl_printer_print_str(p, ")");
+
+  return p;
+}
+
+/* Print the header of the given module to both gen->hls.kernel_h
+ * and gen->hls.kernel_c
+ * If "inter" is -1, this is a normal module call.
+ * If "inter" is 0, this is a intra_trans module call.
+ * If "inter" is 1, this is a inter_trans module call.
+ */
+static isl_stat print_module_headers_xilinx(
+    struct autosa_prog *prog, struct autosa_hw_module *module,
+    struct hls_info *hls, int inter, int boundary)
+{
+  isl_printer *p;
+
+  p = isl_printer_to_file(prog->ctx, hls->kernel_h);
+  p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+  p = print_module_header_xilinx(p, prog, module, inter, boundary);
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
+  isl_printer_free(p);
+
+  p = isl_printer_to_file(prog->ctx, hls->kernel_c);
+  p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+  p = print_module_header_xilinx(p, prog, module, inter, boundary);
+  p = isl_printer_end_line(p);
+  isl_printer_free(p);
+
+  return isl_stat_ok;
+}
+
+/* Print out variable declarations on Xilinx platforms.
+ * The local variable can be mapped to different memory resources:
+ * FF, LUTRAM, BRAM, URAM.
+ */
+static __isl_give isl_printer *print_module_var_xilinx(
+    __isl_take isl_printer *p,
+    struct autosa_kernel_var *var, int double_buffer,
+    struct autosa_hw_module *module)
+{
+  int j;
+  int use_memory = 0; // 0: FF 1: LUTRAM 2: BRAM 3: URAM
+  use_memory = extract_memory_type(module, var, module->options->autosa->uram);
+
+  p = isl_printer_start_line(p);
+  if (var->n_lane == 1)
+    p = isl_printer_print_str(p, var->array->type);
+  else
+  {
+    p = isl_printer_print_str(p, var->array->name);
+    p = isl_printer_print_str(p, "_t");
+    p = isl_printer_print_int(p, var->n_lane);
+  }
+  p = isl_printer_print_str(p, " ");
+  p = isl_printer_print_str(p, var->name);
+  if (double_buffer)
+    p = isl_printer_print_str(p, "_ping");
+  for (j = 0; j < isl_vec_size(var->size); ++j)
+  {
+    isl_val *v;
+
+    p = isl_printer_print_str(p, "[");
+    v = isl_vec_get_element_val(var->size, j);
+    p = isl_printer_print_val(p, v);
+    isl_val_free(v);
+    p = isl_printer_print_str(p, "]");
+  }
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
+  if (use_memory && var->n_part != 1)
+  {
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "#pragma HLS ARRAY_PARTITION variable=");
+    p = isl_printer_print_str(p, var->name);
+    if (double_buffer)
+      p = isl_printer_print_str(p, "_ping");
+    p = isl_printer_print_str(p, " dim=");
+    p = isl_printer_print_int(p, isl_vec_size(var->size));
+    p = isl_printer_print_str(p, " factor=");
+    p = isl_printer_print_int(p, var->n_part);
+    p = isl_printer_print_str(p, " cyclic");
+    p = isl_printer_end_line(p);
+  }
+  if (use_memory)
+  {
+    if (double_buffer)
+    {
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "#pragma HLS ARRAY_MAP variable=");
+      p = isl_printer_print_str(p, var->name);
       p = isl_printer_print_str(p, "_ping instance=");
       p = isl_printer_print_str(p, var->name);
       p = isl_printer_print_str(p, " horizontal");
       p = isl_printer_end_line(p);
     }
     p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "#pragma HLS RESOURCE variable=");
-    p = isl_printer_print_str(p, var->name);
-    if (double_buffer)
-      p = isl_printer_print_str(p, "_ping");
-    p = isl_printer_print_str(p, use_memory == 1 ? " core=RAM_2P_LUTRAM" : (use_memory == 2 ? " core=RAM_2P_BRAM" : " core=RAM_2P_URAM"));
+    p = isl_printer_print_str(p, "#pragma HLS RESOURCE variable=");
+    p = isl_printer_print_str(p, var->name);
+    if (double_buffer)
+      p = isl_printer_print_str(p, "_ping");
+    p = isl_printer_print_str(p, use_memory == 1 ? " core=RAM_2P_LUTRAM" : (use_memory == 2 ? " core=RAM_2P_BRAM" : " core=RAM_2P_URAM"));
+    p = isl_printer_end_line(p);
+  }
+
+  /* Print pong buffer */
+  if (double_buffer)
+  {
+    p = isl_printer_start_line(p);
+    if (var->n_lane == 1)
+      p = isl_printer_print_str(p, var->array->type);
+    else
+    {
+      p = isl_printer_print_str(p, var->array->name);
+      p = isl_printer_print_str(p, "_t");
+      p = isl_printer_print_int(p, var->n_lane);
+    }
+    p = isl_printer_print_str(p, " ");
+    p = isl_printer_print_str(p, var->name);
+    if (double_buffer)
+      p = isl_printer_print_str(p, "_pong");
+    for (j = 0; j < isl_vec_size(var->size); ++j)
+    {
+      isl_val *v;
+
+      p = isl_printer_print_str(p, "[");
+      v = isl_vec_get_element_val(var->size, j);
+      p = isl_printer_print_val(p, v);
+      isl_val_free(v);
+      p = isl_printer_print_str(p, "]");
+    }
+    p = isl_printer_print_str(p, ";");
+    p = isl_printer_end_line(p);
+    if (use_memory && var->n_part != 1)
+    {
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "#pragma HLS ARRAY_PARTITION variable=");
+      p = isl_printer_print_str(p, var->name);
+      if (double_buffer)
+        p = isl_printer_print_str(p, "_pong");
+      p = isl_printer_print_str(p, " dim=");
+      p = isl_printer_print_int(p, isl_vec_size(var->size));
+      p = isl_printer_print_str(p, " factor=");
+      p = isl_printer_print_int(p, var->n_part);
+      p = isl_printer_print_str(p, " cyclic");
+      p = isl_printer_end_line(p);
+    }
+    if (use_memory)
+    {
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "#pragma HLS ARRAY_MAP variable=");
+      p = isl_printer_print_str(p, var->name);
+      p = isl_printer_print_str(p, "_pong instance=");
+      p = isl_printer_print_str(p, var->name);
+      p = isl_printer_print_str(p, " horizontal");
+      p = isl_printer_end_line(p);
+
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "#pragma HLS RESOURCE variable=");
+      p = isl_printer_print_str(p, var->name);
+      p = isl_printer_print_str(p, "_pong");
+      p = isl_printer_print_str(p, use_memory == 1 ? " core=RAM_2P_LUTRAM" : (use_memory == 2 ? " core=RAM_2P_BRAM" : " core=RAM_2P_URAM"));
+      p = isl_printer_end_line(p);
+    }
+  }
+
+  return p;
+}
+
+/* Collect the declaration of the split buffer of the I/O transfer
+ * statement at "node", if any, in the set of strings "user".
+ */
+static isl_bool collect_split_buf_decl(__isl_keep isl_ast_node *node,
+                                       void *user)
+{
+  std::set<std::string> *decls = (std::set<std::string> *)user;
+  struct autosa_kernel_stmt *stmt;
+  struct hls_info hls;
+  isl_printer *p_str;
+  isl_id *id;
+  char *decl;
+
+  if (isl_ast_node_get_type(node) != isl_ast_node_user)
+    return isl_bool_true;
+  id = isl_ast_node_get_annotation(node);
+  if (!id)
+    return isl_bool_true;
+  stmt = (struct autosa_kernel_stmt *)isl_id_get_user(id);
+  isl_id_free(id);
+  if (!stmt || stmt->type != AUTOSA_KERNEL_STMT_IO_TRANSFER ||
+      stmt->u.i.data_pack == stmt->u.i.nxt_data_pack)
+    return isl_bool_true;
+
+  hls.target = XILINX_HW;
+  p_str = isl_printer_to_str(isl_ast_node_get_ctx(node));
+  p_str = autosa_print_io_split_buf(p_str, stmt->u.i.group,
+                                    stmt->u.i.data_pack, stmt->u.i.nxt_data_pack, &hls);
+  decl = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  decls->insert(decl);
+  free(decl);
+
+  return isl_bool_true;
+}
+
+/* Declare the split buffer "buf_data_split" of the I/O transfer statements
+ * in the module AST "tree" with the module variables, instead of in the
+ * pipelined loops.
+ * This is only done if all the statements split the data the same way.
+ * Set hls->split_buf_lifted if the buffer is declared.
+ */
+static __isl_give isl_printer *print_module_split_buf_xilinx(
+    __isl_take isl_printer *p, __isl_keep isl_ast_node *tree,
+    struct hls_info *hls)
+{
+  std::set<std::string> decls;
+
+  hls->split_buf_lifted = 0;
+  if (!tree || isl_ast_node_foreach_descendant_top_down(tree,
+                                                        &collect_split_buf_decl, &decls) < 0)
+    return p;
+  if (decls.size() != 1)
+    return p;
+
+  const std::string &decl = *decls.begin();
+  size_t start = 0;
+  while (start < decl.size())
+  {
+    size_t end = decl.find('\n', start);
+    if (end == std::string::npos)
+      end = decl.size();
+    p = print_str_new_line(p, decl.substr(start, end - start).c_str());
+    start = end + 1;
+  }
+  hls->split_buf_lifted = 1;
+
+  return p;
+}
+
+static __isl_give isl_printer *print_module_vars_xilinx(__isl_take isl_printer *p,
+                                                        struct autosa_hw_module *module, int inter)
+{
+  int i, n;
+  isl_space *space;
+  const char *type;
+
+  if (inter == -1)
+  {
+    for (i = 0; i < module->n_var; ++i)
+      p = print_module_var_xilinx(p, &module->var[i], module->double_buffer, module);
+  }
+
+  if (module->double_buffer && inter == -1)
+  {
+    type = isl_options_get_ast_iterator_type(module->kernel->ctx);
+
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "bool arb = 0;");
+    p = isl_printer_end_line(p);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, module->in ? "bool inter_trans_en = 1;" : "bool inter_trans_en = 0;");
+    p = isl_printer_end_line(p);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, module->in ? "bool intra_trans_en = 0;" : "bool intra_trans_en = 1;");
+    p = isl_printer_end_line(p);
+    /* iterators */
+    space = (module->in) ? module->intra_space : module->inter_space;
+    n = isl_space_dim(space, isl_dim_set);
+    for (int i = 0; i < n; i++)
+    {
+      const char *name;
+      name = isl_space_get_dim_name(space, isl_dim_set, i);
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, type);
+      p = isl_printer_print_str(p, " ");
+      p = isl_printer_print_str(p, name);
+      p = isl_printer_print_str(p, ", ");
+      p = isl_printer_print_str(p, name);
+      p = isl_printer_print_str(p, "_prev");
+      p = isl_printer_print_str(p, ";");
+      p = isl_printer_end_line(p);
+    }
+  }
+
+  return p;
+}
+
+static __isl_give isl_printer *print_module_stmt(__isl_take isl_printer *p,
+                                                 __isl_take isl_ast_print_options *print_options,
+                                                 __isl_keep isl_ast_node *node, void *user)
+{
+  isl_id *id;
+  struct autosa_kernel_stmt *stmt;
+  struct print_hw_module_data *hw_data = (struct print_hw_module_data *)(user);
+  struct autosa_hw_module *module = hw_data->module;
+
+  id = isl_ast_node_get_annotation(node);
+  stmt = (struct autosa_kernel_stmt *)isl_id_get_user(id);
+  isl_id_free(id);
+
+  isl_ast_print_options_free(print_options);
+
+  /* The DRAM process of a prefetching module only accesses
+   * the external memory. */
+  if (hw_data->hls->prefetch == 1 && stmt->type != AUTOSA_KERNEL_STMT_IO_DRAM)
+    return p;
+
+  switch (stmt->type)
+  {
+    //    case POLYSA_KERNEL_STMT_COPY:
+    //      return autosa_kernel_print_copy(p, stmt);
+    //    case POLYSA_KERNEL_STMT_SYNC:
+    //      return print_sync(p, stmt);
+  case AUTOSA_KERNEL_STMT_DOMAIN:
+    return autosa_kernel_print_domain(p, stmt);
+  case AUTOSA_KERNEL_STMT_IO:
+    return autosa_kernel_print_io(p, stmt, hw_data->hls);
+  case AUTOSA_KERNEL_STMT_IO_TRANSFER:
+    return autosa_kernel_print_io_transfer(p, stmt, hw_data->hls);
+  case AUTOSA_KERNEL_STMT_IO_DRAM:
+    return autosa_kernel_print_io_dram(p, stmt, hw_data->hls);
+  case AUTOSA_KERNEL_STMT_IO_MODULE_CALL_INTER_TRANS:
+    return autosa_kernel_print_inter_trans(p, stmt, hw_data->hls);
+  case AUTOSA_KERNEL_STMT_IO_MODULE_CALL_INTRA_TRANS:
+    return autosa_kernel_print_intra_trans(p, stmt, hw_data->hls);
+  case AUTOSA_KERNEL_STMT_IO_MODULE_CALL_INTER_INTRA:
+    return autosa_kernel_print_inter_intra(p, stmt, hw_data->hls);
+  case AUTOSA_KERNEL_STMT_IO_MODULE_CALL_INTRA_INTER:
+    return autosa_kernel_print_intra_inter(p, stmt, hw_data->hls);
+  case AUTOSA_KERNEL_STMT_IO_MODULE_CALL_STATE_HANDLE:
+    return autosa_kernel_print_state_handle(p, stmt, hw_data->hls);
+  case AUTOSA_KERNEL_STMT_IO_MODULE_CALL_CREDIT:
+    return autosa_kernel_print_credit(p, stmt, hw_data->hls);
+  case AUTOSA_KERNEL_STMT_DRAIN_MERGE:
+    return autosa_kernel_print_drain_merge(p, stmt, hw_data->hls);
+  }
+
+  return p;
+}
+
+/* Print the for node "node" with its iterator of "iter_bits" bits
+ * inferred from the loop bounds, if any.
+ * The iterator type of the AST printer is overridden for this loop only,
+ * and restored once the loop is printed, such that nested loops pick
+ * their own type.
+ */
+static __isl_give isl_printer *print_for_narrowed(
+    __isl_keep isl_ast_node *node, __isl_take isl_printer *p,
+    __isl_take isl_ast_print_options *print_options,
+    struct autosa_ast_node_userinfo *info)
+{
+  isl_ctx *ctx;
+  char *saved_type;
+  char type[32];
+
+  if (!info || info->iter_bits == 0)
+    return isl_ast_node_for_print(node, p, print_options);
+
+  ctx = isl_ast_node_get_ctx(node);
+  saved_type = strdup(isl_options_get_ast_iterator_type(ctx));
+  sprintf(type, "%s<%d>", info->iter_signed ? "ap_int" : "ap_uint",
+          info->iter_bits);
+  isl_options_set_ast_iterator_type(ctx, type);
+  p = isl_ast_node_for_print(node, p, print_options);
+  isl_options_set_ast_iterator_type(ctx, saved_type);
+  free(saved_type);
+
+  return p;
+}
+
+/* Examine if the array access "expr" of the statement "stmt" is the same
+ * in the consecutive iterations of a loop, i.e., if the index expressions
+ * are unchanged by the substitution "next" of the loop iterator "c" by "c + 1".
+ */
+static isl_bool access_is_loop_invariant(struct autosa_kernel_stmt *stmt,
+                                         __isl_keep pet_expr *expr, __isl_keep isl_id_to_ast_expr *next)
+{
+  isl_id *ref_id;
+  isl_ast_expr *expr0, *expr1;
+  isl_bool invariant;
+
+  ref_id = pet_expr_access_get_ref_id(expr);
+  expr0 = isl_id_to_ast_expr_get(stmt->u.d.ref2expr, ref_id);
+  expr1 = isl_ast_expr_substitute_ids(isl_ast_expr_copy(expr0),
+                                      isl_id_to_ast_expr_copy(next));
+  invariant = isl_ast_expr_is_equal(expr0, expr1);
+  isl_ast_expr_free(expr0);
+  isl_ast_expr_free(expr1);
+
+  return invariant;
+}
+
+/* Return the substitution of the iterator "c" of the for node "node"
+ * by "c + 1".
+ */
+static __isl_give isl_id_to_ast_expr *next_iteration(
+    __isl_keep isl_ast_node *node)
+{
+  isl_ctx *ctx = isl_ast_node_get_ctx(node);
+  isl_ast_expr *iter, *expr;
+  isl_id_to_ast_expr *next;
+
+  iter = isl_ast_node_for_get_iterator(node);
+  expr = isl_ast_expr_add(isl_ast_expr_copy(iter),
+                          isl_ast_expr_from_val(isl_val_one(ctx)));
+  next = isl_id_to_ast_expr_alloc(ctx, 1);
+  next = isl_id_to_ast_expr_set(next, isl_ast_expr_get_id(iter), expr);
+  isl_ast_expr_free(iter);
+
+  return next;
+}
+
+/* Examine if the unrolled for node "node" iterates an even number of times
+ * over a narrow integer multiply-accumulate statement "acc += x * y",
+ * with "x" invariant in the loop and "y" varying along the loop.
+ * If so, return the statement, and store the accesses in "acc", "x" and "y".
+ */
+static struct autosa_kernel_stmt *extract_dsp_pack_stmt(
+    __isl_keep isl_ast_node *node, struct autosa_prog *prog,
+    pet_expr **acc, pet_expr **x, pet_expr **y)
+{
+  isl_ast_node *body;
+  isl_id *id;
+  isl_id_to_ast_expr *next;
+  struct autosa_kernel_stmt *stmt = NULL;
+  pet_expr *mul;
+  isl_bool inv_x, inv_y;
+  long n;
+
+  n = autosa_ast_node_for_n_iter(node);
+  if (n < 2 || n % 2 != 0)
+    return NULL;
+
+  body = isl_ast_node_for_get_body(node);
+  if (isl_ast_node_get_type(body) == isl_ast_node_user)
+  {
+    id = isl_ast_node_get_annotation(body);
+    if (id)
+    {
+      stmt = (struct autosa_kernel_stmt *)isl_id_get_user(id);
+      isl_id_free(id);
+    }
+  }
+  isl_ast_node_free(body);
+  /* The masked statements and the statements with a fused initialization
+   * are printed as they are. */
+  if (!stmt || stmt->type != AUTOSA_KERNEL_STMT_DOMAIN || stmt->u.d.guard ||
+      stmt->u.d.init)
+    return NULL;
+
+  mul = autosa_stmt_extract_narrow_mac(prog, stmt->u.d.stmt->stmt, acc);
+  if (!mul)
+    return NULL;
+  *x = pet_expr_get_arg(mul, 0);
+  *y = pet_expr_get_arg(mul, 1);
+  pet_expr_free(mul);
+
+  next = next_iteration(node);
+  inv_x = access_is_loop_invariant(stmt, *x, next);
+  inv_y = access_is_loop_invariant(stmt, *y, next);
+  isl_id_to_ast_expr_free(next);
+  if (inv_y == isl_bool_true && inv_x == isl_bool_false)
+  {
+    pet_expr *tmp = *x;
+    *x = *y;
+    *y = tmp;
+  }
+  else if (!(inv_x == isl_bool_true && inv_y == isl_bool_false))
+  {
+    *acc = pet_expr_free(*acc);
+    *x = pet_expr_free(*x);
+    *y = pet_expr_free(*y);
+    return NULL;
+  }
+
+  return stmt;
+}
+
+/* Print the access "expr" of the statement "stmt" in the iteration given by
+ * the substitution "next" of the loop iterator, if not NULL.
+ */
+static __isl_give isl_printer *print_dsp_pack_access(__isl_take isl_printer *p,
+                                                     struct autosa_kernel_stmt *stmt, __isl_keep pet_expr *expr,
+                                                     __isl_keep isl_id_to_ast_expr *next)
+{
+  isl_id *ref_id;
+  isl_ast_expr *index;
+
+  ref_id = pet_expr_access_get_ref_id(expr);
+  index = isl_id_to_ast_expr_get(stmt->u.d.ref2expr, ref_id);
+  if (next)
+    index = isl_ast_expr_substitute_ids(index, isl_id_to_ast_expr_copy(next));
+  p = isl_printer_print_ast_expr(p, index);
+  isl_ast_expr_free(index);
+
+  return p;
+}
+
+/* Print the unrolled loop "node" over the narrow integer multiply-accumulate
+ * statement "stmt" with two multiplies packed in one DSP.
+ * Each iteration of the printed loop computes two iterations "c" and "c + 1"
+ * of the original loop with a single 27x18-bit multiplication
+ *
+ *   dsp_out = ((y[c + 1] << 18) + y[c]) * x;
+ *   acc[c] += dsp_out(17, 0);
+ *   acc[c + 1] += (dsp_out >> 18) + dsp_out[17];
+ *
+ * The products are at most 16 bits wide and do not overlap.
+ * For signed values, the upper product is corrected by the sign of
+ * the lower product.
+ */
+static __isl_give isl_printer *print_for_with_dsp_pack(
+    __isl_keep isl_ast_node *node, __isl_take isl_printer *p,
+    struct autosa_kernel_stmt *stmt, struct autosa_prog *prog,
+    __isl_keep pet_expr *acc, __isl_keep pet_expr *x, __isl_keep pet_expr *y)
+{
+  isl_ast_expr *iter;
+  isl_id_to_ast_expr *next;
+  int is_signed;
+  long n;
+  char *name;
+
+  n = autosa_ast_node_for_n_iter(node);
+  iter = isl_ast_node_for_get_iterator(node);
+  name = isl_ast_expr_to_C_str(iter);
+  isl_ast_expr_free(iter);
+  next = next_iteration(node);
+  is_signed = 0;
+  for (int i = 0; i < prog->n_array; i++)
+  {
+    isl_id *id = pet_expr_access_get_id(x);
+    if (!strcmp(prog->array[i].name, isl_id_get_name(id)))
+      is_signed = !strncmp(prog->array[i].hls_type, "ap_int<", 7);
+    isl_id_free(id);
+  }
+
+  p = print_str_new_line(p, "#pragma HLS UNROLL");
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "for (int ");
+  p = isl_printer_print_str(p, name);
+  p = isl_printer_print_str(p, " = 0; ");
+  p = isl_printer_print_str(p, name);
+  p = isl_printer_print_str(p, " < ");
+  p = isl_printer_print_int(p, n);
+  p = isl_printer_print_str(p, "; ");
+  p = isl_printer_print_str(p, name);
+  p = isl_printer_print_str(p, " += 2) {");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, 4);
+  p = print_str_new_line(p, "/* Two multiplies packed in one DSP */");
+
+  /* ap_int<27> dsp_in = (ap_int<27>(y[c + 1]) << 18) + ap_int<27>(y[c]); */
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "ap_int<27> dsp_in = (ap_int<27>(");
+  p = print_dsp_pack_access(p, stmt, y, next);
+  p = isl_printer_print_str(p, ") << 18) + ap_int<27>(");
+  p = print_dsp_pack_access(p, stmt, y, NULL);
+  p = isl_printer_print_str(p, ");");
+  p = isl_printer_end_line(p);
+
+  /* ap_int<45> dsp_out = dsp_in * x; */
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "ap_int<45> dsp_out = dsp_in * ");
+  p = print_dsp_pack_access(p, stmt, x, NULL);
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
+
+  /* acc[c] += ap_int<18>(dsp_out(17, 0)); */
+  p = isl_printer_start_line(p);
+  p = print_dsp_pack_access(p, stmt, acc, NULL);
+  p = isl_printer_print_str(p, is_signed ? " += ap_int<18>(dsp_out(17, 0));" : " += ap_uint<18>(dsp_out(17, 0));");
+  p = isl_printer_end_line(p);
+
+  /* acc[c + 1] += ap_int<27>(dsp_out >> 18) + dsp_out[17]; */
+  p = isl_printer_start_line(p);
+  p = print_dsp_pack_access(p, stmt, acc, next);
+  p = isl_printer_print_str(p, is_signed ? " += ap_int<27>(dsp_out >> 18) + dsp_out[17];" : " += ap_uint<27>(dsp_out >> 18);");
+  p = isl_printer_end_line(p);
+
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "}");
+
+  isl_id_to_ast_expr_free(next);
+  free(name);
+
+  return p;
+}
+
+/* Examine if the unrolled for node "node" iterates a constant number of
+ * times over a multiply-accumulate statement "acc += x * y" that reduces
+ * along the loop, i.e., with "acc" invariant in the loop and at least one
+ * of "x" and "y" varying along the loop.
+ * If so, return the statement, and store the accesses in "acc", "x" and "y".
+ */
+static struct autosa_kernel_stmt *extract_adder_tree_stmt(
+    __isl_keep isl_ast_node *node, struct autosa_prog *prog,
+    pet_expr **acc, pet_expr **x, pet_expr **y)
+{
+  isl_ast_node *body;
+  isl_id *id;
+  isl_id_to_ast_expr *next;
+  struct autosa_kernel_stmt *stmt = NULL;
+  pet_expr *mul;
+  isl_bool inv_acc, inv_x, inv_y;
+
+  if (autosa_ast_node_for_n_iter(node) < 2)
+    return NULL;
+
+  body = isl_ast_node_for_get_body(node);
+  if (isl_ast_node_get_type(body) == isl_ast_node_user)
+  {
+    id = isl_ast_node_get_annotation(body);
+    if (id)
+    {
+      stmt = (struct autosa_kernel_stmt *)isl_id_get_user(id);
+      isl_id_free(id);
+    }
+  }
+  isl_ast_node_free(body);
+  /* The masked statements and the statements with a fused initialization
+   * are printed as they are. */
+  if (!stmt || stmt->type != AUTOSA_KERNEL_STMT_DOMAIN || stmt->u.d.guard ||
+      stmt->u.d.init)
+    return NULL;
+
+  mul = autosa_stmt_extract_mac(prog, stmt->u.d.stmt->stmt, acc);
+  if (!mul)
+    return NULL;
+  *x = pet_expr_get_arg(mul, 0);
+  *y = pet_expr_get_arg(mul, 1);
+  pet_expr_free(mul);
+
+  next = next_iteration(node);
+  inv_acc = access_is_loop_invariant(stmt, *acc, next);
+  inv_x = access_is_loop_invariant(stmt, *x, next);
+  inv_y = access_is_loop_invariant(stmt, *y, next);
+  isl_id_to_ast_expr_free(next);
+  if (inv_acc != isl_bool_true ||
+      (inv_x == isl_bool_true && inv_y == isl_bool_true))
+  {
+    *acc = pet_expr_free(*acc);
+    *x = pet_expr_free(*x);
+    *y = pet_expr_free(*y);
+    return NULL;
+  }
+
+  return stmt;
+}
+
+/* Print the unrolled loop "node" over the multiply-accumulate statement
+ * "stmt" that reduces along the loop as a balanced adder tree.
+ * The products are computed in parallel into the partial sums,
+ * which are added pairwise in log2(n) levels before being accumulated
+ * into "acc"
+ *
+ *   acc_s[c] = x[c] * y[c];
+ *   for (stride = 1; stride < n; stride *= 2)
+ *     for (c = 0; c + stride < n; c += 2 * stride)
+ *       acc_s[c] += acc_s[c + stride];
+ *   acc += acc_s[0];
+ *
+ * The loop-carried dependence on "acc" is reduced from n additions
+ * to a single one.
+ * It is covered by the latency hiding loops, which keep that many
+ * independent partial accumulators in the PE. A warning is printed
+ * if there are fewer of them than the latency of the addition.
+ */
+static __isl_give isl_printer *print_for_with_adder_tree(
+    __isl_keep isl_ast_node *node, __isl_take isl_printer *p,
+    struct autosa_kernel_stmt *stmt, struct print_hw_module_data *hw_data,
+    __isl_keep pet_expr *acc, __isl_keep pet_expr *x, __isl_keep pet_expr *y)
+{
+  struct autosa_prog *prog = hw_data->prog;
+  struct autosa_kernel *kernel = hw_data->module ? hw_data->module->kernel : NULL;
+  isl_ast_expr *iter;
+  isl_id *id;
+  const char *type = NULL;
+  long n;
+  char *name;
+
+  n = autosa_ast_node_for_n_iter(node);
+  iter = isl_ast_node_for_get_iterator(node);
+  name = isl_ast_expr_to_C_str(iter);
+  isl_ast_expr_free(iter);
+  id = pet_expr_access_get_id(acc);
+  for (int i = 0; i < prog->n_array; i++)
+  {
+    if (!strcmp(prog->array[i].name, isl_id_get_name(id)))
+      type = prog->array[i].type;
+  }
+  isl_id_free(id);
+
+  if (kernel)
+  {
+    int lat = type ? autosa_op_latency(kernel->options, type, pet_op_add) : AUTOSA_LAT_COMPUTE;
+    if (kernel->lat_hide_len < lat)
+      printf("[AutoSA] Warning: %s: The latency hiding factor (%d) is smaller than the adder latency (%d), increase the latency hiding tile sizes to achieve II=1.\n",
+             hw_data->module->name, kernel->lat_hide_len, lat);
+  }
+
+  p = print_str_new_line(p, "/* Adder tree of the SIMD reduction */");
+  p = print_str_new_line(p, "{");
+  p = isl_printer_indent(p, 4);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, type);
+  p = isl_printer_print_str(p, " acc_s[");
+  p = isl_printer_print_int(p, n);
+  p = isl_printer_print_str(p, "];");
+  p = isl_printer_end_line(p);
+  p = print_str_new_line(p, "#pragma HLS ARRAY_PARTITION variable=acc_s complete");
+
+  /* Products */
+  p = print_str_new_line(p, "#pragma HLS UNROLL");
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "for (int ");
+  p = isl_printer_print_str(p, name);
+  p = isl_printer_print_str(p, " = 0; ");
+  p = isl_printer_print_str(p, name);
+  p = isl_printer_print_str(p, " < ");
+  p = isl_printer_print_int(p, n);
+  p = isl_printer_print_str(p, "; ");
+  p = isl_printer_print_str(p, name);
+  p = isl_printer_print_str(p, "++) {");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, 4);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "acc_s[");
+  p = isl_printer_print_str(p, name);
+  p = isl_printer_print_str(p, "] = ");
+  p = print_dsp_pack_access(p, stmt, x, NULL);
+  p = isl_printer_print_str(p, " * ");
+  p = print_dsp_pack_access(p, stmt, y, NULL);
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "}");
+
+  /* Pairwise additions */
+  p = print_str_new_line(p, "#pragma HLS UNROLL");
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "for (int stride = 1; stride < ");
+  p = isl_printer_print_int(p, n);
+  p = isl_printer_print_str(p, "; stride *= 2) {");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, 4);
+  p = print_str_new_line(p, "#pragma HLS UNROLL");
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "for (int ");
+  p = isl_printer_print_str(p, name);
+  p = isl_printer_print_str(p, " = 0; ");
+  p = isl_printer_print_str(p, name);
+  p = isl_printer_print_str(p, " + stride < ");
+  p = isl_printer_print_int(p, n);
+  p = isl_printer_print_str(p, "; ");
+  p = isl_printer_print_str(p, name);
+  p = isl_printer_print_str(p, " += 2 * stride) {");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, 4);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "acc_s[");
+  p = isl_printer_print_str(p, name);
+  p = isl_printer_print_str(p, "] += acc_s[");
+  p = isl_printer_print_str(p, name);
+  p = isl_printer_print_str(p, " + stride];");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "}");
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "}");
+
+  /* acc += acc_s[0]; */
+  p = isl_printer_start_line(p);
+  p = print_dsp_pack_access(p, stmt, acc, NULL);
+  p = isl_printer_print_str(p, " += acc_s[0];");
+  p = isl_printer_end_line(p);
+
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "}");
+
+  free(name);
+
+  return p;
+}
+
+/* Return the type of the iterator of the for node "node", as printed
+ * by print_for_narrowed.
+ */
+static std::string for_node_iterator_type(__isl_keep isl_ast_node *node)
+{
+  isl_id *id;
+  struct autosa_ast_node_userinfo *info = NULL;
+  std::string type;
+
+  id = isl_ast_node_get_annotation(node);
+  if (id)
+    info = (struct autosa_ast_node_userinfo *)isl_id_get_user(id);
+  if (info && info->iter_bits > 0)
+    type = std::string(info->iter_signed ? "ap_int<" : "ap_uint<") +
+           std::to_string(info->iter_bits) + ">";
+  else
+    type = isl_options_get_ast_iterator_type(isl_ast_node_get_ctx(node));
+  isl_id_free(id);
+
+  return type;
+}
+
+/* Is "name" the name of a mark printed as an HLS pragma of the enclosing
+ * loop, i.e., "hls_pipeline", "hls_unroll" or "hls_dependence.<var>"?
+ */
+static int is_pragma_mark(const char *name)
+{
+  return !strcmp(name, "hls_pipeline") || !strcmp(name, "hls_unroll") ||
+         !strncmp(name, "hls_dependence.", strlen("hls_dependence."));
+}
+
+/* Collect the names of the pragma marks in "node" that are not enclosed
+ * by another loop, i.e., the marks applying to the loop whose body is
+ * "node", in "marks".
+ * The degenerate loops are not printed as loops and are looked through.
+ * "in_loop" is set if "node" is enclosed by such another loop, in which
+ * case only "inner_pipeline" is set if the loop is pipelined.
+ */
+static void collect_loop_pragma_marks(__isl_keep isl_ast_node *node,
+                                      std::vector<std::string> &marks, int in_loop, int *inner_pipeline)
+{
+  switch (isl_ast_node_get_type(node))
+  {
+  case isl_ast_node_for:
+  {
+    isl_ast_node *body = isl_ast_node_for_get_body(node);
+    int degenerate = isl_ast_node_for_is_degenerate(node) == isl_bool_true;
+
+    collect_loop_pragma_marks(body, marks, in_loop || !degenerate,
+                              inner_pipeline);
+    isl_ast_node_free(body);
+    break;
+  }
+  case isl_ast_node_block:
+  {
+    isl_ast_node_list *list = isl_ast_node_block_get_children(node);
+    int n = isl_ast_node_list_n_ast_node(list);
+
+    for (int i = 0; i < n; i++)
+    {
+      isl_ast_node *child = isl_ast_node_list_get_ast_node(list, i);
+      collect_loop_pragma_marks(child, marks, in_loop, inner_pipeline);
+      isl_ast_node_free(child);
+    }
+    isl_ast_node_list_free(list);
+    break;
+  }
+  case isl_ast_node_if:
+  {
+    isl_ast_node *child = isl_ast_node_if_get_then_node(node);
+
+    collect_loop_pragma_marks(child, marks, in_loop, inner_pipeline);
+    isl_ast_node_free(child);
+    child = isl_ast_node_if_get_else_node(node);
+    if (child)
+    {
+      collect_loop_pragma_marks(child, marks, in_loop, inner_pipeline);
+      isl_ast_node_free(child);
+    }
+    break;
+  }
+  case isl_ast_node_mark:
+  {
+    isl_id *id = isl_ast_node_mark_get_id(node);
+    std::string name = isl_id_get_name(id);
+    isl_ast_node *child;
+
+    isl_id_free(id);
+    if (in_loop && name == "hls_pipeline")
+      *inner_pipeline = 1;
+    else if (!in_loop && is_pragma_mark(name.c_str()) &&
+             std::find(marks.begin(), marks.end(), name) == marks.end())
+      marks.push_back(name);
+    child = isl_ast_node_mark_get_node(node);
+    collect_loop_pragma_marks(child, marks, in_loop, inner_pipeline);
+    isl_ast_node_free(child);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+/* Return the first node in "node" that is not a pragma mark,
+ * i.e., skip the marks at the top of a loop body that are printed as
+ * the pragmas of the loop.
+ */
+static __isl_give isl_ast_node *skip_pragma_marks(__isl_take isl_ast_node *node)
+{
+  while (node && isl_ast_node_get_type(node) == isl_ast_node_mark)
+  {
+    isl_id *id = isl_ast_node_mark_get_id(node);
+    int pragma = is_pragma_mark(isl_id_get_name(id));
+    isl_ast_node *child;
+
+    isl_id_free(id);
+    if (!pragma)
+      break;
+    child = isl_ast_node_mark_get_node(node);
+    isl_ast_node_free(node);
+    node = child;
+  }
+
+  return node;
+}
+
+/* Print the HLS pragmas of the marks "marks" of a loop.
+ * A loop enclosing a pipelined loop ("inner_pipeline") is not pipelined,
+ * and the dependence pragmas only apply to a pipelined loop.
+ */
+static __isl_give isl_printer *print_loop_pragmas(__isl_take isl_printer *p,
+                                                  std::vector<std::string> &marks, int inner_pipeline)
+{
+  int pipeline = !inner_pipeline &&
+                 std::find(marks.begin(), marks.end(), "hls_pipeline") != marks.end();
+
+  if (pipeline)
+    p = print_str_new_line(p, "#pragma HLS PIPELINE II=1");
+  for (size_t i = 0; i < marks.size() && pipeline; i++)
+  {
+    if (!strncmp(marks[i].c_str(), "hls_dependence.", strlen("hls_dependence.")))
+    {
+      std::string var = marks[i].substr(marks[i].rfind('.') + 1);
+
+      p = isl_printer_start_line(p);
+      p = isl_printer_print_str(p, "#pragma HLS DEPENDENCE variable=");
+      p = isl_printer_print_str(p, var.c_str());
+      p = isl_printer_print_str(p, " inter false");
+      p = isl_printer_end_line(p);
+    }
+  }
+  if (std::find(marks.begin(), marks.end(), "hls_unroll") != marks.end())
+    p = print_str_new_line(p, "#pragma HLS UNROLL");
+
+  return p;
+}
+
+/* Print the for node "node" with the HLS pragmas of the marks "marks"
+ * at the top of its body, e.g.,
+ *
+ *   for (ap_uint<3> c3 = 0; c3 <= 7; c3 += 1) {
+ *   #pragma HLS PIPELINE II=1
+ *     ...
+ *   }
+ *
+ * The pragma marks at the top of the body are not printed.
+ */
+static __isl_give isl_printer *print_for_with_pragmas(
+    __isl_keep isl_ast_node *node, __isl_take isl_printer *p,
+    __isl_take isl_ast_print_options *print_options,
+    std::vector<std::string> &marks, int inner_pipeline)
+{
+  isl_ast_expr *iter, *expr;
+  isl_ast_node *body;
+
+  iter = isl_ast_node_for_get_iterator(node);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "for (");
+  p = isl_printer_print_str(p, for_node_iterator_type(node).c_str());
+  p = isl_printer_print_str(p, " ");
+  p = isl_printer_print_ast_expr(p, iter);
+  p = isl_printer_print_str(p, " = ");
+  expr = isl_ast_node_for_get_init(node);
+  p = isl_printer_print_ast_expr(p, expr);
+  isl_ast_expr_free(expr);
+  p = isl_printer_print_str(p, "; ");
+  expr = isl_ast_node_for_get_cond(node);
+  p = isl_printer_print_ast_expr(p, expr);
+  isl_ast_expr_free(expr);
+  p = isl_printer_print_str(p, "; ");
+  p = isl_printer_print_ast_expr(p, iter);
+  p = isl_printer_print_str(p, " += ");
+  expr = isl_ast_node_for_get_inc(node);
+  p = isl_printer_print_ast_expr(p, expr);
+  isl_ast_expr_free(expr);
+  p = isl_printer_print_str(p, ") {");
+  p = isl_printer_end_line(p);
+  isl_ast_expr_free(iter);
+
+  p = isl_printer_indent(p, 2);
+  p = print_loop_pragmas(p, marks, inner_pipeline);
+  body = skip_pragma_marks(isl_ast_node_for_get_body(node));
+  p = isl_ast_node_print(body, p, print_options);
+  isl_ast_node_free(body);
+  p = isl_printer_indent(p, -2);
+  p = print_str_new_line(p, "}");
+
+  return p;
+}
+
+/* Print the perfect loop nest "loops" with the numbers of iterations
+ * "n_iters" ending at the "hls_pipeline" mark "mark" as a single flattened
+ * loop, e.g.,
+ *
+ *   {
+ *     ap_uint<3> c3 = 0;
+ *     ap_uint<4> c4 = 0;
+ *     for (ap_uint<5> c3_c4 = 0; c3_c4 < 16; c3_c4++) {
+ *     #pragma HLS PIPELINE II=1
+ *       ...
+ *       c4++;
+ *       if (c4 == 8) {
+ *         c4 = 0;
+ *         c3++;
+ *       }
+ *     }
+ *   }
+ *
+ * The original iterators are kept as counters updated at the end of each
+ * iteration, such that the body is printed unchanged and no division is
+ * needed to recover them. The pipeline then runs across the boundaries of
+ * the inner loops, instead of being drained and refilled for each iteration
+ * of the outer loops.
+ */
+static __isl_give isl_printer *print_for_with_flatten(
+    __isl_take isl_printer *p, __isl_take isl_ast_print_options *print_options,
+    std::vector<isl_ast_node *> &loops, std::vector<long> &n_iters,
+    __isl_keep isl_ast_node *mark)
+{
+  std::vector<std::string> names;
+  std::vector<std::string> marks;
+  std::string flat_name;
+  long n_flat = 1;
+  int bits = 0;
+  int inner_pipeline = 0;
+  int n = loops.size();
+  isl_ast_node *body;
+
+  for (int i = 0; i < n; i++)
+  {
+    isl_ast_expr *iter = isl_ast_node_for_get_iterator(loops[i]);
+    isl_id *id = isl_ast_expr_get_id(iter);
+    names.push_back(isl_id_get_name(id));
+    isl_id_free(id);
+    isl_ast_expr_free(iter);
+    flat_name += (i > 0 ? "_" : "") + names[i];
+    n_flat *= n_iters[i];
+  }
+  while (bits < 32 && (1L << bits) <= n_flat)
+    bits++;
+
+  p = print_str_new_line(p, "{");
+  p = isl_printer_indent(p, 2);
+  for (int i = 0; i < n; i++)
+  {
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, for_node_iterator_type(loops[i]).c_str());
+    p = isl_printer_print_str(p, " ");
+    p = isl_printer_print_str(p, names[i].c_str());
+    p = isl_printer_print_str(p, " = 0;");
+    p = isl_printer_end_line(p);
+  }
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "for (");
+  if (bits < 32)
+  {
+    p = isl_printer_print_str(p, "ap_uint<");
+    p = isl_printer_print_int(p, bits);
+    p = isl_printer_print_str(p, ">");
+  }
+  else
+  {
+    p = isl_printer_print_str(p, isl_options_get_ast_iterator_type(isl_printer_get_ctx(p)));
+  }
+  p = isl_printer_print_str(p, " ");
+  p = isl_printer_print_str(p, flat_name.c_str());
+  p = isl_printer_print_str(p, " = 0; ");
+  p = isl_printer_print_str(p, flat_name.c_str());
+  p = isl_printer_print_str(p, " < ");
+  p = isl_printer_print_str(p, std::to_string(n_flat).c_str());
+  p = isl_printer_print_str(p, "; ");
+  p = isl_printer_print_str(p, flat_name.c_str());
+  p = isl_printer_print_str(p, "++) {");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, 2);
+
+  collect_loop_pragma_marks(mark, marks, 0, &inner_pipeline);
+  p = print_loop_pragmas(p, marks, inner_pipeline);
+  body = skip_pragma_marks(isl_ast_node_copy(mark));
+  p = isl_ast_node_print(body, p, print_options);
+  isl_ast_node_free(body);
+
+  /* Advance the counters, innermost first. */
+  for (int i = n - 1; i >= 0; i--)
+  {
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, names[i].c_str());
+    p = isl_printer_print_str(p, "++;");
+    p = isl_printer_end_line(p);
+    if (i == 0)
+      break;
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "if (");
+    p = isl_printer_print_str(p, names[i].c_str());
+    p = isl_printer_print_str(p, " == ");
+    p = isl_printer_print_str(p, std::to_string(n_iters[i]).c_str());
+    p = isl_printer_print_str(p, ") {");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, 2);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, names[i].c_str());
+    p = isl_printer_print_str(p, " = 0;");
+    p = isl_printer_end_line(p);
+  }
+  for (int i = 1; i < n; i++)
+  {
+    p = isl_printer_indent(p, -2);
+    p = print_str_new_line(p, "}");
+  }
+
+  p = isl_printer_indent(p, -2);
+  p = print_str_new_line(p, "}");
+  p = isl_printer_indent(p, -2);
+  p = print_str_new_line(p, "}");
+
+  return p;
+}
+
+static __isl_give isl_printer *print_for_xilinx(__isl_take isl_printer *p,
+                                                __isl_take isl_ast_print_options *print_options,
+                                                __isl_keep isl_ast_node *node, void *user)
+{
+  struct print_hw_module_data *hw_data = (struct print_hw_module_data *)user;
+  struct autosa_kernel_stmt *stmt;
+  struct autosa_ast_node_userinfo *info;
+  std::vector<std::string> marks;
+  isl_ast_node *body;
+  isl_id *id;
+  int pipeline;
+  int unroll;
+  int inner_pipeline = 0;
+
+  info = NULL;
+  id = isl_ast_node_get_annotation(node);
+  if (id)
+    info = (struct autosa_ast_node_userinfo *)isl_id_get_user(id);
+
+  /* The pragmas of the loop are given by the marks in its body. */
+  if (isl_ast_node_for_is_degenerate(node) != isl_bool_true)
+  {
+    body = isl_ast_node_for_get_body(node);
+    collect_loop_pragma_marks(body, marks, 0, &inner_pipeline);
+    isl_ast_node_free(body);
+  }
+  pipeline = !inner_pipeline &&
+             std::find(marks.begin(), marks.end(), "hls_pipeline") != marks.end();
+  unroll = std::find(marks.begin(), marks.end(), "hls_unroll") != marks.end();
+
+  if (unroll && hw_data->prog->scop->options->autosa->dsp_pack)
+  {
+    pet_expr *acc = NULL, *x = NULL, *y = NULL;
+
+    stmt = extract_dsp_pack_stmt(node, hw_data->prog, &acc, &x, &y);
+    if (stmt)
+    {
+      p = print_for_with_dsp_pack(node, p, stmt, hw_data->prog, acc, x, y);
+      isl_ast_print_options_free(print_options);
+      pet_expr_free(acc);
+      pet_expr_free(x);
+      pet_expr_free(y);
+      isl_id_free(id);
+      return p;
+    }
+  }
+
+  if (unroll && hw_data->prog->scop->options->autosa->adder_tree)
+  {
+    pet_expr *acc = NULL, *x = NULL, *y = NULL;
+
+    stmt = extract_adder_tree_stmt(node, hw_data->prog, &acc, &x, &y);
+    if (stmt)
+    {
+      p = print_for_with_adder_tree(node, p, stmt, hw_data, acc, x, y);
+      isl_ast_print_options_free(print_options);
+      pet_expr_free(acc);
+      pet_expr_free(x);
+      pet_expr_free(y);
+      isl_id_free(id);
+      return p;
+    }
+  }
+
+  /* Flatten the perfect loop nests ending at a pipelined loop in the
+   * I/O modules. */
+  if (!pipeline && !unroll && hw_data->module &&
+      hw_data->module->type != PE_MODULE &&
+      hw_data->prog->scop->options->autosa->loop_flatten)
+  {
+    std::vector<isl_ast_node *> loops;
+    std::vector<long> n_iters;
+    isl_ast_node *mark;
+
+    mark = autosa_ast_node_extract_flatten_nest(node, loops, n_iters);
+    if (mark)
+    {
+      p = print_for_with_flatten(p, print_options, loops, n_iters, mark);
+      isl_ast_node_free(mark);
+      for (int i = 0; i < loops.size(); i++)
+        isl_ast_node_free(loops[i]);
+      isl_id_free(id);
+      return p;
+    }
+  }
+
+  if (!marks.empty())
+    p = print_for_with_pragmas(node, p, print_options, marks, inner_pipeline);
+  else
+    p = print_for_narrowed(node, p, print_options, info);
+
+  isl_id_free(id);
+
+  return p;
+}
+
+/* Print the intra_trans module.
+ */
+static __isl_give isl_printer *autosa_print_intra_trans_module(
+    __isl_take isl_printer *p,
+    struct autosa_hw_module *module, struct autosa_prog *prog,
+    struct hls_info *hls, int boundary)
+{
+  struct print_hw_module_data hw_data = {hls, prog, module};
+  isl_ast_print_options *print_options;
+  isl_ctx *ctx = isl_printer_get_ctx(p);
+
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "/* Module Definition */");
+  p = isl_printer_end_line(p);
+
+  print_module_headers_xilinx(prog, module, hls, 0, boundary);
+  fprintf(hls->kernel_c, "{\n");
+  if (hls->target == XILINX_HW)
+    fprintf(hls->kernel_c, "#pragma HLS INLINE OFF\n");
+  p = isl_printer_indent(p, 4);
+  p = print_str_new_line(p, "/* Variable Declaration */");
+  print_module_iterators(hls->kernel_c, module);
+  p = print_module_vars_xilinx(p, module, 0);
+  if (hls->target == XILINX_HW)
+    p = print_module_split_buf_xilinx(p, module->intra_tree, hls);
+  p = print_str_new_line(p, "/* Variable Declaration */");
+  p = isl_printer_end_line(p);
+
+  if (module->double_buffer)
+  {
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "if (!intra_trans_en) return;");
+    p = isl_printer_end_line(p);
+    p = isl_printer_end_line(p);
+  }
+
+  print_options = isl_ast_print_options_alloc(ctx);
+  print_options = isl_ast_print_options_set_print_user(print_options,
+                                                       &print_module_stmt, &hw_data);
+  if (hls->target == XILINX_HW)
+  {
+    print_options = isl_ast_print_options_set_print_for(print_options,
+                                                        &print_for_xilinx, &hw_data);
+  }
+
+  p = isl_ast_node_print(module->intra_tree, p, print_options);
+  p = isl_printer_indent(p, -4);
+  hls->split_buf_lifted = 0;
+
+  fprintf(hls->kernel_c, "}\n");
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "/* Module Definition */");
+  p = isl_printer_end_line(p);
+
+  p = isl_printer_end_line(p);
+
+  return p;
+}
+
+/* Print the inter_trans module.
+ */
+static __isl_give isl_printer *autosa_print_inter_trans_module(
+    __isl_take isl_printer *p,
+    struct autosa_hw_module *module, struct autosa_prog *prog,
+    struct hls_info *hls, int boundary)
+{
+  struct print_hw_module_data hw_data = {hls, prog, module};
+  isl_ast_print_options *print_options;
+  isl_ctx *ctx = isl_printer_get_ctx(p);
+
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "/* Module Definition */");
+  p = isl_printer_end_line(p);
+
+  if (hls->target == XILINX_HW)
+    print_module_headers_xilinx(prog, module, hls, 1, boundary);
+  fprintf(hls->kernel_c, "{\n");
+  fprintf(hls->kernel_c, "#pragma HLS INLINE OFF\n");
+  p = isl_printer_indent(p, 4);
+  p = print_str_new_line(p, "/* Variable Declaration */");
+  print_module_iterators(hls->kernel_c, module);
+  if (hls->target == XILINX_HW)
+  {
+    p = print_module_vars_xilinx(p, module, 1);
+    p = print_module_split_buf_xilinx(p,
+                                      boundary == 0 ? module->inter_tree : module->boundary_inter_tree, hls);
+  }
+  p = print_str_new_line(p, "/* Variable Declaration */");
+  p = isl_printer_end_line(p);
+
+  if (module->double_buffer)
+  {
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "if (!inter_trans_en) return;");
+    p = isl_printer_end_line(p);
+    p = isl_printer_end_line(p);
+  }
+
+  print_options = isl_ast_print_options_alloc(ctx);
+  print_options = isl_ast_print_options_set_print_user(print_options,
+                                                       &print_module_stmt, &hw_data);
+  if (hls->target == XILINX_HW)
+  {
+    print_options = isl_ast_print_options_set_print_for(print_options,
+                                                        &print_for_xilinx, &hw_data);
+  }
+
+  p = isl_ast_node_print((boundary == 0) ? module->inter_tree : module->boundary_inter_tree, p, print_options);
+  p = isl_printer_indent(p, -4);
+  hls->split_buf_lifted = 0;
+
+  fprintf(hls->kernel_c, "}\n");
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "/* Module Definition */");
+  p = isl_printer_end_line(p);
+
+  p = isl_printer_end_line(p);
+
+  return p;
+}
+
+/* Print the drained data merge functions. 
+ */
+static isl_stat print_drain_merge_funcs(
+    struct autosa_kernel *kernel,
+    struct autosa_drain_merge_func **funcs, int n_funcs,
+    struct hls_info *hls)
+{
+  isl_printer *p;
+  isl_ctx *ctx;
+
+  if (n_funcs == 0)
+    return isl_stat_ok;
+
+  ctx = kernel->ctx;
+  if (!hls->hls)
+    p = isl_printer_to_file(kernel->ctx, hls->host_h);
+  else
+    p = isl_printer_to_file(kernel->ctx, hls->kernel_h);
+  p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+  for (int i = 0; i < n_funcs; i++)
+  {
+    struct autosa_array_ref_group *group = funcs[i]->group;
+    isl_ast_print_options *print_options;
+    struct print_hw_module_data hw_data = {hls, NULL, NULL};
+
+    p = print_str_new_line(p, "/* Helper Function */");
+    p = isl_printer_start_line(p);
+    if (hls->hls)
+      p = isl_printer_print_str(p, "inline ");
+    p = isl_printer_print_str(p, "void ");
+    p = autosa_array_ref_group_print_prefix(group, p);
+    p = isl_printer_print_str(p, "_drain_merge(");
+    p = print_drain_merge_arguments_xilinx(p, kernel, group, funcs[i], 1, hls->hls, 0,
+                                           host_unpack_fused(kernel, hls->hls, hls->host_batch,
+                                                             kernel->options->autosa->multi_device));
+    p = isl_printer_print_str(p, "){");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, 4);
+
+    p = print_str_new_line(p, "/* Variable Declaration */");
+    if (!hls->hls)
+      print_func_iterators(hls->host_h, funcs[i]);
+    else
+      print_func_iterators(hls->kernel_h, funcs[i]);
+    p = print_str_new_line(p, "/* Variable Declaration */");
+    p = isl_printer_end_line(p);
+
+    print_options = isl_ast_print_options_alloc(ctx);
+    print_options = isl_ast_print_options_set_print_user(print_options,
+                                                         &print_module_stmt, &hw_data);
+    p = isl_ast_node_print(funcs[i]->device_tree, p, print_options);
+
+    p = isl_printer_indent(p, -4);
+    p = print_str_new_line(p, "}");
+    p = print_str_new_line(p, "/* Helper Function */");
+  }
+  p = isl_printer_end_line(p);
+  isl_printer_free(p);
+
+  return isl_stat_ok;
+}
+
+/* Can the array accessed by the I/O module "module" be serialized by the host
+ * in the order in which "module" accesses the external memory?
+ * This requires "module" to be the only module accessing the array,
+ * through a single memory port, with the accesses in a single AST without
+ * module identifiers or parameters.
+ */
+static int io_module_is_host_serializable(struct autosa_hw_module *module)
+{
+  struct autosa_local_array_info *local_array;
+  struct autosa_array_info *array;
+  isl_space *space;
+  int nparam;
+
+  if (!module->to_mem || module->is_buffer || module->boundary)
+    return 0;
+  if (module->n_io_group != 1 || isl_id_list_n_id(module->inst_ids) > 0)
+    return 0;
+
+  local_array = module->io_groups[0]->local_array;
+  array = local_array->array;
+  if (local_array->n_io_group_refs != 1 || local_array->n_mem_ports != 1)
+    return 0;
+  if (!array->linearize || (array->copy_in && array->copy_out))
+    return 0;
+
+  space = isl_union_set_get_space(module->kernel->arrays);
+  nparam = isl_space_dim(space, isl_dim_param);
+  isl_space_free(space);
+
+  return nparam == 0;
+}
+
+/* Print the code that closes the current block of the compressed
+ * serialized array "ser" of type "type" with "n_lane" elements per access.
+ * The block starts with a header access at position "hdr".
+ * If all the elements of the block are zero, the block is dropped and
+ * only its header, which is left zero, is kept.
+ * Otherwise, the first element of the header is set to one.
+ */
+static __isl_give isl_printer *print_host_sparse_block_end(
+    __isl_take isl_printer *p, const char *type, int n_lane)
+{
+  p = print_str_new_line(p, "if (ser) {");
+  p = isl_printer_indent(p, 2);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "if (std::count(ser + hdr + ");
+  p = isl_printer_print_int(p, n_lane);
+  p = isl_printer_print_str(p, ", ser + cnt, (");
+  p = isl_printer_print_str(p, type);
+  p = isl_printer_print_str(p, ")0) == (long)(cnt - hdr - ");
+  p = isl_printer_print_int(p, n_lane);
+  p = isl_printer_print_str(p, "))");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, 2);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "cnt = hdr + ");
+  p = isl_printer_print_int(p, n_lane);
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, -2);
+  p = print_str_new_line(p, "else");
+  p = isl_printer_indent(p, 2);
+  p = print_str_new_line(p, "ser[hdr] = 1;");
+  p = isl_printer_indent(p, -2);
+  p = isl_printer_indent(p, -2);
+  p = print_str_new_line(p, "}");
+
+  return p;
+}
+
+/* Print the host counterpart of an I/O dram statement.
+ * The elements accessed by the statement are copied between the original
+ * array "orig" and the serialized array "ser", at position "cnt".
+ * No data is copied if the destination is NULL, in which case only
+ * the size of the serialized array is computed.
+ *
+ * If the array is block-sparse, each block of "host_sparse_block" accesses
+ * is preceded by a header access, and the blocks with only zero elements
+ * are dropped once they are complete.
+ * The size computed without data is then the size of
+ * the uncompressed array with the headers.
+ *
+ * With "--AutoSA-host-simd-unpack", the elements read back from
+ * the serialized array are unpacked by autosa_unpack.
+ */
+static __isl_give isl_printer *print_host_serialize_stmt(
+    __isl_take isl_printer *p,
+    __isl_take isl_ast_print_options *print_options,
+    __isl_keep isl_ast_node *node, void *user)
+{
+  isl_id *id;
+  struct autosa_kernel_stmt *stmt;
+  struct hls_info *hls = (struct hls_info *)user;
+  isl_ast_expr *index;
+  int n_lane;
+  int n_block;
+
+  id = isl_ast_node_get_annotation(node);
+  stmt = (struct autosa_kernel_stmt *)isl_id_get_user(id);
+  isl_id_free(id);
+
+  isl_ast_print_options_free(print_options);
+
+  if (stmt->type != AUTOSA_KERNEL_STMT_IO_DRAM)
+    return p;
+
+  n_lane = stmt->u.i.data_pack;
+  n_block = stmt->u.i.local_array->host_sparse_block;
+  index = isl_ast_expr_get_op_arg(stmt->u.i.index, 1);
+
+  if (n_block > 0)
+  {
+    p = print_str_new_line(p, "if (blk == 0) {");
+    p = isl_printer_indent(p, 2);
+    p = print_str_new_line(p, "hdr = cnt;");
+    p = print_str_new_line(p, "if (ser)");
+    p = isl_printer_indent(p, 2);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "std::fill(ser + cnt, ser + cnt + ");
+    p = isl_printer_print_int(p, n_lane);
+    p = isl_printer_print_str(p, ", 0);");
     p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, -2);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "cnt += ");
+    p = isl_printer_print_int(p, n_lane);
+    p = isl_printer_print_str(p, ";");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, -2);
+    p = print_str_new_line(p, "}");
   }
 
-  /* Print pong buffer */
-  if (double_buffer)
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, stmt->u.i.in ? "if (ser)" : "if (orig)");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, 2);
+  p = isl_printer_start_line(p);
+  if (stmt->u.i.in)
+  {
+    p = isl_printer_print_str(p, "std::copy(orig + (");
+    p = isl_printer_print_ast_expr(p, index);
+    p = isl_printer_print_str(p, ") * ");
+    p = isl_printer_print_int(p, n_lane);
+    p = isl_printer_print_str(p, ", orig + (");
+    p = isl_printer_print_ast_expr(p, index);
+    p = isl_printer_print_str(p, " + 1) * ");
+    p = isl_printer_print_int(p, n_lane);
+    p = isl_printer_print_str(p, ", ser + cnt);");
+  }
+  else if (hls->host_simd_unpack)
+  {
+    p = isl_printer_print_str(p, "autosa_unpack<");
+    p = isl_printer_print_int(p, n_lane);
+    p = isl_printer_print_str(p, ">(orig + (");
+    p = isl_printer_print_ast_expr(p, index);
+    p = isl_printer_print_str(p, ") * ");
+    p = isl_printer_print_int(p, n_lane);
+    p = isl_printer_print_str(p, ", ser + cnt);");
+  }
+  else
+  {
+    p = isl_printer_print_str(p, "std::copy(ser + cnt, ser + cnt + ");
+    p = isl_printer_print_int(p, n_lane);
+    p = isl_printer_print_str(p, ", orig + (");
+    p = isl_printer_print_ast_expr(p, index);
+    p = isl_printer_print_str(p, ") * ");
+    p = isl_printer_print_int(p, n_lane);
+    p = isl_printer_print_str(p, ");");
+  }
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, -2);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "cnt += ");
+  p = isl_printer_print_int(p, n_lane);
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
+
+  if (n_block > 0)
   {
     p = isl_printer_start_line(p);
-    if (var->n_lane == 1)
-      p = isl_printer_print_str(p, var->array->type);
-    else
+    p = isl_printer_print_str(p, "if (++blk == ");
+    p = isl_printer_print_int(p, n_block);
+    p = isl_printer_print_str(p, ") {");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, 2);
+    p = print_str_new_line(p, "blk = 0;");
+    p = print_host_sparse_block_end(p, stmt->u.i.array->type, n_lane);
+    p = isl_printer_indent(p, -2);
+    p = print_str_new_line(p, "}");
+  }
+
+  isl_ast_expr_free(index);
+
+  return p;
+}
+
+/* Print the host functions that serialize the arrays read by the kernel
+ * into the order in which their I/O modules access the external memory,
+ * and deserialize the arrays written by the kernel.
+ * Each function walks the same AST as the I/O module and returns the number
+ * of elements of the serialized array.
+ * The arrays selected by "--autosa-qdma-stream" among the serialized arrays
+ * that are only read by the kernel are streamed to the kernel instead.
+ * The serialized arrays are marked in their local array info, such that
+ * the I/O modules access them sequentially.
+ *
+ * The arrays read by the kernel and declared as block-sparse by
+ * "--autosa-block-sparse" are compressed into their non-zero blocks.
+ * The block size is rounded down to a multiple of the number of elements
+ * per DRAM access.
+ */
+static isl_stat print_host_serialize_funcs(
+    struct autosa_hw_module **modules, int n_modules, struct hls_info *hls)
+{
+  isl_printer *p;
+
+  for (int i = 0; i < n_modules; i++)
+  {
+    struct autosa_hw_module *module = modules[i];
+    struct autosa_array_info *array;
+    isl_ast_print_options *print_options;
+    int n_lane, n_block;
+
+    if (!hls->host_serialize)
     {
-      p = isl_printer_print_str(p, var->array->name);
-      p = isl_printer_print_str(p, "_t");
-      p = isl_printer_print_int(p, var->n_lane);
+      if (module->to_mem && module->n_io_group > 0 &&
+          autosa_sparse_block_size(module->options, module->io_groups[0]->array->name) > 0)
+        printf("[AutoSA] Warning: Block-sparse array %s requires --AutoSA-host-serialize, it is transferred as dense.\n",
+               module->io_groups[0]->array->name);
+      continue;
     }
-    p = isl_printer_print_str(p, " ");
-    p = isl_printer_print_str(p, var->name);
-    if (double_buffer)
-      p = isl_printer_print_str(p, "_pong");
-    for (j = 0; j < isl_vec_size(var->size); ++j)
+    if (!io_module_is_host_serializable(module))
     {
-      isl_val *v;
+      if (module->to_mem && module->n_io_group > 0 &&
+          autosa_sparse_block_size(module->options, module->io_groups[0]->array->name) > 0)
+        printf("[AutoSA] Warning: Block-sparse array %s can't be serialized by the host, it is transferred as dense.\n",
+               module->io_groups[0]->array->name);
+      if (module->to_mem && module->n_io_group > 0 &&
+          autosa_qdma_stream_selected(module->options, module->io_groups[0]->array->name))
+        printf("[AutoSA] Warning: Array %s can't be serialized by the host, it is transferred through the external memory.\n",
+               module->io_groups[0]->array->name);
+      continue;
+    }
 
-      p = isl_printer_print_str(p, "[");
-      v = isl_vec_get_element_val(var->size, j);
-      p = isl_printer_print_val(p, v);
-      isl_val_free(v);
-      p = isl_printer_print_str(p, "]");
+    array = module->io_groups[0]->array;
+    n_lane = module->io_groups[0]->io_buffers[module->io_groups[0]->io_level - 1]->n_lane;
+    n_block = array->copy_in ? autosa_sparse_block_size(module->options, array->name) / n_lane : 0;
+    if (n_block > 0)
+      module->io_groups[0]->local_array->host_sparse_block = n_block;
+    p = isl_printer_to_file(module->kernel->ctx, hls->host_h);
+    p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+
+    p = print_str_new_line(p, "/* Helper Function */");
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "unsigned long ");
+    p = print_host_serialize_func_name(p, array);
+    p = isl_printer_print_str(p, "(");
+    if (array->copy_in)
+    {
+      p = isl_printer_print_str(p, array->type);
+      p = isl_printer_print_str(p, " *ser, const ");
+      p = isl_printer_print_str(p, array->type);
+      p = isl_printer_print_str(p, " *orig");
     }
-    p = isl_printer_print_str(p, ";");
-    p = isl_printer_end_line(p);
-    if (use_memory && var->n_part != 1)
+    else
     {
-      p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "#pragma HLS ARRAY_PARTITION variable=");
-      p = isl_printer_print_str(p, var->name);
-      if (double_buffer)
-        p = isl_printer_print_str(p, "_pong");
-      p = isl_printer_print_str(p, " dim=");
-      p = isl_printer_print_int(p, isl_vec_size(var->size));
-      p = isl_printer_print_str(p, " factor=");
-      p = isl_printer_print_int(p, var->n_part);
-      p = isl_printer_print_str(p, " cyclic");
-      p = isl_printer_end_line(p);
+      p = isl_printer_print_str(p, array->type);
+      p = isl_printer_print_str(p, " *orig, const ");
+      p = isl_printer_print_str(p, array->type);
+      p = isl_printer_print_str(p, " *ser");
     }
-    if (use_memory)
+    p = isl_printer_print_str(p, "){");
+    p = isl_printer_end_line(p);
+    p = isl_printer_indent(p, 4);
+
+    p = print_str_new_line(p, "/* Variable Declaration */");
+    p = print_str_new_line(p, "unsigned long cnt = 0;");
+    if (n_block > 0)
+      p = print_str_new_line(p, "unsigned long hdr = 0, blk = 0;");
+    p = print_str_new_line(p, "/* Variable Declaration */");
+    p = isl_printer_end_line(p);
+
+    print_options = isl_ast_print_options_alloc(module->kernel->ctx);
+    print_options = isl_ast_print_options_set_print_user(print_options,
+                                                         &print_host_serialize_stmt, hls);
+    p = isl_ast_node_print(module->device_tree, p, print_options);
+    if (n_block > 0)
     {
-      p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "#pragma HLS ARRAY_MAP variable=");
-      p = isl_printer_print_str(p, var->name);
-      p = isl_printer_print_str(p, "_pong instance=");
-      p = isl_printer_print_str(p, var->name);
-      p = isl_printer_print_str(p, " horizontal");
-      p = isl_printer_end_line(p);
+      /* Close the last partial block. */
+      p = print_str_new_line(p, "if (blk != 0)");
+      p = print_str_new_line(p, "{");
+      p = isl_printer_indent(p, 2);
+      p = print_host_sparse_block_end(p, array->type, n_lane);
+      p = isl_printer_indent(p, -2);
+      p = print_str_new_line(p, "}");
+    }
 
-      p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "#pragma HLS RESOURCE variable=");
-      p = isl_printer_print_str(p, var->name);
-      p = isl_printer_print_str(p, "_pong");
-      p = isl_printer_print_str(p, use_memory == 1 ? " core=RAM_2P_LUTRAM" : (use_memory == 2 ? " core=RAM_2P_BRAM" : " core=RAM_2P_URAM"));
-      p = isl_printer_end_line(p);
+    p = print_str_new_line(p, "return cnt;");
+    p = isl_printer_indent(p, -4);
+    p = print_str_new_line(p, "}");
+    p = print_str_new_line(p, "/* Helper Function */");
+    p = isl_printer_end_line(p);
+    isl_printer_free(p);
+
+    module->io_groups[0]->local_array->host_serialize = 1;
+    if (n_block > 0)
+      printf("[AutoSA] Array %s is serialized by the host into blocks of %d elements, the zero blocks are skipped.\n",
+             array->name, n_block * n_lane);
+    else
+      printf("[AutoSA] Array %s is serialized by the host.\n", array->name);
+    if (autosa_qdma_stream_selected(module->options, array->name))
+    {
+      if (array->copy_out || n_block > 0)
+        printf("[AutoSA] Warning: Only the dense arrays read by the kernel can be streamed through QDMA. Array %s is transferred through the external memory.\n",
+               array->name);
+      else
+      {
+        module->io_groups[0]->local_array->host_stream = 1;
+        printf("[AutoSA] Array %s is streamed to the kernel through QDMA.\n", array->name);
+      }
     }
   }
 
-  return p;
+  return isl_stat_ok;
 }
 
-static __isl_give isl_printer *print_module_vars_xilinx(__isl_take isl_printer *p,
-                                                        struct autosa_hw_module *module, int inter)
+/* Return the number of lanes of the elements that the prefetching
+ * I/O module "module" accesses in the external memory, i.e., of its
+ * outermost I/O buffer.
+ */
+static int io_prefetch_n_lane(struct autosa_hw_module *module)
 {
-  int i, n;
-  isl_space *space;
-  const char *type;
+  struct autosa_array_ref_group *group = module->io_groups[0];
 
-  if (inter == -1)
+  for (int i = group->io_level; i >= 1; i--)
   {
-    for (i = 0; i < module->n_var; ++i)
-      p = print_module_var_xilinx(p, &module->var[i], module->double_buffer, module);
+    if (group->io_buffers[i - 1]->tile)
+      return group->io_buffers[i - 1]->n_lane;
   }
 
-  if (module->double_buffer && inter == -1)
-  {
-    type = isl_options_get_ast_iterator_type(module->kernel->ctx);
+  return group->io_buffers[0]->n_lane;
+}
 
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "bool arb = 0;");
-    p = isl_printer_end_line(p);
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, module->in ? "bool inter_trans_en = 1;" : "bool inter_trans_en = 0;");
-    p = isl_printer_end_line(p);
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, module->in ? "bool intra_trans_en = 0;" : "bool intra_trans_en = 1;");
-    p = isl_printer_end_line(p);
-    /* iterators */
-    space = (module->in) ? module->intra_space : module->inter_space;
-    n = isl_space_dim(space, isl_dim_set);
-    for (int i = 0; i < n; i++)
-    {
-      const char *name;
-      name = isl_space_get_dim_name(space, isl_dim_set, i);
-      p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, type);
-      p = isl_printer_print_str(p, " ");
-      p = isl_printer_print_str(p, name);
-      p = isl_printer_print_str(p, ", ");
-      p = isl_printer_print_str(p, name);
-      p = isl_printer_print_str(p, "_prev");
-      p = isl_printer_print_str(p, ";");
-      p = isl_printer_end_line(p);
+/* Print the header of the core of "module".
+ * For the processes of a prefetching module ("prefetch" set),
+ * the header of the DRAM process (1) or of the body process (2)
+ * is printed, which take the prefetch FIFO as an extra argument.
+ */
+static __isl_give isl_printer *print_module_core_header_xilinx(
+    __isl_take isl_printer *p,
+    struct autosa_prog *prog, struct autosa_hw_module *module,
+    int inter, int boundary, int types, int prefetch)
+{
+  p = isl_printer_start_line(p);
+  if (types)
+  {
+    p = print_module_template(p, module->kernel, module, 1, XILINX_HW);
+    p = isl_printer_print_str(p, "void ");
+  }
+  p = isl_printer_print_str(p, module->name);
+  if (inter == 0)
+    p = isl_printer_print_str(p, "_intra_trans");
+  else if (inter == 1)
+    p = isl_printer_print_str(p, "_inter_trans");
+  if (boundary)
+    p = isl_printer_print_str(p, "_boundary");
+  if (prefetch == 1)
+    p = isl_printer_print_str(p, "_dram");
+  else if (prefetch == 2)
+    p = isl_printer_print_str(p, "_body");
+  if (!types)
+    p = print_module_template(p, module->kernel, module, 0, XILINX_HW);
+  p = isl_printer_print_str(p, "(");
+  p = print_module_arguments(p, prog, module->kernel, module, types,
+                             XILINX_HW, inter, -1, boundary);
+  if (prefetch)
+  {
+    p = isl_printer_print_str(p, ", ");
+    if (types)
+    {
+      p = print_fifo_type_xilinx(p, module->io_groups[0],
+                                 io_prefetch_n_lane(module));
+      p = isl_printer_print_str(p, " &");
     }
+    p = isl_printer_print_str(p, "fifo_prefetch");
   }
+  p = isl_printer_print_str(p, ")");
 
   return p;
 }
 
-static __isl_give isl_printer *print_module_stmt(__isl_take isl_printer *p,
-                                                 __isl_take isl_ast_print_options *print_options,
-                                                 __isl_keep isl_ast_node *node, void *user)
+static __isl_give isl_printer *print_module_core_headers_xilinx(
+    __isl_take isl_printer *p, struct autosa_prog *prog,
+    struct autosa_hw_module *module, struct hls_info *hls,
+    int inter, int boundary, int types)
 {
-  isl_id *id;
-  struct autosa_kernel_stmt *stmt;
-  struct print_hw_module_data *hw_data = (struct print_hw_module_data *)(user);
-  struct autosa_hw_module *module = hw_data->module;
-
-  id = isl_ast_node_get_annotation(node);
-  stmt = (struct autosa_kernel_stmt *)isl_id_get_user(id);
-  isl_id_free(id);
+  p = print_module_core_header_xilinx(p, prog, module, inter, boundary, types,
+                                      hls->prefetch);
 
-  isl_ast_print_options_free(print_options);
+  return p;
+}
 
-  switch (stmt->type)
-  {
-    //    case POLYSA_KERNEL_STMT_COPY:
-    //      return autosa_kernel_print_copy(p, stmt);
-    //    case POLYSA_KERNEL_STMT_SYNC:
-    //      return print_sync(p, stmt);
-  case AUTOSA_KERNEL_STMT_DOMAIN:
-    return autosa_kernel_print_domain(p, stmt);
-  case AUTOSA_KERNEL_STMT_IO:
-    return autosa_kernel_print_io(p, stmt, hw_data->hls);
-  case AUTOSA_KERNEL_STMT_IO_TRANSFER:
-    return autosa_kernel_print_io_transfer(p, stmt, hw_data->hls);
-  case AUTOSA_KERNEL_STMT_IO_DRAM:
-    return autosa_kernel_print_io_dram(p, stmt, hw_data->hls);
-  case AUTOSA_KERNEL_STMT_IO_MODULE_CALL_INTER_TRANS:
-    return autosa_kernel_print_inter_trans(p, stmt, hw_data->hls);
-  case AUTOSA_KERNEL_STMT_IO_MODULE_CALL_INTRA_TRANS:
-    return autosa_kernel_print_intra_trans(p, stmt, hw_data->hls);
-  case AUTOSA_KERNEL_STMT_IO_MODULE_CALL_INTER_INTRA:
-    return autosa_kernel_print_inter_intra(p, stmt, hw_data->hls);
-  case AUTOSA_KERNEL_STMT_IO_MODULE_CALL_INTRA_INTER:
-    return autosa_kernel_print_intra_inter(p, stmt, hw_data->hls);
-  case AUTOSA_KERNEL_STMT_IO_MODULE_CALL_STATE_HANDLE:
-    return autosa_kernel_print_state_handle(p, stmt, hw_data->hls);
-  case AUTOSA_KERNEL_STMT_DRAIN_MERGE:
-    return autosa_kernel_print_drain_merge(p, stmt, hw_data->hls);
-  }
+static __isl_give isl_printer *print_module_wrapper_header_xilinx(
+    __isl_take isl_printer *p,
+    struct autosa_prog *prog, struct autosa_hw_module *module,
+    int inter, int boundary)
+{
+  p = isl_printer_start_line(p);
+  p = print_module_template(p, module->kernel, module, 1, XILINX_HW);
+  p = isl_printer_print_str(p, "void ");
+  p = isl_printer_print_str(p, module->name);
+  if (inter == 0)
+    p = isl_printer_print_str(p, "_intra_trans");
+  else if (inter == 1)
+    p = isl_printer_print_str(p, "_inter_trans");
+  if (boundary)
+    p = isl_printer_print_str(p, "_boundary");
+  p = isl_printer_print_str(p, "_wrapper");
+  p = isl_printer_print_str(p, "(");
+  p = print_module_arguments(p, prog, module->kernel, module, 1,
+                             XILINX_HW, inter, -1, boundary);
+  p = isl_printer_print_str(p, ")");
 
   return p;
 }
 
-static __isl_give isl_printer *print_for_with_pipeline(
-    __isl_keep isl_ast_node *node, __isl_take isl_printer *p,
-    __isl_take isl_ast_print_options *print_options)
+static isl_stat print_module_wrapper_headers_xilinx(
+    struct autosa_prog *prog, struct autosa_hw_module *module,
+    struct hls_info *hls, int inter, int boundary)
 {
-  p = isl_printer_start_line(p);
-  p = isl_printer_print_str(p, "#pragma HLS PIPELINE II=1");
+  isl_printer *p;
+
+  p = isl_printer_to_file(prog->ctx, hls->kernel_h);
+  p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+  p = print_module_wrapper_header_xilinx(p, prog, module, inter, boundary);
+  p = isl_printer_print_str(p, ";");
   p = isl_printer_end_line(p);
+  isl_printer_free(p);
 
-  p = isl_ast_node_for_print(node, p, print_options);
+  p = isl_printer_to_file(prog->ctx, hls->kernel_c);
+  p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+  p = print_module_wrapper_header_xilinx(p, prog, module, inter, boundary);
+  p = isl_printer_end_line(p);
+  isl_printer_free(p);
 
-  return p;
+  return isl_stat_ok;
 }
 
-static __isl_give isl_printer *print_for_with_unroll(
-    __isl_keep isl_ast_node *node, __isl_take isl_printer *p,
-    __isl_take isl_ast_print_options *print_options)
+/* Print the start of the loop over the problems of a persistent kernel
+ * in the body of "module".
+ */
+static __isl_give isl_printer *print_batch_loop_start_xilinx(
+    __isl_take isl_printer *p, struct autosa_hw_module *module)
 {
-  p = isl_printer_start_line(p);
-  p = isl_printer_print_str(p, "#pragma HLS UNROLL");
-  p = isl_printer_end_line(p);
+  if (!autosa_kernel_is_persistent(module->kernel, XILINX_HW))
+    return p;
 
-  p = isl_ast_node_for_print(node, p, print_options);
+  p = print_str_new_line(p, "for (int batch = 0; batch < n_batch; batch++) {");
+  p = isl_printer_indent(p, 4);
 
   return p;
 }
 
-static __isl_give isl_printer *print_for_xilinx(__isl_take isl_printer *p,
-                                                __isl_take isl_ast_print_options *print_options,
-                                                __isl_keep isl_ast_node *node, void *user)
+/* Print the end of the loop over the problems of a persistent kernel
+ * in the body of "module".
+ * The problems are stored consecutively in the external memory.
+ * The I/O modules that access the external memory move the array pointer
+ * to the next problem at the end of each iteration.
+ */
+static __isl_give isl_printer *print_batch_loop_end_xilinx(
+    __isl_take isl_printer *p, struct autosa_hw_module *module)
 {
-  isl_id *id;
-  int pipeline;
-  int unroll;
-
-  pipeline = 0;
-  unroll = 0;
-  id = isl_ast_node_get_annotation(node);
+  if (!autosa_kernel_is_persistent(module->kernel, XILINX_HW))
+    return p;
 
-  if (id)
+  if (module->type != PE_MODULE && module->to_mem)
   {
-    struct autosa_ast_node_userinfo *info;
+    struct autosa_array_ref_group *group = module->io_groups[0];
+    struct autosa_array_info *array = group->array;
+    struct autosa_io_buffer *io_buffer = group->io_buffers[group->io_level - 1];
 
-    info = (struct autosa_ast_node_userinfo *)isl_id_get_user(id);
-    if (info && info->is_pipeline)
-      pipeline = 1;
-    if (info && info->is_unroll)
-      unroll = 1;
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, array->name);
+    p = isl_printer_print_str(p, " += ");
+    if (array->linearize || array->n_index == 0)
+    {
+      p = autosa_array_info_print_data_size(p, array);
+      if (io_buffer->n_lane > 1)
+      {
+        p = isl_printer_print_str(p, " / ");
+        p = isl_printer_print_int(p, io_buffer->n_lane);
+      }
+    }
+    else
+    {
+      /* The pointer points to the rows of the array. */
+      isl_ast_expr *bound = isl_ast_expr_get_op_arg(array->bound_expr, 1);
+      p = isl_printer_print_str(p, "(");
+      p = isl_printer_print_ast_expr(p, bound);
+      p = isl_printer_print_str(p, ")");
+      isl_ast_expr_free(bound);
+    }
+    p = isl_printer_print_str(p, ";");
+    p = isl_printer_end_line(p);
   }
 
-  if (pipeline)
-    p = print_for_with_pipeline(node, p, print_options);
-  else if (unroll)
-    p = print_for_with_unroll(node, p, print_options);
-  else
-    p = isl_ast_node_for_print(node, p, print_options);
-
-  isl_id_free(id);
+  p = isl_printer_indent(p, -4);
+  p = print_str_new_line(p, "}");
 
   return p;
 }
 
-/* Print the intra_trans module.
+/* Print the core of the default module. */
+/* Tell the caches of the irregular arrays that the PE "module" issues
+ * no more requests.
  */
-static __isl_give isl_printer *autosa_print_intra_trans_module(
+static __isl_give isl_printer *print_irregular_cache_done_xilinx(
+    __isl_take isl_printer *p, struct autosa_hw_module *module)
+{
+  struct autosa_kernel *kernel = module->kernel;
+
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    if (!kernel->array[i].array->irregular)
+      continue;
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "fifo_");
+    p = isl_printer_print_str(p, kernel->array[i].array->name);
+    p = isl_printer_print_str(p, "_cache_req.write(-1);");
+    p = isl_printer_end_line(p);
+  }
+
+  return p;
+}
+
+static __isl_give isl_printer *autosa_print_default_module_core(
     __isl_take isl_printer *p,
     struct autosa_hw_module *module, struct autosa_prog *prog,
     struct hls_info *hls, int boundary)
@@ -1972,24 +6749,36 @@ static __isl_give isl_printer *autosa_print_intra_trans_module(
   p = isl_printer_print_str(p, "/* Module Definition */");
   p = isl_printer_end_line(p);
 
-  print_module_headers_xilinx(prog, module, hls, 0, boundary);
-  fprintf(hls->kernel_c, "{\n");
   if (hls->target == XILINX_HW)
-    fprintf(hls->kernel_c, "#pragma HLS INLINE OFF\n");
+    p = print_module_core_headers_xilinx(p, prog, module, hls, -1, boundary, 1);
+  fprintf(hls->kernel_c, "{\n");
+  fprintf(hls->kernel_c, "#pragma HLS INLINE OFF\n");
   p = isl_printer_indent(p, 4);
   p = print_str_new_line(p, "/* Variable Declaration */");
   print_module_iterators(hls->kernel_c, module);
-  p = print_module_vars_xilinx(p, module, 0);
+  if (hls->target == XILINX_HW)
+    p = print_module_vars_xilinx(p, module, -1);
+  if (module->to_mem && module->n_io_group > 0 &&
+      module->io_groups[0]->local_array->host_serialize &&
+      !module->io_groups[0]->local_array->host_stream)
+    p = print_str_new_line(p, "unsigned int serialize_cnt = 0;");
+  if (module->to_mem && module->n_io_group > 0 &&
+      module->io_groups[0]->local_array->host_sparse_block > 0)
+  {
+    p = print_str_new_line(p, "unsigned int sparse_blk = 0;");
+    p = print_str_new_line(p, "bool sparse_valid = false;");
+  }
+  if (hls->perf_counters)
+    p = print_str_new_line(p, "autosa_perf_t perf = {0, 0, 0};");
+  if (module->credit && module->in && hls->target == XILINX_HW)
+    p = print_str_new_line(p, "unsigned int credit_cnt = 0;");
+  if (hls->target == XILINX_HW)
+    p = print_module_split_buf_xilinx(p,
+                                      boundary ? module->boundary_tree : module->device_tree, hls);
   p = print_str_new_line(p, "/* Variable Declaration */");
   p = isl_printer_end_line(p);
 
-  if (module->double_buffer)
-  {
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "if (!intra_trans_en) return;");
-    p = isl_printer_end_line(p);
-    p = isl_printer_end_line(p);
-  }
+  p = print_batch_loop_start_xilinx(p, module);
 
   print_options = isl_ast_print_options_alloc(ctx);
   print_options = isl_ast_print_options_set_print_user(print_options,
@@ -2000,7 +6789,31 @@ static __isl_give isl_printer *autosa_print_intra_trans_module(
                                                         &print_for_xilinx, &hw_data);
   }
 
-  p = isl_ast_node_print(module->intra_tree, p, print_options);
+  if (!boundary)
+    p = isl_ast_node_print(module->device_tree, p, print_options);
+  else
+    p = isl_ast_node_print(module->boundary_tree, p, print_options);
+  hls->split_buf_lifted = 0;
+
+  if (module->credit && module->in)
+  {
+    if (hls->target == XILINX_HW)
+    {
+      /* Collect the credits left by the last array partitions. */
+      p = print_str_new_line(p, "while (credit_cnt > 0) {");
+      p = isl_printer_indent(p, 4);
+      p = print_str_new_line(p, "int token = credit.read();");
+      p = print_str_new_line(p, "credit_cnt--;");
+      p = isl_printer_indent(p, -4);
+      p = print_str_new_line(p, "}");
+    }
+  }
+  p = print_batch_loop_end_xilinx(p, module);
+  if (module->type == PE_MODULE)
+    p = print_irregular_cache_done_xilinx(p, module);
+  if (hls->perf_counters)
+    p = print_str_new_line(p, "fifo_perf.write(perf);");
+
   p = isl_printer_indent(p, -4);
 
   fprintf(hls->kernel_c, "}\n");
@@ -2013,51 +6826,88 @@ static __isl_give isl_printer *autosa_print_intra_trans_module(
   return p;
 }
 
-/* Print the inter_trans module.
+/* Print the PE module "module" to the AI Engine kernels, with the same
+ * core as in the programmable logic.
  */
-static __isl_give isl_printer *autosa_print_inter_trans_module(
+static void print_aie_pe_module_xilinx(struct autosa_hw_module *module,
+                                       struct autosa_prog *prog, struct hls_info *hls)
+{
+  FILE *kernel_c = hls->kernel_c;
+  isl_printer *p;
+
+  hls->kernel_c = hls->aie_c;
+  p = isl_printer_to_file(prog->ctx, hls->aie_c);
+  p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+  p = autosa_print_default_module_core(p, module, prog, hls, 0);
+  isl_printer_free(p);
+  hls->kernel_c = kernel_c;
+}
+
+/* Is "module" printed as a prefetching I/O module?
+ * These are the I/O modules accessing the external memory that are
+ * neither split into inter_trans and intra_trans functions nor
+ * controlled by credits.
+ */
+static int module_is_prefetched(struct autosa_hw_module *module,
+                                struct hls_info *hls)
+{
+  return hls->target == XILINX_HW && hls->io_prefetch > 0 &&
+         module->type != PE_MODULE && module->to_mem &&
+         module->n_io_group == 1 && !autosa_hw_module_is_split(module) &&
+         !module->credit;
+}
+
+/* Print the core of the prefetching I/O module "module".
+ * The accesses to the external memory are issued in lock-step with
+ * the transfers of the module otherwise, such that the latency of each
+ * new burst shows up as a bubble. Instead, the core is printed as
+ * a dataflow region of two processes connected by a FIFO of
+ * hls->io_prefetch elements, both scanning the same loops:
+ * the DRAM process only accesses the external memory, while the body
+ * process performs the rest of the module. The DRAM process of an input
+ * module runs ahead of the body process by up to the depth of the FIFO,
+ * keeping many bursts in flight, while the one of an output module
+ * drains the FIFO into the external memory.
+ */
+static __isl_give isl_printer *print_prefetch_module_core_xilinx(
     __isl_take isl_printer *p,
     struct autosa_hw_module *module, struct autosa_prog *prog,
     struct hls_info *hls, int boundary)
 {
-  struct print_hw_module_data hw_data = {hls, prog, module};
-  isl_ast_print_options *print_options;
-  isl_ctx *ctx = isl_printer_get_ctx(p);
+  hls->prefetch = 1;
+  p = autosa_print_default_module_core(p, module, prog, hls, boundary);
+  hls->prefetch = 2;
+  p = autosa_print_default_module_core(p, module, prog, hls, boundary);
+  hls->prefetch = 0;
 
   p = isl_printer_start_line(p);
   p = isl_printer_print_str(p, "/* Module Definition */");
   p = isl_printer_end_line(p);
 
-  if (hls->target == XILINX_HW)
-    print_module_headers_xilinx(prog, module, hls, 1, boundary);
+  p = print_module_core_headers_xilinx(p, prog, module, hls, -1, boundary, 1);
   fprintf(hls->kernel_c, "{\n");
   fprintf(hls->kernel_c, "#pragma HLS INLINE OFF\n");
+  fprintf(hls->kernel_c, "#pragma HLS DATAFLOW\n");
   p = isl_printer_indent(p, 4);
   p = print_str_new_line(p, "/* Variable Declaration */");
-  print_module_iterators(hls->kernel_c, module);
-  if (hls->target == XILINX_HW)
-    p = print_module_vars_xilinx(p, module, 1);
+  p = isl_printer_start_line(p);
+  p = print_fifo_type_xilinx(p, module->io_groups[0],
+                             io_prefetch_n_lane(module));
+  p = isl_printer_print_str(p, " fifo_prefetch;");
+  p = isl_printer_end_line(p);
+  fprintf(hls->kernel_c, "#pragma HLS STREAM variable=fifo_prefetch depth=%d\n",
+          hls->io_prefetch);
   p = print_str_new_line(p, "/* Variable Declaration */");
   p = isl_printer_end_line(p);
 
-  if (module->double_buffer)
-  {
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "if (!inter_trans_en) return;");
-    p = isl_printer_end_line(p);
-    p = isl_printer_end_line(p);
-  }
-
-  print_options = isl_ast_print_options_alloc(ctx);
-  print_options = isl_ast_print_options_set_print_user(print_options,
-                                                       &print_module_stmt, &hw_data);
-  if (hls->target == XILINX_HW)
-  {
-    print_options = isl_ast_print_options_set_print_for(print_options,
-                                                        &print_for_xilinx, &hw_data);
-  }
-
-  p = isl_ast_node_print((boundary == 0) ? module->inter_tree : module->boundary_inter_tree, p, print_options);
+  p = print_module_core_header_xilinx(p, prog, module, -1, boundary, 0,
+                                      module->in ? 1 : 2);
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
+  p = print_module_core_header_xilinx(p, prog, module, -1, boundary, 0,
+                                      module->in ? 2 : 1);
+  p = isl_printer_print_str(p, ";");
+  p = isl_printer_end_line(p);
   p = isl_printer_indent(p, -4);
 
   fprintf(hls->kernel_c, "}\n");
@@ -2070,150 +6920,157 @@ static __isl_give isl_printer *autosa_print_inter_trans_module(
   return p;
 }
 
-/* Print the drained data merge functions. 
- */
-static isl_stat print_drain_merge_funcs(
-    struct autosa_kernel *kernel,
-    struct autosa_drain_merge_func **funcs, int n_funcs,
-    struct hls_info *hls)
+/* Print the default module. */
+static __isl_give isl_printer *autosa_print_default_module(
+    __isl_take isl_printer *p,
+    struct autosa_hw_module *module, struct autosa_prog *prog,
+    struct hls_info *hls, int boundary)
 {
-  isl_printer *p;
-  isl_ctx *ctx;
-
-  if (n_funcs == 0)
-    return isl_stat_ok;
-
-  ctx = kernel->ctx;
-  if (!hls->hls)
-    p = isl_printer_to_file(kernel->ctx, hls->host_h);
+  /* Print core. */
+  if (module_is_prefetched(module, hls))
+    p = print_prefetch_module_core_xilinx(p, module, prog, hls, boundary);
   else
-    p = isl_printer_to_file(kernel->ctx, hls->kernel_h);
-  p = isl_printer_set_output_format(p, ISL_FORMAT_C);
-  for (int i = 0; i < n_funcs; i++)
-  {
-    struct autosa_array_ref_group *group = funcs[i]->group;
-    isl_ast_print_options *print_options;
-    struct print_hw_module_data hw_data = {hls, NULL, NULL};
+    p = autosa_print_default_module_core(p, module, prog, hls, boundary);
 
-    p = print_str_new_line(p, "/* Helper Function */");
+  /* Print wrapper. */
+  if (hls->target == XILINX_HW)
+  {
     p = isl_printer_start_line(p);
-    if (hls->hls)
-      p = isl_printer_print_str(p, "inline ");
-    p = isl_printer_print_str(p, "void ");
-    p = autosa_array_ref_group_print_prefix(group, p);
-    p = isl_printer_print_str(p, "_drain_merge(");
-    p = print_drain_merge_arguments_xilinx(p, kernel, group, funcs[i], 1, hls->hls);
-    p = isl_printer_print_str(p, "){");
+    p = isl_printer_print_str(p, "/* Module Definition */");
     p = isl_printer_end_line(p);
+
+    print_module_wrapper_headers_xilinx(prog, module, hls, -1, boundary);
+
+    fprintf(hls->kernel_c, "{\n");
     p = isl_printer_indent(p, 4);
 
-    p = print_str_new_line(p, "/* Variable Declaration */");
-    if (!hls->hls)
-      print_func_iterators(hls->host_h, funcs[i]);
-    else
-      print_func_iterators(hls->kernel_h, funcs[i]);
-    p = print_str_new_line(p, "/* Variable Declaration */");
+    p = print_module_core_headers_xilinx(p, prog, module, hls, -1, boundary, 0);
+    p = isl_printer_print_str(p, ";");
     p = isl_printer_end_line(p);
 
-    print_options = isl_ast_print_options_alloc(ctx);
-    print_options = isl_ast_print_options_set_print_user(print_options,
-                                                         &print_module_stmt, &hw_data);
-    p = isl_ast_node_print(funcs[i]->device_tree, p, print_options);
-
     p = isl_printer_indent(p, -4);
-    p = print_str_new_line(p, "}");
-    p = print_str_new_line(p, "/* Helper Function */");
+    fprintf(hls->kernel_c, "}\n");
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "/* Module Definition */");
+    p = isl_printer_end_line(p);
+
+    p = isl_printer_end_line(p);
   }
-  p = isl_printer_end_line(p);
-  isl_printer_free(p);
 
-  return isl_stat_ok;
+  return p;
 }
 
-static __isl_give isl_printer *print_module_core_header_xilinx(
+static __isl_give isl_printer *print_pe_dummy_module_core_header_xilinx(
     __isl_take isl_printer *p,
-    struct autosa_prog *prog, struct autosa_hw_module *module,
-    int inter, int boundary, int types)
+    struct autosa_prog *prog, struct autosa_pe_dummy_module *module, int types)
 {
+  struct autosa_array_ref_group *group = module->io_group;
+
   p = isl_printer_start_line(p);
   if (types)
+  {
+    p = print_module_template(p, module->module->kernel, module->module, 1,
+                              XILINX_HW);
     p = isl_printer_print_str(p, "void ");
-  p = isl_printer_print_str(p, module->name);
-  if (inter == 0)
-    p = isl_printer_print_str(p, "_intra_trans");
-  else if (inter == 1)
-    p = isl_printer_print_str(p, "_inter_trans");
-  if (boundary)
-    p = isl_printer_print_str(p, "_boundary");
+  }
+  // group_name
+  p = isl_printer_print_str(p, group->array->name);
+  if (group->group_type == AUTOSA_IO_GROUP)
+  {
+    if (group->local_array->n_io_group > 1)
+    {
+      p = isl_printer_print_str(p, "_");
+      p = isl_printer_print_int(p, group->nr);
+    }
+  }
+  else if (group->group_type == AUTOSA_DRAIN_GROUP)
+  {
+    p = isl_printer_print_str(p, "_");
+    p = isl_printer_print_str(p, "drain");
+  }
+  p = isl_printer_print_str(p, "_PE_dummy");
+  if (!types)
+    p = print_module_template(p, module->module->kernel, module->module, 0,
+                              XILINX_HW);
   p = isl_printer_print_str(p, "(");
-  p = print_module_arguments(p, prog, module->kernel, module, types,
-                             XILINX_HW, inter, -1, boundary);
+  p = print_pe_dummy_module_arguments(p, prog, module->module->kernel,
+                                      module, types, XILINX_HW);
   p = isl_printer_print_str(p, ")");
 
   return p;
 }
 
-static __isl_give isl_printer *print_module_core_headers_xilinx(
+static __isl_give isl_printer *print_pe_dummy_module_core_headers_xilinx(
     __isl_take isl_printer *p, struct autosa_prog *prog,
-    struct autosa_hw_module *module, struct hls_info *hls,
-    int inter, int boundary, int types)
+    struct autosa_pe_dummy_module *module, struct hls_info *hls, int types)
 {
-  p = print_module_core_header_xilinx(p, prog, module, inter, boundary, types);
+  p = print_pe_dummy_module_core_header_xilinx(p, prog, module, types);
 
   return p;
 }
 
-static __isl_give isl_printer *print_module_wrapper_header_xilinx(
+static __isl_give isl_printer *print_pe_dummy_module_wrapper_header_xilinx(
     __isl_take isl_printer *p,
-    struct autosa_prog *prog, struct autosa_hw_module *module,
-    int inter, int boundary)
+    struct autosa_prog *prog, struct autosa_pe_dummy_module *module)
 {
+  struct autosa_array_ref_group *group = module->io_group;
+
   p = isl_printer_start_line(p);
+  p = print_module_template(p, module->module->kernel, module->module, 1,
+                            XILINX_HW);
   p = isl_printer_print_str(p, "void ");
-  p = isl_printer_print_str(p, module->name);
-  if (inter == 0)
-    p = isl_printer_print_str(p, "_intra_trans");
-  else if (inter == 1)
-    p = isl_printer_print_str(p, "_inter_trans");
-  if (boundary)
-    p = isl_printer_print_str(p, "_boundary");
-  p = isl_printer_print_str(p, "_wrapper");
+  // group_name
+  p = isl_printer_print_str(p, group->array->name);
+  if (group->group_type == AUTOSA_IO_GROUP)
+  {
+    if (group->local_array->n_io_group > 1)
+    {
+      p = isl_printer_print_str(p, "_");
+      p = isl_printer_print_int(p, group->nr);
+    }
+  }
+  else if (group->group_type == AUTOSA_DRAIN_GROUP)
+  {
+    p = isl_printer_print_str(p, "_");
+    p = isl_printer_print_str(p, "drain");
+  }
+  p = isl_printer_print_str(p, "_PE_dummy_wrapper");
   p = isl_printer_print_str(p, "(");
-  p = print_module_arguments(p, prog, module->kernel, module, 1,
-                             XILINX_HW, inter, -1, boundary);
+  p = print_pe_dummy_module_arguments(p, prog, module->module->kernel,
+                                      module, 1, XILINX_HW);
   p = isl_printer_print_str(p, ")");
 
   return p;
 }
 
-static isl_stat print_module_wrapper_headers_xilinx(
-    struct autosa_prog *prog, struct autosa_hw_module *module,
-    struct hls_info *hls, int inter, int boundary)
+static isl_stat print_pe_dummy_module_wrapper_headers_xilinx(
+    struct autosa_prog *prog, struct autosa_pe_dummy_module *module,
+    struct hls_info *hls)
 {
   isl_printer *p;
 
   p = isl_printer_to_file(prog->ctx, hls->kernel_h);
   p = isl_printer_set_output_format(p, ISL_FORMAT_C);
-  p = print_module_wrapper_header_xilinx(p, prog, module, inter, boundary);
+  p = print_pe_dummy_module_wrapper_header_xilinx(p, prog, module);
   p = isl_printer_print_str(p, ";");
   p = isl_printer_end_line(p);
   isl_printer_free(p);
 
   p = isl_printer_to_file(prog->ctx, hls->kernel_c);
   p = isl_printer_set_output_format(p, ISL_FORMAT_C);
-  p = print_module_wrapper_header_xilinx(p, prog, module, inter, boundary);
+  p = print_pe_dummy_module_wrapper_header_xilinx(p, prog, module);
   p = isl_printer_end_line(p);
   isl_printer_free(p);
 
   return isl_stat_ok;
 }
 
-/* Print the default module. */
-static __isl_give isl_printer *autosa_print_default_module(
+static __isl_give isl_printer *autosa_print_default_pe_dummy_module(
     __isl_take isl_printer *p,
-    struct autosa_hw_module *module, struct autosa_prog *prog,
-    struct hls_info *hls, int boundary)
+    struct autosa_pe_dummy_module *pe_dummy_module,
+    struct autosa_prog *prog, struct hls_info *hls, int boundary)
 {
+  struct autosa_hw_module *module = pe_dummy_module->module;
   struct print_hw_module_data hw_data = {hls, prog, module};
   isl_ast_print_options *print_options;
   isl_ctx *ctx = isl_printer_get_ctx(p);
@@ -2224,26 +7081,17 @@ static __isl_give isl_printer *autosa_print_default_module(
   p = isl_printer_end_line(p);
 
   if (hls->target == XILINX_HW)
-    p = print_module_core_headers_xilinx(p, prog, module, hls, -1, boundary, 1);
+    p = print_pe_dummy_module_core_headers_xilinx(p, prog,
+                                                  pe_dummy_module, hls, 1);
+
   fprintf(hls->kernel_c, "{\n");
   fprintf(hls->kernel_c, "#pragma HLS INLINE OFF\n");
-  p = isl_printer_indent(p, 4);
-  p = print_str_new_line(p, "/* Variable Declaration */");
   print_module_iterators(hls->kernel_c, module);
-  if (hls->target == XILINX_HW)
-    p = print_module_vars_xilinx(p, module, -1);
-  p = print_str_new_line(p, "/* Variable Declaration */");
-  p = isl_printer_end_line(p);
 
-  if (module->credit && !module->in)
-  {
-    if (hls->target == XILINX_HW)
-    {
-      p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "credit.write(1);");
-      p = isl_printer_end_line(p);
-    }
-  }
+  p = isl_printer_indent(p, 4);
+  if (hls->perf_counters)
+    p = print_str_new_line(p, "autosa_perf_t perf = {0, 0, 0};");
+  p = isl_printer_end_line(p);
 
   print_options = isl_ast_print_options_alloc(ctx);
   print_options = isl_ast_print_options_set_print_user(print_options,
@@ -2254,20 +7102,11 @@ static __isl_give isl_printer *autosa_print_default_module(
                                                         &print_for_xilinx, &hw_data);
   }
 
-  if (!boundary)
-    p = isl_ast_node_print(module->device_tree, p, print_options);
-  else
-    p = isl_ast_node_print(module->boundary_tree, p, print_options);
-
-  if (module->credit && module->in)
-  {
-    if (hls->target == XILINX_HW)
-    {
-      p = isl_printer_start_line(p);
-      p = isl_printer_print_str(p, "int token = credit.read();");
-      p = isl_printer_end_line(p);
-    }
-  }
+  p = print_batch_loop_start_xilinx(p, module);
+  p = isl_ast_node_print(pe_dummy_module->device_tree, p, print_options);
+  p = print_batch_loop_end_xilinx(p, module);
+  if (hls->perf_counters)
+    p = print_str_new_line(p, "fifo_perf.write(perf);");
 
   p = isl_printer_indent(p, -4);
 
@@ -2285,15 +7124,13 @@ static __isl_give isl_printer *autosa_print_default_module(
     p = isl_printer_print_str(p, "/* Module Definition */");
     p = isl_printer_end_line(p);
 
-    print_module_wrapper_headers_xilinx(prog, module, hls, -1, boundary);
+    print_pe_dummy_module_wrapper_headers_xilinx(prog, pe_dummy_module, hls);
 
     fprintf(hls->kernel_c, "{\n");
     p = isl_printer_indent(p, 4);
-
-    p = print_module_core_headers_xilinx(p, prog, module, hls, -1, boundary, 0);
+    p = print_pe_dummy_module_core_headers_xilinx(p, prog, pe_dummy_module, hls, 0);
     p = isl_printer_print_str(p, ";");
     p = isl_printer_end_line(p);
-
     p = isl_printer_indent(p, -4);
     fprintf(hls->kernel_c, "}\n");
     p = isl_printer_start_line(p);
@@ -2306,169 +7143,370 @@ static __isl_give isl_printer *autosa_print_default_module(
   return p;
 }
 
-static __isl_give isl_printer *print_pe_dummy_module_core_header_xilinx(
-    __isl_take isl_printer *p,
-    struct autosa_prog *prog, struct autosa_pe_dummy_module *module, int types)
+/* Print the declarations of the parameters setting the number of array
+ * partitions executed by "kernel", initialized to the compiled numbers.
+ * A smaller problem is run by lowering them, with the arrays padded in the
+ * host to a multiple of the array partition size.
+ * With the tile scheduler, the array partition sizes and the compiled
+ * numbers of array partitions are declared as well, to construct the
+ * scheduler.
+ */
+static __isl_give isl_printer *print_runtime_tiles_xilinx(
+    __isl_take isl_printer *p, struct autosa_kernel *kernel,
+    struct hls_info *hls)
 {
-  struct autosa_array_ref_group *group = module->io_group;
+  if (kernel->n_runtime_tile == 0)
+    return p;
 
-  p = isl_printer_start_line(p);
-  if (types)
-    p = isl_printer_print_str(p, "void ");
-  // group_name
-  p = isl_printer_print_str(p, group->array->name);
-  if (group->group_type == AUTOSA_IO_GROUP)
+  p = print_str_new_line(p, "// Number of array partitions to execute, at most the compiled numbers");
+  for (int i = 0; i < kernel->n_runtime_tile; i++)
   {
-    if (group->local_array->n_io_group > 1)
-    {
-      p = isl_printer_print_str(p, "_");
-      p = isl_printer_print_int(p, group->nr);
-    }
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "int n_tile_");
+    p = isl_printer_print_int(p, i);
+    p = isl_printer_print_str(p, " = ");
+    p = isl_printer_print_int(p, kernel->runtime_tile_ub[i]);
+    p = isl_printer_print_str(p, ";");
+    p = isl_printer_end_line(p);
   }
-  else if (group->group_type == AUTOSA_DRAIN_GROUP)
+  if (hls->tile_scheduler)
   {
-    p = isl_printer_print_str(p, "_");
-    p = isl_printer_print_str(p, "drain");
+    p = print_str_new_line(p, "// Array partition sizes and compiled numbers of array partitions of the tile scheduler");
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "const int autosa_tile_size[] = {");
+    for (int i = 0; i < kernel->n_runtime_tile; i++)
+    {
+      if (i > 0)
+        p = isl_printer_print_str(p, ", ");
+      p = isl_printer_print_int(p, kernel->runtime_tile_size[i]);
+    }
+    p = isl_printer_print_str(p, "};");
+    p = isl_printer_end_line(p);
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "const int autosa_max_tile[] = {");
+    for (int i = 0; i < kernel->n_runtime_tile; i++)
+    {
+      if (i > 0)
+        p = isl_printer_print_str(p, ", ");
+      p = isl_printer_print_int(p, kernel->runtime_tile_ub[i]);
+    }
+    p = isl_printer_print_str(p, "};");
+    p = isl_printer_end_line(p);
   }
-  p = isl_printer_print_str(p, "_PE_dummy");
-  p = isl_printer_print_str(p, "(");
-  p = print_pe_dummy_module_arguments(p, prog, module->module->kernel,
-                                      module, types, XILINX_HW);
-  p = isl_printer_print_str(p, ")");
 
   return p;
 }
 
-static __isl_give isl_printer *print_pe_dummy_module_core_headers_xilinx(
-    __isl_take isl_printer *p, struct autosa_prog *prog,
-    struct autosa_pe_dummy_module *module, struct hls_info *hls, int types)
+/* The definitions of the modules shared across the structurally identical
+ * modules.
+ * "canonical" maps the canonical form of each definition printed so far
+ * to the name of the function.
+ * "alias" maps the name of each duplicate function to the name of
+ * the function it calls.
+ */
+struct module_dedup_data
 {
-  p = print_pe_dummy_module_core_header_xilinx(p, prog, module, types);
+  std::map<std::string, std::string> canonical;
+  std::map<std::string, std::string> alias;
+};
 
-  return p;
+static bool is_ident_start(char c)
+{
+  return isalpha((unsigned char)c) || c == '_';
 }
 
-static __isl_give isl_printer *print_pe_dummy_module_wrapper_header_xilinx(
-    __isl_take isl_printer *p,
-    struct autosa_prog *prog, struct autosa_pe_dummy_module *module)
+static bool is_ident_char(char c)
 {
-  struct autosa_array_ref_group *group = module->io_group;
+  return isalnum((unsigned char)c) || c == '_';
+}
 
-  p = isl_printer_start_line(p);
-  p = isl_printer_print_str(p, "void ");
-  // group_name
-  p = isl_printer_print_str(p, group->array->name);
-  if (group->group_type == AUTOSA_IO_GROUP)
+/* Does the identifier "ident" contain the name "name" as a segment,
+ * delimited by underscores?
+ */
+static bool ident_has_segment(const std::string &ident, const char *name)
+{
+  size_t len = strlen(name);
+  size_t pos = 0;
+
+  while ((pos = ident.find(name, pos)) != std::string::npos)
   {
-    if (group->local_array->n_io_group > 1)
+    size_t end = pos + len;
+    if ((pos == 0 || ident[pos - 1] == '_') &&
+        (end == ident.size() || ident[end] == '_'))
+      return true;
+    pos++;
+  }
+
+  return false;
+}
+
+/* Return the canonical form of the function definition "def" named "name".
+ * The definition is split into tokens, which are separated by single
+ * spaces. The string literals and the comments are kept as they are.
+ * The identifiers are replaced as follows:
+ * - the name of the function is replaced by "@self",
+ * - the called functions are replaced by the functions they call
+ *   if they are duplicates,
+ * - the packed data types "<array>_t<n>" are replaced by the types
+ *   "ap_uint<w>" they are defined with,
+ * - the other identifiers that contain the name of an array, i.e.,
+ *   the arguments, buffers and fifos of the module,
+ *   are numbered in the order of their first occurrence.
+ * Two definitions with the same canonical form only differ in the names
+ * of the arrays they access and in the data types of the same width.
+ */
+static std::string module_def_canonical_form(const std::string &def,
+                                             const std::string &name,
+                                             struct autosa_prog *prog,
+                                             struct module_dedup_data *data)
+{
+  std::string key;
+  std::map<std::string, int> numbers;
+  size_t i = 0, n = def.size();
+
+  while (i < n)
+  {
+    size_t start = i;
+    std::string token;
+
+    if (isspace((unsigned char)def[i]))
+    {
+      i++;
+      continue;
+    }
+    if (def[i] == '"' || def[i] == '\'')
+    {
+      char quote = def[i++];
+      while (i < n && def[i] != quote)
+        i += def[i] == '\\' ? 2 : 1;
+      i = i < n ? i + 1 : n;
+      token = def.substr(start, i - start);
+    }
+    else if (def.compare(i, 2, "//") == 0)
+    {
+      i = def.find('\n', i);
+      i = i == std::string::npos ? n : i;
+      token = def.substr(start, i - start);
+    }
+    else if (def.compare(i, 2, "/*") == 0)
+    {
+      i = def.find("*/", i + 2);
+      i = i == std::string::npos ? n : i + 2;
+      token = def.substr(start, i - start);
+    }
+    else if (is_ident_char(def[i]))
+    {
+      while (i < n && is_ident_char(def[i]))
+        i++;
+      token = def.substr(start, i - start);
+      if (is_ident_start(token[0]))
+      {
+        size_t next = def.find_first_not_of(" \t\n", i);
+        bool call = next != std::string::npos && def[next] == '(';
+        bool local = false;
+        std::map<std::string, std::string>::iterator it;
+
+        for (int j = 0; j < prog->n_array && !call; j++)
+        {
+          const char *array = prog->array[j].name;
+          size_t len = strlen(array);
+          if (token.compare(0, len, array) == 0 &&
+              token.compare(len, 2, "_t") == 0 && token.size() > len + 2 &&
+              token.find_first_not_of("0123456789", len + 2) == std::string::npos)
+          {
+            int n_lane = atoi(token.c_str() + len + 2);
+            token = "ap_uint<" +
+                    std::to_string(prog->array[j].size * 8 * n_lane) + ">";
+            break;
+          }
+          if (ident_has_segment(token, array))
+            local = true;
+        }
+        if (token == name)
+        {
+          token = "@self";
+        }
+        else if (call)
+        {
+          it = data->alias.find(token);
+          if (it != data->alias.end())
+            token = it->second;
+        }
+        else if (local)
+        {
+          if (numbers.find(token) == numbers.end())
+          {
+            int number = numbers.size();
+            numbers[token] = number;
+          }
+          token = "$" + std::to_string(numbers[token]);
+        }
+      }
+    }
+    else
     {
-      p = isl_printer_print_str(p, "_");
-      p = isl_printer_print_int(p, group->nr);
+      token = def.substr(i++, 1);
     }
+    key += token;
+    key += " ";
   }
-  else if (group->group_type == AUTOSA_DRAIN_GROUP)
-  {
-    p = isl_printer_print_str(p, "_");
-    p = isl_printer_print_str(p, "drain");
-  }
-  p = isl_printer_print_str(p, "_PE_dummy_wrapper");
-  p = isl_printer_print_str(p, "(");
-  p = print_pe_dummy_module_arguments(p, prog, module->module->kernel,
-                                      module, 1, XILINX_HW);
-  p = isl_printer_print_str(p, ")");
 
-  return p;
+  return key;
 }
 
-static isl_stat print_pe_dummy_module_wrapper_headers_xilinx(
-    struct autosa_prog *prog, struct autosa_pe_dummy_module *module,
-    struct hls_info *hls)
+/* Extract the names of the arguments from the function header "header",
+ * i.e., the last identifier before any array dimension of each argument.
+ */
+static std::vector<std::string> extract_header_arg_names(
+    const std::string &header)
 {
-  isl_printer *p;
-
-  p = isl_printer_to_file(prog->ctx, hls->kernel_h);
-  p = isl_printer_set_output_format(p, ISL_FORMAT_C);
-  p = print_pe_dummy_module_wrapper_header_xilinx(p, prog, module);
-  p = isl_printer_print_str(p, ";");
-  p = isl_printer_end_line(p);
-  isl_printer_free(p);
-
-  p = isl_printer_to_file(prog->ctx, hls->kernel_c);
-  p = isl_printer_set_output_format(p, ISL_FORMAT_C);
-  p = print_pe_dummy_module_wrapper_header_xilinx(p, prog, module);
-  p = isl_printer_end_line(p);
-  isl_printer_free(p);
+  std::vector<std::string> names;
+  size_t start = header.find('(');
+  size_t end = header.rfind(')');
+  int depth = 0;
+  std::string arg;
+
+  if (start == std::string::npos || end == std::string::npos || end <= start)
+    return names;
+  for (size_t i = start + 1; i <= end; i++)
+  {
+    char c = header[i];
+    if ((c == ',' && depth == 0) || i == end)
+    {
+      size_t dim = arg.find('[');
+      size_t last;
+      if (dim != std::string::npos)
+        arg = arg.substr(0, dim);
+      last = arg.find_last_not_of(" \t");
+      if (last != std::string::npos)
+      {
+        size_t first = last;
+        while (first > 0 && is_ident_char(arg[first - 1]))
+          first--;
+        names.push_back(arg.substr(first, last - first + 1));
+      }
+      arg.clear();
+      continue;
+    }
+    if (c == '<' || c == '(')
+      depth++;
+    else if (c == '>' || c == ')')
+      depth--;
+    arg += c;
+  }
 
-  return isl_stat_ok;
+  return names;
 }
 
-static __isl_give isl_printer *autosa_print_default_pe_dummy_module(
-    __isl_take isl_printer *p,
-    struct autosa_pe_dummy_module *pe_dummy_module,
-    struct autosa_prog *prog, struct hls_info *hls, int boundary)
+/* Print the module definitions in "text" to "fp".
+ * Each definition is enclosed by "Module Definition" comments.
+ * A definition with the same canonical form as an earlier definition
+ * is replaced by an inlined wrapper calling the earlier definition
+ * with its arguments, such that HLS synthesizes the function once.
+ * Return the number of replaced definitions.
+ */
+static int print_dedup_module_defs(FILE *fp, const std::string &text,
+                                   struct autosa_prog *prog,
+                                   struct module_dedup_data *data)
 {
-  struct autosa_hw_module *module = pe_dummy_module->module;
-  struct print_hw_module_data hw_data = {hls, prog, module};
-  isl_ast_print_options *print_options;
-  isl_ctx *ctx = isl_printer_get_ctx(p);
-
-  /* Print core. */
-  p = isl_printer_start_line(p);
-  p = isl_printer_print_str(p, "/* Module Definition */");
-  p = isl_printer_end_line(p);
-
-  if (hls->target == XILINX_HW)
-    p = print_pe_dummy_module_core_headers_xilinx(p, prog,
-                                                  pe_dummy_module, hls, 1);
-
-  fprintf(hls->kernel_c, "{\n");
-  fprintf(hls->kernel_c, "#pragma HLS INLINE OFF\n");
-  print_module_iterators(hls->kernel_c, module);
-
-  p = isl_printer_indent(p, 4);
-  p = isl_printer_end_line(p);
+  const char *marker = "/* Module Definition */";
+  size_t pos = 0;
+  int n_shared = 0;
 
-  print_options = isl_ast_print_options_alloc(ctx);
-  print_options = isl_ast_print_options_set_print_user(print_options,
-                                                       &print_module_stmt, &hw_data);
-  if (hls->target == XILINX_HW)
+  while (1)
   {
-    print_options = isl_ast_print_options_set_print_for(print_options,
-                                                        &print_for_xilinx, &hw_data);
-  }
-
-  p = isl_ast_node_print(pe_dummy_module->device_tree, p, print_options);
+    size_t start = text.find(marker, pos);
+    size_t end, header_start, header_end, name_end;
+    std::string def, header, name, key;
+    std::vector<std::string> args;
+    std::map<std::string, std::string>::iterator it;
+
+    if (start != std::string::npos)
+      start = text.find('\n', start);
+    end = start == std::string::npos ? start : text.find(marker, start);
+    if (end == std::string::npos)
+    {
+      fputs(text.substr(pos).c_str(), fp);
+      break;
+    }
+    start++;
+    fputs(text.substr(pos, start - pos).c_str(), fp);
+    def = text.substr(start, end - start);
+    pos = end;
+
+    header_start = def.find("void ");
+    header_end = header_start == std::string::npos ? header_start :
+                 def.find('\n', header_start);
+    name_end = header_start == std::string::npos ? header_start :
+               def.find('(', header_start);
+    if (header_end == std::string::npos || name_end == std::string::npos ||
+        name_end > header_end)
+    {
+      fputs(def.c_str(), fp);
+      continue;
+    }
+    header = def.substr(header_start, header_end - header_start);
+    name = def.substr(header_start + 5, name_end - header_start - 5);
 
-  p = isl_printer_indent(p, -4);
+    key = module_def_canonical_form(def, name, prog, data);
+    it = data->canonical.find(key);
+    if (it == data->canonical.end())
+    {
+      data->canonical[key] = name;
+      fputs(def.c_str(), fp);
+      continue;
+    }
 
-  fprintf(hls->kernel_c, "}\n");
-  p = isl_printer_start_line(p);
-  p = isl_printer_print_str(p, "/* Module Definition */");
-  p = isl_printer_end_line(p);
+    data->alias[name] = it->second;
+    n_shared++;
+    args = extract_header_arg_names(header);
+    fprintf(fp, "%s\n{\n", header.c_str());
+    fprintf(fp, "#pragma HLS INLINE\n");
+    fprintf(fp, "    /* Shared with %s */\n", it->second.c_str());
+    fprintf(fp, "    %s(", it->second.c_str());
+    for (size_t i = 0; i < args.size(); i++)
+      fprintf(fp, "%s%s", i == 0 ? "" : ", ", args[i].c_str());
+    fprintf(fp, ");\n}\n");
+  }
 
-  p = isl_printer_end_line(p);
+  return n_shared;
+}
 
-  /* Print wrapper. */
-  if (hls->target == XILINX_HW)
+/* Print the definitions of the functions of the hardware module "module".
+ */
+static __isl_give isl_printer *print_hw_module_defs(
+    __isl_take isl_printer *p, struct autosa_hw_module *module,
+    struct autosa_prog *prog, struct hls_info *hls)
+{
+  if (autosa_hw_module_is_split(module))
   {
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "/* Module Definition */");
-    p = isl_printer_end_line(p);
+    /* Print out the definitions for inter_trans and intra_trans function calls. */
+    /* Intra transfer function */
+    p = autosa_print_intra_trans_module(p, module, prog, hls, 0);
 
-    print_pe_dummy_module_wrapper_headers_xilinx(prog, pe_dummy_module, hls);
+    /* Inter transfer function */
+    p = autosa_print_inter_trans_module(p, module, prog, hls, 0);
+    if (module->boundary)
+      p = autosa_print_inter_trans_module(p, module, prog, hls, 1);
+  }
 
-    fprintf(hls->kernel_c, "{\n");
-    p = isl_printer_indent(p, 4);
-    p = print_pe_dummy_module_core_headers_xilinx(p, prog, pe_dummy_module, hls, 0);
-    p = isl_printer_print_str(p, ";");
-    p = isl_printer_end_line(p);
-    p = isl_printer_indent(p, -4);
-    fprintf(hls->kernel_c, "}\n");
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "/* Module Definition */");
-    p = isl_printer_end_line(p);
+  p = autosa_print_default_module(p, module, prog, hls, 0);
+  if (hls->aie_c && module->type == PE_MODULE)
+    print_aie_pe_module_xilinx(module, prog, hls);
 
-    p = isl_printer_end_line(p);
+  if (module->boundary)
+  {
+    /* Print out the definitions for boundary trans function calls. */
+    p = autosa_print_default_module(p, module, prog, hls, 1);
+  }
+  if (module->n_pe_dummy_modules > 0)
+  {
+    /* Print out the definitions for pe dummy function calls. */
+    for (int j = 0; j < module->n_pe_dummy_modules; j++)
+    {
+      p = autosa_print_default_pe_dummy_module(
+          p, module->pe_dummy_modules[j], prog, hls, 0);
+    }
   }
 
   return p;
@@ -2485,13 +7523,19 @@ static __isl_give isl_printer *autosa_print_host_code(__isl_take isl_printer *p,
   isl_ctx *ctx = isl_ast_node_get_ctx(tree);
   struct print_host_user_data data = {hls, prog, top};
   struct print_hw_module_data hw_data = {hls, prog, NULL};
-  isl_printer *p_module;
+  isl_printer *p_module, *p_tmp;
+  int dedup = top->kernel->options->autosa->module_dedup;
+  struct module_dedup_data dedup_data;
+  int n_shared = 0;
 
   /* Print the data pack types in the program. */
-  print_data_types_xilinx(top, hls);
+  print_data_types_xilinx(top, hls->kernel_h);
+  if (hls->aie_c)
+    print_data_types_xilinx(top, hls->aie_c);
 
   /* Print the helper functions in the program. */
   print_drain_merge_funcs(top->kernel, drain_merge_funcs, n_drain_merge_funcs, hls);
+  print_host_serialize_funcs(modules, n_modules, hls);
 
   /* Print the default AST. */
   print_options = isl_ast_print_options_alloc(ctx);
@@ -2500,6 +7544,7 @@ static __isl_give isl_printer *autosa_print_host_code(__isl_take isl_printer *p,
 
   /* Print the macros definitions in the program. */
   p = autosa_print_macros(p, tree);
+  p = print_runtime_tiles_xilinx(p, top->kernel, hls);
   p = isl_ast_node_print(tree, p, print_options);
 
   /* Print the hw module ASTs. */
@@ -2508,41 +7553,150 @@ static __isl_give isl_printer *autosa_print_host_code(__isl_take isl_printer *p,
 
   for (int i = 0; i < n_modules; i++)
   {
-    if (modules[i]->is_filter && modules[i]->is_buffer)
+    if (dedup)
     {
-      /* Print out the definitions for inter_trans and intra_trans function calls. */
-      /* Intra transfer function */
-      p_module = autosa_print_intra_trans_module(p_module, modules[i], prog, hls, 0);
+      FILE *kernel_c = hls->kernel_c;
+      FILE *fp = tmpfile();
+      std::string text;
+      char buffer[4096];
+      size_t n;
 
-      /* Inter transfer function */
-      p_module = autosa_print_inter_trans_module(p_module, modules[i], prog, hls, 0);
-      if (modules[i]->boundary)
-        p_module = autosa_print_inter_trans_module(p_module, modules[i], prog, hls, 1);
+      if (!fp)
+      {
+        p_module = print_hw_module_defs(p_module, modules[i], prog, hls);
+        continue;
+      }
+      /* Print the definitions to a temporary file first. */
+      hls->kernel_c = fp;
+      p_tmp = isl_printer_to_file(ctx, fp);
+      p_tmp = isl_printer_set_output_format(p_tmp, ISL_FORMAT_C);
+      p_tmp = print_hw_module_defs(p_tmp, modules[i], prog, hls);
+      isl_printer_free(p_tmp);
+      hls->kernel_c = kernel_c;
+
+      rewind(fp);
+      while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        text.append(buffer, n);
+      fclose(fp);
+      n_shared += print_dedup_module_defs(kernel_c, text, prog, &dedup_data);
     }
-
-    p_module = autosa_print_default_module(p_module, modules[i], prog, hls, 0);
-
-    if (modules[i]->boundary)
+    else
     {
-      /* Print out the definitions for boundary trans function calls. */
-      p_module = autosa_print_default_module(p_module, modules[i], prog, hls, 1);
+      p_module = print_hw_module_defs(p_module, modules[i], prog, hls);
     }
-    if (modules[i]->n_pe_dummy_modules > 0)
+  }
+  isl_printer_free(p_module);
+  if (dedup)
+    printf("[AutoSA] %d module definition(s) shared with identical modules.\n",
+           n_shared);
+
+  return p;
+}
+
+/* Compute the AXI burst length (in beats) of the reads ("read" set) or writes
+ * of "local_array" in the external memory.
+ * The burst length is given by the contiguous extent of the outermost I/O
+ * buffers of the I/O groups (and the drain group for the writes), divided
+ * by the width of the memory port. It is limited to a power of two between
+ * 2 and 256, the maximal AXI burst length.
+ * Return 0 if the array is not transferred in this direction.
+ */
+static int compute_axi_burst_len(struct autosa_local_array_info *local_array,
+                                 int read)
+{
+  std::vector<struct autosa_array_ref_group *> groups;
+  int port_bytes = local_array->n_lane * local_array->array->size;
+  long bytes = 0;
+  int burst_len;
+
+  for (int i = 0; i < local_array->n_io_group; i++)
+  {
+    struct autosa_array_ref_group *group = local_array->io_groups[i];
+    if ((read && group->copy_in) || (!read && group->copy_out))
+      groups.push_back(group);
+  }
+  if (!read && local_array->drain_group)
+    groups.push_back(local_array->drain_group);
+  if (groups.size() == 0 || local_array->array->n_index == 0)
+    return 0;
+
+  for (int i = 0; i < groups.size(); i++)
+  {
+    struct autosa_array_ref_group *group = groups[i];
+    for (int l = group->io_level - 1; l >= 0; l--)
     {
-      /* Print out the definitions for pe dummy function calls. */
-      for (int j = 0; j < modules[i]->n_pe_dummy_modules; j++)
-      {
-        p_module = autosa_print_default_pe_dummy_module(
-            p_module, modules[i]->pe_dummy_modules[j], prog, hls, 0);
-      }
+      struct autosa_array_tile *tile = group->io_buffers[l]->tile;
+      if (!tile)
+        continue;
+      bytes = max(bytes, isl_val_get_num_si(tile->bound[tile->n - 1].size) *
+                             local_array->array->size);
+      break;
     }
   }
-  isl_printer_free(p_module);
+
+  burst_len = 2;
+  while (burst_len < 256 && (long)burst_len * 2 * port_bytes <= bytes)
+    burst_len *= 2;
+
+  return burst_len;
+}
+
+/* Print the burst length and the number of outstanding transactions of the
+ * reads or writes ("read" set) of "local_array" as m_axi interface options.
+ * The number of outstanding transactions keeps 256 beats in flight,
+ * which covers the latency of the external memory.
+ */
+static __isl_give isl_printer *print_axi_burst_options_xilinx(
+    __isl_take isl_printer *p, struct autosa_local_array_info *local_array,
+    int read)
+{
+  int burst_len = compute_axi_burst_len(local_array, read);
+  int n_outstanding;
+
+  if (burst_len == 0)
+    return p;
+  n_outstanding = max(2, min(32, 256 / burst_len));
+
+  p = isl_printer_print_str(p, read ? " max_read_burst_length=" :
+                                      " max_write_burst_length=");
+  p = isl_printer_print_int(p, burst_len);
+  p = isl_printer_print_str(p, read ? " num_read_outstanding=" :
+                                      " num_write_outstanding=");
+  p = isl_printer_print_int(p, n_outstanding);
 
   return p;
 }
 
+/* Report the arrays of "kernel" with short bursts, of less than 16 beats,
+ * in the external memory.
+ */
+static void report_short_axi_bursts(struct autosa_kernel *kernel)
+{
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    if (!autosa_kernel_requires_array_argument(kernel, i) ||
+        autosa_array_is_scalar(local_array->array))
+      continue;
+    for (int read = 1; read >= 0; read--)
+    {
+      int burst_len = compute_axi_burst_len(local_array, read);
+      if (burst_len == 0 || burst_len >= 16)
+        continue;
+      printf("[AutoSA] Warning: The %s of array %s use bursts of %d beats. ",
+             read ? "reads" : "writes", local_array->array->name, burst_len);
+      if (!kernel->options->autosa->two_level_buffer)
+        printf("Try --AutoSA-two-level-buffer to coalesce the transfers.");
+      printf("\n");
+    }
+  }
+}
+
 /* Declare the AXI interface for each global pointers. 
+ * If "--AutoSA-axi-burst" is set, the bursts of the interfaces
+ * are tuned as well.
+ * The arrays streamed through QDMA are AXI4-Stream ports without
+ * a control register.
  */
 static __isl_give isl_printer *print_top_module_interface_xilinx(
     __isl_take isl_printer *p,
@@ -2572,11 +7726,26 @@ static __isl_give isl_printer *print_top_module_interface_xilinx(
           p = isl_printer_print_str(p, local_array->array->name);
           p = isl_printer_print_str(p, "_");
           p = isl_printer_print_int(p, j);
+          if (kernel->options->autosa->axi_burst)
+          {
+            p = print_axi_burst_options_xilinx(p, local_array, 1);
+            p = print_axi_burst_options_xilinx(p, local_array, 0);
+          }
           p = isl_printer_print_str(p, "\");");
           p = isl_printer_end_line(p);
           p = print_str_new_line(p, "p = isl_printer_end_line(p);");
         }
       }
+      else if (local_array->host_stream)
+      {
+        p = print_str_new_line(p, "p = isl_printer_start_line(p);");
+        p = isl_printer_start_line(p);
+        p = isl_printer_print_str(p, "p = isl_printer_print_str(p, \"#pragma HLS INTERFACE axis port=");
+        p = isl_printer_print_str(p, local_array->array->name);
+        p = isl_printer_print_str(p, "\");");
+        p = isl_printer_end_line(p);
+        p = print_str_new_line(p, "p = isl_printer_end_line(p);");
+      }
       else
       {
         p = print_str_new_line(p, "p = isl_printer_start_line(p);");
@@ -2585,6 +7754,11 @@ static __isl_give isl_printer *print_top_module_interface_xilinx(
         p = isl_printer_print_str(p, local_array->array->name);
         p = isl_printer_print_str(p, " offset=slave bundle=gmem_");
         p = isl_printer_print_str(p, local_array->array->name);
+        if (kernel->options->autosa->axi_burst)
+        {
+          p = print_axi_burst_options_xilinx(p, local_array, 1);
+          p = print_axi_burst_options_xilinx(p, local_array, 0);
+        }
         p = isl_printer_print_str(p, "\");");
         p = isl_printer_end_line(p);
         p = print_str_new_line(p, "p = isl_printer_end_line(p);");
@@ -2595,7 +7769,8 @@ static __isl_give isl_printer *print_top_module_interface_xilinx(
   for (int i = 0; i < kernel->n_array; ++i)
   {
     struct autosa_local_array_info *local_array = &kernel->array[i];
-    if (autosa_kernel_requires_array_argument(kernel, i))
+    if (autosa_kernel_requires_array_argument(kernel, i) &&
+        !local_array->host_stream)
     {
       if (local_array->n_io_group_refs > 1)
       {
@@ -2641,6 +7816,33 @@ static __isl_give isl_printer *print_top_module_interface_xilinx(
   }
   isl_space_free(space);
 
+  if (autosa_kernel_is_persistent(kernel, XILINX_HW))
+  {
+    p = print_str_new_line(p, "p = isl_printer_start_line(p);");
+    p = print_str_new_line(p, "p = isl_printer_print_str(p, \"#pragma HLS INTERFACE s_axilite port=n_batch bundle=control\");");
+    p = print_str_new_line(p, "p = isl_printer_end_line(p);");
+  }
+
+  if (kernel->options->autosa->perf_counters)
+  {
+    p = print_str_new_line(p, "p = isl_printer_start_line(p);");
+    p = print_str_new_line(p, "p = isl_printer_print_str(p, \"#pragma HLS INTERFACE m_axi port=perf offset=slave bundle=gmem_perf\");");
+    p = print_str_new_line(p, "p = isl_printer_end_line(p);");
+    p = print_str_new_line(p, "p = isl_printer_start_line(p);");
+    p = print_str_new_line(p, "p = isl_printer_print_str(p, \"#pragma HLS INTERFACE s_axilite port=perf bundle=control\");");
+    p = print_str_new_line(p, "p = isl_printer_end_line(p);");
+  }
+
+  if (kernel->options->autosa->fifo_trace)
+  {
+    p = print_str_new_line(p, "p = isl_printer_start_line(p);");
+    p = print_str_new_line(p, "p = isl_printer_print_str(p, \"#pragma HLS INTERFACE m_axi port=trace offset=slave bundle=gmem_trace\");");
+    p = print_str_new_line(p, "p = isl_printer_end_line(p);");
+    p = print_str_new_line(p, "p = isl_printer_start_line(p);");
+    p = print_str_new_line(p, "p = isl_printer_print_str(p, \"#pragma HLS INTERFACE s_axilite port=trace bundle=control\");");
+    p = print_str_new_line(p, "p = isl_printer_end_line(p);");
+  }
+
   n = isl_space_dim(kernel->space, isl_dim_set);
   type = isl_options_get_ast_iterator_type(prog->ctx);
   for (int i = 0; i < n; i++)
@@ -2779,31 +7981,108 @@ static __isl_give isl_printer *print_top_module_fifo_stmt(__isl_take isl_printer
     return autosa_kernel_print_fifo_decl(p, stmt, data->prog, data->hls);
   }
 
-  return p;
-}
+  return p;
+}
+
+static __isl_give isl_printer *print_top_module_call_stmt(
+    __isl_take isl_printer *p,
+    __isl_take isl_ast_print_options *print_options,
+    __isl_keep isl_ast_node *node, void *user)
+{
+  isl_id *id;
+  struct autosa_kernel_stmt *stmt;
+  struct print_hw_module_data *data = (struct print_hw_module_data *)(user);
+
+  id = isl_ast_node_get_annotation(node);
+  stmt = (struct autosa_kernel_stmt *)isl_id_get_user(id);
+  isl_id_free(id);
+
+  isl_ast_print_options_free(print_options);
+
+  switch (stmt->type)
+  {
+  case AUTOSA_KERNEL_STMT_MODULE_CALL:
+    return autosa_kernel_print_module_call(p, stmt, data->prog, data->hls->target);
+  }
+
+  return p;
+}
+
+/* Extract the names of the module counters of the top module.
+ * The number of names is returned in "n".
+ */
+static char **extract_top_module_names(isl_ctx *ctx,
+                                       struct autosa_hw_top_module *top, int *n)
+{
+  int n_module_names = 0;
+  char **module_names = NULL;
+
+  for (int i = 0; i < top->n_hw_modules; i++)
+  {
+    /* Generate module call counter. */
+    struct autosa_hw_module *module = top->hw_modules[i];
+    char *module_name;
+
+    if (autosa_hw_module_is_split(module))
+    {
+      module_name = concat(ctx, module->name, "intra_trans");
+
+      n_module_names++;
+      module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
+      module_names[n_module_names - 1] = module_name;
+
+      module_name = concat(ctx, module->name, "inter_trans");
+
+      n_module_names++;
+      module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
+      module_names[n_module_names - 1] = module_name;
+
+      if (module->boundary)
+      {
+        module_name = concat(ctx, module->name, "inter_trans_boundary");
+
+        n_module_names++;
+        module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
+        module_names[n_module_names - 1] = module_name;
+      }
+    }
+
+    module_name = strdup(module->name);
 
-static __isl_give isl_printer *print_top_module_call_stmt(
-    __isl_take isl_printer *p,
-    __isl_take isl_ast_print_options *print_options,
-    __isl_keep isl_ast_node *node, void *user)
-{
-  isl_id *id;
-  struct autosa_kernel_stmt *stmt;
-  struct print_hw_module_data *data = (struct print_hw_module_data *)(user);
+    n_module_names++;
+    module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
+    module_names[n_module_names - 1] = module_name;
 
-  id = isl_ast_node_get_annotation(node);
-  stmt = (struct autosa_kernel_stmt *)isl_id_get_user(id);
-  isl_id_free(id);
+    if (module->boundary)
+    {
+      module_name = concat(ctx, module->name, "boundary");
 
-  isl_ast_print_options_free(print_options);
+      n_module_names++;
+      module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
+      module_names[n_module_names - 1] = module_name;
+    }
 
-  switch (stmt->type)
-  {
-  case AUTOSA_KERNEL_STMT_MODULE_CALL:
-    return autosa_kernel_print_module_call(p, stmt, data->prog, data->hls->target);
+    if (module->n_pe_dummy_modules > 0)
+    {
+      for (int j = 0; j < module->n_pe_dummy_modules; j++)
+      {
+        struct autosa_pe_dummy_module *dummy_module = module->pe_dummy_modules[j];
+        struct autosa_array_ref_group *group = dummy_module->io_group;
+        isl_printer *p_str = isl_printer_to_str(ctx);
+        p_str = autosa_array_ref_group_print_prefix(group, p_str);
+        p_str = isl_printer_print_str(p_str, "_PE_dummy");
+        module_name = isl_printer_get_str(p_str);
+        isl_printer_free(p_str);
+
+        n_module_names++;
+        module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
+        module_names[n_module_names - 1] = module_name;
+      }
+    }
   }
 
-  return p;
+  *n = n_module_names;
+  return module_names;
 }
 
 /* This function prints the code that prints out the top function that 
@@ -2913,172 +8192,785 @@ static void print_top_gen_host_code(
   p = isl_printer_end_line(p);
 
   int n_module_names = 0;
-  char **module_names = NULL;
-  for (int i = 0; i < top->n_hw_modules; i++)
+  char **module_names = extract_top_module_names(ctx, top, &n_module_names);
+  for (int i = 0; i < n_module_names; i++)
   {
-    /* Generate module call counter. */
-    struct autosa_hw_module *module = top->hw_modules[i];
-    char *module_name;
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "int ");
+    p = isl_printer_print_str(p, module_names[i]);
+    p = isl_printer_print_str(p, "_cnt = 0;");
+    p = isl_printer_end_line(p);
+  }
+
+  /* Print module calls. */
+  for (int i = 0; i < top->n_module_calls; i++)
+  {
+    /* Print AST */
+    print_options = isl_ast_print_options_alloc(ctx);
+    print_options = isl_ast_print_options_set_print_user(print_options,
+                                                         &print_top_module_call_stmt, &hw_data);
+
+    p = isl_ast_node_print(top->module_call_wrapped_trees[i],
+                           p, print_options);
+  }
+
+  /* module:module_name:module_cnt. */
+  for (int i = 0; i < n_module_names; i++)
+  {
+    p = isl_printer_start_line(p);
+    p = isl_printer_print_str(p, "fprintf(fd, \"module:");
+    p = isl_printer_print_str(p, module_names[i]);
+    p = isl_printer_print_str(p, ":\%d\\n\", ");
+    p = isl_printer_print_str(p, module_names[i]);
+    p = isl_printer_print_str(p, "_cnt);");
+    p = isl_printer_end_line(p);
+  }
+  p = isl_printer_end_line(p);
+
+  for (int i = 0; i < n_module_names; i++)
+  {
+    free(module_names[i]);
+  }
+  free(module_names);
+
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "p = isl_printer_indent(p, -4);");
+  p = isl_printer_end_line(p);
 
-    if (module->is_filter && module->is_buffer)
+  p = print_str_new_line(p, "p = isl_printer_start_line(p);");
+  p = print_str_new_line(p, "p = isl_printer_print_str(p, \"}\");");
+  p = print_str_new_line(p, "p = isl_printer_end_line(p);");
+  if (hls->target == XILINX_HW)
+  {
+    if (!hls->hls)
     {
-      module_name = concat(ctx, module->name, "intra_trans");
+      p = print_str_new_line(p, "p = isl_printer_start_line(p);");
+      p = print_str_new_line(p, "p = isl_printer_print_str(p, \"}\");");
+      p = print_str_new_line(p, "p = isl_printer_end_line(p);");
+    }
+  }
 
-      n_module_names++;
-      module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
-      module_names[n_module_names - 1] = module_name;
+  p = isl_printer_end_line(p);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "fclose(fd);");
+  p = isl_printer_end_line(p);
 
-      module_name = concat(ctx, module->name, "inter_trans");
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "isl_printer_free(p);");
+  p = isl_printer_end_line(p);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "isl_ctx_free(ctx);");
+  p = isl_printer_end_line(p);
+  p = isl_printer_indent(p, -4);
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "}");
+  p = isl_printer_end_line(p);
+  p = isl_printer_end_line(p);
 
-      n_module_names++;
-      module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
-      module_names[n_module_names - 1] = module_name;
+  /* For internal testing only. */
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "int main()");
+  p = isl_printer_end_line(p);
 
-      if (module->boundary)
-      {
-        module_name = concat(ctx, module->name, "inter_trans_boundary");
+  p = ppcg_start_block(p);
 
-        n_module_names++;
-        module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
-        module_names[n_module_names - 1] = module_name;
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "FILE *f = fopen(\"");
+  p = isl_printer_print_str(p, hls->output_dir);
+  p = isl_printer_print_str(p, "/src/top.cpp\", \"w\");");
+  p = isl_printer_end_line(p);
+
+  p = isl_printer_start_line(p);
+  p = isl_printer_print_str(p, "top_generate(f);");
+  p = isl_printer_end_line(p);
+
+  p = ppcg_end_block(p);
+  p = isl_printer_free(p);
+
+  return;
+}
+
+/* Write out the floorplan of the module calls in "gen" of the kernel
+ * "kernel" on multiple SLRs.
+ * The pblocks are printed to "floorplan.tcl". The compute unit is placed on
+ * the SLR of most of the modules accessing the external memory, and each
+ * kernel port is mapped to the DDR bank of the SLR of the module accessing it
+ * in "connectivity.cfg", where the DDR bank i is attached to the SLR i.
+ * With HBM, the HBM channels are already mapped in "connectivity.cfg"
+ * and only the placement of the compute unit is appended.
+ */
+static isl_stat print_slr_floorplan_xilinx(struct autosa_top_gen *gen,
+                                           struct autosa_kernel *kernel, struct hls_info *hls)
+{
+  std::vector<int> n_port(kernel->options->autosa->n_slr, 0);
+  isl_printer *p_str;
+  char *file_path, *kernel_name;
+  int hbm = kernel->options->autosa->hbm;
+  int home = 0;
+  FILE *fp;
+
+  p_str = isl_printer_to_str(hls->ctx);
+  p_str = isl_printer_print_str(p_str, "kernel");
+  p_str = isl_printer_print_int(p_str, kernel->id);
+  kernel_name = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+
+  p_str = isl_printer_to_str(hls->ctx);
+  p_str = isl_printer_print_str(p_str, hls->output_dir);
+  p_str = isl_printer_print_str(p_str, "/src/floorplan.tcl");
+  file_path = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  fp = fopen(file_path, "w");
+  if (!fp)
+  {
+    printf("[AutoSA] Error: Can't open the file: %s\n", file_path);
+    free(file_path);
+    free(kernel_name);
+    return isl_stat_error;
+  }
+  autosa_top_gen_write_pblocks(gen, fp, kernel_name);
+  fclose(fp);
+  free(file_path);
+
+  p_str = isl_printer_to_str(hls->ctx);
+  p_str = isl_printer_print_str(p_str, hls->output_dir);
+  p_str = isl_printer_print_str(p_str, "/src/connectivity.cfg");
+  file_path = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  fp = fopen(file_path, hbm ? "a" : "w");
+  if (!fp)
+  {
+    printf("[AutoSA] Error: Can't open the file: %s\n", file_path);
+    free(file_path);
+    free(kernel_name);
+    return isl_stat_error;
+  }
+
+  if (!hbm)
+    fprintf(fp, "[connectivity]\n");
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    if (!autosa_kernel_requires_array_argument(kernel, i) ||
+        autosa_array_is_scalar(local_array->array) ||
+        local_array->host_stream)
+      continue;
+    for (int k = 0; k < local_array->n_io_group_refs; k++)
+    {
+      char port[256], bank_port[256];
+      int slr, bank, first;
+
+      if (local_array->n_io_group_refs > 1)
+        snprintf(port, sizeof(port), "%s_%d", local_array->array->name, k);
+      else
+        snprintf(port, sizeof(port), "%s", local_array->array->name);
+      slr = autosa_top_gen_get_port_slr(gen, port);
+      if (slr < 0)
+        continue;
+      n_port[slr]++;
+      if (hbm)
+        continue;
+      /* The ports sharing a host buffer are mapped to the bank of the
+       * first of them. */
+      for (first = 0; first < k; first++)
+        if (local_array->group_ref_mem_port_map[first].second ==
+            local_array->group_ref_mem_port_map[k].second)
+          break;
+      bank = slr;
+      if (first < k)
+      {
+        snprintf(bank_port, sizeof(bank_port), "%s_%d",
+                 local_array->array->name, first);
+        bank = autosa_top_gen_get_port_slr(gen, bank_port);
+        if (bank < 0)
+          bank = slr;
       }
+      fprintf(fp, "sp=%s_1.%s:DDR[%d]\n", kernel_name, port, bank);
     }
+  }
+  for (int i = 1; i < n_port.size(); i++)
+    if (n_port[i] > n_port[home])
+      home = i;
+  fprintf(fp, "slr=%s_1:SLR%d\n", kernel_name, home);
+  fclose(fp);
+  free(file_path);
+  free(kernel_name);
 
-    module_name = strdup(module->name);
+  return isl_stat_ok;
+}
 
-    n_module_names++;
-    module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
-    module_names[n_module_names - 1] = module_name;
+/* Print the AI Engine side of the kernel "kernel" whose PEs are mapped on
+ * the AI Engines by "gen": the kernel of the PEs, appended to
+ * "aie/kernels.cc" and declared in "aie/kernels.h", the graph in
+ * "aie/graph.h" and "aie/graph.cpp", and the connectivity of the PLIOs to
+ * the programmable logic in "aie/system.cfg".
+ */
+static isl_stat print_aie_graph_xilinx(struct autosa_top_gen *gen,
+                                       struct autosa_kernel *kernel, struct hls_info *hls)
+{
+  const char *files[] = {"kernels.h", "graph.h", "graph.cpp", "system.cfg"};
+  FILE *fp[4];
+  char kernel_name[32];
+  isl_stat r = isl_stat_ok;
+
+  if (autosa_top_gen_get_n_aie_pe(gen) == 0)
+  {
+    printf("[AutoSA] Warning: No PE is mapped on the AI Engines.\n");
+    return isl_stat_ok;
+  }
+
+  snprintf(kernel_name, sizeof(kernel_name), "kernel%d", kernel->id);
+  for (int i = 0; i < 4; i++)
+  {
+    isl_printer *p_str = isl_printer_to_str(hls->ctx);
+    char *file_path;
+
+    p_str = isl_printer_print_str(p_str, hls->output_dir);
+    p_str = isl_printer_print_str(p_str, "/src/aie/");
+    p_str = isl_printer_print_str(p_str, files[i]);
+    file_path = isl_printer_get_str(p_str);
+    isl_printer_free(p_str);
+    fp[i] = fopen(file_path, "w");
+    if (!fp[i])
+    {
+      printf("[AutoSA] Error: Can't open the file: %s\n", file_path);
+      r = isl_stat_error;
+    }
+    free(file_path);
+  }
+
+  if (r == isl_stat_ok)
+    r = autosa_top_gen_write_aie_kernels(gen, fp[0], hls->aie_c);
+  if (r == isl_stat_ok)
+    r = autosa_top_gen_write_aie_graph(gen, fp[1], kernel_name);
+  if (r == isl_stat_ok)
+  {
+    fprintf(fp[2], "#include \"graph.h\"\n\n");
+    fprintf(fp[2], "%s_graph g;\n\n", kernel_name);
+    fprintf(fp[2], "#if defined(__AIESIM__) || defined(__X86SIM__)\n");
+    fprintf(fp[2], "int main()\n");
+    fprintf(fp[2], "{\n");
+    fprintf(fp[2], "    g.init();\n");
+    fprintf(fp[2], "    g.run(1);\n");
+    fprintf(fp[2], "    g.end();\n");
+    fprintf(fp[2], "    return 0;\n");
+    fprintf(fp[2], "}\n");
+    fprintf(fp[2], "#endif\n");
+    r = autosa_top_gen_write_aie_connectivity(gen, fp[3], kernel_name);
+  }
+  for (int i = 0; i < 4; i++)
+    if (fp[i])
+      fclose(fp[i]);
+
+  return r;
+}
+
+/* Write out the Vitis linker configuration "clock.cfg" of the PE kernel
+ * of "kernel" in the PE clock, connected to the compute unit of "kernel"
+ * through the clock-crossing FIFOs.
+ * If the PEs could not be moved to their own kernel, no file is written
+ * and the whole kernel runs in the kernel clock.
+ */
+static isl_stat print_clock_config_xilinx(struct autosa_top_gen *gen,
+                                          struct autosa_kernel *kernel, struct hls_info *hls)
+{
+  char kernel_name[32];
+  isl_printer *p_str;
+  char *file_path;
+  isl_stat r;
+  FILE *fp;
+
+  snprintf(kernel_name, sizeof(kernel_name), "kernel%d", kernel->id);
+  p_str = isl_printer_to_str(hls->ctx);
+  p_str = isl_printer_print_str(p_str, hls->output_dir);
+  p_str = isl_printer_print_str(p_str, "/src/clock.cfg");
+  file_path = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  remove(file_path);
+  fp = fopen(file_path, "w");
+  if (!fp)
+  {
+    printf("[AutoSA] Error: Can't open the file: %s\n", file_path);
+    free(file_path);
+    return isl_stat_error;
+  }
+  r = autosa_top_gen_write_clock_config(gen, fp, kernel_name,
+                                        kernel->options->autosa->kernel_clock);
+  fclose(fp);
+  if (r < 0)
+    remove(file_path);
+  free(file_path);
+
+  return isl_stat_ok;
+}
+
+/* Write out the names of the module instances connected to the performance
+ * counters in "gen" and the function printing out the counters
+ * to "perf_counters.h", which is included by the host.
+ */
+static isl_stat print_perf_counters_names_xilinx(struct autosa_top_gen *gen,
+                                                 struct hls_info *hls)
+{
+  isl_printer *p_str;
+  char *file_path;
+  isl_stat r;
+  FILE *fp;
+
+  p_str = isl_printer_to_str(hls->ctx);
+  p_str = isl_printer_print_str(p_str, hls->output_dir);
+  p_str = isl_printer_print_str(p_str, "/src/perf_counters.h");
+  file_path = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  fp = fopen(file_path, "w");
+  if (!fp)
+  {
+    printf("[AutoSA] Error: Can't open the file: %s\n", file_path);
+    free(file_path);
+    return isl_stat_error;
+  }
+  r = autosa_top_gen_write_perf_counters(gen, fp);
+  fclose(fp);
+  free(file_path);
+
+  return r;
+}
+
+/* Return the direction of the FIFO argument "pos" among the "n_fifo"
+ * FIFO arguments of a call of "func", given the top module "user".
+ */
+static int top_module_fifo_arg_dir(const char *func, int pos, int n_fifo,
+                                   void *user)
+{
+  struct autosa_hw_top_module *top = (struct autosa_hw_top_module *)user;
+
+  return autosa_sim_fifo_arg_dir(top->kernel->ctx, top->n_hw_modules,
+                                 top->hw_modules, func, pos, n_fifo);
+}
+
+/* This function generates the top function that calls the hardware modules
+ * and declares the fifos directly, instead of compiling and executing
+ * the code printed by print_top_gen_host_code.
+ * The top module ASTs are interpreted by autosa_top_gen, and the module
+ * calls are reordered the same way as in autosa_scripts/codegen.py.
+ * The top function is printed to "output_dir/src/top.cpp" and the design
+ * information to "output_dir/resource_est/design_info.dat".
+ * If the top function cannot be generated, neither file is printed, and
+ * the post-processing scripts fall back to the code printed by
+ * print_top_gen_host_code.
+ */
+static isl_stat print_top_module_native(
+    struct autosa_prog *prog, __isl_keep isl_ast_node *node,
+    struct autosa_hw_top_module *top, struct hls_info *hls)
+{
+  isl_ctx *ctx = isl_ast_node_get_ctx(node);
+  isl_printer *p_str, *p_info;
+  struct print_hw_module_data hw_data = {hls, prog, NULL};
+  struct autosa_top_gen *gen;
+  isl_stat r = isl_stat_ok;
+  char *code, *info;
+  char *top_path, *info_path;
+  FILE *fp;
+
+  p_str = isl_printer_to_str(ctx);
+  p_str = isl_printer_print_str(p_str, hls->output_dir);
+  p_str = isl_printer_print_str(p_str, "/src/top.cpp");
+  top_path = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  p_str = isl_printer_to_str(ctx);
+  p_str = isl_printer_print_str(p_str, hls->output_dir);
+  p_str = isl_printer_print_str(p_str, "/resource_est/design_info.dat");
+  info_path = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  remove(top_path);
+
+  gen = autosa_top_gen_alloc(ctx);
+  if (!hls->hls)
+    autosa_top_gen_set_n_slr(gen, top->kernel->options->autosa->n_slr);
+  autosa_top_gen_set_chain_pipeline(gen,
+                                    top->kernel->options->autosa->chain_pipeline);
+  autosa_top_gen_set_perf_counters(gen, hls->perf_counters);
+  if (hls->fifo_trace)
+    autosa_top_gen_set_fifo_trace(gen, top->kernel->options->autosa->fifo_trace,
+                                  &top_module_fifo_arg_dir, top);
+  if (hls->aie_c)
+    autosa_top_gen_set_aie(gen, 1, &top_module_fifo_arg_dir, top);
+  if (top->kernel->options->autosa->pe_clock > 0)
+    autosa_top_gen_set_pe_clock(gen, top->kernel->options->autosa->pe_clock,
+                                &top_module_fifo_arg_dir, top);
+  autosa_top_gen_set_threads(gen, hls->cpu_sim);
+  autosa_top_gen_set_module_template(gen,
+                                     top->kernel->options->autosa->module_template);
+  /* The read and write modules of an array share the credit FIFO
+   * "fifo_[group]_credit".
+   */
+  for (int i = 0; i < top->n_hw_modules; i++)
+  {
+    struct autosa_hw_module *module = top->hw_modules[i];
+    const char *suffix = module->in ? "_in" : "_out";
+    char *group_name, *fifo_name;
+    size_t len;
 
+    if (!module->credit)
+      continue;
+    group_name = strdup(module->name);
+    len = strlen(group_name);
+    if (len > strlen(suffix) && !strcmp(group_name + len - strlen(suffix), suffix))
+      group_name[len - strlen(suffix)] = '\0';
+    p_str = isl_printer_to_str(ctx);
+    p_str = isl_printer_print_str(p_str, "fifo_");
+    p_str = isl_printer_print_str(p_str, group_name);
+    p_str = isl_printer_print_str(p_str, "_credit");
+    fifo_name = isl_printer_get_str(p_str);
+    isl_printer_free(p_str);
+    free(group_name);
+    autosa_top_gen_add_credit(gen, module->name, fifo_name, module->credit);
     if (module->boundary)
     {
-      module_name = concat(ctx, module->name, "boundary");
-
-      n_module_names++;
-      module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
-      module_names[n_module_names - 1] = module_name;
-    }
-
-    if (module->n_pe_dummy_modules > 0)
-    {
-      for (int j = 0; j < module->n_pe_dummy_modules; j++)
-      {
-        struct autosa_pe_dummy_module *dummy_module = module->pe_dummy_modules[j];
-        struct autosa_array_ref_group *group = dummy_module->io_group;
-        isl_printer *p_str = isl_printer_to_str(ctx);
-        p_str = autosa_array_ref_group_print_prefix(group, p_str);
-        p_str = isl_printer_print_str(p_str, "_PE_dummy");
-        module_name = isl_printer_get_str(p_str);
-        isl_printer_free(p_str);
-
-        n_module_names++;
-        module_names = (char **)realloc(module_names, n_module_names * sizeof(char *));
-        module_names[n_module_names - 1] = module_name;
-      }
+      char *boundary_name = concat(ctx, module->name, "boundary");
+      autosa_top_gen_add_credit(gen, boundary_name, fifo_name, module->credit);
+      free(boundary_name);
     }
+    free(fifo_name);
   }
-  for (int i = 0; i < n_module_names; i++)
+  /* The PEs read the irregular arrays through their caches. */
+  for (int i = 0; i < top->kernel->n_array && hls->cache_sets > 0; i++)
   {
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "int ");
-    p = isl_printer_print_str(p, module_names[i]);
-    p = isl_printer_print_str(p, "_cnt = 0;");
-    p = isl_printer_end_line(p);
+    struct autosa_array_info *array = top->kernel->array[i].array;
+    char *size;
+
+    if (!array->irregular)
+      continue;
+    p_str = isl_printer_to_str(ctx);
+    p_str = autosa_array_info_print_data_size(p_str, array);
+    size = isl_printer_get_str(p_str);
+    isl_printer_free(p_str);
+    autosa_top_gen_add_cache(gen, array->name, array->type, size,
+                             hls->cache_sets, hls->cache_ways);
+    free(size);
   }
+  p_info = isl_printer_to_str(ctx);
+
+  /* Print the headers. */
+  p_str = isl_printer_to_str(ctx);
+  p_str = print_top_module_headers_xilinx(p_str, prog, top, hls);
+  p_str = print_str_new_line(p_str, "p = isl_printer_indent(p, 4);");
+  p_str = print_str_new_line(p_str, "p = isl_printer_start_line(p);");
+  p_str = print_str_new_line(p_str, "p = isl_printer_print_str(p, \"/* FIFO Declaration */\");");
+  p_str = print_str_new_line(p_str, "p = isl_printer_end_line(p);");
+  code = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  r = autosa_top_gen_exec_str(gen, code);
+  free(code);
 
-  /* Print module calls. */
-  for (int i = 0; i < top->n_module_calls; i++)
+  /* Print FIFO declarations. */
+  for (int i = 0; i < top->n_fifo_decls && r == isl_stat_ok; i++)
   {
-    /* Print AST */
-    print_options = isl_ast_print_options_alloc(ctx);
-    print_options = isl_ast_print_options_set_print_user(print_options,
-                                                         &print_top_module_call_stmt, &hw_data);
+    char *fifo_decl_name = top->fifo_decl_names[i];
+    char *fifo_name = extract_fifo_name_from_fifo_decl_name(ctx, fifo_decl_name);
+    char *fifo_w = extract_fifo_width_from_fifo_decl_name(ctx, fifo_decl_name);
 
-    p = isl_ast_node_print(top->module_call_wrapped_trees[i],
-                           p, print_options);
+    autosa_top_gen_set_var(gen, "fifo_cnt", 0);
+    r = autosa_top_gen_exec_tree(gen, top->fifo_decl_wrapped_trees[i],
+                                 &print_top_module_fifo_stmt, &hw_data);
+
+    /* fifo:fifo_name:fifo_cnt:fifo_width */
+    p_info = isl_printer_print_str(p_info, "fifo:");
+    p_info = isl_printer_print_str(p_info, fifo_name);
+    p_info = isl_printer_print_str(p_info, ":");
+    p_info = isl_printer_print_int(p_info,
+                                   autosa_top_gen_get_var(gen, "fifo_cnt"));
+    p_info = isl_printer_print_str(p_info, ":");
+    p_info = isl_printer_print_str(p_info, fifo_w);
+    p_info = isl_printer_print_str(p_info, "\n");
+
+    free(fifo_name);
+    free(fifo_w);
   }
 
-  /* module:module_name:module_cnt. */
+  if (r == isl_stat_ok)
+    r = autosa_top_gen_exec_str(gen,
+                                "p = isl_printer_start_line(p);\n"
+                                "p = isl_printer_print_str(p, \"/* FIFO Declaration */\");\n"
+                                "p = isl_printer_end_line(p);\n"
+                                "p = isl_printer_end_line(p);\n");
+
+  /* Print module calls. */
+  int n_module_names = 0;
+  char **module_names = extract_top_module_names(ctx, top, &n_module_names);
   for (int i = 0; i < n_module_names; i++)
   {
-    p = isl_printer_start_line(p);
-    p = isl_printer_print_str(p, "fprintf(fd, \"module:");
-    p = isl_printer_print_str(p, module_names[i]);
-    p = isl_printer_print_str(p, ":\%d\\n\", ");
-    p = isl_printer_print_str(p, module_names[i]);
-    p = isl_printer_print_str(p, "_cnt);");
-    p = isl_printer_end_line(p);
+    char *cnt_name = concat(ctx, module_names[i], "cnt");
+    autosa_top_gen_set_var(gen, cnt_name, 0);
+    free(cnt_name);
+  }
+
+  for (int i = 0; i < top->n_module_calls && r == isl_stat_ok; i++)
+  {
+    r = autosa_top_gen_exec_tree(gen, top->module_call_wrapped_trees[i],
+                                 &print_top_module_call_stmt, &hw_data);
   }
-  p = isl_printer_end_line(p);
 
+  /* module:module_name:module_cnt */
   for (int i = 0; i < n_module_names; i++)
   {
+    char *cnt_name = concat(ctx, module_names[i], "cnt");
+    p_info = isl_printer_print_str(p_info, "module:");
+    p_info = isl_printer_print_str(p_info, module_names[i]);
+    p_info = isl_printer_print_str(p_info, ":");
+    p_info = isl_printer_print_int(p_info, autosa_top_gen_get_var(gen, cnt_name));
+    p_info = isl_printer_print_str(p_info, "\n");
+    free(cnt_name);
     free(module_names[i]);
   }
   free(module_names);
 
-  p = isl_printer_start_line(p);
-  p = isl_printer_print_str(p, "p = isl_printer_indent(p, -4);");
-  p = isl_printer_end_line(p);
-
-  p = print_str_new_line(p, "p = isl_printer_start_line(p);");
-  p = print_str_new_line(p, "p = isl_printer_print_str(p, \"}\");");
-  p = print_str_new_line(p, "p = isl_printer_end_line(p);");
-  if (hls->target == XILINX_HW)
+  if (r == isl_stat_ok)
+    r = autosa_top_gen_exec_str(gen,
+                                "p = isl_printer_indent(p, -4);\n"
+                                "p = isl_printer_start_line(p);\n"
+                                "p = isl_printer_print_str(p, \"}\");\n"
+                                "p = isl_printer_end_line(p);\n");
+  if (r == isl_stat_ok && !hls->hls)
+    r = autosa_top_gen_exec_str(gen,
+                                "p = isl_printer_start_line(p);\n"
+                                "p = isl_printer_print_str(p, \"}\");\n"
+                                "p = isl_printer_end_line(p);\n");
+
+  if (r == isl_stat_ok)
   {
-    if (!hls->hls)
+    fp = fopen(top_path, "w");
+    if (fp)
     {
-      p = print_str_new_line(p, "p = isl_printer_start_line(p);");
-      p = print_str_new_line(p, "p = isl_printer_print_str(p, \"}\");");
-      p = print_str_new_line(p, "p = isl_printer_end_line(p);");
+      r = autosa_top_gen_write(gen, fp, 1);
+      fclose(fp);
+    }
+    else
+    {
+      r = isl_stat_error;
     }
   }
+  if (r == isl_stat_ok && !hls->hls &&
+      top->kernel->options->autosa->n_slr > 1)
+    r = print_slr_floorplan_xilinx(gen, top->kernel, hls);
+  if (r == isl_stat_ok && hls->perf_counters)
+    r = print_perf_counters_names_xilinx(gen, hls);
+  if (r == isl_stat_ok && hls->aie_c)
+    r = print_aie_graph_xilinx(gen, top->kernel, hls);
+  if (r == isl_stat_ok && top->kernel->options->autosa->pe_clock > 0)
+    r = print_clock_config_xilinx(gen, top->kernel, hls);
+  if (r == isl_stat_ok)
+  {
+    info = isl_printer_get_str(p_info);
+    fp = fopen(info_path, "w");
+    if (fp)
+    {
+      fprintf(fp, "%s", info);
+      fclose(fp);
+    }
+    free(info);
+  }
+  else
+  {
+    remove(top_path);
+    printf("[AutoSA] Warning: Failed to generate the top module natively.\n");
+  }
 
-  p = isl_printer_end_line(p);
-  p = isl_printer_start_line(p);
-  p = isl_printer_print_str(p, "fclose(fd);");
-  p = isl_printer_end_line(p);
+  isl_printer_free(p_info);
+  autosa_top_gen_free(gen);
+  free(top_path);
+  free(info_path);
 
-  p = isl_printer_start_line(p);
-  p = isl_printer_print_str(p, "isl_printer_free(p);");
-  p = isl_printer_end_line(p);
-  p = isl_printer_start_line(p);
-  p = isl_printer_print_str(p, "isl_ctx_free(ctx);");
-  p = isl_printer_end_line(p);
-  p = isl_printer_indent(p, -4);
-  p = isl_printer_start_line(p);
-  p = isl_printer_print_str(p, "}");
-  p = isl_printer_end_line(p);
-  p = isl_printer_end_line(p);
+  return r;
+}
 
-  /* For internal testing only. */
-  p = isl_printer_start_line(p);
-  p = isl_printer_print_str(p, "int main()");
-  p = isl_printer_end_line(p);
+/* Given a autosa_prog "prog" and the corresponding tranformed AST
+ * "tree", print the entire OpenCL/HLS code to "p".
+ * "types" collects the types for which a definition has already been
+ * printed.
+ */
+/* Print the name of the kernel argument of "local_array"
+ * connected to the io_group_ref "ref".
+ */
+static void print_kernel_port_name(FILE *fp,
+                                   struct autosa_local_array_info *local_array, int ref)
+{
+  if (local_array->n_io_group_refs > 1)
+    fprintf(fp, "%s_%d", local_array->array->name, ref);
+  else
+    fprintf(fp, "%s", local_array->array->name);
+}
 
-  p = ppcg_start_block(p);
+/* Print the number of compute units "n_cu" of the kernel "kernel"
+ * and their names, kernel<id>_1 to kernel<id>_<n_cu>, to "fp".
+ */
+static void print_cu_nk_xilinx(FILE *fp, struct autosa_kernel *kernel,
+                               int n_cu)
+{
+  fprintf(fp, "nk=kernel%d:%d:", kernel->id, n_cu);
+  for (int c = 0; c < n_cu; c++)
+    fprintf(fp, "%skernel%d_%d", c > 0 ? "." : "", kernel->id, c + 1);
+  fprintf(fp, "\n");
+}
 
-  p = isl_printer_start_line(p);
-  p = isl_printer_print_str(p, "FILE *f = fopen(\"");
-  p = isl_printer_print_str(p, hls->output_dir);
-  p = isl_printer_print_str(p, "/src/top.cpp\", \"w\");");
-  p = isl_printer_end_line(p);
+/* Generate the Vitis connectivity file "connectivity.cfg" for the "n_cu"
+ * compute units of "kernel".
+ * All the external memory ports of the compute unit c are mapped to
+ * the DDR bank c, so that the compute units don't share the bandwidth
+ * of a bank (see sa_select_compute_units).
+ */
+static isl_stat print_cu_connectivity_xilinx(struct autosa_kernel *kernel,
+                                             struct hls_info *hls, int n_cu)
+{
+  isl_printer *p_str;
+  char *file_path;
+  FILE *fp;
 
-  p = isl_printer_start_line(p);
-  p = isl_printer_print_str(p, "top_generate(f);");
-  p = isl_printer_end_line(p);
+  p_str = isl_printer_to_str(hls->ctx);
+  p_str = isl_printer_print_str(p_str, hls->output_dir);
+  p_str = isl_printer_print_str(p_str, "/src/connectivity.cfg");
+  file_path = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  fp = fopen(file_path, "w");
+  if (!fp)
+  {
+    printf("[AutoSA] Error: Can't open the file: %s\n", file_path);
+    free(file_path);
+    return isl_stat_error;
+  }
 
-  p = ppcg_end_block(p);
-  p = isl_printer_free(p);
+  fprintf(fp, "[connectivity]\n");
+  print_cu_nk_xilinx(fp, kernel, n_cu);
+  for (int c = 0; c < n_cu; c++)
+  {
+    for (int i = 0; i < kernel->n_array; i++)
+    {
+      struct autosa_local_array_info *local_array = &kernel->array[i];
+      if (!autosa_kernel_requires_array_argument(kernel, i) ||
+          autosa_array_is_scalar(local_array->array))
+        continue;
+      for (int k = 0; k < local_array->n_io_group_refs; k++)
+      {
+        fprintf(fp, "sp=kernel%d_%d.", kernel->id, c + 1);
+        print_kernel_port_name(fp, local_array, k);
+        fprintf(fp, ":DDR[%d]\n", c);
+      }
+    }
+  }
+  fclose(fp);
+  free(file_path);
 
-  return;
+  return isl_stat_ok;
 }
 
-/* Given a autosa_prog "prog" and the corresponding tranformed AST
- * "tree", print the entire OpenCL/HLS code to "p".
- * "types" collects the types for which a definition has already been
- * printed.
+/* Generate the Vitis connectivity file "connectivity.cfg", which maps
+ * each external memory port of the kernel to an HBM channel.
+ * The kernel ports sharing the same host buffer (one buffer per array and
+ * memory port) are mapped to the same channel.
+ * The buffers are assigned in the order of decreasing bandwidth demand
+ * to the least loaded channel. If the number of channels is not specified,
+ * each buffer is assigned its own channel.
+ * With multiple compute units, each compute unit is assigned its own
+ * range of channels.
  */
+static isl_stat print_hbm_connectivity_xilinx(struct autosa_kernel *kernel,
+                                              struct hls_info *hls)
+{
+  std::vector<std::pair<int, int> > buffers;
+  std::vector<double> demands;
+  std::vector<int> assigned;
+  std::vector<double> loads;
+  std::vector<int> n_buffer;
+  std::vector<bool> done;
+  int n_channel;
+  int n_cu = kernel->options->autosa->compute_units;
+  isl_printer *p_str;
+  char *file_path;
+  FILE *fp;
+
+  for (int i = 0; i < kernel->n_array; i++)
+  {
+    struct autosa_local_array_info *local_array = &kernel->array[i];
+    if (!autosa_kernel_requires_array_argument(kernel, i) ||
+        autosa_array_is_scalar(local_array->array) ||
+        local_array->host_stream)
+      continue;
+    for (int j = 0; j < local_array->n_mem_ports; j++)
+    {
+      double demand = 0;
+      for (int k = 0; k < local_array->n_io_group_refs; k++)
+        if (local_array->group_ref_mem_port_map[k].second == j)
+          demand += local_array->group_ref_bw_demand[k];
+      buffers.push_back(std::pair<int, int>(i, j));
+      demands.push_back(demand);
+      assigned.push_back(-1);
+      done.push_back(false);
+    }
+  }
+  if (buffers.size() == 0)
+    return isl_stat_ok;
+
+  n_channel = kernel->options->autosa->n_hbm_channel;
+  if (n_channel <= 0)
+    n_channel = buffers.size();
+  if (n_channel < buffers.size())
+    printf("[AutoSA] Warning: %d memory ports are mapped to %d HBM channels.\n",
+           (int)buffers.size(), n_channel);
+  loads.assign(n_channel, 0);
+  n_buffer.assign(n_channel, 0);
+
+  for (int n = 0; n < buffers.size(); n++)
+  {
+    int cur = -1, ch = 0;
+    for (int i = 0; i < buffers.size(); i++)
+      if (!done[i] && (cur == -1 || demands[i] > demands[cur]))
+        cur = i;
+    for (int c = 1; c < n_channel; c++)
+      if (loads[c] < loads[ch] ||
+          (loads[c] == loads[ch] && n_buffer[c] < n_buffer[ch]))
+        ch = c;
+    loads[ch] += demands[cur];
+    n_buffer[ch]++;
+    assigned[cur] = ch;
+    done[cur] = true;
+  }
+
+  p_str = isl_printer_to_str(hls->ctx);
+  p_str = isl_printer_print_str(p_str, hls->output_dir);
+  p_str = isl_printer_print_str(p_str, "/src/connectivity.cfg");
+  file_path = isl_printer_get_str(p_str);
+  isl_printer_free(p_str);
+  fp = fopen(file_path, "w");
+  if (!fp)
+  {
+    printf("[AutoSA] Error: Can't open the file: %s\n", file_path);
+    free(file_path);
+    return isl_stat_error;
+  }
+
+  fprintf(fp, "[connectivity]\n");
+  if (n_cu > 1)
+    print_cu_nk_xilinx(fp, kernel, n_cu);
+  for (int c = 0; c < n_cu; c++)
+  {
+    for (int n = 0; n < buffers.size(); n++)
+    {
+      struct autosa_local_array_info *local_array = &kernel->array[buffers[n].first];
+      for (int k = 0; k < local_array->n_io_group_refs; k++)
+      {
+        if (local_array->group_ref_mem_port_map[k].second != buffers[n].second)
+          continue;
+        fprintf(fp, "sp=kernel%d_%d.", kernel->id, c + 1);
+        print_kernel_port_name(fp, local_array, k);
+        fprintf(fp, ":HBM[%d]\n", c * n_channel + assigned[n]);
+      }
+    }
+  }
+  fclose(fp);
+  free(file_path);
+
+  return isl_stat_ok;
+}
+
 static __isl_give isl_printer *print_hw(
     __isl_take isl_printer *p,
     struct autosa_prog *prog, __isl_keep isl_ast_node *tree,
@@ -3089,6 +8981,15 @@ static __isl_give isl_printer *print_hw(
 {
   struct hls_info *hls = (struct hls_info *)user;
   isl_printer *kernel;
+  int n_cu = top_module->kernel->options->autosa->compute_units;
+
+  if (n_cu > 1)
+  {
+    /* The batches in the slot "s" always run on the compute unit
+     * "s % n_cu", so that the device buffers of each slot stay in
+     * the memory bank of a single compute unit. */
+    hls->host_batch = (max(hls->host_batch, n_cu) + n_cu - 1) / n_cu * n_cu;
+  }
 
   kernel = isl_printer_to_file(isl_printer_get_ctx(p), hls->kernel_c);
   kernel = isl_printer_set_output_format(kernel, ISL_FORMAT_C);
@@ -3098,11 +8999,34 @@ static __isl_give isl_printer *print_hw(
   if (!kernel)
     return isl_printer_free(p);
 
+  if (hls->aie_c)
+  {
+    struct autosa_types aie_types = {0, NULL};
+
+    kernel = isl_printer_to_file(isl_printer_get_ctx(p), hls->aie_c);
+    kernel = isl_printer_set_output_format(kernel, ISL_FORMAT_C);
+    kernel = autosa_print_types(kernel, &aie_types, prog);
+    isl_printer_free(kernel);
+    for (int i = 0; i < aie_types.n; i++)
+      free(aie_types.name[i]);
+    free(aie_types.name);
+  }
+
   /* Print OpenCL host and kernel function. */
   p = autosa_print_host_code(p, prog, tree, modules, n_modules, top_module,
                              drain_merge_funcs, n_drain_merge_funcs, hls);
   /* Print seperate top module code generation function. */
   print_top_gen_host_code(prog, tree, top_module, hls);
+  /* Map the external memory ports to the HBM channels. */
+  if (top_module->kernel->options->autosa->hbm && !hls->hls)
+    print_hbm_connectivity_xilinx(top_module->kernel, hls);
+  /* Map the compute units to the DDR banks. */
+  else if (n_cu > 1)
+    print_cu_connectivity_xilinx(top_module->kernel, hls, n_cu);
+  /* Generate the top module directly, and floorplan it on the SLRs. */
+  print_top_module_native(prog, tree, top_module, hls);
+  if (top_module->kernel->options->autosa->axi_burst)
+    report_short_axi_bursts(top_module->kernel);
 
   return p;
 }
@@ -3117,13 +9041,250 @@ int generate_autosa_xilinx_hls_c(isl_ctx *ctx, struct ppcg_options *options,
 
   hls.target = XILINX_HW;
   hls.hls = options->autosa->hls;
+  hls.cpu_sim = (options->target == AUTOSA_TARGET_C);
+  hls.host_batch = options->autosa->host_batch;
+  if (options->autosa->compute_units != 1 &&
+      (hls.hls || hls.cpu_sim || options->autosa->host_xrt ||
+       options->autosa->multi_device > 1 ||
+       options->autosa->persistent_kernel || options->autosa->aie ||
+       options->autosa->pe_clock > 0 || options->autosa->n_slr > 1))
+  {
+    /* The compute units are launched through the OpenCL kernel objects of
+     * a single device, and the AI Engine graph, the PE kernel and
+     * the floorplan are connected to a single compute unit. */
+    printf("[AutoSA] Warning: Multiple compute units are only supported in the OpenCL host on a single device, without persistent kernels, AI Engines, the PE clock or SLR floorplanning. Disabled.\n");
+    options->autosa->compute_units = 1;
+  }
+  if (options->autosa->compute_units != 1 && hls.host_batch == 1)
+  {
+    /* The independent requests are distributed to the compute units
+     * as batches, see print_hw. */
+    hls.host_batch = 2;
+  }
+  hls.host_serialize = options->autosa->host_serialize;
+  if (hls.host_serialize &&
+      (hls.hls || hls.host_batch > 1 || options->autosa->persistent_kernel))
+  {
+    printf("[AutoSA] Warning: Host serialization is only supported in the OpenCL host with a single batch. Disabled.\n");
+    hls.host_serialize = 0;
+  }
+  hls.host_zero_copy = options->autosa->host_zero_copy;
+  hls.host_xrt = options->autosa->host_xrt;
+  if (hls.host_xrt && (hls.hls || hls.cpu_sim))
+  {
+    printf("[AutoSA] Warning: The XRT host is not supported in the HLS host or in the CPU simulation. Disabled.\n");
+    hls.host_xrt = 0;
+  }
+  if (options->autosa->host_threads > 1 && (hls.hls || hls.cpu_sim))
+  {
+    printf("[AutoSA] Warning: The multithreaded host preparation is only supported in the OpenCL or XRT host. Disabled.\n");
+    options->autosa->host_threads = 1;
+  }
+  hls.host_threads = options->autosa->host_threads;
+  if (options->autosa->host_simd_unpack && (hls.hls || hls.cpu_sim))
+  {
+    printf("[AutoSA] Warning: The SIMD unpacking of the outputs is only supported in the OpenCL or XRT host. Disabled.\n");
+    options->autosa->host_simd_unpack = 0;
+  }
+  hls.host_simd_unpack = options->autosa->host_simd_unpack;
+  hls.host_session = options->autosa->host_session;
+  if (hls.host_session &&
+      (hls.hls || hls.cpu_sim || hls.host_batch > 1 || hls.host_serialize ||
+       options->autosa->multi_device > 1))
+  {
+    /* The session binds a single set of device buffers to the host arrays
+     * in their original layout. */
+    printf("[AutoSA] Warning: The host session is only supported in the OpenCL or XRT host with a single batch, a single device and without host serialization. Disabled.\n");
+    hls.host_session = 0;
+  }
+  hls.host_bench = options->autosa->host_bench;
+  hls.host_bench_warmup = options->autosa->host_bench_warmup;
+  if (hls.host_bench > 0 && (hls.hls || hls.cpu_sim || hls.host_batch > 1))
+  {
+    printf("[AutoSA] Warning: The host benchmark mode is only supported in the OpenCL host with a single batch. Disabled.\n");
+    hls.host_bench = 0;
+  }
+  if (hls.host_xrt && (hls.host_bench > 0 || options->autosa->perf_counters ||
+                       options->autosa->fifo_trace))
+  {
+    /* The benchmark mode and the profiling buffers rely on the OpenCL
+     * events and buffers. */
+    printf("[AutoSA] Warning: The host benchmark mode, the performance counters and the FIFO traces are only supported in the OpenCL host. Disabled.\n");
+    hls.host_bench = 0;
+    options->autosa->perf_counters = 0;
+    free(options->autosa->fifo_trace);
+    options->autosa->fifo_trace = NULL;
+  }
+  hls.qdma_stream = options->autosa->qdma_stream != NULL;
+  if (hls.qdma_stream &&
+      (hls.hls || hls.cpu_sim || hls.host_xrt || !hls.host_serialize ||
+       hls.host_bench > 0 || options->autosa->multi_device > 1))
+  {
+    /* The streams are fed from the serialized arrays by the OpenCL
+     * extensions of a single device, once per launch. */
+    printf("[AutoSA] Warning: The QDMA streams are only supported in the OpenCL host with serialized arrays (--AutoSA-host-serialize), without the benchmark mode or multiple devices. Option --AutoSA-qdma-stream is ignored.\n");
+    free(options->autosa->qdma_stream);
+    options->autosa->qdma_stream = NULL;
+    hls.qdma_stream = 0;
+  }
+  if (hls.host_zero_copy && hls.host_batch > 1)
+  {
+    printf("[AutoSA] Warning: Zero-copy host buffers are not supported with multiple in-flight batches. Disabled.\n");
+    hls.host_zero_copy = 0;
+  }
+  if (options->autosa->perf_counters && (hls.cpu_sim || hls.host_batch > 1))
+  {
+    printf("[AutoSA] Warning: Performance counters are not supported with multiple in-flight batches or in the CPU simulation. Disabled.\n");
+    options->autosa->perf_counters = 0;
+  }
+  if (options->autosa->fifo_trace && !options->autosa->perf_counters)
+  {
+    if (hls.cpu_sim || hls.host_batch > 1)
+    {
+      printf("[AutoSA] Warning: FIFO traces are not supported with multiple in-flight batches or in the CPU simulation. Option --AutoSA-fifo-trace is ignored.\n");
+      free(options->autosa->fifo_trace);
+      options->autosa->fifo_trace = NULL;
+    }
+    else
+    {
+      /* The trace processes stop on the performance counters of the
+       * modules reading the traced FIFOs. */
+      printf("[AutoSA] FIFO traces require the performance counters. Option --AutoSA-perf-counters is enabled.\n");
+      options->autosa->perf_counters = 1;
+    }
+  }
+  if (options->autosa->multi_device > 1 &&
+      (hls.hls || hls.cpu_sim || hls.host_batch > 1 || hls.host_xrt ||
+       options->autosa->persistent_kernel))
+  {
+    printf("[AutoSA] Warning: Multiple devices are only supported in the OpenCL host with a single batch. Disabled.\n");
+    options->autosa->multi_device = 1;
+  }
+  if (options->autosa->multi_device > 1 &&
+      (hls.host_serialize || hls.host_zero_copy || hls.host_bench > 0 ||
+       options->autosa->perf_counters || options->autosa->fifo_trace))
+  {
+    /* The devices get their own shifted copies of the host buffers,
+     * and are launched through their own command queues. */
+    printf("[AutoSA] Warning: Host serialization, zero-copy host buffers, the host benchmark mode, the performance counters and the FIFO traces are not supported on multiple devices. Disabled.\n");
+    hls.host_serialize = 0;
+    hls.host_zero_copy = 0;
+    hls.host_bench = 0;
+    options->autosa->perf_counters = 0;
+    free(options->autosa->fifo_trace);
+    options->autosa->fifo_trace = NULL;
+  }
+  hls.perf_counters = options->autosa->perf_counters;
+  hls.fifo_trace = options->autosa->fifo_trace != NULL;
+  if (hls.host_session && (hls.perf_counters || hls.fifo_trace))
+  {
+    printf("[AutoSA] Warning: The host session is not supported with performance counters or FIFO traces. Disabled.\n");
+    hls.host_session = 0;
+  }
+  if (options->autosa->data_type && hls.hls)
+  {
+    /* The HLS testbench calls the kernel with the C types. */
+    printf("[AutoSA] Warning: Arbitrary-precision data types are only supported in the OpenCL host. Option --AutoSA-data-type is ignored.\n");
+    free(options->autosa->data_type);
+    options->autosa->data_type = NULL;
+  }
+  hls.aie = options->autosa->aie;
+  if (hls.aie && (hls.hls || hls.cpu_sim || hls.perf_counters ||
+                  hls.fifo_trace || options->autosa->persistent_kernel ||
+                  options->autosa->data_type))
+  {
+    /* The AI Engine kernels are compiled from the HLS PEs, without
+     * the profiling or the batches, on the C data types. */
+    printf("[AutoSA] Warning: The AI Engines are only supported in the OpenCL host without performance counters, FIFO traces, persistent kernels or arbitrary-precision data types. Disabled.\n");
+    hls.aie = 0;
+  }
+  if (options->autosa->triangular && !options->autosa->module_template)
+  {
+    /* The idle PEs drop their computation once their identifiers are
+     * constants. */
+    printf("[AutoSA] The triangular arrays specialize the PEs on their identifiers. Option --AutoSA-module-template is enabled.\n");
+    options->autosa->module_template = 1;
+  }
+  if (options->autosa->module_template &&
+      (hls.aie || options->autosa->module_dedup))
+  {
+    /* The AI Engine kernels and the shared module definitions call the
+     * modules with their module identifiers as function arguments. */
+    printf("[AutoSA] Warning: The module templates are not supported with AI Engines or shared module definitions. Disabled.\n");
+    options->autosa->module_template = 0;
+  }
+  if (options->autosa->triangular && !options->autosa->module_template)
+  {
+    printf("[AutoSA] Warning: The triangular arrays require the module templates. Disabled.\n");
+    options->autosa->triangular = 0;
+  }
+  hls.tb_cache = options->autosa->tb_cache;
+  hls.tb_sample = options->autosa->tb_sample;
+  if (hls.tb_cache && (!hls.hls || hls.perf_counters || hls.fifo_trace))
+  {
+    printf("[AutoSA] Warning: The cached testbench is only supported in the HLS host without performance counters or FIFO traces. Disabled.\n");
+    hls.tb_cache = 0;
+  }
+  if (options->autosa->pe_clock > 0 &&
+      (hls.hls || hls.cpu_sim || hls.aie || hls.perf_counters ||
+       hls.fifo_trace || options->autosa->n_slr > 1))
+  {
+    /* The PE kernel is only linked by Vitis, and the floorplan and the
+     * profiling modules assume a single kernel. */
+    printf("[AutoSA] Warning: The PE clock is only supported in the OpenCL host without AI Engines, SLR floorplanning, performance counters or FIFO traces. Disabled.\n");
+    options->autosa->pe_clock = 0;
+  }
+  hls.tile_scheduler = options->autosa->tile_scheduler;
+  if (hls.tile_scheduler && !options->autosa->runtime_tiles)
+  {
+    printf("[AutoSA] Warning: The tile scheduler requires the runtime numbers of array partitions (--AutoSA-runtime-tiles). Disabled.\n");
+    hls.tile_scheduler = 0;
+  }
+  hls.io_prefetch = options->autosa->io_prefetch;
+  if (hls.io_prefetch > 0 &&
+      (hls.cpu_sim || hls.perf_counters || options->autosa->persistent_kernel))
+  {
+    /* The processes of the prefetching modules would share the
+     * performance counters and the array pointers of the problems. */
+    printf("[AutoSA] Warning: The prefetching I/O modules are not supported in the CPU simulation, with performance counters or in persistent kernels. Disabled.\n");
+    hls.io_prefetch = 0;
+  }
+  hls.cache_sets = 0;
+  hls.cache_ways = 0;
+  if (options->autosa->irregular_cache)
+  {
+    if (sscanf(options->autosa->irregular_cache, "%dx%d", &hls.cache_sets,
+               &hls.cache_ways) != 2 ||
+        hls.cache_sets <= 0 || hls.cache_ways <= 0)
+    {
+      printf("[AutoSA] Warning: Invalid cache geometry %s, expected <sets>x<ways>. Option --AutoSA-irregular-cache is ignored.\n",
+             options->autosa->irregular_cache);
+      hls.cache_sets = 0;
+    }
+    else if (hls.cpu_sim || hls.aie || options->autosa->pe_clock > 0 ||
+             options->autosa->persistent_kernel)
+    {
+      /* The caches are called from the top module, and only stop once
+       * all the PEs of a single problem are done. */
+      printf("[AutoSA] Warning: The caches of the irregular arrays are not supported in the CPU simulation, with AI Engines, the PE clock or in persistent kernels. Option --AutoSA-irregular-cache is ignored.\n");
+      hls.cache_sets = 0;
+    }
+    if (hls.cache_sets == 0)
+    {
+      free(options->autosa->irregular_cache);
+      options->autosa->irregular_cache = NULL;
+      hls.cache_ways = 0;
+    }
+  }
+  hls.prefetch = 0;
+  hls.split_buf_lifted = 0;
   hls.ctx = ctx;
   hls.output_dir = options->autosa->output_dir;
   hls_open_files(&hls, input);
 
   r = generate_sa(ctx, input, hls.host_c, options, &print_hw, &hls);
 
-  hls_close_files(&hls);
+  hls_close_files(&hls, input);
 
   return r;
 }
@@ -1247,6 +1247,14 @@ static void create_kernel_var(isl_ctx *ctx, struct gpu_array_ref_group *group,
 	for (j = 0; j < group->array->n_index; ++j)
 		var->size = isl_vec_set_element_val(var->size, j,
 					    isl_val_copy(tile->bound[j].size));
+	if (var->type == ppcg_access_shared && tile->pad > 0) {
+		isl_val *size;
+
+		j = group->array->n_index - 1;
+		size = isl_vec_get_element_val(var->size, j);
+		size = isl_val_add_ui(size, tile->pad);
+		var->size = isl_vec_set_element_val(var->size, j, size);
+	}
 }
 
 static isl_stat create_kernel_vars(struct ppcg_kernel *kernel)
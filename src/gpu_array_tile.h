@@ -27,6 +27,9 @@ struct gpu_array_bound
  * requires_unroll is set if the schedule dimensions that are mapped
  * to threads need to be unrolled for this (private) tile to be used.
  *
+ * "pad" is the number of elements appended to the innermost dimension
+ * of a shared memory tile to avoid shared memory bank conflicts.
+ *
  * "depth" reflects the number of schedule dimensions that affect the tile.
  * The copying into and/or out of the tile is performed at that depth.
  *
@@ -46,6 +49,7 @@ struct gpu_array_tile
 {
 	isl_ctx *ctx;
 	int requires_unroll;
+	int pad;
 	int depth;
 	int n;
 	struct gpu_array_bound *bound;
@@ -420,6 +420,77 @@ static __isl_give isl_union_map *localize_access(struct gpu_group_data *data,
 	return access;
 }
 
+/* Return the number of elements by which the rows of the shared memory
+ * tile "tile" of the access relation "access" should be padded.
+ * "access" is of the same form as in access_is_coalesced.
+ *
+ * The shared memory is interleaved over banks of 32-bit words.
+ * If incrementing the dimension that will get wrapped over the last
+ * thread index results in accessing another element of the same column
+ * of the tile, i.e., an element with the same last array index,
+ * then the successive threads access elements that are one row apart.
+ * If the row size is even, then these elements fall into the same banks
+ * and the accesses are serialized, e.g., up to 32 times for 32 x 32 tiles.
+ * Padding the rows by one element makes the row size odd such that
+ * the column is spread over all the banks.
+ * The indexing of the tile is not affected by the padding.
+ */
+static int shared_tile_padding(struct gpu_group_data *data,
+	__isl_keep isl_union_map *access, struct gpu_array_tile *tile)
+{
+	int n;
+	isl_ctx *ctx;
+	isl_val *two;
+	isl_space *space;
+	isl_map *access_map;
+	isl_map *next_thread_x;
+	isl_map *map, *same_column, *same_element;
+	isl_bool even, empty, column, broadcast;
+
+	n = tile->n;
+	if (n < 2)
+		return 0;
+	ctx = tile->ctx;
+	two = isl_val_int_from_si(ctx, 2);
+	even = isl_val_is_divisible_by(tile->bound[n - 1].size, two);
+	isl_val_free(two);
+	if (even < 0)
+		return -1;
+	if (!even)
+		return 0;
+
+	access = isl_union_map_copy(access);
+	access = isl_union_map_apply_domain(access,
+				isl_union_map_copy(data->full_sched));
+	access_map = isl_map_from_union_map(access);
+
+	space = isl_map_get_space(access_map);
+	space = isl_space_domain(space);
+	next_thread_x = next(space, data->thread_depth + data->n_thread - 1);
+
+	map = isl_map_apply_domain(next_thread_x, isl_map_copy(access_map));
+	map = isl_map_apply_range(map, access_map);
+
+	space = isl_space_map_from_set(isl_space_range(isl_map_get_space(map)));
+	same_element = isl_map_identity(isl_space_copy(space));
+	same_column = isl_map_universe(space);
+	same_column = isl_map_equate(same_column, isl_dim_in, n - 1,
+					isl_dim_out, n - 1);
+
+	empty = isl_map_is_empty(map);
+	column = isl_map_is_subset(map, same_column);
+	broadcast = isl_map_is_subset(map, same_element);
+
+	isl_map_free(same_column);
+	isl_map_free(same_element);
+	isl_map_free(map);
+
+	if (empty < 0 || column < 0 || broadcast < 0)
+		return -1;
+
+	return !empty && column && !broadcast;
+}
+
 /* Given an access relation in terms of at least data->thread_depth initial
  * dimensions of the computed schedule, check if it is bijective for
  * fixed values of the first data->thread_depth dimensions.
@@ -872,6 +943,8 @@ static __isl_give isl_map *shared_access(struct gpu_array_ref_group *group,
  * We only try to compute a shared memory tile if there is any reuse
  * or if the access is not coalesced.
  * Reuse and coalescing are checked within the given kernel.
+ * The rows of the shared memory tile are padded if the threads access
+ * its columns, see shared_tile_padding.
  *
  * For computing a private memory tile, we also require that there is
  * some reuse.  Moreover, we require that the access is private
@@ -952,7 +1025,6 @@ static isl_stat compute_group_bounds_core(struct ppcg_kernel *kernel,
 		r = isl_stat_error;
 	if (use_shared && no_reuse)
 		coalesced = access_is_coalesced(data, local);
-	isl_union_map_free(local);
 
 	if (r >= 0 && kernel->options->debug->verbose &&
 	    use_shared && no_reuse && coalesced)
@@ -969,7 +1041,18 @@ static isl_stat compute_group_bounds_core(struct ppcg_kernel *kernel,
 			group->shared_tile =
 					gpu_array_tile_free(group->shared_tile);
 		isl_map_free(acc);
+		if (group->shared_tile) {
+			int pad;
+
+			pad = shared_tile_padding(data, local,
+							group->shared_tile);
+			if (pad < 0)
+				r = isl_stat_error;
+			else
+				group->shared_tile->pad = pad;
+		}
 	}
+	isl_union_map_free(local);
 
 	if (r < 0 || (!force_private && (!use_private || no_reuse))) {
 		isl_union_map_free(access);
@@ -6,6 +6,8 @@
  * Written by Sven Verdoolaege.
  */
 
+#include <stdlib.h>
+
 #include <isl/ctx.h>
 #include <isl/id.h>
 #include <isl/val.h>
@@ -348,6 +350,314 @@ static int merge_leaves(int n, struct ppcg_grouping_leaf leaves[n],
 	return n;
 }
 
+/* Validity and proximity schedule constraints "map" from the instances
+ * of a statement in the leaf at position "src" of a sequence of leaves
+ * to the instances of a statement in the later leaf at position "dst".
+ * "merge" caches the result of check_merge on "map" and
+ * is -1 as long as it has not been computed.
+ */
+struct ppcg_grouping_dep {
+	int src;
+	int dst;
+	int merge;
+	isl_map *map;
+};
+
+/* Internal data structure used by merge_leaves_incremental.
+ *
+ * "n" and "leaves" are the leaves in the sequence.
+ * "deps" contains "n_dep" constraints between statements in pairs
+ * of these leaves, with room for "size" elements.
+ * "unique" is cleared as soon as some statement turns out to have
+ * instances in several leaves.
+ */
+struct ppcg_leaf_deps_data {
+	int n;
+	struct ppcg_grouping_leaf *leaves;
+	int n_dep;
+	int size;
+	struct ppcg_grouping_dep *deps;
+	int unique;
+};
+
+/* Free all memory allocated for the constraints in "data".
+ */
+static void ppcg_leaf_deps_data_clear(struct ppcg_leaf_deps_data *data)
+{
+	int i;
+
+	for (i = 0; i < data->n_dep; ++i)
+		isl_map_free(data->deps[i].map);
+	free(data->deps);
+}
+
+/* Return the position of the leaf in data->leaves that contains
+ * instances of the statement with space "space" and store these
+ * instances in "set".
+ * Return -1 if there is no such leaf and -2 on error.
+ * If several leaves contain instances of the statement,
+ * then data->unique is cleared.
+ */
+static int find_leaf(struct ppcg_leaf_deps_data *data,
+	__isl_take isl_space *space, __isl_give isl_set **set)
+{
+	int i, pos = -1;
+
+	*set = NULL;
+	for (i = 0; i < data->n; ++i) {
+		isl_set *set_i;
+		isl_bool empty;
+
+		set_i = isl_union_set_extract_set(data->leaves[i].domain,
+						isl_space_copy(space));
+		empty = isl_set_plain_is_empty(set_i);
+		if (empty < 0 || empty) {
+			isl_set_free(set_i);
+			if (empty < 0) {
+				pos = -2;
+				break;
+			}
+			continue;
+		}
+		if (pos >= 0) {
+			isl_set_free(set_i);
+			data->unique = 0;
+			break;
+		}
+		pos = i;
+		*set = set_i;
+	}
+	isl_space_free(space);
+
+	if (pos == -2)
+		*set = isl_set_free(*set);
+	return pos;
+}
+
+/* Add the constraints in "map" to data->deps, restricted to
+ * the instances in the leaves of their source and target statements,
+ * if these are two distinct leaves in the sequence, in order.
+ * Abort if some statement has instances in several leaves.
+ */
+static isl_stat collect_leaf_dep(__isl_take isl_map *map, void *user)
+{
+	struct ppcg_leaf_deps_data *data = user;
+	isl_set *src_set, *dst_set;
+	int src, dst;
+
+	src = find_leaf(data, isl_space_domain(isl_map_get_space(map)),
+			&src_set);
+	dst = find_leaf(data, isl_space_range(isl_map_get_space(map)),
+			&dst_set);
+	if (src < -1 || dst < -1 || !data->unique || src < 0 || dst <= src) {
+		isl_set_free(src_set);
+		isl_set_free(dst_set);
+		isl_map_free(map);
+		if (src < -1 || dst < -1 || !data->unique)
+			return isl_stat_error;
+		return isl_stat_ok;
+	}
+
+	map = isl_map_intersect_domain(map, src_set);
+	map = isl_map_intersect_range(map, dst_set);
+	if (!map)
+		return isl_stat_error;
+
+	if (data->n_dep >= data->size) {
+		struct ppcg_grouping_dep *deps;
+
+		data->size = 2 * data->size + 16;
+		deps = isl_realloc_array(isl_map_get_ctx(map), data->deps,
+				struct ppcg_grouping_dep, data->size);
+		if (!deps) {
+			isl_map_free(map);
+			return isl_stat_error;
+		}
+		data->deps = deps;
+	}
+	data->deps[data->n_dep].src = src;
+	data->deps[data->n_dep].dst = dst;
+	data->deps[data->n_dep].merge = -1;
+	data->deps[data->n_dep].map = map;
+	data->n_dep++;
+
+	return isl_stat_ok;
+}
+
+/* Order the constraints by the positions of their source leaves and
+ * then by those of their target leaves.
+ */
+static int cmp_grouping_dep(const void *a, const void *b)
+{
+	const struct ppcg_grouping_dep *dep_a = a;
+	const struct ppcg_grouping_dep *dep_b = b;
+
+	if (dep_a->src != dep_b->src)
+		return dep_a->src - dep_b->src;
+	return dep_a->dst - dep_b->dst;
+}
+
+/* Should the group of leaves from "first" to "last" be merged
+ * with the group of leaves from "last + 1" to "next_last"?
+ *
+ * That is, is there any constraint between a statement in the first group
+ * and a statement in the second group for which check_merge holds?
+ * "start" contains the position of the first constraint in data->deps
+ * with each leaf as source.
+ * The result of check_merge is computed on the original leaves of
+ * the two statements and is cached in the constraints.
+ *
+ * Return 1 if the groups should be merged, 0 if not and -1 on error.
+ */
+static int merge_groups(struct ppcg_leaf_deps_data *data, int *start,
+	int first, int last, int next_last)
+{
+	int i, j;
+
+	for (i = first; i <= last; ++i) {
+		for (j = start[i]; j < start[i + 1]; ++j) {
+			struct ppcg_grouping_dep *dep = &data->deps[j];
+
+			if (dep->dst <= last)
+				continue;
+			if (dep->dst > next_last)
+				break;
+			if (dep->merge < 0) {
+				struct ppcg_merge_leaves_data merge_data;
+				isl_stat ok;
+
+				merge_data.merge = 0;
+				merge_data.src = &data->leaves[dep->src];
+				merge_data.dst = &data->leaves[dep->dst];
+				ok = check_merge(isl_map_copy(dep->map),
+						&merge_data);
+				if (ok < 0 && !merge_data.merge)
+					return -1;
+				dep->merge = merge_data.merge;
+			}
+			if (dep->merge)
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* Combine the leaves in each group of "leaves", where group "i"
+ * consists of the leaves from position "i" to position "last[i]",
+ * into the first "n_group" elements of "leaves".
+ */
+static isl_stat combine_groups(int n, struct ppcg_grouping_leaf leaves[n],
+	int *last)
+{
+	int i, j, k;
+
+	k = 0;
+	for (i = 0; i < n; i = last[i] + 1) {
+		struct ppcg_grouping_leaf leaf = leaves[i];
+
+		for (j = i + 1; j <= last[i]; ++j) {
+			leaf.domain = isl_union_set_union(leaf.domain,
+							leaves[j].domain);
+			leaf.list = isl_union_set_list_concat(leaf.list,
+							leaves[j].list);
+			leaf.prefix = isl_multi_union_pw_aff_union_add(
+					leaf.prefix, leaves[j].prefix);
+		}
+		for (j = i; j <= last[i]; ++j) {
+			leaves[j].domain = NULL;
+			leaves[j].list = NULL;
+			leaves[j].prefix = NULL;
+		}
+		leaves[k++] = leaf;
+		if (!leaf.domain || !leaf.list || !leaf.prefix)
+			return isl_stat_error;
+	}
+
+	return isl_stat_ok;
+}
+
+/* Merge pairs of consecutive leaves in "leaves" taking into account
+ * the intersection of validity and proximity schedule constraints "dep",
+ * in the same way as merge_leaves, but without recomputing
+ * the constraints between the merged leaves after each merge.
+ *
+ * The constraints in "dep" are split up once into constraints
+ * between pairs of the original leaves.  This requires each statement
+ * to have instances in at most one of the leaves.
+ * The outcome of check_merge on these constraints then only depends
+ * on the original leaves that contain their source and target statements
+ * and not on the leaves these have been merged with, so it is computed
+ * at most once for each of them.
+ * Since only consecutive leaves get merged, the groups of merged leaves
+ * are ranges of leaves, which are represented by their first leaf,
+ * with "last" keeping track of the last leaf of each group.
+ * The leaves themselves are only combined at the end.
+ *
+ * Return the final number of leaves in the sequence, -1 on error or
+ * -2 if some statement has instances in several leaves.
+ */
+static int merge_leaves_incremental(int n, struct ppcg_grouping_leaf leaves[n],
+	__isl_keep isl_union_map *dep)
+{
+	int i, n_group;
+	int *start, *last;
+	isl_ctx *ctx;
+	isl_stat ok;
+	struct ppcg_leaf_deps_data data = { n, leaves, 0, 0, NULL, 1 };
+
+	ok = isl_union_map_foreach_map(dep, &collect_leaf_dep, &data);
+	if (ok < 0) {
+		ppcg_leaf_deps_data_clear(&data);
+		return data.unique ? -1 : -2;
+	}
+	qsort(data.deps, data.n_dep, sizeof(struct ppcg_grouping_dep),
+		&cmp_grouping_dep);
+
+	ctx = isl_union_map_get_ctx(dep);
+	start = isl_alloc_array(ctx, int, n + 1);
+	last = isl_alloc_array(ctx, int, n);
+	if (!start || !last)
+		goto error;
+	for (i = 0, n_group = 0; i <= n; ++i) {
+		while (n_group < data.n_dep && data.deps[n_group].src < i)
+			n_group++;
+		start[i] = n_group;
+	}
+	for (i = 0; i < n; ++i)
+		last[i] = i;
+
+	n_group = n;
+	for (i = n - 1; i >= 0; --i) {
+		int merge, next;
+
+		next = last[i] + 1;
+		if (next >= n)
+			continue;
+		merge = merge_groups(&data, start, i, last[i], last[next]);
+		if (merge < 0)
+			goto error;
+		if (!merge)
+			continue;
+		last[i] = last[next];
+		--n_group;
+		++i;
+	}
+
+	if (n_group < n && combine_groups(n, leaves, last) < 0)
+		goto error;
+
+	free(start);
+	free(last);
+	ppcg_leaf_deps_data_clear(&data);
+	return n_group;
+error:
+	free(start);
+	free(last);
+	ppcg_leaf_deps_data_clear(&data);
+	return -1;
+}
+
 /* Construct a schedule with "domain" as domain, that executes
  * the elements of "list" in order (as a sequence).
  */
@@ -563,7 +873,8 @@ static isl_stat add_groups(struct ppcg_grouping *grouping,
  * schedule constraints is available and extract the required
  * information from the "n" leaves.
  * Then try and merge consecutive leaves based on the validity
- * and proximity constraints.
+ * and proximity constraints.  The leaves are merged incrementally,
+ * unless some statement has instances in several leaves.
  * If any pairs were successfully merged, then add groups
  * corresponding to the merged leaves to "grouping".
  */
@@ -580,7 +891,9 @@ static isl_stat group_subsequence(__isl_keep isl_schedule_node *node,
 	if (!leaves)
 		return isl_stat_error;
 
-	n_merge = merge_leaves(n, leaves, grouping->dep);
+	n_merge = merge_leaves_incremental(n, leaves, grouping->dep);
+	if (n_merge == -2)
+		n_merge = merge_leaves(n, leaves, grouping->dep);
 	if (n_merge >= 0 && n_merge < n &&
 	    add_groups(grouping, n_merge, leaves) < 0)
 		return isl_stat_error;
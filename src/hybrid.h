@@ -6,6 +6,11 @@
 
 #include "ppcg.h"
 
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
 struct ppcg_ht_bounds;
 typedef struct ppcg_ht_bounds ppcg_ht_bounds;
 
@@ -18,6 +23,8 @@ isl_bool ppcg_ht_parent_has_input_pattern(__isl_keep isl_schedule_node *node);
 __isl_give ppcg_ht_bounds *ppcg_ht_compute_bounds(struct ppcg_scop *scop,
 																									__isl_keep isl_schedule_node *node);
 void ppcg_ht_bounds_dump(__isl_keep ppcg_ht_bounds *bounds);
+__isl_give isl_val *ppcg_ht_bounds_get_lower(__isl_keep ppcg_ht_bounds *bounds,
+	int pos);
 isl_bool ppcg_ht_bounds_is_valid(__isl_keep ppcg_ht_bounds *bounds);
 isl_bool ppcg_ht_bounds_supports_sizes(__isl_keep ppcg_ht_bounds *bounds,
 																			 __isl_keep isl_multi_val *sizes);
@@ -39,4 +46,8 @@ __isl_give isl_schedule_node *hybrid_tile_foreach_phase(
 __isl_give isl_schedule_node *hybrid_tile_drop_phase_marks(
 		__isl_take isl_schedule_node *node);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -24,15 +24,27 @@
 #include "cuda.h"
 #include "opencl.h"
 #include "cpu.h"
+#include "autosa_server.h"
 
 #include <iostream>
 
 using namespace std;
 
+/* "autosa --server=<socket> [--server-jobs=<n>]" starts the compile server
+ * on the Unix domain socket "socket" instead of compiling a program,
+ * see autosa_server.cpp.
+ */
 int main(int argc, char **argv)
 {
 	int r;
 
+	if (argc > 1 && !strncmp(argv[1], "--server=", 9)) {
+		int n_job = 1;
+		if (argc > 2 && !strncmp(argv[2], "--server-jobs=", 14))
+			n_job = atoi(argv[2] + 14);
+		return autosa_server_main(argv[1] + 9, n_job);
+	}
+
 	r = autosa_main_wrap(argc, argv);
 
 	return r;
@@ -39,7 +39,10 @@
 #include "opencl.h"
 #include "cpu.h"
 #include "autosa_xilinx_hls_c.h"
+#include "autosa_cache.h"
 #include "autosa_intel_opencl.h"
+#include "autosa_cpu.h"
+#include "autosa_cuda.h"
 
 //#define _DEBUG
 
@@ -922,6 +925,17 @@ static __isl_give isl_map *construct_dep_rar(__isl_keep isl_vec *sol,
  */
 static isl_stat build_rar_dep(__isl_take isl_map *map, void *user) {
   struct ppcg_scop *ps = (struct ppcg_scop *)(user);
+  /* The irregular arrays are served by the caches instead of
+   * being reused across the PEs. */
+  if (ps->irregular_arrays) {
+    isl_space *space = isl_space_range(isl_map_get_space(map));
+    isl_bool irregular = isl_union_set_contains(ps->irregular_arrays, space);
+    isl_space_free(space);
+    if (irregular) {
+      isl_map_free(map);
+      return isl_stat_ok;
+    }
+  }
   /* Examine if the read access is an external access. */
   isl_union_map *tagged_dep_flow = ps->tagged_dep_flow;
   isl_bool is_external = isl_union_map_every_map(tagged_dep_flow, &is_external_access, map);
@@ -1007,12 +1021,46 @@ static void compute_tagged_rar_dep(struct ppcg_scop *ps)
   derive_rar_dep_from_tagged_rar_dep(ps);
 }
 
-static void compute_tagged_waw_dep_only(struct ppcg_scop *ps)
+/* Return the (universes of the) arrays written in "ps" whose WAW dependences
+ * have not been computed yet, restricted to the array called "name"
+ * if "name" is not NULL and the array is found among the arrays of pet.
+ */
+static __isl_give isl_union_set *waw_arrays_todo(struct ppcg_scop *ps,
+  const char *name)
+{
+  isl_union_set *arrays;
+
+  arrays = isl_union_map_range(isl_union_map_copy(ps->may_writes));
+  arrays = isl_union_set_universe(arrays);
+  for (int i = 0; name && i < ps->pet->n_array; i++) {
+    isl_set *extent = ps->pet->arrays[i]->extent;
+    const char *array_name = isl_set_get_tuple_name(extent);
+    if (!array_name || strcmp(array_name, name))
+      continue;
+    arrays = isl_union_set_from_set(isl_union_set_extract_set(arrays,
+                                      isl_set_get_space(extent)));
+    break;
+  }
+  if (ps->waw_arrays)
+    arrays = isl_union_set_subtract(arrays,
+                                    isl_union_set_copy(ps->waw_arrays));
+
+  return arrays;
+}
+
+/* Compute the tagged WAW dependences between the writes to the arrays
+ * "arrays" and add them to ps->tagged_dep_waw.
+ * The writes that are not executed after the dead code elimination
+ * are not taken into account.
+ */
+static void compute_tagged_waw_dep_only(struct ppcg_scop *ps,
+  __isl_take isl_union_set *arrays)
 {
   isl_union_pw_multi_aff *tagger;
   isl_schedule *schedule;
+  isl_union_set *domain;
   isl_union_map *kills;
-  isl_union_map *must_source;
+  isl_union_map *writes;
   isl_union_access_info *access;
   isl_union_flow *flow;
   isl_union_map *tagged_flow;
@@ -1020,39 +1068,107 @@ static void compute_tagged_waw_dep_only(struct ppcg_scop *ps)
   tagger = isl_union_pw_multi_aff_copy(ps->tagger);
   schedule = isl_schedule_copy(ps->schedule);
   schedule = isl_schedule_pullback_union_pw_multi_aff(schedule, tagger);
+  domain = isl_schedule_get_domain(schedule);
   kills = isl_union_map_copy(ps->tagged_must_kills);
-  must_source = isl_union_map_copy(ps->tagged_must_writes);
-  kills = isl_union_map_union(kills, must_source);
-  access = isl_union_access_info_from_sink(
-      isl_union_map_copy(ps->tagged_may_writes));
+  kills = isl_union_map_union(kills,
+      isl_union_map_copy(ps->tagged_must_writes));
+  kills = isl_union_map_intersect_range(kills, isl_union_set_copy(arrays));
+  kills = isl_union_map_intersect_domain(kills, isl_union_set_copy(domain));
+  writes = isl_union_map_copy(ps->tagged_may_writes);
+  writes = isl_union_map_intersect_range(writes, arrays);
+  writes = isl_union_map_intersect_domain(writes, domain);
+  access = isl_union_access_info_from_sink(isl_union_map_copy(writes));
   access = isl_union_access_info_set_kill(access, kills);
-  access = isl_union_access_info_set_may_source(access, 
-      isl_union_map_copy(ps->tagged_may_writes));
+  access = isl_union_access_info_set_may_source(access, writes);
   access = isl_union_access_info_set_schedule(access, schedule);
   flow = isl_union_access_info_compute_flow(access);
   tagged_flow = isl_union_flow_get_may_dependence(flow);
-  ps->tagged_dep_waw = tagged_flow;
+  ps->tagged_dep_waw = isl_union_map_union(ps->tagged_dep_waw, tagged_flow);
   isl_union_flow_free(flow);
 }
 
 static void derive_waw_dep_from_tagged_waw_dep(struct ppcg_scop *ps)
 {
+  isl_union_map_free(ps->dep_waw);
   ps->dep_waw = isl_union_map_copy(ps->tagged_dep_waw);
   ps->dep_waw = isl_union_map_factor_domain(ps->dep_waw);
 }
 
-/* Compute the WAW dependence for each intermediate write access.
- * The results are stored in ps->dep_waw.
- * A copy of the waw dependences, tagged with the reference tags 
- * is stored in ps->tagged_dep_waw.
- *
- * We first compute ps->tagged_dep_waw, i.e., the tagged WAW dependences
- * and then project out the tags. 
+/* Return the WAW dependences of "ps", tagged with the reference tags,
+ * between the writes to the array called "array", or to all arrays if
+ * "array" is NULL.
+ * The dependences are only used by the construction of the I/O of
+ * the systolic arrays and are therefore computed on demand,
+ * for the requested array only, unless they have been computed before.
+ * The untagged WAW dependences are kept in ps->dep_waw.
+ * The result may contain the dependences of other arrays as well.
  */
-static void compute_tagged_waw_dep(struct ppcg_scop *ps)
+__isl_keep isl_union_map *ppcg_scop_get_tagged_dep_waw(struct ppcg_scop *ps,
+  const char *array)
 {
-  compute_tagged_waw_dep_only(ps); 
+  isl_union_set *arrays;
+  isl_bool empty;
+
+  if (!ps->tagged_dep_waw)
+    ps->tagged_dep_waw = isl_union_map_empty(isl_set_get_space(ps->context));
+  arrays = waw_arrays_todo(ps, array);
+  empty = isl_union_set_is_empty(arrays);
+  if (empty < 0 || empty) {
+    isl_union_set_free(arrays);
+    if (!ps->dep_waw)
+      derive_waw_dep_from_tagged_waw_dep(ps);
+    return ps->tagged_dep_waw;
+  }
+
+  if (ps->waw_arrays)
+    ps->waw_arrays = isl_union_set_union(ps->waw_arrays,
+                                         isl_union_set_copy(arrays));
+  else
+    ps->waw_arrays = isl_union_set_copy(arrays);
+  compute_tagged_waw_dep_only(ps, arrays);
   derive_waw_dep_from_tagged_waw_dep(ps);
+
+  return ps->tagged_dep_waw;
+}
+
+/* Add the array read by "expr" to "user" if the access goes through
+ * a data-dependent (nested) index expression.
+ */
+static int collect_irregular_access(__isl_keep pet_expr *expr, void *user)
+{
+	isl_union_set **arrays = (isl_union_set **)user;
+	isl_multi_pw_aff *index;
+	isl_space *space;
+
+	if (pet_expr_get_n_arg(expr) == 0 || !pet_expr_access_is_read(expr))
+		return 0;
+	index = pet_expr_access_get_index(expr);
+	space = isl_space_range(isl_multi_pw_aff_get_space(index));
+	isl_multi_pw_aff_free(index);
+	*arrays = isl_union_set_add_set(*arrays, isl_set_universe(space));
+
+	return 0;
+}
+
+/* Collect the (universes of the) read-only arrays accessed through
+ * data-dependent index expressions in "ps" into ps->irregular_arrays,
+ * if these accesses are to be cached (--AutoSA-irregular-cache).
+ */
+static void collect_irregular_arrays(struct ppcg_scop *ps)
+{
+	isl_union_set *written;
+
+	if (!ps->options->autosa->irregular_cache)
+		return;
+
+	ps->irregular_arrays = isl_union_set_empty(isl_set_get_space(ps->context));
+	for (int i = 0; i < ps->pet->n_stmt; ++i)
+		pet_tree_foreach_access_expr(ps->pet->stmts[i]->body,
+			&collect_irregular_access, &ps->irregular_arrays);
+	written = isl_union_map_range(isl_union_map_copy(ps->may_writes));
+	written = isl_union_set_universe(written);
+	ps->irregular_arrays = isl_union_set_subtract(ps->irregular_arrays,
+							written);
 }
 
 /* Compute the dependences of the program represented by "scop".
@@ -1066,7 +1182,9 @@ static void compute_tagged_waw_dep(struct ppcg_scop *ps)
  * set of order dependences and a set of external false dependences
  * in compute_live_range_reordering_dependences.
  * 
- * Extended by AutoSA: Add analysis for WAW and RAR dependences.
+ * Extended by AutoSA: Add analysis for RAR dependences, which are used
+ * as schedule constraints.  The WAW dependences are only computed on demand,
+ * for the arrays that need them, by ppcg_scop_get_tagged_dep_waw.
  */
 static void compute_dependences(struct ppcg_scop *scop)
 {
@@ -1102,10 +1220,8 @@ static void compute_dependences(struct ppcg_scop *scop)
 	isl_union_flow_free(flow);
 
 	/* AutoSA Extended */
-	if (scop->options->autosa->autosa) {
+	if (scop->options->autosa->autosa)
 		compute_tagged_rar_dep(scop);
-		compute_tagged_waw_dep(scop);			
-	}
 	/* AutoSA Extended */
 }
 
@@ -1227,6 +1343,16 @@ static void *ppcg_scop_free(struct ppcg_scop *ps)
 	isl_union_map_free(ps->dep_rar);
 	isl_union_map_free(ps->tagged_dep_waw);
 	isl_union_map_free(ps->dep_waw);
+	isl_union_set_free(ps->waw_arrays);
+	isl_union_set_free(ps->irregular_arrays);
+	free(ps->cache_key);
+	for (int i = 0; i < 2; i++)
+	{
+		isl_multi_union_pw_aff_free(ps->dep_dis[i].band);
+		free(ps->dep_dis[i].dis);
+		free(ps->dep_dis[i].tagged_rar_dis);
+		free(ps->dep_dis[i].tagged_flow_dis);
+	}
 	/* AutoSA Extended */
 
 	free(ps);
@@ -1284,8 +1410,12 @@ static struct ppcg_scop *ppcg_scop_from_pet_scop(struct pet_scop *scop,
 			isl_union_map_copy(scop->independences[i]->filter));
 
 	compute_tagger(ps);
-	compute_dependences(ps);
-	eliminate_dead_code(ps);
+	collect_irregular_arrays(ps);
+	if (!autosa_cache_load_deps(ps)) {
+		compute_dependences(ps);
+		eliminate_dead_code(ps);
+		autosa_cache_save_deps(ps);
+	}
 
 	if (!ps->context || !ps->domain || !ps->call || !ps->reads ||
 	    !ps->may_writes || !ps->must_writes || !ps->tagged_must_kills ||
@@ -1464,8 +1594,10 @@ int autosa_main_wrap(int argc, char **argv)
 //	else if (options->ppcg->target == AUTOSA_TARGET_T2S)
 //	  r = generate_autosa_t2s(ctx, options->ppcg, options->input, 
 //				options->output); // TODO: To fix
-//	else if (options->ppcg->target == AUTOSA_TARGET_C)
-//	  r = generate_autosa_cpu(ctx, options->ppcg, options->input); // TODO: to fix
+	else if (options->ppcg->target == AUTOSA_TARGET_C)
+	  r = generate_autosa_cpu(ctx, options->ppcg, options->input);
+	else if (options->ppcg->target == AUTOSA_TARGET_CUDA)
+	  r = generate_autosa_cuda(ctx, options->ppcg, options->input);
 
 	isl_ctx_free(ctx);
 
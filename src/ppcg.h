@@ -1,6 +1,7 @@
 #ifndef PPCG_H
 #define PPCG_H
 
+#include <isl/aff.h>
 #include <isl/schedule.h>
 #include <isl/set.h>
 #include <isl/union_set.h>
@@ -18,6 +19,26 @@ extern "C"
 	const char *ppcg_base_name(const char *filename);
 	int ppcg_extract_base_name(char *name, const char *input);
 
+	/* The distances of the dependences at the loops of a permutable band
+ * with the partial schedule "band" of "band_w" members, shared by all
+ * the systolic array candidates derived from the band.
+ * "dis" contains the distances of the "n_dep" flow and RAR dependences,
+ * "tagged_rar_dis" and "tagged_flow_dis" those of the "n_tagged_rar"
+ * tagged RAR and the "n_tagged_flow" tagged flow dependences,
+ * each as a row of "band_w" elements.
+ */
+	struct autosa_dep_dis_table
+	{
+		isl_multi_union_pw_aff *band;
+		int band_w;
+		int n_dep;
+		int *dis;
+		int n_tagged_rar;
+		int *tagged_rar_dis;
+		int n_tagged_flow;
+		int *tagged_flow_dis;
+	};
+
 	/* Representation of the scop for use inside PPCG.
  *
  * "options" are the options specified by the user.
@@ -75,6 +96,13 @@ extern "C"
  * The names are mapped to a dummy value.
  *
  * "pet" is the original pet_scop.
+ *
+ * "dep_waw"/"tagged_dep_waw" represent the WAW dependences between
+ *	the writes to the arrays in "waw_arrays".  They are computed on demand
+ *	by ppcg_scop_get_tagged_dep_waw and may be NULL.
+ *
+ * "dep_dis" contains the dependence distances at the base permutable
+ * bands of the async and sync systolic array candidates.
  */
 	struct ppcg_scop
 	{
@@ -118,6 +146,14 @@ extern "C"
 		isl_union_map *tagged_dep_rar;
 		isl_union_map *dep_waw;
 		isl_union_map *tagged_dep_waw;
+		/* Arrays whose WAW dependences have been computed */
+		isl_union_set *waw_arrays;
+		/* Read-only arrays accessed through data-dependent indices */
+		isl_union_set *irregular_arrays;
+		/* Key of the scop in the compilation cache */
+		char *cache_key;
+		/* Dependence distances of the async and sync candidates */
+		struct autosa_dep_dis_table dep_dis[2];
 		/* AutoSA Extended */
 	};
 
@@ -132,6 +168,8 @@ extern "C"
 										 void *user);
 
 	int autosa_main_wrap(int argc, char **argv);
+	__isl_keep isl_union_map *ppcg_scop_get_tagged_dep_waw(struct ppcg_scop *ps,
+																												 const char *array);
 
 #ifdef __cplusplus
 }
@@ -15,6 +15,7 @@ static struct isl_arg_choice target[] = {
 	{"cuda",					PPCG_TARGET_CUDA},
 	{"opencl",      	PPCG_TARGET_OPENCL},
 	{"autosa_c",		 	AUTOSA_TARGET_C},
+	{"autosa_cuda",		AUTOSA_TARGET_CUDA},
 	{"autosa_hls_c", 	AUTOSA_TARGET_XILINX_HLS_C},
 	{"autosa_opencl",	AUTOSA_TARGET_INTEL_OPENCL},
 	{"autosa_t2s",		AUTOSA_TARGET_T2S},
@@ -88,30 +89,161 @@ ISL_ARGS_END
 ISL_ARGS_START(struct autosa_options, autosa_options_args)
 ISL_ARG_BOOL(struct autosa_options, autosa, 0, "autosa", 1,
   "generate systolic arrays using AutoSA")
+ISL_ARG_BOOL(struct autosa_options, adder_tree, 0, "adder-tree", 0,
+  "print the SIMD reductions of the Xilinx PEs as balanced adder trees")
+ISL_ARG_BOOL(struct autosa_options, aie, 0, "aie", 0,
+  "map the PEs on the AI Engines of Versal devices")
+ISL_ARG_BOOL(struct autosa_options, axi_burst, 0, "axi-burst", 0,
+  "tune the AXI burst length and outstanding transactions of external memory interfaces")
+ISL_ARG_BOOL(struct autosa_options, batch1, 0, "batch1", 0,
+  "optimize the design for the latency of a single request")
+ISL_ARG_STR(struct autosa_options, block_sparse, 0, "block-sparse", "blocks", NULL,
+  "block sizes of the block-sparse arrays, e.g., \"A=64;B=64\"")
+ISL_ARG_STR(struct autosa_options, cache_dir, 0, "cache-dir", "dir", NULL,
+  "directory of the compilation cache")
+ISL_ARG_STR(struct autosa_options, calibration, 0, "calibration", "file", NULL,
+  "correction coefficients of the latency and resource estimators")
+ISL_ARG_INT(struct autosa_options, chain_pipeline, 0, "chain-pipeline", "hops", 0,
+  "insert a pipeline stage every <hops> hops in the I/O daisy chains")
+ISL_ARG_INT(struct autosa_options, compute_units, 0, "compute-units", "num",
+  1,
+  "number of compute units of the kernel (0 for as many as fit the "
+  "resources)")
 ISL_ARG_STR(struct autosa_options, config, 0, "config", "config", NULL, 
   "AutoSA configuration file")
+ISL_ARG_BOOL(struct autosa_options, conv, 0, "conv", 0,
+  "buffer the sliding windows of the convolutions in the array partitions")
+ISL_ARG_STR(struct autosa_options, conv_dataflow, 0, "conv-dataflow",
+  "dataflow", NULL,
+  "keep the weight-stationary (ws) or output-stationary (os) arrays only")
+ISL_ARG_STR(struct autosa_options, conv_group, 0, "conv-group",
+  "mapping", NULL,
+  "map the groups of the grouped convolutions on the array rows (row) "
+  "or over the time loops (time)")
+ISL_ARG_STR(struct autosa_options, cost_model, 0, "cost-model", "file", NULL,
+  "learned cost model that rescores the explored design points")
 ISL_ARG_BOOL(struct autosa_options, credit_control, 0, "credit-control", 0,
   "enable credit control between different array partitions")	
 ISL_ARG_BOOL(struct autosa_options, data_pack, 0, "data-pack", 1,
   "enable data packing for data transfer")	
+ISL_ARG_STR(struct autosa_options, data_type, 0, "data-type", "types", NULL,
+  "HLS data types of the element types, e.g., \"data_t=ap_int<8>;acc_t=ap_int<32>\"")
 ISL_ARG_BOOL(struct autosa_options, double_buffer, 0, "double-buffer", 1,
-  "enable double-buffering for data transfer")	
+  "enable double-buffering for data transfer")
+ISL_ARG_BOOL(struct autosa_options, dsp_pack, 0, "dsp-pack", 0,
+  "pack two narrow integer multiplies sharing an operand in one DSP")	
+ISL_ARG_BOOL(struct autosa_options, explore, 0, "explore", 0,
+  "explore the design space in-process")
+ISL_ARG_BOOL(struct autosa_options, explore_arena, 0, "explore-arena", 0,
+  "keep the freed memory of the exploration in a warm process heap")
+ISL_ARG_INT(struct autosa_options, explore_budget, 0, "explore-budget", "num",
+  256,
+  "maximal number of (partial) design points evaluated by the sampling "
+  "search strategies")
+ISL_ARG_INT(struct autosa_options, explore_jobs, 0, "explore-jobs", "num", 1,
+  "number of parallel jobs in design space exploration")
+ISL_ARG_STR(struct autosa_options, explore_journal, 0, "explore-journal",
+  "file", NULL,
+  "journal of the evaluated design points to resume the exploration from")
+ISL_ARG_INT(struct autosa_options, explore_max_points, 0, "explore-max-points", "num", 1024,
+  "maximal number of design points to explore (0 for unlimited)")
+ISL_ARG_STR(struct autosa_options, explore_strategy, 0, "explore-strategy",
+  "strategy", NULL,
+  "search strategy of the exploration: exhaustive, random, genetic or bayes")
+ISL_ARG_INT(struct autosa_options, explore_time, 0, "explore-time", "seconds",
+  0,
+  "time budget of the sampling search strategies (0 for unlimited)")
+ISL_ARG_STR(struct autosa_options, fifo_trace, 0, "fifo-trace", "fifos", NULL,
+  "comma-separated FIFOs whose occupancy is traced on hardware")
+ISL_ARG_BOOL(struct autosa_options, fuse_init, 0, "fuse-init", 0,
+  "fuse the zero initializations into the first updates of the sums in the PEs")
 ISL_ARG_BOOL(struct autosa_options, hbm, 0, "hbm", 0,
   "use multi-port DRAM/HBM")	
+ISL_ARG_INT(struct autosa_options, n_hbm_channel, 0, "hbm-channel-num", "num", 0,
+  "number of HBM channels assigned automatically to the I/O groups")
 ISL_ARG_INT(struct autosa_options, n_hbm_port, 0, "hbm-port-num", "num", 2, 
   "default HBM port number")
 ISL_ARG_BOOL(struct autosa_options, hls, 0, "hls", 0,
   "generate Xilinx HLS host")	
+ISL_ARG_INT(struct autosa_options, host_batch, 0, "host-batch", "num", 1,
+  "number of in-flight batches in Xilinx OpenCL host")
+ISL_ARG_INT(struct autosa_options, host_bench, 0, "host-bench", "reps", 0,
+  "number of timed kernel repetitions in benchmark mode of Xilinx OpenCL host")
+ISL_ARG_INT(struct autosa_options, host_bench_warmup, 0, "host-bench-warmup",
+  "runs", 2, "number of warmup runs in benchmark mode of Xilinx OpenCL host")
+ISL_ARG_BOOL(struct autosa_options, host_serialize, 0, "host-serialize", 0,
+  "serialize arrays in DRAM access order in Xilinx OpenCL host")
+ISL_ARG_BOOL(struct autosa_options, host_session, 0, "host-session", 0,
+  "generate a persistent device session library in Xilinx host")
+ISL_ARG_BOOL(struct autosa_options, host_simd_unpack, 0, "host-simd-unpack", 0,
+  "unpack the outputs with SIMD copies in Xilinx OpenCL host")
+ISL_ARG_INT(struct autosa_options, host_threads, 0, "host-threads", "num", 1,
+  "number of threads preparing the host buffers in Xilinx host")
+ISL_ARG_BOOL(struct autosa_options, host_xrt, 0, "host-xrt", 0,
+  "use the native XRT API in Xilinx host")
+ISL_ARG_BOOL(struct autosa_options, host_zero_copy, 0, "host-zero-copy", 0,
+  "bind device buffers to aligned host arrays in Xilinx OpenCL host")
+ISL_ARG_STR(struct autosa_options, hw_info, 0, "hw-info", "info", NULL,
+  "hardware resource information file")
 ISL_ARG_BOOL(struct autosa_options, insert_hls_dependence, 0, "insert-hls-dependence", 1,
-  "insert Xilinx HLS dependence pragma")		
+  "insert Xilinx HLS dependence pragma on the I/O buffers proven free of "
+  "carried dependences at the pipelined loops")		
+ISL_ARG_INT(struct autosa_options, intel_mem_banks, 0, "intel-mem-banks", "num", 0,
+  "number of memory banks to place the buffers in for Intel OpenCL, 0 to "
+  "interleave them")
+ISL_ARG_INT(struct autosa_options, io_prefetch, 0, "io-prefetch", "depth", 0,
+  "decouple the external memory accesses of the L3 I/O modules by FIFOs of "
+  "<depth> elements")
+ISL_ARG_BOOL(struct autosa_options, io_rebalance, 0, "io-rebalance", 0,
+  "rebalance the data pack factors of the I/O modules against the PEs")
+ISL_ARG_STR(struct autosa_options, irregular_cache, 0, "irregular-cache", "geometry", NULL,
+  "serve the read-only arrays accessed through data-dependent indices from "
+  "an on-chip set-associative cache of geometry <sets>x<ways> (e.g. 256x4)")
+ISL_ARG_INT(struct autosa_options, kernel_clock, 0, "kernel-clock", "MHz", 250,
+  "frequency of the kernel clock of the I/O modules with the PE clock")
 ISL_ARG_BOOL(struct autosa_options, use_local_memory, 0, "local-memory", 1, 
   "use local memory in kernel code")
+ISL_ARG_BOOL(struct autosa_options, loop_flatten, 0, "loop-flatten", 0,
+  "flatten the perfect loop nests of the pipelined loops in the I/O modules")
+ISL_ARG_BOOL(struct autosa_options, loop_skew, 0, "loop-skew", 0,
+  "skew the loops to expose more space loop candidates")
+ISL_ARG_INT(struct autosa_options, max_fifo_depth, 0,
+  "max-fifo-depth", "depth", 512, "maximal FIFO depth")
 ISL_ARG_INT(struct autosa_options, max_local_memory, 0,
   "max-local-memory", "size", 8192, "maximal amount of local memory")	
 ISL_ARG_INT(struct autosa_options, max_sa_dim, 0,
   "max-sa-dim", "dim", 2, "maximal systolic array dimension")
+ISL_ARG_BOOL(struct autosa_options, mem_binding, 0, "mem-binding", 0,
+  "bind the local buffers to the memory resources of the board together")
+ISL_ARG_BOOL(struct autosa_options, module_dedup, 0, "module-dedup", 0,
+  "share the definitions of the structurally identical modules")
+ISL_ARG_BOOL(struct autosa_options, module_template, 0, "module-template", 0,
+  "print the Xilinx modules as templates on their module identifiers")
+ISL_ARG_INT(struct autosa_options, multi_device, 0, "multi-device", "num", 1,
+  "number of devices running the array partitions of the Xilinx kernel")
+ISL_ARG_BOOL(struct autosa_options, on_chip_drain_merge, 0,
+  "on-chip-drain-merge", 0,
+  "merge the drained results of all the memory ports on-chip")
 ISL_ARG_STR(struct autosa_options, output_dir, 0, "output-dir", "dir", "./autosa.tmp/output", 
   "AutoSA Output directory")
+ISL_ARG_BOOL(struct autosa_options, output_resident, 0, "output-resident", 0,
+  "keep the outputs on-chip across the reduction array partitions")
+ISL_ARG_INT(struct autosa_options, pe_clock, 0, "pe-clock", "MHz", 0,
+  "run the PEs in their own kernel clocked at MHz")
+ISL_ARG_BOOL(struct autosa_options, perf_counters, 0, "perf-counters", 0,
+  "insert performance counters into the hardware modules")
+ISL_ARG_BOOL(struct autosa_options, persistent_kernel, 0, "persistent-kernel", 0,
+  "generate a persistent kernel that processes a batch of problems per launch")
+ISL_ARG_BOOL(struct autosa_options, profile, 0, "profile", 0,
+  "profile the compilation phases")
+ISL_ARG_STR(struct autosa_options, qdma_stream, 0, "qdma-stream", "arrays", NULL,
+  "arrays streamed to the kernel through QDMA in Xilinx OpenCL host, e.g., \"A;B\"")
+ISL_ARG_BOOL(struct autosa_options, reg_reuse, 0, "reg-reuse", 0,
+  "reuse the array elements invariant in the inner PE loops in registers")
+ISL_ARG_INT(struct autosa_options, resource_target, 0, "resource-target", "percent", 80,
+  "maximal resource utilization (in percentage) of the design")
+ISL_ARG_BOOL(struct autosa_options, runtime_tiles, 0, "runtime-tiles", 0,
+  "set the number of array partitions at runtime")
 ISL_ARG_STR(struct autosa_options, sa_sizes, 0, "sa-sizes", "sizes", NULL,
 	"per kernel PE optimization tile sizes")	
 ISL_ARG_INT(struct autosa_options, sa_tile_size, 0, "sa-tile-size", "size", 4, 
@@ -119,8 +251,24 @@ ISL_ARG_INT(struct autosa_options, sa_tile_size, 0, "sa-tile-size", "size", 4,
 ISL_ARG_USER_OPT_CHOICE(struct autosa_options, sa_type, 0, "sa-type", sa_type,
   NULL, AUTOSA_SA_TYPE_ASYNC, AUTOSA_SA_TYPE_ASYNC,
   "systolic array type")	
+ISL_ARG_BOOL(struct autosa_options, share_input, 0, "share-input", 0,
+  "share the host buffer of the read-only I/O groups of the same array")
 ISL_ARG_STR(struct autosa_options, simd_info, 0, "simd-info", "info", NULL,
 	"per kernel SIMD information")	
+ISL_ARG_BOOL(struct autosa_options, simulate, 0, "simulate", 0,
+  "simulate the array to validate the estimated latency")
+ISL_ARG_INT(struct autosa_options, n_slr, 0, "slr-num", "num", 1,
+  "number of SLRs to floorplan the array on")
+ISL_ARG_BOOL(struct autosa_options, stencil_skew, 0, "stencil-skew", 0,
+  "skew the time loop of stencils into a permutable band")
+ISL_ARG_BOOL(struct autosa_options, tb_cache, 0, "tb-cache", 0,
+  "generate a testbench replaying the golden data cached by the HLS host")
+ISL_ARG_INT(struct autosa_options, tb_sample, 0, "tb-sample", "num", 1,
+  "check every num-th output element in the cached testbench")
+ISL_ARG_BOOL(struct autosa_options, tile_scheduler, 0, "tile-scheduler", 0,
+  "generate a host tile scheduler running jobs of several sizes on the array")
+ISL_ARG_BOOL(struct autosa_options, triangular, 0, "triangular", 0,
+  "specialize the PEs of non-rectangular arrays on their position")
 ISL_ARG_BOOL(struct autosa_options, two_level_buffer, 0, "two-level-buffer", 0,
   "enable two-level buffering in I/O modules")
 ISL_ARG_BOOL(struct autosa_options, t2s_tile, 0, "t2s-tile", 0,
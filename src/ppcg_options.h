@@ -22,11 +22,19 @@ extern "C"
 	{
 		/* Generate systolic array using AutoSA. */
 		int autosa;
+		/* Print the SIMD reductions as balanced adder trees. */
+		int adder_tree;
+		/* Tune the AXI bursts of the external memory interfaces. */
+		int axi_burst;
 		/* Use HBM memory. */
 		int hbm;
+		/* Number of HBM channels assigned automatically to the I/O groups */
+		int n_hbm_channel;
 		int n_hbm_port;
 		/* Enable double buffering. */
 		int double_buffer;
+		/* Pack two narrow multiplies in one DSP */
+		int dsp_pack;
 		/* Maximal systolic array dimension. */
 		int max_sa_dim;
 		/* Systolic array type. */
@@ -45,24 +53,152 @@ extern "C"
 		int max_local_memory;
 		/* Enable data pack for transferring data */
 		int data_pack;
+		/* HLS data types of the C element types */
+		char *data_type;
+		/* Block sizes of the block-sparse arrays */
+		char *block_sparse;
 		/* Enable credit control between different array partitions */
 		int credit_control;
 		/* Enable two-level buffering in I/O modules */
 		int two_level_buffer;
 		/* Configuration file */
 		char *config;
+		/* Compilation cache directory */
+		char *cache_dir;
+		/* Number of hops between the pipeline stages in the I/O chains */
+		int chain_pipeline;
 		/* Output directory */
 		char *output_dir;
 		/* SIMD information file */
 		char *simd_info;
 		/* Generate HLS host instead of OpenCL host */
 		int hls;
+		/* Number of in-flight batches in Xilinx OpenCL host */
+		int host_batch;
+		/* Maximal FIFO depth */
+		int max_fifo_depth;
+		/* Serialize arrays in DRAM access order in Xilinx OpenCL host */
+		int host_serialize;
+		/* Bind device buffers to host arrays in Xilinx OpenCL host */
+		int host_zero_copy;
+		/* Generate a persistent kernel looping over a batch of problems */
+		int persistent_kernel;
 		/* Use URAM */
 		int uram;
 		/* Print verbose information */
 		int verbose;
-		/* Insert HLS dependence pragma */
+		/* Insert HLS dependence pragma where no dependence is carried */
 		int insert_hls_dependence;
+		/* Explore the design space in-process */
+		int explore;
+		/* Maximal number of design points to explore */
+		int explore_max_points;
+		/* Number of parallel jobs in exploration */
+		int explore_jobs;
+		/* Hardware resource information file */
+		char *hw_info;
+		/* Resource utilization target (in percentage) */
+		int resource_target;
+		/* Profile the compilation phases */
+		int profile;
+		/* Reuse the invariant array elements in PE registers */
+		int reg_reuse;
+		/* Simulate the array to validate the estimated latency */
+		int simulate;
+		/* Number of SLRs to floorplan the array on */
+		int n_slr;
+		/* Set the number of array partitions at runtime */
+		int runtime_tiles;
+		/* Insert performance counters into the hardware modules */
+		int perf_counters;
+		/* Calibration file of the latency and resource estimators */
+		char *calibration;
+		/* Comma-separated FIFOs whose occupancy is traced */
+		char *fifo_trace;
+		/* Number of timed kernel repetitions in the benchmark mode of
+		 * the OpenCL host */
+		int host_bench;
+		/* Number of warmup runs in the benchmark mode of the OpenCL host */
+		int host_bench_warmup;
+		/* Optimize the design for the latency of a single request */
+		int batch1;
+		/* Skew the time loop of stencils into a permutable band */
+		int stencil_skew;
+		/* Skew the loops to expose more space loop candidates */
+		int loop_skew;
+		/* Bind the local buffers to the memory resources of the board
+		 * together */
+		int mem_binding;
+		/* Merge the drained results of all the memory ports on-chip */
+		int on_chip_drain_merge;
+		/* Use the native XRT API in the Xilinx host */
+		int host_xrt;
+		/* Number of devices across which the outermost array partitioning
+		 * loop is distributed */
+		int multi_device;
+		/* Rebalance the I/O modules against the throughput of the PEs */
+		int io_rebalance;
+		/* Flatten the perfect loop nests of the pipelined loops in the
+		 * I/O modules */
+		int loop_flatten;
+		/* Keep the freed memory of the exploration in a warm heap */
+		int explore_arena;
+		/* Generate a testbench replaying the cached golden data */
+		int tb_cache;
+		/* Stride of the outputs checked by the cached testbench */
+		int tb_sample;
+		/* Map the PEs on the AI Engines */
+		int aie;
+		/* Share the definitions of the structurally identical modules */
+		int module_dedup;
+		/* Map the sliding-window accesses of convolutions */
+		int conv;
+		/* Dataflow of the convolution arrays (ws or os) */
+		char *conv_dataflow;
+		/* Mapping of the convolution groups (row or time) */
+		char *conv_group;
+		/* Generate the host tile scheduler of the runtime array partitions */
+		int tile_scheduler;
+		/* Keep the outputs on-chip across the reduction array partitions */
+		int output_resident;
+		/* Frequency of the PE clock in MHz, 0 for a single clock */
+		int pe_clock;
+		/* Frequency of the kernel clock in MHz with the PE clock */
+		int kernel_clock;
+		/* Learned cost model of the design space exploration */
+		char *cost_model;
+		/* Search strategy of the design space exploration */
+		char *explore_strategy;
+		/* Evaluation budget of the sampling search strategies */
+		int explore_budget;
+		/* Time budget of the sampling search strategies in seconds */
+		int explore_time;
+		/* Share the memory ports of the read-only I/O groups of an array */
+		int share_input;
+		/* Depth of the prefetch FIFOs of the L3 I/O modules */
+		int io_prefetch;
+		/* Geometry of the caches of the arrays accessed irregularly */
+		char *irregular_cache;
+		/* Print the modules as templates on their module identifiers */
+		int module_template;
+		/* Journal of the design space exploration */
+		char *explore_journal;
+		/* Number of compute units of the kernel, 0 to fit the resources */
+		int compute_units;
+		/* Specialize the PEs of non-rectangular arrays on their position */
+		int triangular;
+		/* Fuse the zero initializations into the sums in the PEs */
+		int fuse_init;
+		/* Generate a persistent device session library in the host */
+		int host_session;
+		/* Number of threads copying the host buffers in the host */
+		int host_threads;
+		/* Arrays streamed to the kernel through the QDMA host streams */
+		char *qdma_stream;
+		/* Number of memory banks of the buffers on Intel FPGAs, 0 to interleave */
+		int intel_mem_banks;
+		/* Unpack the outputs in the host with SIMD copies */
+		int host_simd_unpack;
 	};
 
 	struct ppcg_options
@@ -154,6 +290,7 @@ extern "C"
 #define AUTOSA_TARGET_INTEL_OPENCL 4
 #define AUTOSA_TARGET_T2S 5
 #define AUTOSA_TARGET_C 6
+#define AUTOSA_TARGET_CUDA 7
 
 #define AUTOSA_SA_TYPE_SYNC 0
 #define AUTOSA_SA_TYPE_ASYNC 1